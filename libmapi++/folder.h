@@ -29,6 +29,7 @@
 #include <libmapi++/mapi_exception.h>
 #include <libmapi++/object.h>
 #include <libmapi++/message.h>
+#include <libmapi++/property_container.h>
 
 namespace libmapipp
 {
@@ -45,6 +46,11 @@ class folder : public object {
 
 		typedef std::vector<message_shared_ptr >	message_container_type;
 
+		/**
+		 * Contents table rows, one property container per %message
+		*/
+		typedef std::vector<property_container>		row_container_type;
+
 		/**
 		 * Pointer to a %folder
 		*/
@@ -91,10 +97,24 @@ class folder : public object {
 		/**
 		 * \brief Fetch all messages in this %folder
 		 *
+		 * Messages are opened on first use.
+		 *
 		 * \return A container of message shared pointers.
 		 */
 		message_container_type fetch_messages() throw(mapi_exception);
 
+		/**
+		 * \brief Fetch some properties of all messages in this %folder
+		 *
+		 * The properties are read from the contents table and no %message
+		 * is opened.
+		 *
+		 * \param columns The property tags to fetch.
+		 *
+		 * \return A container of property containers, one per %message.
+		 */
+		row_container_type fetch_messages(const std::vector<uint32_t>& columns) throw(mapi_exception);
+
 		/**
 		 * \brief Fetch all subfolders within this %folder
 		 *
@@ -113,6 +133,72 @@ class folder : public object {
 		mapi_id_t	m_id;
 };
 
+/**
+ * \brief A cursor over the messages of a %folder
+ *
+ * The contents table is read one page at a time, so enumerating a large
+ * %folder does not keep every row in memory.
+ *
+ * \code
+ * message_cursor cursor(inbox_folder, columns);
+ * while (cursor.next()) {
+ * 	property_container row = cursor.get_row();
+ * 	...
+ * }
+ * \endcode
+ */
+class message_cursor : public object {
+	public:
+		/**
+		 * \brief Constructor
+		 *
+		 * \param parent_folder The %folder to enumerate.
+		 * \param columns The property tags to fetch for each %message, in
+		 * addition to PR_FID and PR_MID.
+		 * \param page_size The number of rows to read at once.
+		 */
+		message_cursor(folder& parent_folder, const std::vector<uint32_t>& columns = std::vector<uint32_t>(),
+			       uint32_t page_size = 0x32) throw(mapi_exception);
+
+		/**
+		 * \brief Get the number of messages in the %folder when the cursor was created.
+		 */
+		uint32_t size() const { return m_row_count; }
+
+		/**
+		 * \brief Move to the next %message.
+		 *
+		 * \return false when there are no more messages.
+		 */
+		bool next() throw(mapi_exception);
+
+		/**
+		 * \brief Get the properties of the current %message.
+		 *
+		 * The container is only valid until the next call to next().
+		 */
+		property_container get_row() throw(mapi_exception);
+
+		/**
+		 * \brief Get the current %message. It is opened on first use.
+		 */
+		folder::message_shared_ptr get_message() throw(mapi_exception);
+
+		/**
+		 * Destructor
+		 */
+		virtual ~message_cursor() throw()
+		{
+			if (m_row_set.aRow) MAPIFreeBuffer(m_row_set.aRow);
+		}
+
+	private:
+		uint32_t	m_row_count;
+		uint32_t	m_page_size;
+		uint32_t	m_row;
+		SRowSet		m_row_set;
+};
+
 } // namespace libmapipp
 
 #endif //!LIBMAPIPP__FOLDER_H__
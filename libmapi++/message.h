@@ -53,14 +53,55 @@ class message : public object {
 		 * \param mapi_session The session to use to retrieve this %message.
 		 * \param folder_id The id of the folder this %message belongs to.
 		 * \param message_id The %message id.
+		 * \param open_now Whether to open the %message right away. When false,
+		 * the %message is opened on first use, which saves a round-trip
+		 * per %message when enumerating a folder.
 		 */
-		message(session& mapi_session, const mapi_id_t folder_id, const mapi_id_t message_id) throw(mapi_exception) 
-		: object(mapi_session, "message"), m_folder_id(folder_id), m_id(message_id)
+		message(session& mapi_session, const mapi_id_t folder_id, const mapi_id_t message_id, bool open_now = true) throw(mapi_exception)
+		: object(mapi_session, "message"), m_folder_id(folder_id), m_id(message_id), m_opened(false)
 		{
-			if (OpenMessage(&mapi_session.get_message_store().data(), folder_id, message_id, &m_object, 0) != MAPI_E_SUCCESS)
-				throw mapi_exception(GetLastError(), "message::message : OpenMessage");
+			if (open_now) open();
 		}
 
+		/**
+		 * \brief Open this %message if it is not opened yet.
+		 */
+		void open() throw(mapi_exception)
+		{
+			if (m_opened) return;
+
+			if (OpenMessage(&m_session.get_message_store().data(), m_folder_id, m_id, &m_object, 0) != MAPI_E_SUCCESS)
+				throw mapi_exception(GetLastError(), "message::open : OpenMessage");
+			m_opened = true;
+		}
+
+		/**
+		 * \brief Obtain a reference to the mapi_object_t associated with this %message
+		 *
+		 * The %message is opened first if needed. If opening fails, the
+		 * error is reported with mapi_errstr(), the handle stays invalid
+		 * and libmapi calls using it fail. Call open() first to get the
+		 * error as an exception.
+		 */
+		virtual mapi_object_t& data() throw()
+		{
+			if (!m_opened) {
+				try {
+					open();
+				} catch (const mapi_exception& e) {
+					mapi_errstr("message::data : OpenMessage", e.get_status());
+				}
+			}
+			return m_object;
+		}
+
+		/**
+		 * \brief Obtain a property_container to be used with this %message.
+		 *
+		 * The %message is opened first if needed.
+		 */
+		virtual property_container get_property_container();
+
 		/**
 		 * \brief Fetches all attachments in this %message.
 		 *
@@ -88,7 +129,7 @@ class message : public object {
 	private:
 		mapi_id_t	m_folder_id;
 		mapi_id_t	m_id;
-
+		bool		m_opened;
 };
 
 } // namespace libmapipp
@@ -23,6 +23,7 @@
 
 #include <stdint.h>
 #include <iostream> // for debugging only.
+#include <boost/shared_ptr.hpp>
 
 #include <libmapi++/clibmapi.h>
 #include <libmapi++/mapi_exception.h>
@@ -164,7 +165,27 @@ class property_container {
 
 		/// Constructor
 		property_container(TALLOC_CTX* memory_ctx, mapi_object_t& mapi_object) : 
-		m_memory_ctx(memory_ctx), m_mapi_object(mapi_object), m_fetched(false), m_property_tag_array(NULL), m_cn_vals(0), m_property_values(0)
+		m_memory_ctx(memory_ctx), m_mapi_object(&mapi_object), m_fetched(false), m_property_tag_array(NULL), m_cn_vals(0), m_property_values(0)
+		{
+			m_property_value_array.cValues = 0;
+			m_property_value_array.lpProps = NULL;
+		}
+
+		/**
+		 * \brief Constructor for a container holding a table row
+		 *
+		 * The container is already fetched and only gives access to the
+		 * columns of the row: fetch() and fetch_all() are not available.
+		 * The row must outlive the container, unless the container shares
+		 * the ownership of the rows through row_owner.
+		 *
+		 * \param memory_ctx The memory context the row was allocated with.
+		 * \param row A row returned by QueryRows.
+		 * \param row_owner The owner of the memory holding the row, released
+		 * with the last container referring to it.
+		 */
+		property_container(TALLOC_CTX* memory_ctx, const SRow& row, boost::shared_ptr<void> row_owner = boost::shared_ptr<void>()) :
+		m_memory_ctx(memory_ctx), m_mapi_object(NULL), m_fetched(true), m_property_tag_array(NULL), m_cn_vals(row.cValues), m_property_values(row.lpProps), m_row_owner(row_owner)
 		{
 			m_property_value_array.cValues = 0;
 			m_property_value_array.lpProps = NULL;
@@ -177,7 +198,10 @@ class property_container {
 		 */
 		uint32_t fetch()
 		{
-			if (GetProps(&m_mapi_object, MAPI_UNICODE, m_property_tag_array, &m_property_values, &m_cn_vals) != MAPI_E_SUCCESS)
+			if (!m_mapi_object)
+				throw mapi_exception(MAPI_E_NO_SUPPORT, "property_container::fetch : table row");
+
+			if (GetProps(m_mapi_object, MAPI_UNICODE, m_property_tag_array, &m_property_values, &m_cn_vals) != MAPI_E_SUCCESS)
 				throw mapi_exception(GetLastError(), "property_container::fetch : GetProps");
 
 			MAPIFreeBuffer(m_property_tag_array);
@@ -190,7 +214,10 @@ class property_container {
 		/// \brief Fetches \b ALL properties of the object associated with this container.
 		void fetch_all()
 		{
-			if (GetPropsAll(&m_mapi_object, MAPI_UNICODE, &m_property_value_array) != MAPI_E_SUCCESS)
+			if (!m_mapi_object)
+				throw mapi_exception(MAPI_E_NO_SUPPORT, "property_container::fetch_all : table row");
+
+			if (GetPropsAll(m_mapi_object, MAPI_UNICODE, &m_property_value_array) != MAPI_E_SUCCESS)
 				throw mapi_exception(GetLastError(), "property_container::fetch_all : GetPropsAll");
 
 			// Free property_tag_array in case user used operator<< by mistake.
@@ -279,7 +306,7 @@ class property_container {
 
 	private:
 		TALLOC_CTX*		m_memory_ctx;
-		mapi_object_t&		m_mapi_object;
+		mapi_object_t*		m_mapi_object;
 
 		bool			m_fetched;
 
@@ -292,6 +319,9 @@ class property_container {
 		// Used when calling GetPropsAll (fetch_all)
 		mapi_SPropValue_array	m_property_value_array;
 
+		// Keeps the rows of a table alive
+		boost::shared_ptr<void>	m_row_owner;
+
 		const void* find_SPropValue_value(uint32_t property_tag)
 		{
 			for (uint32_t i = 0; i < m_cn_vals; ++i)
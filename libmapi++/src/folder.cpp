@@ -56,7 +56,8 @@ folder::message_container_type folder::fetch_messages() throw(mapi_exception)
 			try {
 				message_container.push_back(message_shared_ptr(new message(m_session,
 											   m_id,
-											   row_set.aRow[i].lpProps[1].value.d)));
+											   row_set.aRow[i].lpProps[1].value.d,
+											   false)));
 			} catch(mapi_exception e) {
 				mapi_object_release(&contents_table);
 				throw;
@@ -69,6 +70,64 @@ folder::message_container_type folder::fetch_messages() throw(mapi_exception)
 	return message_container;
 }
 
+static void free_rows(void* rows_ctx)
+{
+	talloc_free(rows_ctx);
+}
+
+folder::row_container_type folder::fetch_messages(const std::vector<uint32_t>& columns) throw(mapi_exception)
+{
+	uint32_t 	contents_table_row_count = 0;
+        mapi_object_t	contents_table;
+
+	mapi_object_init(&contents_table);
+	if (GetContentsTable(&m_object, &contents_table, 0, &contents_table_row_count) != MAPI_E_SUCCESS) {
+		mapi_object_release(&contents_table);
+		throw mapi_exception(GetLastError(), "folder::fetch_messages : GetContentsTable");
+	}
+
+	SPropTagArray* property_tag_array = talloc_zero(m_session.get_memory_ctx(), SPropTagArray);
+	property_tag_array->cValues = columns.size();
+	property_tag_array->aulPropTag = talloc_array(property_tag_array, enum MAPITAGS, columns.size());
+	for (unsigned int i = 0; i < columns.size(); ++i) {
+		property_tag_array->aulPropTag[i] = (enum MAPITAGS)columns[i];
+	}
+
+	if (SetColumns(&contents_table, property_tag_array) != MAPI_E_SUCCESS) {
+		MAPIFreeBuffer(property_tag_array);
+		mapi_object_release(&contents_table);
+		throw mapi_exception(GetLastError(), "folder::fetch_messages : SetColumns");
+	}
+
+	MAPIFreeBuffer(property_tag_array);
+
+	uint32_t rows_to_read = contents_table_row_count;
+	SRowSet  row_set;
+
+	row_container_type row_container;
+	row_container.reserve(contents_table_row_count);
+
+	// The rows are freed with the last container referring to them.
+	TALLOC_CTX* rows_ctx = talloc_named(NULL, 0, "folder::fetch_messages");
+	if (!rows_ctx) {
+		mapi_object_release(&contents_table);
+		throw mapi_exception(MAPI_E_NOT_ENOUGH_MEMORY, "folder::fetch_messages : talloc_named");
+	}
+	boost::shared_ptr<void> rows_owner(rows_ctx, free_rows);
+
+	while( (QueryRows(&contents_table, rows_to_read, TBL_ADVANCE, &row_set) == MAPI_E_SUCCESS) && row_set.cRows) {
+		rows_to_read -= row_set.cRows;
+		talloc_steal(rows_ctx, row_set.aRow);
+		for (unsigned int i = 0; i < row_set.cRows; ++i) {
+			row_container.push_back(property_container(rows_ctx, row_set.aRow[i], rows_owner));
+		}
+	}
+
+	mapi_object_release(&contents_table);
+
+	return row_container;
+}
+
 folder::hierarchy_container_type folder::fetch_hierarchy() throw(mapi_exception)
 {
 	mapi_object_t	hierarchy_table;
@@ -114,5 +173,68 @@ folder::hierarchy_container_type folder::fetch_hierarchy() throw(mapi_exception)
 	return hierarchy_container;
 }
 
+message_cursor::message_cursor(folder& parent_folder, const std::vector<uint32_t>& columns, uint32_t page_size) throw(mapi_exception)
+: object(parent_folder.get_session(), "message_cursor"), m_row_count(0), m_page_size(page_size ? page_size : 0x32), m_row(0)
+{
+	m_row_set.cRows = 0;
+	m_row_set.aRow = NULL;
+
+	if (GetContentsTable(&parent_folder.data(), &m_object, 0, &m_row_count) != MAPI_E_SUCCESS)
+		throw mapi_exception(GetLastError(), "message_cursor::message_cursor : GetContentsTable");
+
+	SPropTagArray* property_tag_array = set_SPropTagArray(m_session.get_memory_ctx(), 0x2, PR_FID, PR_MID);
+	for (std::vector<uint32_t>::const_iterator it = columns.begin(); it != columns.end(); ++it) {
+		SPropTagArray_add(m_session.get_memory_ctx(), property_tag_array, (enum MAPITAGS)*it);
+	}
+
+	if (SetColumns(&m_object, property_tag_array) != MAPI_E_SUCCESS) {
+		MAPIFreeBuffer(property_tag_array);
+		throw mapi_exception(GetLastError(), "message_cursor::message_cursor : SetColumns");
+	}
+
+	MAPIFreeBuffer(property_tag_array);
+}
+
+bool message_cursor::next() throw(mapi_exception)
+{
+	if (m_row + 1 < m_row_set.cRows) {
+		++m_row;
+		return true;
+	}
+
+	if (m_row_set.aRow) {
+		MAPIFreeBuffer(m_row_set.aRow);
+		m_row_set.aRow = NULL;
+	}
+	m_row_set.cRows = 0;
+	m_row = 0;
+
+	if (QueryRows(&m_object, m_page_size, TBL_ADVANCE, &m_row_set) != MAPI_E_SUCCESS) {
+		m_row_set.cRows = 0;
+		m_row_set.aRow = NULL;
+		throw mapi_exception(GetLastError(), "message_cursor::next : QueryRows");
+	}
+
+	return m_row_set.cRows != 0;
+}
+
+property_container message_cursor::get_row() throw(mapi_exception)
+{
+	if (m_row >= m_row_set.cRows)
+		throw mapi_exception(MAPI_E_NOT_FOUND, "message_cursor::get_row : no current row");
+
+	return property_container(m_session.get_memory_ctx(), m_row_set.aRow[m_row]);
+}
+
+folder::message_shared_ptr message_cursor::get_message() throw(mapi_exception)
+{
+	if (m_row >= m_row_set.cRows)
+		throw mapi_exception(MAPI_E_NOT_FOUND, "message_cursor::get_message : no current row");
+
+	SRow& row = m_row_set.aRow[m_row];
+
+	return folder::message_shared_ptr(new message(m_session, row.lpProps[0].value.d, row.lpProps[1].value.d, false));
+}
+
 } // namespace libmapipp
 
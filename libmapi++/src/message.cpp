@@ -19,13 +19,21 @@
 */
 
 #include <libmapi++/attachment.h>
+#include <libmapi++/property_container.h>
 
 namespace libmapipp {
 
+property_container message::get_property_container()
+{
+	open();
+	return object::get_property_container();
+}
+
 message::attachment_container_type message::fetch_attachments()
 {
 	mapi_object_t   attachment_table;
 
+	open();
 	mapi_object_init(&attachment_table);
 	if (GetAttachmentTable(&m_object, &attachment_table) != MAPI_E_SUCCESS) {
 		mapi_object_release(&attachment_table);
@@ -163,6 +163,107 @@ _PUBLIC_ enum MAPISTATUS Release(mapi_object_t *obj)
 }
 
 
+/**
+   \details Queue the release of an object for the next request sent
+   to the server
+
+   The Release ROP is sent ahead of the ROPs of the next request. When
+   the queue is full, the queued releases are sent first.
+
+   \param obj the object to release
+
+   \return MAPI_E_SUCCESS if the release was queued, MAPI_E_NO_SUPPORT
+   if releases are not deferred on the session, otherwise MAPI error
+
+   \sa emsmdb_set_deferred_release, FlushReleases
+*/
+enum MAPISTATUS ReleaseDeferred(mapi_object_t *obj)
+{
+	struct mapi_session	*session;
+	struct emsmdb_context	*emsmdb_ctx;
+	enum MAPISTATUS		retval;
+	uint8_t 		logon_id = 0;
+
+	/* Sanity checks */
+	session = mapi_object_get_session(obj);
+	OPENCHANGE_RETVAL_IF(!session || !session->emsmdb || !session->emsmdb->ctx, MAPI_E_INVALID_PARAMETER, NULL);
+
+	emsmdb_ctx = (struct emsmdb_context *)session->emsmdb->ctx;
+	OPENCHANGE_RETVAL_IF(!emsmdb_ctx->defer_release || !emsmdb_ctx->releases, MAPI_E_NO_SUPPORT, NULL);
+
+	if ((retval = mapi_object_get_logon_id(obj, &logon_id)) != MAPI_E_SUCCESS)
+		return retval;
+
+	if (emsmdb_ctx->release_count == EMSMDB_DEFERRED_RELEASE_MAX) {
+		retval = FlushReleases(session);
+		OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+	}
+
+	emsmdb_ctx->releases[emsmdb_ctx->release_count].handle = mapi_object_get_handle(obj);
+	emsmdb_ctx->releases[emsmdb_ctx->release_count].logon_id = logon_id;
+	emsmdb_ctx->release_count++;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Send the releases deferred on a session
+
+   Releases are otherwise sent along with the next request. This
+   function sends them in a request of their own, for instance before
+   the session goes idle.
+
+   \param session pointer to the MAPI session
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \note Developers may also call GetLastError() to retrieve the last
+   MAPI error code. Possible MAPI error codes are:
+   - MAPI_E_INVALID_PARAMETER: session is not valid
+   - MAPI_E_CALL_FAILED: A network problem was encountered during the
+     transaction
+
+   \sa emsmdb_set_deferred_release, GetLastError
+*/
+_PUBLIC_ enum MAPISTATUS FlushReleases(struct mapi_session *session)
+{
+	struct mapi_request	*mapi_request;
+	struct mapi_response	*mapi_response;
+	struct emsmdb_context	*emsmdb_ctx;
+	NTSTATUS		status;
+	TALLOC_CTX		*mem_ctx;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!session || !session->emsmdb || !session->emsmdb->ctx, MAPI_E_INVALID_PARAMETER, NULL);
+
+	emsmdb_ctx = (struct emsmdb_context *)session->emsmdb->ctx;
+	if (!emsmdb_ctx->release_count) {
+		return MAPI_E_SUCCESS;
+	}
+
+	mem_ctx = talloc_named(session, 0, "FlushReleases");
+
+	/* An empty request: the transaction prepends the queued releases */
+	mapi_request = talloc_zero(mem_ctx, struct mapi_request);
+	mapi_request->mapi_len = 2;
+	mapi_request->length = 2;
+
+	status = emsmdb_transaction_wrapper(session, mem_ctx, mapi_request, &mapi_response);
+	OPENCHANGE_RETVAL_IF(!NT_STATUS_IS_OK(status), MAPI_E_CALL_FAILED, mem_ctx);
+
+	if (mapi_response->mapi_repl) {
+		OPENCHANGE_CHECK_NOTIFICATION(session, mapi_response);
+	}
+
+	talloc_free(mapi_response);
+	talloc_free(mem_ctx);
+
+	errno = 0;
+	return MAPI_E_SUCCESS;
+}
+
+
 /**
    \details Returns the latest error code.
 
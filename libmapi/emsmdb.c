@@ -102,7 +102,7 @@ struct emsmdb_context *emsmdb_connect(TALLOC_CTX *parent_mem_ctx,
 	ret->rpc_connection = p;
 	ret->mem_ctx = parent_mem_ctx;
 
-	ret->cache_requests = talloc(parent_mem_ctx, struct EcDoRpc_MAPI_REQ *);
+	ret->compress_threshold = MAPI_COMPRESS_THRESHOLD;
 	ret->info.szDisplayName = NULL;
 	ret->info.szDNPrefix = NULL;
 
@@ -194,6 +194,7 @@ struct emsmdb_context *emsmdb_connect_ex(TALLOC_CTX *mem_ctx,
 	ctx = talloc_zero(mem_ctx, struct emsmdb_context);
 	ctx->rpc_connection = p;
 	ctx->mem_ctx = mem_ctx;
+	ctx->compress_threshold = MAPI_COMPRESS_THRESHOLD;
 
 	ctx->info.szDisplayName = NULL;
 	ctx->info.szDNPrefix = NULL;
@@ -277,8 +278,6 @@ int emsmdb_disconnect_dtor(void *data)
 
 	emsmdb_disconnect(emsmdb_ctx);	
 
-	talloc_free(emsmdb_ctx->cache_requests);
-
 	if (emsmdb_ctx->info.szDisplayName) {
 		talloc_free(emsmdb_ctx->info.szDisplayName);
 	}
@@ -368,6 +367,122 @@ _PUBLIC_ NTSTATUS emsmdb_transaction_null(struct emsmdb_context *emsmdb_ctx,
 }
 
 
+/**
+   \details Count the ROPs of a MAPI request
+
+   \param req pointer to the MAPI request
+
+   \return the number of ROPs before the terminating entry, if any
+ */
+static uint32_t emsmdb_request_count(struct mapi_request *req)
+{
+	uint32_t	count;
+	uint32_t	i;
+
+	if (!req->mapi_req) return 0;
+
+	count = talloc_array_length(req->mapi_req);
+	for (i = 0; i < count && req->mapi_req[i].opnum; i++);
+
+	return i;
+}
+
+
+/**
+   \details Prepend the Release ROPs deferred on the EMSMDB context to
+   a MAPI request
+
+   Releases are placed before the ROPs of the request, so objects are
+   released in the order the application released them. Their handles
+   are appended to the handle table, leaving the handle indexes used
+   by the request ROPs untouched. Release has no reply, so the replies
+   are left untouched too. Releases that would overflow the handle
+   table or the request buffer wait for the next request.
+
+   The releases stay queued until emsmdb_commit_releases() is called
+   once the request was delivered.
+
+   \param emsmdb_ctx pointer to the EMSMDB connection context
+   \param mem_ctx pointer to the memory context
+   \param req pointer to the MAPI request to send
+
+   \return the number of releases prepended to the request
+ */
+static uint32_t emsmdb_prepend_releases(struct emsmdb_context *emsmdb_ctx,
+					TALLOC_CTX *mem_ctx,
+					struct mapi_request *req)
+{
+	struct EcDoRpc_MAPI_REQ	*mapi_req;
+	uint32_t		*handles;
+	uint32_t		count;
+	uint32_t		handle_count;
+	uint32_t		release_count;
+	uint32_t		i;
+
+	if (!emsmdb_ctx->release_count) return 0;
+
+	count = emsmdb_request_count(req);
+	handle_count = (req->mapi_len - req->length) / sizeof (uint32_t);
+
+	/* Handle indexes are 8 bits and a Release costs 3 bytes plus its handle */
+	release_count = emsmdb_ctx->release_count;
+	if (handle_count + release_count > 0xFF) {
+		release_count = (handle_count < 0xFF) ? 0xFF - handle_count : 0;
+	}
+	if (req->mapi_len + release_count * (3 + sizeof (uint32_t)) > MAPI_EXTENDED_BUFFER_MAX_SIZE) {
+		release_count = (req->mapi_len < MAPI_EXTENDED_BUFFER_MAX_SIZE) ?
+			(MAPI_EXTENDED_BUFFER_MAX_SIZE - req->mapi_len) / (3 + sizeof (uint32_t)) : 0;
+	}
+	if (!release_count) return 0;
+
+	mapi_req = talloc_zero_array(mem_ctx, struct EcDoRpc_MAPI_REQ, release_count + count + 1);
+	handles = talloc_array(mem_ctx, uint32_t, handle_count + release_count);
+	if (!mapi_req || !handles) {
+		talloc_free(mapi_req);
+		talloc_free(handles);
+		return 0;
+	}
+
+	for (i = 0; i < release_count; i++) {
+		mapi_req[i].opnum = op_MAPI_Release;
+		mapi_req[i].logon_id = emsmdb_ctx->releases[i].logon_id;
+		mapi_req[i].handle_idx = handle_count + i;
+		handles[handle_count + i] = emsmdb_ctx->releases[i].handle;
+	}
+	if (count) {
+		memcpy(mapi_req + release_count, req->mapi_req, count * sizeof (struct EcDoRpc_MAPI_REQ));
+	}
+	if (handle_count) {
+		memcpy(handles, req->handles, handle_count * sizeof (uint32_t));
+	}
+
+	req->mapi_req = mapi_req;
+	req->handles = handles;
+	req->length += release_count * 3;
+	req->mapi_len += release_count * (3 + sizeof (uint32_t));
+
+	return release_count;
+}
+
+
+/**
+   \details Remove the releases sent with a successful request from the
+   queue of the EMSMDB context
+
+   \param emsmdb_ctx pointer to the EMSMDB connection context
+   \param release_count the number of releases prepended to the request
+ */
+static void emsmdb_commit_releases(struct emsmdb_context *emsmdb_ctx,
+				   uint32_t release_count)
+{
+	if (!release_count) return;
+
+	emsmdb_ctx->release_count -= release_count;
+	memmove(emsmdb_ctx->releases, emsmdb_ctx->releases + release_count,
+		emsmdb_ctx->release_count * sizeof (struct emsmdb_release));
+}
+
+
 static int mapi_response_destructor(void *data)
 {
 	struct mapi_response	*mapi_response = (struct mapi_response *)data;
@@ -408,8 +523,15 @@ _PUBLIC_ NTSTATUS emsmdb_transaction(struct emsmdb_context *emsmdb_ctx,
 	struct mapi_response	*mapi_response;
 	uint16_t		*length;
 	NTSTATUS		status;
-	struct EcDoRpc_MAPI_REQ	*multi_req;
-	uint8_t			i = 0;
+	uint32_t		count;
+	uint32_t		release_count;
+
+	/* Release ROPs deferred by the application go first */
+	release_count = emsmdb_prepend_releases(emsmdb_ctx, mem_ctx, req);
+
+	count = emsmdb_request_count(req);
+	req->mapi_req = talloc_realloc(mem_ctx, req->mapi_req, struct EcDoRpc_MAPI_REQ, count + 1);
+	req->mapi_req[count].opnum = 0;
 
 start:
 	r.in.handle = r.out.handle = &emsmdb_ctx->handle;
@@ -422,28 +544,14 @@ start:
 	talloc_set_destructor((void *)mapi_response, (int (*)(void *))mapi_response_destructor);
 	r.out.mapi_response = mapi_response;
 
-	/* process cached data */
-	if (emsmdb_ctx->cache_count) {
-		multi_req = talloc_array(mem_ctx, struct EcDoRpc_MAPI_REQ, emsmdb_ctx->cache_count + 2);
-		for (i = 0; i < emsmdb_ctx->cache_count; i++) {
-			multi_req[i] = *emsmdb_ctx->cache_requests[i];
-		}
-		multi_req[i] = req->mapi_req[0];
-		req->mapi_req = multi_req;
-	}
-
-	req->mapi_req = talloc_realloc(mem_ctx, req->mapi_req, struct EcDoRpc_MAPI_REQ, emsmdb_ctx->cache_count + 2);
-	req->mapi_req[i+1].opnum = 0;
-
 	r.in.mapi_request = req;
-	r.in.mapi_request->mapi_len += emsmdb_ctx->cache_size;
-	r.in.mapi_request->length += emsmdb_ctx->cache_size;
 	length = talloc_zero(mem_ctx, uint16_t);
 	*length = r.in.mapi_request->mapi_len;
 	r.in.length = r.out.length = length;
 	r.in.max_data = (*length >= 0x4000) ? 0x7FFF : emsmdb_ctx->max_data;
 
 	status = dcerpc_EcDoRpc_r(emsmdb_ctx->rpc_connection->binding_handle, mem_ctx, &r);
+	emsmdb_ctx->info.transactions++;
 	if (!NT_STATUS_IS_OK(status)) {
 		if (emsmdb_ctx->setup == false) {
 			errno = 0;
@@ -458,7 +566,7 @@ start:
 	} else {
 		emsmdb_ctx->setup = true;
 	}
-	emsmdb_ctx->cache_size = emsmdb_ctx->cache_count = 0;
+	emsmdb_commit_releases(emsmdb_ctx, release_count);
 
 	if (r.out.mapi_response->mapi_repl && r.out.mapi_response->mapi_repl->error_code) {
 		talloc_set_destructor((void *)mapi_response, NULL);
@@ -488,70 +596,47 @@ _PUBLIC_ NTSTATUS emsmdb_transaction_ext2(struct emsmdb_context *emsmdb_ctx,
 					  struct mapi_response **repl)
 {
 	NTSTATUS		status;
+	enum ndr_err_code	ndr_err;
 	struct EcDoRpcExt2	r;
 	struct mapi2k7_response	mapi2k7_response;
 	struct ndr_push		*ndr_uncomp_rgbIn;
-	struct ndr_push		*ndr_comp_rgbIn;
 	struct ndr_push		*ndr_rgbIn;
 	struct ndr_pull		*ndr_pull = NULL;
 	uint32_t		pulFlags = 0x0;
-	uint32_t		pcbOut = 0x8007;
+	uint32_t		pcbOut = 0x40000; /* room for chained extended buffers */
 	uint32_t		pcbAuxOut = 0x1008;
 	uint32_t		pulTransTime = 0;
+	uint16_t		flags;
+	uint32_t		release_count;
 	DATA_BLOB		rgbOut;
-	struct RPC_HEADER_EXT	RPC_HEADER_EXT;
 
 	r.in.handle = r.out.handle = &emsmdb_ctx->handle;
 	r.in.pulFlags = r.out.pulFlags = &pulFlags;
 
-	/* Step 1. Push mapi_request in a data blob */
+	/* Step 1. Push mapi_request in a data blob, Release ROPs deferred
+	 * by the application first */
+	release_count = emsmdb_prepend_releases(emsmdb_ctx, mem_ctx, req);
+
 	ndr_uncomp_rgbIn = ndr_push_init_ctx(mem_ctx);
 	ndr_set_flags(&ndr_uncomp_rgbIn->flags, LIBNDR_FLAG_NOALIGN);
 	ndr_push_mapi_request(ndr_uncomp_rgbIn, NDR_SCALARS|NDR_BUFFERS, req);
 
-	/* Step 2. Compress the blob */
-	/* 	ndr_comp_rgbIn = ndr_push_init_ctx(mem_ctx); */
-	/* 	ndr_push_lzxpress_compress(ndr_comp_rgbIn, ndr_uncomp_rgbIn); */
-
-	/* If the compressed blob is larger than the uncompressed one, use obfuscation */
-	/* 	if (ndr_comp_rgbIn->offset > ndr_uncomp_rgbIn->offset) { */
-	/* 		talloc_free(ndr_comp_rgbIn); */
-	ndr_comp_rgbIn = ndr_uncomp_rgbIn;
-	obfuscate_data(ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset, 0xA5);
-		
-	RPC_HEADER_EXT.Version = 0x0000;
-	RPC_HEADER_EXT.Flags = RHEF_XorMagic|RHEF_Last;
-	RPC_HEADER_EXT.Size = ndr_comp_rgbIn->offset;
-	RPC_HEADER_EXT.SizeActual = ndr_comp_rgbIn->offset;
+	/* Step 2. Compress the blob if enabled, fall back on obfuscation
+	 * when it is too small, too large or does not shrink */
+	flags = RHEF_XorMagic|RHEF_Last;
+	if (emsmdb_ctx->compress) {
+		flags |= RHEF_Compressed;
+	}
 
 	ndr_rgbIn = ndr_push_init_ctx(mem_ctx);
 	ndr_set_flags(&ndr_rgbIn->flags, LIBNDR_FLAG_NOALIGN);
-	ndr_push_RPC_HEADER_EXT(ndr_rgbIn, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT);
-	ndr_push_bytes(ndr_rgbIn, ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset);
-		/* 	} else { */
-		/* 		RPC_HEADER_EXT.Version = 0x0000; */
-		/* 		RPC_HEADER_EXT.Flags = RHEF_Compressed|RHEF_Last; */
-		/* 		RPC_HEADER_EXT.Size = ndr_comp_rgbIn->offset; */
-		/* 		RPC_HEADER_EXT.SizeActual = ndr_uncomp_rgbIn->offset; */
-
-		/* 		ndr_rgbIn = ndr_push_init_ctx(mem_ctx); */
-		/* 		ndr_set_flags(&ndr_rgbIn->flags, LIBNDR_FLAG_NOALIGN); */
-		/* 		ndr_push_RPC_HEADER_EXT(ndr_rgbIn, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT); */
-		/* 		ndr_push_bytes(ndr_rgbIn, ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset); */
-		/* 	} */
-
-		/* Plain request (no obfuscation or compression) */
-		/* ndr_comp_rgbIn = ndr_uncomp_rgbIn; */
-		/* RPC_HEADER_EXT.Version = 0x0000; */
-		/* RPC_HEADER_EXT.Flags = RHEF_Last; */
-		/* RPC_HEADER_EXT.Size = ndr_uncomp_rgbIn->offset; */
-		/* RPC_HEADER_EXT.SizeActual = ndr_uncomp_rgbIn->offset; */
-
-		/* Pull the complete rgbIn */
-		/* ndr_rgbIn = ndr_push_init_ctx(mem_ctx); */
-		/* ndr_set_flags(&ndr_rgbIn->flags, LIBNDR_FLAG_NOALIGN); */
-		/* ndr_push_RPC_HEADER_EXT(ndr_rgbIn, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT); */
-		/* ndr_push_bytes(ndr_rgbIn, ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset); */
+	ndr_err = ndr_push_mapi_extended_buffer(ndr_rgbIn, ndr_uncomp_rgbIn->data, ndr_uncomp_rgbIn->offset, flags,
+						emsmdb_ctx->compress_threshold, &emsmdb_ctx->info.request_compression);
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+		talloc_free(ndr_rgbIn);
+		talloc_free(ndr_uncomp_rgbIn);
+		return NT_STATUS_NO_MEMORY;
+	}
 
 	r.in.rgbIn = ndr_rgbIn->data;
 	r.in.cbIn = ndr_rgbIn->offset;
@@ -565,14 +650,16 @@ _PUBLIC_ NTSTATUS emsmdb_transaction_ext2(struct emsmdb_context *emsmdb_ctx,
 	r.out.pulTransTime = &pulTransTime;
 
 	status = dcerpc_EcDoRpcExt2_r(emsmdb_ctx->rpc_connection->binding_handle, mem_ctx, &r);
+	emsmdb_ctx->info.transactions++;
 	talloc_free(ndr_rgbIn);
-	talloc_free(ndr_comp_rgbIn);
-		
+	talloc_free(ndr_uncomp_rgbIn);
+
 	if (!NT_STATUS_IS_OK(status)) {
 		return status;
 	} else if (r.out.result) {
 		return NT_STATUS_UNSUCCESSFUL;
 	}
+	emsmdb_commit_releases(emsmdb_ctx, release_count);
 
 	/* Pull MAPI response form rgbOut */
 	rgbOut.data = r.out.rgbOut;
@@ -751,6 +838,70 @@ _PUBLIC_ struct emsmdb_info *emsmdb_get_info(struct mapi_session *session)
 }
 
 
+/**
+   \details Enable or disable the compression of EcDoRpcExt2
+   requests for a session
+
+   Requests are LZ77 compressed when they are at least threshold
+   bytes long, fit in a single extended buffer and actually shrink;
+   otherwise they are sent obfuscated. The outcome is accounted in
+   the request_compression counters returned by emsmdb_get_info().
+
+   \param session pointer to the MAPI session
+   \param status whether requests are compressed or not
+   \param threshold the minimum request size worth compressing, 0
+   for the default
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsmdb_set_compression(struct mapi_session *session, bool status, uint32_t threshold)
+{
+	struct emsmdb_context	*emsmdb_ctx;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!session || !session->emsmdb || !session->emsmdb->ctx, MAPI_E_NOT_INITIALIZED, NULL);
+
+	emsmdb_ctx = (struct emsmdb_context *)session->emsmdb->ctx;
+	emsmdb_ctx->compress = status;
+	emsmdb_ctx->compress_threshold = threshold ? threshold : MAPI_COMPRESS_THRESHOLD;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Enable or disable deferred releases for a session
+
+   When enabled, mapi_object_release() does not send a Release ROP of
+   its own: the release is queued and sent ahead of the ROPs of the
+   next request. Releases already queued are sent with the next
+   request even after deferral is disabled.
+
+   \param session pointer to the MAPI session
+   \param status whether releases are deferred or not
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+
+   \sa FlushReleases
+ */
+_PUBLIC_ enum MAPISTATUS emsmdb_set_deferred_release(struct mapi_session *session, bool status)
+{
+	struct emsmdb_context	*emsmdb_ctx;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!session || !session->emsmdb || !session->emsmdb->ctx, MAPI_E_NOT_INITIALIZED, NULL);
+
+	emsmdb_ctx = (struct emsmdb_context *)session->emsmdb->ctx;
+	if (status && !emsmdb_ctx->releases) {
+		emsmdb_ctx->releases = talloc_array(emsmdb_ctx, struct emsmdb_release, EMSMDB_DEFERRED_RELEASE_MAX);
+		OPENCHANGE_RETVAL_IF(!emsmdb_ctx->releases, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	}
+	emsmdb_ctx->defer_release = status;
+
+	return MAPI_E_SUCCESS;
+}
+
+
 /**
    \details Free property values retrieved with pull_emsmdb_property
 
@@ -21,6 +21,20 @@
 #ifndef __EMSMDB_H__
 #define	__EMSMDB_H__
 
+/* Maximum uncompressed payload of an RPC_HEADER_EXT extended buffer */
+#define	MAPI_EXTENDED_BUFFER_MAX_SIZE	0x8000
+
+/* Default minimum size of a request payload worth compressing */
+#define	MAPI_COMPRESS_THRESHOLD		1024
+
+struct mapi_compression_stats {
+	uint64_t		buffers;		///< Extended buffers pushed
+	uint64_t		compressed_buffers;	///< Extended buffers sent compressed
+	uint64_t		bytes_in;		///< Payload bytes before compression
+	uint64_t		bytes_out;		///< Payload bytes after compression
+	uint64_t		usec;			///< CPU time spent compressing, in microseconds
+};
+
 struct emsmdb_info {
 	char			*szDisplayName;
 	char			*szDNPrefix;
@@ -29,6 +43,16 @@ struct emsmdb_info {
 	uint32_t		pcmsRetryDelay;
 	uint32_t		picxr;
 	uint16_t		rgwServerVersion[3];
+	struct mapi_compression_stats	request_compression; ///< Counters of the EcDoRpcExt2 requests sent
+	uint64_t		transactions;	///< EcDoRpc or EcDoRpcExt2 round-trips
+};
+
+/* Maximum number of Release ROPs waiting for the next request */
+#define	EMSMDB_DEFERRED_RELEASE_MAX	64
+
+struct emsmdb_release {
+	uint32_t		handle;
+	uint8_t			logon_id;
 };
 
 struct emsmdb_context {
@@ -37,13 +61,15 @@ struct emsmdb_context {
 	struct nspi_context    	*nspi;
 	struct cli_credentials	*cred;
 	TALLOC_CTX	       	*mem_ctx;
-	struct EcDoRpc_MAPI_REQ	**cache_requests;
-	uint32_t	       	cache_size;
-	uint8_t			cache_count;
+	struct emsmdb_release	*releases;	///< Release ROPs deferred to the next request
+	uint32_t		release_count;
+	bool			defer_release;
 	uint16_t	       	prop_count;
 	enum MAPITAGS	       	*properties;
 	uint16_t     	       	max_data;
 	bool		       	setup;
+	bool			compress;	///< Whether EcDoRpcExt2 requests are compressed
+	uint32_t		compress_threshold;
 	struct emsmdb_info	info;
 	struct policy_handle	async_handle; ///< The handle to use for Async notification requests
 	struct dcerpc_pipe	*async_rpc_connection;
@@ -21,6 +21,11 @@
 #include "libmapi/libmapi_private.h"
 #include "libmapi/fxparser.h"
 
+/* the initial size of the buffer keeping incomplete elements */
+#define	FXPARSER_BUFFER_STEP	4096
+/* above this size, the buffer is released once emptied */
+#define	FXPARSER_BUFFER_KEEP	(1024 * 1024)
+
 #ifdef ENABLE_ASSERTS
 #include <assert.h>
 #define OC_ASSERT(x) assert(x)
@@ -82,12 +87,11 @@ static bool pull_tag(struct fx_parser_context *parser)
 
 static bool pull_uint8_data(struct fx_parser_context *parser, uint32_t read_len, uint8_t **data_read)
 {
-	uint32_t i;
-	for (i = 0; i < read_len; i++) {
-		if (!pull_uint8_t(parser, (uint8_t*)&((*data_read)[i]))) {
-			return false;
-		}
+	if ((parser->idx) + read_len > parser->data.length) {
+		return false;
 	}
+	memcpy(*data_read, parser->data.data + parser->idx, read_len);
+	parser->idx += read_len;
 	return true;
 }
 
@@ -184,7 +188,7 @@ static bool pull_clsid(struct fx_parser_context *parser, struct FlatUID_r **pcls
 	if (parser->idx + 16 > parser->data.length)
 		return false;
 
-	clsid = talloc_zero(parser->mem_ctx, struct FlatUID_r);
+	clsid = talloc_zero(parser->value_ctx, struct FlatUID_r);
 	for (i = 0; i < 16; ++i) {
 		if (!pull_uint8_t(parser, &(clsid->ab[i])))
 			return false;
@@ -198,17 +202,15 @@ static bool pull_clsid(struct fx_parser_context *parser, struct FlatUID_r **pcls
 static bool pull_string8(struct fx_parser_context *parser, char **pstr)
 {
 	char *str;
-	uint32_t i, length;
+	uint32_t length;
 
 	if (!pull_uint32_t(parser, &length) ||
 	    parser->idx + length > parser->data.length)
 		return false;
 
-	str = talloc_array(parser->mem_ctx, char, length + 1);
-	for (i = 0; i < length; i++) {
-		if (!pull_uint8_t(parser, (uint8_t*)&(str[i]))) {
-			return false;
-		}
+	str = talloc_array(parser->value_ctx, char, length + 1);
+	if (!pull_uint8_data(parser, length, (uint8_t **)&str)) {
+		return false;
 	}
 	str[length] = '\0';
 
@@ -224,7 +226,7 @@ static bool fetch_ucs2_data(struct fx_parser_context *parser, uint32_t numbytes,
 		return false;
 	}
 
-	*data_read = talloc_zero_array(parser->mem_ctx, smb_ucs2_t, (numbytes/2) + 1);
+	*data_read = talloc_zero_array(parser->value_ctx, smb_ucs2_t, (numbytes/2) + 1);
 	memcpy(*data_read, &(parser->data.data[parser->idx]), numbytes);
 	parser->idx += numbytes;
 	return true;
@@ -234,7 +236,7 @@ static bool fetch_ucs2_nullterminated(struct fx_parser_context *parser, smb_ucs2
 {
 	uint32_t idx_local = parser->idx;
 	bool found = false;
-	while (idx_local < parser->data.length -1) {
+	while (idx_local + 1 < parser->data.length) {
 		smb_ucs2_t val = 0x0000;
 		val += parser->data.data[idx_local];
 		idx_local++;
@@ -261,12 +263,11 @@ static bool pull_unicode(struct fx_parser_context *parser, char **pstr)
 	    parser->idx + length > parser->data.length)
 		return false;
 
-	ucs2_data = talloc_zero_array(parser->mem_ctx, smb_ucs2_t, (length/2) + 1);
-
 	if (!fetch_ucs2_data(parser, length, &ucs2_data)) {
 		return false;
 	}
-	pull_ucs2_talloc(parser->mem_ctx, &utf8_data, ucs2_data, &utf8_len);
+	pull_ucs2_talloc(parser->value_ctx, &utf8_data, ucs2_data, &utf8_len);
+	talloc_free(ucs2_data);
 
 	*pstr = utf8_data;
 
@@ -279,7 +280,14 @@ static bool pull_binary(struct fx_parser_context *parser, struct Binary_r *bin)
 	    parser->idx + bin->cb > parser->data.length)
 		return false;
 
-	bin->lpb = talloc_array(parser->mem_ctx, uint8_t, bin->cb + 1);
+	/* when streaming, the value is a view into the parsed data */
+	if (parser->op_chunk) {
+		bin->lpb = parser->data.data + parser->idx;
+		parser->idx += bin->cb;
+		return true;
+	}
+
+	bin->lpb = talloc_array(parser->value_ctx, uint8_t, bin->cb + 1);
 
 	return pull_uint8_data(parser, bin->cb, &(bin->lpb));
 }
@@ -389,7 +397,7 @@ static bool fetch_property_value(struct fx_parser_context *parser, DATA_BLOB *bu
 		if (!pull_uint32_t(parser, &(prop->value.MVbin.cValues)) ||
 		    parser->idx + prop->value.MVbin.cValues * 4 > parser->data.length)
 			return false;
-		prop->value.MVbin.lpbin = talloc_array(parser->mem_ctx, struct Binary_r, prop->value.MVbin.cValues);
+		prop->value.MVbin.lpbin = talloc_array(parser->value_ctx, struct Binary_r, prop->value.MVbin.cValues);
 		for (i = 0; i < prop->value.MVbin.cValues; i++) {
 			if (!pull_binary(parser, &(prop->value.MVbin.lpbin[i])))
 				return false;
@@ -402,7 +410,7 @@ static bool fetch_property_value(struct fx_parser_context *parser, DATA_BLOB *bu
 		if (!pull_uint32_t(parser, &(prop->value.MVi.cValues)) ||
 		    parser->idx + prop->value.MVi.cValues * 2 > parser->data.length)
 			return false;
-		prop->value.MVi.lpi = talloc_array(parser->mem_ctx, uint16_t, prop->value.MVi.cValues);
+		prop->value.MVi.lpi = talloc_array(parser->value_ctx, uint16_t, prop->value.MVi.cValues);
 		for (i = 0; i < prop->value.MVi.cValues; i++) {
 			if (!pull_uint16_t(parser, &(prop->value.MVi.lpi[i])))
 				return false;
@@ -415,7 +423,7 @@ static bool fetch_property_value(struct fx_parser_context *parser, DATA_BLOB *bu
 		if (!pull_uint32_t(parser, &(prop->value.MVl.cValues)) ||
 		    parser->idx + prop->value.MVl.cValues * 4 > parser->data.length)
 			return false;
-		prop->value.MVl.lpl = talloc_array(parser->mem_ctx, uint32_t, prop->value.MVl.cValues);
+		prop->value.MVl.lpl = talloc_array(parser->value_ctx, uint32_t, prop->value.MVl.cValues);
 		for (i = 0; i < prop->value.MVl.cValues; i++) {
 			if (!pull_uint32_t(parser, &(prop->value.MVl.lpl[i])))
 				return false;
@@ -429,7 +437,7 @@ static bool fetch_property_value(struct fx_parser_context *parser, DATA_BLOB *bu
 		if (!pull_uint32_t(parser, &(prop->value.MVszA.cValues)) ||
 		    parser->idx + prop->value.MVszA.cValues * 4 > parser->data.length)
 			return false;
-		prop->value.MVszA.lppszA = (const char **) talloc_array(parser->mem_ctx, char *, prop->value.MVszA.cValues);
+		prop->value.MVszA.lppszA = (const char **) talloc_array(parser->value_ctx, char *, prop->value.MVszA.cValues);
 		for (i = 0; i < prop->value.MVszA.cValues; i++) {
 			str = NULL;
 			if (!pull_string8(parser, &str))
@@ -444,7 +452,7 @@ static bool fetch_property_value(struct fx_parser_context *parser, DATA_BLOB *bu
 		if (!pull_uint32_t(parser, &(prop->value.MVguid.cValues)) ||
 		    parser->idx + prop->value.MVguid.cValues * 16 > parser->data.length)
 			return false;
-		prop->value.MVguid.lpguid = talloc_array(parser->mem_ctx, struct FlatUID_r *, prop->value.MVguid.cValues);
+		prop->value.MVguid.lpguid = talloc_array(parser->value_ctx, struct FlatUID_r *, prop->value.MVguid.cValues);
 		for (i = 0; i < prop->value.MVguid.cValues; i++) {
 			if (!pull_clsid(parser, &(prop->value.MVguid.lpguid[i])))
 				return false;
@@ -459,7 +467,7 @@ static bool fetch_property_value(struct fx_parser_context *parser, DATA_BLOB *bu
 		if (!pull_uint32_t(parser, &(prop->value.MVszW.cValues)) ||
 		    parser->idx + prop->value.MVszW.cValues * 4 > parser->data.length)
 			return false;
-		prop->value.MVszW.lppszW = (const char **)  talloc_array(parser->mem_ctx, char *, prop->value.MVszW.cValues);
+		prop->value.MVszW.lppszW = (const char **)  talloc_array(parser->value_ctx, char *, prop->value.MVszW.cValues);
 		for (i = 0; i < prop->value.MVszW.cValues; i++) {
 			str = NULL;
 			if (!pull_unicode(parser, &str))
@@ -474,7 +482,7 @@ static bool fetch_property_value(struct fx_parser_context *parser, DATA_BLOB *bu
 		if (!pull_uint32_t(parser, &(prop->value.MVft.cValues)) ||
 		    parser->idx + prop->value.MVft.cValues * 8 > parser->data.length)
 			return false;
-		prop->value.MVft.lpft = talloc_array(parser->mem_ctx, struct FILETIME, prop->value.MVft.cValues);
+		prop->value.MVft.lpft = talloc_array(parser->value_ctx, struct FILETIME, prop->value.MVft.cValues);
 		for (i = 0; i < prop->value.MVft.cValues; i++) {
 			if (!pull_systime(parser, &(prop->value.MVft.lpft[i])))
 				return false;
@@ -507,7 +515,8 @@ static bool pull_named_property(struct fx_parser_context *parser, enum MAPISTATU
 		parser->namedprop.ulKind = MNID_STRING;
 		if (!fetch_ucs2_nullterminated(parser, &ucs2_data))
 			return false;
-		pull_ucs2_talloc(parser->mem_ctx, (char**)&(parser->namedprop.kind.lpwstr.Name), ucs2_data, &(utf8_len));
+		pull_ucs2_talloc(parser->value_ctx, (char**)&(parser->namedprop.kind.lpwstr.Name), ucs2_data, &(utf8_len));
+		talloc_free(ucs2_data);
 		parser->namedprop.kind.lpwstr.NameSize = utf8_len;
 		/* printf("named: %s\n", parser->namedprop.kind.lpwstr.Name); */
 	} else {
@@ -553,6 +562,32 @@ _PUBLIC_ void fxparser_set_property_callback(struct fx_parser_context *parser, f
 	parser->op_property = property_callback;
 }
 
+/**
+  \details set a callback function for streamed property values
+
+  Once set, the parser works in streaming mode: binary and string
+  values of at least threshold bytes are not accumulated but handed to
+  chunk_callback piece by piece, as they arrive, along with the offset
+  of the piece and the total size of the value. Strings are passed as
+  they are on the wire: 8-bit or UTF-16LE. Other values are passed to
+  the property callback, where binary values point into the parser
+  data. All values are only valid for the duration of the callback.
+*/
+_PUBLIC_ void fxparser_set_chunk_callback(struct fx_parser_context *parser, fxparser_chunk_callback_t chunk_callback, uint32_t threshold)
+{
+	parser->op_chunk = chunk_callback;
+	parser->chunk_threshold = threshold;
+	if (chunk_callback) {
+		if (parser->value_ctx == parser->mem_ctx) {
+			parser->value_ctx = talloc_named(parser, 0, "fast transfer values");
+		}
+	}
+	else if (parser->value_ctx != parser->mem_ctx) {
+		talloc_free(parser->value_ctx);
+		parser->value_ctx = parser->mem_ctx;
+	}
+}
+
 /**
   \details initialise a fast transfer parser
 */
@@ -561,7 +596,10 @@ _PUBLIC_ struct fx_parser_context* fxparser_init(TALLOC_CTX *mem_ctx, void *priv
 	struct fx_parser_context *parser = talloc_zero(mem_ctx, struct fx_parser_context);
 
 	parser->mem_ctx = mem_ctx;
-	parser->data = data_blob_talloc_named(parser->mem_ctx, NULL, 0, "fast transfer parser");
+	parser->value_ctx = mem_ctx;
+	parser->data = data_blob_null;
+	parser->buffer = data_blob_null;
+	parser->buffer_size = 0;
 	parser->state = ParserState_Entry;
 	parser->idx = 0;
 	parser->lpProp.ulPropTag = (enum MAPITAGS) 0;
@@ -572,16 +610,43 @@ _PUBLIC_ struct fx_parser_context* fxparser_init(TALLOC_CTX *mem_ctx, void *priv
 	return parser;
 }
 
-/**
-  \details parse a fast transfer buffer
+static bool fxparser_is_chunked(struct fx_parser_context *parser)
+{
+	uint32_t length;
+
+	if (!parser->op_chunk) {
+		return false;
+	}
+
+	switch (parser->lpProp.ulPropTag & 0xFFFF) {
+	case PT_STRING8:
+	case PT_UNICODE:
+	case PT_BINARY:
+	case PT_OBJECT:
+		break;
+	default:
+		return false;
+	}
+
+	if (parser->idx + 4 > parser->data.length) {
+		return false;
+	}
+	length = parser->data.data[parser->idx] | (parser->data.data[parser->idx + 1] << 8)
+		| (parser->data.data[parser->idx + 2] << 16) | ((uint32_t)parser->data.data[parser->idx + 3] << 24);
+
+	return (length >= parser->chunk_threshold);
+}
+
+/*
+ parse as many elements as possible from parser->data, starting at parser->idx
 */
-_PUBLIC_ enum MAPISTATUS fxparser_parse(struct fx_parser_context *parser, DATA_BLOB *fxbuf)
+static enum MAPISTATUS fxparser_parse_data(struct fx_parser_context *parser)
 {
 	enum MAPISTATUS ms = MAPI_E_SUCCESS;
 
-	data_blob_append(parser->mem_ctx, &(parser->data), fxbuf->data, fxbuf->length);
 	parser->enough_data = true;
-	while(ms == MAPI_E_SUCCESS && (parser->idx < parser->data.length) && parser->enough_data) {
+	/* a tag already read may not need more data, such as a marker ending the stream */
+	while(ms == MAPI_E_SUCCESS && (parser->idx < parser->data.length || parser->state != ParserState_Entry) && parser->enough_data) {
 		uint32_t idx = parser->idx;
 
 		switch(parser->state) {
@@ -655,11 +720,19 @@ _PUBLIC_ enum MAPISTATUS fxparser_parse(struct fx_parser_context *parser, DATA_B
 			}
 			case ParserState_HavePropTag:
 			{
-				if (fetch_property_value(parser, &(parser->data), &(parser->lpProp))) {
+				if (fxparser_is_chunked(parser)) {
+					pull_uint32_t(parser, &(parser->value_length));
+					parser->value_offset = 0;
+					parser->state = ParserState_HaveValueChunk;
+				} else if (fetch_property_value(parser, &(parser->data), &(parser->lpProp))) {
 					// printf("position %i of %zi\n", parser->idx, parser->data.length);
 					if (parser->op_property) {
 						ms = parser->op_property(parser->lpProp, parser->priv);
 					}
+					if (parser->value_ctx != parser->mem_ctx) {
+						talloc_free(parser->value_ctx);
+						parser->value_ctx = talloc_named(parser, 0, "fast transfer values");
+					}
 					parser->state = ParserState_Entry;
 				} else {
 					parser->enough_data = false;
@@ -667,16 +740,126 @@ _PUBLIC_ enum MAPISTATUS fxparser_parse(struct fx_parser_context *parser, DATA_B
 				}
 				break;
 			}
+			case ParserState_HaveValueChunk:
+			{
+				DATA_BLOB chunk;
+
+				chunk.data = parser->data.data + parser->idx;
+				chunk.length = parser->data.length - parser->idx;
+				if (chunk.length > parser->value_length - parser->value_offset) {
+					chunk.length = parser->value_length - parser->value_offset;
+				}
+				if (!chunk.length && parser->value_offset < parser->value_length) {
+					parser->enough_data = false;
+					break;
+				}
+				ms = parser->op_chunk(parser->lpProp.ulPropTag, chunk, parser->value_offset,
+						      parser->value_length, parser->priv);
+				parser->idx += chunk.length;
+				parser->value_offset += chunk.length;
+				if (parser->value_offset == parser->value_length) {
+					parser->state = ParserState_Entry;
+				}
+				break;
+			}
 		}
 	}
-	{
-		// Remove the part of the buffer that we've used
-		uint32_t remainder_len = parser->data.length - parser->idx;
-		DATA_BLOB remainder = data_blob_talloc_named(parser->mem_ctx, &(parser->data.data[parser->idx]), remainder_len, "fast transfer parser");
-		data_blob_free(&(parser->data));
-		parser->data = remainder;
+
+	return ms;
+}
+
+/*
+ append data to the internal buffer, growing it geometrically
+*/
+static void fxparser_buffer_append(struct fx_parser_context *parser, const uint8_t *data, size_t length)
+{
+	size_t	size;
+
+	if (!length) return;
+
+	if (parser->buffer.length + length > parser->buffer_size) {
+		size = parser->buffer_size ? parser->buffer_size : FXPARSER_BUFFER_STEP;
+		while (size < parser->buffer.length + length) {
+			size *= 2;
+		}
+		parser->buffer.data = talloc_realloc(parser, parser->buffer.data, uint8_t, size);
+		parser->buffer_size = size;
+	}
+	memcpy(parser->buffer.data + parser->buffer.length, data, length);
+	parser->buffer.length += length;
+}
+
+/*
+ drop the first length bytes of the internal buffer
+*/
+static void fxparser_buffer_consume(struct fx_parser_context *parser, size_t length)
+{
+	if (length < parser->buffer.length) {
+		memmove(parser->buffer.data, parser->buffer.data + length, parser->buffer.length - length);
+	}
+	parser->buffer.length -= length;
+
+	/* do not hold on to the space taken by an unusually large element */
+	if (!parser->buffer.length && parser->buffer_size > FXPARSER_BUFFER_KEEP) {
+		talloc_free(parser->buffer.data);
+		parser->buffer.data = NULL;
+		parser->buffer_size = 0;
+	}
+}
+
+/**
+  \details parse a fast transfer buffer
+
+  Complete elements are parsed straight from fxbuf. Only the element
+  left incomplete at the end of fxbuf is kept by the parser, until the
+  next buffers complete it.
+*/
+_PUBLIC_ enum MAPISTATUS fxparser_parse(struct fx_parser_context *parser, DATA_BLOB *fxbuf)
+{
+	enum MAPISTATUS ms = MAPI_E_SUCCESS;
+	size_t		offset = 0;
+	size_t		step;
+	size_t		pending;
+
+	/* Step 1. Complete the element left over by the previous buffer,
+	   feeding it with increasingly large parts of fxbuf */
+	while (ms == MAPI_E_SUCCESS && parser->buffer.length && offset < fxbuf->length) {
+		pending = parser->buffer.length;
+		step = (pending > FXPARSER_BUFFER_STEP) ? pending : FXPARSER_BUFFER_STEP;
+		if (step > fxbuf->length - offset) {
+			step = fxbuf->length - offset;
+		}
+		fxparser_buffer_append(parser, fxbuf->data + offset, step);
+		offset += step;
+
+		parser->data = parser->buffer;
 		parser->idx = 0;
+		ms = fxparser_parse_data(parser);
+		if (parser->idx >= pending) {
+			/* the rest of the buffer is still in fxbuf */
+			offset -= parser->buffer.length - parser->idx;
+			parser->buffer.length = 0;
+			fxparser_buffer_consume(parser, 0);
+		}
+		else {
+			fxparser_buffer_consume(parser, parser->idx);
+		}
 	}
 
+	/* Step 2. Parse the remaining elements in place */
+	if (ms == MAPI_E_SUCCESS && !parser->buffer.length && offset < fxbuf->length) {
+		parser->data = *fxbuf;
+		parser->idx = offset;
+		ms = fxparser_parse_data(parser);
+		offset = parser->idx;
+	}
+
+	/* Step 3. Keep what could not be parsed */
+	if (offset < fxbuf->length) {
+		fxparser_buffer_append(parser, fxbuf->data + offset, fxbuf->length - offset);
+	}
+	parser->data = data_blob_null;
+	parser->idx = 0;
+
 	return ms;
 }
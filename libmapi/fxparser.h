@@ -25,17 +25,23 @@
    We mean it.
 */
 
-enum fx_parser_state { ParserState_Entry, ParserState_HaveTag, ParserState_HavePropTag };
+enum fx_parser_state { ParserState_Entry, ParserState_HaveTag, ParserState_HavePropTag, ParserState_HaveValueChunk };
 
 struct fx_parser_context {
 	TALLOC_CTX		*mem_ctx;
-	DATA_BLOB		data;	/* the data we have (so far) to parse */
+	TALLOC_CTX		*value_ctx;	/* where property values are allocated */
+	DATA_BLOB		data;	/* the data being parsed: either buffer or the caller's data */
 	uint32_t		idx;	/* where we are up to in the data blob */
+	DATA_BLOB		buffer;	/* the incomplete element left over by the previous call */
+	size_t			buffer_size;	/* the allocated size of buffer */
 	enum fx_parser_state	state;
 	struct SPropValue	lpProp;		/* the current property tag and value we are parsing */
 	struct MAPINAMEID	namedprop;	/* the current named property we are parsing */
 	bool 			enough_data;
 	uint32_t		tag;
+	uint32_t		value_length;	/* the size of the value being streamed */
+	uint32_t		value_offset;	/* how much of the value has been streamed so far */
+	uint32_t		chunk_threshold; /* the size from which values are streamed */
 	void			*priv;
 	
 	/* callbacks for parser actions */
@@ -43,6 +49,7 @@ struct fx_parser_context {
 	enum MAPISTATUS (*op_delprop)(uint32_t, void *);
 	enum MAPISTATUS (*op_namedprop)(uint32_t, struct MAPINAMEID, void *);
 	enum MAPISTATUS (*op_property)(struct SPropValue, void *);
+	enum MAPISTATUS (*op_chunk)(uint32_t, DATA_BLOB, uint32_t, uint32_t, void *);
 };
 
 #endif
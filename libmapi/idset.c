@@ -40,7 +40,8 @@ struct GLOBSET_parser {
 	uint8_t				total_stack_size;
 	bool				error;
 	uint32_t			range_count;
-	struct globset_range	*ranges;
+	uint32_t			range_alloc;
+	struct globset_range		*ranges;
 };
 
 /**
@@ -61,6 +62,21 @@ static inline void GLOBSET_parser_do_bitmask(struct GLOBSET_parser *parser);
 static void GLOBSET_parser_do_pop(struct GLOBSET_parser *parser);
 static void GLOBSET_parser_do_range(struct GLOBSET_parser *parser);
 
+/**
+  \details append a range read from the wire to the parser ranges,
+  with its bounds converted to host order
+*/
+static void GLOBSET_parser_add_range(struct GLOBSET_parser *parser, uint64_t low, uint64_t high)
+{
+	if (parser->range_count == parser->range_alloc) {
+		parser->range_alloc = parser->range_alloc ? parser->range_alloc * 2 : 16;
+		parser->ranges = talloc_realloc(parser, parser->ranges, struct globset_range, parser->range_alloc);
+	}
+	parser->ranges[parser->range_count].low = exchange_globcnt(low);
+	parser->ranges[parser->range_count].high = exchange_globcnt(high);
+	parser->range_count++;
+}
+
 static inline void GLOBSET_parser_do_push(struct GLOBSET_parser *parser, uint8_t count)
 {
 	DATA_BLOB *push_buffer;
@@ -138,13 +154,12 @@ static uint64_t GLOBSET_parser_range_value(DATA_BLOB *combined)
 static void GLOBSET_parser_do_range(struct GLOBSET_parser *parser)
 {
 	uint8_t count;
-	struct globset_range *range;
+	uint64_t low, high;
 	DATA_BLOB *combined, *additional;
 	void *mem_ctx;
 
 	mem_ctx = talloc_zero(NULL, void);
 
-	range = talloc_zero(parser, struct globset_range);
 	count = 6 - parser->total_stack_size;
 
 	if (count > 0) {
@@ -158,25 +173,20 @@ static void GLOBSET_parser_do_range(struct GLOBSET_parser *parser)
 	}
 	parser->buffer_position += count;
 	combined = GLOBSET_parser_stack_combine(mem_ctx, parser, additional);
-	range->low = GLOBSET_parser_range_value(combined);
+	low = GLOBSET_parser_range_value(combined);
 
 	if (count == 0) {
-		range->high = range->low;
+		high = low;
 	}
-	else if (count > 0) {
+	else {
 		memcpy(additional->data, parser->buffer.data + parser->buffer_position, count);
 		parser->buffer_position += count;
 		combined = GLOBSET_parser_stack_combine(mem_ctx, parser, additional);
-		range->high = GLOBSET_parser_range_value(combined);
+		high = GLOBSET_parser_range_value(combined);
 	}
 
-	DLIST_ADD_END(parser->ranges, range, void);
-	/* DEBUG(5, ("  added range: [%.16"PRIx64":%.16"PRIx64"] %p  %p %p\n", range->low, range->high, range, range->prev, range->next)); */
-	parser->range_count++;
-
-	if (!parser->ranges) {
-		abort();
-	}
+	GLOBSET_parser_add_range(parser, low, high);
+	/* DEBUG(5, ("  added range: [%.16"PRIx64":%.16"PRIx64"]\n", low, high)); */
 
 	talloc_free(mem_ctx);
 }
@@ -186,7 +196,6 @@ static inline void GLOBSET_parser_do_bitmask(struct GLOBSET_parser *parser)
 	uint8_t mask, bit, i;
 	DATA_BLOB *combined, additional;
 	uint64_t baseValue, lowValue, highValue;
-	struct globset_range *range;
 	bool blank = false;
 
 	mask = parser->buffer.data[parser->buffer_position+1];
@@ -213,11 +222,7 @@ static inline void GLOBSET_parser_do_bitmask(struct GLOBSET_parser *parser)
 		}
 		else {
 			if ((mask & bit) == 0) {
-				range = talloc_zero(parser, struct globset_range);
-				range->low = lowValue;
-				range->high = highValue;
-				DLIST_ADD_END(parser->ranges, range, void);
-				parser->range_count++;
+				GLOBSET_parser_add_range(parser, lowValue, highValue);
 				blank = true;
 			}
 			else {
@@ -227,21 +232,89 @@ static inline void GLOBSET_parser_do_bitmask(struct GLOBSET_parser *parser)
 	}
 
 	if (!blank) {
-		range = talloc_zero(parser, struct globset_range);
-		range->low = lowValue;
-		range->high = highValue;
-		DLIST_ADD_END(parser->ranges, range, void);
-		parser->range_count++;
+		GLOBSET_parser_add_range(parser, lowValue, highValue);
 	}
 }
 
+static int IDSET_range_compar(const void *vap, const void *vbp)
+{
+	const struct globset_range *ap, *bp;
+
+	ap = (const struct globset_range *) vap;
+	bp = (const struct globset_range *) vbp;
+
+	if (ap->low < bp->low) {
+		return -1;
+	}
+	else if (ap->low > bp->low) {
+		return 1;
+	}
+
+	return 0;
+}
+
+static int IDSET_globcnt_compar(const void *vap, const void *vbp)
+{
+	uint64_t a, b;
+
+	a = *(const uint64_t *) vap;
+	b = *(const uint64_t *) vbp;
+
+	if (a < b) {
+		return -1;
+	}
+	else if (a > b) {
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+  \details sort ranges by their lower bound, then merge the ones which
+  overlap or are adjacent and drop empty ones (low > high).
+
+  \return the number of ranges left
+*/
+static uint32_t IDSET_normalize_ranges(struct globset_range *ranges, uint32_t count)
+{
+	uint32_t i, j;
+	bool sorted = true;
+
+	for (i = 1; sorted && i < count; i++) {
+		sorted = (ranges[i - 1].low <= ranges[i].low);
+	}
+	if (!sorted) {
+		qsort(ranges, count, sizeof(struct globset_range), IDSET_range_compar);
+	}
+
+	j = 0;
+	for (i = 0; i < count; i++) {
+		if (ranges[i].low > ranges[i].high) {
+			continue;
+		}
+		if (j > 0 && ranges[i].low <= ranges[j - 1].high + 1) {
+			if (ranges[i].high > ranges[j - 1].high) {
+				ranges[j - 1].high = ranges[i].high;
+			}
+		}
+		else {
+			ranges[j++] = ranges[i];
+		}
+	}
+
+	return j;
+}
+
 /**
   \details deserialize a GLOBSET following the format described in [OXCFXICS - 2.2.2.5]
+
+  \return an array of countP ranges, sorted, disjoint and in host order
 */
 _PUBLIC_ struct globset_range *GLOBSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buffer, uint32_t *countP, uint32_t *byte_countP)
 {
 	struct GLOBSET_parser *parser;
-	struct globset_range *ranges, *range;
+	struct globset_range *ranges;
 	bool end = false;
 	uint8_t command;
 
@@ -291,6 +364,7 @@ _PUBLIC_ struct globset_range *GLOBSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buff
 		/* abort(); */
 	}
 	else {
+		parser->range_count = IDSET_normalize_ranges(parser->ranges, parser->range_count);
 		ranges = parser->ranges;
 		if (countP) {
 			*countP = parser->range_count;
@@ -299,11 +373,8 @@ _PUBLIC_ struct globset_range *GLOBSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buff
 			*byte_countP = parser->buffer_position;
 		}
 		if (ranges) {
-			range = ranges;
-			while (range) {
-				(void) talloc_reference(mem_ctx, range);
-				range = range->next;
-			}
+			ranges = talloc_realloc(mem_ctx, talloc_steal(mem_ctx, ranges), struct globset_range,
+						parser->range_count ? parser->range_count : 1);
 		}
 	}
 	talloc_free(parser);
@@ -315,7 +386,6 @@ _PUBLIC_ struct globset_range *GLOBSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buff
 static void check_idset(const struct idset *idset)
 {
 	uint32_t i;
-	struct globset_range *range, *last_range;
 
 	while (idset) {
 		if (!idset->idbased && GUID_all_zero(&idset->repl.guid)) {
@@ -323,30 +393,17 @@ static void check_idset(const struct idset *idset)
 			abort();
 		}
 
-		i = 0;
-		if (idset->ranges) {
-			range = idset->ranges;
-			while (range) {
-				/* DEBUG(5, ("range %d: [%.16Lx:%.16Lx] prev: %p; next: %p\n", i, range->low, range->high, range->prev, range->next)); */
-				if (range->prev == NULL) {
-					DEBUG(5, ("range %d has a NULL prev\n", i));
-					abort();
-				}
-				i++;
-				last_range = range;
-				range = range->next;
+		for (i = 0; i < idset->range_count; i++) {
+			if (idset->ranges[i].low > idset->ranges[i].high) {
+				DEBUG(5, ("idset: range %d is empty\n", i));
+				abort();
 			}
-			
-			if (idset->ranges->prev != last_range) {
-				DEBUG(5, ("idset: last element of linked list is not the expected one\n"));
+			if (i > 0 && idset->ranges[i].low <= idset->ranges[i - 1].high + 1) {
+				DEBUG(5, ("idset: range %d is not disjoint from and after the previous one\n", i));
 				abort();
 			}
 		}
 
-		if (i != idset->range_count) {
-			DEBUG(5, ("idset: elements count does not match the reported value (%d and %d)\n", i, idset->range_count));
-			abort();
-		}
 		idset = idset->next;
 	}
 }
@@ -359,7 +416,7 @@ static void check_idset(const struct idset *idset)
 */
 _PUBLIC_ struct idset *IDSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buffer, bool idbased)
 {
-	struct idset		*idset, *prev_idset = NULL;
+	struct idset		*idset, *head_idset = NULL, *prev_idset = NULL;
         DATA_BLOB		guid_blob, globset;
 	uint32_t		total_bytes, byte_count;
 
@@ -368,35 +425,54 @@ _PUBLIC_ struct idset *IDSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buffer, bool i
 	total_bytes = 0;
 	while (total_bytes < buffer.length) {
 		idset = talloc_zero(mem_ctx, struct idset);
-		if (prev_idset) {
-			prev_idset->next = idset;
-		}
+		if (!idset) break;
+		idset->idbased = idbased;
 
+		/* a replica is only linked once it parsed successfully */
 		if (idbased) {
+			if (total_bytes + 2 > buffer.length) {
+				talloc_free(idset);
+				break;
+			}
 			idset->repl.id = (buffer.data[total_bytes] | (buffer.data[total_bytes+1] << 8));
 			total_bytes += 2;
 		}
 		else {
-			guid_blob.data = buffer.data;
+			if (total_bytes + 16 > buffer.length) {
+				talloc_free(idset);
+				break;
+			}
+			guid_blob.data = buffer.data + total_bytes;
 			guid_blob.length = 16;
 			GUID_from_data_blob(&guid_blob, &idset->repl.guid);
 			total_bytes += 16;
 		}
 
-		globset.length = buffer.length - 16;
-		globset.data = (uint8_t *) buffer.data + 16;
+		byte_count = 0;
+		globset.length = buffer.length - total_bytes;
+		globset.data = (uint8_t *) buffer.data + total_bytes;
 		idset->ranges = GLOBSET_parse(idset, globset, &idset->range_count, &byte_count);
-		
+		if (!byte_count) {
+			talloc_free(idset);
+			break;
+		}
+
 		total_bytes += byte_count;
 
 		check_idset(idset);
 
+		if (prev_idset) {
+			prev_idset->next = idset;
+		}
+		else {
+			head_idset = idset;
+		}
 		prev_idset = idset;
 	}
 
-	IDSET_dump(idset, "freshly parsed");
+	IDSET_dump(head_idset, "freshly parsed");
 
-	return idset;
+	return head_idset;
 }
 
 static int IDSET_ID_compar(const void *vap, const void *vbp)
@@ -426,46 +502,13 @@ static int IDSET_GUID_compar(const void *vap, const void *vbp)
 
 	ap = *(const struct idset **) vap;
 	bp = *(const struct idset **) vbp;
-	
-	return GUID_compare(&ap->repl.guid, &bp->repl.guid);
-}
-
-static int IDSET_globcnt_compar(const void *vap, const void *vbp)
-{
-	int retval;
-	uint64_t a, b;
-
-	a = exchange_globcnt(*(uint64_t *) vap);
-	b = exchange_globcnt(*(uint64_t *) vbp);
 
-	if (a < b) {
-		retval = -1;
-	}
-	else if (a == b) {
-		retval = 0;
-	}
-	else {
-		retval = 1;
-	}
-
-	return retval;
-}
-
-static int IDSET_range_compar(const void *vap, const void *vbp)
-{
-	const struct globset_range *ap, *bp;
-
-	ap = *(const struct globset_range **) vap;
-	bp = *(const struct globset_range **) vbp;
-
-	return IDSET_globcnt_compar(&ap->low, &bp->low);
+	return GUID_compare(&ap->repl.guid, &bp->repl.guid);
 }
 
 static struct idset *IDSET_make(TALLOC_CTX *mem_ctx, bool idbased, uint16_t base_id, const struct GUID *base_guid, const uint64_t *array, uint32_t length, bool single)
 {
 	struct idset *idset;
-	struct globset_range *current_globset;
-	uint64_t last_consequent;
 	uint64_t *work_array;
 	uint32_t i;
 
@@ -482,42 +525,35 @@ static struct idset *IDSET_make(TALLOC_CTX *mem_ctx, bool idbased, uint16_t base
 	}
 	idset->single = single;
 
-	current_globset = talloc_zero(idset, struct globset_range);
-	DLIST_ADD_END(idset->ranges, current_globset, end);
-	idset->range_count = 1;
-
 	if (length == 0) {
 		return idset;
 	}
 
-	work_array = talloc_memdup(NULL, array, sizeof(uint64_t) * length);
-	qsort(work_array, length, sizeof(uint64_t), IDSET_globcnt_compar);
-
-	if (length == 2) {
-		DEBUG(5, ("work_array[0]: %.16Lx, %.16Lx\n", (unsigned long long) work_array[0], (unsigned long long) work_array[1]));
-		if (work_array[0] != array[0]) {
-			DEBUG(5, ("elements were reordered\n"));
-		}
+	work_array = talloc_array(NULL, uint64_t, length);
+	for (i = 0; i < length; i++) {
+		work_array[i] = exchange_globcnt(array[i]);
 	}
+	qsort(work_array, length, sizeof(uint64_t), IDSET_globcnt_compar);
 
-	current_globset->low = work_array[0];
-
-	if (single || length < 3) {
-		current_globset->high = work_array[length-1];
+	if (single) {
+		idset->ranges = talloc_array(idset, struct globset_range, 1);
+		idset->ranges[0].low = work_array[0];
+		idset->ranges[0].high = work_array[length-1];
+		idset->range_count = 1;
 	}
 	else {
-		last_consequent = exchange_globcnt(current_globset->low);
+		idset->ranges = talloc_array(idset, struct globset_range, length);
+		idset->ranges[0].low = work_array[0];
+		idset->ranges[0].high = work_array[0];
+		idset->range_count = 1;
 		for (i = 1; i < length; i++) {
-			if ((exchange_globcnt(work_array[i]) != last_consequent) && (exchange_globcnt(work_array[i]) != (last_consequent + 1))) {
-				current_globset->high = exchange_globcnt(last_consequent);
-				current_globset = talloc_zero(idset, struct globset_range);
-				DLIST_ADD_END(idset->ranges, current_globset, void);
+			if (work_array[i] > idset->ranges[idset->range_count-1].high + 1) {
+				idset->ranges[idset->range_count].low = work_array[i];
 				idset->range_count++;
-				current_globset->low = work_array[i];
 			}
-			last_consequent = exchange_globcnt(work_array[i]);
+			idset->ranges[idset->range_count-1].high = work_array[i];
 		}
-		current_globset->high = exchange_globcnt(last_consequent);
+		idset->ranges = talloc_realloc(idset, idset->ranges, struct globset_range, idset->range_count);
 	}
 
 	talloc_free(work_array);
@@ -527,58 +563,6 @@ static struct idset *IDSET_make(TALLOC_CTX *mem_ctx, bool idbased, uint16_t base
 	return idset;
 }
 
-/* start: [0|1|2|3|4|5] -- count --> */
-static void GLOBSET_ndr_push_shifted_id(struct ndr_push *ndr, uint64_t range_id, uint8_t start, uint8_t count)
-{
-	uint8_t i, steps, byte;
-
-	for (i = 0; i < count; i++) {
-		steps = start + i;
-		byte = (range_id >> (8 * steps)) & 0xff;
-		ndr_push_uint8(ndr, NDR_SCALARS, byte);
-	}
-}
-
-static void GLOBSET_ndr_push_globset_range(struct ndr_push *ndr, struct globset_range *range)
-{
-	uint8_t i;
-	uint64_t mask;
-	bool done;
-
-	if (range->low == range->high) {
-		ndr_push_uint8(ndr, NDR_SCALARS, 0x06); /* push 6 */
-		GLOBSET_ndr_push_shifted_id(ndr, range->low, 0, 6);
-	}
-	else {
-		i = 0;
-		mask = 0xff;
-		done = false;
-		while (!done && i < 6) {
-			if ((range->low & mask) == (range->high & mask)) {
-				mask <<= 8;
-				i++;
-			}
-			else {
-				done = true;
-			}
-		}
-		if (i > 0 && i < 6) {
-			/* push i */
-			ndr_push_uint8(ndr, NDR_SCALARS, i);
-			GLOBSET_ndr_push_shifted_id(ndr, range->low, 0, i);
-		}
-
-		ndr_push_uint8(ndr, NDR_SCALARS, 0x52); /* range */
-		GLOBSET_ndr_push_shifted_id(ndr, range->low, i, 6 - i);
-		GLOBSET_ndr_push_shifted_id(ndr, range->high, i, 6 - i);
-
-		if (i > 0 && i < 6) {
-			/* pop */
-			ndr_push_uint8(ndr, NDR_SCALARS, 0x50);
-		}
-	}
-}
-
 static int IDSET_count(const struct idset *idset)
 {
 	int	max = 0;
@@ -627,90 +611,107 @@ static void IDSET_reorder_idset(struct idset **idsetP)
 	talloc_free(idsets);
 }
 
-static void IDSET_reorder_ranges(struct idset *idset)
+/**
+  \details returns the idset of the same replica as replica in the
+  idset list, or NULL
+*/
+static struct idset *IDSET_find_replica(struct idset *idset, const struct idset *replica)
 {
-	struct globset_range *range;
-	struct globset_range **ranges;
-	uint32_t i;
+	while (idset) {
+		if (idset->idbased == replica->idbased) {
+			if (idset->idbased ? (idset->repl.id == replica->repl.id)
+			    : GUID_equal(&idset->repl.guid, &replica->repl.guid)) {
+				return idset;
+			}
+		}
+		idset = idset->next;
+	}
+
+	return NULL;
+}
 
-	if (!idset || idset->range_count < 2) return;
+/**
+  \details merge the sorted ranges of two idsets of the same replica
+  into idset, in one pass over both
+*/
+static void IDSET_merge_ranges(struct idset *idset, const struct globset_range *ranges, uint32_t count)
+{
+	struct globset_range	*merged;
+	const struct globset_range *next;
+	uint32_t		i = 0, j = 0, merged_count = 0;
 
-	ranges = talloc_array(NULL, struct globset_range *, idset->range_count);
-	range = idset->ranges;
-	for (i = 0; i < idset->range_count; i++) {
-		ranges[i] = range;
-		range = range->next;
-	}
+	if (!count) return;
 
-	qsort(ranges, idset->range_count, sizeof(struct globset_range *), IDSET_range_compar);
+	merged = talloc_array(idset, struct globset_range, idset->range_count + count);
+	while (i < idset->range_count || j < count) {
+		if (j == count || (i < idset->range_count && idset->ranges[i].low <= ranges[j].low)) {
+			next = idset->ranges + i++;
+		}
+		else {
+			next = ranges + j++;
+		}
 
-	idset->ranges = ranges[0];
-	ranges[0]->prev = ranges[idset->range_count-1];
-	for (i = 0; i < idset->range_count - 1; i++) {
-		ranges[i]->next = ranges[i+1];
-		ranges[i+1]->prev = ranges[i];
+		if (merged_count && next->low <= merged[merged_count-1].high + 1) {
+			if (next->high > merged[merged_count-1].high) {
+				merged[merged_count-1].high = next->high;
+			}
+		}
+		else {
+			merged[merged_count++] = *next;
+		}
 	}
-	ranges[idset->range_count-1]->next = NULL;
 
-	check_idset(idset);
+	if (idset->single && merged_count > 1) {
+		merged[0].high = merged[merged_count-1].high;
+		merged_count = 1;
+	}
 
-	talloc_free(ranges);
+	talloc_free(idset->ranges);
+	idset->ranges = talloc_realloc(idset, merged, struct globset_range, merged_count);
+	idset->range_count = merged_count;
 }
 
-static void IDSET_compact_ranges(struct idset *idset)
+/**
+  \details remove the sorted ranges passed as parameter from the ranges
+  of idset, in one pass over both
+*/
+static void IDSET_subtract_ranges(struct idset *idset, const struct globset_range *ranges, uint32_t count)
 {
-	struct globset_range *range, *next_range, *prev_range;
+	struct globset_range	*result;
+	uint32_t		i, j = 0, result_count = 0;
+	uint64_t		low;
 
-	if (!idset || idset->range_count < 2) return;
+	if (!count || !idset->range_count) return;
 
-	if (idset->single) {
-		range = idset->ranges;
-		next_range = range->next;
-		while (next_range) {
-			if (exchange_globcnt(next_range->low) < exchange_globcnt(range->low)) {
-				range->low = next_range->low;
+	/* each removed range splits at most one range in two */
+	result = talloc_array(idset, struct globset_range, idset->range_count + count);
+	for (i = 0; i < idset->range_count; i++) {
+		low = idset->ranges[i].low;
+		while (j < count && ranges[j].high < low) {
+			j++;
+		}
+		while (j < count && ranges[j].low <= idset->ranges[i].high) {
+			if (ranges[j].low > low) {
+				result[result_count].low = low;
+				result[result_count].high = ranges[j].low - 1;
+				result_count++;
 			}
-			if (exchange_globcnt(next_range->high) > exchange_globcnt(range->high)) {
-				range->high = next_range->high;
+			if (ranges[j].high >= idset->ranges[i].high) {
+				break;
 			}
-			prev_range = next_range;
-			next_range = next_range->next;
-			talloc_free(prev_range);
+			low = ranges[j].high + 1;
+			j++;
 		}
-		range->next = NULL;
-		range->prev = range;
-		idset->range_count = 1;
-	}
-	else {
-		range = idset->ranges;
-		while (range) {
-			next_range = range->next;
-			while (next_range) {
-				if (exchange_globcnt(next_range->low) >= exchange_globcnt(range->low)
-				    && exchange_globcnt(next_range->low) <= exchange_globcnt(range->high)) {		/* A[  B[...  ]A */
-					if (exchange_globcnt(next_range->high) > exchange_globcnt(range->high)) {	/* A[  B[  ]A  ]B -> A[  B[  ]AB */
-						range->high = next_range->high;
-					}
-					range->next = next_range->next;
-					if (range->next) {
-						range->next->prev = range;
-					}
-					if (idset->ranges->prev == next_range) {
-						idset->ranges->prev = range;
-					}
-					idset->range_count--;
-					talloc_free(next_range);
-					next_range = range->next;
-				}
-				else {
-					next_range = NULL;
-				}
-			}
-			range = range->next;
+		if (j == count || ranges[j].low > idset->ranges[i].high) {
+			result[result_count].low = low;
+			result[result_count].high = idset->ranges[i].high;
+			result_count++;
 		}
 	}
 
-	check_idset(idset);
+	talloc_free(idset->ranges);
+	idset->ranges = talloc_realloc(idset, result, struct globset_range, result_count ? result_count : 1);
+	idset->range_count = result_count;
 }
 
 /**
@@ -718,7 +719,6 @@ static void IDSET_compact_ranges(struct idset *idset)
 */
 static struct idset *IDSET_clone(TALLOC_CTX *mem_ctx, const struct idset *source_idset)
 {
-	struct globset_range *range, *clone;
 	struct idset *idset = NULL, *head_idset = NULL, *tail_idset;
 
 	if (!source_idset) return NULL;
@@ -737,14 +737,9 @@ static struct idset *IDSET_clone(TALLOC_CTX *mem_ctx, const struct idset *source
 		}
 		idset->single = source_idset->single;
 		idset->range_count = source_idset->range_count;
-
-		range = source_idset->ranges;
-		while (range) {
-			clone = talloc_zero(idset, struct globset_range);
-			clone->low = range->low;
-			clone->high = range->high;
-			DLIST_ADD_END(idset->ranges, clone, void);
-			range = range->next;
+		if (source_idset->range_count) {
+			idset->ranges = talloc_memdup(idset, source_idset->ranges,
+						      sizeof(struct globset_range) * source_idset->range_count);
 		}
 
 		if (!head_idset) {
@@ -766,119 +761,193 @@ static struct idset *IDSET_clone(TALLOC_CTX *mem_ctx, const struct idset *source
 */
 _PUBLIC_ struct idset *IDSET_merge_idsets(TALLOC_CTX *mem_ctx, const struct idset *left, const struct idset *right)
 {
-	struct idset *merged_idset, *clone_right, *current, *next;
-	uint16_t current_id = 0, next_id;
-	struct GUID *current_guid = NULL, *next_guid;
-	bool added_ranges = false, same_id, idbased;
-	struct globset_range *range;
+	struct idset *merged_idset, *current, *tail;
+	const struct idset *replica;
 
 	if (!left || left->range_count == 0) return IDSET_clone(mem_ctx, right);
 	if (!right || right->range_count == 0) return IDSET_clone(mem_ctx, left);
 
 	merged_idset = IDSET_clone(mem_ctx, left);
-	clone_right = IDSET_clone(mem_ctx, right);
 
-	current = merged_idset;
-	while (current->next) {
-		current = current->next;
+	for (replica = right; replica; replica = replica->next) {
+		current = IDSET_find_replica(merged_idset, replica);
+		if (current) {
+			IDSET_merge_ranges(current, replica->ranges, replica->range_count);
+		}
+		else {
+			for (tail = merged_idset; tail->next; tail = tail->next);
+			tail->next = talloc_zero(mem_ctx, struct idset);
+			*tail->next = *replica;
+			tail->next->next = NULL;
+			tail->next->ranges = talloc_memdup(tail->next, replica->ranges,
+							   sizeof(struct globset_range) * (replica->range_count ? replica->range_count : 1));
+		}
 	}
-	current->next = clone_right;
 
 	IDSET_reorder_idset(&merged_idset);
 
-	current = merged_idset;
-	idbased = current->idbased;
-	if (idbased) {
-		current_id = current->repl.id;
-	} else {
-		current_guid = &current->repl.guid;
+	check_idset(merged_idset);
+
+	return merged_idset;
+}
+
+/* start: [0|1|2|3|4|5] -- count --> */
+static inline uint8_t *GLOBSET_write_shifted_id(uint8_t *data, uint64_t range_id, uint8_t start, uint8_t count)
+{
+	uint8_t i;
+
+	for (i = 0; i < count; i++) {
+		*data++ = (range_id >> (8 * (start + i))) & 0xff;
 	}
-	while (current->next) {
-		next = current->next;
 
-		if (idbased) {
-			next_id = next->repl.id;
-			same_id = (current_id == next_id);
-		} else {
-			next_guid = &next->repl.guid;
-			same_id = GUID_equal(current_guid, next_guid);
-		}
-		
-		if (same_id) {
-			added_ranges = true;
-			current->range_count += next->range_count;
-			range = next->ranges;
-			current->ranges->prev->next = range;
-			while (range) {
-				(void) talloc_reference(current, range);
-				range = range->next;
-			}
-			current->next = next->next;
-			talloc_free(next);
-		}
-		else {
-			current = next;
-		}
+	return data;
+}
+
+/**
+  \details returns the number of GLOBCNT bytes shared by both bounds
+  of a range, starting from the most significant one
+*/
+static inline uint8_t GLOBSET_range_common_bytes(const struct globset_range *range)
+{
+	uint8_t i = 0;
+
+	while (i < 6 && ((range->low >> (40 - 8 * i)) & 0xff) == ((range->high >> (40 - 8 * i)) & 0xff)) {
+		i++;
 	}
 
-	if (added_ranges) {
-		current = merged_idset;
-		while (current) {
-			IDSET_reorder_ranges(current);
-			IDSET_compact_ranges(current);
-			current = current->next;
-		}
+	return i;
+}
+
+static size_t GLOBSET_range_size(const struct globset_range *range)
+{
+	uint8_t i;
+
+	if (range->low == range->high) {
+		return 7; /* push 6 */
 	}
 
-	return merged_idset;
+	i = GLOBSET_range_common_bytes(range);
+	if (i > 0) {
+		return (1 + i) + (1 + 2 * (6 - i)) + 1; /* push i, range, pop */
+	}
+
+	return 1 + 12; /* range */
+}
+
+static uint8_t *GLOBSET_write_range(uint8_t *data, const struct globset_range *range)
+{
+	uint64_t low, high;
+	uint8_t i;
+
+	/* GLOBCNT bytes are pushed most significant first */
+	low = exchange_globcnt(range->low);
+	high = exchange_globcnt(range->high);
+
+	if (range->low == range->high) {
+		*data++ = 0x06; /* push 6 */
+		return GLOBSET_write_shifted_id(data, low, 0, 6);
+	}
+
+	i = GLOBSET_range_common_bytes(range);
+	if (i > 0) {
+		*data++ = i; /* push i */
+		data = GLOBSET_write_shifted_id(data, low, 0, i);
+	}
+
+	*data++ = 0x52; /* range */
+	data = GLOBSET_write_shifted_id(data, low, i, 6 - i);
+	data = GLOBSET_write_shifted_id(data, high, i, 6 - i);
+
+	if (i > 0) {
+		*data++ = 0x50; /* pop */
+	}
+
+	return data;
 }
 
 /**
   \details serialize an idset structure in a struct SBinary_r
+
+  The size of the GLOBSETs is computed first, so that ranges are
+  written straight from the idset into the returned buffer.
 */
 _PUBLIC_ struct Binary_r *IDSET_serialize(TALLOC_CTX *mem_ctx, const struct idset *idset)
 {
-	struct ndr_push	*ndr;
-	struct globset_range *current_range;
-	struct Binary_r *data;
+	const struct idset	*current;
+	struct Binary_r		*data;
+	uint8_t			*ptr;
+	size_t			size = 0;
+	uint32_t		i;
 
 	check_idset(idset);
 
-	ndr = ndr_push_init_ctx(NULL);
-	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
-	ndr->offset = 0;
+	for (current = idset; current; current = current->next) {
+		size += current->idbased ? 2 : 16;
+		for (i = 0; i < current->range_count; i++) {
+			size += GLOBSET_range_size(current->ranges + i);
+		}
+		size += 1; /* end */
+	}
 
-	while (idset) {
-		if (idset->idbased) {
-			ndr_push_uint16(ndr, NDR_SCALARS, idset->repl.id);
+	data = talloc_zero(mem_ctx, struct Binary_r);
+	data->cb = size;
+	data->lpb = talloc_array(data, uint8_t, size ? size : 1);
+	ptr = data->lpb;
+
+	for (current = idset; current; current = current->next) {
+		if (current->idbased) {
+			*ptr++ = current->repl.id & 0xff;
+			*ptr++ = (current->repl.id >> 8) & 0xff;
 		} else {
-			ndr_push_GUID(ndr, NDR_SCALARS, &idset->repl.guid);
+			*ptr++ = current->repl.guid.time_low & 0xff;
+			*ptr++ = (current->repl.guid.time_low >> 8) & 0xff;
+			*ptr++ = (current->repl.guid.time_low >> 16) & 0xff;
+			*ptr++ = (current->repl.guid.time_low >> 24) & 0xff;
+			*ptr++ = current->repl.guid.time_mid & 0xff;
+			*ptr++ = (current->repl.guid.time_mid >> 8) & 0xff;
+			*ptr++ = current->repl.guid.time_hi_and_version & 0xff;
+			*ptr++ = (current->repl.guid.time_hi_and_version >> 8) & 0xff;
+			memcpy(ptr, current->repl.guid.clock_seq, 2);
+			ptr += 2;
+			memcpy(ptr, current->repl.guid.node, 6);
+			ptr += 6;
 		}
 
-		current_range = idset->ranges;
-		while (current_range) {
-			GLOBSET_ndr_push_globset_range(ndr, current_range);
-			current_range = current_range->next;
+		for (i = 0; i < current->range_count; i++) {
+			ptr = GLOBSET_write_range(ptr, current->ranges + i);
 		}
-		ndr_push_uint8(ndr, NDR_SCALARS, 0x00); /* end */
-		idset = idset->next;
+		*ptr++ = 0x00; /* end */
 	}
 
-	data = talloc_zero(mem_ctx, struct Binary_r);
-	data->cb = ndr->offset;
-	data->lpb = ndr->data;
-	(void) talloc_reference(data, data->lpb);
-	talloc_free(ndr);
-
 	return data;
 }
 
+/**
+  \details tests the presence of a globcnt, in host order, in the
+  sorted ranges of an idset
+*/
+static bool IDSET_ranges_include(const struct idset *idset, uint64_t globcnt)
+{
+	uint32_t low = 0, high = idset->range_count, middle;
+
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (idset->ranges[middle].high < globcnt) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	return (low < idset->range_count && idset->ranges[low].low <= globcnt);
+}
+
 /**
   \details tests the presence of a specific id in the ranges of a ReplID-based idset structure
 */
 _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 {
-	struct globset_range *range;
 	uint16_t eid_id;
 	uint64_t eid_globcnt;
 
@@ -887,18 +956,11 @@ _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 	}
 
 	eid_id = eid & 0xffff;
-	eid_globcnt = eid >> 16;
+	eid_globcnt = exchange_globcnt(eid >> 16);
 
 	while (idset) {
-		if (idset->repl.id == eid_id) {
-			range = idset->ranges;
-			while (range) {
-				if (exchange_globcnt(range->low) <= exchange_globcnt(eid_globcnt)
-				    && exchange_globcnt(range->high) >= exchange_globcnt(eid_globcnt)) {
-					return true;
-				}
-				range = range->next;
-			}
+		if (idset->repl.id == eid_id && IDSET_ranges_include(idset, eid_globcnt)) {
+			return true;
 		}
 		idset = idset->next;
 	}
@@ -911,7 +973,7 @@ _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 */
 _PUBLIC_ bool IDSET_includes_guid_glob(const struct idset *idset, struct GUID *replica_guid, uint64_t id)
 {
-	struct globset_range *range;
+	uint64_t globcnt;
 
 	if (!idset || idset->idbased) {
 		return false;
@@ -920,15 +982,10 @@ _PUBLIC_ bool IDSET_includes_guid_glob(const struct idset *idset, struct GUID *r
 		return false;
 	}
 
+	globcnt = exchange_globcnt(id);
 	while (idset) {
-		if (GUID_equal(&idset->repl.guid, replica_guid)) {
-			range = idset->ranges;
-			while (range) {
-				if (exchange_globcnt(range->low) <= exchange_globcnt(id) && exchange_globcnt(range->high) >= exchange_globcnt(id)) {
-					return true;
-				}
-				range = range->next;
-			}
+		if (GUID_equal(&idset->repl.guid, replica_guid) && IDSET_ranges_include(idset, globcnt)) {
+			return true;
 		}
 		idset = idset->next;
 	}
@@ -936,56 +993,9 @@ _PUBLIC_ bool IDSET_includes_guid_glob(const struct idset *idset, struct GUID *r
 	return false;
 }
 
-static void IDSET_ranges_remove_globcnt(struct idset *idset, uint64_t eid) {
-	struct globset_range *range, *new_range;
-	bool done = false;
-	uint64_t work_eid;
-
-	work_eid = exchange_globcnt(eid);
-
-	range = idset->ranges;
-	while (!done && range) {
-		if (range->low == eid) {
-			if (range->high == eid) {
-				DLIST_REMOVE(idset->ranges, range);
-				idset->range_count--;
-				if (range->next == NULL && idset->ranges != NULL) {
-					idset->ranges->prev = range->prev;
-				}
-				talloc_free(range);
-			}
-			else {
-				range->low = exchange_globcnt(work_eid + 1);
-			}
-			done = true;
-		}
-		else if (range->high == eid) {
-			range->high = exchange_globcnt(work_eid + 1);
-			done = true;
-		}
-		else if ((exchange_globcnt(range->low) < work_eid) && (exchange_globcnt(range->high) > work_eid)) {
-			new_range = talloc_zero(idset, struct globset_range);
-			new_range->low = exchange_globcnt(work_eid + 1);
-			new_range->high = range->high;
-			range->high = exchange_globcnt(work_eid - 1);
-			new_range->next = range->next;
-			range->next = new_range;
-			if (new_range->next == NULL) {
-				idset->ranges->prev = new_range;
-			}
-			idset->range_count++;
-			done = true;
-		}
-		else {
-			range = range->next;
-		}
-	}
-}
-
 _PUBLIC_ void IDSET_remove_rawidset(struct idset *idset, const struct rawidset *rawidset)
 {
-	struct idset *current_idset;
-	int i;
+	struct idset *current_idset, *removed_idset;
 
 	if (!idset || !rawidset) {
 		return;
@@ -1015,10 +1025,11 @@ _PUBLIC_ void IDSET_remove_rawidset(struct idset *idset, const struct rawidset *
 		}
 	}
 
-	if (current_idset) {
-		for (i = 0; i < rawidset->count; i++) {
-			IDSET_ranges_remove_globcnt(current_idset, rawidset->globcnts[i]);
-		}
+	if (current_idset && rawidset->count > 0) {
+		removed_idset = IDSET_make(NULL, rawidset->idbased, rawidset->repl.id, &rawidset->repl.guid,
+					   rawidset->globcnts, rawidset->count, false);
+		IDSET_subtract_ranges(current_idset, removed_idset->ranges, removed_idset->range_count);
+		talloc_free(removed_idset);
 	}
 
 	check_idset(idset);
@@ -1029,7 +1040,6 @@ _PUBLIC_ void IDSET_remove_rawidset(struct idset *idset, const struct rawidset *
 */
 _PUBLIC_ void IDSET_dump(const struct idset *idset, const char *label)
 {
-	struct globset_range *range;
 	uint32_t i;
 	char *guid_str;
 
@@ -1044,13 +1054,11 @@ _PUBLIC_ void IDSET_dump(const struct idset *idset, const char *label)
 			talloc_free(guid_str);
 		}
 
-		range = idset->ranges;
 		for (i = 0; i < idset->range_count; i++) {
-			if (exchange_globcnt(range->low) > exchange_globcnt(range->high)) {
+			if (idset->ranges[i].low > idset->ranges[i].high) {
 				abort();
 			}
-			DEBUG(0, ("  [0x%.12" PRIx64 ":0x%.12" PRIx64 "]\n", range->low, range->high));
-			range = range->next;
+			DEBUG(0, ("  [0x%.12" PRIx64 ":0x%.12" PRIx64 "]\n", idset->ranges[i].low, idset->ranges[i].high));
 		}
 
 		idset = idset->next;
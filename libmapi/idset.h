@@ -30,15 +30,13 @@ struct idset {
 	} repl;
 	bool			single; /* single range */
 	uint32_t		range_count;
-	struct globset_range	*ranges;
+	struct globset_range	*ranges; /* sorted, disjoint, host order */
 	struct idset		*next;
 };
 
 struct globset_range {
 	uint64_t		low;
 	uint64_t		high;
-	struct globset_range	*prev;
-	struct globset_range	*next;
 };
 
 struct rawidset {
@@ -62,6 +62,7 @@
 #include "libmapi/mapi_provider.h"
 #include "libmapi/mapi_object.h"
 #include "libmapi/mapi_id_array.h"
+#include "libmapi/mapi_batch.h"
 #include "libmapi/mapi_notification.h"
 #include "libmapi/mapi_profile.h"
 #include "libmapi/mapidefs.h"
@@ -118,6 +119,8 @@ NTSTATUS		emsmdb_transaction(struct emsmdb_context *, TALLOC_CTX *, struct mapi_
 NTSTATUS		emsmdb_transaction_ext2(struct emsmdb_context *, TALLOC_CTX *, struct mapi_request *, struct mapi_response **);
 NTSTATUS		emsmdb_transaction_wrapper(struct mapi_session *, TALLOC_CTX *, struct mapi_request *, struct mapi_response **);
 struct emsmdb_info	*emsmdb_get_info(struct mapi_session *);
+enum MAPISTATUS		emsmdb_set_compression(struct mapi_session *, bool, uint32_t);
+enum MAPISTATUS		emsmdb_set_deferred_release(struct mapi_session *, bool);
 void			emsmdb_get_SRowSet(TALLOC_CTX *, struct SRowSet *, struct SPropTagArray *, DATA_BLOB *);
 
 /* The following public definitions come from libmapi/cdo_mapi.c */
@@ -197,6 +200,17 @@ void			mapidump_freebusy_date(uint32_t, const char *);
 void			mapidump_freebusy_event(struct Binary_r *, uint32_t, uint32_t, const char *);
 void			mapidump_languages_list(void);
 
+/* The following public definitions come from libmapi/mapi_batch.c */
+enum MAPISTATUS		mapi_batch_init(struct mapi_session *, TALLOC_CTX *, struct mapi_batch **);
+enum MAPISTATUS		mapi_batch_OpenFolder(struct mapi_batch *, mapi_object_t *, mapi_id_t, mapi_object_t *, struct mapi_batch_future *);
+enum MAPISTATUS		mapi_batch_OpenMessage(struct mapi_batch *, mapi_object_t *, mapi_id_t, mapi_id_t, mapi_object_t *, uint8_t, struct mapi_batch_future *);
+enum MAPISTATUS		mapi_batch_GetContentsTable(struct mapi_batch *, mapi_object_t *, mapi_object_t *, uint8_t, struct mapi_batch_future *);
+enum MAPISTATUS		mapi_batch_GetHierarchyTable(struct mapi_batch *, mapi_object_t *, mapi_object_t *, uint8_t, struct mapi_batch_future *);
+enum MAPISTATUS		mapi_batch_SetColumns(struct mapi_batch *, mapi_object_t *, struct SPropTagArray *, struct mapi_batch_future *);
+enum MAPISTATUS		mapi_batch_QueryRows(struct mapi_batch *, mapi_object_t *, uint16_t, enum QueryRowsFlags, struct mapi_batch_future *);
+enum MAPISTATUS		mapi_batch_GetProps(struct mapi_batch *, mapi_object_t *, uint32_t, struct SPropTagArray *, struct mapi_batch_future *);
+enum MAPISTATUS		mapi_batch_execute(struct mapi_batch *);
+
 /* The following public definitions come from libmapi/mapi_object.c */
 enum MAPISTATUS		mapi_object_init(mapi_object_t *);
 void			mapi_object_release(mapi_object_t *);
@@ -449,6 +463,7 @@ enum MAPISTATUS		ReloadCachedInformation(mapi_object_t *);
 enum MAPISTATUS		MAPIAllocateBuffer(struct mapi_context *, uint32_t, void **);
 enum MAPISTATUS		MAPIFreeBuffer(void *);
 enum MAPISTATUS		Release(mapi_object_t *);
+enum MAPISTATUS		FlushReleases(struct mapi_session *);
 enum MAPISTATUS		GetLastError(void);
 enum MAPISTATUS		GetLongTermIdFromId(mapi_object_t *, mapi_id_t, struct LongTermId *);
 enum MAPISTATUS		GetIdFromLongTermId(mapi_object_t *, struct LongTermId, mapi_id_t *);
@@ -502,10 +517,18 @@ char			*x500_truncate_dn_last_elements(TALLOC_CTX *, const char *, uint32_t);
 char			*x500_get_servername(const char *);
 
 /* The following public definitions come from libmapi/lzfu.c */
+struct lzfu_stream;
 enum MAPISTATUS		WrapCompressedRTFStream(mapi_object_t *, DATA_BLOB *);
+enum MAPISTATUS		WriteCompressedRTFStream(mapi_object_t *, const char *, size_t);
 enum MAPISTATUS		uncompress_rtf(TALLOC_CTX *, uint8_t *, uint32_t, DATA_BLOB *);
 uint32_t		calculateCRC(uint8_t *, uint32_t, uint32_t);
 enum MAPISTATUS		compress_rtf(TALLOC_CTX *, const char*, const size_t, uint8_t **, size_t *);
+struct lzfu_stream	*lzfu_compress_init(TALLOC_CTX *);
+enum MAPISTATUS		lzfu_compress_update(struct lzfu_stream *, const uint8_t *, size_t, DATA_BLOB *);
+enum MAPISTATUS		lzfu_compress_final(struct lzfu_stream *, DATA_BLOB *, DATA_BLOB *);
+struct lzfu_stream	*lzfu_uncompress_init(TALLOC_CTX *);
+enum MAPISTATUS		lzfu_uncompress_update(struct lzfu_stream *, const uint8_t *, size_t, DATA_BLOB *);
+enum MAPISTATUS		lzfu_uncompress_final(struct lzfu_stream *);
 
 /* The following public definitions come from libmapi/utils.c */
 char			*guid_delete_dash(TALLOC_CTX *, const char *);
@@ -526,12 +549,14 @@ typedef enum MAPISTATUS (*fxparser_marker_callback_t)(uint32_t, void *);
 typedef enum MAPISTATUS (*fxparser_delprop_callback_t)(uint32_t, void *);
 typedef enum MAPISTATUS (*fxparser_namedprop_callback_t)(uint32_t, struct MAPINAMEID, void *);
 typedef enum MAPISTATUS (*fxparser_property_callback_t)(struct SPropValue, void *);
+typedef enum MAPISTATUS (*fxparser_chunk_callback_t)(uint32_t, DATA_BLOB, uint32_t, uint32_t, void *);
 
 struct fx_parser_context *fxparser_init(TALLOC_CTX *, void *);
 void 			fxparser_set_marker_callback(struct fx_parser_context *, fxparser_marker_callback_t);
 void 			fxparser_set_delprop_callback(struct fx_parser_context *, fxparser_delprop_callback_t);
 void 			fxparser_set_namedprop_callback(struct fx_parser_context *, fxparser_namedprop_callback_t);
 void 			fxparser_set_property_callback(struct fx_parser_context *, fxparser_property_callback_t);
+void 			fxparser_set_chunk_callback(struct fx_parser_context *, fxparser_chunk_callback_t, uint32_t);
 enum MAPISTATUS		fxparser_parse(struct fx_parser_context *, DATA_BLOB *);
 
 /* The following public definitions come from libmapi/idset.c */
@@ -60,6 +60,7 @@ __BEGIN_DECLS
 void obfuscate_data(uint8_t *, uint32_t, uint8_t);
 enum ndr_err_code ndr_pull_lzxpress_decompress(struct ndr_pull *, struct ndr_pull **, ssize_t);
 enum ndr_err_code ndr_push_lzxpress_compress(struct ndr_push *, struct ndr_push *);
+enum ndr_err_code ndr_push_mapi_extended_buffer(struct ndr_push *, const uint8_t *, uint32_t, uint16_t, uint32_t, struct mapi_compression_stats *);
 enum ndr_err_code ndr_push_ExtendedException(struct ndr_push *, int, uint16_t, const struct ExceptionInfo *, const struct ExtendedException *);
 enum ndr_err_code ndr_pull_ExtendedException(struct ndr_pull *, int, uint16_t, const struct ExceptionInfo *, struct ExtendedException *);
 enum ndr_err_code ndr_push_AppointmentRecurrencePattern(struct ndr_push *, int, const struct AppointmentRecurrencePattern *);
@@ -113,6 +114,12 @@ enum MAPISTATUS		ProcessNotification(struct mapi_notify_ctx *, struct mapi_respo
 /* The following private definitions come from libmapi/IMAPITable.c  */
 uint32_t		get_mapi_SRestriction_size(struct mapi_SRestriction *);
 
+/* The following private definitions come from libmapi/IStoreFolder.c  */
+void			mapi_object_message_init(struct mapi_session *, mapi_object_t *, struct OpenMessage_repl *);
+
+/* The following private definitions come from libmapi/IUnknown.c  */
+enum MAPISTATUS		ReleaseDeferred(mapi_object_t *);
+
 /* The following private definitions come from libmapi/IMSProvider.c  */
 enum MAPISTATUS		Logon(struct mapi_session *, struct mapi_provider *, enum PROVIDER_ID);
 enum MAPISTATUS		GetNewLogonId(struct mapi_session *, uint8_t *);
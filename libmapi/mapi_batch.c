@@ -0,0 +1,697 @@
+/*
+   OpenChange MAPI implementation.
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+/**
+   \file mapi_batch.c
+
+   \brief Send several dependent operations in a single request
+
+   Each libmapi call such as OpenFolder or QueryRows costs a network
+   round-trip. A batch queues operations instead and sends them all in
+   one EcDoRpc request when it is executed. An operation may use the
+   object opened by an operation queued before it: the server resolves
+   the handle slot the earlier operation fills, so a whole
+   OpenFolder, GetContentsTable, SetColumns, QueryRows sequence costs a
+   single round-trip.
+
+   The objects and the futures given to the queueing functions are
+   filled when the batch is executed, either explicitly with
+   mapi_batch_execute or when a new operation would not fit in the
+   request anymore.
+*/
+
+#define	MAPI_BATCH_HANDLES_MAX	255
+
+static void mapi_batch_reset(struct mapi_batch *batch)
+{
+	talloc_free(batch->mem_ctx);
+	batch->mem_ctx = talloc_named(batch, 0, "mapi_batch");
+	batch->mapi_req = NULL;
+	batch->ops = NULL;
+	batch->handles = NULL;
+	batch->handle_count = 0;
+	batch->count = 0;
+	batch->size = sizeof (uint16_t);
+}
+
+
+/**
+   \details Create a new batch of operations
+
+   \param session pointer to the MAPI session the operations are sent on
+   \param mem_ctx pointer to the memory context
+   \param batch pointer on the pointer to the returned batch
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa mapi_batch_execute
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_init(struct mapi_session *session,
+					 TALLOC_CTX *mem_ctx,
+					 struct mapi_batch **batch)
+{
+	struct mapi_batch	*_batch;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!session, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!batch, MAPI_E_INVALID_PARAMETER, NULL);
+
+	_batch = talloc_zero(mem_ctx, struct mapi_batch);
+	OPENCHANGE_RETVAL_IF(!_batch, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	_batch->session = session;
+	mapi_batch_reset(_batch);
+	OPENCHANGE_RETVAL_IF(!_batch->mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, _batch);
+
+	*batch = _batch;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Execute the pending operations if one more operation of
+   the given size could not be added to the request
+ */
+static enum MAPISTATUS mapi_batch_reserve(struct mapi_batch *batch, uint32_t size)
+{
+	if (!batch->count) return MAPI_E_SUCCESS;
+
+	/* an operation uses at most one new input and one output handle */
+	if ((batch->handle_count + 2 > MAPI_BATCH_HANDLES_MAX) ||
+	    (batch->size + size + 3 + sizeof (uint32_t) * (batch->handle_count + 2) > MAPI_EXTENDED_BUFFER_MAX_SIZE)) {
+		return mapi_batch_execute(batch);
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+
+static enum MAPISTATUS mapi_batch_add_handle(struct mapi_batch *batch, uint32_t handle, uint8_t *handle_idx)
+{
+	batch->handles = talloc_realloc(batch->mem_ctx, batch->handles, uint32_t, batch->handle_count + 1);
+	OPENCHANGE_RETVAL_IF(!batch->handles, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	batch->handles[batch->handle_count] = handle;
+	*handle_idx = batch->handle_count;
+	batch->handle_count++;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Find the handle slot of the object an operation applies
+   to: the output slot of the pending operation opening it, otherwise
+   a slot holding its handle
+ */
+static enum MAPISTATUS mapi_batch_get_input(struct mapi_batch *batch, mapi_object_t *obj,
+					    uint8_t *handle_idx, uint8_t *logon_id)
+{
+	enum MAPISTATUS		retval;
+	mapi_handle_t		handle;
+	uint32_t		i;
+
+	for (i = batch->count; i > 0; i--) {
+		if (batch->ops[i - 1].out_idx && batch->ops[i - 1].obj == obj) {
+			*handle_idx = batch->ops[i - 1].out_idx;
+			*logon_id = batch->ops[i - 1].logon_id;
+			return MAPI_E_SUCCESS;
+		}
+	}
+
+	OPENCHANGE_RETVAL_IF(mapi_object_get_session(obj) != batch->session, MAPI_E_INVALID_PARAMETER, NULL);
+	retval = mapi_object_get_logon_id(obj, logon_id);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	/* neither opened nor being opened by the batch */
+	handle = mapi_object_get_handle(obj);
+	OPENCHANGE_RETVAL_IF(handle == 0xffffffff, MAPI_E_INVALID_PARAMETER, NULL);
+
+	for (i = 0; i < batch->handle_count; i++) {
+		if (batch->handles[i] == handle) {
+			*handle_idx = i;
+			return MAPI_E_SUCCESS;
+		}
+	}
+
+	return mapi_batch_add_handle(batch, handle, handle_idx);
+}
+
+
+/**
+   \details Append an operation to the batch. Its request union is
+   left for the caller to fill.
+ */
+static struct mapi_batch_op *mapi_batch_push(struct mapi_batch *batch,
+					     uint8_t opnum,
+					     mapi_object_t *obj,
+					     bool output,
+					     uint32_t size,
+					     struct mapi_batch_future *future)
+{
+	struct mapi_batch_op	*op;
+	uint8_t			handle_idx;
+	uint8_t			logon_id;
+	uint8_t			out_idx = 0;
+
+	if (mapi_batch_get_input(batch, obj, &handle_idx, &logon_id) != MAPI_E_SUCCESS) {
+		return NULL;
+	}
+	if (output && mapi_batch_add_handle(batch, 0xffffffff, &out_idx) != MAPI_E_SUCCESS) {
+		return NULL;
+	}
+
+	batch->mapi_req = talloc_realloc(batch->mem_ctx, batch->mapi_req, struct EcDoRpc_MAPI_REQ, batch->count + 1);
+	batch->ops = talloc_realloc(batch->mem_ctx, batch->ops, struct mapi_batch_op, batch->count + 1);
+	if (!batch->mapi_req || !batch->ops) return NULL;
+
+	memset(&batch->mapi_req[batch->count], 0, sizeof (struct EcDoRpc_MAPI_REQ));
+	batch->mapi_req[batch->count].opnum = opnum;
+	batch->mapi_req[batch->count].logon_id = logon_id;
+	batch->mapi_req[batch->count].handle_idx = handle_idx;
+
+	op = &batch->ops[batch->count];
+	memset(op, 0, sizeof (struct mapi_batch_op));
+	op->opnum = opnum;
+	op->logon_id = logon_id;
+	op->handle_idx = handle_idx;
+	op->out_idx = out_idx;
+	op->future = future;
+	if (future) {
+		memset(future, 0, sizeof (struct mapi_batch_future));
+	}
+
+	batch->size += size + 3;
+	batch->count++;
+
+	return op;
+}
+
+
+/**
+   \details Queue an OpenFolder operation
+
+   \param batch pointer to the batch
+   \param obj_store the store or folder the folder is opened from; it
+   may be opened by a pending operation of the batch
+   \param id_folder the folder identifier
+   \param obj_folder the resulting folder, set when the batch is
+   executed
+   \param future pointer to the operation result, may be NULL
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa OpenFolder
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_OpenFolder(struct mapi_batch *batch,
+					       mapi_object_t *obj_store,
+					       mapi_id_t id_folder,
+					       mapi_object_t *obj_folder,
+					       struct mapi_batch_future *future)
+{
+	struct mapi_batch_op	*op;
+	struct OpenFolder_req	*request;
+	enum MAPISTATUS		retval;
+	uint32_t		size;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch || !obj_store || !obj_folder, MAPI_E_INVALID_PARAMETER, NULL);
+
+	size = sizeof (uint8_t) + sizeof (uint64_t) + sizeof (uint8_t);
+	retval = mapi_batch_reserve(batch, size);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op = mapi_batch_push(batch, op_MAPI_OpenFolder, obj_store, true, size, future);
+	OPENCHANGE_RETVAL_IF(!op, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	op->obj = obj_folder;
+	op->id = id_folder;
+
+	request = &batch->mapi_req[batch->count - 1].u.mapi_OpenFolder;
+	request->handle_idx = op->out_idx;
+	request->folder_id = id_folder;
+	request->OpenModeFlags = OpenModeFlags_Folder;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue an OpenMessage operation
+
+   \param batch pointer to the batch
+   \param obj_store the store the message is opened from; it may be
+   opened by a pending operation of the batch
+   \param id_folder the folder identifier
+   \param id_message the message identifier
+   \param obj_message the resulting message, set when the batch is
+   executed
+   \param ulFlags the open mode flags
+   \param future pointer to the operation result, may be NULL
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa OpenMessage
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_OpenMessage(struct mapi_batch *batch,
+						mapi_object_t *obj_store,
+						mapi_id_t id_folder,
+						mapi_id_t id_message,
+						mapi_object_t *obj_message,
+						uint8_t ulFlags,
+						struct mapi_batch_future *future)
+{
+	struct mapi_batch_op	*op;
+	struct OpenMessage_req	*request;
+	enum MAPISTATUS		retval;
+	uint32_t		size;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch || !obj_store || !obj_message, MAPI_E_INVALID_PARAMETER, NULL);
+
+	size = sizeof (uint8_t) + sizeof (uint16_t) + sizeof (mapi_id_t) + sizeof (uint8_t) + sizeof (mapi_id_t);
+	retval = mapi_batch_reserve(batch, size);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op = mapi_batch_push(batch, op_MAPI_OpenMessage, obj_store, true, size, future);
+	OPENCHANGE_RETVAL_IF(!op, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	op->obj = obj_message;
+	op->id = id_message;
+
+	request = &batch->mapi_req[batch->count - 1].u.mapi_OpenMessage;
+	request->handle_idx = op->out_idx;
+	request->CodePageId = 0xfff;
+	request->FolderId = id_folder;
+	request->OpenModeFlags = (enum OpenMessage_OpenModeFlags)ulFlags;
+	request->MessageId = id_message;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a GetContentsTable operation
+
+   \param batch pointer to the batch
+   \param obj_container the container; it may be opened by a pending
+   operation of the batch
+   \param obj_table the resulting table, set when the batch is
+   executed
+   \param TableFlags flags controlling the type of table
+   \param future pointer to the operation result, may be NULL. Its
+   RowCount field receives the number of rows of the table.
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa GetContentsTable
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_GetContentsTable(struct mapi_batch *batch,
+						     mapi_object_t *obj_container,
+						     mapi_object_t *obj_table,
+						     uint8_t TableFlags,
+						     struct mapi_batch_future *future)
+{
+	struct mapi_batch_op		*op;
+	struct GetContentsTable_req	*request;
+	enum MAPISTATUS			retval;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch || !obj_container || !obj_table, MAPI_E_INVALID_PARAMETER, NULL);
+
+	retval = mapi_batch_reserve(batch, 2);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op = mapi_batch_push(batch, op_MAPI_GetContentsTable, obj_container, true, 2, future);
+	OPENCHANGE_RETVAL_IF(!op, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	op->obj = obj_table;
+
+	request = &batch->mapi_req[batch->count - 1].u.mapi_GetContentsTable;
+	request->handle_idx = op->out_idx;
+	request->TableFlags = TableFlags;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a GetHierarchyTable operation
+
+   \param batch pointer to the batch
+   \param obj_container the container; it may be opened by a pending
+   operation of the batch
+   \param obj_table the resulting table, set when the batch is
+   executed
+   \param TableFlags flags controlling the type of table
+   \param future pointer to the operation result, may be NULL. Its
+   RowCount field receives the number of rows of the table.
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa GetHierarchyTable
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_GetHierarchyTable(struct mapi_batch *batch,
+						      mapi_object_t *obj_container,
+						      mapi_object_t *obj_table,
+						      uint8_t TableFlags,
+						      struct mapi_batch_future *future)
+{
+	struct mapi_batch_op		*op;
+	struct GetHierarchyTable_req	*request;
+	enum MAPISTATUS			retval;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch || !obj_container || !obj_table, MAPI_E_INVALID_PARAMETER, NULL);
+
+	retval = mapi_batch_reserve(batch, 2);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op = mapi_batch_push(batch, op_MAPI_GetHierarchyTable, obj_container, true, 2, future);
+	OPENCHANGE_RETVAL_IF(!op, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	op->obj = obj_table;
+
+	request = &batch->mapi_req[batch->count - 1].u.mapi_GetHierarchyTable;
+	request->handle_idx = op->out_idx;
+	request->TableFlags = TableFlags;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a SetColumns operation
+
+   \param batch pointer to the batch
+   \param obj_table the table; it may be opened by a pending operation
+   of the batch
+   \param properties the properties intended to be columns, copied
+   into the batch
+   \param future pointer to the operation result, may be NULL
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa SetColumns
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_SetColumns(struct mapi_batch *batch,
+					       mapi_object_t *obj_table,
+					       struct SPropTagArray *properties,
+					       struct mapi_batch_future *future)
+{
+	struct mapi_batch_op	*op;
+	struct SetColumns_req	*request;
+	enum MAPISTATUS		retval;
+	uint32_t		size;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch || !obj_table || !properties, MAPI_E_INVALID_PARAMETER, NULL);
+
+	size = 3 + properties->cValues * sizeof (uint32_t);
+	retval = mapi_batch_reserve(batch, size);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op = mapi_batch_push(batch, op_MAPI_SetColumns, obj_table, false, size, future);
+	OPENCHANGE_RETVAL_IF(!op, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	op->obj = obj_table;
+	op->properties.cValues = properties->cValues;
+	op->properties.aulPropTag = talloc_memdup(batch->mem_ctx, properties->aulPropTag,
+						  properties->cValues * sizeof (enum MAPITAGS));
+
+	request = &batch->mapi_req[batch->count - 1].u.mapi_SetColumns;
+	request->SetColumnsFlags = SetColumns_TBL_SYNC;
+	request->prop_count = op->properties.cValues;
+	request->properties = op->properties.aulPropTag;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a QueryRows operation
+
+   \param batch pointer to the batch
+   \param obj_table the table; it may be opened by a pending operation
+   of the batch
+   \param row_count the maximum number of rows to retrieve
+   \param flags flags to use for the query
+   \param future pointer to the operation result. Its rowSet field
+   receives the rows.
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa QueryRows
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_QueryRows(struct mapi_batch *batch,
+					      mapi_object_t *obj_table,
+					      uint16_t row_count,
+					      enum QueryRowsFlags flags,
+					      struct mapi_batch_future *future)
+{
+	struct mapi_batch_op	*op;
+	struct QueryRows_req	*request;
+	enum MAPISTATUS		retval;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch || !obj_table || !future, MAPI_E_INVALID_PARAMETER, NULL);
+
+	retval = mapi_batch_reserve(batch, 4);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op = mapi_batch_push(batch, op_MAPI_QueryRows, obj_table, false, 4, future);
+	OPENCHANGE_RETVAL_IF(!op, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	op->obj = obj_table;
+
+	request = &batch->mapi_req[batch->count - 1].u.mapi_QueryRows;
+	request->QueryRowsFlags = flags;
+	request->ForwardRead = 1;
+	request->RowCount = row_count;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a GetProps operation
+
+   \param batch pointer to the batch
+   \param obj the object; it may be opened by a pending operation of
+   the batch
+   \param flags MAPI_UNICODE to retrieve unicode strings
+   \param SPropTagArray the properties to retrieve, copied into the
+   batch
+   \param future pointer to the operation result. Its lpProps and
+   PropCount fields receive the property values.
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \note Unlike GetProps, named properties are not mapped: resolving
+   them would cost a GetIDsFromNames round-trip per object. Callers
+   map them beforehand or pass tags already known to the store.
+
+   \sa GetProps
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_GetProps(struct mapi_batch *batch,
+					     mapi_object_t *obj,
+					     uint32_t flags,
+					     struct SPropTagArray *SPropTagArray,
+					     struct mapi_batch_future *future)
+{
+	struct mapi_batch_op	*op;
+	struct GetProps_req	*request;
+	enum MAPISTATUS		retval;
+	uint32_t		size;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch || !obj || !SPropTagArray || !future, MAPI_E_INVALID_PARAMETER, NULL);
+
+	size = 3 * sizeof (uint16_t) + SPropTagArray->cValues * sizeof (uint32_t);
+	retval = mapi_batch_reserve(batch, size);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op = mapi_batch_push(batch, op_MAPI_GetProps, obj, false, size, future);
+	OPENCHANGE_RETVAL_IF(!op, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	op->obj = obj;
+	op->properties.cValues = SPropTagArray->cValues;
+	op->properties.aulPropTag = talloc_memdup(batch->mem_ctx, SPropTagArray->aulPropTag,
+						  SPropTagArray->cValues * sizeof (enum MAPITAGS));
+
+	request = &batch->mapi_req[batch->count - 1].u.mapi_GetProps;
+	request->PropertySizeLimit = 0x0;
+	request->WantUnicode = (flags & MAPI_UNICODE) != 0 ? true : 0x0;
+	request->prop_count = (uint16_t) op->properties.cValues;
+	request->properties = op->properties.aulPropTag;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Apply the reply of an operation to its object and future,
+   the way the matching synchronous call does
+ */
+static void mapi_batch_resolve(struct mapi_batch *batch,
+			       struct mapi_batch_op *op,
+			       struct mapi_response *mapi_response,
+			       struct EcDoRpc_MAPI_REPL *mapi_repl)
+{
+	struct mapi_session	*session = batch->session;
+	struct mapi_batch_future *future = op->future;
+	mapi_object_table_t	*table;
+	enum MAPISTATUS		retval;
+
+	retval = mapi_repl ? mapi_repl->error_code : MAPI_E_CALL_FAILED;
+	/* SetColumns and GetProps partially succeed with warnings */
+	if (retval && !(retval == MAPI_W_ERRORS_RETURNED &&
+			(op->opnum == op_MAPI_SetColumns || op->opnum == op_MAPI_GetProps))) {
+		goto end;
+	}
+
+	if (op->out_idx) {
+		mapi_object_set_session(op->obj, session);
+		mapi_object_set_handle(op->obj, mapi_response->handles[op->out_idx]);
+		mapi_object_set_logon_id(op->obj, op->logon_id);
+	}
+
+	switch (op->opnum) {
+	case op_MAPI_OpenFolder:
+		mapi_object_set_id(op->obj, op->id);
+		break;
+	case op_MAPI_OpenMessage:
+		mapi_object_message_init(session, op->obj, &mapi_repl->u.mapi_OpenMessage);
+		break;
+	case op_MAPI_GetContentsTable:
+		if (future) {
+			future->RowCount = mapi_repl->u.mapi_GetContentsTable.RowCount;
+		}
+		mapi_object_table_init((TALLOC_CTX *)session, op->obj);
+		break;
+	case op_MAPI_GetHierarchyTable:
+		if (future) {
+			future->RowCount = mapi_repl->u.mapi_GetHierarchyTable.RowCount;
+		}
+		mapi_object_table_init((TALLOC_CTX *)session, op->obj);
+		break;
+	case op_MAPI_SetColumns:
+		retval = MAPI_E_SUCCESS;
+		if (op->obj->private_data == NULL) {
+			op->obj->private_data = talloc_zero((TALLOC_CTX *)session, mapi_object_table_t);
+		}
+		table = (mapi_object_table_t *)op->obj->private_data;
+		if (table) {
+			table->proptags.cValues = op->properties.cValues;
+			table->proptags.aulPropTag = talloc_memdup((TALLOC_CTX *)table, op->properties.aulPropTag,
+								   op->properties.cValues * sizeof (enum MAPITAGS));
+		}
+		break;
+	case op_MAPI_QueryRows:
+		table = (mapi_object_table_t *)op->obj->private_data;
+		if (!table) {
+			retval = MAPI_E_INVALID_OBJECT;
+			break;
+		}
+		future->rowSet.cRows = mapi_repl->u.mapi_QueryRows.RowCount;
+		future->rowSet.aRow = talloc_array((TALLOC_CTX *)table, struct SRow, future->rowSet.cRows);
+		emsmdb_get_SRowSet((TALLOC_CTX *)future->rowSet.aRow, &future->rowSet,
+				   &table->proptags, &mapi_repl->u.mapi_QueryRows.RowData);
+		break;
+	case op_MAPI_GetProps:
+		if (emsmdb_get_SPropValue((TALLOC_CTX *)session, &mapi_repl->u.mapi_GetProps.prop_data,
+					  &op->properties, &future->lpProps, &future->PropCount,
+					  mapi_repl->u.mapi_GetProps.layout) != MAPI_E_SUCCESS) {
+			retval = MAPI_E_SUCCESS;
+		}
+		break;
+	}
+
+end:
+	if (future) {
+		future->done = true;
+		future->retval = retval;
+	}
+}
+
+
+/**
+   \details Send the pending operations of a batch in a single request
+
+   The objects opened by the operations are set and the futures are
+   filled with the result of each operation. An operation using an
+   object whose opening failed fails as well.
+
+   \param batch pointer to the batch
+
+   \return MAPI_E_SUCCESS if the request was exchanged, otherwise MAPI
+   error. The result of each operation is stored in its future.
+
+   \note Developers may also call GetLastError() to retrieve the last
+   MAPI error code. Possible MAPI error codes are:
+   - MAPI_E_INVALID_PARAMETER: batch is NULL
+   - MAPI_E_CALL_FAILED: A network problem was encountered during the
+     transaction
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_execute(struct mapi_batch *batch)
+{
+	struct mapi_request		*mapi_request;
+	struct mapi_response		*mapi_response;
+	struct EcDoRpc_MAPI_REPL	*mapi_repl;
+	NTSTATUS			status;
+	enum MAPISTATUS			retval = MAPI_E_SUCCESS;
+	uint32_t			i;
+	uint32_t			j = 0;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch, MAPI_E_INVALID_PARAMETER, NULL);
+	if (!batch->count) return MAPI_E_SUCCESS;
+
+	/* Fill the mapi_request structure */
+	mapi_request = talloc_zero(batch->mem_ctx, struct mapi_request);
+	OPENCHANGE_RETVAL_IF(!mapi_request, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	mapi_request->mapi_len = batch->size + sizeof (uint32_t) * batch->handle_count;
+	mapi_request->length = batch->size;
+	mapi_request->mapi_req = batch->mapi_req;
+	mapi_request->handles = batch->handles;
+
+	status = emsmdb_transaction_wrapper(batch->session, batch->mem_ctx, mapi_request, &mapi_response);
+	batch->round_trips++;
+	if (!NT_STATUS_IS_OK(status) || !mapi_response->mapi_repl) {
+		retval = MAPI_E_CALL_FAILED;
+		mapi_response = NULL;
+	}
+
+	/* Replies come in the order of the operations; the server stops
+	 * at the first one it could not process */
+	for (i = 0; i < batch->count; i++) {
+		mapi_repl = NULL;
+		if (mapi_response && mapi_response->mapi_repl[j].opnum == batch->ops[i].opnum) {
+			mapi_repl = &mapi_response->mapi_repl[j++];
+		}
+		mapi_batch_resolve(batch, &batch->ops[i], mapi_response, mapi_repl);
+	}
+
+	if (mapi_response) {
+		OPENCHANGE_CHECK_NOTIFICATION(batch->session, mapi_response);
+		talloc_free(mapi_response);
+	}
+	mapi_batch_reset(batch);
+
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	return MAPI_E_SUCCESS;
+}
@@ -0,0 +1,57 @@
+/*
+   OpenChange MAPI implementation.
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef	__MAPI_BATCH_H
+#define	__MAPI_BATCH_H
+
+/* Result of an operation queued in a batch, filled when the batch
+ * is executed */
+struct mapi_batch_future {
+	bool			done;
+	enum MAPISTATUS		retval;
+	uint32_t		RowCount;	/* GetContentsTable, GetHierarchyTable */
+	struct SRowSet		rowSet;		/* QueryRows */
+	struct SPropValue	*lpProps;	/* GetProps */
+	uint32_t		PropCount;	/* GetProps */
+};
+
+struct mapi_batch_op {
+	uint8_t				opnum;
+	uint8_t				logon_id;
+	uint8_t				handle_idx;
+	uint8_t				out_idx;
+	mapi_object_t			*obj;
+	mapi_id_t			id;
+	struct SPropTagArray		properties;
+	struct mapi_batch_future	*future;
+};
+
+struct mapi_batch {
+	struct mapi_session		*session;
+	TALLOC_CTX			*mem_ctx;
+	struct EcDoRpc_MAPI_REQ		*mapi_req;
+	struct mapi_batch_op		*ops;
+	uint32_t			*handles;
+	uint32_t			handle_count;
+	uint32_t			count;
+	uint32_t			size;
+	uint32_t			round_trips;
+};
+
+#endif /* __MAPI_BATCH_H */
@@ -30,6 +30,114 @@
 */
 
 
+/**
+   \details Return the position in a mapi_nameid_tags index of the
+   first entry whose proptag or lid is not lower than key
+ */
+static uint32_t mapi_nameid_tags_lower_bound(const uint16_t *by_key, uint32_t count,
+					     bool lid, uint32_t key)
+{
+	uint32_t	low = 0;
+	uint32_t	high = count;
+	uint32_t	mid;
+	uint32_t	value;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		value = lid ? mapi_nameid_tags[by_key[mid]].lid : mapi_nameid_tags[by_key[mid]].proptag;
+		if (value < key) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+
+/**
+   \details Find the first mapi_nameid_tags entry matching proptag
+
+   \return the entry position on success, otherwise MAPI_NAMEID_TAGS_COUNT
+ */
+static uint32_t mapi_nameid_tags_find_proptag(uint32_t proptag)
+{
+	uint32_t	pos;
+
+	pos = mapi_nameid_tags_lower_bound(mapi_nameid_tags_by_proptag, MAPI_NAMEID_TAGS_COUNT, false, proptag);
+	if (pos < MAPI_NAMEID_TAGS_COUNT && mapi_nameid_tags[mapi_nameid_tags_by_proptag[pos]].proptag == proptag) {
+		return mapi_nameid_tags_by_proptag[pos];
+	}
+
+	return MAPI_NAMEID_TAGS_COUNT;
+}
+
+
+/**
+   \details Find the first mapi_nameid_tags entry matching the
+   lid,OLEGUID couple
+
+   \return the entry position on success, otherwise MAPI_NAMEID_TAGS_COUNT
+ */
+static uint32_t mapi_nameid_tags_find_lid(uint16_t lid, const char *OLEGUID)
+{
+	uint32_t	pos;
+	uint32_t	idx;
+
+	/* Entries sharing a lid are kept in table order by the index */
+	for (pos = mapi_nameid_tags_lower_bound(mapi_nameid_tags_by_lid, MAPI_NAMEID_TAGS_COUNT, true, lid);
+	     pos < MAPI_NAMEID_TAGS_COUNT; pos++) {
+		idx = mapi_nameid_tags_by_lid[pos];
+		if (mapi_nameid_tags[idx].lid != lid) break;
+		if (!strcmp(mapi_nameid_tags[idx].OLEGUID, OLEGUID)) {
+			return idx;
+		}
+	}
+
+	return MAPI_NAMEID_TAGS_COUNT;
+}
+
+
+/**
+   \details Find the first mapi_nameid_tags entry whose OOM (or Name)
+   and OLEGUID match
+
+   \param Name whether to search the Name field instead of the OOM one
+
+   \return the entry position on success, otherwise MAPI_NAMEID_TAGS_COUNT
+ */
+static uint32_t mapi_nameid_tags_find_string(bool Name, const char *key, const char *OLEGUID)
+{
+	const uint16_t	*by_key = Name ? mapi_nameid_tags_by_Name : mapi_nameid_tags_by_OOM;
+	uint32_t	count = Name ? MAPI_NAMEID_TAGS_NAME_COUNT : MAPI_NAMEID_TAGS_OOM_COUNT;
+	uint32_t	low = 0;
+	uint32_t	high = count;
+	uint32_t	mid;
+	uint32_t	idx;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		idx = by_key[mid];
+		if (strcmp(Name ? mapi_nameid_tags[idx].Name : mapi_nameid_tags[idx].OOM, key) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	for (; low < count; low++) {
+		idx = by_key[low];
+		if (strcmp(Name ? mapi_nameid_tags[idx].Name : mapi_nameid_tags[idx].OOM, key)) break;
+		if (!strcmp(mapi_nameid_tags[idx].OLEGUID, OLEGUID)) {
+			return idx;
+		}
+	}
+
+	return MAPI_NAMEID_TAGS_COUNT;
+}
+
+
 /**
    \details Create a new mapi_nameid structure
 
@@ -89,35 +197,32 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_add(struct mapi_nameid *mapi_nameid,
 	OPENCHANGE_RETVAL_IF(!OOM, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].OOM &&
-		    !strcmp(OOM, mapi_nameid_tags[i].OOM) && 
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid, 
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind)mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
+	i = mapi_nameid_tags_find_string(false, OOM, OLEGUID);
+	if (i < MAPI_NAMEID_TAGS_COUNT) {
+		mapi_nameid->nameid = talloc_realloc(mapi_nameid, 
+						     mapi_nameid->nameid, struct MAPINAMEID,
+						     mapi_nameid->count + 1);
+		mapi_nameid->entries = talloc_realloc(mapi_nameid,
+						    mapi_nameid->entries, struct mapi_nameid_tags,
+						    mapi_nameid->count + 1);
+		count = mapi_nameid->count;
+
+		mapi_nameid->entries[count] = mapi_nameid_tags[i];
+
+		mapi_nameid->nameid[count].ulKind = (enum ulKind)mapi_nameid_tags[i].ulKind;
+		GUID_from_string(mapi_nameid_tags[i].OLEGUID,
+				 &(mapi_nameid->nameid[count].lpguid));
+		switch (mapi_nameid_tags[i].ulKind) {
+		case MNID_ID:
+			mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
+			break;
+		case MNID_STRING:
+			mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
+			mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
+			break;
 		}
+		mapi_nameid->count++;
+		return MAPI_E_SUCCESS;
 	}
 
 	return MAPI_E_NOT_FOUND;
@@ -155,34 +260,32 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_add(struct mapi_nameid *mapi_nameid,
 	OPENCHANGE_RETVAL_IF(!lid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if ((lid == mapi_nameid_tags[i].lid) &&
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid, 
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
+	i = mapi_nameid_tags_find_lid(lid, OLEGUID);
+	if (i < MAPI_NAMEID_TAGS_COUNT) {
+		mapi_nameid->nameid = talloc_realloc(mapi_nameid, 
+						     mapi_nameid->nameid, struct MAPINAMEID,
+						     mapi_nameid->count + 1);
+		mapi_nameid->entries = talloc_realloc(mapi_nameid,
+						    mapi_nameid->entries, struct mapi_nameid_tags,
+						    mapi_nameid->count + 1);
+		count = mapi_nameid->count;
+
+		mapi_nameid->entries[count] = mapi_nameid_tags[i];
+
+		mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
+		GUID_from_string(mapi_nameid_tags[i].OLEGUID,
+				 &(mapi_nameid->nameid[count].lpguid));
+		switch (mapi_nameid_tags[i].ulKind) {
+		case MNID_ID:
+			mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
+			break;
+		case MNID_STRING:
+			mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
+			mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
+			break;
 		}
+		mapi_nameid->count++;
+		return MAPI_E_SUCCESS;
 	}
 
 	return MAPI_E_NOT_FOUND;	
@@ -221,35 +324,32 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_add(struct mapi_nameid *mapi_nameid,
 	OPENCHANGE_RETVAL_IF(!Name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name && 
-		    !strcmp(Name, mapi_nameid_tags[i].Name) &&
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid, 
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
+	i = mapi_nameid_tags_find_string(true, Name, OLEGUID);
+	if (i < MAPI_NAMEID_TAGS_COUNT) {
+		mapi_nameid->nameid = talloc_realloc(mapi_nameid, 
+						     mapi_nameid->nameid, struct MAPINAMEID,
+						     mapi_nameid->count + 1);
+		mapi_nameid->entries = talloc_realloc(mapi_nameid,
+						    mapi_nameid->entries, struct mapi_nameid_tags,
+						    mapi_nameid->count + 1);
+		count = mapi_nameid->count;
+
+		mapi_nameid->entries[count] = mapi_nameid_tags[i];
+
+		mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
+		GUID_from_string(mapi_nameid_tags[i].OLEGUID,
+				 &(mapi_nameid->nameid[count].lpguid));
+		switch (mapi_nameid_tags[i].ulKind) {
+		case MNID_ID:
+			mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
+			break;
+		case MNID_STRING:
+			mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
+			mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
+			break;
 		}
+		mapi_nameid->count++;
+		return MAPI_E_SUCCESS;
 	}
 
 	return MAPI_E_NOT_FOUND;
@@ -387,33 +487,32 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_canonical_add(struct mapi_nameid *mapi_name
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!proptag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].proptag == proptag) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							      mapi_nameid->entries, struct mapi_nameid_tags,
-							      mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
+	i = mapi_nameid_tags_find_proptag(proptag);
+	if (i < MAPI_NAMEID_TAGS_COUNT) {
+		mapi_nameid->nameid = talloc_realloc(mapi_nameid,
+						     mapi_nameid->nameid, struct MAPINAMEID,
+						     mapi_nameid->count + 1);
+		mapi_nameid->entries = talloc_realloc(mapi_nameid,
+						      mapi_nameid->entries, struct mapi_nameid_tags,
+						      mapi_nameid->count + 1);
+		count = mapi_nameid->count;
+
+		mapi_nameid->entries[count] = mapi_nameid_tags[i];
+
+		mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
+		GUID_from_string(mapi_nameid_tags[i].OLEGUID,
+				 &(mapi_nameid->nameid[count].lpguid));
+		switch (mapi_nameid_tags[i].ulKind) {
+		case MNID_ID:
+			mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
+			break;
+		case MNID_STRING:
+			mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
+			mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
+			break;
 		}
+		mapi_nameid->count++;
+		return MAPI_E_SUCCESS;
 	}
 
 	return MAPI_E_NOT_FOUND;
@@ -432,10 +531,9 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_property_lookup(uint32_t proptag)
 {
 	uint32_t	i;
 
-	for (i = 0; mapi_nameid_tags[i].proptag; i++) {
-		if (mapi_nameid_tags[i].proptag == proptag) {
-			return MAPI_E_SUCCESS;
-		}
+	i = mapi_nameid_tags_find_proptag(proptag);
+	if (i < MAPI_NAMEID_TAGS_COUNT) {
+		return MAPI_E_SUCCESS;
 	}
 
 	return MAPI_E_NOT_FOUND;
@@ -466,13 +564,10 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_lookup(const char *OOM, const char *OLE
 	OPENCHANGE_RETVAL_IF(!OOM, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].OOM && 
-		    !strcmp(mapi_nameid_tags[i].OOM, OOM) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
+	i = mapi_nameid_tags_find_string(false, OOM, OLEGUID);
+	if (i < MAPI_NAMEID_TAGS_COUNT) {
+		*propType = mapi_nameid_tags[i].propType;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -503,12 +598,10 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_lookup(uint16_t lid, const char *OLEGUI
 	OPENCHANGE_RETVAL_IF(!lid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].lid == lid &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
+	i = mapi_nameid_tags_find_lid(lid, OLEGUID);
+	if (i < MAPI_NAMEID_TAGS_COUNT) {
+		*propType = mapi_nameid_tags[i].propType;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -540,12 +633,10 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_lookup_canonical(uint16_t lid, const ch
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!propTag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].lid == lid &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propTag = mapi_nameid_tags[i].proptag;
-			return MAPI_E_SUCCESS;
-		}
+	i = mapi_nameid_tags_find_lid(lid, OLEGUID);
+	if (i < MAPI_NAMEID_TAGS_COUNT) {
+		*propTag = mapi_nameid_tags[i].proptag;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -577,13 +668,10 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_lookup(const char *Name,
 	OPENCHANGE_RETVAL_IF(!Name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name &&
-		    !strcmp(mapi_nameid_tags[i].Name, Name) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
+	i = mapi_nameid_tags_find_string(true, Name, OLEGUID);
+	if (i < MAPI_NAMEID_TAGS_COUNT) {
+		*propType = mapi_nameid_tags[i].propType;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -616,13 +704,10 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_lookup_canonical(const char *Name,
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!propTag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name &&
-		    !strcmp(mapi_nameid_tags[i].Name, Name) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propTag = mapi_nameid_tags[i].proptag;
-			return MAPI_E_SUCCESS;
-		}
+	i = mapi_nameid_tags_find_string(true, Name, OLEGUID);
+	if (i < MAPI_NAMEID_TAGS_COUNT) {
+		*propTag = mapi_nameid_tags[i].proptag;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -964,22 +1049,44 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_GetIDsFromNames(struct mapi_nameid *mapi_na
 	return MAPI_E_SUCCESS;
 }
 
+/**
+   \details Return the position in mapi_nameid_names_by_proptag of the
+   first entry whose property tag is not lower than proptag
+ */
+static uint32_t mapi_nameid_names_lower_bound(uint32_t proptag)
+{
+	uint32_t	low = 0;
+	uint32_t	high = MAPI_NAMEID_NAMES_COUNT;
+	uint32_t	mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (mapi_nameid_names[mapi_nameid_names_by_proptag[mid]].proptag < proptag) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
 _PUBLIC_ const char *get_namedid_name(uint32_t proptag)
 {
-	uint32_t idx;
+	uint32_t pos;
 
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if (mapi_nameid_names[idx].proptag == proptag) { 
-			return mapi_nameid_names[idx].propname;
-		}
+	pos = mapi_nameid_names_lower_bound(proptag);
+	if (pos < MAPI_NAMEID_NAMES_COUNT &&
+	    mapi_nameid_names[mapi_nameid_names_by_proptag[pos]].proptag == proptag) {
+		return mapi_nameid_names[mapi_nameid_names_by_proptag[pos]].propname;
 	}
 	if (((proptag & 0xFFFF) == PT_STRING8) ||
 	    ((proptag & 0xFFFF) == PT_MV_STRING8)) {
 		proptag += 1; /* try as _UNICODE variant */
-	}
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if (mapi_nameid_names[idx].proptag == proptag) { 
-			return mapi_nameid_names[idx].propname;
+		pos = mapi_nameid_names_lower_bound(proptag);
+		if (pos < MAPI_NAMEID_NAMES_COUNT &&
+		    mapi_nameid_names[mapi_nameid_names_by_proptag[pos]].proptag == proptag) {
+			return mapi_nameid_names[mapi_nameid_names_by_proptag[pos]].propname;
 		}
 	}
 	return NULL;
@@ -987,11 +1094,20 @@ _PUBLIC_ const char *get_namedid_name(uint32_t proptag)
 
 _PUBLIC_ uint32_t get_namedid_value(const char *propname)
 {
-	uint32_t idx;
-
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if (!strcmp(mapi_nameid_names[idx].propname, propname)) { 
-			return mapi_nameid_names[idx].proptag;
+	uint32_t	low = 0;
+	uint32_t	high = MAPI_NAMEID_NAMES_COUNT;
+	uint32_t	mid;
+	int		ret;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		ret = strcmp(mapi_nameid_names[mapi_nameid_names_by_propname[mid]].propname, propname);
+		if (!ret) {
+			return mapi_nameid_names[mapi_nameid_names_by_propname[mid]].proptag;
+		} else if (ret < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
 		}
 	}
 
@@ -1000,17 +1116,24 @@ _PUBLIC_ uint32_t get_namedid_value(const char *propname)
 
 _PUBLIC_ uint16_t get_namedid_type(uint16_t untypedtag)
 {
+	uint32_t	pos;
 	uint32_t	idx;
+	uint32_t	found = MAPI_NAMEID_NAMES_COUNT;
 	uint16_t	current_type;
 
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if ((mapi_nameid_names[idx].proptag >> 16) == untypedtag) {
-			current_type = mapi_nameid_names[idx].proptag & 0xFFFF;
-			if (current_type != PT_ERROR && current_type != PT_STRING8) {
-				return current_type;
-			}
+	/* Keep the first matching entry in table order */
+	for (pos = mapi_nameid_names_lower_bound(untypedtag << 16);
+	     pos < MAPI_NAMEID_NAMES_COUNT; pos++) {
+		idx = mapi_nameid_names_by_proptag[pos];
+		if ((mapi_nameid_names[idx].proptag >> 16) != untypedtag) break;
+		current_type = mapi_nameid_names[idx].proptag & 0xFFFF;
+		if (current_type != PT_ERROR && current_type != PT_STRING8 && idx < found) {
+			found = idx;
 		}
 	}
+	if (found < MAPI_NAMEID_NAMES_COUNT) {
+		return mapi_nameid_names[found].proptag & 0xFFFF;
+	}
 
 	DEBUG(5, ("%s: type for property '%x' could not be deduced\n", __FUNCTION__, untypedtag));
 	return 0;
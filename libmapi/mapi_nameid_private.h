@@ -1176,4 +1176,275 @@ static struct mapi_nameid_names mapi_nameid_names[] = {
 
 };
 
+#define	MAPI_NAMEID_TAGS_COUNT	582
+#define	MAPI_NAMEID_NAMES_COUNT	581
+
+static const uint16_t mapi_nameid_tags_by_proptag[] = {
+	 222,  248,  229,  232,  231,  242,  240,  243,  226,  230,  246,  244,
+	 245,  227,  228,  225,  247,  234,  249,  142,  235,  237,  241,  223,
+	 224,  221,  233,  236,  239,  238,  168,  171,  183,  175,  176,  186,
+	  52,   53,   10,   64,   15,   56,   57,   66,   61,   63,    9,    4,
+	  54,   39,    1,    0,   59,   74,   75,   73,    8,    7,  185,   67,
+	  72,   70,   68,   71,   16,    5,    3,   11,   12,   13,   14,   18,
+	  19,   17,   60,   20,   22,   21,   23,   24,   25,   26,   28,   27,
+	  29,   30,   31,   32,   34,   33,   35,   36,   37,   38,   40,   41,
+	  42,   43,   44,   45,   46,   47,   48,   49,   50,   51,   55,   58,
+	  69,   62,    2,    6,   65,  356,  327,  360,  354,  337,  352,  329,
+	 336,  335,  330,  338,  359,  355,  344,  351,  332,  357,  342,  358,
+	 333,  339,  349,  346,  331,  345,  348,  347,  343,  341,  353,  350,
+	 328,  340,  334,   94,   95,   85,  110,  108,  119,   78,  127,  128,
+	 121,  126,   98,   84,   97,   83,   82,   96,   81,   79,  100,   91,
+	  99,  137,   93,  136,  125,  105,  117,  120,  118,  133,  123,   92,
+	 135,  134,  140,  139,  112,  111,  132,   76,  106,  141,  109,  361,
+	 114,  115,  116,  131,  107,   77,  113,  129,  130,   90,   89,   88,
+	  80,   87,   86,  104,  103,  101,  102,  122,  124,  138,  188,  194,
+	 192,  196,  195,  184,  145,  199,  198,  200,  154,  153,  203,  202,
+	 146,  190,  197,  191,  189,  210,  209,  169,  147,  179,  178,  177,
+	 155,  159,  182,  181,  180,  166,  167,  193,  173,  174,  207,  158,
+	 156,  157,  201,  204,  205,  206,  172,  152,  148,  149,  150,  151,
+	 187,  208,  170,  162,  163,  161,  165,  160,  164,  143,  144,  219,
+	 218,  215,  216,  217,  212,  214,  213,  211,  220,  256,  259,  258,
+	 257,  255,  260,  261,  317,  294,  295,  296,  307,  305,  310,  277,
+	 278,  276,  272,  293,  311,  306,  285,  284,  288,  271,  287,  274,
+	 265,  273,  262,  299,  292,  279,  309,  291,  281,  270,  303,  283,
+	 266,  316,  318,  314,  313,  289,  320,  269,  321,  263,  275,  301,
+	 325,  324,  323,  326,  268,  267,  298,  297,  308,  286,  300,  302,
+	 282,  315,  304,  264,  280,  322,  312,  290,  319,  250,  252,  251,
+	 253,  254,  581,  362,  363,  364,  365,  366,  367,  368,  369,  370,
+	 371,  372,  373,  374,  375,  376,  377,  378,  379,  380,  381,  382,
+	 383,  384,  385,  386,  387,  388,  389,  390,  391,  392,  393,  394,
+	 395,  396,  397,  398,  399,  400,  401,  402,  403,  404,  405,  406,
+	 407,  408,  409,  410,  411,  412,  413,  414,  415,  416,  417,  418,
+	 419,  420,  421,  422,  423,  424,  425,  426,  427,  428,  429,  430,
+	 431,  432,  433,  434,  435,  436,  437,  438,  439,  440,  441,  442,
+	 443,  444,  445,  446,  447,  448,  449,  450,  451,  452,  453,  454,
+	 455,  456,  457,  458,  459,  460,  461,  462,  463,  464,  465,  466,
+	 467,  468,  469,  470,  471,  472,  473,  474,  475,  476,  477,  478,
+	 479,  480,  481,  482,  483,  484,  485,  486,  487,  488,  489,  490,
+	 491,  492,  493,  494,  495,  496,  497,  498,  499,  500,  501,  502,
+	 503,  504,  505,  506,  507,  508,  509,  510,  511,  512,  513,  514,
+	 515,  516,  517,  518,  519,  520,  521,  522,  523,  524,  525,  526,
+	 527,  528,  529,  530,  531,  532,  533,  534,  535,  536,  537,  538,
+	 539,  540,  541,  542,  543,  544,  545,  546,  547,  548,  549,  550,
+	 551,  552,  553,  554,  555,  556,  557,  558,  559,  560,  561,  562,
+	 563,  564,  565,  566,  567,  568,  569,  570,  571,  572,  573,  574,
+	 575,  576,  577,  578,  579,  580,
+};
+
+static const uint16_t mapi_nameid_tags_by_lid[] = {
+	 363,  364,  365,  366,  367,  368,  369,  370,  371,  372,  373,  374,
+	 375,  376,  377,  378,  379,  380,  381,  382,  383,  384,  385,  386,
+	 387,  388,  389,  390,  391,  392,  393,  394,  395,  396,  397,  398,
+	 399,  400,  401,  402,  403,  404,  405,  406,  407,  408,  409,  410,
+	 411,  412,  413,  414,  415,  416,  417,  418,  419,  420,  421,  422,
+	 423,  424,  425,  426,  427,  428,  429,  430,  431,  432,  433,  434,
+	 435,  436,  437,  438,  439,  440,  441,  442,  443,  444,  445,  446,
+	 447,  448,  449,  450,  451,  452,  453,  454,  455,  456,  457,  458,
+	 459,  460,  461,  462,  463,  464,  465,  466,  467,  468,  469,  470,
+	 471,  472,  473,  474,  475,  476,  477,  478,  479,  480,  481,  482,
+	 483,  484,  485,  486,  487,  488,  489,  490,  491,  492,  493,  494,
+	 495,  496,  497,  498,  499,  500,  501,  502,  503,  504,  505,  506,
+	 507,  508,  509,  510,  511,  512,  513,  514,  515,  516,  517,  518,
+	 519,  520,  521,  522,  523,  524,  525,  526,  527,  528,  529,  530,
+	 531,  532,  533,  534,  535,  536,  537,  538,  539,  540,  541,  542,
+	 543,  544,  545,  546,  547,  548,  549,  550,  551,  552,  553,  554,
+	 555,  556,  557,  558,  559,  560,  561,  562,  563,  564,  565,  566,
+	 567,  568,  569,  570,  571,  572,  573,  574,  575,  576,  577,  578,
+	 579,  580,  222,  248,  229,  232,  231,  242,  240,  243,  226,  230,
+	 246,  244,  245,  227,  228,  225,  247,  234,  249,  142,  235,  237,
+	 241,  223,  224,  221,  233,  236,  239,  238,  168,  171,  183,  175,
+	 176,  186,   52,   53,   10,   64,   15,   56,   57,   66,   61,   63,
+	   9,    4,   54,   39,    1,    0,   59,   74,   75,   73,    8,    7,
+	 185,   67,   72,   70,   68,   71,   16,    5,    3,   11,   12,   13,
+	  14,   18,   19,   17,   60,   20,   22,   21,   23,   24,   25,   26,
+	  28,   27,   29,   30,   31,   32,   34,   33,   35,   36,   37,   38,
+	  40,   41,   42,   43,   44,   45,   46,   47,   48,   49,   50,   51,
+	  55,   58,   69,   62,    2,    6,   65,  356,  327,  360,  354,  337,
+	 352,  329,  336,  335,  330,  338,  359,  355,  344,  351,  332,  357,
+	 342,  358,  333,  339,  349,  346,  331,  345,  348,  347,  343,  341,
+	 353,  350,  328,  340,  334,   94,   95,   85,  110,  108,  119,   78,
+	 127,  128,  121,  126,   98,   84,   97,   83,   82,   96,   81,   79,
+	 100,   91,   99,  137,   93,  136,  125,  105,  117,  120,  118,  133,
+	 123,   92,  135,  134,  140,  139,  112,  111,  132,   76,  106,  141,
+	 109,  361,  114,  115,  116,  131,  107,   77,  113,  129,  130,   90,
+	  89,   88,   80,   87,   86,  104,  103,  101,  102,  122,  124,  138,
+	 188,  194,  192,  196,  195,  184,  145,  199,  198,  200,  154,  153,
+	 203,  202,  146,  190,  197,  191,  189,  210,  209,  169,  147,  179,
+	 178,  177,  155,  159,  182,  181,  180,  166,  167,  193,  173,  174,
+	 207,  158,  156,  157,  201,  204,  205,  206,  172,  152,  148,  149,
+	 150,  151,  187,  208,  170,  162,  163,  161,  165,  160,  164,  143,
+	 144,  219,  218,  215,  216,  217,  212,  214,  213,  211,  220,  256,
+	 259,  258,  257,  255,  260,  261,  317,  294,  295,  296,  307,  305,
+	 310,  277,  278,  276,  272,  293,  311,  306,  285,  284,  288,  271,
+	 287,  274,  265,  273,  262,  299,  292,  279,  309,  291,  281,  270,
+	 303,  283,  266,  316,  318,  314,  313,  289,  320,  269,  321,  263,
+	 275,  301,  325,  324,  323,  326,  268,  267,  298,  297,  308,  286,
+	 300,  302,  282,  315,  304,  264,  280,  322,  312,  290,  319,  250,
+	 252,  251,  253,  254,  581,  362,
+};
+
+#define	MAPI_NAMEID_TAGS_OOM_COUNT	364
+
+static const uint16_t mapi_nameid_tags_by_OOM[] = {
+	   0,    1,    2,  145,   76,   77,    3,   65,   78,    6,   79,   80,
+	  81,   82,   83,   84,   85,  221,   86,   87,   88,   89,   90,   91,
+	  92,   93,   95,   94,   96,   97,   98,   99,  100,  101,  102,  103,
+	 104,  105,  106,    4,  107,    7,    8,  147,    5,  108,  109,  362,
+	 110,  149,  150,  151,  148,  152,  224,  142,  111,  112,  113,  153,
+	 154,  155,  114,  115,    9,   10,  156,  157,  158,   11,   12,   13,
+	  14,  159,  160,  161,  162,  163,  164,  165,  166,  167,   16,   17,
+	  18,   19,   20,   15,  116,   21,   22,   23,   24,   25,   26,   32,
+	  38,   27,   28,   29,   30,   31,   33,   34,   35,   36,   37,   39,
+	 117,  143,  144,  118,  119,  120,  123,   40,   41,   42,   43,   44,
+	  45,   46,   47,   48,   49,   50,   51,   52,   53,   54,  170,  122,
+	  55,  121,   59,   56,   57,   58,  124,  173,  174,   60,  125,  138,
+	 222,  223,  225,  226,  227,  228,  229,  230,  231,  232,  234,  235,
+	 240,  241,  237,  242,  243,  244,  245,  246,  247,  248,  249,  126,
+	 127,  211,  212,  213,  214,  215,  216,  217,  218,  219,  220,  128,
+	 233,  168,  172,  175,  183,  186,  129,  180,  181,  182,  177,  178,
+	 179,  250,  251,  252,  253,  254,  236,  238,  239,  130,  131,  132,
+	  61,   62,  133,  327,  255,  256,  257,  258,  259,  260,  261,   63,
+	 184,  185,  134,  135,  136,  187,   64,  188,  189,  193,  190,  191,
+	 192,  194,  195,  196,  197,  198,  581,  169,  137,  262,  263,  264,
+	 265,  266,  267,  268,  269,  270,  271,  272,  273,  274,  275,  276,
+	 277,  278,  279,  280,  281,  282,  283,  284,  285,  286,  287,  288,
+	 289,  290,  291,  292,  293,  294,  295,  296,  297,  298,  299,  300,
+	 301,  302,  303,  304,  305,  306,  307,  308,  309,  310,  311,  312,
+	 313,  314,  315,  316,  317,  318,  319,  320,  321,  322,  323,  324,
+	 325,  326,  199,  200,  146,  201,  329,  330,  334,  333,  335,  336,
+	 328,  331,  337,  338,  339,  340,  341,  202,  342,  343,  344,  345,
+	 203,  346,  332,  347,  348,  349,  350,  351,  352,  353,  357,  354,
+	 355,  356,  358,  359,  360,  139,  140,  141,  204,  205,  206,  361,
+	 207,  208,  209,  210,   66,   67,   68,   69,   71,   70,   72,   73,
+	  74,   75,  171,  176,
+};
+
+#define	MAPI_NAMEID_TAGS_NAME_COUNT	218
+
+static const uint16_t mapi_nameid_tags_by_Name[] = {
+	 375,  459,  378,  369,  365,  366,  460,  383,  461,  490,  384,  491,
+	 404,  492,  493,  385,  386,  387,  388,  389,  390,  391,  392,  393,
+	 511,  512,  513,  514,  515,  516,  517,  518,  519,  520,  572,  395,
+	 396,  397,  521,  522,  398,  399,  400,  401,  536,  537,  363,  364,
+	 402,  403,  405,  551,  552,  553,  554,  555,  407,  556,  557,  559,
+	 558,  408,  409,  411,  410,  560,  561,  562,  563,  564,  565,  412,
+	 413,  367,  566,  567,  416,  417,  569,  418,  419,  420,  421,  422,
+	 423,  424,  425,  571,  573,  574,  427,  428,  575,  406,  576,  429,
+	 577,  430,  431,  578,  579,  432,  368,  580,  456,  433,  439,  434,
+	 376,  377,  379,  380,  381,  382,  415,  370,  414,  426,  371,  372,
+	 373,  374,  435,  436,  437,  438,  440,  441,  442,  443,  444,  445,
+	 446,  447,  448,  449,  450,  451,  452,  453,  454,  455,  457,  458,
+	 394,  523,  524,  525,  526,  527,  528,  529,  530,  531,  532,  568,
+	 570,  533,  534,  535,  462,  463,  464,  465,  466,  467,  468,  469,
+	 470,  471,  472,  473,  474,  475,  476,  477,  478,  479,  549,  480,
+	 481,  482,  550,  483,  484,  485,  486,  487,  488,  489,  494,  495,
+	 496,  497,  498,  499,  500,  501,  502,  503,  504,  505,  506,  507,
+	 508,  509,  510,  538,  539,  540,  541,  542,  543,  544,  545,  546,
+	 547,  548,
+};
+
+static const uint16_t mapi_nameid_names_by_proptag[] = {
+	 226,  252,  233,  236,  235,  246,  244,  247,  230,  234,  250,  248,
+	 249,  231,  232,  229,  251,  238,  253,  146,  239,  241,  245,  227,
+	 228,  225,  237,  240,  243,  242,  172,  175,  187,  179,  180,  190,
+	  52,   53,   10,   64,   15,   56,   57,   66,   61,   63,    9,    4,
+	  54,   39,    1,    0,   59,   74,   75,   73,    8,    7,  189,   67,
+	  72,   70,   68,   71,   16,    5,    3,   11,   12,   13,   14,   18,
+	  19,   17,   60,   20,   22,   21,   23,   24,   25,   26,   28,   27,
+	  29,   30,   31,   32,   34,   33,   35,   36,   37,   38,   40,   41,
+	  42,   43,   44,   45,   46,   47,   48,   49,   50,   51,   55,   58,
+	  69,   62,    2,    6,   65,  361,  332,  365,  359,  342,  357,  334,
+	 341,  340,  335,  343,  364,  360,  349,  356,  337,  362,  347,  363,
+	 338,  344,  354,  351,  336,  350,  353,  352,  348,  346,  358,  355,
+	 333,  345,  339,   96,   97,   87,  112,  110,  121,   80,  129,  130,
+	 123,  128,  100,   86,   99,   85,   84,   98,   83,   81,  102,   93,
+	 101,  139,   95,  138,  127,  107,  119,  122,  120,  135,  125,   94,
+	 137,  136,  142,  141,  114,  113,  134,   78,  108,  143,  111,  366,
+	 116,  117,  118,  133,  109,   79,  115,  131,  132,   92,   91,   90,
+	  82,   89,   88,  106,  105,  103,  104,  124,  126,  140,  192,  198,
+	 196,  200,  199,  188,  149,  203,  202,  204,  158,  157,  207,  206,
+	 150,  194,  201,  195,  193,  214,  213,  173,  151,  183,  182,  181,
+	 159,  163,  186,  185,  184,  170,  171,  197,  177,  178,  211,  162,
+	 160,  161,  205,  208,  209,  210,  176,  156,  152,  153,  154,  155,
+	 191,  212,  174,  166,  167,  165,  169,  164,  168,  147,  148,  223,
+	 222,  219,  220,  221,  216,  218,  217,  215,  224,  261,  264,  263,
+	 262,  260,  265,  266,  322,  299,  300,  301,  312,  310,  315,  282,
+	 283,  281,  277,  298,  316,  311,  290,  289,  293,  276,  292,  279,
+	 270,  278,  267,  304,  297,  284,  314,  296,  286,  275,  308,  288,
+	 271,  321,  323,  319,  318,  294,  325,  274,  326,  268,  280,  306,
+	 330,  329,  328,  331,  273,  272,  303,  302,  313,  291,  305,  307,
+	 287,  320,  309,  269,  285,  327,  317,  295,  324,  255,  257,  256,
+	 258,  259,  458,   76,   77,  144,  145,  254,  367,  368,  369,  370,
+	 371,  372,  373,  374,  375,  376,  377,  378,  379,  380,  381,  382,
+	 383,  384,  385,  386,  387,  388,  389,  390,  391,  392,  393,  394,
+	 395,  396,  397,  398,  399,  400,  401,  402,  403,  404,  405,  406,
+	 407,  408,  409,  410,  411,  412,  413,  414,  415,  416,  417,  418,
+	 419,  420,  421,  422,  423,  424,  425,  426,  427,  428,  429,  430,
+	 431,  432,  433,  434,  435,  436,  437,  438,  439,  440,  441,  442,
+	 443,  444,  445,  446,  447,  448,  449,  450,  451,  452,  453,  454,
+	 455,  456,  457,  459,  460,  461,  462,  463,  464,  465,  466,  467,
+	 468,  469,  470,  471,  472,  473,  474,  475,  476,  477,  478,  479,
+	 480,  481,  482,  483,  484,  485,  486,  487,  488,  489,  490,  491,
+	 492,  493,  494,  495,  496,  497,  498,  499,  500,  501,  502,  503,
+	 504,  505,  506,  507,  508,  509,  510,  511,  512,  513,  514,  515,
+	 516,  517,  518,  519,  520,  521,  522,  523,  524,  525,  526,  527,
+	 528,  529,  530,  531,  532,  533,  534,  535,  536,  537,  538,  539,
+	 540,  541,  542,  543,  544,  545,  546,  547,  548,  549,  550,  551,
+	 552,  553,  554,  555,  556,  557,  558,  559,  560,  561,  562,  563,
+	 564,  565,  566,  567,  568,  569,  570,  571,  572,  573,  574,  575,
+	 576,  577,  578,  579,  580,
+};
+
+static const uint16_t mapi_nameid_names_by_propname[] = {
+	   0,    1,    2,  149,   78,   79,    3,   80,   81,   82,   83,   84,
+	  85,   86,   87,  225,   88,   89,   90,   91,   92,   93,   94,   95,
+	  96,   97,   98,   99,  100,  101,  102,  103,  104,  105,  106,  107,
+	 226,  108,    4,  150,  109,  151,    5,    6,    7,    8,  110,  227,
+	 458,  111,  112,  152,  153,  154,  155,  156,  228,  146,  113,  114,
+	 115,  157,  158,  159,  116,  117,    9,   10,  160,  161,  162,   11,
+	  12,   13,   14,  163,  164,  165,  166,  167,  168,  169,  170,  171,
+	 229,  172,  230,   15,  118,   16,   17,   18,   19,   20,   21,   22,
+	  23,   24,   25,   26,   27,   28,   29,   30,   31,   32,   33,   34,
+	  35,   36,   37,   38,   39,  231,  232,  119,  120,  121,  122,  125,
+	  40,   41,   42,   43,   44,   45,   46,   47,   48,   49,   50,   51,
+	  52,   53,   54,  173,  174,  123,  124,   55,  233,   56,   57,   58,
+	  59,  175,  126,  176,   60,  127,  177,  178,  234,  235,  236,  128,
+	 129,  215,  216,  217,  218,  219,  220,  221,  222,  223,  224,  237,
+	 130,  238,  179,  239,  131,  180,  184,  185,  186,  181,  182,  183,
+	 255,  256,  257,  258,  259,  187,  240,  241,  242,  243,  132,  244,
+	 133,  134,   61,   62,  245,  135,  332,  260,  261,  262,  263,  264,
+	 265,  266,   63,  188,  189,  190,  136,  137,  138,  191,   64,  192,
+	 193,  194,  195,  196,  197,  198,  199,  200,  201,  202,  246,  247,
+	 139,  147,  148,  267,  268,  269,  270,  271,  272,  273,  274,  275,
+	 276,  277,  278,  279,  280,  281,  282,  283,  284,  285,  286,  287,
+	 288,  289,  290,  291,  292,  293,  294,  295,  296,  297,  298,  299,
+	 300,  301,  302,  303,  304,  305,  306,  307,  308,  309,  310,  311,
+	 312,  313,  314,  315,  316,  317,  318,  319,  320,  321,  322,  323,
+	 324,  325,  326,  327,  328,  329,  330,  331,  203,  140,  204,  205,
+	 248,  249,  333,  334,  335,  336,  337,  338,  339,  340,  341,  342,
+	 343,  344,  345,  346,  206,  347,  348,  349,  350,  207,  351,  352,
+	 353,  354,  355,  356,  357,  358,  359,  360,  361,  362,  363,  364,
+	 365,  250,  141,  142,  143,  208,  209,  210,  366,  211,  212,  213,
+	 214,   65,  251,  252,   66,   67,   68,   69,   71,   70,   72,  253,
+	  73,   74,   75,  374,  459,  375,  376,  377,  144,  145,  367,  378,
+	 379,  380,  381,  460,  368,  382,  461,  462,  463,  464,  465,  466,
+	 467,  468,  469,  470,  471,  472,  473,  474,  475,  476,  477,  478,
+	 479,  480,  481,  482,  483,  484,  485,  486,  487,  488,  489,  490,
+	 383,  491,  492,  493,  494,  495,  496,  497,  498,  499,  500,  501,
+	 502,  503,  504,  505,  506,  507,  508,  509,  510,  384,  385,  386,
+	 387,  388,  389,  390,  391,  392,  511,  393,  512,  513,  514,  515,
+	 516,  517,  518,  519,  520,  394,  395,  396,  521,  522,  534,  535,
+	 533,  523,  524,  525,  526,  527,  528,  529,  530,  531,  532,  397,
+	 398,  399,  400,  536,  537,  538,  539,  540,  541,  542,  543,  544,
+	 545,  546,  547,  548,  549,  550,  401,  402,   76,   77,  403,  404,
+	 405,  551,  552,  553,  554,  555,  406,  556,  557,  558,  407,  408,
+	 559,  409,  410,  560,  561,  562,  563,  564,  565,  411,  412,  254,
+	 413,  369,  414,  566,  567,  415,  568,  416,  569,  417,  570,  418,
+	 419,  420,  421,  422,  423,  424,  571,  572,  425,  573,  574,  426,
+	 427,  575,  576,  428,  577,  429,  430,  578,  579,  431,  580,  432,
+	 433,  434,  435,  436,  437,  438,  439,  440,  441,  442,  443,  444,
+	 445,  446,  447,  448,  449,  450,  451,  452,  453,  370,  371,  372,
+	 373,  454,  455,  456,  457,
+};
+
 #endif /* !MAPI_NAMEID_PRIVATE_H__ */
@@ -94,9 +94,12 @@ _PUBLIC_ void mapi_object_release(mapi_object_t *obj)
 	if (!obj) return;
 	if (obj->handle == INVALID_HANDLE_VALUE) return;
 
-	retval = Release(obj);
-	if (retval != MAPI_E_SUCCESS) {
-		DEBUG(1, ("Release has failed"));
+	/* Stores give their logon id back and are released at once */
+	if (obj->store == true || ReleaseDeferred(obj) != MAPI_E_SUCCESS) {
+		retval = Release(obj);
+		if (retval != MAPI_E_SUCCESS) {
+			DEBUG(1, ("Release has failed"));
+		}
 	}
 
 	if (obj->private_data) {
@@ -139,6 +139,12 @@
 /* see MAPI_CREATE above */
 
 
+/* GetSearchCriteria search state */
+#define	SEARCH_RUNNING		0x00000001
+#define	SEARCH_REBUILD		0x00000002
+#define	SEARCH_RECURSIVE	0x00000004
+#define	SEARCH_COMPLETE		0x00001000
+
 /* GetGALTable flags */
 #define	TABLE_START		0x0
 #define	TABLE_CUR		0x1
@@ -1291,22 +1291,266 @@ static struct mapi_proptags canonical_property_tags[] = {
 	{ 0,                                                                  0,            "NULL"                                                              }
 };
 
-_PUBLIC_ const char *get_proptag_name(uint32_t proptag)
+#define	CANONICAL_PROPERTY_TAGS_COUNT	1276
+
+static const uint16_t canonical_property_tags_by_tag[] = {
+	1160, 1159,  119,  118,  193, 1028,  192, 1027,  195,  194,  305,  304,
+	 367,  366,  479,  480,  606,  605,  730,  729,  758,  757,  781,  782,
+	 811,  810,  856,  855,  713,  714,  886,  885,  894,  893,  898,  897,
+	1081, 1082, 1144, 1141,  239,  238,  890,  889, 1096, 1095, 1143, 1142,
+	 820,  819,  824,  823, 1090, 1089, 1094, 1093,  832,  831,  836,  835,
+	 888,  887,  807,  806,  630,  629,  792,  791,  726,  725,  698,  697,
+	 728,  727,  878,  877,  880,  879,  826,  825,  838,  837,  813,  812,
+	 892,  891,  686,  685,  632,  631,  604,  603,  620,  619,  710,  709,
+	 708,  707,  712,  711,  722,  721,  720,  719,  724,  723, 1114, 1111,
+	 345,  344,  749,  750,  904,  903, 1086, 1085, 1088, 1087,  704,  703,
+	 706,  705,  716,  715,  718,  717,  283,  282,  281,  278,  688,  687,
+	 690,  689,  694,  693,  816,  815,  818,  817,  828,  827,  830,  872,
+	 829,  871, 1178, 1177, 1172, 1171,  638,  637,  100,  101,  105,  104,
+	 732,  731,  863,  864,  882,  881, 1066, 1065, 1072, 1071, 1074, 1073,
+	1062, 1061, 1064, 1063,  874,  873,  317,  316,  325,  324,  327,  326,
+	 333,  332,  610,  609,  613,  614,  623,  625,  626,  624,  754,  753,
+	 906,  905,  622,  621,  602,  601,  627,  628,  424,  423,  654,  653,
+	 928,  927,  172,  173,  162,  163,  521,  522, 1054, 1051,  776,  775,
+	 648,  647, 1173, 1174, 1150, 1149, 1148, 1147, 1185, 1184,  814,  801,
+	1053, 1052, 1179, 1180,  363,  362,  373,  372,  375,  374,  376,  377,
+	   2,    5,  921,  922,  518,  517,    3,    4,  592,  591,  866,  865,
+	1130, 1129,  655,  656,  355,  354,  209,  202,  896,  895,  931,  932,
+	 929,  930,  934,  933,  926,  925,  935,  936,  937,  938,  208,  456,
+	 207,  455,  206,  205,  204,  203,  641,  642,  528,  527,  530,  529,
+	 484,  483,  572,  571,  574,  573,  576,  575,  700,  699,  463,  464,
+	 567,  568,  570,  569,  386,  387,  385,  384,  397,  398,  200,  201,
+	 259,  258,  462,  461,  458,  457,  227,  226,  460,  459,  478,  477,
+	1186, 1183,  187,  186,  191,  190,  189,  188,  923,  924,  331,  328,
+	 117,  116,  341,  340,  249,  248,  322,  323,  287,  286,  560,  559,
+	1048, 1047, 1152, 1151,  277,  276,  280,  279,  127,  126,  764,  763,
+	 911,  912, 1113, 1112,  908,  907,  909,  910,  124,  125,  123,  122,
+	1133, 1134, 1131, 1132,  264,  265,  395,  396,  268,  269,  274,  275,
+	1056, 1055, 1140, 1139,  121,  120,  267,  266,  263,  262,  391,  390,
+	 261,  260,  532,  531,  534,  533,  538,  537,  540,  539,  542,  541,
+	 870,  869,  536,  535,   11,    8,   10,    9,  371,  370,  681,  682,
+	 402,  401,  301,  300,  143,  145,  144,  142,  147,  146,  149,  148,
+	 151,  150,  158,  159,  155,  154,  165,  164,  171,  170,  175,  174,
+	 875,  876,  177,  176,  157,  156,  161,  160,  135,  134,  137,  136,
+	 139,  138,  141,  140,  152,  153,  169,  168,  167,  166, 1166, 1165,
+	 334,  337, 1162, 1161,  335,  336,  778, 1102,  777, 1101,    1,   19,
+	   0,   18,    7,    6,  223,  222,  418,  417,  420,  419,  422,  421,
+	 219,  218,  454,  453,  514,  513,  556,  555,  558,  557,  584,  583,
+	 616,  615,  684,  683, 1146, 1145,  696,  695,  692,  691,  702,  701,
+	 768,  767,  253,  252, 1170, 1169,  321,  320,  658,  657,  780,  779,
+	 211,  213,  210,  212,  640,  639,  800,  799,  225,  224,  746,  745,
+	1176, 1175,  752,  751, 1190, 1189,  774,  773,  215,  214,  452,  451,
+	 285,  284,  582,  581, 1128, 1127, 1136, 1135,  770,  769,  766,  765,
+	1158, 1157,  544,  543,  130,  129,  436,  438,  435,  437,  131,  128,
+	1060, 1059, 1210, 1209,  199,  198,  434,  433,  636,  635,  330,  329,
+	 786,  785,  868,  867, 1110, 1109,  255,  254,  295,  294, 1156, 1182,
+	1155, 1181,  412,  411,  415,  416,  590,  589,  650,  649,  762,  761,
+	 217,  216,  251,  250,  235,  234,  440,  439,  442,  441,  446,  445,
+	 448,  447,  450,  449,  444,  443,  734,  733,  736,  735,  740,  739,
+	 742,  741,  744,  743,  738,  737, 1194, 1193, 1057, 1058,  511,  512,
+	1164, 1163,  523,  524,  196,  197,  315,  314,  901,  902,  426,  425,
+	 306,  307,  310,  311,  364,  365,  368,  369,  309,  308,  257,  256,
+	 617,  618,  291,  290,  289,  288,  564,  563,  562,  561,  607,  608,
+	 643,  644, 1115, 1116,  346,  347, 1121, 1122,  352,  353, 1125, 1126,
+	1123, 1124,  348,  349, 1119, 1120,  350,  351,  342,  343,  338,  339,
+	1117, 1118,  646,  645,  485,  488,  489,  490,  491,  492,  497,  498,
+	 378,  379,  469,  470,  380,  381, 1067, 1068, 1091, 1092,  821,  822,
+	 833,  834,  472,  471,  803,  802,  805,  804,  809,  808,  474,  473,
+	 476,  475,  503,  504, 1076, 1075, 1098, 1097,  840,  839,  293,  292,
+	 566,  565,  505,  506,  507,  508,  500,  499,  502,  501,  272,  273,
+	1069, 1070,  509,  510,  496,  495,  493,  494,  486,  487,  798,  797,
+	 270,  271,  525,  526,  611,  612, 1078, 1077,  857,  858,  847,  848,
+	 854,  849,  853,  852,  851,  850, 1100, 1099,  842,  841,  844,  843,
+	 861,  860,  845,  846,  859,  862,  547,  548,  553,  554,  549,  550,
+	 545,  546,  552,  551,  884,  883, 1049, 1050, 1106, 1105,  760,  759,
+	 229,  228,  772,  771,  967,  968,  969,  970,  964,  961,  960,  959,
+	 957,  958,  963,  962,  965,  966, 1192, 1191,  586,  585,  588,  587,
+	 748,  747, 1026, 1025,  231,  230,  392,  913,  914,  430,  429,   33,
+	  32,  431,  432,  237,  236,  299,  298,  297,  296,  947,  948,  941,
+	 942,  428,  427,  939,  940,  950,  949,  787,  788,  482,  481,  593,
+	 594,  789,  790,  596,  595,  598,  597,  599,  600,  952,  951,  954,
+	 953,  977,  978,  979,  980,  981,  982,  946,  945,  944,  943,  976,
+	 973,  972,  971,  955,  956,  975,  974,  319,  318,  579,  580,  651,
+	 652,  246,  247,   59,   58, 1103, 1104, 1188, 1187, 1138, 1137,  578,
+	 577,  389,  388,  794,  793,  796,  795, 1084, 1083,  303,  302,  394,
+	 393,  756,  755,  634,  633,  516,  515,  519,  520,   67,   66,  468,
+	 467,  245,  242,  233,  232,  133,  132,  241,  240,  244,  243,  466,
+	 465,  674,  673,  675, 1205,  676, 1206,  662,  984, 1080,  661, 1079,
+	 983,  671,  672, 1208, 1207,  382,  383,  664,  663,  680, 1204, 1203,
+	 679,  221,  678,  220,  677,  669,  670,  667,  668,  659,  660,  665,
+	 666,  900,  899, 1037, 1038, 1033, 1034, 1023, 1045, 1024, 1046,  996,
+	1036, 1228,  995, 1227, 1035, 1004, 1003,  994, 1040, 1039,  991,  990,
+	1030, 1029,  989, 1041,  414, 1042,  413,  407, 1043, 1237,  408, 1044,
+	1238,  405, 1031,  406, 1032, 1243,  404, 1244,  403, 1221,  993, 1222,
+	 992,  998, 1232,  997, 1231, 1220, 1219, 1236, 1235, 1242, 1241, 1020,
+	1224, 1223, 1019, 1011, 1226, 1225, 1010, 1022, 1230, 1229, 1021, 1239,
+	1013, 1240, 1012, 1215, 1018, 1216, 1017, 1009, 1212, 1211, 1008, 1016,
+	1015, 1007, 1006,  410,  409,  399,  400,  986,  985,  313,  312, 1014,
+	1005,  988,  987, 1002, 1001, 1000,  999, 1218, 1217, 1214, 1213, 1233,
+	1234, 1196, 1195, 1200, 1199, 1198, 1197, 1201, 1202,  915,  916,  918,
+	 917,  920,  919,  784,  783,  359,  358,  184,  185,  361,  360,  357,
+	 356,  180,  181,  183,  182,  179,  178,   39,   38,   62,   63,   60,
+	  61,   53,   52, 1153,   57, 1154,   56,   65,   64,   81,   78,   99,
+	  98,   95,   94,  111,  110,   97,   96,   80,   79,   37,   34,   73,
+	  72,   16,   17,   27,   26,   71,   70,   36,   35,  115,  114,   75,
+	  74,   91,   90,   93,   92,   87,   86,   85,   84,   89,   88,   20,
+	  21,   51,   50,  103,  102,   43,   42,   49,   48,   47,   46,   41,
+	  40, 1168, 1167,  108,  109,   77,   76,  107,  106,   69,   68, 1108,
+	1107,   13,   12,  113,  112,   29,   28,   31,   30,   45,   44,   24,
+	  25,   22,   23, 1245, 1246, 1247, 1248, 1249, 1250, 1251, 1252, 1253,
+	1254, 1255, 1256, 1257, 1258, 1259, 1260, 1261, 1262, 1263, 1264, 1265,
+	1266, 1267, 1268, 1269, 1270, 1271, 1272, 1273, 1274, 1275,   55,   54,
+	  83,   82,   14,   15,
+};
+
+static const uint16_t canonical_property_tags_by_name[] = {
+	   0,    1,    2,    3,    4,    5,    6,    7,    8,    9,   10,   11,
+	  12,   13,   14,   15,   16,   17,   18,   19,   20,   21,   22,   23,
+	  24,   25,   26,   27,   28,   29,   30,   31,   32,   33,   34,   35,
+	  36,   37,   38,   39,   40,   41,   42,   43,   44,   45,   46,   47,
+	  48,   49,   50,   51,   52,   53,   54,   55,   56,   57,   58,   59,
+	  60,   61,   62,   63,   64,   65,   66,   67,   68,   69,   70,   71,
+	  72,   73,   74,   75,   76,   77,   78,   79,   80,   81,   82,   83,
+	  84,   85,   86,   87,   88,   89,   90,   91,   92,   93,   94,   95,
+	  96,   97,   98,   99,  100,  101,  102,  103,  104,  105,  106,  107,
+	 108,  109,  110,  111,  112,  113,  114,  115,  116,  117,  118,  119,
+	 120,  121,  122,  123,  124,  125,  126,  127,  128,  129,  130,  131,
+	 132,  133,  134,  135,  136,  137,  138,  139,  140,  141,  142,  143,
+	 144,  145,  146,  147,  148,  149,  150,  151,  152,  153,  154,  155,
+	 156,  157,  158,  159,  160,  161,  162,  163,  164,  165,  166,  167,
+	 168,  169,  170,  171,  172,  173,  174,  175,  176,  177,  178,  179,
+	 180,  181,  182,  183,  184,  185,  186,  187,  188,  189,  190,  191,
+	 192,  193,  194,  195,  196,  197,  198,  199,  200,  201,  202,  203,
+	 204,  205,  206,  207,  208,  209,  210,  211,  212,  213,  214,  215,
+	 216,  217,  218,  219,  220,  221,  222,  223,  224,  225,  226,  227,
+	 228,  229,  230,  231,  232,  233,  234,  235,  236,  237,  238,  239,
+	 240,  241,  242,  243,  244,  245,  246,  247,  248,  249,  250,  251,
+	 252,  253,  254,  255,  256,  257,  258,  259,  260,  261,  262,  263,
+	 264,  265,  266,  267,  268,  269,  270,  271,  272,  273,  274,  275,
+	 276,  277,  278,  279,  280,  281,  282,  283,  284,  285,  286,  287,
+	 288,  289,  290,  291,  292,  293,  294,  295,  296,  297,  298,  299,
+	 300,  301,  302,  303,  304,  305,  306,  307,  308,  309,  310,  311,
+	 312,  313,  314,  315,  316,  317,  318,  319,  320,  321,  322,  323,
+	 324,  325,  326,  327,  328,  329,  330,  331,  332,  333,  334,  335,
+	 336,  337,  338,  339,  340,  341,  342,  343,  344,  345,  346,  347,
+	 348,  349,  350,  351,  352,  353,  354,  355,  356,  357,  358,  359,
+	 360,  361,  362,  363,  364,  365,  366,  367,  368,  369,  370,  371,
+	 372,  373,  374,  375,  376,  377,  378,  379,  380,  381,  382,  383,
+	 384,  385,  386,  387,  388,  389,  390,  391,  392,  393,  394,  395,
+	 396,  397,  398,  399,  400,  401,  402,  403,  404,  405,  406,  407,
+	 408,  409,  410,  411,  412,  413,  414,  415,  416,  417,  418,  419,
+	 420,  421,  422,  423,  424,  425,  426,  427,  428,  429,  430,  431,
+	 432,  433,  434,  435,  436,  437,  438,  439,  440,  441,  442,  443,
+	 444,  445,  446,  447,  448,  449,  450,  451,  452,  453,  454,  455,
+	 456,  457,  458,  459,  460,  461,  462,  463,  464,  465,  466,  467,
+	 468,  469,  470,  471,  472,  473,  474,  475,  476,  477,  478,  479,
+	 480,  481,  482,  483,  484,  485,  486,  487,  488,  489,  490,  491,
+	 492,  493,  494,  495,  496,  497,  498,  499,  500,  501,  502,  503,
+	 504,  505,  506,  507,  508,  509,  510,  511,  512,  513,  514,  515,
+	 516,  517,  518,  519,  520,  521,  522,  523,  524,  525,  526,  527,
+	 528,  529,  530,  531,  532,  533,  534,  535,  536,  537,  538,  539,
+	 540,  541,  542,  543,  544,  545,  546,  547,  548,  549,  550,  551,
+	 552,  553,  554,  555,  556,  557,  558,  559,  560,  561,  562,  563,
+	 564,  565,  566,  567,  568,  569,  570,  571,  572,  573,  574,  575,
+	 576,  577,  578,  579,  580,  581,  582,  583,  584,  585,  586,  587,
+	 588,  589,  590,  591,  592,  593,  594,  595,  596,  597,  598,  599,
+	 600,  601,  602,  603,  604,  605,  606,  607,  608,  609,  610,  611,
+	 612,  613,  614,  615,  616,  617,  618,  619,  620,  621,  622,  623,
+	 624,  625,  626,  627,  628,  629,  630,  631,  632,  633,  634,  635,
+	 636,  637,  638,  639,  640,  641,  642,  643,  644,  645,  646,  647,
+	 648,  649,  650,  651,  652,  653,  654,  655,  656,  657,  658,  659,
+	 660,  661,  662,  663,  664,  665,  666,  667,  668,  669,  670,  671,
+	 672,  673,  674,  675,  676,  677,  678,  679,  680,  681,  682,  683,
+	 684,  685,  686,  687,  688,  689,  690,  691,  692,  693,  694,  695,
+	 696,  697,  698,  699,  700,  701,  702,  703,  704,  705,  706,  707,
+	 708,  709,  710,  711,  712,  713,  714,  715,  716,  717,  718,  719,
+	 720,  721,  722,  723,  724,  725,  726,  727,  728,  729,  730,  731,
+	 732,  733,  734,  735,  736,  737,  738,  739,  740,  741,  742,  743,
+	 744,  745,  746,  747,  748,  749,  750,  751,  752,  753,  754,  755,
+	 756,  757,  758,  759,  760,  761,  762,  763,  764,  765,  766,  767,
+	 768,  769,  770,  771,  772,  773,  774,  775,  776,  777,  778,  779,
+	 780,  781,  782,  783,  784,  785,  786,  787,  788,  789,  790,  791,
+	 792,  793,  794,  795,  796,  797,  798,  799,  800,  801,  802,  803,
+	 804,  805,  806,  807,  808,  809,  810,  811,  812,  813,  814,  815,
+	 816,  817,  818,  819,  820,  821,  822,  823,  824,  825,  826,  827,
+	 828,  829,  830,  831,  832,  833,  834,  835,  836,  837,  838,  839,
+	 840,  841,  842,  843,  844,  845,  846,  847,  848,  849,  850,  851,
+	 852,  853,  854,  855,  856,  857,  858,  859,  860,  861,  862,  863,
+	 864,  865,  866,  867,  868,  869,  870,  871,  872,  873,  874,  875,
+	 876,  877,  878,  879,  880,  881,  882,  883,  884,  885,  886,  887,
+	 888,  889,  890,  891,  892,  893,  894,  895,  896,  897,  898,  899,
+	 900,  901,  902,  903,  904,  905,  906,  907,  908,  909,  910,  911,
+	 912,  913,  914,  915,  916,  917,  918,  919,  920,  921,  922,  923,
+	 924,  925,  926,  927,  928,  929,  930,  931,  932,  933,  934,  935,
+	 936,  937,  938,  939,  940,  941,  942,  943,  944,  945,  946,  947,
+	 948,  949,  950,  951,  952,  953,  954,  955,  956,  957,  958,  959,
+	 960,  961,  962,  963,  964,  965,  966,  967,  968,  969,  970,  971,
+	 972,  973,  974,  975,  976,  977,  978,  979,  980,  981,  982,  983,
+	 984,  985,  986,  987,  988,  989,  990,  991,  992,  993,  994,  995,
+	 996,  997,  998,  999, 1000, 1001, 1002, 1003, 1004, 1005, 1006, 1007,
+	1008, 1009, 1010, 1011, 1012, 1013, 1014, 1015, 1016, 1017, 1018, 1019,
+	1020, 1021, 1022, 1023, 1024, 1025, 1026, 1027, 1028, 1029, 1030, 1031,
+	1032, 1033, 1034, 1035, 1036, 1037, 1038, 1039, 1040, 1041, 1042, 1043,
+	1044, 1045, 1046, 1047, 1048, 1049, 1050, 1051, 1052, 1053, 1054, 1055,
+	1056, 1057, 1058, 1059, 1060, 1061, 1062, 1063, 1064, 1065, 1066, 1067,
+	1068, 1069, 1070, 1071, 1072, 1073, 1074, 1075, 1076, 1077, 1078, 1079,
+	1080, 1081, 1082, 1083, 1084, 1085, 1086, 1087, 1088, 1089, 1090, 1091,
+	1092, 1093, 1094, 1095, 1096, 1097, 1098, 1099, 1100, 1101, 1102, 1103,
+	1104, 1105, 1106, 1107, 1108, 1109, 1110, 1111, 1112, 1113, 1114, 1115,
+	1116, 1117, 1118, 1119, 1120, 1121, 1122, 1123, 1124, 1125, 1126, 1127,
+	1128, 1129, 1130, 1131, 1132, 1133, 1134, 1135, 1136, 1137, 1138, 1139,
+	1140, 1141, 1142, 1143, 1144, 1145, 1146, 1147, 1148, 1149, 1150, 1151,
+	1152, 1153, 1154, 1155, 1156, 1157, 1158, 1159, 1160, 1161, 1162, 1163,
+	1164, 1165, 1166, 1167, 1168, 1169, 1170, 1171, 1172, 1173, 1174, 1175,
+	1176, 1177, 1178, 1179, 1180, 1181, 1182, 1183, 1184, 1185, 1186, 1187,
+	1188, 1189, 1190, 1191, 1192, 1193, 1194, 1195, 1196, 1197, 1198, 1199,
+	1200, 1201, 1202, 1203, 1204, 1205, 1206, 1207, 1208, 1209, 1210, 1211,
+	1212, 1213, 1214, 1215, 1216, 1217, 1218, 1219, 1220, 1221, 1222, 1223,
+	1224, 1225, 1226, 1227, 1228, 1229, 1230, 1231, 1232, 1233, 1234, 1235,
+	1236, 1237, 1238, 1239, 1240, 1241, 1242, 1243, 1244, 1262, 1253, 1261,
+	1246, 1252, 1266, 1249, 1248, 1263, 1258, 1264, 1250, 1270, 1271, 1268,
+	1273, 1274, 1275, 1269, 1272, 1267, 1245, 1260, 1259, 1254, 1255, 1251,
+	1257, 1247, 1265, 1256,
+};
+
+/**
+   \details Return the position in canonical_property_tags_by_tag of the
+   first entry whose property tag is not lower than proptag
+ */
+static uint32_t canonical_property_tags_lower_bound(uint32_t proptag)
 {
-	uint32_t idx;
+	uint32_t	low = 0;
+	uint32_t	high = CANONICAL_PROPERTY_TAGS_COUNT;
+	uint32_t	mid;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (canonical_property_tags[canonical_property_tags_by_tag[mid]].proptag < proptag) {
+			low = mid + 1;
+		} else {
+			high = mid;
 		}
 	}
+
+	return low;
+}
+
+_PUBLIC_ const char *get_proptag_name(uint32_t proptag)
+{
+	uint32_t pos;
+
+	pos = canonical_property_tags_lower_bound(proptag);
+	if (pos < CANONICAL_PROPERTY_TAGS_COUNT &&
+	    canonical_property_tags[canonical_property_tags_by_tag[pos]].proptag == proptag) {
+		return canonical_property_tags[canonical_property_tags_by_tag[pos]].propname;
+	}
 	if (((proptag & 0xFFFF) == PT_STRING8) ||
 	    ((proptag & 0xFFFF) == PT_MV_STRING8)) {
 		proptag += 1; /* try as _UNICODE variant */
-	}
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
+		pos = canonical_property_tags_lower_bound(proptag);
+		if (pos < CANONICAL_PROPERTY_TAGS_COUNT &&
+		    canonical_property_tags[canonical_property_tags_by_tag[pos]].proptag == proptag) {
+			return canonical_property_tags[canonical_property_tags_by_tag[pos]].propname;
 		}
 	}
 	return NULL;
@@ -1314,11 +1558,20 @@ _PUBLIC_ const char *get_proptag_name(uint32_t proptag)
 
 _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 {
-	uint32_t idx;
+	uint32_t	low = 0;
+	uint32_t	high = CANONICAL_PROPERTY_TAGS_COUNT;
+	uint32_t	mid;
+	int		ret;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (!strcmp(canonical_property_tags[idx].propname, propname)) { 
-			return canonical_property_tags[idx].proptag;
+	while (low < high) {
+		mid = (low + high) / 2;
+		ret = strcmp(canonical_property_tags[canonical_property_tags_by_name[mid]].propname, propname);
+		if (!ret) {
+			return canonical_property_tags[canonical_property_tags_by_name[mid]].proptag;
+		} else if (ret < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
 		}
 	}
 
@@ -1327,17 +1580,25 @@ _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 
 _PUBLIC_ uint16_t get_property_type(uint16_t untypedtag)
 {
+	uint32_t	pos;
 	uint32_t	idx;
+	uint32_t	found = CANONICAL_PROPERTY_TAGS_COUNT;
 	uint16_t	current_type;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if ((canonical_property_tags[idx].proptag >> 16) == untypedtag) {
-			current_type = canonical_property_tags[idx].proptype;
-			if (current_type != PT_ERROR && current_type != PT_STRING8) {
-				return current_type;
-			}
+	/* Entries sharing a property id are contiguous: keep the first
+	 * one in table order, as a linear scan would */
+	for (pos = canonical_property_tags_lower_bound(untypedtag << 16);
+	     pos < CANONICAL_PROPERTY_TAGS_COUNT; pos++) {
+		idx = canonical_property_tags_by_tag[pos];
+		if ((canonical_property_tags[idx].proptag >> 16) != untypedtag) break;
+		current_type = canonical_property_tags[idx].proptype;
+		if (current_type != PT_ERROR && current_type != PT_STRING8 && idx < found) {
+			found = idx;
 		}
 	}
+	if (found < CANONICAL_PROPERTY_TAGS_COUNT) {
+		return canonical_property_tags[found].proptype;
+	}
 
 	DEBUG(5, ("%s: type for property '%x' could not be deduced\n", __FUNCTION__, untypedtag));
 	return 0;
@@ -211,3 +211,267 @@ bool mpm_session_cmp(struct mpm_session *session,
 	return mpm_session_cmp_sub(session, dce_call->conn->server_id, 
 				   dce_call->context->context_id);
 }
+
+
+static uint32_t mpm_session_table_hash(const struct GUID *uuid)
+{
+	uint32_t	hash;
+	uint32_t	i;
+
+	hash = uuid->time_low ^ (uuid->time_mid << 16) ^ uuid->time_hi_and_version;
+	hash ^= (uuid->clock_seq[0] << 24) | (uuid->clock_seq[1] << 16);
+	for (i = 0; i < sizeof (uuid->node); i++) {
+		hash = (hash * 31) ^ uuid->node[i];
+	}
+
+	return hash;
+}
+
+
+static void mpm_session_table_unlink(struct mpm_session_table *table,
+				     struct mpm_session_table_entry *entry)
+{
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	} else {
+		table->idle_head = entry->next;
+	}
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	} else {
+		table->idle_tail = entry->prev;
+	}
+	entry->prev = NULL;
+	entry->next = NULL;
+}
+
+
+static void mpm_session_table_touch(struct mpm_session_table *table,
+				    struct mpm_session_table_entry *entry)
+{
+	entry->last_used = time(NULL);
+	if (table->idle_head == entry) return;
+
+	/* Only entries not yet linked have no predecessor */
+	if (entry->prev) {
+		mpm_session_table_unlink(table, entry);
+	}
+	entry->next = table->idle_head;
+	if (table->idle_head) {
+		table->idle_head->prev = entry;
+	} else {
+		table->idle_tail = entry;
+	}
+	table->idle_head = entry;
+}
+
+
+static bool mpm_session_table_grow(struct mpm_session_table *table)
+{
+	struct mpm_session_table_entry	**buckets;
+	struct mpm_session_table_entry	*entry;
+	struct mpm_session_table_entry	*hnext;
+	uint32_t			bucket_count;
+	uint32_t			i;
+	uint32_t			idx;
+
+	bucket_count = (table->bucket_mask + 1) * 2;
+	buckets = talloc_zero_array(table, struct mpm_session_table_entry *, bucket_count);
+	if (!buckets) return false;
+
+	for (i = 0; i <= table->bucket_mask; i++) {
+		for (entry = table->buckets[i]; entry; entry = hnext) {
+			hnext = entry->hnext;
+			idx = mpm_session_table_hash(&entry->uuid) & (bucket_count - 1);
+			entry->hnext = buckets[idx];
+			buckets[idx] = entry;
+		}
+	}
+
+	talloc_free(table->buckets);
+	table->buckets = buckets;
+	table->bucket_mask = bucket_count - 1;
+
+	return true;
+}
+
+
+/**
+   \details Create a GUID indexed session table
+
+   Servers use the session table to retrieve their sessions from the
+   policy handle uuid in constant time. Sessions are also kept
+   ordered by last use, so stale ones can be found without scanning.
+
+   \param mem_ctx pointer to the memory context
+   \param size the expected number of sessions, 0 for the default
+
+   \return Allocated session table on success, otherwise NULL
+ */
+struct mpm_session_table *mpm_session_table_init(TALLOC_CTX *mem_ctx, uint32_t size)
+{
+	struct mpm_session_table	*table;
+	uint32_t			bucket_count;
+
+	if (!mem_ctx) return NULL;
+	if (!size) {
+		size = MPM_SESSION_TABLE_DEFAULT_SIZE;
+	}
+
+	table = talloc_zero(mem_ctx, struct mpm_session_table);
+	if (!table) return NULL;
+
+	for (bucket_count = 16; bucket_count < size; bucket_count <<= 1);
+	table->buckets = talloc_zero_array(table, struct mpm_session_table_entry *, bucket_count);
+	if (!table->buckets) {
+		talloc_free(table);
+		return NULL;
+	}
+	table->bucket_mask = bucket_count - 1;
+
+	return table;
+}
+
+
+/**
+   \details Register a session in the session table
+
+   The table does not take ownership of data.
+
+   \param table pointer to the session table
+   \param uuid pointer to the GUID identifying the session
+   \param data pointer to the server session
+
+   \return true on success, otherwise false
+ */
+bool mpm_session_table_add(struct mpm_session_table *table,
+			   const struct GUID *uuid,
+			   void *data)
+{
+	struct mpm_session_table_entry	*entry;
+	uint32_t			idx;
+
+	if (!table || !uuid || !data) return false;
+
+	if (table->count > table->bucket_mask) {
+		mpm_session_table_grow(table);
+	}
+
+	entry = talloc_zero(table, struct mpm_session_table_entry);
+	if (!entry) return false;
+
+	entry->uuid = *uuid;
+	entry->data = data;
+
+	idx = mpm_session_table_hash(uuid) & table->bucket_mask;
+	entry->hnext = table->buckets[idx];
+	table->buckets[idx] = entry;
+	mpm_session_table_touch(table, entry);
+	table->count += 1;
+
+	return true;
+}
+
+
+/**
+   \details Retrieve a session from the session table and refresh its
+   last use timestamp
+
+   \param table pointer to the session table
+   \param uuid pointer to the GUID identifying the session
+
+   \return pointer to the server session on success, otherwise NULL
+ */
+void *mpm_session_table_find(struct mpm_session_table *table,
+			     const struct GUID *uuid)
+{
+	struct mpm_session_table_entry	*entry;
+
+	if (!table || !uuid) return NULL;
+
+	for (entry = table->buckets[mpm_session_table_hash(uuid) & table->bucket_mask];
+	     entry; entry = entry->hnext) {
+		if (GUID_equal(uuid, &entry->uuid)) {
+			mpm_session_table_touch(table, entry);
+			return entry->data;
+		}
+	}
+
+	return NULL;
+}
+
+
+/**
+   \details Unregister a session from the session table
+
+   \param table pointer to the session table
+   \param uuid pointer to the GUID identifying the session
+
+   \return true on success, otherwise false
+ */
+bool mpm_session_table_remove(struct mpm_session_table *table,
+			      const struct GUID *uuid)
+{
+	struct mpm_session_table_entry	**el;
+	struct mpm_session_table_entry	*entry;
+
+	if (!table || !uuid) return false;
+
+	for (el = &table->buckets[mpm_session_table_hash(uuid) & table->bucket_mask];
+	     *el; el = &(*el)->hnext) {
+		if (GUID_equal(uuid, &(*el)->uuid)) {
+			entry = *el;
+			*el = entry->hnext;
+			mpm_session_table_unlink(table, entry);
+			table->count -= 1;
+			talloc_free(entry);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/**
+   \details Return the number of sessions registered in the session
+   table
+
+   \param table pointer to the session table
+
+   \return the number of sessions
+ */
+uint32_t mpm_session_table_count(struct mpm_session_table *table)
+{
+	if (!table) return 0;
+
+	return table->count;
+}
+
+
+/**
+   \details Retrieve the least recently used session if it has not
+   been used since a given time
+
+   \param table pointer to the session table
+   \param idle_since the time before which the session must have
+   been used last
+   \param last_used pointer to the last use timestamp of the session
+   to return, can be NULL
+
+   \return pointer to the server session on success, NULL if no
+   session is idle
+ */
+void *mpm_session_table_get_idle(struct mpm_session_table *table,
+				 time_t idle_since,
+				 time_t *last_used)
+{
+	if (!table || !table->idle_tail) return NULL;
+	if (table->idle_tail->last_used >= idle_since) return NULL;
+
+	if (last_used) {
+		*last_used = table->idle_tail->last_used;
+	}
+
+	return table->idle_tail->data;
+}
@@ -77,6 +77,25 @@ struct mpm_session {
 };
 
 
+struct mpm_session_table_entry {
+	struct GUID			uuid;
+	time_t				last_used;
+	void				*data;
+	struct mpm_session_table_entry	*hnext;
+	struct mpm_session_table_entry	*prev;
+	struct mpm_session_table_entry	*next;
+};
+
+
+struct mpm_session_table {
+	struct mpm_session_table_entry	**buckets;
+	uint32_t			bucket_mask;
+	uint32_t			count;
+	struct mpm_session_table_entry	*idle_head;	/* most recently used */
+	struct mpm_session_table_entry	*idle_tail;	/* least recently used */
+};
+
+
 struct auth_serversupplied_info 
 {
 	struct dom_sid	*account_sid;
@@ -118,13 +137,21 @@ struct mapi_handles {
 	uint32_t	       	handle;
 	uint32_t		parent_handle;
 	void		       	*private_data;
+	struct mapi_handles	*children;
+	struct mapi_handles	*sibling_prev;
+	struct mapi_handles	*sibling_next;
 	struct mapi_handles	*prev;
 	struct mapi_handles	*next;
 };
 
 
 struct mapi_handles_context {
-	TDB_CONTEXT	       	*tdb_ctx;
+	struct mapi_handles	**slab;
+	uint32_t		slab_size;
+	uint32_t		*free_list;
+	uint32_t		free_count;
+	uint32_t		free_size;
+	uint32_t		count;
 	uint32_t		last_handle;
 	struct mapi_handles    	*handles;
 };
@@ -135,6 +162,13 @@ struct openchangedb_table {
 	struct SSortOrderSet		*lpSortCriteria;
 	struct mapi_SRestriction	*restrictions;
 	struct ldb_result		*res;
+	uint32_t			*rows;		/* res->msgs indexes in sort order */
+	uint32_t			row_count;
+	uint32_t			*view;		/* rows matching restrictions */
+	uint32_t			view_count;
+	bool				*matches;	/* restriction result per sorted row */
+	struct openchangedb_table	*prev;
+	struct openchangedb_table	*next;
 };
 
 enum openchangedb_message_status {
@@ -155,6 +189,9 @@ struct openchangedb_message {
 #define	MAPI_HANDLES_RESERVED	0xFFFFFFFF
 #define	MAPI_HANDLES_ROOT	"root"
 #define	MAPI_HANDLES_NULL	"null"
+#define	MAPI_HANDLES_SLAB_SIZE	256
+
+#define	MPM_SESSION_TABLE_DEFAULT_SIZE	256
 
 
 /**
@@ -219,6 +256,12 @@ bool mpm_session_set_private_data(struct mpm_session *, void *);
 bool mpm_session_release(struct mpm_session *);
 bool mpm_session_cmp_sub(struct mpm_session *, struct server_id, uint32_t);
 bool mpm_session_cmp(struct mpm_session *, struct dcesrv_call_state *);
+struct mpm_session_table *mpm_session_table_init(TALLOC_CTX *, uint32_t);
+bool mpm_session_table_add(struct mpm_session_table *, const struct GUID *, void *);
+void *mpm_session_table_find(struct mpm_session_table *, const struct GUID *);
+bool mpm_session_table_remove(struct mpm_session_table *, const struct GUID *);
+uint32_t mpm_session_table_count(struct mpm_session_table *);
+void *mpm_session_table_get_idle(struct mpm_session_table *, time_t, time_t *);
 
 /* definitions from openchangedb.c */
 enum MAPISTATUS openchangedb_get_new_folderID(struct ldb_context *, uint64_t *);
@@ -266,6 +309,8 @@ enum MAPISTATUS openchangedb_table_init(TALLOC_CTX *, uint8_t, uint64_t, void **
 enum MAPISTATUS openchangedb_table_set_sort_order(void *, struct SSortOrderSet *);
 enum MAPISTATUS openchangedb_table_set_restrictions(void *, struct mapi_SRestriction *);
 enum MAPISTATUS openchangedb_table_get_property(TALLOC_CTX *, void *, struct ldb_context *, enum MAPITAGS, uint32_t, bool live_filtered, void **);
+enum MAPISTATUS openchangedb_table_get_row_count(void *, struct ldb_context *, bool, uint32_t *);
+void openchangedb_table_invalidate(uint64_t);
 
 /* definitions from openchangedb_message.c */
 enum MAPISTATUS openchangedb_message_open(TALLOC_CTX *, struct ldb_context *, uint64_t, uint64_t, void **, void **);
@@ -34,6 +34,11 @@
 /**
    \details Initialize MAPI handles context
 
+   Handles are stored in a dense slab indexed by handle value. Released
+   handles are pushed on a free-list and reused by subsequent
+   mapi_handles_add calls, and each record keeps the list of its child
+   handles so deletion cascades only visit the released subtree.
+
    \param mem_ctx pointer to the memory context
 
    \return Allocated MAPI handles context on success, otherwise NULL
@@ -46,10 +51,19 @@ _PUBLIC_ struct mapi_handles_context *mapi_handles_init(TALLOC_CTX *mem_ctx)
 	handles_ctx = talloc_zero(mem_ctx, struct mapi_handles_context);
 	if (!handles_ctx) return NULL;
 
-	/* Step 2. Initialize the TDB context */
-	handles_ctx->tdb_ctx = tdb_open(NULL, 0, TDB_INTERNAL, O_RDWR|O_CREAT, 0600);
+	/* Step 2. Initialize the handles slab */
+	handles_ctx->slab = talloc_zero_array(handles_ctx, struct mapi_handles *, MAPI_HANDLES_SLAB_SIZE);
+	if (!handles_ctx->slab) {
+		talloc_free(handles_ctx);
+		return NULL;
+	}
+	handles_ctx->slab_size = MAPI_HANDLES_SLAB_SIZE;
 
-	/* Step 3. Initialize the handles list */
+	/* Step 3. Initialize the free-list and the handles list */
+	handles_ctx->free_list = NULL;
+	handles_ctx->free_count = 0;
+	handles_ctx->free_size = 0;
+	handles_ctx->count = 0;
 	handles_ctx->handles = NULL;
 
 	/* Step 4. Set last_handle to the first valid value */
@@ -71,7 +85,6 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_release(struct mapi_handles_context *handl
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 
-	tdb_close(handles_ctx->tdb_ctx);
 	talloc_free(handles_ctx);
 
 	return MAPI_E_SUCCESS;
@@ -79,7 +92,7 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_release(struct mapi_handles_context *handl
 
 
 /**
-   \details Search for a record in the TDB database
+   \details Search for a record in the handles slab
 
    \param handles_ctx pointer to the MAPI handles context
    \param handle MAPI handle to lookup
@@ -91,168 +104,83 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_release(struct mapi_handles_context *handl
 _PUBLIC_ enum MAPISTATUS mapi_handles_search(struct mapi_handles_context *handles_ctx,
 					     uint32_t handle, struct mapi_handles **rec)
 {
-	TALLOC_CTX		*mem_ctx;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	struct mapi_handles	*el;
-
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slab, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!rec, MAPI_E_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_search");
-
-	/* Step 1. Search for the handle within TDB database */
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
+	OPENCHANGE_RETVAL_IF(handle >= handles_ctx->slab_size, MAPI_E_NOT_FOUND, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slab[handle], MAPI_E_NOT_FOUND, NULL);
 
-	dbuf = tdb_fetch(handles_ctx->tdb_ctx, key);
-	talloc_free(key.dptr);
-	OPENCHANGE_RETVAL_IF(!dbuf.dptr, MAPI_E_NOT_FOUND, mem_ctx);
-	OPENCHANGE_RETVAL_IF(!dbuf.dsize, MAPI_E_NOT_FOUND, mem_ctx);
-
-	talloc_free(mem_ctx);
-	/* Ensure this is not a free'd record */
-	if (dbuf.dsize == (sizeof(MAPI_HANDLES_NULL) - 1) && !strncmp((char *)dbuf.dptr, MAPI_HANDLES_NULL, dbuf.dsize)) {
-		free(dbuf.dptr);
-		return MAPI_E_NOT_FOUND;
-	}
-	free(dbuf.dptr);
-
-	/* Step 2. Return the record within the double chained list */
-	for (el = handles_ctx->handles; el; el = el->next) {
-		if (el->handle == handle) {
-			*rec = el;
-			return MAPI_E_SUCCESS;
-		}
-	}
+	*rec = handles_ctx->slab[handle];
 
-	return MAPI_E_CORRUPT_STORE;
+	return MAPI_E_SUCCESS;
 }
 
 
 /**
-   \details Set a TDB record data as null meaning it can be reused in
-   the future.
+   \details Grow the handles slab so it can hold the handle given as
+   parameter
 
    \param handles_ctx pointer to the MAPI handles context
-   \param handle handle key value to free
+   \param handle the handle value which needs a slot
 
    \return MAPI_E_SUCCESS on success, otherwise MAPI error
  */
-static enum MAPISTATUS mapi_handles_tdb_free(struct mapi_handles_context *handles_ctx,
-					     uint32_t handle)
+static enum MAPISTATUS mapi_handles_slab_grow(struct mapi_handles_context *handles_ctx,
+					      uint32_t handle)
 {
-	TALLOC_CTX		*mem_ctx;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	int			ret;
-
-	/* Sanity checks */
-	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
+	struct mapi_handles	**slab;
+	uint32_t		slab_size;
 
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_tdb_free");
-	
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
-
-	/* Step 1. Makes sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Update existing record */
-	dbuf.dptr = (unsigned char *)MAPI_HANDLES_NULL;
-	dbuf.dsize = sizeof(MAPI_HANDLES_NULL) - 1;
-
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_MODIFY);
-	talloc_free(mem_ctx);
-	if (ret == -1) {
-		DEBUG(3, ("[%s:%d]: Unable to create 0x%x record: %s\n", __FUNCTION__, __LINE__,
-			  handle, tdb_errorstr(handles_ctx->tdb_ctx)));
-		return MAPI_E_CORRUPT_STORE;
+	if (handle < handles_ctx->slab_size) {
+		return MAPI_E_SUCCESS;
 	}
 
-	return MAPI_E_SUCCESS;
-}
-
-
-/**
-   \details Update a TDB record
-
-   
- */
-static enum MAPISTATUS mapi_handles_tdb_update(struct mapi_handles_context *handles_ctx,
-					       uint32_t handle, uint32_t container_handle)
-{
-	TALLOC_CTX	*mem_ctx;
-	TDB_DATA	key;
-	TDB_DATA	dbuf;
-	int		ret;
-
-	/* Sanity checks */
-	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handle, MAPI_E_INVALID_PARAMETER, NULL);
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_tdb_update");
-
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
-
-	/* Step 1. Makes sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Update record */
-	dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", container_handle);
-	dbuf.dsize = strlen((const char *)dbuf.dptr);
+	slab_size = handles_ctx->slab_size;
+	while (slab_size <= handle) {
+		slab_size *= 2;
+	}
 
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_MODIFY);
-	talloc_free(mem_ctx);
-	if (ret == -1) {
-		DEBUG(3, ("[%s:%d]: Unable to update 0x%x record: %s\n", __FUNCTION__, __LINE__,
-			  handle, tdb_errorstr(handles_ctx->tdb_ctx)));
+	slab = talloc_realloc(handles_ctx, handles_ctx->slab, struct mapi_handles *, slab_size);
+	OPENCHANGE_RETVAL_IF(!slab, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+	memset(slab + handles_ctx->slab_size, 0, (slab_size - handles_ctx->slab_size) * sizeof (struct mapi_handles *));
 
-		return MAPI_E_CORRUPT_STORE;	
-	}
+	handles_ctx->slab = slab;
+	handles_ctx->slab_size = slab_size;
 
 	return MAPI_E_SUCCESS;
 }
 
 
 /**
-   \details Traverse TDB database and search for the first record
-   which dbuf value is "null" string.
- 
-   \param tdb_ctx pointer to the TDB context
-   \param key the current TDB key
-   \param dbuf the current TDB value
-   \param state pointer on private data
-
-   \return 1 when a free record is found, otherwise 0
-*/
-static int mapi_handles_traverse_null(TDB_CONTEXT *tdb_ctx,
-				      TDB_DATA key, TDB_DATA dbuf,
-				      void *state)
-{
-	TALLOC_CTX	*mem_ctx;
-	uint32_t	*handle = (uint32_t *) state;
-	char		*handle_str = NULL;
+   \details Push a released handle on the free-list so it can be
+   reused by mapi_handles_add
 
-	if (dbuf.dptr && (dbuf.dsize == sizeof(MAPI_HANDLES_NULL) - 1) && strncmp((const char *)dbuf.dptr, MAPI_HANDLES_NULL, dbuf.dsize) == 0) {
-		mem_ctx = talloc_named(NULL, 0, "mapi_handles_traverse_null");
-		handle_str = talloc_strndup(mem_ctx, (char *)key.dptr, key.dsize);
-		*handle = strtol((const char *) handle_str, NULL, 16);
-		talloc_free(mem_ctx);
+   \param handles_ctx pointer to the MAPI handles context
+   \param handle handle value to free
 
-		return 1;
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS mapi_handles_free_push(struct mapi_handles_context *handles_ctx,
+					      uint32_t handle)
+{
+	uint32_t	*free_list;
+	uint32_t	free_size;
+
+	if (handles_ctx->free_count == handles_ctx->free_size) {
+		free_size = handles_ctx->free_size ? handles_ctx->free_size * 2 : MAPI_HANDLES_SLAB_SIZE;
+		free_list = talloc_realloc(handles_ctx, handles_ctx->free_list, uint32_t, free_size);
+		OPENCHANGE_RETVAL_IF(!free_list, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+		handles_ctx->free_list = free_list;
+		handles_ctx->free_size = free_size;
 	}
 
-	return 0;
+	handles_ctx->free_list[handles_ctx->free_count] = handle;
+	handles_ctx->free_count += 1;
+
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -270,84 +198,61 @@ static int mapi_handles_traverse_null(TDB_CONTEXT *tdb_ctx,
 _PUBLIC_ enum MAPISTATUS mapi_handles_add(struct mapi_handles_context *handles_ctx,
 					  uint32_t container_handle, struct mapi_handles **rec)
 {
-	TALLOC_CTX		*mem_ctx;
 	enum MAPISTATUS		retval;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	uint32_t		handle = 0;
+	uint32_t		handle;
 	struct mapi_handles	*el;
-	int			ret;
+	struct mapi_handles	*parent = NULL;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slab, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!rec, MAPI_E_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_add");
-
-	/* Step 1. Seek the TDB database for the first free record */
-	ret = tdb_traverse(handles_ctx->tdb_ctx, mapi_handles_traverse_null, (void *)&handle);
-	if (ret > -1 && handle > 0) {
-		DEBUG(0, ("We have found free record 0x%x\n", handle));
-		retval = mapi_handles_tdb_update(handles_ctx, handle, container_handle);
-		OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
-		
-		el = talloc_zero((TALLOC_CTX *)handles_ctx, struct mapi_handles);
-		if (!el) {
-			mapi_handles_tdb_free(handles_ctx, handle);
-			talloc_free(mem_ctx);
-			return MAPI_E_NOT_ENOUGH_RESOURCES;
-		}
-
-		el->handle = handle;
-		el->parent_handle = container_handle;
-		el->private_data = NULL;
-		*rec = el;
-		DLIST_ADD_END(handles_ctx->handles, el, struct mapi_handles *);
-
-		talloc_free(mem_ctx);
-
-		return MAPI_E_SUCCESS;
+	/* Step 1. Reuse the most recently released handle if any, otherwise pick a new one */
+	if (handles_ctx->free_count) {
+		handle = handles_ctx->free_list[handles_ctx->free_count - 1];
+	} else {
+		handle = handles_ctx->last_handle;
+		OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+		retval = mapi_handles_slab_grow(handles_ctx, handle);
+		OPENCHANGE_RETVAL_IF(retval, retval, NULL);
 	}
 
-	/* Step 2. If no record is available, create a new one */
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handles_ctx->last_handle);
-	key.dsize = strlen((const char *)key.dptr);
+	el = talloc_zero((TALLOC_CTX *)handles_ctx, struct mapi_handles);
+	OPENCHANGE_RETVAL_IF(!el, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
 
-	if (container_handle) {
-		dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", container_handle);
-		dbuf.dsize = strlen((const char *)dbuf.dptr);
+	if (handles_ctx->free_count) {
+		handles_ctx->free_count -= 1;
 	} else {
-		dbuf.dptr = (unsigned char *) MAPI_HANDLES_ROOT;
-		dbuf.dsize = strlen(MAPI_HANDLES_ROOT);
+		handles_ctx->last_handle += 1;
 	}
 
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_INSERT);
-	if (ret == -1) {
-		DEBUG(3, ("[%s:%d]: Unable to create 0x%x record: %s\n", __FUNCTION__, __LINE__,
-			  handles_ctx->last_handle, tdb_errorstr(handles_ctx->tdb_ctx)));
-		talloc_free(mem_ctx);
+	el->handle = handle;
+	el->parent_handle = container_handle;
+	el->private_data = NULL;
+	el->children = NULL;
 
-		return MAPI_E_CORRUPT_STORE;
-	}
+	/* Step 2. Reference the record within the slab and the handles list */
+	handles_ctx->slab[handle] = el;
+	handles_ctx->count += 1;
+	DLIST_ADD_END(handles_ctx->handles, el, struct mapi_handles *);
 
-	el = talloc_zero((TALLOC_CTX *)handles_ctx, struct mapi_handles);
-	if (!el) {
-		mapi_handles_tdb_free(handles_ctx, handles_ctx->last_handle);
-		talloc_free(mem_ctx);
-		return MAPI_E_NOT_ENOUGH_RESOURCES;
+	/* Step 3. Attach the record to its container children list */
+	if (container_handle && container_handle < handles_ctx->slab_size) {
+		parent = handles_ctx->slab[container_handle];
+	}
+	if (parent) {
+		el->sibling_prev = NULL;
+		el->sibling_next = parent->children;
+		if (parent->children) {
+			parent->children->sibling_prev = el;
+		}
+		parent->children = el;
 	}
 
-	el->handle = handles_ctx->last_handle;
-	el->parent_handle = container_handle;
-	el->private_data = NULL;
 	*rec = el;
-	DLIST_ADD_END(handles_ctx->handles, el, struct mapi_handles *);
 
 	DEBUG(5, ("handle 0x%.2x is a father of 0x%.2x\n", container_handle, el->handle));
-	handles_ctx->last_handle += 1;
-	talloc_free(mem_ctx);
 
 	return MAPI_E_SUCCESS;
 }
@@ -396,55 +301,9 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_set_private_data(struct mapi_handles *hand
 }
 
 
-struct mapi_handles_private {
-	struct mapi_handles_context	*handles_ctx;
-	uint32_t			container_handle;
-};
-
-/**
-   \details Traverse TDB database and search for records
-   which dbuf value is set to state.
- 
-   \param tdb_ctx pointer to the TDB context
-   \param key the current TDB key (potential child handle)
-   \param dbuf the current TDB value (parent handle)
-   \param state pointer on private data
-
-   \return 1 when a free record is found, otherwise 0
-*/
-static int mapi_handles_traverse_delete(TDB_CONTEXT *tdb_ctx,
-					TDB_DATA key, TDB_DATA dbuf,
-					void *state)
-{
-	TALLOC_CTX			*mem_ctx;
-	struct mapi_handles_private	*handles_private = (struct mapi_handles_private *) state;
-	uint32_t			handle;
-	char				*container_handle_str = NULL;
-	char				*handle_str = NULL;
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_traverse_delete");
-	container_handle_str = talloc_asprintf(mem_ctx, "0x%x", handles_private->container_handle);
-
-	if (dbuf.dptr && strlen(container_handle_str) == dbuf.dsize && strncmp((const char *)dbuf.dptr, container_handle_str, dbuf.dsize) == 0) {
-		handle_str = talloc_strndup(mem_ctx, (char *)key.dptr, key.dsize);
-		DEBUG(5, ("handles being released must NOT have child handles attached to them (%s is a child of %s)\n", handle_str, container_handle_str));
-		handle = strtol((const char *) handle_str, NULL, 16);
-		/* abort(); */
-		/* DEBUG(5, ("deleting child handle: %d, %s\n", handle, handle_str)); */
-		mapi_handles_delete(handles_private->handles_ctx, handle);
-	}
-
-	talloc_free(mem_ctx);
-
-	return 0;
-}
-
-
-
 /**
    \details Remove the MAPI handle referenced by the handle parameter
-   from the double chained list and mark its associated TDB record as
-   null
+   from the handles slab and release its children hierarchy
 
    \param handles_ctx pointer to the MAPI handles context
    \param handle the handle to delete
@@ -454,56 +313,57 @@ static int mapi_handles_traverse_delete(TDB_CONTEXT *tdb_ctx,
 _PUBLIC_ enum MAPISTATUS mapi_handles_delete(struct mapi_handles_context *handles_ctx, 
 					     uint32_t handle)
 {
-	TALLOC_CTX			*mem_ctx;
 	enum MAPISTATUS			retval;
-	TDB_DATA			key;
 	struct mapi_handles		*el;
-	struct mapi_handles_private	handles_private;
-	int				ret;
-	bool				found = false;
+	struct mapi_handles		*parent = NULL;
+	struct mapi_handles		*child;
+	struct mapi_handles		*next;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slab, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
 
-	DEBUG(4, ("[%s:%d]: Deleting MAPI handle 0x%x (handles_ctx: %p, tdb_ctx: %p)\n", __FUNCTION__, __LINE__,
-		  handle, handles_ctx, handles_ctx->tdb_ctx));
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_delete");
-
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
+	DEBUG(4, ("[%s:%d]: Deleting MAPI handle 0x%x (handles_ctx: %p)\n", __FUNCTION__, __LINE__,
+		  handle, handles_ctx));
 
 	/* Step 1. Make sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Delete this record from the double chained list */
-	for (el = handles_ctx->handles; el; el = el->next) {
-		if (el->handle == handle) {
-			DLIST_REMOVE(handles_ctx->handles, el);
-			talloc_free(el);
-			found = true;
-			break;
+	OPENCHANGE_RETVAL_IF(handle >= handles_ctx->slab_size, MAPI_E_NOT_FOUND, NULL);
+	el = handles_ctx->slab[handle];
+	OPENCHANGE_RETVAL_IF(!el, MAPI_E_NOT_FOUND, NULL);
+
+	/* Step 2. Detach this record from its container children list */
+	if (el->parent_handle && el->parent_handle < handles_ctx->slab_size) {
+		parent = handles_ctx->slab[el->parent_handle];
+	}
+	if (parent) {
+		if (el->sibling_prev) {
+			el->sibling_prev->sibling_next = el->sibling_next;
+		} else if (parent->children == el) {
+			parent->children = el->sibling_next;
+		}
+		if (el->sibling_next) {
+			el->sibling_next->sibling_prev = el->sibling_prev;
 		}
 	}
-	/* This case should never occur */
-	OPENCHANGE_RETVAL_IF(found == false, MAPI_E_CORRUPT_STORE, mem_ctx);
 
-	/* Step 3. Free this record within the TDB database */
-	retval = mapi_handles_tdb_free(handles_ctx, handle);
-	/* if (retval) { */
-	/* 	abort(); */
-	/* } */
-	OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
+	/* Step 3. Delete this record from the slab and the double chained list */
+	child = el->children;
+	handles_ctx->slab[handle] = NULL;
+	handles_ctx->count -= 1;
+	DLIST_REMOVE(handles_ctx->handles, el);
+	talloc_free(el);
 
 	/* Step 4. Delete hierarchy of children */
-	handles_private.handles_ctx = handles_ctx;
-	handles_private.container_handle = handle;
-	ret = tdb_traverse(handles_ctx->tdb_ctx, mapi_handles_traverse_delete, (void *)&handles_private);
+	for (; child; child = next) {
+		next = child->sibling_next;
+		DEBUG(5, ("handles being released must NOT have child handles attached to them (0x%x is a child of 0x%x)\n", child->handle, handle));
+		mapi_handles_delete(handles_ctx, child->handle);
+	}
 
-	talloc_free(mem_ctx);
+	/* Step 5. Make the handle available for reuse */
+	retval = mapi_handles_free_push(handles_ctx, handle);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
 
 	DEBUG(4, ("[%s:%d]: Deleting MAPI handle 0x%x COMPLETE\n", __FUNCTION__, __LINE__, handle));
 
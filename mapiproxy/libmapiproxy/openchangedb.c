@@ -1661,11 +1661,14 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_mid_by_subject(struct ldb_context *ldb
 
 _PUBLIC_ enum MAPISTATUS openchangedb_delete_folder(struct ldb_context *ldb_ctx, uint64_t fid)
 {
-	TALLOC_CTX	*mem_ctx;
-	char		*dnstr;
-	struct ldb_dn	*dn;
-	int		retval;
-	enum MAPISTATUS	ret;
+	TALLOC_CTX		*mem_ctx;
+	char			*dnstr;
+	struct ldb_dn		*dn;
+	struct ldb_result	*res = NULL;
+	const char * const	attrs[] = { "PidTagParentFolderId", NULL };
+	uint64_t		parent_fid = 0;
+	int			retval;
+	enum MAPISTATUS		ret;
 
 	mem_ctx = talloc_zero(NULL, TALLOC_CTX);
 
@@ -1675,8 +1678,17 @@ _PUBLIC_ enum MAPISTATUS openchangedb_delete_folder(struct ldb_context *ldb_ctx,
 	}
 
 	dn = ldb_dn_new(mem_ctx, ldb_ctx, dnstr);
+
+	retval = ldb_search(ldb_ctx, mem_ctx, &res, dn, LDB_SCOPE_BASE, attrs, NULL);
+	if (retval == LDB_SUCCESS && res->count) {
+		parent_fid = ldb_msg_find_attr_as_uint64(res->msgs[0], "PidTagParentFolderId", 0);
+	}
+
 	retval = ldb_delete(ldb_ctx, dn);
 	if (retval == LDB_SUCCESS) {
+		if (parent_fid) {
+			openchangedb_table_invalidate(parent_fid);
+		}
 		ret = MAPI_E_SUCCESS;
 	}
 	else {
@@ -2047,6 +2059,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_create_folder(struct ldb_context *ldb_ctx,
 	error = ldb_add(ldb_ctx, msg);
 	switch (error) {
 	case 0:
+		openchangedb_table_invalidate(parentFolderID);
 		retval = MAPI_E_SUCCESS;
 		break;
 	case 68:
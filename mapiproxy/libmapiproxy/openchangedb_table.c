@@ -32,6 +32,50 @@
 #include "libmapi/libmapi.h"
 #include "libmapi/libmapi_private.h"
 
+/* live openchangedb tables, so folder changes can invalidate their views */
+static struct openchangedb_table	*openchangedb_tables = NULL;
+
+struct openchangedb_table_sort_key {
+	bool		present;
+	uint64_t	num;
+	const char	*str;
+};
+
+struct openchangedb_table_sort_ctx {
+	struct SSortOrderSet			*lpSortCriteria;
+	struct openchangedb_table_sort_key	*keys;
+};
+
+static int openchangedb_table_destructor(struct openchangedb_table *table)
+{
+	DLIST_REMOVE(openchangedb_tables, table);
+	return 0;
+}
+
+static void openchangedb_table_reset_view(struct openchangedb_table *table)
+{
+	talloc_free(table->view);
+	talloc_free(table->matches);
+	table->view = NULL;
+	table->matches = NULL;
+	table->view_count = 0;
+}
+
+static void openchangedb_table_reset_rows(struct openchangedb_table *table)
+{
+	openchangedb_table_reset_view(table);
+	talloc_free(table->rows);
+	table->rows = NULL;
+	table->row_count = 0;
+}
+
+static void openchangedb_table_reset_res(struct openchangedb_table *table)
+{
+	openchangedb_table_reset_rows(table);
+	talloc_free(table->res);
+	table->res = NULL;
+}
+
 /**
    /details Initialize an openchangedb table
 
@@ -61,6 +105,9 @@ _PUBLIC_ enum MAPISTATUS openchangedb_table_init(TALLOC_CTX *mem_ctx, uint8_t ta
 	table->restrictions = NULL;
 	table->res = NULL;
 
+	DLIST_ADD(openchangedb_tables, table);
+	talloc_set_destructor(table, openchangedb_table_destructor);
+
 	*table_object = (void *)table;
 
 	return MAPI_E_SUCCESS;
@@ -86,10 +133,8 @@ _PUBLIC_ enum MAPISTATUS openchangedb_table_set_sort_order(void *table_object,
 
 	table = (struct openchangedb_table *) table_object;
 
-	if (table->res) {
-		talloc_free(table->res);
-		table->res = NULL;
-	}
+	/* The search results are kept, only the row vector is rebuilt */
+	openchangedb_table_reset_rows(table);
 
 	if (table->lpSortCriteria) {
 		talloc_free(table->lpSortCriteria);
@@ -112,6 +157,15 @@ _PUBLIC_ enum MAPISTATUS openchangedb_table_set_sort_order(void *table_object,
 }
 
 
+/**
+   \details Set restrictions to specified openchangedb table object
+
+   \param table_object pointer to the table object
+   \param res pointer to the restriction to save, NULL to remove
+   existing restrictions
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
 _PUBLIC_ enum MAPISTATUS openchangedb_table_set_restrictions(void *table_object,
 							     struct mapi_SRestriction *res)
 {
@@ -119,14 +173,11 @@ _PUBLIC_ enum MAPISTATUS openchangedb_table_set_restrictions(void *table_object,
 
 	/* Sanity checks */
 	MAPI_RETVAL_IF(!table_object, MAPI_E_NOT_INITIALIZED, NULL);
-	MAPI_RETVAL_IF(!res, MAPI_E_INVALID_PARAMETER, NULL);
 
 	table = (struct openchangedb_table *) table_object;
 
-	if (table->res) {
-		talloc_free(table->res);
-		table->res = NULL;
-	}
+	/* The sorted row vector is kept, only the view is rebuilt */
+	openchangedb_table_reset_view(table);
 
 	if (table->restrictions) {
 		talloc_free(table->restrictions);
@@ -163,59 +214,313 @@ _PUBLIC_ enum MAPISTATUS openchangedb_table_set_restrictions(void *table_object,
 	return MAPI_E_SUCCESS;
 }
 
-static char *openchangedb_table_build_filter(TALLOC_CTX *mem_ctx, struct openchangedb_table *table, uint64_t row_fmid, struct mapi_SRestriction *restrictions)
+
+/**
+   \details Drop the materialized view of every table listing the
+   children of a folder. This must be called whenever a child is added
+   to or removed from the folder.
+
+   \param folderID the identifier of the modified folder
+ */
+_PUBLIC_ void openchangedb_table_invalidate(uint64_t folderID)
 {
-	char		*filter = NULL;
-	const char	*PidTagAttr = NULL;
+	struct openchangedb_table	*table;
+
+	for (table = openchangedb_tables; table; table = table->next) {
+		if (table->folderID == folderID) {
+			openchangedb_table_reset_res(table);
+		}
+	}
+}
 
+static char *openchangedb_table_build_filter(TALLOC_CTX *mem_ctx, struct openchangedb_table *table)
+{
 	switch (table->table_type) {
 	case 0x3 /* EMSMDBP_TABLE_FAI_TYPE */:
-		filter = talloc_asprintf(mem_ctx, "(&(objectClass=faiMessage)(PidTagParentFolderId=%"PRIu64")(PidTagMessageId=", table->folderID);
-		break;
+		return talloc_asprintf(mem_ctx, "(&(objectClass=faiMessage)(PidTagParentFolderId=%"PRIu64")(PidTagMessageId=*))", table->folderID);
 	case 0x2 /* EMSMDBP_TABLE_MESSAGE_TYPE */:
-		filter = talloc_asprintf(mem_ctx, "(&(objectClass=systemMessage)(PidTagParentFolderId=%"PRIu64")(PidTagMessageId=", table->folderID);
-		break;
+		return talloc_asprintf(mem_ctx, "(&(objectClass=systemMessage)(PidTagParentFolderId=%"PRIu64")(PidTagMessageId=*))", table->folderID);
 	case 0x1 /* EMSMDBP_TABLE_FOLDER_TYPE */:
-		filter = talloc_asprintf(mem_ctx, "(&(PidTagParentFolderId=%"PRIu64")(PidTagFolderId=", table->folderID);
+		return talloc_asprintf(mem_ctx, "(&(PidTagParentFolderId=%"PRIu64")(PidTagFolderId=*))", table->folderID);
+	}
+
+	return NULL;
+}
+
+static void openchangedb_table_sort_key_fill(TALLOC_CTX *mem_ctx, struct ldb_message *msg,
+					     uint32_t proptag, struct openchangedb_table_sort_key *key)
+{
+	const char		*PidTagAttr;
+	const char		*str;
+	struct ldb_val		val;
+
+	key->present = false;
+
+	PidTagAttr = openchangedb_property_get_attribute(proptag);
+	if (!PidTagAttr || !ldb_msg_find_element(msg, PidTagAttr)) {
+		return;
+	}
+
+	switch (proptag & 0xFFFF) {
+	case PT_BOOLEAN:
+		key->num = ldb_msg_find_attr_as_bool(msg, PidTagAttr, 0x0);
 		break;
+	case PT_LONG:
+	case PT_I8:
+	case PT_SYSTIME:
+		key->num = ldb_msg_find_attr_as_uint64(msg, PidTagAttr, 0x0);
+		break;
+	case PT_STRING8:
+	case PT_UNICODE:
+		str = ldb_msg_find_attr_as_string(msg, PidTagAttr, NULL);
+		if (!str) {
+			return;
+		}
+		val = ldb_binary_decode(mem_ctx, str);
+		key->str = (const char *) val.data;
+		break;
+	default:
+		/* Other types do not take part in the ordering */
+		return;
 	}
 
-	if (row_fmid == 0) {
-		filter = talloc_asprintf_append(filter, "*)");
+	key->present = true;
+}
+
+static int openchangedb_table_sort_compare(void *v1, void *v2, void *opaque)
+{
+	struct openchangedb_table_sort_ctx	*ctx = (struct openchangedb_table_sort_ctx *) opaque;
+	uint32_t				row1 = *(uint32_t *) v1;
+	uint32_t				row2 = *(uint32_t *) v2;
+	uint32_t				cSorts = ctx->lpSortCriteria->cSorts;
+	struct openchangedb_table_sort_key	*key1, *key2;
+	uint32_t				i;
+	int					ret;
+
+	for (i = 0; i < cSorts; i++) {
+		key1 = &ctx->keys[row1 * cSorts + i];
+		key2 = &ctx->keys[row2 * cSorts + i];
+
+		if (key1->present != key2->present) {
+			ret = key1->present ? 1 : -1;
+		}
+		else if (!key1->present) {
+			ret = 0;
+		}
+		else if (key1->str || key2->str) {
+			ret = strcasecmp(key1->str ? key1->str : "", key2->str ? key2->str : "");
+		}
+		else {
+			ret = (key1->num > key2->num) - (key1->num < key2->num);
+		}
+
+		if (ret) {
+			return (ctx->lpSortCriteria->aSort[i].ulOrder == TABLE_SORT_DESCEND) ? -ret : ret;
+		}
 	}
-	else {
-		filter = talloc_asprintf_append(filter, "%"PRIu64")", row_fmid);
+
+	/* Keep the search order for equal rows */
+	return (row1 > row2) - (row1 < row2);
+}
+
+/**
+   \details Build the sorted row vector of an openchangedb table
+
+   Sort keys are extracted once per row, then the vector of result
+   indexes is sorted in memory.
+ */
+static enum MAPISTATUS openchangedb_table_build_rows(struct openchangedb_table *table)
+{
+	TALLOC_CTX				*mem_ctx;
+	struct openchangedb_table_sort_ctx	ctx;
+	uint32_t				cSorts, i, j;
+
+	table->rows = talloc_array((TALLOC_CTX *)table, uint32_t, table->res->count);
+	OPENCHANGE_RETVAL_IF(table->res->count && !table->rows, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	table->row_count = table->res->count;
+	for (i = 0; i < table->row_count; i++) {
+		table->rows[i] = i;
 	}
 
-	if (restrictions) {
-		switch (restrictions->rt) {
-		case RES_PROPERTY:
-			/* Retrieve PidTagName */
-			PidTagAttr = openchangedb_property_get_attribute(restrictions->res.resProperty.ulPropTag);
-			if (!PidTagAttr) {
-				talloc_free(filter);
-				return NULL;
-			}
-			filter = talloc_asprintf_append(filter, "(%s=", PidTagAttr);
-			switch (restrictions->res.resProperty.ulPropTag & 0xFFFF) {
-			case PT_STRING8:
-				filter = talloc_asprintf_append(filter, "%s)", restrictions->res.resProperty.lpProp.value.lpszA);
-				break;
-			case PT_UNICODE:
-				filter = talloc_asprintf_append(filter, "%s)", restrictions->res.resProperty.lpProp.value.lpszW);
-				break;
-			default:
-				DEBUG(0, ("Unsupported RES_PROPERTY property type: 0x%.4x\n", (restrictions->res.resProperty.ulPropTag & 0xFFFF)));
-				talloc_free(filter);
-				return NULL;
+	if (!table->lpSortCriteria || !table->lpSortCriteria->cSorts || table->row_count < 2) {
+		return MAPI_E_SUCCESS;
+	}
+
+	mem_ctx = talloc_new(NULL);
+	cSorts = table->lpSortCriteria->cSorts;
+	ctx.lpSortCriteria = table->lpSortCriteria;
+	ctx.keys = talloc_zero_array(mem_ctx, struct openchangedb_table_sort_key, table->row_count * cSorts);
+	OPENCHANGE_RETVAL_IF(!ctx.keys, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+
+	for (i = 0; i < table->row_count; i++) {
+		for (j = 0; j < cSorts; j++) {
+			openchangedb_table_sort_key_fill(ctx.keys, table->res->msgs[i],
+							 table->lpSortCriteria->aSort[j].ulPropTag,
+							 &ctx.keys[i * cSorts + j]);
+		}
+	}
+
+	ldb_qsort(table->rows, table->row_count, sizeof (uint32_t), &ctx, openchangedb_table_sort_compare);
+
+	talloc_free(mem_ctx);
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Evaluate the table restriction against an openchangedb row
+
+   Values are compared with the LDB attribute syntax, so the result
+   matches an equality LDB search filter.
+ */
+static bool openchangedb_table_row_matches(TALLOC_CTX *mem_ctx, struct ldb_context *ldb_ctx,
+					   struct mapi_SRestriction *restrictions,
+					   struct ldb_message *msg)
+{
+	const struct ldb_schema_attribute	*a;
+	struct ldb_message_element		*el;
+	struct ldb_val				val;
+	const char				*PidTagAttr;
+	const char				*str;
+	unsigned int				i;
+
+	if (!restrictions) {
+		return true;
+	}
+
+	switch (restrictions->rt) {
+	case RES_PROPERTY:
+		PidTagAttr = openchangedb_property_get_attribute(restrictions->res.resProperty.ulPropTag);
+		if (!PidTagAttr) {
+			return false;
+		}
+		switch (restrictions->res.resProperty.ulPropTag & 0xFFFF) {
+		case PT_STRING8:
+			str = restrictions->res.resProperty.lpProp.value.lpszA;
+			break;
+		case PT_UNICODE:
+			str = restrictions->res.resProperty.lpProp.value.lpszW;
+			break;
+		default:
+			DEBUG(0, ("Unsupported RES_PROPERTY property type: 0x%.4x\n", (restrictions->res.resProperty.ulPropTag & 0xFFFF)));
+			return false;
+		}
+		if (!str) {
+			return false;
+		}
+
+		el = ldb_msg_find_element(msg, PidTagAttr);
+		if (!el) {
+			return false;
+		}
+
+		a = ldb_schema_attribute_by_name(ldb_ctx, PidTagAttr);
+		val = ldb_binary_decode(mem_ctx, str);
+		for (i = 0; i < el->num_values; i++) {
+			if (a->syntax->comparison_fn(ldb_ctx, mem_ctx, &el->values[i], &val) == 0) {
+				return true;
 			}
 		}
+		return false;
+	default:
+		return true;
+	}
+}
+
+/**
+   \details Build the restricted view of an openchangedb table from its
+   sorted row vector
+ */
+static enum MAPISTATUS openchangedb_table_build_view(struct openchangedb_table *table,
+						     struct ldb_context *ldb_ctx)
+{
+	TALLOC_CTX	*mem_ctx;
+	uint32_t	i;
+
+	table->matches = talloc_array((TALLOC_CTX *)table, bool, table->row_count);
+	table->view = talloc_array((TALLOC_CTX *)table, uint32_t, table->row_count);
+	OPENCHANGE_RETVAL_IF(table->row_count && (!table->matches || !table->view), MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	mem_ctx = talloc_new(NULL);
+	table->view_count = 0;
+	for (i = 0; i < table->row_count; i++) {
+		table->matches[i] = openchangedb_table_row_matches(mem_ctx, ldb_ctx, table->restrictions,
+								   table->res->msgs[table->rows[i]]);
+		if (table->matches[i]) {
+			table->view[table->view_count++] = table->rows[i];
+		}
+	}
+	talloc_free(mem_ctx);
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Make sure the search results, the sorted row vector and the
+   restricted view of an openchangedb table are available
+ */
+static enum MAPISTATUS openchangedb_table_materialize(struct openchangedb_table *table,
+						      struct ldb_context *ldb_ctx)
+{
+	enum MAPISTATUS		retval;
+	const char * const	attrs[] = { "*", NULL };
+	char			*ldb_filter;
+	int			ret;
+
+	if (!table->res) {
+		ldb_filter = openchangedb_table_build_filter(NULL, table);
+		OPENCHANGE_RETVAL_IF(!ldb_filter, MAPI_E_TOO_COMPLEX, NULL);
+		DEBUG(5, ("ldb_filter = %s\n", ldb_filter));
+		ret = ldb_search(ldb_ctx, (TALLOC_CTX *)table, &table->res, ldb_get_default_basedn(ldb_ctx), LDB_SCOPE_SUBTREE, attrs, ldb_filter, NULL);
+		talloc_free(ldb_filter);
+		OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_INVALID_OBJECT, NULL);
+	}
+
+	if (!table->rows) {
+		retval = openchangedb_table_build_rows(table);
+		OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+	}
+
+	if (!table->view) {
+		retval = openchangedb_table_build_view(table, ldb_ctx);
+		OPENCHANGE_RETVAL_IF(retval, retval, NULL);
 	}
 
-	/* Close filter */
-	filter = talloc_asprintf_append(filter, ")");
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Retrieve the number of rows of an openchangedb table
 
-	return filter;
+   \param table_object pointer to the table object
+   \param ldb_ctx pointer to the openchange LDB context
+   \param live_filtered whether restrictions are applied when fetching
+   rows (true) or when counting them (false)
+   \param row_countp pointer to the number of rows to return
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_table_get_row_count(void *table_object,
+							  struct ldb_context *ldb_ctx,
+							  bool live_filtered,
+							  uint32_t *row_countp)
+{
+	struct openchangedb_table	*table;
+	enum MAPISTATUS			retval;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!table_object, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!ldb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!row_countp, MAPI_E_INVALID_PARAMETER, NULL);
+
+	table = (struct openchangedb_table *)table_object;
+
+	retval = openchangedb_table_materialize(table, ldb_ctx);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	*row_countp = live_filtered ? table->row_count : table->view_count;
+
+	return MAPI_E_SUCCESS;
 }
 
 _PUBLIC_ enum MAPISTATUS openchangedb_table_get_property(TALLOC_CTX *mem_ctx,
@@ -227,12 +532,9 @@ _PUBLIC_ enum MAPISTATUS openchangedb_table_get_property(TALLOC_CTX *mem_ctx,
 							 void **data)
 {
 	struct openchangedb_table	*table;
-	char				*ldb_filter = NULL;
-	struct ldb_result		*res = NULL, *live_res = NULL;
-	const char * const		attrs[] = { "*", NULL };
-	const char			*PidTagAttr = NULL, *childIdAttr;
-	uint64_t			*row_fmid;
-	int				ret;
+	struct ldb_message		*msg;
+	const char			*PidTagAttr = NULL;
+	enum MAPISTATUS			retval;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!table_object, MAPI_E_NOT_INITIALIZED, NULL);
@@ -242,56 +544,19 @@ _PUBLIC_ enum MAPISTATUS openchangedb_table_get_property(TALLOC_CTX *mem_ctx,
 	table = (struct openchangedb_table *)table_object;
 
 	/* Fetch results */
-	if (!table->res) {
-		/* Build ldb filter */
-		if (live_filtered) {
-			ldb_filter = openchangedb_table_build_filter(NULL, table, 0, NULL);
-			DEBUG(0, ("(live-filtered) ldb_filter = %s\n", ldb_filter));
-		}
-		else {
-			ldb_filter = openchangedb_table_build_filter(NULL, table, 0, table->restrictions);
-			DEBUG(0, ("(pre-filtered) ldb_filter = %s\n", ldb_filter));
-		}
-		OPENCHANGE_RETVAL_IF(!ldb_filter, MAPI_E_TOO_COMPLEX, NULL);
-		ret = ldb_search(ldb_ctx, (TALLOC_CTX *)table_object, &table->res, ldb_get_default_basedn(ldb_ctx), LDB_SCOPE_SUBTREE, attrs, ldb_filter, NULL);
-		talloc_free(ldb_filter);
-		OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_INVALID_OBJECT, NULL);
-	}
-	res = table->res;
+	retval = openchangedb_table_materialize(table, ldb_ctx);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
 
-	/* Ensure position is within search results range */
-	OPENCHANGE_RETVAL_IF(pos >= res->count, MAPI_E_INVALID_OBJECT, NULL);
-
-	/* If live filtering, make sure the specified row match the restrictions */
+	/* Ensure position is within the view range. If live filtering,
+	 * make sure the specified row match the restrictions */
 	if (live_filtered) {
-		TALLOC_CTX *local_mem_ctx;
-
-		switch (table->table_type) {
-		case 0x3 /* EMSMDBP_TABLE_FAI_TYPE */:
-		case 0x2 /* EMSMDBP_TABLE_MESSAGE_TYPE */:
-			childIdAttr = "PidTagMessageId";
-			break;
-		case 0x1 /* EMSMDBP_TABLE_FOLDER_TYPE */:
-			childIdAttr = "PidTagFolderId";
-			break;
-		default:
-			DEBUG(0, ("unsupported table type for openchangedb: %d\n", table->table_type));
-			abort();
-		}
-		row_fmid = openchangedb_get_property_data(mem_ctx, res, pos, PR_MID, childIdAttr);
-		if (!row_fmid || !*row_fmid) {
-			DEBUG(0, ("ldb object must have a '%s' field\n", childIdAttr));
-			abort();
-		}
-
-		local_mem_ctx = talloc_zero(NULL, TALLOC_CTX);
-
-		ldb_filter = openchangedb_table_build_filter(local_mem_ctx, table, *row_fmid, table->restrictions);
-		OPENCHANGE_RETVAL_IF(!ldb_filter, MAPI_E_TOO_COMPLEX, NULL);
-		DEBUG(0, ("  row ldb_filter = %s\n", ldb_filter));
-		ret = ldb_search(ldb_ctx, local_mem_ctx, &live_res, ldb_get_default_basedn(ldb_ctx), LDB_SCOPE_SUBTREE, attrs, ldb_filter, NULL);
-		OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS || live_res->count == 0, MAPI_E_INVALID_OBJECT, local_mem_ctx);
-		talloc_free(local_mem_ctx);
+		OPENCHANGE_RETVAL_IF(pos >= table->row_count, MAPI_E_INVALID_OBJECT, NULL);
+		OPENCHANGE_RETVAL_IF(!table->matches[pos], MAPI_E_INVALID_OBJECT, NULL);
+		msg = table->res->msgs[table->rows[pos]];
+	}
+	else {
+		OPENCHANGE_RETVAL_IF(pos >= table->view_count, MAPI_E_INVALID_OBJECT, NULL);
+		msg = table->res->msgs[table->view[pos]];
 	}
 
 	/* hacks for some attributes specific to tables */
@@ -316,14 +581,14 @@ _PUBLIC_ enum MAPISTATUS openchangedb_table_get_property(TALLOC_CTX *mem_ctx,
 	OPENCHANGE_RETVAL_IF(!PidTagAttr, MAPI_E_NOT_FOUND, NULL);
 
 	/* Ensure the element exists */
-	OPENCHANGE_RETVAL_IF(!ldb_msg_find_element(res->msgs[pos], PidTagAttr), MAPI_E_NOT_FOUND, NULL);
+	OPENCHANGE_RETVAL_IF(!ldb_msg_find_element(msg, PidTagAttr), MAPI_E_NOT_FOUND, NULL);
 
 	/* Check if this is a "special property" */
-	*data = openchangedb_get_special_property(mem_ctx, ldb_ctx, res, proptag, PidTagAttr);
+	*data = openchangedb_get_special_property(mem_ctx, ldb_ctx, table->res, proptag, PidTagAttr);
 	OPENCHANGE_RETVAL_IF(*data != NULL, MAPI_E_SUCCESS, NULL);
 
 	/* Check if this is NOT a "special property" */
-	*data = openchangedb_get_property_data(mem_ctx, res, pos, proptag, PidTagAttr);
+	*data = openchangedb_get_property_data_message(mem_ctx, msg, proptag, PidTagAttr);
 	OPENCHANGE_RETVAL_IF(*data != NULL, MAPI_E_SUCCESS, NULL);
 
 	return MAPI_E_NOT_FOUND;
@@ -212,6 +212,7 @@ struct mapistore_backend {
                 enum mapistore_error	(*set_restrictions)(void *, struct mapi_SRestriction *, uint8_t *);
                 enum mapistore_error	(*set_sort_order)(void *, struct SSortOrderSet *, uint8_t *);
                 enum mapistore_error	(*get_row)(void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, struct mapistore_property_data **);
+                enum mapistore_error	(*get_rows)(void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, uint32_t, struct mapistore_property_data ***);
                 enum mapistore_error	(*get_row_count)(void *, enum mapistore_query_type, uint32_t *);
 		enum mapistore_error	(*handle_destructor)(void *, uint32_t);
         } table;
@@ -248,13 +249,23 @@ struct backend_context_list {
 };
 
 struct processing_context;
+struct mapistore_cache;
+
+struct mapistore_cache_stats {
+	uint32_t	entries;
+	uint32_t	max_entries;
+	uint64_t	hits;
+	uint64_t	misses;
+	uint64_t	evictions;
+};
 
 struct mapistore_context {
 	struct processing_context		*processing_ctx;
 	struct backend_context_list		*context_list;
-	struct indexing_context_list		*indexing_list;
-	struct replica_mapping_context_list	*replica_mapping_list;
+	struct mapistore_cache			*indexing_cache;
+	struct mapistore_cache			*replica_mapping_cache;
 	struct mapistore_subscription_list	*subscriptions;
+	struct mapistore_subscription_index	*subscription_index;
 	struct mapistore_notification_list	*notifications;
 	struct ldb_context			*nprops_ctx;
 	struct mapistore_connection_info	*conn_info;
@@ -341,6 +352,7 @@ enum mapistore_error mapistore_table_set_columns(struct mapistore_context *, uin
 enum mapistore_error mapistore_table_set_restrictions(struct mapistore_context *, uint32_t, void *, struct mapi_SRestriction *, uint8_t *);
 enum mapistore_error mapistore_table_set_sort_order(struct mapistore_context *, uint32_t, void *, struct SSortOrderSet *, uint8_t *);
 enum mapistore_error mapistore_table_get_row(struct mapistore_context *, uint32_t, void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, struct mapistore_property_data **);
+enum mapistore_error mapistore_table_get_rows(struct mapistore_context *, uint32_t, void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, uint32_t, struct mapistore_property_data ***);
 enum mapistore_error mapistore_table_get_row_count(struct mapistore_context *, uint32_t, void *, enum mapistore_query_type, uint32_t *);
 enum mapistore_error mapistore_table_handle_destructor(struct mapistore_context *, uint32_t, void *, uint32_t);
 
@@ -373,11 +385,13 @@ enum mapistore_error mapistore_indexing_record_add_mid(struct mapistore_context
 enum mapistore_error mapistore_indexing_record_del_mid(struct mapistore_context *, uint32_t, const char *, uint64_t, uint8_t);
 enum mapistore_error mapistore_indexing_record_get_uri(struct mapistore_context *, const char *, TALLOC_CTX *, uint64_t, char **, bool *);
 enum mapistore_error mapistore_indexing_record_get_fmid(struct mapistore_context *, const char *, const char *, bool, uint64_t *, bool *);
+enum mapistore_error mapistore_indexing_get_cache_stats(struct mapistore_context *, struct mapistore_cache_stats *);
 
 /* definitions from mapistore_replica_mapping.c */
 enum mapistore_error mapistore_replica_mapping_add(struct mapistore_context *, const char *, struct replica_mapping_context_list **);
 enum mapistore_error mapistore_replica_mapping_guid_to_replid(struct mapistore_context *, const char *username, const struct GUID *, uint16_t *);
 enum mapistore_error mapistore_replica_mapping_replid_to_guid(struct mapistore_context *, const char *username, uint16_t, struct GUID *);
+enum mapistore_error mapistore_replica_mapping_get_cache_stats(struct mapistore_context *, struct mapistore_cache_stats *);
 
 /* definitions from mapistore_namedprops.c */
 enum mapistore_error mapistore_namedprops_get_mapped_id(struct ldb_context *ldb_ctx, struct MAPINAMEID, uint16_t *);
@@ -422,6 +436,8 @@ struct mapistore_subscription {
 		struct mapistore_table_subscription_parameters table_parameters;
 		struct mapistore_object_subscription_parameters object_parameters;
 	} parameters;
+	struct mapistore_subscription_index		*index;
+	struct mapistore_subscription_index_entry	*index_entries;
 #if 0
 	char		*mqueue_name;
 	mqd_t		mqueue;
@@ -725,6 +725,22 @@ enum mapistore_error mapistore_backend_table_get_row(struct backend_context *bct
         return bctx->backend->table.get_row(table, mem_ctx, query_type, rowid, data);
 }
 
+enum mapistore_error mapistore_backend_table_get_rows(struct backend_context *bctx, void *table, TALLOC_CTX *mem_ctx,
+						      enum mapistore_query_type query_type, uint32_t rowid, uint32_t count,
+						      struct mapistore_property_data ***rowsp)
+{
+	enum mapistore_error	retval = MAPISTORE_ERR_NOT_IMPLEMENTED;
+
+	if (bctx->backend->table.get_rows) {
+		retval = bctx->backend->table.get_rows(table, mem_ctx, query_type, rowid, count, rowsp);
+	}
+	if (retval == MAPISTORE_ERR_NOT_IMPLEMENTED) {
+		retval = mapistore_backend_defaults_table_get_rows(bctx->backend, table, mem_ctx, query_type, rowid, count, rowsp);
+	}
+
+	return retval;
+}
+
 enum mapistore_error mapistore_backend_table_get_row_count(struct backend_context *bctx, void *table, enum mapistore_query_type query_type, uint32_t *row_countp)
 {
         return bctx->backend->table.get_row_count(table, query_type, row_countp);
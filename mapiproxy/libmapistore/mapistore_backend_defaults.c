@@ -299,6 +299,17 @@ static enum mapistore_error mapistore_op_defaults_get_row(void *table_object,
 	return MAPISTORE_ERR_NOT_IMPLEMENTED;
 }
 
+static enum mapistore_error mapistore_op_defaults_get_rows(void *table_object,
+							   TALLOC_CTX *mem_ctx,
+							   enum mapistore_query_type query_type,
+							   uint32_t rowid,
+							   uint32_t count,
+							   struct mapistore_property_data ***rowsp)
+{
+	DEBUG(5, ("[%s:%d] MAPISTORE defaults - MAPISTORE_ERR_NOT_IMPLEMENTED\n", __FUNCTION__, __LINE__));
+	return MAPISTORE_ERR_NOT_IMPLEMENTED;
+}
+
 static enum mapistore_error mapistore_op_defaults_get_row_count(void *table_object,
 								enum mapistore_query_type query_type,
 								uint32_t *row_countp)
@@ -342,6 +353,50 @@ static enum mapistore_error mapistore_op_defaults_generate_uri(TALLOC_CTX *mem_c
 	return MAPISTORE_ERR_NOT_IMPLEMENTED;
 }
 
+/**
+   \details Fetch a range of rows from a table by calling the backend
+   get_row operation once per row. This is used for backends which do
+   not implement the batched get_rows operation.
+
+   \param backend pointer to the backend providing get_row
+   \param table_object pointer to the backend table object
+   \param mem_ctx pointer to the memory context
+   \param query_type the type of query to run
+   \param rowid the index of the first row to fetch
+   \param count the number of rows to fetch
+   \param rowsp pointer to the array of count rows to return, rows
+   which could not be fetched are set to NULL
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_backend_defaults_table_get_rows(struct mapistore_backend *backend,
+							       void *table_object,
+							       TALLOC_CTX *mem_ctx,
+							       enum mapistore_query_type query_type,
+							       uint32_t rowid,
+							       uint32_t count,
+							       struct mapistore_property_data ***rowsp)
+{
+	struct mapistore_property_data	**rows;
+	uint32_t			i;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!backend, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!rowsp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	rows = talloc_zero_array(mem_ctx, struct mapistore_property_data *, count);
+	MAPISTORE_RETVAL_IF(count && !rows, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	for (i = 0; i < count; i++) {
+		if (backend->table.get_row(table_object, rows, query_type, rowid + i, rows + i) != MAPISTORE_SUCCESS) {
+			rows[i] = NULL;
+		}
+	}
+	*rowsp = rows;
+
+	return MAPISTORE_SUCCESS;
+}
+
 extern enum mapistore_error mapistore_backend_init_defaults(struct mapistore_backend *backend)
 {
 	/* Sanity checks */
@@ -390,6 +445,7 @@ extern enum mapistore_error mapistore_backend_init_defaults(struct mapistore_bac
 	backend->table.set_restrictions = mapistore_op_defaults_set_restrictions;
 	backend->table.set_sort_order = mapistore_op_defaults_set_sort_order;
 	backend->table.get_row = mapistore_op_defaults_get_row;
+	backend->table.get_rows = mapistore_op_defaults_get_rows;
 	backend->table.get_row_count = mapistore_op_defaults_get_row_count;
 	backend->table.handle_destructor = mapistore_op_defaults_handle_destructor;
 
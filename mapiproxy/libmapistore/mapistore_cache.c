@@ -0,0 +1,253 @@
+/*
+   OpenChange Storage Abstraction Layer library
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file mapistore_cache.c
+
+   \brief Bounded LRU cache of per-user contexts
+
+   This file implements the hashed LRU cache mapistore uses to keep
+   per-user database contexts (indexing, replica mapping) open. When
+   the cache is full, the least recently used entry which is not in
+   use is released, closing its underlying database.
+ */
+
+#include <string.h>
+
+#include "mapistore.h"
+#include "mapistore_errors.h"
+#include "mapistore_private.h"
+#include "libmapi/libmapi_private.h"
+
+
+static uint32_t mapistore_cache_hash(const char *key)
+{
+	uint32_t	hash = 5381;
+
+	while (*key) {
+		hash = ((hash << 5) + hash) ^ (uint8_t)*key++;
+	}
+
+	return hash;
+}
+
+
+/**
+   \details Initialize a mapistore cache
+
+   \param mem_ctx pointer to the memory context
+   \param max_entries the maximum number of entries to keep open,
+   at most MAPISTORE_CACHE_MAX_SIZE
+   \param evictable function telling whether an entry's data can be
+   released, NULL if any entry can be
+
+   \return Allocated cache on success, otherwise NULL
+ */
+struct mapistore_cache *mapistore_cache_init(TALLOC_CTX *mem_ctx, uint32_t max_entries,
+					     bool (*evictable)(void *))
+{
+	struct mapistore_cache	*cache;
+	uint32_t		bucket_count;
+
+	if (!max_entries) {
+		max_entries = MAPISTORE_CACHE_DEFAULT_SIZE;
+	} else if (max_entries > MAPISTORE_CACHE_MAX_SIZE) {
+		DEBUG(0, ("[%s:%d]: cache size %u is too large, using %u\n", __FUNCTION__, __LINE__,
+			  max_entries, MAPISTORE_CACHE_MAX_SIZE));
+		max_entries = MAPISTORE_CACHE_MAX_SIZE;
+	}
+
+	cache = talloc_zero(mem_ctx, struct mapistore_cache);
+	if (!cache) return NULL;
+
+	for (bucket_count = 16; bucket_count < max_entries; bucket_count <<= 1);
+
+	cache->buckets = talloc_zero_array(cache, struct mapistore_cache_entry *, bucket_count);
+	if (!cache->buckets) {
+		talloc_free(cache);
+		return NULL;
+	}
+	cache->bucket_mask = bucket_count - 1;
+	cache->max_entries = max_entries;
+	cache->evictable = evictable;
+
+	return cache;
+}
+
+
+static void mapistore_cache_lru_unlink(struct mapistore_cache *cache, struct mapistore_cache_entry *entry)
+{
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	} else {
+		cache->lru_head = entry->next;
+	}
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	} else {
+		cache->lru_tail = entry->prev;
+	}
+	entry->prev = NULL;
+	entry->next = NULL;
+}
+
+
+static void mapistore_cache_lru_push(struct mapistore_cache *cache, struct mapistore_cache_entry *entry)
+{
+	entry->prev = NULL;
+	entry->next = cache->lru_head;
+	if (cache->lru_head) {
+		cache->lru_head->prev = entry;
+	} else {
+		cache->lru_tail = entry;
+	}
+	cache->lru_head = entry;
+}
+
+
+static void mapistore_cache_remove(struct mapistore_cache *cache, struct mapistore_cache_entry *entry)
+{
+	struct mapistore_cache_entry	**el;
+
+	for (el = &cache->buckets[entry->hash & cache->bucket_mask]; *el; el = &(*el)->hnext) {
+		if (*el == entry) {
+			*el = entry->hnext;
+			break;
+		}
+	}
+	mapistore_cache_lru_unlink(cache, entry);
+	cache->count -= 1;
+
+	talloc_free(entry);
+}
+
+
+/**
+   \details Lookup a cache entry and mark it as most recently used
+
+   \param cache pointer to the mapistore cache
+   \param key the key to lookup
+
+   \return the entry data on success, otherwise NULL
+ */
+void *mapistore_cache_lookup(struct mapistore_cache *cache, const char *key)
+{
+	struct mapistore_cache_entry	*entry;
+	uint32_t			hash;
+
+	if (!cache || !key) return NULL;
+
+	hash = mapistore_cache_hash(key);
+	for (entry = cache->buckets[hash & cache->bucket_mask]; entry; entry = entry->hnext) {
+		if (entry->hash == hash && !strcmp(entry->key, key)) {
+			cache->hits += 1;
+			if (cache->lru_head != entry) {
+				mapistore_cache_lru_unlink(cache, entry);
+				mapistore_cache_lru_push(cache, entry);
+			}
+			return entry->data;
+		}
+	}
+
+	cache->misses += 1;
+
+	return NULL;
+}
+
+
+/**
+   \details Add an entry to the cache, releasing the least recently
+   used evictable entry if the cache is full.
+
+   The cache takes ownership of data, which is free'd when the entry is
+   evicted or when the cache is released.
+
+   \param cache pointer to the mapistore cache
+   \param key the key of the entry
+   \param data the data to associate to key
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_cache_add(struct mapistore_cache *cache, const char *key, void *data)
+{
+	struct mapistore_cache_entry	*entry;
+	struct mapistore_cache_entry	*victim;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!cache, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!key || !data, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	/* Step 1. Make room for the new entry */
+	if (cache->count >= cache->max_entries) {
+		for (victim = cache->lru_tail; victim; victim = victim->prev) {
+			if (!cache->evictable || cache->evictable(victim->data)) {
+				break;
+			}
+		}
+		if (victim) {
+			DEBUG(5, ("[%s:%d]: evicting %s\n", __FUNCTION__, __LINE__, victim->key));
+			mapistore_cache_remove(cache, victim);
+			cache->evictions += 1;
+		} else {
+			DEBUG(3, ("[%s:%d]: all %d entries are in use, growing beyond limit\n",
+				  __FUNCTION__, __LINE__, cache->count));
+		}
+	}
+
+	/* Step 2. Insert the entry */
+	entry = talloc_zero(cache, struct mapistore_cache_entry);
+	MAPISTORE_RETVAL_IF(!entry, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	entry->key = talloc_strdup(entry, key);
+	entry->hash = mapistore_cache_hash(key);
+	entry->data = talloc_steal(entry, data);
+
+	entry->hnext = cache->buckets[entry->hash & cache->bucket_mask];
+	cache->buckets[entry->hash & cache->bucket_mask] = entry;
+	mapistore_cache_lru_push(cache, entry);
+	cache->count += 1;
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Retrieve the cache counters
+
+   \param cache pointer to the mapistore cache
+   \param stats pointer to the statistics structure to fill
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_cache_get_stats(struct mapistore_cache *cache, struct mapistore_cache_stats *stats)
+{
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!cache, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!stats, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	stats->entries = cache->count;
+	stats->max_entries = cache->max_entries;
+	stats->hits = cache->hits;
+	stats->misses = cache->misses;
+	stats->evictions = cache->evictions;
+
+	return MAPISTORE_SUCCESS;
+}
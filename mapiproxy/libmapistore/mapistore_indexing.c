@@ -49,20 +49,27 @@
 struct indexing_context_list *mapistore_indexing_search(struct mapistore_context *mstore_ctx, 
 							const char *username)
 {
-	struct indexing_context_list	*el;
-
 	/* Sanity checks */
 	if (!mstore_ctx) return NULL;
-	if (!mstore_ctx->indexing_list) return NULL;
+	if (!mstore_ctx->indexing_cache) return NULL;
 	if (!username) return NULL;
 
-	for (el = mstore_ctx->indexing_list; el; el = el->next) {
-		if (el && el->username && !strcmp(el->username, username)) {
-			return el;
-		}
-	}
+	return (struct indexing_context_list *) mapistore_cache_lookup(mstore_ctx->indexing_cache, username);
+}
+
+/**
+   \details Tell whether an indexing context can be evicted from the
+   indexing cache
+
+   \param data pointer to the indexing context
+
+   \return true if no backend context references it, otherwise false
+ */
+bool mapistore_indexing_evictable(void *data)
+{
+	struct indexing_context_list	*ictx = (struct indexing_context_list *) data;
 
-	return NULL;
+	return (ictx->ref_count == 0);
 }
 
 /**
@@ -80,9 +87,11 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_add(struct mapistore_context *m
 	TALLOC_CTX			*mem_ctx;
 	struct indexing_context_list	*ictx;
 	char				*dbpath = NULL;
+	enum mapistore_error		ret;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->indexing_cache, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERROR, NULL);
 
 	/* Step 1. Search if the context already exists */
@@ -91,7 +100,7 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_add(struct mapistore_context *m
 	MAPISTORE_RETVAL_IF(ictx, MAPISTORE_SUCCESS, NULL);
 
 	mem_ctx = talloc_named(NULL, 0, "mapistore_indexing_init");
-	ictx = talloc_zero(mstore_ctx, struct indexing_context_list);
+	ictx = talloc_zero(mem_ctx, struct indexing_context_list);
 
 	/* Step 1. Open/Create the indexing database */
 	dbpath = talloc_asprintf(mem_ctx, "%s/%s/indexing.tdb", 
@@ -100,13 +109,22 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_add(struct mapistore_context *m
 	talloc_free(dbpath);
 	if (!ictx->index_ctx) {
 		DEBUG(3, ("[%s:%d]: %s\n", __FUNCTION__, __LINE__, strerror(errno)));
-		talloc_free(ictx);
 		talloc_free(mem_ctx);
 		return MAPISTORE_ERR_DATABASE_INIT;
 	}
 	ictx->username = talloc_strdup(ictx, username);
-	/* ictx->ref_count = 0; */
-	DLIST_ADD_END(mstore_ctx->indexing_list, ictx, struct indexing_context_list *);
+	ictx->uri_index = NULL;
+	ictx->ref_count = 0;
+
+	/* Step 2. Build the URI reverse index on databases created before it existed */
+	if (mapistore_indexing_upgrade(ictx) != MAPISTORE_SUCCESS) {
+		DEBUG(1, ("[%s:%d]: Unable to build URI index for %s, falling back to slow lookups\n",
+			  __FUNCTION__, __LINE__, username));
+	}
+
+	/* Step 3. Insert the context in the cache, it now owns it */
+	ret = mapistore_cache_add(mstore_ctx->indexing_cache, username, ictx);
+	MAPISTORE_RETVAL_IF(ret, ret, mem_ctx);
 
 	*ictxp = ictx;
 
@@ -115,39 +133,57 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_add(struct mapistore_context *m
 	return MAPISTORE_SUCCESS;
 }
 
-/* /\** */
-/*    \details Increase the ref count associated to a given indexing context */
+/**
+   \details Increase the ref count associated to a given indexing
+   context. Referenced contexts are never evicted from the cache.
 
-/*    \param ictx pointer to the indexing context */
+   \param ictx pointer to the indexing context
 
-/*    \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE_ERROR */
-/*  *\/ */
-/* enum mapistore_error mapistore_indexing_add_ref_count(struct indexing_context_list *ictx) */
-/* { */
-/* 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERROR, NULL); */
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE_ERROR
+ */
+enum mapistore_error mapistore_indexing_add_ref_count(struct indexing_context_list *ictx)
+{
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERROR, NULL);
 
-/* 	ictx->ref_count += 1; */
+	ictx->ref_count += 1;
 
-/* 	return MAPISTORE_SUCCESS; */
-/* } */
+	return MAPISTORE_SUCCESS;
+}
 
 
-/* /\** */
-/*    \details Decrease the ref count associated to a given indexing context */
+/**
+   \details Decrease the ref count associated to a given indexing context
 
-/*    \param ictx pointer to the indexing context */
+   \param ictx pointer to the indexing context
 
-/*    \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE_ERROR */
-/*  *\/ */
-/* enum mapistore_error mapistore_indexing_del_ref_count(struct indexing_context_list *ictx) */
-/* { */
-/* 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERROR, NULL); */
-/* 	MAPISTORE_RETVAL_IF(!ictx->ref_count, MAPISTORE_SUCCESS, NULL); */
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE_ERROR
+ */
+enum mapistore_error mapistore_indexing_del_ref_count(struct indexing_context_list *ictx)
+{
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERROR, NULL);
+	MAPISTORE_RETVAL_IF(!ictx->ref_count, MAPISTORE_SUCCESS, NULL);
 
-/* 	ictx->ref_count -= 1; */
+	ictx->ref_count -= 1;
 
-/* 	return MAPISTORE_SUCCESS; */
-/* } */
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Retrieve the indexing contexts cache counters
+
+   \param mstore_ctx pointer to the mapistore context
+   \param stats pointer to the statistics structure to fill
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_indexing_get_cache_stats(struct mapistore_context *mstore_ctx,
+								 struct mapistore_cache_stats *stats)
+{
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+
+	return mapistore_cache_get_stats(mstore_ctx->indexing_cache, stats);
+}
 
 
 /**
@@ -197,6 +233,503 @@ enum mapistore_error mapistore_indexing_search_existing_fmid(struct indexing_con
 	return MAPISTORE_SUCCESS;
 }
 
+/**
+   \details Return a copy of the URI with its trailing slash stripped
+
+   \param mem_ctx pointer to the memory context
+   \param uri the URI to normalize
+   \param len the length of the URI
+
+   \return the normalized URI on success, otherwise NULL
+ */
+static char *mapistore_indexing_normalize_uri(TALLOC_CTX *mem_ctx, const char *uri, size_t len)
+{
+	if (len && uri[len - 1] == '/') {
+		len--;
+	}
+
+	return talloc_strndup(mem_ctx, uri, len);
+}
+
+/**
+   \details Parse a fmid key as stored in the indexing database
+   ("0x%.16"PRIx64 optionally prefixed with the soft-deleted tag)
+
+   \param data the key data
+   \param len the key length
+   \param fmidp pointer to the fmid the function returns
+   \param soft_deletedp pointer to the soft deleted flag the function returns
+
+   \return true if the key is a fmid key, otherwise false
+ */
+static bool mapistore_indexing_parse_fmid_key(const unsigned char *data, size_t len,
+					      uint64_t *fmidp, bool *soft_deletedp)
+{
+	char	buf[64];
+	size_t	taglen = strlen(MAPISTORE_SOFT_DELETED_TAG);
+	bool	soft_deleted = false;
+
+	if (len > taglen && !strncmp((const char *)data, MAPISTORE_SOFT_DELETED_TAG, taglen)) {
+		soft_deleted = true;
+		data += taglen;
+		len -= taglen;
+	}
+	if (len < 3 || len >= sizeof (buf) || strncmp((const char *)data, "0x", 2)) {
+		return false;
+	}
+
+	memcpy(buf, data, len);
+	buf[len] = '\0';
+	*fmidp = strtoull(buf, NULL, 16);
+	*soft_deletedp = soft_deleted;
+
+	return true;
+}
+
+static int mapistore_indexing_uri_entry_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct indexing_uri_entry *)a)->uri,
+		      ((const struct indexing_uri_entry *)b)->uri);
+}
+
+/**
+   \details Return the index of the first sorted entry which URI is
+   not lower than the given one
+ */
+static uint32_t mapistore_indexing_uri_lower_bound(struct indexing_uri_index *uri_index, const char *uri)
+{
+	uint32_t	lo = 0;
+	uint32_t	hi = uri_index->count;
+	uint32_t	mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (strcmp(uri_index->entries[mid].uri, uri) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+static int mapistore_indexing_uri_index_load_traverse(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
+{
+	struct indexing_uri_index	*uri_index = (struct indexing_uri_index *)data;
+	struct indexing_uri_entry	*entry;
+	size_t				taglen = strlen(MAPISTORE_URI_TAG);
+	uint64_t			fmid;
+	bool				soft_deleted;
+
+	if (key.dsize <= taglen || strncmp((const char *)key.dptr, MAPISTORE_URI_TAG, taglen)) {
+		return 0;
+	}
+	if (!mapistore_indexing_parse_fmid_key(value.dptr, value.dsize, &fmid, &soft_deleted)) {
+		return 0;
+	}
+
+	if (uri_index->count == uri_index->pending_size) {
+		uri_index->pending_size = uri_index->pending_size ? uri_index->pending_size * 2 : 256;
+		uri_index->entries = talloc_realloc(uri_index, uri_index->entries, struct indexing_uri_entry,
+						    uri_index->pending_size);
+		if (!uri_index->entries) return -1;
+	}
+
+	entry = &uri_index->entries[uri_index->count];
+	entry->uri = talloc_strndup(uri_index->entries, (const char *)key.dptr + taglen, key.dsize - taglen);
+	entry->fmid = fmid;
+	entry->soft_deleted = soft_deleted;
+	entry->deleted = false;
+	uri_index->count += 1;
+
+	return 0;
+}
+
+/**
+   \details Load the sorted view of the URI reverse index
+
+   \param ictx pointer to the indexing context
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error mapistore_indexing_uri_index_load(struct indexing_context_list *ictx)
+{
+	struct indexing_uri_index	*uri_index;
+	int				ret;
+
+	if (ictx->uri_index) {
+		return MAPISTORE_SUCCESS;
+	}
+
+	uri_index = talloc_zero(ictx, struct indexing_uri_index);
+	MAPISTORE_RETVAL_IF(!uri_index, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	/* pending_size is used as the capacity of entries while loading */
+	ret = tdb_traverse_read(ictx->index_ctx->tdb, mapistore_indexing_uri_index_load_traverse, uri_index);
+	MAPISTORE_RETVAL_IF(ret < 0, MAPISTORE_ERR_DATABASE_OPS, uri_index);
+	uri_index->pending_size = 0;
+
+	if (uri_index->count) {
+		qsort(uri_index->entries, uri_index->count, sizeof (struct indexing_uri_entry),
+		      mapistore_indexing_uri_entry_cmp);
+	}
+	ictx->uri_index = uri_index;
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Merge pending records into the sorted view of the URI
+   reverse index and drop deleted entries
+
+   \param uri_index pointer to the URI index
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error mapistore_indexing_uri_index_flush(struct indexing_uri_index *uri_index)
+{
+	struct indexing_uri_entry	*entries;
+	uint32_t			i, j, count;
+
+	if (!uri_index->pending_count) {
+		return MAPISTORE_SUCCESS;
+	}
+
+	qsort(uri_index->pending, uri_index->pending_count, sizeof (struct indexing_uri_entry),
+	      mapistore_indexing_uri_entry_cmp);
+
+	entries = talloc_array(uri_index, struct indexing_uri_entry, uri_index->count + uri_index->pending_count);
+	MAPISTORE_RETVAL_IF(!entries, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	for (i = 0, j = 0, count = 0; i < uri_index->count || j < uri_index->pending_count;) {
+		if (j == uri_index->pending_count ||
+		    (i < uri_index->count && strcmp(uri_index->entries[i].uri, uri_index->pending[j].uri) <= 0)) {
+			if (!uri_index->entries[i].deleted) {
+				entries[count] = uri_index->entries[i];
+				talloc_steal(entries, entries[count].uri);
+				count++;
+			}
+			i++;
+		} else {
+			entries[count] = uri_index->pending[j];
+			talloc_steal(entries, entries[count].uri);
+			count++;
+			j++;
+		}
+	}
+
+	talloc_free(uri_index->entries);
+	talloc_free(uri_index->pending);
+	uri_index->entries = entries;
+	uri_index->count = count;
+	uri_index->pending = NULL;
+	uri_index->pending_count = 0;
+	uri_index->pending_size = 0;
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Remove the records of a URI from the sorted view of the
+   URI reverse index if it is loaded
+
+   \param ictx pointer to the indexing context
+   \param uri the normalized mapistore URI
+   \param fmid the fmid the records must reference, 0 for any
+ */
+static void mapistore_indexing_uri_index_del(struct indexing_context_list *ictx, const char *uri, uint64_t fmid)
+{
+	struct indexing_uri_index	*uri_index = ictx->uri_index;
+	uint32_t			i;
+
+	if (!uri_index) return;
+
+	for (i = mapistore_indexing_uri_lower_bound(uri_index, uri);
+	     i < uri_index->count && !strcmp(uri_index->entries[i].uri, uri); i++) {
+		if (!uri_index->entries[i].deleted && (!fmid || uri_index->entries[i].fmid == fmid)) {
+			uri_index->entries[i].deleted = true;
+		}
+	}
+
+	for (i = 0; i < uri_index->pending_count;) {
+		if ((!fmid || uri_index->pending[i].fmid == fmid) && !strcmp(uri_index->pending[i].uri, uri)) {
+			talloc_free(uri_index->pending[i].uri);
+			uri_index->pending_count -= 1;
+			uri_index->pending[i] = uri_index->pending[uri_index->pending_count];
+		} else {
+			i++;
+		}
+	}
+}
+
+/**
+   \details Queue a record for the sorted view of the URI reverse index
+   if it is loaded
+ */
+static void mapistore_indexing_uri_index_add(struct indexing_context_list *ictx, const char *uri,
+					     uint64_t fmid, bool soft_deleted)
+{
+	struct indexing_uri_index	*uri_index = ictx->uri_index;
+	struct indexing_uri_entry	*pending;
+
+	if (!uri_index) return;
+
+	if (uri_index->pending_count == uri_index->pending_size) {
+		uri_index->pending_size = uri_index->pending_size ? uri_index->pending_size * 2 : 64;
+		pending = talloc_realloc(uri_index, uri_index->pending, struct indexing_uri_entry,
+					 uri_index->pending_size);
+		if (!pending) {
+			/* Drop the sorted view: it is reloaded from the database on next use */
+			talloc_free(uri_index);
+			ictx->uri_index = NULL;
+			return;
+		}
+		uri_index->pending = pending;
+	}
+
+	pending = &uri_index->pending[uri_index->pending_count];
+	pending->uri = talloc_strdup(uri_index->pending, uri);
+	pending->fmid = fmid;
+	pending->soft_deleted = soft_deleted;
+	pending->deleted = false;
+	uri_index->pending_count += 1;
+}
+
+/**
+   \details Store the URI -> fmid reverse record of a folder or
+   message. The record replaces the one of any fmid previously
+   registered under this URI.
+
+   \param ictx pointer to the indexing context
+   \param uri the normalized mapistore URI
+   \param fmid the folder or message ID
+   \param soft_deleted whether the fmid record is soft deleted
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error mapistore_indexing_uri_store(struct indexing_context_list *ictx, const char *uri,
+							 uint64_t fmid, bool soft_deleted)
+{
+	TALLOC_CTX	*mem_ctx;
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	int		ret;
+
+	mem_ctx = talloc_named(NULL, 0, "mapistore_indexing_uri_store");
+
+	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "%s%s", MAPISTORE_URI_TAG, uri);
+	key.dsize = strlen((const char *) key.dptr);
+
+	dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "%s0x%.16"PRIx64,
+						      soft_deleted ? MAPISTORE_SOFT_DELETED_TAG : "", fmid);
+	dbuf.dsize = strlen((const char *) dbuf.dptr);
+
+	ret = tdb_store(ictx->index_ctx->tdb, key, dbuf, TDB_REPLACE);
+	talloc_free(mem_ctx);
+	MAPISTORE_RETVAL_IF(ret == -1, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	mapistore_indexing_uri_index_del(ictx, uri, 0);
+	mapistore_indexing_uri_index_add(ictx, uri, fmid, soft_deleted);
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Remove the URI -> fmid reverse record of a folder or
+   message if it still references this fmid
+
+   \param ictx pointer to the indexing context
+   \param uri the mapistore URI as stored in the fmid record
+   \param uri_len the length of the URI
+   \param fmid the folder or message ID
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error mapistore_indexing_uri_delete(struct indexing_context_list *ictx, const char *uri,
+							  size_t uri_len, uint64_t fmid)
+{
+	TALLOC_CTX	*mem_ctx;
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	char		*normalized;
+	uint64_t	stored_fmid;
+	bool		soft_deleted;
+	int		ret = 0;
+
+	mem_ctx = talloc_named(NULL, 0, "mapistore_indexing_uri_delete");
+
+	normalized = mapistore_indexing_normalize_uri(mem_ctx, uri, uri_len);
+	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "%s%s", MAPISTORE_URI_TAG, normalized);
+	key.dsize = strlen((const char *) key.dptr);
+
+	dbuf = tdb_fetch(ictx->index_ctx->tdb, key);
+	if (dbuf.dptr) {
+		if (mapistore_indexing_parse_fmid_key(dbuf.dptr, dbuf.dsize, &stored_fmid, &soft_deleted) &&
+		    stored_fmid == fmid) {
+			ret = tdb_delete(ictx->index_ctx->tdb, key);
+		}
+		free(dbuf.dptr);
+	}
+	mapistore_indexing_uri_index_del(ictx, normalized, fmid);
+
+	talloc_free(mem_ctx);
+	MAPISTORE_RETVAL_IF(ret == -1, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Flag the URI -> fmid reverse record of a folder or message
+   as soft deleted if it still references this fmid
+
+   \param ictx pointer to the indexing context
+   \param uri the normalized mapistore URI
+   \param fmid the folder or message ID
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error mapistore_indexing_uri_soft_delete(struct indexing_context_list *ictx, const char *uri,
+							       uint64_t fmid)
+{
+	TDB_DATA		key;
+	TDB_DATA		dbuf;
+	uint64_t		stored_fmid;
+	bool			soft_deleted;
+	bool			owned = false;
+
+	key.dptr = (unsigned char *) talloc_asprintf(ictx, "%s%s", MAPISTORE_URI_TAG, uri);
+	key.dsize = strlen((const char *) key.dptr);
+
+	dbuf = tdb_fetch(ictx->index_ctx->tdb, key);
+	talloc_free(key.dptr);
+	if (dbuf.dptr) {
+		owned = (mapistore_indexing_parse_fmid_key(dbuf.dptr, dbuf.dsize, &stored_fmid, &soft_deleted) &&
+			 stored_fmid == fmid && !soft_deleted);
+		free(dbuf.dptr);
+	}
+
+	/* The URI now belongs to another fmid: leave its record alone */
+	if (!owned) return MAPISTORE_SUCCESS;
+
+	return mapistore_indexing_uri_store(ictx, uri, fmid, true);
+}
+
+struct mapistore_indexing_upgrade_data {
+	TALLOC_CTX	*mem_ctx;
+	char		**uris;
+	uint64_t	*fmids;
+	bool		*soft_deleted;
+	uint32_t	count;
+	uint32_t	size;
+};
+
+static int mapistore_indexing_upgrade_traverse(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
+{
+	struct mapistore_indexing_upgrade_data	*upgrade = (struct mapistore_indexing_upgrade_data *)data;
+	uint64_t				fmid;
+	bool					soft_deleted;
+
+	if (!mapistore_indexing_parse_fmid_key(key.dptr, key.dsize, &fmid, &soft_deleted)) {
+		return 0;
+	}
+
+	if (upgrade->count == upgrade->size) {
+		upgrade->size = upgrade->size ? upgrade->size * 2 : 256;
+		upgrade->uris = talloc_realloc(upgrade->mem_ctx, upgrade->uris, char *, upgrade->size);
+		upgrade->fmids = talloc_realloc(upgrade->mem_ctx, upgrade->fmids, uint64_t, upgrade->size);
+		upgrade->soft_deleted = talloc_realloc(upgrade->mem_ctx, upgrade->soft_deleted, bool, upgrade->size);
+		if (!upgrade->uris || !upgrade->fmids || !upgrade->soft_deleted) return -1;
+	}
+
+	upgrade->uris[upgrade->count] = mapistore_indexing_normalize_uri(upgrade->mem_ctx, (const char *)value.dptr, value.dsize);
+	upgrade->fmids[upgrade->count] = fmid;
+	upgrade->soft_deleted[upgrade->count] = soft_deleted;
+	upgrade->count += 1;
+
+	return 0;
+}
+
+/**
+   \details Upgrade an indexing database to the current layout
+
+   Databases created before MAPISTORE_DB_INDEXING_VERSION 2 only hold
+   fmid -> URI records. This function builds the URI -> fmid reverse
+   records for every existing entry and tags the database with the
+   current version, so it only runs once per database.
+
+   \param ictx pointer to the indexing context
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_indexing_upgrade(struct indexing_context_list *ictx)
+{
+	struct mapistore_indexing_upgrade_data	upgrade;
+	struct tdb_context			*tdb;
+	TDB_DATA				key;
+	TDB_DATA				dbuf;
+	uint32_t				i;
+	int					pass;
+	int					ret;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERROR, NULL);
+	MAPISTORE_RETVAL_IF(!ictx->index_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+
+	tdb = ictx->index_ctx->tdb;
+	key.dptr = (unsigned char *) MAPISTORE_DB_INDEXING_VERSION_KEY;
+	key.dsize = strlen(MAPISTORE_DB_INDEXING_VERSION_KEY);
+
+	dbuf = tdb_fetch(tdb, key);
+	if (dbuf.dptr) {
+		ret = (dbuf.dsize >= 1 && strtoul((const char *)dbuf.dptr, NULL, 10) >= MAPISTORE_DB_INDEXING_VERSION) ? 0 : 1;
+		free(dbuf.dptr);
+		MAPISTORE_RETVAL_IF(!ret, MAPISTORE_SUCCESS, NULL);
+	}
+
+	DEBUG(3, ("[%s:%d]: Building URI index for %s\n", __FUNCTION__, __LINE__, ictx->username));
+
+	memset(&upgrade, 0, sizeof (upgrade));
+	upgrade.mem_ctx = talloc_named(NULL, 0, "mapistore_indexing_upgrade");
+
+	ret = tdb_traverse_read(tdb, mapistore_indexing_upgrade_traverse, &upgrade);
+	MAPISTORE_RETVAL_IF(ret < 0, MAPISTORE_ERR_DATABASE_OPS, upgrade.mem_ctx);
+
+	ret = tdb_transaction_start(tdb);
+	MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERR_DATABASE_OPS, upgrade.mem_ctx);
+
+	/* Soft deleted records first so live records win on shared URIs */
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < upgrade.count; i++) {
+			if (upgrade.soft_deleted[i] != (pass == 0)) continue;
+			ret = mapistore_indexing_uri_store(ictx, upgrade.uris[i], upgrade.fmids[i], upgrade.soft_deleted[i]);
+			if (ret != MAPISTORE_SUCCESS) {
+				tdb_transaction_cancel(tdb);
+				talloc_free(upgrade.mem_ctx);
+				return ret;
+			}
+		}
+	}
+
+	dbuf.dptr = (unsigned char *) talloc_asprintf(upgrade.mem_ctx, "%d", MAPISTORE_DB_INDEXING_VERSION);
+	dbuf.dsize = strlen((const char *) dbuf.dptr);
+	ret = tdb_store(tdb, key, dbuf, TDB_REPLACE);
+	if (ret == -1) {
+		tdb_transaction_cancel(tdb);
+		talloc_free(upgrade.mem_ctx);
+		return MAPISTORE_ERR_DATABASE_OPS;
+	}
+
+	ret = tdb_transaction_commit(tdb);
+	MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERR_DATABASE_OPS, upgrade.mem_ctx);
+
+	DEBUG(3, ("[%s:%d]: URI index built for %s (%d records)\n", __FUNCTION__, __LINE__,
+		  ictx->username, upgrade.count));
+	talloc_free(upgrade.mem_ctx);
+
+	return MAPISTORE_SUCCESS;
+}
+
 enum mapistore_error mapistore_indexing_record_add(TALLOC_CTX *mem_ctx,
 						   struct indexing_context_list *ictx,
 						   uint64_t fmid,
@@ -205,6 +738,7 @@ enum mapistore_error mapistore_indexing_record_add(TALLOC_CTX *mem_ctx,
 	int		ret;
 	TDB_DATA	key;
 	TDB_DATA	dbuf;
+	char		*normalized;
 
 	/* Add the record given its fid and mapistore_uri */
 	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%.16"PRIx64, fmid);
@@ -214,15 +748,29 @@ enum mapistore_error mapistore_indexing_record_add(TALLOC_CTX *mem_ctx,
 	dbuf.dsize = strlen((const char *) dbuf.dptr);
 
 	ret = tdb_store(ictx->index_ctx->tdb, key, dbuf, TDB_INSERT);
-	talloc_free(key.dptr);
 	talloc_free(dbuf.dptr);
 
 	if (ret == -1) {
 		DEBUG(3, ("[%s:%d]: Unable to create 0x%.16"PRIx64" record: %s\n", __FUNCTION__, __LINE__,
 			  fmid, mapistore_URI));
+		talloc_free(key.dptr);
 		return MAPISTORE_ERR_DATABASE_OPS;
 	}
 
+	/* Maintain the URI -> fmid reverse record */
+	normalized = mapistore_indexing_normalize_uri(mem_ctx, mapistore_URI, strlen(mapistore_URI));
+	ret = mapistore_indexing_uri_store(ictx, normalized, fmid, false);
+	talloc_free(normalized);
+	if (ret != MAPISTORE_SUCCESS) {
+		DEBUG(3, ("[%s:%d]: Unable to create URI record for 0x%.16"PRIx64": %s\n", __FUNCTION__, __LINE__,
+			  fmid, mapistore_URI));
+		/* Do not leave a fmid record without its reverse record */
+		tdb_delete(ictx->index_ctx->tdb, key);
+		talloc_free(key.dptr);
+		return ret;
+	}
+	talloc_free(key.dptr);
+
 	return MAPISTORE_SUCCESS;
 }
 
@@ -297,6 +845,7 @@ enum mapistore_error mapistore_indexing_record_del_fmid(struct mapistore_context
 	TDB_DATA			key;
 	TDB_DATA			newkey;
 	TDB_DATA			dbuf;
+	char				*uri;
 	bool				IsSoftDeleted = false;
 
 	/* Sanity checks */
@@ -336,15 +885,28 @@ enum mapistore_error mapistore_indexing_record_del_fmid(struct mapistore_context
 		dbuf = tdb_fetch(ictx->index_ctx->tdb, key);
 		/* Add new record */
 		ret = tdb_store(ictx->index_ctx->tdb, newkey, dbuf, TDB_INSERT);
-		free(dbuf.dptr);
 		/* Delete previous record */
 		ret = tdb_delete(ictx->index_ctx->tdb, key);
 		talloc_free(key.dptr);
 		talloc_free(newkey.dptr);
+		/* Flag the URI reverse record as soft deleted */
+		if (dbuf.dptr) {
+			uri = mapistore_indexing_normalize_uri(mstore_ctx, (const char *)dbuf.dptr, dbuf.dsize);
+			mapistore_indexing_uri_soft_delete(ictx, uri, fmid);
+			talloc_free(uri);
+			free(dbuf.dptr);
+		}
 		break;
 	case MAPISTORE_PERMANENT_DELETE:
+		dbuf = tdb_fetch(ictx->index_ctx->tdb, key);
 		ret = tdb_delete(ictx->index_ctx->tdb, key);
 		talloc_free(key.dptr);
+		if (dbuf.dptr) {
+			if (!ret) {
+				mapistore_indexing_uri_delete(ictx, (const char *)dbuf.dptr, dbuf.dsize, fmid);
+			}
+			free(dbuf.dptr);
+		}
 		MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERR_DATABASE_OPS, NULL);
 		break;
 	}
@@ -414,96 +976,44 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_record_get_uri(struct mapistore
 }
 
 /**
-   \details A slow but effective way to retrieve an fmid from a uri
+   \details Retrieve the folder or message ID matching a URI
+
+   Exact lookups fetch the URI reverse record directly. Partial
+   lookups accept a single '*' wildcard ("startswith*endswith") and
+   are resolved with a range scan over the sorted view of the reverse
+   index.
 
    \param mstore_ctx pointer to the mapistore context
-   \param mem_ctx pointer to the talloc context
-   \param fmid the fmid/key to the record
-   \param urip pointer to the uri pointer
-   \param soft_deletedp pointer to the soft deleted pointer
+   \param username the name of the account where to look for the
+   indexing database
+   \param uri the URI to lookup
+   \param partial whether the URI contains a wildcard
+   \param fmidp pointer to the fmid the function returns
+   \param soft_deletedp pointer to the soft deleted flag the function returns
 
    \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
  */
-struct tdb_get_fid_data {
-	bool		found;
-	uint64_t	fmid;
-	char		*uri;
-	size_t		uri_len;
-	uint32_t	wildcard_count;
-	char		*startswith;
-	char		*endswith;
-};
-
-static int tdb_get_fid_traverse(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
-{
-	struct tdb_get_fid_data	*tdb_data;
-	char			*key_str, *cmp_uri, *slash_ptr;
-	TALLOC_CTX		*mem_ctx;
-	int			ret = 0;
-
-	mem_ctx = talloc_zero(NULL, void);
-	tdb_data = data;
-	cmp_uri = talloc_array(mem_ctx, char, value.dsize + 1);
-	memcpy(cmp_uri, value.dptr, value.dsize);
-	*(cmp_uri + value.dsize) = 0;
-	slash_ptr = cmp_uri + value.dsize - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
-	}
-	if (strcmp(cmp_uri, tdb_data->uri) == 0) {
-		key_str = talloc_strndup(mem_ctx, (char *) key.dptr, key.dsize);
-		tdb_data->fmid = strtoull(key_str, NULL, 16);
-		tdb_data->found = true;
-		ret = 1;
-	}
-	
-	talloc_free(mem_ctx);
-
-	return ret;
-}
-
-static int tdb_get_fid_traverse_partial(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
-{
-	struct tdb_get_fid_data	*tdb_data;
-	char			*key_str, *cmp_uri, *slash_ptr;
-	TALLOC_CTX		*mem_ctx;
-	int			ret = 0;
-
-	mem_ctx = talloc_zero(NULL, void);
-	tdb_data = data;
-	cmp_uri = talloc_array(mem_ctx, char, value.dsize + 1);
-	memcpy(cmp_uri, value.dptr, value.dsize);
-	*(cmp_uri + value.dsize) = 0;
-	slash_ptr = cmp_uri + value.dsize - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
-	}
-
-	if (!strncmp(cmp_uri, tdb_data->startswith, strlen(tdb_data->startswith)) &&
-	    !strncmp(cmp_uri + (strlen(cmp_uri) - strlen(tdb_data->endswith)), tdb_data->endswith, 
-		     strlen(tdb_data->endswith))) {
-		    key_str = talloc_strndup(mem_ctx, (char *) key.dptr, key.dsize);
-		    tdb_data->fmid = strtoull(key_str, NULL, 16);
-		    tdb_data->found = true;
-		    ret = 1;
-	}
-	
-	talloc_free(mem_ctx);
-
-	return ret;
-}
-
 _PUBLIC_ enum mapistore_error mapistore_indexing_record_get_fmid(struct mapistore_context *mstore_ctx, const char *username, const char *uri, bool partial, uint64_t *fmidp, bool *soft_deletedp)
 {
+	TALLOC_CTX			*mem_ctx;
 	struct indexing_context_list	*ictx;
+	struct indexing_uri_index	*uri_index;
+	struct indexing_uri_entry	*entry;
 	int				ret;
-	struct tdb_get_fid_data		tdb_data;
-	char				*slash_ptr;
+	TDB_DATA			key;
+	TDB_DATA			dbuf;
+	char				*normalized;
+	char				*startswith;
+	const char			*endswith;
+	size_t				startswith_len, endswith_len, uri_len;
+	uint32_t			wildcard_count;
 	uint32_t			i;
+	bool				found = false;
 
 	/* SANITY checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!uri, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!fmidp, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!soft_deletedp, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 
@@ -512,59 +1022,63 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_record_get_fmid(struct mapistor
 	MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERROR, NULL);
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERROR, NULL);
 
-	tdb_data.found = false;
-	tdb_data.uri = talloc_strdup(NULL, uri);
-	tdb_data.uri_len = strlen(uri);
+	mem_ctx = talloc_named(NULL, 0, "mapistore_indexing_record_get_fmid");
+	normalized = mapistore_indexing_normalize_uri(mem_ctx, uri, strlen(uri));
 
-	tdb_data.startswith = NULL;
-	tdb_data.endswith = NULL;
-	tdb_data.wildcard_count = 0;
-
-	slash_ptr = tdb_data.uri + tdb_data.uri_len - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
-		tdb_data.uri_len--;
-	}
-	if (partial == false) {
-		tdb_traverse_read(ictx->index_ctx->tdb, tdb_get_fid_traverse, &tdb_data);
-	} else {
-		for (tdb_data.wildcard_count = 0, i = 0; i < strlen(uri); i++) {
-			if (uri[i] == '*') tdb_data.wildcard_count += 1;
+	wildcard_count = 0;
+	if (partial == true) {
+		for (i = 0; normalized[i]; i++) {
+			if (normalized[i] == '*') wildcard_count += 1;
 		}
-
-		switch (tdb_data.wildcard_count) {
-		case 0: /* complete URI */
-			partial = true;
-			break;
-		case 1: /* start and end only */
-			tdb_data.endswith = strchr(uri, '*') + 1;
-			tdb_data.startswith = talloc_strndup(NULL, uri, strlen(uri) - strlen(tdb_data.endswith) - 1);
-			break;
-		default:
+		if (wildcard_count > 1) {
 			DEBUG(0, ("[%s:%d]: Too many wildcards found (1 maximum)\n", __FUNCTION__, __LINE__));
-			talloc_free(tdb_data.uri);
+			talloc_free(mem_ctx);
 			return MAPISTORE_ERR_NOT_FOUND;
 		}
+	}
 
-		if (partial == true) {
-			tdb_traverse_read(ictx->index_ctx->tdb, tdb_get_fid_traverse_partial, &tdb_data);
-			talloc_free(tdb_data.startswith);
-		} else {
-			tdb_traverse_read(ictx->index_ctx->tdb, tdb_get_fid_traverse, &tdb_data);
+	if (wildcard_count == 0) {
+		/* Complete URI: direct lookup of the reverse record */
+		key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "%s%s", MAPISTORE_URI_TAG, normalized);
+		key.dsize = strlen((const char *) key.dptr);
+
+		dbuf = tdb_fetch(ictx->index_ctx->tdb, key);
+		if (dbuf.dptr) {
+			found = mapistore_indexing_parse_fmid_key(dbuf.dptr, dbuf.dsize, fmidp, soft_deletedp);
+			free(dbuf.dptr);
+		}
+	} else {
+		/* start and end only: range scan over URIs starting with startswith */
+		ret = mapistore_indexing_uri_index_load(ictx);
+		MAPISTORE_RETVAL_IF(ret, ret, mem_ctx);
+		uri_index = ictx->uri_index;
+		ret = mapistore_indexing_uri_index_flush(uri_index);
+		MAPISTORE_RETVAL_IF(ret, ret, mem_ctx);
+
+		endswith = strchr(normalized, '*') + 1;
+		endswith_len = strlen(endswith);
+		startswith_len = strlen(normalized) - endswith_len - 1;
+		startswith = talloc_strndup(mem_ctx, normalized, startswith_len);
+
+		for (i = mapistore_indexing_uri_lower_bound(uri_index, startswith); i < uri_index->count; i++) {
+			entry = &uri_index->entries[i];
+			if (strncmp(entry->uri, startswith, startswith_len)) break;
+			if (entry->deleted) continue;
+
+			uri_len = strlen(entry->uri);
+			if (uri_len >= startswith_len + endswith_len &&
+			    !strcmp(entry->uri + uri_len - endswith_len, endswith)) {
+				*fmidp = entry->fmid;
+				*soft_deletedp = entry->soft_deleted;
+				found = true;
+				break;
+			}
 		}
 	}
 
-	talloc_free(tdb_data.uri);
-	if (tdb_data.found) {
-		*fmidp = tdb_data.fmid;
-		*soft_deletedp = false; /* TODO: implement the feature */
-		ret = MAPISTORE_SUCCESS;
-	}
-	else {
-		ret = MAPISTORE_ERR_NOT_FOUND;
-	}
+	talloc_free(mem_ctx);
 
-	return ret;
+	return found ? MAPISTORE_SUCCESS : MAPISTORE_ERR_NOT_FOUND;
 }
 
 /**
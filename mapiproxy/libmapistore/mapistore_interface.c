@@ -33,6 +33,24 @@
 
 #include <string.h>
 
+/**
+   \details Read a cache size parametric option, falling back to the
+   default size when it is not strictly positive
+ */
+static uint32_t mapistore_cache_size(struct loadparm_context *lp_ctx, const char *option)
+{
+	int	size;
+
+	size = lpcfg_parm_int(lp_ctx, NULL, "mapistore", option, MAPISTORE_CACHE_DEFAULT_SIZE);
+	if (size <= 0) {
+		DEBUG(0, ("[%s:%d]: invalid mapistore:%s %d, using %d\n", __FUNCTION__, __LINE__,
+			  option, size, MAPISTORE_CACHE_DEFAULT_SIZE));
+		return MAPISTORE_CACHE_DEFAULT_SIZE;
+	}
+
+	return (uint32_t) size;
+}
+
 /**
    \details Initialize the mapistore context
 
@@ -86,10 +104,20 @@ _PUBLIC_ struct mapistore_context *mapistore_init(TALLOC_CTX *mem_ctx, struct lo
 	}
 
 	mstore_ctx->context_list = NULL;
-	mstore_ctx->indexing_list = talloc_zero(mstore_ctx, struct indexing_context_list);
-	mstore_ctx->replica_mapping_list = talloc_zero(mstore_ctx, struct replica_mapping_context_list);
+	mstore_ctx->indexing_cache = mapistore_cache_init(mstore_ctx,
+							  mapistore_cache_size(lp_ctx, "indexing_cache_size"),
+							  mapistore_indexing_evictable);
+	mstore_ctx->replica_mapping_cache = mapistore_cache_init(mstore_ctx,
+								 mapistore_cache_size(lp_ctx, "replica_mapping_cache_size"),
+								 NULL);
+	if (!mstore_ctx->indexing_cache || !mstore_ctx->replica_mapping_cache) {
+		DEBUG(0, ("[%s:%d]: %s\n", __FUNCTION__, __LINE__, mapistore_errstr(MAPISTORE_ERR_NO_MEMORY)));
+		talloc_free(mstore_ctx);
+		return NULL;
+	}
 	mstore_ctx->notifications = NULL;
 	mstore_ctx->subscriptions = NULL;
+	mstore_ctx->subscription_index = NULL;
 	mstore_ctx->conn_info = NULL;
 
 	mstore_ctx->nprops_ctx = NULL;
@@ -211,8 +239,11 @@ _PUBLIC_ enum mapistore_error mapistore_add_context(struct mapistore_context *ms
 		mapistore_dir = talloc_asprintf(mem_ctx, "%s/%s", mapistore_get_mapping_path(), owner);
 		mkdir(mapistore_dir, 0700);
 
-		mapistore_indexing_add(mstore_ctx, owner, &ictx);
-		/* mapistore_indexing_add_ref_count(ictx); */
+		retval = mapistore_indexing_add(mstore_ctx, owner, &ictx);
+		if (retval != MAPISTORE_SUCCESS) {
+			talloc_free(mem_ctx);
+			return retval;
+		}
 
 		backend_uri = talloc_strdup(mem_ctx, &namespace[3]);
 		namespace[3] = '\0';
@@ -222,6 +253,8 @@ _PUBLIC_ enum mapistore_error mapistore_add_context(struct mapistore_context *ms
 		}
 
 		backend_ctx->indexing = ictx;
+		/* Referenced indexing contexts are never evicted from the cache */
+		mapistore_indexing_add_ref_count(ictx);
 
 		backend_list = talloc_zero((TALLOC_CTX *) mstore_ctx, struct backend_context_list);
 		backend_list->ctx = backend_ctx;
@@ -327,6 +360,7 @@ _PUBLIC_ enum mapistore_error mapistore_del_context(struct mapistore_context *ms
 {
 	struct backend_context_list	*backend_list;
 	struct backend_context		*backend_ctx;
+	struct indexing_context_list	*ictx;
 	int				retval;
 	bool				found = false;
 
@@ -351,26 +385,18 @@ _PUBLIC_ enum mapistore_error mapistore_del_context(struct mapistore_context *ms
 		return MAPISTORE_ERROR;
 	}
 
-	/* Step 1. Release the indexing context within backend */
-	/* if (backend_ctx->indexing) {
-		mapistore_indexing_del_ref_count(backend_ctx->indexing);
-		if (backend_ctx->indexing->ref_count == 0) {
-			DEBUG(5, ("freeing up mapistore_indexing ctx: %p\n", backend_ctx->indexing));
-			DLIST_REMOVE(mstore_ctx->indexing_list, backend_ctx->indexing);
-			talloc_unlink(mstore_ctx->indexing_list, backend_ctx->indexing);
-			backend_ctx->indexing = NULL;
-		}
-	} */
-
-	/* Step 2. Delete the context within backend */
+	/* Step 1. Delete the context within backend */
+	ictx = backend_ctx->indexing;
 	retval = mapistore_backend_delete_context(backend_ctx);
 	
 	switch (retval) {
 	case MAPISTORE_ERR_REF_COUNT:
 		return MAPISTORE_SUCCESS;
 	case MAPISTORE_SUCCESS:
+		/* Step 2. Release the indexing context reference, it can now be evicted */
+		mapistore_indexing_del_ref_count(ictx);
 		DLIST_REMOVE(mstore_ctx->context_list, backend_list);
-		/* Step 2. Add the free'd context id to the free list */
+		/* Step 3. Add the free'd context id to the free list */
 		retval = mapistore_free_context_id(mstore_ctx->processing_ctx, context_id);
 		break;
 	default:
@@ -1671,6 +1697,43 @@ _PUBLIC_ enum mapistore_error mapistore_table_get_row(struct mapistore_context *
 	return mapistore_backend_table_get_row(backend_ctx, table, mem_ctx, query_type, rowid, data);
 }
 
+/**
+   \details Fetch a range of rows from a table in a single backend call
+
+   Backends that do not implement the get_rows operation fall back on
+   one get_row call per row.
+
+   \param mstore_ctx pointer to the mapistore context
+   \param context_id the context identifier referencing the backend
+   \param table pointer to the backend table object
+   \param mem_ctx pointer to the memory context
+   \param query_type the type of query to run
+   \param rowid the index of the first row to fetch
+   \param count the number of rows to fetch
+   \param rowsp pointer to the array of count rows to return, rows
+   which could not be fetched (e.g. filtered out by a restriction) are
+   set to NULL
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_table_get_rows(struct mapistore_context *mstore_ctx, uint32_t context_id, void *table, TALLOC_CTX *mem_ctx,
+						       enum mapistore_query_type query_type, uint32_t rowid, uint32_t count,
+						       struct mapistore_property_data ***rowsp)
+{
+	struct backend_context	*backend_ctx;
+
+	/* Sanity checks */
+	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
+	MAPISTORE_RETVAL_IF(!rowsp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	/* Step 1. Search the context */
+	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	/* Step 2. Call backend operation */
+	return mapistore_backend_table_get_rows(backend_ctx, table, mem_ctx, query_type, rowid, count, rowsp);
+}
+
 _PUBLIC_ enum mapistore_error mapistore_table_get_row_count(struct mapistore_context *mstore_ctx, uint32_t context_id, void *table, enum mapistore_query_type query_type, uint32_t *row_countp)
 {
 	struct backend_context	*backend_ctx;
@@ -28,6 +28,242 @@
 #include "mapiproxy/libmapistore/mgmt/mapistore_mgmt.h"
 #include "mapiproxy/libmapistore/mgmt/gen_ndr/ndr_mapistore_mgmt.h"
 
+/*
+  Subscriptions are indexed by the notification keys they can match,
+  so a notification only looks at the subscriptions registered for its
+  own table handle, folder or message and event:
+
+  - table subscriptions, by handle;
+  - whole store subscriptions, by event;
+  - folder and message subscriptions, by (folder_id, event) for
+    notifications on the folder itself, and by (folder_id, object_id,
+    event) for notifications on its messages.
+
+  Candidates found in a bucket are still checked against the
+  subscription parameters with notification_matches_subscription().
+ */
+
+#define	MAPISTORE_SUBSCRIPTION_INDEX_MIN	64
+
+enum mapistore_subscription_key {
+	MAPISTORE_SUBSCRIPTION_KEY_TABLE = 1,
+	MAPISTORE_SUBSCRIPTION_KEY_WHOLE_STORE,
+	MAPISTORE_SUBSCRIPTION_KEY_FOLDER,
+	MAPISTORE_SUBSCRIPTION_KEY_MESSAGE
+};
+
+struct mapistore_subscription_index_entry {
+	struct mapistore_subscription			*subscription;
+	enum mapistore_subscription_key			kind;
+	uint16_t					event;
+	uint64_t					folder_id;
+	uint64_t					object_id;
+	struct mapistore_subscription_index_entry	*next_sibling;
+	struct mapistore_subscription_index_entry	*prev;
+	struct mapistore_subscription_index_entry	*next;
+};
+
+struct mapistore_subscription_index {
+	struct mapistore_subscription_index_entry	**buckets;
+	uint32_t					size;
+	uint32_t					count;
+};
+
+static const uint16_t mapistore_subscription_events[] = {
+	fnevObjectCreated, fnevObjectModified, fnevObjectDeleted, fnevObjectCopied, fnevObjectMoved
+};
+
+static uint32_t mapistore_subscription_hash(enum mapistore_subscription_key kind, uint16_t event,
+					    uint64_t folder_id, uint64_t object_id)
+{
+	uint64_t	h;
+
+	h = ((uint64_t)kind << 16 | event) * 0x9E3779B97F4A7C15ULL;
+	h = (h ^ folder_id) * 0xC2B2AE3D27D4EB4FULL;
+	h = (h ^ object_id) * 0x165667B19E3779F9ULL;
+
+	return (uint32_t)(h >> 32);
+}
+
+static void mapistore_subscription_index_link(struct mapistore_subscription_index *index,
+					      struct mapistore_subscription_index_entry *entry)
+{
+	struct mapistore_subscription_index_entry	**bucket;
+
+	bucket = &index->buckets[mapistore_subscription_hash(entry->kind, entry->event, entry->folder_id, entry->object_id)
+				 & (index->size - 1)];
+	entry->prev = NULL;
+	entry->next = *bucket;
+	if (*bucket) {
+		(*bucket)->prev = entry;
+	}
+	*bucket = entry;
+}
+
+static void mapistore_subscription_index_unlink(struct mapistore_subscription_index *index,
+						struct mapistore_subscription_index_entry *entry)
+{
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	} else {
+		index->buckets[mapistore_subscription_hash(entry->kind, entry->event, entry->folder_id, entry->object_id)
+			       & (index->size - 1)] = entry->next;
+	}
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	}
+	entry->prev = entry->next = NULL;
+}
+
+static void mapistore_subscription_index_grow(struct mapistore_subscription_index *index)
+{
+	struct mapistore_subscription_index_entry	**old_buckets;
+	struct mapistore_subscription_index_entry	*entry;
+	struct mapistore_subscription_index_entry	*next;
+	uint32_t					old_size;
+	uint32_t					i;
+
+	old_buckets = index->buckets;
+	old_size = index->size;
+
+	index->buckets = talloc_zero_array(index, struct mapistore_subscription_index_entry *, old_size * 2);
+	if (!index->buckets) {
+		index->buckets = old_buckets;
+		return;
+	}
+	index->size = old_size * 2;
+
+	for (i = 0; i < old_size; i++) {
+		for (entry = old_buckets[i]; entry; entry = next) {
+			next = entry->next;
+			mapistore_subscription_index_link(index, entry);
+		}
+	}
+	talloc_free(old_buckets);
+}
+
+static int mapistore_subscription_index_destructor(struct mapistore_subscription_index *index)
+{
+	struct mapistore_subscription_index_entry	*entry;
+	uint32_t					i;
+
+	/* subscriptions released after the index must not unlink from it */
+	for (i = 0; i < index->size; i++) {
+		for (entry = index->buckets[i]; entry; entry = entry->next) {
+			entry->subscription->index = NULL;
+		}
+	}
+
+	return 0;
+}
+
+static int mapistore_subscription_index_entries_destructor(struct mapistore_subscription *subscription)
+{
+	struct mapistore_subscription_index_entry	*entry;
+
+	if (subscription->index) {
+		for (entry = subscription->index_entries; entry; entry = entry->next_sibling) {
+			mapistore_subscription_index_unlink(subscription->index, entry);
+			subscription->index->count--;
+		}
+		subscription->index = NULL;
+	}
+
+	return 0;
+}
+
+static bool mapistore_subscription_index_add_key(struct mapistore_subscription_index *index,
+						 struct mapistore_subscription *subscription,
+						 enum mapistore_subscription_key kind, uint16_t event,
+						 uint64_t folder_id, uint64_t object_id)
+{
+	struct mapistore_subscription_index_entry	*entry;
+
+	entry = talloc_zero(subscription, struct mapistore_subscription_index_entry);
+	if (!entry) return false;
+
+	entry->subscription = subscription;
+	entry->kind = kind;
+	entry->event = event;
+	entry->folder_id = folder_id;
+	entry->object_id = object_id;
+	entry->next_sibling = subscription->index_entries;
+	subscription->index_entries = entry;
+
+	if (index->count >= index->size) {
+		mapistore_subscription_index_grow(index);
+	}
+	mapistore_subscription_index_link(index, entry);
+	index->count++;
+
+	return true;
+}
+
+/**
+   \details Add a subscription to the subscription index of a mapistore
+   context. The subscription is removed from the index when released.
+
+   \param mstore_ctx pointer to the mapistore context
+   \param subscription pointer to the subscription to index
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE_ERR_NO_MEMORY
+ */
+static enum mapistore_error mapistore_subscription_index_add(struct mapistore_context *mstore_ctx,
+							     struct mapistore_subscription *subscription)
+{
+	struct mapistore_subscription_index		*index;
+	struct mapistore_object_subscription_parameters	*object_parameters;
+	uint32_t					i;
+	uint16_t					event;
+
+	index = mstore_ctx->subscription_index;
+	if (!index) {
+		index = talloc_zero(mstore_ctx, struct mapistore_subscription_index);
+		MAPISTORE_RETVAL_IF(!index, MAPISTORE_ERR_NO_MEMORY, NULL);
+		index->size = MAPISTORE_SUBSCRIPTION_INDEX_MIN;
+		index->buckets = talloc_zero_array(index, struct mapistore_subscription_index_entry *, index->size);
+		MAPISTORE_RETVAL_IF(!index->buckets, MAPISTORE_ERR_NO_MEMORY, index);
+		talloc_set_destructor(index, mapistore_subscription_index_destructor);
+		mstore_ctx->subscription_index = index;
+	}
+
+	subscription->index = index;
+	subscription->index_entries = NULL;
+	talloc_set_destructor(subscription, mapistore_subscription_index_entries_destructor);
+
+	if (subscription->notification_types & fnevTableModified) {
+		if (!mapistore_subscription_index_add_key(index, subscription, MAPISTORE_SUBSCRIPTION_KEY_TABLE,
+							  0, 0, subscription->handle)) {
+			return MAPISTORE_ERR_NO_MEMORY;
+		}
+	}
+	if (subscription->notification_types == fnevTableModified) {
+		return MAPISTORE_SUCCESS;
+	}
+
+	object_parameters = &subscription->parameters.object_parameters;
+	for (i = 0; i < sizeof(mapistore_subscription_events) / sizeof(mapistore_subscription_events[0]); i++) {
+		event = mapistore_subscription_events[i];
+		if (!(subscription->notification_types & event)) continue;
+
+		if (object_parameters->whole_store) {
+			if (!mapistore_subscription_index_add_key(index, subscription, MAPISTORE_SUBSCRIPTION_KEY_WHOLE_STORE,
+								  event, 0, 0)) {
+				return MAPISTORE_ERR_NO_MEMORY;
+			}
+			continue;
+		}
+		if (!mapistore_subscription_index_add_key(index, subscription, MAPISTORE_SUBSCRIPTION_KEY_FOLDER,
+							  event, object_parameters->folder_id, 0)
+		    || !mapistore_subscription_index_add_key(index, subscription, MAPISTORE_SUBSCRIPTION_KEY_MESSAGE,
+							     event, object_parameters->folder_id, object_parameters->object_id)) {
+			return MAPISTORE_ERR_NO_MEMORY;
+		}
+	}
+
+	return MAPISTORE_SUCCESS;
+}
+
 #if 0
 static int mapistore_subscription_destructor(void *data)
 {
@@ -58,22 +294,24 @@ struct mapistore_subscription *mapistore_new_subscription(TALLOC_CTX *mem_ctx,
                                                           uint16_t notification_types,
                                                           void *notification_parameters)
 {
+        struct mapistore_subscription			*new_subscription;
+        struct mapistore_table_subscription_parameters	*table_parameters;
+        struct mapistore_object_subscription_parameters *object_parameters;
 #if 0
 	int						ret;
 	struct mapistore_connection_info		c;
 	struct mapistore_mgmt_notif			n;
-        struct mapistore_subscription			*new_subscription;
-        struct mapistore_table_subscription_parameters	*table_parameters;
-        struct mapistore_object_subscription_parameters *object_parameters;
 	unsigned int					prio;
 	struct mq_attr					attr;
 	DATA_BLOB					data;
+#endif
+
+	if (!mstore_ctx) return NULL;
 
         new_subscription = talloc_zero(mem_ctx, struct mapistore_subscription);
+	if (!new_subscription) return NULL;
         new_subscription->handle = handle;
         new_subscription->notification_types = notification_types;
-	new_subscription->mqueue = -1;
-	new_subscription->mqueue_name = NULL;
         if (notification_types == fnevTableModified) {
                 table_parameters = notification_parameters;
                 new_subscription->parameters.table_parameters = *table_parameters;
@@ -81,7 +319,17 @@ struct mapistore_subscription *mapistore_new_subscription(TALLOC_CTX *mem_ctx,
         else {
                 object_parameters = notification_parameters;
                 new_subscription->parameters.object_parameters = *object_parameters;
+	}
+
+	if (mapistore_subscription_index_add(mstore_ctx, new_subscription) != MAPISTORE_SUCCESS) {
+		talloc_free(new_subscription);
+		return NULL;
+	}
 
+#if 0
+	new_subscription->mqueue = -1;
+	new_subscription->mqueue_name = NULL;
+	if (notification_types != fnevTableModified) {
 		/* NewMail POC: open newmail mail queue */
 		if (notification_types & fnevNewMail || notification_types & fnevObjectCreated) {
 			new_subscription->mqueue_name = talloc_asprintf((TALLOC_CTX *)new_subscription, 
@@ -133,16 +381,13 @@ struct mapistore_subscription *mapistore_new_subscription(TALLOC_CTX *mem_ctx,
 			DEBUG(0, ("[%s:%d]: registering notification: %d\n", __FUNCTION__, __LINE__, ret));
 		}
 	}
-
-        return new_subscription;
 #endif
 
-	return NULL;
+        return new_subscription;
 }
 
 _PUBLIC_ void mapistore_push_notification(struct mapistore_context *mstore_ctx, uint8_t object_type, enum mapistore_notification_type event, void *parameters)
 {
-#if 0
         struct mapistore_notification *new_notification;
         struct mapistore_notification_list *new_list;
         struct mapistore_table_notification_parameters *table_parameters;
@@ -169,8 +414,7 @@ _PUBLIC_ void mapistore_push_notification(struct mapistore_context *mstore_ctx,
 						sizeof(enum MAPITAGS) * new_notification->parameters.object_parameters.tag_count);
 		}
 	}
-	DLIST_ADD_END(mstore_ctx->notifications, new_list, void);
-#endif
+	DLIST_ADD_END(mstore_ctx->notifications, new_list, struct mapistore_notification_list *);
 }
 
 #if 0
@@ -185,10 +429,9 @@ static struct mapistore_notification_list *mapistore_notification_process_mqueue
 	ndr_pull = ndr_pull_init_blob(&data, mem_ctx);
 	ndr_pull_mapistore_mgmt_command(ndr_pull, NDR_SCALARS|NDR_BUFFERS, &command);
 
-	/* verbose */
-	{
+	if (DEBUGLVL(5)) {
 		struct ndr_print	*ndr_print;
-		
+
 		ndr_print = talloc_zero(mem_ctx, struct ndr_print);
 		ndr_print->print = ndr_print_printf_helper;
 		ndr_print->depth = 1;
@@ -419,7 +662,6 @@ _PUBLIC_ enum MAPISTATUS mapistore_get_queued_notifications(struct mapistore_con
 	return (found == false) ? MAPISTORE_ERR_NOT_FOUND : MAPISTORE_SUCCESS;
 }
 
-#if 0
 static bool notification_matches_subscription(struct mapistore_notification *notification, struct mapistore_subscription *subscription)
 {
         bool result;
@@ -474,7 +716,6 @@ static bool notification_matches_subscription(struct mapistore_notification *not
 
         return result;
 }
-#endif
 
 _PUBLIC_ enum mapistore_error mapistore_delete_subscription(struct mapistore_context *mstore_ctx, uint32_t identifier, 
 							    uint16_t NotificationFlags)
@@ -485,7 +726,7 @@ _PUBLIC_ enum mapistore_error mapistore_delete_subscription(struct mapistore_con
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 
 	for (el = mstore_ctx->subscriptions; el; el = el->next) {
-		if ((el->subscription->handle == identifier) &&
+		if (el->subscription && (el->subscription->handle == identifier) &&
 		    (el->subscription->notification_types == NotificationFlags)) {
 			DEBUG(0, ("*** DELETING SUBSCRIPTION ***\n"));
 			DEBUG(0, ("subscription: handle = 0x%x\n", el->subscription->handle));
@@ -503,25 +744,96 @@ _PUBLIC_ enum mapistore_error mapistore_delete_subscription(struct mapistore_con
 	return MAPISTORE_ERR_NOT_FOUND;
 }
 
+static void mapistore_find_matching_key(struct mapistore_context *mstore_ctx,
+					struct mapistore_notification *notification,
+					struct mapistore_subscription_list **matching_subscriptions,
+					enum mapistore_subscription_key kind, uint16_t event,
+					uint64_t folder_id, uint64_t object_id)
+{
+	struct mapistore_subscription_index		*index = mstore_ctx->subscription_index;
+	struct mapistore_subscription_index_entry	*entry;
+	struct mapistore_subscription_list		*new_element;
+
+	for (entry = index->buckets[mapistore_subscription_hash(kind, event, folder_id, object_id) & (index->size - 1)];
+	     entry; entry = entry->next) {
+		if (entry->kind != kind || entry->event != event
+		    || entry->folder_id != folder_id || entry->object_id != object_id) {
+			continue;
+		}
+		if (notification_matches_subscription(notification, entry->subscription)) {
+			new_element = talloc_zero(mstore_ctx, struct mapistore_subscription_list);
+			if (!new_element) return;
+			new_element->subscription = entry->subscription;
+			DLIST_ADD_END(*matching_subscriptions, new_element, struct mapistore_subscription_list *);
+		}
+	}
+}
+
+/**
+   \details Return the list of subscriptions matching a notification
+
+   \param mstore_ctx pointer to the mapistore context
+   \param notification pointer to the notification
+
+   \return a list of subscriptions allocated with mstore_ctx, to be
+   released by the caller, or NULL if no subscription matches
+ */
 _PUBLIC_ struct mapistore_subscription_list *mapistore_find_matching_subscriptions(struct mapistore_context *mstore_ctx, struct mapistore_notification *notification)
 {
-#if 0
-        struct mapistore_subscription_list *matching_subscriptions, *new_element, *current_element;
+        struct mapistore_subscription_list		*matching_subscriptions = NULL;
+        struct mapistore_object_notification_parameters	*n_object_parameters;
+	uint16_t					event;
 
-	if (!mstore_ctx) return NULL;
+	if (!mstore_ctx || !notification || !mstore_ctx->subscription_index) return NULL;
 
-        matching_subscriptions = NULL;
+	if (notification->object_type == MAPISTORE_TABLE) {
+		mapistore_find_matching_key(mstore_ctx, notification, &matching_subscriptions,
+					    MAPISTORE_SUBSCRIPTION_KEY_TABLE, 0, 0,
+					    notification->parameters.table_parameters.handle);
+		return matching_subscriptions;
+	}
 
-        current_element = mstore_ctx->subscriptions;
-        while (current_element) {
-                if (notification_matches_subscription(notification, current_element->subscription)) {
-                        new_element = talloc_memdup(mstore_ctx, current_element, sizeof(struct mapistore_subscription_list));
-                        DLIST_ADD_END(matching_subscriptions, new_element, void);
-                }
-                current_element = current_element->next;
-        }
-        
-        return matching_subscriptions;
-#endif
-	return NULL;
+	switch (notification->event) {
+	case MAPISTORE_OBJECT_CREATED:
+		event = fnevObjectCreated;
+		break;
+	case MAPISTORE_OBJECT_MODIFIED:
+		event = fnevObjectModified;
+		break;
+	case MAPISTORE_OBJECT_DELETED:
+		event = fnevObjectDeleted;
+		break;
+	case MAPISTORE_OBJECT_COPIED:
+		event = fnevObjectCopied;
+		break;
+	case MAPISTORE_OBJECT_MOVED:
+		event = fnevObjectMoved;
+		break;
+	default:
+		return NULL;
+	}
+
+	mapistore_find_matching_key(mstore_ctx, notification, &matching_subscriptions,
+				    MAPISTORE_SUBSCRIPTION_KEY_WHOLE_STORE, event, 0, 0);
+
+	n_object_parameters = &notification->parameters.object_parameters;
+	if (notification->object_type == MAPISTORE_FOLDER) {
+		mapistore_find_matching_key(mstore_ctx, notification, &matching_subscriptions,
+					    MAPISTORE_SUBSCRIPTION_KEY_FOLDER, event, n_object_parameters->object_id, 0);
+	}
+	else if (notification->object_type == MAPISTORE_MESSAGE) {
+		mapistore_find_matching_key(mstore_ctx, notification, &matching_subscriptions,
+					    MAPISTORE_SUBSCRIPTION_KEY_MESSAGE, event, n_object_parameters->folder_id, 0);
+		if (n_object_parameters->object_id) {
+			mapistore_find_matching_key(mstore_ctx, notification, &matching_subscriptions,
+						    MAPISTORE_SUBSCRIPTION_KEY_MESSAGE, event,
+						    n_object_parameters->folder_id, n_object_parameters->object_id);
+		}
+	}
+	else {
+		DEBUG(5, ("[%s] warning: considering notification for unhandled object: %d...\n",
+			  __PRETTY_FUNCTION__, notification->object_type));
+	}
+
+	return matching_subscriptions;
 }
@@ -97,30 +97,81 @@ struct processing_context {
 };
 
 
+/**
+   Sorted URI to folder/message identifier entry
+ */
+struct indexing_uri_entry {
+	char				*uri;
+	uint64_t			fmid;
+	bool				soft_deleted;
+	bool				deleted;
+};
+
+/**
+   In-memory sorted view of the URI reverse index, used for prefix
+   range scans. Records added since the last scan are kept unsorted in
+   the pending array and merged on the next lookup.
+ */
+struct indexing_uri_index {
+	struct indexing_uri_entry	*entries;
+	uint32_t			count;
+	struct indexing_uri_entry	*pending;
+	uint32_t			pending_count;
+	uint32_t			pending_size;
+};
+
 /**
    Indexing identifier list
  */
 struct indexing_context_list {
 	struct tdb_wrap			*index_ctx;
 	char				*username;
-	// uint32_t			ref_count;
-	struct indexing_context_list	*prev;
-	struct indexing_context_list	*next;
+	struct indexing_uri_index	*uri_index;
+	uint32_t			ref_count;
 };
 
 #define	MAPISTORE_DB_NAMED		"named_properties.ldb"
 #define	MAPISTORE_DB_INDEXING		"indexing.tdb"
 #define	MAPISTORE_SOFT_DELETED_TAG	"SOFT_DELETED:"
+#define	MAPISTORE_URI_TAG		"URI:"
+#define	MAPISTORE_DB_INDEXING_VERSION_KEY	"MAPISTORE_INDEXING_VERSION"
+#define	MAPISTORE_DB_INDEXING_VERSION	2
 
 struct replica_mapping_context_list {
 	struct tdb_context		*tdb;
 	char				*username;
 	uint32_t			ref_count;
-	struct replica_mapping_context_list	*prev;
-	struct replica_mapping_context_list	*next;
 };
 #define	MAPISTORE_DB_REPLICA_MAPPING	"replica_mapping.tdb"
 
+/**
+   Hashed LRU cache of per-user contexts
+ */
+struct mapistore_cache_entry {
+	char				*key;
+	uint32_t			hash;
+	void				*data;
+	struct mapistore_cache_entry	*hnext;
+	struct mapistore_cache_entry	*prev;
+	struct mapistore_cache_entry	*next;
+};
+
+struct mapistore_cache {
+	struct mapistore_cache_entry	**buckets;
+	uint32_t			bucket_mask;
+	struct mapistore_cache_entry	*lru_head;
+	struct mapistore_cache_entry	*lru_tail;
+	uint32_t			count;
+	uint32_t			max_entries;
+	uint64_t			hits;
+	uint64_t			misses;
+	uint64_t			evictions;
+	bool				(*evictable)(void *);
+};
+
+#define	MAPISTORE_CACHE_DEFAULT_SIZE	128
+#define	MAPISTORE_CACHE_MAX_SIZE	65536
+
 /**
    The database name where in use ID mappings are stored
  */
@@ -193,6 +244,7 @@ enum mapistore_error mapistore_backend_table_set_columns(struct backend_context
 enum mapistore_error mapistore_backend_table_set_restrictions(struct backend_context *, void *, struct mapi_SRestriction *, uint8_t *);
 enum mapistore_error mapistore_backend_table_set_sort_order(struct backend_context *, void *, struct SSortOrderSet *, uint8_t *);
 enum mapistore_error mapistore_backend_table_get_row(struct backend_context *, void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, struct mapistore_property_data **);
+enum mapistore_error mapistore_backend_table_get_rows(struct backend_context *, void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, uint32_t, struct mapistore_property_data ***);
 enum mapistore_error mapistore_backend_table_get_row_count(struct backend_context *, void *, enum mapistore_query_type, uint32_t *);
 enum mapistore_error mapistore_backend_table_handle_destructor(struct backend_context *, void *, uint32_t);
 
@@ -202,6 +254,15 @@ enum mapistore_error mapistore_backend_properties_set_properties(struct backend_
 
 enum mapistore_error mapistore_backend_manager_generate_uri(struct backend_context *, TALLOC_CTX *, const char *, const char *, const char *, const char *, char **);
 
+/* definitions from mapistore_backend_defaults.c */
+enum mapistore_error mapistore_backend_defaults_table_get_rows(struct mapistore_backend *, void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, uint32_t, struct mapistore_property_data ***);
+
+/* definitions from mapistore_cache.c */
+struct mapistore_cache *mapistore_cache_init(TALLOC_CTX *, uint32_t, bool (*)(void *));
+void *mapistore_cache_lookup(struct mapistore_cache *, const char *);
+enum mapistore_error mapistore_cache_add(struct mapistore_cache *, const char *, void *);
+enum mapistore_error mapistore_cache_get_stats(struct mapistore_cache *, struct mapistore_cache_stats *);
+
 /* definitions from mapistore_tdb_wrap.c */
 struct tdb_wrap *mapistore_tdb_wrap_open(TALLOC_CTX *, const char *, int, int, int, mode_t);
 
@@ -210,13 +271,15 @@ struct ldb_context *mapistore_ldb_wrap_connect(TALLOC_CTX *, struct tevent_conte
 
 /* definitions from mapistore_indexing.c */
 struct indexing_context_list *mapistore_indexing_search(struct mapistore_context *, const char *);
+bool mapistore_indexing_evictable(void *);
 enum mapistore_error mapistore_indexing_add(struct mapistore_context *, const char *, struct indexing_context_list **);
 enum mapistore_error mapistore_indexing_search_existing_fmid(struct indexing_context_list *, uint64_t, bool *);
 enum mapistore_error mapistore_indexing_record_add(TALLOC_CTX *, struct indexing_context_list *, uint64_t, const char *);
+enum mapistore_error mapistore_indexing_upgrade(struct indexing_context_list *);
 enum mapistore_error mapistore_indexing_record_add_fmid(struct mapistore_context *, uint32_t, const char *, uint64_t);
 enum mapistore_error mapistore_indexing_record_del_fmid(struct mapistore_context *, uint32_t, const char *, uint64_t, uint8_t);
-// enum mapistore_error mapistore_indexing_add_ref_count(struct indexing_context_list *);
-// enum mapistore_error mapistore_indexing_del_ref_count(struct indexing_context_list *);
+enum mapistore_error mapistore_indexing_add_ref_count(struct indexing_context_list *);
+enum mapistore_error mapistore_indexing_del_ref_count(struct indexing_context_list *);
 
 /* definitions from mapistore_namedprops.c */
 enum mapistore_error mapistore_namedprops_init(TALLOC_CTX *, struct ldb_context **);
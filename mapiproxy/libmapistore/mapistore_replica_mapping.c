@@ -24,7 +24,6 @@
 #include "mapistore.h"
 #include "mapistore_errors.h"
 #include "mapistore_private.h"
-#include <dlinklist.h>
 #include "libmapi/libmapi_private.h"
 
 #include <tdb.h>
@@ -46,20 +45,19 @@ static uint16_t mapistore_replica_mapping_get_next_replid(struct tdb_context *);
  */
 static struct replica_mapping_context_list *mapistore_replica_mapping_search(struct mapistore_context *mstore_ctx, const char *username)
 {
-	struct replica_mapping_context_list	*el;
-
 	/* Sanity checks */
 	if (!mstore_ctx) return NULL;
-	if (!mstore_ctx->replica_mapping_list) return NULL;
+	if (!mstore_ctx->replica_mapping_cache) return NULL;
 	if (!username) return NULL;
 
-	for (el = mstore_ctx->replica_mapping_list; el; el = el->next) {
-		if (el && el->username && !strcmp(el->username, username)) {
-			return el;
-		}
-	}
+	return (struct replica_mapping_context_list *) mapistore_cache_lookup(mstore_ctx->replica_mapping_cache, username);
+}
+
+static int context_list_destructor(struct replica_mapping_context_list *rmctx)
+{
+	tdb_close(rmctx->tdb);
 
-	return NULL;
+	return 1;
 }
 
 /**
@@ -69,24 +67,21 @@ static struct replica_mapping_context_list *mapistore_replica_mapping_search(str
    \param username name for which the replica_mapping database has to be
    created
 
+   \note The returned context is owned by the replica mapping cache
+   and may be closed by a subsequent call for another user.
+
    \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
  */
-
-static int context_list_destructor(struct replica_mapping_context_list *rmctx)
-{
-	tdb_close(rmctx->tdb);
-
-	return 1;
-}
-
 _PUBLIC_ enum mapistore_error mapistore_replica_mapping_add(struct mapistore_context *mstore_ctx, const char *username, struct replica_mapping_context_list **rmctxp)
 {
 	TALLOC_CTX				*mem_ctx;
 	struct replica_mapping_context_list	*rmctx;
 	char					*dbpath = NULL;
+	enum mapistore_error			ret;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->replica_mapping_cache, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERROR, NULL);
 
 	/* Step 1. Search if the context already exists */
@@ -95,7 +90,7 @@ _PUBLIC_ enum mapistore_error mapistore_replica_mapping_add(struct mapistore_con
 	MAPISTORE_RETVAL_IF(rmctx, MAPISTORE_SUCCESS, NULL);
 
 	mem_ctx = talloc_named(NULL, 0, "mapistore_replica_mapping_init");
-	rmctx = talloc_zero(mstore_ctx->replica_mapping_list, struct replica_mapping_context_list);
+	rmctx = talloc_zero(mem_ctx, struct replica_mapping_context_list);
 
 	/* Step 1. Open/Create the replica_mapping database */
 	dbpath = talloc_asprintf(mem_ctx, "%s/%s/" MAPISTORE_DB_REPLICA_MAPPING, 
@@ -103,14 +98,16 @@ _PUBLIC_ enum mapistore_error mapistore_replica_mapping_add(struct mapistore_con
 	rmctx->tdb = tdb_open(dbpath, 0, 0, O_RDWR|O_CREAT, 0600);
 	if (!rmctx->tdb) {
 		DEBUG(3, ("[%s:%d]: %s (%s)\n", __FUNCTION__, __LINE__, strerror(errno), dbpath));
-		talloc_free(rmctx);
 		talloc_free(mem_ctx);
 		return MAPISTORE_ERR_DATABASE_INIT;
 	}
 	talloc_set_destructor(rmctx, context_list_destructor);
 	rmctx->username = talloc_strdup(rmctx, username);
 	rmctx->ref_count = 0;
-	DLIST_ADD_END(mstore_ctx->replica_mapping_list, rmctx, struct replica_mapping_context_list *);
+
+	/* Step 2. Insert the context in the cache, it now owns it */
+	ret = mapistore_cache_add(mstore_ctx->replica_mapping_cache, username, rmctx);
+	MAPISTORE_RETVAL_IF(ret, ret, mem_ctx);
 
 	*rmctxp = rmctx;
 
@@ -119,6 +116,22 @@ _PUBLIC_ enum mapistore_error mapistore_replica_mapping_add(struct mapistore_con
 	return MAPISTORE_SUCCESS;
 }
 
+/**
+   \details Retrieve the replica mapping contexts cache counters
+
+   \param mstore_ctx pointer to the mapistore context
+   \param stats pointer to the statistics structure to fill
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_replica_mapping_get_cache_stats(struct mapistore_context *mstore_ctx,
+									struct mapistore_cache_stats *stats)
+{
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+
+	return mapistore_cache_get_stats(mstore_ctx->replica_mapping_cache, stats);
+}
+
 /* _PUBLIC_ enum mapistore_error mapistore_replica_mapping_add(struct mapistore_context *mstore_ctx, const char *username) */
 /* { */
 /* 	TALLOC_CTX			*mem_ctx; */
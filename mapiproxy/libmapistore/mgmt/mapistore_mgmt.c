@@ -64,6 +64,10 @@ static void mgmt_ipc_process_notif(struct mapistore_mgmt_context *mgmt_ctx,
 	case MAPISTORE_MGMT_NOTIF:
 		mapistore_mgmt_message_notification_command(mgmt_ctx, command.command.notification);
 		break;
+	case MAPISTORE_MGMT_NEWMAIL:
+		/* delivery agents send these to ocsmanager, see mapistore_mgmt_newmail.c */
+		DEBUG(0, ("[%s:%d]: Unexpected newmail command\n", __FUNCTION__, __LINE__));
+		break;
 	default:
 		DEBUG(0, ("[%s:%d]: Invalid command type: %d\n",
 			  __FUNCTION__, __LINE__, command.type));
@@ -34,6 +34,11 @@
 
 #include "gen_ndr/mapistore_mgmt.h"
 
+/* Newmail endpoint used by delivery agents, see mapistore_mgmt_newmail.c */
+#define	MAPISTORE_MGMT_NEWMAIL_SOCKET		"/var/run/ocsmanager/newmail.sock"
+#define	MAPISTORE_MGMT_NEWMAIL_MAX_DATAGRAM	65536
+#define	MAPISTORE_MGMT_NEWMAIL_RCVBUF		(1024 * 1024)
+
 /* forward declaration */
 struct mapistore_context;
 
@@ -110,6 +115,12 @@ enum mapistore_error mapistore_mgmt_message_bind_command(struct mapistore_mgmt_c
 enum mapistore_error mapistore_mgmt_send_newmail_notification(struct mapistore_mgmt_context *, const char *, uint64_t, uint64_t, const char *);
 enum mapistore_error mapistore_mgmt_send_udp_notification(struct mapistore_mgmt_context *, const char *);
 
+/* definitions from mapistore_mgmt_newmail.c */
+int mapistore_mgmt_newmail_connect(const char *);
+enum mapistore_error mapistore_mgmt_newmail_send(int, struct mapistore_mgmt_command_batch *);
+int mapistore_mgmt_newmail_listen(const char *);
+enum mapistore_error mapistore_mgmt_newmail_receive(TALLOC_CTX *, int, struct mapistore_mgmt_command_batch **);
+
 __END_DECLS
 
 #endif /* ! __MAPISTORE_MGMT_H */
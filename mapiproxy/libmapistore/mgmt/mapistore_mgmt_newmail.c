@@ -0,0 +1,209 @@
+/*
+   OpenChange Storage Abstraction Layer library
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file mapistore_mgmt_newmail.c
+
+   \brief Newmail channel between mail delivery agents and ocsmanager
+
+   Delivery agents (the dovecot ocsmanager plugin) keep a connected
+   Unix datagram socket on the ocsmanager newmail endpoint and send
+   batches of MAPISTORE_MGMT_NEWMAIL commands, NDR encoded. Each
+   datagram holds one mapistore_mgmt_command_batch, with one command
+   per user and folder listing the UIDs of the messages delivered
+   there. ocsmanager registers the messages and sends one newmail
+   notification per command on the user queue.
+ */
+
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "mapiproxy/libmapistore/mgmt/mapistore_mgmt.h"
+#include "mapiproxy/libmapistore/mgmt/gen_ndr/ndr_mapistore_mgmt.h"
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static enum mapistore_error mapistore_mgmt_newmail_addr(const char *path, struct sockaddr_un *addr)
+{
+	MAPISTORE_RETVAL_IF(!path, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(strlen(path) >= sizeof (addr->sun_path), MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	memset(addr, 0, sizeof (struct sockaddr_un));
+	addr->sun_family = AF_UNIX;
+	strncpy(addr->sun_path, path, sizeof (addr->sun_path) - 1);
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Connect to the newmail endpoint. The socket is non
+   blocking: a delivery agent never waits for ocsmanager.
+
+   \param path the path of the endpoint socket
+
+   \return the socket descriptor on success, otherwise -1
+ */
+_PUBLIC_ int mapistore_mgmt_newmail_connect(const char *path)
+{
+	struct sockaddr_un	addr;
+	int			fd;
+
+	if (mapistore_mgmt_newmail_addr(path, &addr) != MAPISTORE_SUCCESS) {
+		return -1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_DGRAM|SOCK_NONBLOCK|SOCK_CLOEXEC, 0);
+	if (fd == -1) return -1;
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof (struct sockaddr_un)) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+
+/**
+   \details Send a batch of newmail commands to the endpoint
+
+   \param fd the socket returned by mapistore_mgmt_newmail_connect
+   \param batch pointer to the batch to send
+
+   \note On MAPISTORE_ERR_MSG_SEND, errno is left as set by send:
+   EAGAIN means the endpoint is busy and the batch can be sent again
+   later, other values mean the socket has to be connected again.
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_mgmt_newmail_send(int fd, struct mapistore_mgmt_command_batch *batch)
+{
+	TALLOC_CTX		*mem_ctx;
+	DATA_BLOB		data;
+	enum ndr_err_code	ndr_err;
+	ssize_t			len;
+	int			err;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(fd == -1, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!batch || !batch->count, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	mem_ctx = talloc_named(NULL, 0, "mapistore_mgmt_newmail_send");
+	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	ndr_err = ndr_push_struct_blob(&data, mem_ctx, batch, (ndr_push_flags_fn_t)ndr_push_mapistore_mgmt_command_batch);
+	MAPISTORE_RETVAL_IF(!NDR_ERR_CODE_IS_SUCCESS(ndr_err), MAPISTORE_ERR_INVALID_DATA, mem_ctx);
+
+	len = send(fd, data.data, data.length, MSG_DONTWAIT|MSG_NOSIGNAL);
+	err = errno;
+	talloc_free(mem_ctx);
+	errno = err;
+
+	return (len == (ssize_t)data.length) ? MAPISTORE_SUCCESS : MAPISTORE_ERR_MSG_SEND;
+}
+
+
+/**
+   \details Create the newmail endpoint. A stale socket left by a
+   previous instance is removed.
+
+   \param path the path of the endpoint socket
+
+   \return the socket descriptor on success, otherwise -1
+ */
+_PUBLIC_ int mapistore_mgmt_newmail_listen(const char *path)
+{
+	struct sockaddr_un	addr;
+	int			fd;
+	int			size = MAPISTORE_MGMT_NEWMAIL_RCVBUF;
+
+	if (mapistore_mgmt_newmail_addr(path, &addr) != MAPISTORE_SUCCESS) {
+		return -1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_DGRAM|SOCK_CLOEXEC, 0);
+	if (fd == -1) return -1;
+
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof (struct sockaddr_un)) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	/* leave room for bursts of large batches while ocsmanager dispatches */
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof (size));
+
+	return fd;
+}
+
+
+/**
+   \details Wait for the next batch of newmail commands sent to the
+   endpoint and decode it. Commands of other types are dropped.
+
+   \param mem_ctx pointer to the memory context
+   \param fd the socket returned by mapistore_mgmt_newmail_listen
+   \param _batch pointer on pointer to the batch to return
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_mgmt_newmail_receive(TALLOC_CTX *mem_ctx, int fd,
+							     struct mapistore_mgmt_command_batch **_batch)
+{
+	struct mapistore_mgmt_command_batch	*batch;
+	DATA_BLOB				data;
+	enum ndr_err_code			ndr_err;
+	ssize_t					len;
+	uint32_t				i;
+	uint32_t				count;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(fd == -1, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!_batch, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	batch = talloc_zero(mem_ctx, struct mapistore_mgmt_command_batch);
+	MAPISTORE_RETVAL_IF(!batch, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	data = data_blob_talloc(batch, NULL, MAPISTORE_MGMT_NEWMAIL_MAX_DATAGRAM);
+	MAPISTORE_RETVAL_IF(!data.data, MAPISTORE_ERR_NO_MEMORY, batch);
+
+	do {
+		len = recv(fd, data.data, data.length, 0);
+	} while (len == -1 && errno == EINTR);
+	MAPISTORE_RETVAL_IF(len <= 0, MAPISTORE_ERR_MSG_RCV, batch);
+	data.length = len;
+
+	ndr_err = ndr_pull_struct_blob(&data, batch, batch, (ndr_pull_flags_fn_t)ndr_pull_mapistore_mgmt_command_batch);
+	MAPISTORE_RETVAL_IF(!NDR_ERR_CODE_IS_SUCCESS(ndr_err), MAPISTORE_ERR_INVALID_DATA, batch);
+
+	for (i = 0, count = 0; i < batch->count; i++) {
+		if (batch->commands[i].type != MAPISTORE_MGMT_NEWMAIL) continue;
+		batch->commands[count++] = batch->commands[i];
+	}
+	batch->count = count;
+
+	*_batch = batch;
+
+	return MAPISTORE_SUCCESS;
+}
@@ -33,7 +33,6 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <sys/wait.h>
 #include <time.h>
 
 struct mpm_cache *mpm = NULL;
@@ -122,84 +121,6 @@ static void cache_dump_stream_stat(struct mpm_stream *stream)
 }
 
 
-/**
-   \details
-
-   1. close the existing FILE *
-   2. build complete file path
-   3. replace __FILE__ arguments with complete file path
-   4. call execve
-   5. stat the sync'd file
-   6. open the stream again
-   7. mark the file as cached
-
-   \param stream pointer on the mpm_stream entry
- */
-static NTSTATUS cache_exec_sync_cmd(struct mpm_stream *stream)
-{
-	uint32_t	i;
-	int		ret = 0;
-	char		**args;
-	struct stat	sb;
-	pid_t		pid;
-	int		status;
-
-	mpm_cache_stream_close(stream);
-
-	for (i = 0; mpm->sync_cmd[i]; i++);
-
-	args = talloc_array((TALLOC_CTX *)mpm, char *, i + 1);
-
-	for (i = 0; mpm->sync_cmd[i]; i++){
-		if (strstr(mpm->sync_cmd[i], "__FILE__")) {
-			args[i] = string_sub_talloc((TALLOC_CTX *)args, mpm->sync_cmd[i], "__FILE__", stream->filename);
-		} else {
-			args[i] = talloc_strdup((TALLOC_CTX *)args, mpm->sync_cmd[i]);
-		}
-	}
-	args[i] = NULL;
-
-	for (i = 0; args[i]; i++){
-		DEBUG(0, ("'%s' ", args[i]));
-	}
-	DEBUG(0, ("\n"));
-
-	switch(pid = fork()) {
-	case -1:
-		DEBUG(0, ("Failed to fork\n"));
-		break;
-	case 0:
-		ret = execve(args[0], args, NULL);
-		break;
-	default:
-		wait(&status);
-		break;
-	}
-	talloc_free(args);
-	if (ret == -1) {
-		perror("execve: ");
-		return NT_STATUS_INVALID_PARAMETER;
-	}
-
-	ret = stat(stream->filename, &sb);
-	if (ret == -1) {
-		perror("stat: ");
-		return NT_STATUS_INVALID_PARAMETER;
-	}
-
-	if (sb.st_size != stream->StreamSize) {
-		DEBUG(0, ("Sync'd file size is 0x%x and 0x%x was expected\n",
-			  (uint32_t)sb.st_size, stream->StreamSize));
-		return NT_STATUS_INVALID_PARAMETER;
-	}
-
-	mpm_cache_stream_open(mpm, stream);
-	stream->cached = true;
-
-	return NT_STATUS_OK;
-}
-
-
 /**
    \details Track down Release calls and update the mpm_cache global
    list - removing associated entries.
@@ -643,6 +564,11 @@ static NTSTATUS cache_pull_OpenStream(struct dcesrv_call_state *dce_call,
 			stream->PropertyTag = request.PropertyTag;
 			stream->StreamSize = 0;
 			stream->filename = NULL;
+			stream->tmpname = NULL;
+			stream->fd = -1;
+			stream->map = NULL;
+			stream->entry = NULL;
+			stream->fill_job = NULL;
 			stream->attachment = attach;
 			stream->cached = false;
 			stream->message = NULL;
@@ -672,6 +598,11 @@ static NTSTATUS cache_pull_OpenStream(struct dcesrv_call_state *dce_call,
 			stream->PropertyTag = request.PropertyTag;
 			stream->StreamSize = 0;
 			stream->filename = NULL;
+			stream->tmpname = NULL;
+			stream->fd = -1;
+			stream->map = NULL;
+			stream->entry = NULL;
+			stream->fill_job = NULL;
 			stream->attachment = NULL;
 			stream->cached = false;
 			stream->ahead = (mpm->ahead == true) ? true : false;
@@ -797,9 +728,13 @@ static NTSTATUS cache_push_ReadStream(struct dcesrv_call_state *dce_call,
 	for (stream = mpm->streams; stream; stream = stream->next) {
 		if ((mpm_session_cmp(stream->session, dce_call) == true) &&
 		    mapi_response->handles[mapi_repl.handle_idx] == stream->handle) {
-			if (stream->fp && stream->cached == false) {
+			if (stream->fill_job) {
+				/* relayed while the cache is filled in the background */
+				stream->offset += response.data.length;
+			} else if (stream->fd != -1 && stream->cached == false) {
 				if (mpm->sync == true && stream->StreamSize > mpm->sync_min) {
-					cache_exec_sync_cmd(stream);
+					mpm_cache_fill_submit(mpm, stream);
+					stream->offset += response.data.length;
 				} else {
 					server_id_printable = server_id_str(NULL, &(stream->session->server_id));
 					DEBUG(5, ("* [%s:%d] [s(%s),c(0x%x)] %zd bytes from remove server\n", 
@@ -810,6 +745,7 @@ static NTSTATUS cache_push_ReadStream(struct dcesrv_call_state *dce_call,
 						if (response.data.length) {
 							cache_dump_stream_stat(stream);
 						}
+						mpm_cache_stream_commit(mpm, stream);
 					}
 				}
 			} else if (stream->cached == true) {
@@ -845,6 +781,9 @@ static NTSTATUS cache_pull(struct dcesrv_call_state *dce_call, TALLOC_CTX *mem_c
 		return NT_STATUS_OK;
 	}
 
+	/* pick up the streams filled in the background since the last call */
+	mpm_cache_fill_poll(mpm);
+
 	EcDoRpc = (struct EcDoRpc *) r;
 	if (!EcDoRpc) return NT_STATUS_OK;
 	if (!&(EcDoRpc->in)) return NT_STATUS_OK;
@@ -1023,11 +962,11 @@ static NTSTATUS cache_dispatch(struct dcesrv_call_state *dce_call, TALLOC_CTX *m
 						mapi_response->mapi_repl[i].opnum = op_MAPI_ReadStream;
 						mapi_response->mapi_repl[i].handle_idx = mapi_req[i].handle_idx;
 						mapi_response->mapi_repl[i].error_code = MAPI_E_SUCCESS;
-						mapi_response->mapi_repl[i].u.mapi_ReadStream.data.length = 0;
-						mapi_response->mapi_repl[i].u.mapi_ReadStream.data.data = talloc_size(mem_ctx, request.ByteCount);
+						/* the reply data points into the stream mapping */
 						mpm_cache_stream_read(stream, (size_t) request.ByteCount, 
 								      &mapi_response->mapi_repl[i].u.mapi_ReadStream.data.length,
 								      &mapi_response->mapi_repl[i].u.mapi_ReadStream.data.data);
+						mpm->stats.bytes_served += mapi_response->mapi_repl[i].u.mapi_ReadStream.data.length;
 						if (stream->offset == stream->StreamSize) {
 							if (mapi_response->mapi_repl[i].u.mapi_ReadStream.data.length) {
 								cache_dump_stream_stat(stream);
@@ -1050,8 +989,10 @@ static NTSTATUS cache_dispatch(struct dcesrv_call_state *dce_call, TALLOC_CTX *m
 							/* When read ahead is over */
 							if (stream->offset == stream->StreamSize) {
 								cache_dump_stream_stat(stream);
+								if (!NT_STATUS_IS_OK(mpm_cache_stream_commit(mpm, stream))) {
+									DEBUG(0, ("* [%s:%d] Unable to store the stream read ahead\n", MPM_LOCATION));
+								}
 								mpm_cache_stream_reset(stream);
-								stream->cached = true;
 								stream->ahead = false;
 								goto cached;
 							}
@@ -1134,6 +1075,8 @@ static NTSTATUS cache_unbind(struct server_id server_id, uint32_t context_id)
 		}
 	}
 
+	mpm_cache_store_dump_stats(mpm);
+
 	return NT_STATUS_OK;
 }
 
@@ -1143,7 +1086,13 @@ static NTSTATUS cache_unbind(struct server_id server_id, uint32_t context_id)
    smb.conf
 
    Possible smb.conf parameters:
-	* mpm_cache:database
+	* mpm_cache:path
+	* mpm_cache:ahead
+	* mpm_cache:sync
+	* mpm_cache:sync_min
+	* mpm_cache:sync_cmd
+	* mpm_cache:max_size (in MB, 0 for no limit)
+	* mpm_cache:fill_workers
 
    \param dce_ctx the session context
 
@@ -1167,6 +1116,8 @@ static NTSTATUS cache_init(struct dcesrv_context *dce_ctx)
 	mpm->sync_min = lpcfg_parm_int(dce_ctx->lp_ctx, NULL, MPM_NAME, "sync_min", 500000);
 	mpm->sync_cmd = str_list_make(dce_ctx, lpcfg_parm_string(dce_ctx->lp_ctx, NULL, MPM_NAME, "sync_cmd"), " ");
 	mpm->dbpath = lpcfg_parm_string(dce_ctx->lp_ctx, NULL, MPM_NAME, "path");
+	mpm->max_size = (uint64_t) lpcfg_parm_int(dce_ctx->lp_ctx, NULL, MPM_NAME, "max_size", MPM_STORE_MAX_SIZE) << 20;
+	mpm->fill_workers = lpcfg_parm_int(dce_ctx->lp_ctx, NULL, MPM_NAME, "fill_workers", MPM_FILL_WORKERS);
 
 	if ((mpm->ahead == true) && mpm->sync) {
 		DEBUG(0, ("%s: cache:ahead and cache:sync are exclusive!\n", MPM_ERROR));
@@ -1180,6 +1131,12 @@ static NTSTATUS cache_init(struct dcesrv_context *dce_ctx)
 		return NT_STATUS_INVALID_PARAMETER;
 	}
 
+	status = mpm_cache_store_init(mpm);
+	if (!NT_STATUS_IS_OK(status)) {
+		talloc_free(mpm);
+		return status;
+	}
+
 	database = talloc_asprintf(dce_ctx->lp_ctx, "tdb://%s/%s", mpm->dbpath, MPM_DB);
 	status = mpm_cache_ldb_createdb(dce_ctx, database, &mpm->ldb_ctx);
 	if (!NT_STATUS_IS_OK(status)) {
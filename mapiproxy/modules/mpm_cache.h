@@ -57,6 +57,40 @@ struct mpm_attachment {
 	struct mpm_attachment	*next;
 };
 
+/**
+   An entry of the on-disk stream store. Entries are addressed by the
+   (MessageId, AttachmentID, PropertyTag) key of the stream they hold
+   and are kept in a hash table and in a LRU list, most recently used
+   first.
+ */
+struct mpm_cache_entry {
+	uint64_t		MessageId;
+	uint32_t		AttachmentID;
+	enum MAPITAGS		PropertyTag;
+	uint32_t		StreamSize;
+	uint32_t		refcount;
+	struct mpm_cache_entry	*hash_next;
+	struct mpm_cache_entry	*prev;
+	struct mpm_cache_entry	*next;
+};
+
+/**
+   A fill job runs the sync command for a stream on a worker thread
+ */
+struct mpm_cache_fill_job {
+	struct mpm_stream		*stream;
+	uint64_t			MessageId;
+	uint32_t			AttachmentID;
+	enum MAPITAGS			PropertyTag;
+	uint32_t			StreamSize;
+	char				*filename;
+	char				*tmpname;
+	char				**args;
+	bool				success;
+	struct mpm_cache_fill_job	*prev;
+	struct mpm_cache_fill_job	*next;
+};
+
 /**
    A stream can either be for a message or attachment
  */
@@ -67,17 +101,30 @@ struct mpm_stream {
 	enum MAPITAGS		PropertyTag;
 	uint32_t		StreamSize;
 	size_t			offset;
-	FILE			*fp;
+	int			fd;
+	uint8_t			*map;
 	char			*filename;
+	char			*tmpname;
 	bool			cached;
 	bool			ahead;
 	struct timeval		tv_start;
+	struct mpm_cache_entry	*entry;
+	struct mpm_cache_fill_job *fill_job;
 	struct mpm_attachment	*attachment;
 	struct mpm_message	*message;
 	struct mpm_stream	*prev;
 	struct mpm_stream	*next;
 };
 
+struct mpm_cache_stats {
+	uint64_t		hits;
+	uint64_t		misses;
+	uint64_t		evictions;
+	uint64_t		fills;
+	uint64_t		fill_failures;
+	uint64_t		bytes_served;
+};
+
 /* TODO: Make use of dce_ctx->context->context_id to differentiate sessions ? */
 
 struct mpm_cache {
@@ -90,6 +137,12 @@ struct mpm_cache {
 	bool			sync;
 	int			sync_min;
 	char     		**sync_cmd;
+	int			fill_workers;
+	struct mpm_cache_entry	**entries_hash;
+	struct mpm_cache_entry	*entries;
+	uint64_t		store_size;
+	uint64_t		max_size;
+	struct mpm_cache_stats	stats;
 };
 
 __BEGIN_DECLS
@@ -106,6 +159,19 @@ NTSTATUS	mpm_cache_stream_close(struct mpm_stream *);
 NTSTATUS	mpm_cache_stream_write(struct mpm_stream *, uint16_t, uint8_t *);
 NTSTATUS	mpm_cache_stream_read(struct mpm_stream *, size_t, size_t *, uint8_t **);
 NTSTATUS	mpm_cache_stream_reset(struct mpm_stream *);
+NTSTATUS	mpm_cache_stream_commit(struct mpm_cache *, struct mpm_stream *);
+void		mpm_cache_stream_key(struct mpm_stream *, uint64_t *, uint32_t *);
+
+NTSTATUS	mpm_cache_store_init(struct mpm_cache *);
+char		*mpm_cache_store_path(TALLOC_CTX *, struct mpm_cache *, uint64_t, uint32_t, enum MAPITAGS, bool);
+struct mpm_cache_entry *mpm_cache_store_lookup(struct mpm_cache *, uint64_t, uint32_t, enum MAPITAGS);
+NTSTATUS	mpm_cache_store_add(struct mpm_cache *, uint64_t, uint32_t, enum MAPITAGS, const char *);
+void		mpm_cache_store_evict(struct mpm_cache *);
+void		mpm_cache_store_dump_stats(struct mpm_cache *);
+
+NTSTATUS	mpm_cache_fill_submit(struct mpm_cache *, struct mpm_stream *);
+void		mpm_cache_fill_poll(struct mpm_cache *);
+void		mpm_cache_fill_detach(struct mpm_stream *);
 
 __END_DECLS
 
@@ -117,6 +183,10 @@ __END_DECLS
 #define	MPM_ERROR	"[ERROR] mpm_cache:"
 #define	MPM_DB		"mpm_cache.ldb"
 #define	MPM_DB_STORAGE	"data"
+#define	MPM_STORE_HASH_SIZE	4096
+#define	MPM_STORE_MAX_SIZE	1024
+#define	MPM_FILL_WORKERS	2
+#define	MPM_NO_ATTACHMENT	0xFFFFFFFF
 
 #define	MPM_LOCATION	__FUNCTION__, __LINE__
 #define	MPM_SESSION(x)	x->session->server_id.pid, x->session->server_id.task_id, x->session->server_id.vnn, x->session->context_id
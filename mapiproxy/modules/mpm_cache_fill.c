@@ -0,0 +1,324 @@
+/*
+   MAPI Proxy - Cache module
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file mpm_cache_fill.c
+
+   \brief Asynchronous cache fill for the cache module
+
+   When mpm_cache:sync is enabled, the sync command transferring a
+   stream from another MAPIProxy instance runs on a pool of worker
+   threads. The proxy keeps relaying ReadStream calls to the remote
+   server meanwhile, and switches the stream to the cache once the
+   fill is complete. Worker threads only run the command: jobs are
+   created, collected and freed by the proxy process.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/modules/mpm_cache.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+#include <util/debug.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <unistd.h>
+
+struct mpm_cache_fill_pool {
+	pid_t				pid;
+	bool				started;
+	struct mpm_cache_fill_job	*pending;
+	struct mpm_cache_fill_job	*done;
+#if defined(HAVE_PTHREADS)
+	pthread_mutex_t			lock;
+	pthread_cond_t			cond;
+#endif
+};
+
+static struct mpm_cache_fill_pool	fill_pool;
+
+/**
+   \details Run the sync command of a job and check the size of the
+   resulting file. This is called from worker threads and must not
+   allocate memory nor log.
+
+   \param job pointer to the fill job
+ */
+static void mpm_cache_fill_run(struct mpm_cache_fill_job *job)
+{
+	struct stat	sb;
+	pid_t		pid;
+	int		status;
+
+	job->success = false;
+
+	switch (pid = fork()) {
+	case -1:
+		return;
+	case 0:
+		execve(job->args[0], job->args, NULL);
+		_exit(127);
+	default:
+		while (waitpid(pid, &status, 0) == -1) {
+			if (errno != EINTR) return;
+		}
+		break;
+	}
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return;
+	if (stat(job->tmpname, &sb) == -1) return;
+	if (sb.st_size != job->StreamSize) return;
+
+	job->success = true;
+}
+
+#if defined(HAVE_PTHREADS)
+static void *mpm_cache_fill_worker(void *arg)
+{
+	struct mpm_cache_fill_job	*job;
+
+	for (;;) {
+		pthread_mutex_lock(&fill_pool.lock);
+		while (!fill_pool.pending) {
+			pthread_cond_wait(&fill_pool.cond, &fill_pool.lock);
+		}
+		job = fill_pool.pending;
+		DLIST_REMOVE(fill_pool.pending, job);
+		pthread_mutex_unlock(&fill_pool.lock);
+
+		mpm_cache_fill_run(job);
+
+		pthread_mutex_lock(&fill_pool.lock);
+		DLIST_ADD_END(fill_pool.done, job, struct mpm_cache_fill_job *);
+		pthread_mutex_unlock(&fill_pool.lock);
+	}
+
+	return NULL;
+}
+
+/**
+   \details Start the worker threads. This is done on first use, from
+   the process serving the connection: threads do not survive the
+   fork of the server process model.
+ */
+static bool mpm_cache_fill_start(struct mpm_cache *mpm)
+{
+	pthread_attr_t	attr;
+	pthread_t	thread;
+	int		i;
+	int		started = 0;
+
+	if (fill_pool.started && fill_pool.pid == getpid()) return true;
+
+	fill_pool.pending = NULL;
+	fill_pool.done = NULL;
+	pthread_mutex_init(&fill_pool.lock, NULL);
+	pthread_cond_init(&fill_pool.cond, NULL);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	for (i = 0; i < mpm->fill_workers; i++) {
+		if (pthread_create(&thread, &attr, mpm_cache_fill_worker, NULL) == 0) {
+			started++;
+		}
+	}
+	pthread_attr_destroy(&attr);
+
+	if (!started) {
+		DEBUG(0, ("%s: Unable to start the cache fill workers\n", MPM_ERROR));
+		return false;
+	}
+
+	DEBUG(2, ("* [%s:%d]: %d cache fill workers started\n", MPM_LOCATION, started));
+	fill_pool.pid = getpid();
+	fill_pool.started = true;
+
+	return true;
+}
+#endif
+
+
+/**
+   \details Start filling the cache for a stream with the sync command.
+
+   The partial file written so far is dropped: the stream is relayed
+   until the fill completes, and __FILE__ arguments are replaced with
+   the path of the stream in the store, which is the same on every
+   MAPIProxy instance sharing the same mpm_cache:path. The last
+   argument holding __FILE__ is the destination: it is replaced with
+   a temporary file instead, moved into place once the fill succeeds.
+
+   \param mpm pointer to the cache module general structure
+   \param stream pointer to the mpm_stream entry
+
+   \return NT_STATUS_OK on success, otherwise NT_STATUS_INVALID_PARAMETER
+   or NT_STATUS_NO_MEMORY
+ */
+NTSTATUS mpm_cache_fill_submit(struct mpm_cache *mpm, struct mpm_stream *stream)
+{
+	struct mpm_cache_fill_job	*job;
+	uint32_t			i;
+	uint32_t			dest;
+
+	if (!mpm->sync_cmd || !mpm->sync_cmd[0] || !stream->filename || stream->fill_job) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	if (stream->fd != -1) {
+		close(stream->fd);
+		stream->fd = -1;
+	}
+	if (stream->tmpname) {
+		unlink(stream->tmpname);
+		talloc_free(stream->tmpname);
+		stream->tmpname = NULL;
+	}
+
+	job = talloc_zero((TALLOC_CTX *)mpm, struct mpm_cache_fill_job);
+	NT_STATUS_HAVE_NO_MEMORY(job);
+
+	mpm_cache_stream_key(stream, &job->MessageId, &job->AttachmentID);
+	job->PropertyTag = stream->PropertyTag;
+	job->StreamSize = stream->StreamSize;
+	job->filename = talloc_strdup(job, stream->filename);
+	job->tmpname = talloc_asprintf(job, "%s.tmp", stream->filename);
+
+	for (i = 0, dest = 0; mpm->sync_cmd[i]; i++) {
+		if (strstr(mpm->sync_cmd[i], "__FILE__")) dest = i;
+	}
+	job->args = talloc_array(job, char *, i + 1);
+	for (i = 0; mpm->sync_cmd[i]; i++) {
+		if (strstr(mpm->sync_cmd[i], "__FILE__")) {
+			job->args[i] = string_sub_talloc(job->args, mpm->sync_cmd[i], "__FILE__",
+							 (i == dest) ? job->tmpname : job->filename);
+		} else {
+			job->args[i] = talloc_strdup(job->args, mpm->sync_cmd[i]);
+		}
+		DEBUG(2, ("'%s' ", job->args[i]));
+	}
+	job->args[i] = NULL;
+	DEBUG(2, ("\n"));
+
+	job->stream = stream;
+	stream->fill_job = job;
+	mpm->stats.fills++;
+
+#if defined(HAVE_PTHREADS)
+	if (mpm_cache_fill_start(mpm)) {
+		pthread_mutex_lock(&fill_pool.lock);
+		DLIST_ADD_END(fill_pool.pending, job, struct mpm_cache_fill_job *);
+		pthread_cond_signal(&fill_pool.cond);
+		pthread_mutex_unlock(&fill_pool.lock);
+		return NT_STATUS_OK;
+	}
+#endif
+
+	/* no worker available: fill synchronously */
+	mpm_cache_fill_run(job);
+	DLIST_ADD_END(fill_pool.done, job, struct mpm_cache_fill_job *);
+	mpm_cache_fill_poll(mpm);
+
+	return NT_STATUS_OK;
+}
+
+
+/**
+   \details Collect the completed fill jobs. Complete files are moved
+   into place and added to the store, and the streams still opened on
+   them are switched to the cache at their current offset.
+
+   \param mpm pointer to the cache module general structure
+ */
+void mpm_cache_fill_poll(struct mpm_cache *mpm)
+{
+	struct mpm_cache_fill_job	*done;
+	struct mpm_cache_fill_job	*job;
+	struct mpm_stream		*stream;
+	size_t				offset;
+	NTSTATUS			status;
+
+#if defined(HAVE_PTHREADS)
+	if (fill_pool.started && fill_pool.pid == getpid()) {
+		pthread_mutex_lock(&fill_pool.lock);
+		done = fill_pool.done;
+		fill_pool.done = NULL;
+		pthread_mutex_unlock(&fill_pool.lock);
+	} else
+#endif
+	{
+		done = fill_pool.done;
+		fill_pool.done = NULL;
+	}
+
+	while ((job = done) != NULL) {
+		DLIST_REMOVE(done, job);
+
+		if (job->success && rename(job->tmpname, job->filename) == -1) {
+			DEBUG(0, ("%s: Unable to move %s to %s: %s\n", MPM_ERROR, job->tmpname, job->filename, strerror(errno)));
+			job->success = false;
+		}
+
+		if (job->success) {
+			status = mpm_cache_store_add(mpm, job->MessageId, job->AttachmentID, job->PropertyTag, job->filename);
+		} else {
+			DEBUG(0, ("%s: sync command failed for %s\n", MPM_ERROR, job->filename));
+			mpm->stats.fill_failures++;
+			unlink(job->tmpname);
+			status = NT_STATUS_UNSUCCESSFUL;
+		}
+
+		stream = job->stream;
+		if (stream) {
+			stream->fill_job = NULL;
+			offset = stream->offset;
+			if (NT_STATUS_IS_OK(status)) {
+				status = mpm_cache_stream_open(mpm, stream);
+			}
+			if (!NT_STATUS_IS_OK(status) || !stream->cached) {
+				/* keep relaying this stream */
+				mpm_cache_stream_close(stream);
+			}
+			stream->offset = offset;
+		}
+
+		talloc_free(job);
+	}
+}
+
+
+/**
+   \details Detach a stream from its fill job, when the stream is
+   released before the fill completes. The job still adds the file to
+   the store once complete.
+
+   \param stream pointer to the mpm_stream entry
+ */
+void mpm_cache_fill_detach(struct mpm_stream *stream)
+{
+	if (stream->fill_job) {
+		stream->fill_job->stream = NULL;
+		stream->fill_job = NULL;
+	}
+}
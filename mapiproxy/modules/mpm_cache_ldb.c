@@ -248,9 +248,6 @@ NTSTATUS mpm_cache_ldb_add_stream(struct mpm_cache *mpm,
 	struct mpm_message	*message;
 	struct mpm_attachment	*attach;
 	struct ldb_message	*msg;
-	struct ldb_dn		*dn;
-	const char * const	attrs[] = { "*", NULL };
-	struct ldb_result	*res;
 	char			*basedn = NULL;
 	char			*attribute;
 	int			ret;
@@ -268,74 +265,25 @@ NTSTATUS mpm_cache_ldb_add_stream(struct mpm_cache *mpm,
 		return NT_STATUS_OK;
 	}
 
-	/* This is a stream for an attachment */
+	/* Complete streams are served from the store */
+	mpm_cache_stream_open(mpm, stream);
+	if (stream->cached == true) {
+		stream->ahead = false;
+		return NT_STATUS_OK;
+	}
+
 	if (stream->attachment) {
 		basedn = talloc_asprintf(mem_ctx, "CN=%d,CN=0x%"PRIx64",CN=0x%"PRIx64",CN=Cache",
 					 attach->AttachmentID, message->MessageId,
 					 message->FolderId);
-		dn = ldb_dn_new(mem_ctx, ldb_ctx, basedn);
-		talloc_free(basedn);
-		if (!dn) return NT_STATUS_UNSUCCESSFUL;
-		
-		ret = ldb_search(ldb_ctx, mem_ctx, &res, dn, LDB_SCOPE_BASE, attrs, 
-				 "(0x%x=*)", stream->PropertyTag);
-
-		if (ret == LDB_SUCCESS && res->count == 1) {
-			attribute = talloc_asprintf(mem_ctx, "0x%x", stream->PropertyTag);
-			basedn = (char *) ldb_msg_find_attr_as_string(res->msgs[0], attribute, NULL);
-			talloc_free(attribute);
-			DEBUG(2, ("* [%s:%d] Loading from cache 0x%x = %s\n", MPM_LOCATION,
-				  stream->PropertyTag, basedn));
-			stream->filename = talloc_strdup(mem_ctx, basedn);
-			stream->cached = true;
-			stream->ahead = false;
-			mpm_cache_stream_open(mpm, stream);
-
-			return NT_STATUS_OK;
-		}
-
-		/* Otherwise create the stream with basedn above */
-		basedn = talloc_asprintf(mem_ctx, "CN=%d,CN=0x%"PRIx64",CN=0x%"PRIx64",CN=Cache",
-					 attach->AttachmentID, message->MessageId,
-					 message->FolderId);
-
 		DEBUG(2, ("* [%s:%d] Create the stream TDB record for attachment\n", MPM_LOCATION));
-	} 
-
-	if (stream->message) {
-		basedn = talloc_asprintf(mem_ctx, "CN=0x%"PRIx64",CN=0x%"PRIx64",CN=Cache",
-					 message->MessageId, message->FolderId);
-		dn = ldb_dn_new(mem_ctx, ldb_ctx, basedn);
-		talloc_free(basedn);
-		if (!dn) return NT_STATUS_UNSUCCESSFUL;
-
-		ret = ldb_search(ldb_ctx, mem_ctx, &res, dn, LDB_SCOPE_BASE, attrs, "(0x%x=*)", stream->PropertyTag);
-
-		if (ret == LDB_SUCCESS && res->count == 1) {
-			attribute = talloc_asprintf(mem_ctx, "0x%x", stream->PropertyTag);
-			basedn = (char *) ldb_msg_find_attr_as_string(res->msgs[0], attribute, NULL);
-			talloc_free(attribute);
-			DEBUG(2, ("* [%s:%d] Loading from cache 0x%x = %s\n", MPM_LOCATION,
-				  stream->PropertyTag, basedn));
-			stream->filename = talloc_strdup(mem_ctx, basedn);
-			stream->cached = true;
-			stream->ahead = false;
-			mpm_cache_stream_open(mpm, stream);
-
-			return NT_STATUS_OK;
-		}
-
-		/* Otherwise create the stream with basedn above */
+	} else {
 		basedn = talloc_asprintf(mem_ctx, "CN=0x%"PRIx64",CN=0x%"PRIx64",CN=Cache",
 					 message->MessageId, message->FolderId);
-		
 		DEBUG(2, ("* [%s:%d] Modify the message TDB record and append stream information\n",
 			  MPM_LOCATION));
 	}
 
-	stream->cached = false;
-	mpm_cache_stream_open(mpm, stream);
-
 	msg = ldb_msg_new(mem_ctx);
 	if (msg == NULL) return NT_STATUS_NO_MEMORY;
 
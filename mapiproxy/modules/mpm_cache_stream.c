@@ -23,6 +23,13 @@
    \file mpm_cache_stream.c
 
    \brief Storage routines for the cache module
+
+   Streams are stored under path/data, in a file named after the
+   (MessageId, AttachmentID, PropertyTag) key of the stream. Files
+   are first written under a temporary name and only enter the store
+   once complete. Complete streams are served from a read-only
+   mapping of their file, and the least recently used ones are
+   removed when the store grows over mpm_cache:max_size.
  */
 
 #include "mapiproxy/dcesrv_mapiproxy.h"
@@ -32,85 +39,494 @@
 #include "libmapi/libmapi_private.h"
 #include <util/debug.h>
 
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static inline uint32_t mpm_cache_store_hash(uint64_t MessageId, uint32_t AttachmentID, enum MAPITAGS PropertyTag)
+{
+	uint64_t	h;
+
+	h = MessageId ^ ((uint64_t) AttachmentID << 32) ^ (uint32_t) PropertyTag;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+
+	return (uint32_t) h;
+}
+
+
+/**
+   \details Build the path of a stream in the store
+
+   \param mem_ctx the memory context used to allocate the path
+   \param mpm pointer to the cache module general structure
+   \param MessageId the message identifier of the stream
+   \param AttachmentID the attachment number, or MPM_NO_ATTACHMENT
+   \param PropertyTag the property the stream was opened on
+   \param create whether the parent directory should be created
+
+   \return Allocated path on success, otherwise NULL
+ */
+char *mpm_cache_store_path(TALLOC_CTX *mem_ctx, struct mpm_cache *mpm, uint64_t MessageId,
+			   uint32_t AttachmentID, enum MAPITAGS PropertyTag, bool create)
+{
+	char		*path;
+	uint32_t	h;
+	int		ret;
+
+	h = mpm_cache_store_hash(MessageId, AttachmentID, PropertyTag);
+	if (create) {
+		path = talloc_asprintf(mem_ctx, "%s/%s/%02x", mpm->dbpath, MPM_DB_STORAGE, h & 0xff);
+		ret = mkdir(path, 0777);
+		talloc_free(path);
+		if ((ret == -1) && (errno != EEXIST)) return NULL;
+	}
+
+	return talloc_asprintf(mem_ctx, "%s/%s/%02x/%.16"PRIx64"-%.8x-%.8x.stream", mpm->dbpath,
+			       MPM_DB_STORAGE, h & 0xff, MessageId, AttachmentID, PropertyTag);
+}
+
+
+/**
+   \details Find a complete stream in the store
+
+   \param mpm pointer to the cache module general structure
+   \param MessageId the message identifier of the stream
+   \param AttachmentID the attachment number, or MPM_NO_ATTACHMENT
+   \param PropertyTag the property the stream was opened on
+
+   \return Pointer to the store entry on success, otherwise NULL
+ */
+struct mpm_cache_entry *mpm_cache_store_lookup(struct mpm_cache *mpm, uint64_t MessageId,
+					       uint32_t AttachmentID, enum MAPITAGS PropertyTag)
+{
+	struct mpm_cache_entry	*entry;
+
+	entry = mpm->entries_hash[mpm_cache_store_hash(MessageId, AttachmentID, PropertyTag) % MPM_STORE_HASH_SIZE];
+	for (; entry; entry = entry->hash_next) {
+		if (entry->MessageId == MessageId && entry->AttachmentID == AttachmentID &&
+		    entry->PropertyTag == PropertyTag) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+
+static struct mpm_cache_entry *mpm_cache_store_insert(struct mpm_cache *mpm, uint64_t MessageId,
+						      uint32_t AttachmentID, enum MAPITAGS PropertyTag,
+						      uint32_t StreamSize)
+{
+	struct mpm_cache_entry	*entry;
+	uint32_t		bucket;
+
+	entry = talloc_zero((TALLOC_CTX *)mpm, struct mpm_cache_entry);
+	if (!entry) return NULL;
+
+	entry->MessageId = MessageId;
+	entry->AttachmentID = AttachmentID;
+	entry->PropertyTag = PropertyTag;
+	entry->StreamSize = StreamSize;
+
+	bucket = mpm_cache_store_hash(MessageId, AttachmentID, PropertyTag) % MPM_STORE_HASH_SIZE;
+	entry->hash_next = mpm->entries_hash[bucket];
+	mpm->entries_hash[bucket] = entry;
+	DLIST_ADD(mpm->entries, entry);
+	mpm->store_size += StreamSize;
+
+	return entry;
+}
+
+
+static void mpm_cache_store_remove(struct mpm_cache *mpm, struct mpm_cache_entry *entry)
+{
+	struct mpm_cache_entry	**el;
+	char			*path;
+
+	path = mpm_cache_store_path((TALLOC_CTX *)mpm, mpm, entry->MessageId, entry->AttachmentID, entry->PropertyTag, false);
+	if (path) {
+		unlink(path);
+		talloc_free(path);
+	}
+
+	el = &mpm->entries_hash[mpm_cache_store_hash(entry->MessageId, entry->AttachmentID, entry->PropertyTag) % MPM_STORE_HASH_SIZE];
+	while (*el && *el != entry) {
+		el = &(*el)->hash_next;
+	}
+	if (*el) {
+		*el = entry->hash_next;
+	}
+	DLIST_REMOVE(mpm->entries, entry);
+	mpm->store_size -= entry->StreamSize;
+	talloc_free(entry);
+}
+
 
 /**
-   \details Create a file: message or attachment in the cache
+   \details Remove the least recently used streams until the store
+   fits in mpm_cache:max_size. Streams currently mapped by a session
+   are left in place.
+
+   \param mpm pointer to the cache module general structure
+ */
+void mpm_cache_store_evict(struct mpm_cache *mpm)
+{
+	struct mpm_cache_entry	*entry;
+	struct mpm_cache_entry	*prev;
+
+	if (!mpm->max_size || mpm->store_size <= mpm->max_size) return;
+
+	for (entry = mpm->entries; entry && entry->next; entry = entry->next);
 
-   If the stream is attached to an attachment:	FolderID/MessageID/AttachmentID.stream
-   If the stream is attached to a message:	FolderID/MessageID.stream
+	for (; entry && mpm->store_size > mpm->max_size; entry = prev) {
+		prev = (entry == mpm->entries) ? NULL : entry->prev;
+		if (entry->refcount) continue;
+
+		DEBUG(2, ("* [%s:%d]: Evicting stream 0x%"PRIx64"/0x%x/0x%x (%u bytes)\n", MPM_LOCATION,
+			  entry->MessageId, entry->AttachmentID, entry->PropertyTag, entry->StreamSize));
+		mpm_cache_store_remove(mpm, entry);
+		mpm->stats.evictions++;
+	}
+}
+
+
+/**
+   \details Add a complete stream file to the store
 
    \param mpm pointer to the cache module general structure
+   \param MessageId the message identifier of the stream
+   \param AttachmentID the attachment number, or MPM_NO_ATTACHMENT
+   \param PropertyTag the property the stream was opened on
+   \param filename the file holding the stream data, which is moved
+   to its place in the store
+
+   \return NT_STATUS_OK on success, otherwise NT_STATUS_UNSUCCESSFUL
+ */
+NTSTATUS mpm_cache_store_add(struct mpm_cache *mpm, uint64_t MessageId, uint32_t AttachmentID,
+			     enum MAPITAGS PropertyTag, const char *filename)
+{
+	struct mpm_cache_entry	*entry;
+	struct stat		sb;
+	char			*path;
+
+	path = mpm_cache_store_path((TALLOC_CTX *)mpm, mpm, MessageId, AttachmentID, PropertyTag, true);
+	if (!path) return NT_STATUS_UNSUCCESSFUL;
+
+	if (strcmp(path, filename) && rename(filename, path) == -1) {
+		DEBUG(0, ("* [%s:%d]: Unable to move %s to %s: %s\n", MPM_LOCATION, filename, path, strerror(errno)));
+		unlink(filename);
+		talloc_free(path);
+		return NT_STATUS_UNSUCCESSFUL;
+	}
+
+	if (stat(path, &sb) == -1) {
+		talloc_free(path);
+		return NT_STATUS_UNSUCCESSFUL;
+	}
+	talloc_free(path);
+
+	entry = mpm_cache_store_lookup(mpm, MessageId, AttachmentID, PropertyTag);
+	if (entry) {
+		mpm->store_size -= entry->StreamSize;
+		entry->StreamSize = sb.st_size;
+		mpm->store_size += entry->StreamSize;
+		DLIST_REMOVE(mpm->entries, entry);
+		DLIST_ADD(mpm->entries, entry);
+	} else if (!mpm_cache_store_insert(mpm, MessageId, AttachmentID, PropertyTag, sb.st_size)) {
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	mpm_cache_store_evict(mpm);
+
+	return NT_STATUS_OK;
+}
+
+
+struct mpm_cache_store_file {
+	uint64_t	MessageId;
+	uint32_t	AttachmentID;
+	uint32_t	PropertyTag;
+	uint32_t	StreamSize;
+	time_t		mtime;
+};
+
+static int mpm_cache_store_file_cmp(const void *a, const void *b)
+{
+	const struct mpm_cache_store_file	*fa = (const struct mpm_cache_store_file *) a;
+	const struct mpm_cache_store_file	*fb = (const struct mpm_cache_store_file *) b;
+
+	if (fa->mtime < fb->mtime) return -1;
+	if (fa->mtime > fb->mtime) return 1;
+	return 0;
+}
+
+
+/**
+   \details Create the store and index the streams left by previous
+   runs. Their modification time is used as the initial LRU order and
+   leftover temporary files are removed.
+
+   \param mpm pointer to the cache module general structure
+
+   \return NT_STATUS_OK on success, otherwise NT_STATUS_NO_MEMORY or
+   NT_STATUS_UNSUCCESSFUL
+ */
+NTSTATUS mpm_cache_store_init(struct mpm_cache *mpm)
+{
+	TALLOC_CTX			*mem_ctx;
+	struct mpm_cache_store_file	*files = NULL;
+	uint32_t			count = 0;
+	uint32_t			i;
+	DIR				*store_dir, *dir;
+	struct dirent			*store_de, *de;
+	struct stat			sb;
+	char				*path, *subpath, *file;
+	unsigned int			AttachmentID, PropertyTag;
+	uint64_t			MessageId;
+	int				len;
+
+	mpm->entries_hash = talloc_zero_array((TALLOC_CTX *)mpm, struct mpm_cache_entry *, MPM_STORE_HASH_SIZE);
+	if (!mpm->entries_hash) return NT_STATUS_NO_MEMORY;
+
+	mem_ctx = talloc_named(NULL, 0, "mpm_cache_store_init");
+	path = talloc_asprintf(mem_ctx, "%s/%s", mpm->dbpath, MPM_DB_STORAGE);
+	if ((mkdir(path, 0777) == -1) && (errno != EEXIST)) {
+		DEBUG(0, ("%s: Unable to create %s: %s\n", MPM_ERROR, path, strerror(errno)));
+		talloc_free(mem_ctx);
+		return NT_STATUS_UNSUCCESSFUL;
+	}
+
+	store_dir = opendir(path);
+	if (!store_dir) {
+		talloc_free(mem_ctx);
+		return NT_STATUS_UNSUCCESSFUL;
+	}
+
+	while ((store_de = readdir(store_dir)) != NULL) {
+		if (strlen(store_de->d_name) != 2 || !isxdigit(store_de->d_name[0]) || !isxdigit(store_de->d_name[1])) {
+			continue;
+		}
+		subpath = talloc_asprintf(mem_ctx, "%s/%s", path, store_de->d_name);
+		dir = opendir(subpath);
+		if (!dir) continue;
+
+		while ((de = readdir(dir)) != NULL) {
+			if (de->d_name[0] == '.') continue;
+
+			file = talloc_asprintf(mem_ctx, "%s/%s", subpath, de->d_name);
+			len = 0;
+			if (sscanf(de->d_name, "%16"SCNx64"-%8x-%8x.stream%n", &MessageId, &AttachmentID, &PropertyTag, &len) != 3 ||
+			    de->d_name[len] != '\0') {
+				/* interrupted writes */
+				if (strstr(de->d_name, ".tmp")) {
+					unlink(file);
+				}
+				talloc_free(file);
+				continue;
+			}
+			if (stat(file, &sb) == 0 && S_ISREG(sb.st_mode)) {
+				files = talloc_realloc(mem_ctx, files, struct mpm_cache_store_file, count + 1);
+				files[count].MessageId = MessageId;
+				files[count].AttachmentID = AttachmentID;
+				files[count].PropertyTag = PropertyTag;
+				files[count].StreamSize = sb.st_size;
+				files[count].mtime = sb.st_mtime;
+				count++;
+			}
+			talloc_free(file);
+		}
+		closedir(dir);
+		talloc_free(subpath);
+	}
+	closedir(store_dir);
+
+	/* oldest first, so the most recent ends up at the head of the LRU list */
+	if (count) {
+		qsort(files, count, sizeof (struct mpm_cache_store_file), mpm_cache_store_file_cmp);
+	}
+	for (i = 0; i < count; i++) {
+		mpm_cache_store_insert(mpm, files[i].MessageId, files[i].AttachmentID,
+				       (enum MAPITAGS) files[i].PropertyTag, files[i].StreamSize);
+	}
+	talloc_free(mem_ctx);
+
+	DEBUG(1, ("* [%s:%d]: %u streams (%"PRIu64" bytes) in the store\n", MPM_LOCATION,
+		  count, mpm->store_size));
+	mpm_cache_store_evict(mpm);
+
+	return NT_STATUS_OK;
+}
+
+
+/**
+   \details Dump the store statistics
+
+   \param mpm pointer to the cache module general structure
+ */
+void mpm_cache_store_dump_stats(struct mpm_cache *mpm)
+{
+	DEBUG(1, ("STATISTIC: store: %"PRIu64" hits, %"PRIu64" misses, %"PRIu64" evictions, "
+		  "%"PRIu64"/%"PRIu64" failed fills, %"PRIu64" bytes served, %"PRIu64"/%"PRIu64" bytes used\n",
+		  mpm->stats.hits, mpm->stats.misses, mpm->stats.evictions,
+		  mpm->stats.fill_failures, mpm->stats.fills, mpm->stats.bytes_served,
+		  mpm->store_size, mpm->max_size));
+}
+
+
+/**
+   \details Retrieve the store key of a stream
+
    \param stream pointer to the mpm_stream entry
+   \param MessageId pointer to the returned message identifier
+   \param AttachmentID pointer to the returned attachment number
+ */
+void mpm_cache_stream_key(struct mpm_stream *stream, uint64_t *MessageId, uint32_t *AttachmentID)
+{
+	if (stream->attachment) {
+		*MessageId = stream->attachment->message->MessageId;
+		*AttachmentID = stream->attachment->AttachmentID;
+	} else {
+		*MessageId = stream->message->MessageId;
+		*AttachmentID = MPM_NO_ATTACHMENT;
+	}
+}
+
+
+static bool mpm_cache_stream_map(struct mpm_cache *mpm, struct mpm_stream *stream, struct mpm_cache_entry *entry)
+{
+	struct stat	sb;
+	uint8_t		*map = NULL;
+	int		fd;
+
+	fd = open(stream->filename, O_RDONLY);
+	if (fd == -1) return false;
+
+	if (fstat(fd, &sb) == -1 || sb.st_size != entry->StreamSize) {
+		close(fd);
+		return false;
+	}
+
+	if (entry->StreamSize) {
+		map = (uint8_t *) mmap(NULL, entry->StreamSize, PROT_READ, MAP_SHARED, fd, 0);
+		if (map == MAP_FAILED) {
+			close(fd);
+			return false;
+		}
+	}
+	close(fd);
 
-   \return Return a FILE pointer otherwise NULL
+	stream->map = map;
+	stream->entry = entry;
+	stream->cached = true;
+	entry->refcount++;
+	DLIST_REMOVE(mpm->entries, entry);
+	DLIST_ADD(mpm->entries, entry);
+
+	return true;
+}
+
+
+/**
+   \details Open a message or attachment stream in the cache
+
+   If the stream is complete in the store, it is mapped and marked as
+   cached. Otherwise a temporary file is created next to its place in
+   the store, which mpm_cache_stream_commit() moves into the store
+   once the stream has been fully written.
+
+   \param mpm pointer to the cache module general structure
+   \param stream pointer to the mpm_stream entry
+
+   \return NT_STATUS_OK on success, otherwise NT_STATUS_UNSUCCESSFUL
  */
 NTSTATUS mpm_cache_stream_open(struct mpm_cache *mpm, struct mpm_stream *stream)
 {
-	TALLOC_CTX	*mem_ctx;
-	char		*file;
-	int		ret;
+	TALLOC_CTX		*mem_ctx;
+	struct mpm_cache_entry	*entry;
+	uint64_t		MessageId;
+	uint32_t		AttachmentID;
 
 	mem_ctx = (TALLOC_CTX *) mpm;
 
-	if (stream->filename) {
-		stream->fp = fopen(stream->filename, "r");
-		stream->offset = 0;
+	if (!stream->message && !stream->attachment) {
 		return NT_STATUS_OK;
 	}
 
-	if (stream->message) {
-		/* Create the folder */
-		file = talloc_asprintf(mem_ctx, "%s/0x%"PRIx64, mpm->dbpath, stream->message->FolderId);
-		ret = mkdir(file, 0777);
-		talloc_free(file);
-		if ((ret == -1) && (errno != EEXIST)) return NT_STATUS_UNSUCCESSFUL;
-
-		/* Open the file */
-		file = talloc_asprintf(mem_ctx, "%s/0x%"PRIx64"/0x%"PRIx64".stream",
-				       mpm->dbpath, stream->message->FolderId,
-				       stream->message->MessageId);
-
-		DEBUG(2, ("* [%s:%d]: Opening Message stream %s\n", MPM_LOCATION, file));
-		stream->filename = talloc_strdup(mem_ctx, file);
-		stream->fp = fopen(file, "w+");
-		stream->offset = 0;
-		talloc_free(file);
-		
-		return NT_STATUS_OK;
+	mpm_cache_stream_key(stream, &MessageId, &AttachmentID);
+	talloc_free(stream->filename);
+	stream->filename = mpm_cache_store_path(mem_ctx, mpm, MessageId, AttachmentID, stream->PropertyTag, true);
+	if (!stream->filename) return NT_STATUS_UNSUCCESSFUL;
+	stream->offset = 0;
+
+	entry = mpm_cache_store_lookup(mpm, MessageId, AttachmentID, stream->PropertyTag);
+	if (entry && entry->StreamSize == stream->StreamSize) {
+		if (mpm_cache_stream_map(mpm, stream, entry)) {
+			DEBUG(2, ("* [%s:%d]: Loading from cache %s\n", MPM_LOCATION, stream->filename));
+			mpm->stats.hits++;
+			return NT_STATUS_OK;
+		}
+	}
+	/* the stream changed or its file went away */
+	if (entry && !entry->refcount) {
+		mpm_cache_store_remove(mpm, entry);
 	}
 
-	if (stream->attachment) {
-		/* Create the folders */
-		file = talloc_asprintf(mem_ctx, "%s/0x%"PRIx64, mpm->dbpath, 
-				       stream->attachment->message->FolderId);
-		ret = mkdir(file, 0777);
-		talloc_free(file);
-		if ((ret == -1) && (errno != EEXIST)) return NT_STATUS_UNSUCCESSFUL;
-
-		file = talloc_asprintf(mem_ctx, "%s/0x%"PRIx64"/0x%"PRIx64, mpm->dbpath,
-				       stream->attachment->message->FolderId, 
-				       stream->attachment->message->MessageId);
-		ret = mkdir(file, 0777);
-		talloc_free(file);
-		if ((ret == -1) && (errno != EEXIST)) return NT_STATUS_UNSUCCESSFUL;
-
-		file = talloc_asprintf(mem_ctx, "%s/0x%"PRIx64"/0x%"PRIx64"/%d.stream", 
-				       mpm->dbpath,
-				       stream->attachment->message->FolderId, 
-				       stream->attachment->message->MessageId,
-				       stream->attachment->AttachmentID);
-
-		DEBUG(2, ("* [%s:%d]: Opening Attachment stream %s\n", MPM_LOCATION, file));
-		stream->filename = talloc_strdup(mem_ctx, file);
-		stream->fp = fopen(file, "w+");
-		stream->offset = 0;
-		talloc_free(file);
+	mpm->stats.misses++;
+	stream->cached = false;
+	stream->tmpname = talloc_asprintf(mem_ctx, "%s.%d.tmp", stream->filename, (int) getpid());
+	DEBUG(2, ("* [%s:%d]: Opening stream %s\n", MPM_LOCATION, stream->tmpname));
+	stream->fd = open(stream->tmpname, O_RDWR|O_CREAT|O_TRUNC, 0666);
+	if (stream->fd == -1) {
+		DEBUG(0, ("* [%s:%d]: Unable to create %s: %s\n", MPM_LOCATION, stream->tmpname, strerror(errno)));
+		talloc_free(stream->tmpname);
+		stream->tmpname = NULL;
+		return NT_STATUS_UNSUCCESSFUL;
+	}
 
-		return NT_STATUS_OK;
+	return NT_STATUS_OK;
+}
+
+
+/**
+   \details Move a fully written stream into the store and serve it
+   from there. The stream offset is left unchanged.
+
+   \param mpm pointer to the cache module general structure
+   \param stream pointer to the mpm_stream entry
+
+   \return NT_STATUS_OK on success, otherwise NT_STATUS_INVALID_PARAMETER
+   or NT_STATUS_UNSUCCESSFUL
+ */
+NTSTATUS mpm_cache_stream_commit(struct mpm_cache *mpm, struct mpm_stream *stream)
+{
+	struct mpm_cache_entry	*entry;
+	NTSTATUS		status;
+	uint64_t		MessageId;
+	uint32_t		AttachmentID;
+
+	if (stream->fd == -1 || !stream->tmpname) return NT_STATUS_INVALID_PARAMETER;
+	if (stream->offset != stream->StreamSize) return NT_STATUS_UNSUCCESSFUL;
+
+	close(stream->fd);
+	stream->fd = -1;
+
+	mpm_cache_stream_key(stream, &MessageId, &AttachmentID);
+	status = mpm_cache_store_add(mpm, MessageId, AttachmentID, stream->PropertyTag, stream->tmpname);
+	talloc_free(stream->tmpname);
+	stream->tmpname = NULL;
+	if (!NT_STATUS_IS_OK(status)) return status;
+
+	entry = mpm_cache_store_lookup(mpm, MessageId, AttachmentID, stream->PropertyTag);
+	if (!entry || !mpm_cache_stream_map(mpm, stream, entry)) {
+		return NT_STATUS_UNSUCCESSFUL;
 	}
 
 	return NT_STATUS_OK;
@@ -126,19 +542,46 @@ NTSTATUS mpm_cache_stream_open(struct mpm_cache *mpm, struct mpm_stream *stream)
  */
 NTSTATUS mpm_cache_stream_close(struct mpm_stream *stream)
 {
-	if (stream && stream->fp) {
-		fclose(stream->fp);
-		stream->fp = NULL;
-	} else {
-		return NT_STATUS_NOT_FOUND;
+	bool	found = false;
+
+	if (!stream) return NT_STATUS_NOT_FOUND;
+
+	if (stream->fill_job) {
+		mpm_cache_fill_detach(stream);
+		found = true;
 	}
 
-	return NT_STATUS_OK;
+	if (stream->entry) {
+		if (stream->map) {
+			munmap(stream->map, stream->StreamSize);
+			stream->map = NULL;
+		}
+		stream->entry->refcount--;
+		stream->entry = NULL;
+		found = true;
+	}
+
+	if (stream->fd != -1) {
+		close(stream->fd);
+		stream->fd = -1;
+		found = true;
+	}
+
+	if (stream->tmpname) {
+		unlink(stream->tmpname);
+		talloc_free(stream->tmpname);
+		stream->tmpname = NULL;
+	}
+
+	return found ? NT_STATUS_OK : NT_STATUS_NOT_FOUND;
 }
 
 
 /**
-   \details Read input_size bytes from a local binary stream
+   \details Read input_size bytes from a cached stream
+
+   The data is not copied: it points into the stream mapping, which
+   remains valid until the stream is closed.
 
    \param stream pointer to the mpm_stream entry
    \param input_size the number of bytes to read
@@ -150,8 +593,15 @@ NTSTATUS mpm_cache_stream_close(struct mpm_stream *stream)
  */
 NTSTATUS mpm_cache_stream_read(struct mpm_stream *stream, size_t input_size, size_t *length, uint8_t **data)
 {
-	fseek(stream->fp, stream->offset, SEEK_SET);
-	*length = fread(*data, sizeof (uint8_t), input_size, stream->fp);
+	*length = 0;
+	*data = NULL;
+	if (stream->map && stream->offset < stream->StreamSize) {
+		*length = stream->StreamSize - stream->offset;
+		if (*length > input_size) {
+			*length = input_size;
+		}
+		*data = stream->map + stream->offset;
+	}
 	stream->offset += *length;
 	DEBUG(5, ("* [%s:%d]: Current offset: 0x%zx\n", MPM_LOCATION,
 		  stream->offset));
@@ -171,10 +621,11 @@ NTSTATUS mpm_cache_stream_read(struct mpm_stream *stream, size_t input_size, siz
  */
 NTSTATUS mpm_cache_stream_write(struct mpm_stream *stream, uint16_t length, uint8_t *data)
 {
-	uint32_t	WrittenSize;
+	ssize_t		WrittenSize;
+
+	if (stream->fd == -1) return NT_STATUS_UNSUCCESSFUL;
 
-	fseek(stream->fp, stream->offset, SEEK_SET);
-	WrittenSize = fwrite(data, sizeof (uint8_t), length, stream->fp);
+	WrittenSize = pwrite(stream->fd, data, length, stream->offset);
 	if (WrittenSize != length) {
 		DEBUG(0, ("* [%s:%d] WrittenSize != length\n", MPM_LOCATION));
 		return NT_STATUS_UNSUCCESSFUL;
@@ -195,7 +646,6 @@ NTSTATUS mpm_cache_stream_write(struct mpm_stream *stream, uint16_t length, uint
  */
 NTSTATUS mpm_cache_stream_reset(struct mpm_stream *stream)
 {
-	fseek(stream->fp, 0, SEEK_SET);
 	stream->offset = 0;
 
 	return NT_STATUS_OK;
@@ -31,20 +31,35 @@
 #include "mapiproxy/libmapiserver/libmapiserver.h"
 #include "dcesrv_exchange_emsmdb.h"
 
-struct exchange_emsmdb_session		*emsmdb_session = NULL;
+static struct mpm_session_table		*emsmdb_sessions = NULL;
 void					*openchange_ldb_ctx = NULL;
+static uint32_t				emsmdb_compress_threshold = EMSMDB_COMPRESS_THRESHOLD;
+static struct mapi_compression_stats	emsmdb_compression_stats;
+static uint64_t				emsmdb_compression_summary_buffers = 0;
 
 static struct exchange_emsmdb_session *dcesrv_find_emsmdb_session(struct GUID *uuid)
 {
-	struct exchange_emsmdb_session	*session, *found_session = NULL;
+	return (struct exchange_emsmdb_session *) mpm_session_table_find(emsmdb_sessions, uuid);
+}
 
-	for (session = emsmdb_session; !found_session && session; session = session->next) {
-		if (GUID_equal(uuid, &session->uuid)) {
-			found_session = session;
-		}
-	}
+/**
+   \details Log the compression counters of this server process at a
+   level usable in production
+
+   \param reason short description of what triggers the summary
+ */
+static void emsmdb_compression_summary(const char *reason)
+{
+	struct mapi_compression_stats	*stats = &emsmdb_compression_stats;
+
+	if (stats->buffers == emsmdb_compression_summary_buffers) return;
+	emsmdb_compression_summary_buffers = stats->buffers;
 
-	return found_session;
+	DEBUG(1, ("exchange_emsmdb: EcDoRpcExt2 compression summary (%s): %"PRIu64"/%"PRIu64" buffers compressed, "
+		  "%"PRIu64" -> %"PRIu64" bytes (%.1f%% saved) in %"PRIu64" usec\n", reason,
+		  stats->compressed_buffers, stats->buffers, stats->bytes_in, stats->bytes_out,
+		  stats->bytes_in ? 100.0 * (double)(stats->bytes_in - stats->bytes_out) / (double)stats->bytes_in : 0.0,
+		  stats->usec));
 }
 
 /* FIXME: See _unbind below */
@@ -209,11 +224,11 @@ static enum MAPISTATUS dcesrv_EcDoConnect(struct dcesrv_call_state *dce_call,
         }
 	else {
 		/* Step 7. Associate this emsmdbp context to the session */
-		session = talloc((TALLOC_CTX *)emsmdb_session, struct exchange_emsmdb_session);
+		session = talloc(emsmdb_sessions, struct exchange_emsmdb_session);
 		OPENCHANGE_RETVAL_IF(!session, MAPI_E_NOT_ENOUGH_RESOURCES, emsmdbp_ctx);
 
 		session->pullTimeStamp = *r->out.pullTimeStamp;
-		session->session = mpm_session_init((TALLOC_CTX *)emsmdb_session, dce_call);
+		session->session = mpm_session_init((TALLOC_CTX *)session, dce_call);
 		OPENCHANGE_RETVAL_IF(!session->session, MAPI_E_NOT_ENOUGH_RESOURCES, emsmdbp_ctx);
 
                 session->uuid = handle->wire_handle.uuid;
@@ -221,9 +236,14 @@ static enum MAPISTATUS dcesrv_EcDoConnect(struct dcesrv_call_state *dce_call,
 		mpm_session_set_private_data(session->session, (void *) emsmdbp_ctx);
 		mpm_session_set_destructor(session->session, emsmdbp_destructor);
 
-		DEBUG(0, ("[exchange_emsmdb]: New session added: %d\n", session->session->context_id));
+		if (!mpm_session_table_add(emsmdb_sessions, &session->uuid, session)) {
+			talloc_free(session);
+			talloc_free(emsmdbp_ctx);
+			return MAPI_E_NOT_ENOUGH_RESOURCES;
+		}
 
-		DLIST_ADD_END(emsmdb_session, session, struct exchange_emsmdb_session *);
+		DEBUG(0, ("[exchange_emsmdb]: New session added: %d (%d sessions)\n", session->session->context_id,
+			  mpm_session_table_count(emsmdb_sessions)));
 	}
 
 	return MAPI_E_SUCCESS;
@@ -262,7 +282,8 @@ static enum MAPISTATUS dcesrv_EcDoDisconnect(struct dcesrv_call_state *dce_call,
                 if (session) {
                         ret = mpm_session_release(session->session);
                         if (ret == true) {
-                                DLIST_REMOVE(emsmdb_session, session);
+                                mpm_session_table_remove(emsmdb_sessions, &session->uuid);
+                                talloc_free(session);
                                 DEBUG(5, ("[%s:%d]: Session found and released\n", 
                                           __FUNCTION__, __LINE__));
                         } else {
@@ -659,7 +680,7 @@ static struct mapi_response *EcDoRpc_process_transaction(TALLOC_CTX *mem_ctx,
 	uint16_t		size = 0;
 	uint32_t		i;
 	uint32_t		idx;
-	bool			needs_realloc = true;
+	uint32_t		count = 0;
 
 	/* Sanity checks */
 	if (!emsmdbp_ctx) return NULL;
@@ -676,16 +697,15 @@ static struct mapi_response *EcDoRpc_process_transaction(TALLOC_CTX *mem_ctx,
 		goto notif;
 	}
 
-	/* Step 2. Process serialized MAPI requests */
-	mapi_response->mapi_repl = talloc_zero(mem_ctx, struct EcDoRpc_MAPI_REPL);
+	/* Step 2. Process serialized MAPI requests. Each ROP but
+	 * RopRelease produces exactly one reply, so the reply array is
+	 * sized upfront from the request (plus the terminating entry) */
+	for (count = 0; mapi_request->mapi_req[count].opnum != 0; count++);
+	count += 1;
+	mapi_response->mapi_repl = talloc_zero_array(mem_ctx, struct EcDoRpc_MAPI_REPL, count);
 	for (i = 0, idx = 0, size = 0; mapi_request->mapi_req[i].opnum != 0; i++) {
 		DEBUG(0, ("MAPI Rop: 0x%.2x (%d)\n", mapi_request->mapi_req[i].opnum, size));
 
-		if (mapi_request->mapi_req[i].opnum != op_MAPI_Release) {
-			mapi_response->mapi_repl = talloc_realloc(mem_ctx, mapi_response->mapi_repl,
-								  struct EcDoRpc_MAPI_REPL, idx + 2);
-		}
-
 		switch (mapi_request->mapi_req[i].opnum) {
 		case op_MAPI_Release: /* 0x01 */
 			retval = EcDoRpc_RopRelease(mem_ctx, emsmdbp_ctx, 
@@ -1247,12 +1267,15 @@ notif:
 	/* Step 3. Notifications/Pending calls should be processed here */
 	/* Note: GetProps and GetRows are filled with flag NDR_REMAINING, which may hide the content of the following replies. */
 	while ((notification_holder = emsmdbp_ctx->mstore_ctx->notifications)) {
+		emsmdbp_folder_cache_notify(emsmdbp_ctx->folder_cache, notification_holder->notification);
+		emsmdbp_object_search_notify(emsmdbp_ctx, notification_holder->notification);
 		subscription_list = mapistore_find_matching_subscriptions(emsmdbp_ctx->mstore_ctx, notification_holder->notification);
 		while ((subscription_holder = subscription_list)) {
-			if (needs_realloc) {
-				mapi_response->mapi_repl = talloc_realloc(mem_ctx, mapi_response->mapi_repl, struct EcDoRpc_MAPI_REPL, idx + 2);
+			if (idx + 2 > count) {
+				count = (count < 8) ? 8 : count * 2;
+				mapi_response->mapi_repl = talloc_realloc(mem_ctx, mapi_response->mapi_repl, struct EcDoRpc_MAPI_REPL, count);
 			}
-			needs_realloc = emsmdbp_fill_notification(mapi_response->mapi_repl, emsmdbp_ctx, &(mapi_response->mapi_repl[idx]), subscription_holder->subscription, notification_holder->notification, &size);
+			emsmdbp_fill_notification(mapi_response->mapi_repl, emsmdbp_ctx, &(mapi_response->mapi_repl[idx]), subscription_holder->subscription, notification_holder->notification, &size);
 			DLIST_REMOVE(subscription_list, subscription_holder);
 			talloc_free(subscription_holder);
 			idx++;
@@ -1261,6 +1284,9 @@ notif:
 		DLIST_REMOVE(emsmdbp_ctx->mstore_ctx->notifications, notification_holder);
 		talloc_free(notification_holder);
 	}
+
+	/* Search folders are populated a slice at a time */
+	emsmdbp_object_search_run(emsmdbp_ctx, EMSMDBP_SEARCH_ROWS_SLICE);
 	
 #if 0
 	DEBUG(0, ("subscriptions: %p\n", emsmdbp_ctx->mstore_ctx->subscriptions));
@@ -1672,11 +1698,11 @@ static enum MAPISTATUS dcesrv_EcDoConnectEx(struct dcesrv_call_state *dce_call,
         }
 	else {
 		/* Step 7. Associate this emsmdbp context to the session */
-		session = talloc((TALLOC_CTX *)emsmdb_session, struct exchange_emsmdb_session);
+		session = talloc(emsmdb_sessions, struct exchange_emsmdb_session);
 		OPENCHANGE_RETVAL_IF(!session, MAPI_E_NOT_ENOUGH_RESOURCES, emsmdbp_ctx);
 
 		session->pullTimeStamp = *r->out.pulTimeStamp;
-		session->session = mpm_session_init((TALLOC_CTX *)emsmdb_session, dce_call);
+		session->session = mpm_session_init((TALLOC_CTX *)session, dce_call);
 		OPENCHANGE_RETVAL_IF(!session->session, MAPI_E_NOT_ENOUGH_RESOURCES, emsmdbp_ctx);
 		
 		session->uuid = handle->wire_handle.uuid;
@@ -1684,14 +1710,146 @@ static enum MAPISTATUS dcesrv_EcDoConnectEx(struct dcesrv_call_state *dce_call,
 		mpm_session_set_private_data(session->session, (void *) emsmdbp_ctx);
 		mpm_session_set_destructor(session->session, emsmdbp_destructor);
 
-		DEBUG(0, ("[exchange_emsmdb]: New session added: %d\n", session->session->context_id));
+		if (!mpm_session_table_add(emsmdb_sessions, &session->uuid, session)) {
+			talloc_free(session);
+			talloc_free(emsmdbp_ctx);
+			return MAPI_E_NOT_ENOUGH_RESOURCES;
+		}
 
-		DLIST_ADD_END(emsmdb_session, session, struct exchange_emsmdb_session *);
+		DEBUG(0, ("[exchange_emsmdb]: New session added: %d (%d sessions)\n", session->session->context_id,
+			  mpm_session_table_count(emsmdb_sessions)));
 	}
 
 	return MAPI_E_SUCCESS;
 }
 
+/**
+   \details Close the ROP buffer being built and push it as an
+   extended buffer
+
+   \param ndr pointer to the NDR push context holding rgbOut
+   \param ndr_buffer pointer to the ROP buffer (RopSize and replies)
+   \param ndr_handles pointer to the serialized handle table
+   \param flags the RPC_HEADER_EXT flags to request
+   \param max_size the maximum size of rgbOut
+
+   \return NDR_ERR_SUCCESS on success, NDR_ERR_BUFSIZE if the buffer
+   does not fit within max_size, otherwise NDR error
+ */
+static enum ndr_err_code emsmdbp_push_rop_buffer(struct ndr_push *ndr,
+						 struct ndr_push *ndr_buffer,
+						 struct ndr_push *ndr_handles,
+						 uint16_t flags,
+						 uint32_t max_size)
+{
+	uint32_t	rop_size;
+	uint32_t	offset;
+
+	/* RopSize covers itself and the replies, not the handle table */
+	rop_size = ndr_buffer->offset;
+	ndr_buffer->offset = 0;
+	NDR_CHECK(ndr_push_uint16(ndr_buffer, NDR_SCALARS, rop_size));
+	ndr_buffer->offset = rop_size;
+	NDR_CHECK(ndr_push_bytes(ndr_buffer, ndr_handles->data, ndr_handles->offset));
+
+	offset = ndr->offset;
+	NDR_CHECK(ndr_push_mapi_extended_buffer(ndr, ndr_buffer->data, ndr_buffer->offset, flags,
+						emsmdb_compress_threshold, &emsmdb_compression_stats));
+	ndr_buffer->offset = rop_size;
+
+	if (ndr->offset > max_size) {
+		ndr->offset = offset;
+		return NDR_ERR_BUFSIZE;
+	}
+
+	return NDR_ERR_SUCCESS;
+}
+
+/**
+   \details Push a mapi_response as a chain of extended buffers
+
+   Replies are packed in order into ROP buffers of at most
+   MAPI_EXTENDED_BUFFER_MAX_SIZE bytes, each one carrying its own
+   RopSize and a copy of the handle table, and each compressed or
+   obfuscated independently. Only the last buffer is flagged with
+   RHEF_Last. A reply too large for a buffer of its own is sent
+   uncompressed.
+
+   No reply is dropped: if rgbOut would exceed the size the client
+   can receive, the whole chain is rejected with NDR_ERR_BUFSIZE and
+   the caller fails the call.
+
+   \param mem_ctx pointer to the memory context
+   \param ndr pointer to the NDR push context to write rgbOut to
+   \param mapi_response pointer to the MAPI response to push
+   \param flags the RHEF_Compressed and RHEF_XorMagic flags requested
+   by the client
+   \param max_size the maximum size of rgbOut
+
+   \return NDR_ERR_SUCCESS on success, NDR_ERR_BUFSIZE if the response
+   does not fit within max_size, otherwise NDR error
+ */
+static enum ndr_err_code emsmdbp_push_mapi_response_chain(TALLOC_CTX *mem_ctx,
+							  struct ndr_push *ndr,
+							  struct mapi_response *mapi_response,
+							  uint16_t flags,
+							  uint32_t max_size)
+{
+	enum ndr_err_code	ndr_err = NDR_ERR_SUCCESS;
+	struct ndr_push		*ndr_buffer;
+	struct ndr_push		*ndr_handles;
+	struct ndr_push		*ndr_rop;
+	uint32_t		handles_count;
+	uint32_t		offset;
+	uint32_t		i;
+
+	ndr_buffer = ndr_push_init_ctx(mem_ctx);
+	ndr_handles = ndr_push_init_ctx(mem_ctx);
+	ndr_rop = ndr_push_init_ctx(mem_ctx);
+	if (!ndr_buffer || !ndr_handles || !ndr_rop) {
+		ndr_err = NDR_ERR_ALLOC;
+		goto end;
+	}
+	ndr_set_flags(&ndr_buffer->flags, LIBNDR_FLAG_NOALIGN);
+	ndr_set_flags(&ndr_handles->flags, LIBNDR_FLAG_NOALIGN);
+	ndr_set_flags(&ndr_rop->flags, LIBNDR_FLAG_NOALIGN);
+
+	/* Step 1. Serialize the handle table shared by all buffers */
+	handles_count = (mapi_response->mapi_len - mapi_response->length) / sizeof (uint32_t);
+	for (i = 0; i < handles_count; i++) {
+		ndr_err = ndr_push_uint32(ndr_handles, NDR_SCALARS, mapi_response->handles[i]);
+		if (ndr_err != NDR_ERR_SUCCESS) goto end;
+	}
+
+	/* Step 2. Pack replies into buffers, leaving room for RopSize */
+	ndr_buffer->offset = sizeof (uint16_t);
+	for (i = 0, offset = 0; offset < mapi_response->length - sizeof (uint16_t); i++) {
+		ndr_rop->offset = 0;
+		ndr_err = ndr_push_EcDoRpc_MAPI_REPL(ndr_rop, NDR_SCALARS, &mapi_response->mapi_repl[i]);
+		if (ndr_err != NDR_ERR_SUCCESS) goto end;
+		offset += ndr_rop->offset;
+
+		if (ndr_buffer->offset > sizeof (uint16_t) &&
+		    ndr_buffer->offset + ndr_rop->offset + ndr_handles->offset > MAPI_EXTENDED_BUFFER_MAX_SIZE) {
+			ndr_err = emsmdbp_push_rop_buffer(ndr, ndr_buffer, ndr_handles, flags, max_size);
+			if (ndr_err != NDR_ERR_SUCCESS) goto end;
+			ndr_buffer->offset = sizeof (uint16_t);
+		}
+		ndr_err = ndr_push_bytes(ndr_buffer, ndr_rop->data, ndr_rop->offset);
+		if (ndr_err != NDR_ERR_SUCCESS) goto end;
+	}
+
+	/* Step 3. Push the last buffer */
+	ndr_err = emsmdbp_push_rop_buffer(ndr, ndr_buffer, ndr_handles, flags | RHEF_Last, max_size);
+
+end:
+	talloc_free(ndr_rop);
+	talloc_free(ndr_handles);
+	talloc_free(ndr_buffer);
+
+	return ndr_err;
+}
+
 /**
    \details exchange_emsmdb EcDoRpcExt2 (0xB) function
 
@@ -1709,17 +1867,20 @@ static enum MAPISTATUS dcesrv_EcDoRpcExt2(struct dcesrv_call_state *dce_call,
 	struct emsmdbp_context		*emsmdbp_ctx = NULL;
 	struct mapi2k7_request		mapi2k7_request;
 	struct mapi_response		*mapi_response;
-	struct RPC_HEADER_EXT		RPC_HEADER_EXT;
 	struct ndr_pull			*ndr_pull = NULL;
-	struct ndr_push			*ndr_uncomp_rgbOut;
-	struct ndr_push			*ndr_comp_rgbOut;
 	struct ndr_push			*ndr_rgbOut;
+	enum ndr_err_code		ndr_err;
+	uint16_t			flags;
 	uint32_t			pulFlags = 0x0;
 	uint32_t			pulTransTime = 0;
+	uint32_t			max_rgbOut;
 	DATA_BLOB			rgbIn;
 
 	DEBUG(3, ("exchange_emsmdb: EcDoRpcExt2 (0xB)\n"));
 
+	/* pcbOut is [in,out]: save the size the client can receive */
+	max_rgbOut = *r->in.pcbOut;
+
 	r->out.rgbOut = NULL;
 	*r->out.pcbOut = 0;
 	r->out.rgbAuxOut = NULL;
@@ -1759,32 +1920,34 @@ static enum MAPISTATUS dcesrv_EcDoRpcExt2(struct dcesrv_call_state *dce_call,
 	r->out.handle = r->in.handle;
 	*r->out.pulFlags = pulFlags;
 
-	/* Push MAPI response into a DATA blob */
-	ndr_uncomp_rgbOut = ndr_push_init_ctx(mem_ctx);
-	ndr_set_flags(&ndr_uncomp_rgbOut->flags, LIBNDR_FLAG_NOALIGN);
-	ndr_push_mapi_response(ndr_uncomp_rgbOut, NDR_SCALARS|NDR_BUFFERS, mapi_response);
-	talloc_free(mapi_response);
-
-	/* TODO: compress if requested */
-	ndr_comp_rgbOut = ndr_uncomp_rgbOut;
-
-	/* Build RPC_HEADER_EXT header for MAPI response DATA blob */
-	RPC_HEADER_EXT.Version = 0x0000;
-	RPC_HEADER_EXT.Flags = RHEF_Last;
-	RPC_HEADER_EXT.Flags |= (mapi2k7_request.header.Flags & RHEF_XorMagic);
-	RPC_HEADER_EXT.Size = ndr_comp_rgbOut->offset;
-	RPC_HEADER_EXT.SizeActual = ndr_comp_rgbOut->offset;
+	/* Push MAPI response as chained extended buffers, compressed
+	 * and/or obfuscated as requested by the client */
+	flags = mapi2k7_request.header.Flags & (RHEF_Compressed|RHEF_XorMagic);
 
-	/* Obfuscate content if applicable*/
-	if (RPC_HEADER_EXT.Flags & RHEF_XorMagic) {
-		obfuscate_data(ndr_comp_rgbOut->data, ndr_comp_rgbOut->offset, 0xA5);
-	}
-
-	/* Push the constructed blob */
 	ndr_rgbOut = ndr_push_init_ctx(mem_ctx);
 	ndr_set_flags(&ndr_rgbOut->flags, LIBNDR_FLAG_NOALIGN);
-	ndr_push_RPC_HEADER_EXT(ndr_rgbOut, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT);
-	ndr_push_bytes(ndr_rgbOut, ndr_comp_rgbOut->data, ndr_comp_rgbOut->offset);
+	ndr_err = emsmdbp_push_mapi_response_chain(mem_ctx, ndr_rgbOut, mapi_response, flags, max_rgbOut);
+	talloc_free(mapi_response);
+	if (ndr_err != NDR_ERR_SUCCESS) {
+		talloc_free(ndr_rgbOut);
+		*r->out.pulTransTime = pulTransTime;
+		if (ndr_err == NDR_ERR_BUFSIZE) {
+			DEBUG(1, ("exchange_emsmdb: EcDoRpcExt2 response exceeds %d bytes\n", max_rgbOut));
+			r->out.result = ecBufferTooSmall;
+			return ecBufferTooSmall;
+		}
+		DEBUG(1, ("exchange_emsmdb: EcDoRpcExt2 failed to push the response: %d\n", ndr_err));
+		r->out.result = MAPI_E_CALL_FAILED;
+		return MAPI_E_CALL_FAILED;
+	}
+
+	DEBUG(5, ("exchange_emsmdb: EcDoRpcExt2 compression: %"PRIu64"/%"PRIu64" buffers, %"PRIu64" -> %"PRIu64" bytes in %"PRIu64" usec\n",
+		  emsmdb_compression_stats.compressed_buffers, emsmdb_compression_stats.buffers,
+		  emsmdb_compression_stats.bytes_in, emsmdb_compression_stats.bytes_out,
+		  emsmdb_compression_stats.usec));
+	if (emsmdb_compression_stats.buffers - emsmdb_compression_summary_buffers >= EMSMDB_COMPRESS_SUMMARY_INTERVAL) {
+		emsmdb_compression_summary("periodic");
+	}
 
 	/* Push MAPI response into a DATA blob */
 	r->out.rgbOut = ndr_rgbOut->data;
@@ -1939,10 +2102,11 @@ static NTSTATUS dcesrv_exchange_emsmdb_dispatch(struct dcesrv_call_state *dce_ca
  */
 static NTSTATUS dcesrv_exchange_emsmdb_init(struct dcesrv_context *dce_ctx)
 {
+	const char	*spill_dir;
+
 	/* Initialize exchange_emsmdb session */
-	emsmdb_session = talloc_zero(dce_ctx, struct exchange_emsmdb_session);
-	if (!emsmdb_session) return NT_STATUS_NO_MEMORY;
-	emsmdb_session->session = NULL;
+	emsmdb_sessions = mpm_session_table_init((TALLOC_CTX *)dce_ctx, 0);
+	if (!emsmdb_sessions) return NT_STATUS_NO_MEMORY;
 
 	/* Open read/write context on OpenChange dispatcher database */
 	openchange_ldb_ctx = emsmdbp_openchange_ldb_init(dce_ctx->lp_ctx);
@@ -1950,6 +2114,14 @@ static NTSTATUS dcesrv_exchange_emsmdb_init(struct dcesrv_context *dce_ctx)
 		smb_panic("unable to initialize 'openchange.ldb' context");
 	}
 
+	/* Responses smaller than this are never compressed */
+	emsmdb_compress_threshold = lpcfg_parm_int(dce_ctx->lp_ctx, NULL, "dcerpc_mapiproxy", "compress_threshold", EMSMDB_COMPRESS_THRESHOLD);
+
+	/* Stream buffers larger than this are moved to a temporary file */
+	spill_dir = lpcfg_parm_string(dce_ctx->lp_ctx, NULL, "dcerpc_mapiproxy", "stream_spill_dir");
+	emsmdbp_stream_set_spill(lpcfg_parm_ulong(dce_ctx->lp_ctx, NULL, "dcerpc_mapiproxy", "stream_spill_size", EMSMDBP_STREAM_SPILL_SIZE),
+				 spill_dir ? talloc_strdup(dce_ctx, spill_dir) : NULL);
+
 	return NT_STATUS_OK;
 }
 
@@ -1973,6 +2145,8 @@ static NTSTATUS dcesrv_exchange_emsmdb_unbind(struct server_id server_id, uint32
 
 	DEBUG (0, ("dcesrv_exchange_emsmdb_unbind\n"));
 
+	emsmdb_compression_summary("unbind");
+
 	/* session = dcesrv_find_emsmdb_session_by_server_id(&server_id, context_id); */
 	/* if (session) { */
 	/* 	ret = mpm_session_release(session->session); */
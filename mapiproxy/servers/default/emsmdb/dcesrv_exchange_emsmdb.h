@@ -54,6 +54,8 @@ struct emsmdbp_context {
 	struct ldb_context			*samdb_ctx;
 	struct mapistore_context		*mstore_ctx;
 	struct mapi_handles_context		*handles_ctx;
+	struct emsmdbp_search_folder		*searches;
+	struct emsmdbp_folder_cache		*folder_cache;
 
 	TALLOC_CTX				*mem_ctx;
 };
@@ -62,13 +64,16 @@ struct exchange_emsmdb_session {
 	uint32_t			pullTimeStamp;
 	struct mpm_session		*session;
         struct GUID                     uuid;
-	struct exchange_emsmdb_session	*prev;
-	struct exchange_emsmdb_session	*next;
 };
 
+struct emsmdbp_stream_spill;
+
+/* buffer.data is only owned by the stream when allocated is not 0 */
 struct emsmdbp_stream {
-	size_t			position;
-	DATA_BLOB		buffer;
+	size_t				position;
+	DATA_BLOB			buffer;
+	size_t				allocated;
+	struct emsmdbp_stream_spill	*spill;
 };
 
 struct emsmdbp_syncconfigure_request {
@@ -148,6 +153,7 @@ struct emsmdbp_object_table {
 	uint32_t				numerator;
 	uint32_t				denominator;
         struct mapistore_subscription_list	*subscription_list;
+	bool					search;		/* contents table of a search folder */
 };
 
 struct emsmdbp_object_stream {
@@ -237,10 +243,113 @@ struct emsmdbp_object {
 	struct emsmdbp_stream_data      *stream_data;
 };
 
+enum emsmdbp_restriction_class {
+	EMSMDBP_RESTRICTION_NONE = 0,
+	EMSMDBP_RESTRICTION_INTEGER,
+	EMSMDBP_RESTRICTION_DOUBLE,
+	EMSMDBP_RESTRICTION_STRING,
+	EMSMDBP_RESTRICTION_BINARY
+};
+
+struct emsmdbp_restriction_value {
+	enum emsmdbp_restriction_class	type;
+	int64_t				i;
+	double				dbl;
+	const uint8_t			*data;
+	size_t				length;
+};
+
+/* node of a compiled restriction, see emsmdbp_restriction.c */
+struct emsmdbp_restriction_node {
+	uint8_t					rt;
+	uint8_t					relop;
+	uint32_t				fuzzy;
+	uint32_t				count;		/* children of RES_AND, RES_OR, RES_NOT and RES_COMMENT */
+	uint32_t				next;		/* index of the node following this subtree */
+	uint16_t				column;
+	uint16_t				column2;
+	uint32_t				mask;		/* RES_BITMASK mask or RES_SIZE size */
+	struct emsmdbp_restriction_value	value;
+};
+
+struct emsmdbp_restriction {
+	uint32_t				count;
+	struct emsmdbp_restriction_node		*nodes;
+	struct SPropTagArray			*columns;
+};
+
+struct emsmdbp_search_result {
+	uint64_t			mid;
+	uint64_t			fid;
+};
+
+struct emsmdbp_search_folder {
+	uint64_t			folderID;
+	uint32_t			search_flags;	/* flags of the last SetSearchCriteria */
+	uint32_t			state;		/* SEARCH_* flags returned by GetSearchCriteria */
+	DATA_BLOB			criteria;	/* NDR encoded restriction */
+	struct emsmdbp_restriction	*restriction;
+	uint16_t			scope_count;
+	uint64_t			*scope;		/* folders set by the client */
+	uint32_t			folders_count;
+	uint64_t			*folders;	/* searched folders, sorted */
+	uint32_t			pending_count;
+	uint64_t			*pending;	/* folders left to populate */
+	uint32_t			results_count;
+	uint32_t			results_size;
+	struct emsmdbp_search_result	*results;	/* matching messages, sorted by mid */
+
+	/* population state */
+	struct emsmdbp_object		*mailbox;
+	struct emsmdbp_object		*table;
+	uint64_t			table_fid;
+	uint32_t			table_row;
+
+	struct emsmdbp_search_folder	*prev;
+	struct emsmdbp_search_folder	*next;
+};
+
+struct emsmdbp_folder_cache_entry {
+	struct emsmdbp_folder_cache		*cache;
+	uint64_t				fid;
+	uint64_t				parent_fid;
+	bool					uri_known;
+	char					*mapistore_uri;	/* NULL for folders rooting no context */
+	struct emsmdbp_folder_cache_entry	*next;
+};
+
+/* folder ancestry cache, see emsmdbp_folder_cache.c */
+struct emsmdbp_folder_cache {
+	struct emsmdbp_folder_cache_entry	**buckets;
+	uint32_t				size;
+	uint32_t				count;
+};
+
+#define	EMSMDBP_FOLDER_CACHE_BUCKETS	1024
+#define	EMSMDBP_FOLDER_CACHE_MAX	16384
+
 #define	EMSMDB_PCMSPOLLMAX		60000
 #define	EMSMDB_PCRETRY			6
 #define	EMSMDB_PCRETRYDELAY		10000
 
+/* default minimum size of a response worth compressing */
+#define	EMSMDB_COMPRESS_THRESHOLD	1024
+
+/* number of extended buffers between two compression summaries */
+#define	EMSMDB_COMPRESS_SUMMARY_INTERVAL	1000
+
+/* initial capacity of a stream buffer */
+#define	EMSMDBP_STREAM_MIN_ALLOC	4096
+
+/* default size above which stream buffers move to a temporary file, 0 disables */
+#define	EMSMDBP_STREAM_SPILL_SIZE	(8 * 1024 * 1024)
+
+/* maximum number of table rows requested from a backend at once */
+#define	EMSMDBP_TABLE_ROWS_BATCH	128
+
+/* messages read by background search folder population per EcDoRpc call */
+#define	EMSMDBP_SEARCH_ROWS_SLICE	512
+
 enum emsmdbp_mailbox_systemidx {
 	EMSMDBP_MAILBOX_ROOT = 1,
 	EMSMDBP_DEFERRED_ACTION,
@@ -335,6 +444,7 @@ struct emsmdbp_object *emsmdbp_folder_open_table(TALLOC_CTX *, struct emsmdbp_ob
 struct emsmdbp_object *emsmdbp_object_table_init(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *);
 int emsmdbp_object_table_get_available_properties(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, struct SPropTagArray **);
 void **emsmdbp_object_table_get_row_props(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, uint32_t, enum mapistore_query_type, enum MAPISTATUS **);
+void ***emsmdbp_object_table_get_rows_props(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, uint32_t, uint32_t, enum mapistore_query_type, enum MAPISTATUS ***);
 struct emsmdbp_object *emsmdbp_object_message_init(TALLOC_CTX *, struct emsmdbp_context *, uint64_t, struct emsmdbp_object *);
 enum mapistore_error emsmdbp_object_message_open(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, uint64_t, uint64_t, bool, struct emsmdbp_object **, struct mapistore_message **);
 struct emsmdbp_object *emsmdbp_object_message_open_attachment_table(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *);
@@ -350,9 +460,46 @@ struct emsmdbp_object *emsmdbp_object_ftcontext_init(TALLOC_CTX *, struct emsmdb
 struct emsmdbp_stream_data *emsmdbp_stream_data_from_value(TALLOC_CTX *, enum MAPITAGS, void *value, bool);
 struct emsmdbp_stream_data *emsmdbp_object_get_stream_data(struct emsmdbp_object *, enum MAPITAGS);
 DATA_BLOB emsmdbp_stream_read_buffer(struct emsmdbp_stream *, uint32_t);
-void emsmdbp_stream_write_buffer(TALLOC_CTX *, struct emsmdbp_stream *, DATA_BLOB);
+enum MAPISTATUS emsmdbp_stream_write_buffer(TALLOC_CTX *, struct emsmdbp_stream *, DATA_BLOB);
+void emsmdbp_stream_release(struct emsmdbp_stream *);
+void emsmdbp_stream_set_spill(size_t, const char *);
 void emsmdbp_fill_table_row_blob(TALLOC_CTX *, struct emsmdbp_context *, DATA_BLOB *, uint16_t, enum MAPITAGS *, void **, enum MAPISTATUS *);
 void emsmdbp_fill_row_blob(TALLOC_CTX *, struct emsmdbp_context *, uint8_t *, DATA_BLOB *,struct SPropTagArray *, void **, enum MAPISTATUS *, bool *);
+bool emsmdbp_object_is_search_folder(struct emsmdbp_object *);
+struct emsmdbp_search_folder *emsmdbp_object_search_open(struct emsmdbp_object *);
+enum MAPISTATUS emsmdbp_object_search_populate(struct emsmdbp_context *, struct emsmdbp_search_folder *, uint32_t, uint32_t *);
+void emsmdbp_object_search_run(struct emsmdbp_context *, uint32_t);
+void emsmdbp_object_search_notify(struct emsmdbp_context *, struct mapistore_notification *);
+void emsmdbp_object_search_message_notify(struct emsmdbp_context *, enum mapistore_notification_type, uint64_t, uint64_t, uint64_t, uint64_t);
+void emsmdbp_object_search_table_refresh(struct emsmdbp_object *);
+
+/* definitions from emsmdbp_restriction.c */
+struct emsmdbp_restriction	*emsmdbp_restriction_compile(TALLOC_CTX *, struct mapi_SRestriction *);
+bool				emsmdbp_restriction_match(struct emsmdbp_restriction *, void **, enum MAPISTATUS *);
+
+/* definitions from emsmdbp_folder_cache.c */
+struct emsmdbp_folder_cache		*emsmdbp_folder_cache_init(TALLOC_CTX *);
+void					emsmdbp_folder_cache_flush(struct emsmdbp_folder_cache *);
+struct emsmdbp_folder_cache_entry	*emsmdbp_folder_cache_get(struct emsmdbp_folder_cache *, uint64_t);
+struct emsmdbp_folder_cache_entry	*emsmdbp_folder_cache_add(struct emsmdbp_folder_cache *, uint64_t, uint64_t);
+void					emsmdbp_folder_cache_set_uri(struct emsmdbp_folder_cache_entry *, const char *);
+void					emsmdbp_folder_cache_del(struct emsmdbp_folder_cache *, uint64_t);
+void					emsmdbp_folder_cache_notify(struct emsmdbp_folder_cache *, struct mapistore_notification *);
+
+/* definitions from emsmdbp_search.c */
+struct emsmdbp_search_folder	*emsmdbp_search_find(struct emsmdbp_context *, uint64_t);
+struct emsmdbp_search_folder	*emsmdbp_search_add(struct emsmdbp_context *, uint64_t);
+void				emsmdbp_search_del(struct emsmdbp_context *, uint64_t);
+bool				emsmdbp_search_has_folder(struct emsmdbp_search_folder *, uint64_t);
+bool				emsmdbp_search_add_folder(struct emsmdbp_search_folder *, uint64_t);
+void				emsmdbp_search_del_folder(struct emsmdbp_search_folder *, uint64_t);
+bool				emsmdbp_search_next_folder(struct emsmdbp_search_folder *, uint64_t *);
+bool				emsmdbp_search_add_result(struct emsmdbp_search_folder *, uint64_t, uint64_t);
+bool				emsmdbp_search_del_result(struct emsmdbp_search_folder *, uint64_t);
+struct emsmdbp_search_result	*emsmdbp_search_get_result(struct emsmdbp_search_folder *, uint32_t);
+void				emsmdbp_search_restart(struct emsmdbp_search_folder *);
+void				emsmdbp_search_stop(struct emsmdbp_search_folder *);
+enum MAPISTATUS			emsmdbp_search_set_criteria(struct emsmdbp_search_folder *, struct mapi_SRestriction *, uint16_t, uint64_t *, uint32_t);
 
 /* definitions from oxcfold.c */
 enum MAPISTATUS EcDoRpc_RopOpenFolder(TALLOC_CTX *, struct emsmdbp_context *, struct EcDoRpc_MAPI_REQ *, struct EcDoRpc_MAPI_REPL *, uint32_t *, uint16_t *);
@@ -158,6 +158,14 @@ _PUBLIC_ struct emsmdbp_context *emsmdbp_init(struct loadparm_context *lp_ctx,
 	}
 	talloc_set_destructor((void *)emsmdbp_ctx->handles_ctx, (int (*)(void *))emsmdbp_mapi_handles_destructor);
 
+	/* Initialize the folder ancestry cache */
+	emsmdbp_ctx->folder_cache = emsmdbp_folder_cache_init(mem_ctx);
+	if (!emsmdbp_ctx->folder_cache) {
+		DEBUG(0, ("[%s:%d]: Folder cache initialization failed\n", __FUNCTION__, __LINE__));
+		talloc_free(mem_ctx);
+		return NULL;
+	}
+
 	return emsmdbp_ctx;
 }
 
@@ -0,0 +1,264 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_folder_cache.c
+
+   \brief Folder ancestry cache
+
+   Opening a folder by identifier walks up to the mailbox root to
+   find its parents, each step costing openchangedb searches and,
+   for mapistore folders, indexing lookups and URI manipulations.
+   The cache records for each folder met during the session its
+   parent folder and, for folders living in openchangedb, the
+   mapistore URI of the context they root (or the fact that they root
+   none).
+
+   Entries are added when folders are opened or created and when
+   hierarchy tables are read, and are dropped when folders are moved
+   or deleted, whether by the session or as notified by mapistore.
+
+   The cache belongs to the session rather than to a mailbox: folder
+   identifiers are allocated from the server-wide GlobalCount, so they
+   do not collide between the mailboxes a session opens.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/libmapistore/mapistore.h"
+
+#include "dcesrv_exchange_emsmdb.h"
+
+static uint32_t emsmdbp_folder_cache_hash(uint64_t fid)
+{
+	/* the counter part of folder identifiers is in the high bytes */
+	fid ^= fid >> 32;
+	fid ^= fid >> 16;
+
+	return (uint32_t) (fid * 0x9E3779B1);
+}
+
+static struct emsmdbp_folder_cache_entry **emsmdbp_folder_cache_bucket(struct emsmdbp_folder_cache *cache, uint64_t fid)
+{
+	return &cache->buckets[emsmdbp_folder_cache_hash(fid) & (cache->size - 1)];
+}
+
+/**
+   \details Initialize the folder ancestry cache
+
+   \param mem_ctx pointer to the memory context
+
+   \return Allocated folder cache on success, otherwise NULL
+ */
+_PUBLIC_ struct emsmdbp_folder_cache *emsmdbp_folder_cache_init(TALLOC_CTX *mem_ctx)
+{
+	struct emsmdbp_folder_cache	*cache;
+
+	cache = talloc_zero(mem_ctx, struct emsmdbp_folder_cache);
+	if (!cache) return NULL;
+
+	cache->size = EMSMDBP_FOLDER_CACHE_BUCKETS;
+	cache->buckets = talloc_zero_array(cache, struct emsmdbp_folder_cache_entry *, cache->size);
+	if (!cache->buckets) {
+		talloc_free(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+/**
+   \details Drop every entry of the cache
+
+   \param cache pointer to the folder cache
+ */
+_PUBLIC_ void emsmdbp_folder_cache_flush(struct emsmdbp_folder_cache *cache)
+{
+	uint32_t	i;
+
+	if (!cache) return;
+
+	for (i = 0; i < cache->size; i++) {
+		while (cache->buckets[i]) {
+			talloc_free(cache->buckets[i]);
+		}
+	}
+	cache->count = 0;
+}
+
+/**
+   \details Find the cache entry of a folder
+
+   \param cache pointer to the folder cache
+   \param fid the folder identifier
+
+   \return the entry on success, otherwise NULL
+ */
+_PUBLIC_ struct emsmdbp_folder_cache_entry *emsmdbp_folder_cache_get(struct emsmdbp_folder_cache *cache, uint64_t fid)
+{
+	struct emsmdbp_folder_cache_entry	*entry;
+
+	if (!cache) return NULL;
+
+	for (entry = *emsmdbp_folder_cache_bucket(cache, fid); entry; entry = entry->next) {
+		if (entry->fid == fid) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static int emsmdbp_folder_cache_entry_destructor(struct emsmdbp_folder_cache_entry *entry)
+{
+	struct emsmdbp_folder_cache_entry	**bucket;
+
+	bucket = emsmdbp_folder_cache_bucket(entry->cache, entry->fid);
+	while (*bucket && *bucket != entry) {
+		bucket = &(*bucket)->next;
+	}
+	if (*bucket) {
+		*bucket = entry->next;
+		entry->cache->count--;
+	}
+
+	return 0;
+}
+
+/**
+   \details Record the parent of a folder. The mapistore URI known
+   for the folder is kept unless its parent changed.
+
+   \param cache pointer to the folder cache
+   \param fid the folder identifier
+   \param parent_fid the identifier of the parent folder, 0 for a
+   root folder
+
+   \return the entry on success, otherwise NULL
+ */
+_PUBLIC_ struct emsmdbp_folder_cache_entry *emsmdbp_folder_cache_add(struct emsmdbp_folder_cache *cache, uint64_t fid, uint64_t parent_fid)
+{
+	struct emsmdbp_folder_cache_entry	**bucket;
+	struct emsmdbp_folder_cache_entry	*entry;
+
+	if (!cache || !fid) return NULL;
+
+	bucket = emsmdbp_folder_cache_bucket(cache, fid);
+	for (entry = *bucket; entry; entry = entry->next) {
+		if (entry->fid == fid) {
+			if (entry->parent_fid != parent_fid) {
+				entry->parent_fid = parent_fid;
+				talloc_free(entry->mapistore_uri);
+				entry->mapistore_uri = NULL;
+				entry->uri_known = false;
+			}
+			return entry;
+		}
+	}
+
+	/* folders of very large hierarchies are looked up again */
+	if (cache->count >= EMSMDBP_FOLDER_CACHE_MAX) {
+		DEBUG(5, ("[%s:%d]: folder cache is full, flushing it\n", __FUNCTION__, __LINE__));
+		emsmdbp_folder_cache_flush(cache);
+	}
+
+	entry = talloc_zero(cache, struct emsmdbp_folder_cache_entry);
+	if (!entry) return NULL;
+
+	entry->cache = cache;
+	entry->fid = fid;
+	entry->parent_fid = parent_fid;
+	entry->next = *bucket;
+	*bucket = entry;
+	cache->count++;
+	talloc_set_destructor(entry, emsmdbp_folder_cache_entry_destructor);
+
+	return entry;
+}
+
+/**
+   \details Record the mapistore URI rooted by a folder
+
+   \param entry pointer to the folder cache entry
+   \param uri the mapistore URI, NULL if the folder roots no
+   mapistore context
+ */
+_PUBLIC_ void emsmdbp_folder_cache_set_uri(struct emsmdbp_folder_cache_entry *entry, const char *uri)
+{
+	if (!entry) return;
+
+	talloc_free(entry->mapistore_uri);
+	entry->mapistore_uri = uri ? talloc_strdup(entry, uri) : NULL;
+	entry->uri_known = (!uri || entry->mapistore_uri);
+}
+
+/**
+   \details Drop a folder from the cache. The entries of its
+   subfolders stay valid: identifiers are never reused and their
+   parent does not change.
+
+   \param cache pointer to the folder cache
+   \param fid the folder identifier
+ */
+_PUBLIC_ void emsmdbp_folder_cache_del(struct emsmdbp_folder_cache *cache, uint64_t fid)
+{
+	struct emsmdbp_folder_cache_entry	*entry;
+
+	if (!cache) return;
+
+	for (entry = *emsmdbp_folder_cache_bucket(cache, fid); entry; entry = entry->next) {
+		if (entry->fid == fid) {
+			talloc_free(entry);
+			return;
+		}
+	}
+}
+
+/**
+   \details Update the cache with a mapistore folder notification
+
+   \param cache pointer to the folder cache
+   \param notification pointer to the notification
+ */
+_PUBLIC_ void emsmdbp_folder_cache_notify(struct emsmdbp_folder_cache *cache, struct mapistore_notification *notification)
+{
+	struct mapistore_object_notification_parameters	*parameters;
+
+	if (!cache || !notification || notification->object_type != MAPISTORE_FOLDER) return;
+
+	parameters = &notification->parameters.object_parameters;
+	switch (notification->event) {
+	case MAPISTORE_OBJECT_CREATED:
+		emsmdbp_folder_cache_add(cache, parameters->object_id, parameters->folder_id);
+		break;
+	case MAPISTORE_OBJECT_MOVED:
+		emsmdbp_folder_cache_del(cache, parameters->old_object_id);
+		if (parameters->object_id != parameters->old_object_id) {
+			emsmdbp_folder_cache_del(cache, parameters->object_id);
+		}
+		break;
+	case MAPISTORE_OBJECT_DELETED:
+		emsmdbp_folder_cache_del(cache, parameters->object_id);
+		break;
+	default:
+		break;
+	}
+}
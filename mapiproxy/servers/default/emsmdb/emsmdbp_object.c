@@ -26,7 +26,10 @@
  */
 
 #include <ctype.h>
+#include <fcntl.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "mapiproxy/dcesrv_mapiproxy.h"
 #include "mapiproxy/libmapiproxy/libmapiproxy.h"
@@ -375,6 +378,7 @@ _PUBLIC_ enum MAPISTATUS emsmdbp_object_create_folder(struct emsmdbp_context *em
 			abort();
 		}
 	}
+	emsmdbp_folder_cache_add(emsmdbp_ctx->folder_cache, fid, parent_folder->object.folder->folderID);
 	*new_folderp = new_folder;
 
 	return MAPI_E_SUCCESS;
@@ -390,6 +394,7 @@ _PUBLIC_ enum mapistore_error emsmdbp_object_open_folder(TALLOC_CTX *mem_ctx, st
 	uint32_t				contextID;
 	uint64_t				parent_fid, oc_parent_fid;
 	void					*local_ctx;
+	struct emsmdbp_folder_cache_entry	*entry;
 
 	folder_object = emsmdbp_object_folder_init(mem_ctx, emsmdbp_ctx, fid, parent);
 	if (emsmdbp_is_mapistore(parent)) {
@@ -399,11 +404,39 @@ _PUBLIC_ enum mapistore_error emsmdbp_object_open_folder(TALLOC_CTX *mem_ctx, st
 			talloc_free(folder_object);
 			return retval;
 		}
+		emsmdbp_folder_cache_add(emsmdbp_ctx->folder_cache, fid, parent->object.folder->folderID);
 	}
 	else {
 		local_ctx = talloc_zero(NULL, void);
-	
-		retval = openchangedb_get_mapistoreURI(local_ctx, emsmdbp_ctx->oc_ctx, fid, &path, true);
+
+		switch (parent->type) {
+		case EMSMDBP_OBJECT_MAILBOX:
+			parent_fid = parent->object.mailbox->folderID;
+			break;
+		case EMSMDBP_OBJECT_FOLDER:
+			parent_fid = parent->object.folder->folderID;
+			break;
+		default:
+			DEBUG(5, ("you should never get here\n"));
+			abort();
+		}
+
+		/* the mapistore URI of openchangedb folders is looked up once */
+		entry = emsmdbp_folder_cache_get(emsmdbp_ctx->folder_cache, fid);
+		if (entry && entry->uri_known) {
+			path = talloc_strdup(local_ctx, entry->mapistore_uri);
+			retval = MAPISTORE_SUCCESS;
+		}
+		else {
+			retval = openchangedb_get_mapistoreURI(local_ctx, emsmdbp_ctx->oc_ctx, fid, &path, true);
+			if (retval == MAPISTORE_SUCCESS) {
+				if (!entry && path) {
+					entry = emsmdbp_folder_cache_add(emsmdbp_ctx->folder_cache, fid, parent_fid);
+				}
+				emsmdbp_folder_cache_set_uri(entry, path);
+			}
+		}
+
 		if (retval == MAPISTORE_SUCCESS && path) {
 			folder_object->object.folder->mapistore_root = true;
 			/* system/special folder */
@@ -426,30 +459,25 @@ _PUBLIC_ enum mapistore_error emsmdbp_object_open_folder(TALLOC_CTX *mem_ctx, st
 			/* (void) talloc_reference(folder_object, folder_object->backend_object); */
 		}
 		else {
-			switch (parent->type) {
-			case EMSMDBP_OBJECT_MAILBOX:
-				parent_fid = parent->object.mailbox->folderID;
-				break;
-			case EMSMDBP_OBJECT_FOLDER:
-				parent_fid = parent->object.folder->folderID;
-				break;
-			default:
-				DEBUG(5, ("you should never get here\n"));
-				abort();
-			}
-			mailbox_object = emsmdbp_get_mailbox(parent);
-			ret = openchangedb_get_parent_fid(emsmdbp_ctx->oc_ctx, fid, &oc_parent_fid, mailbox_object->object.mailbox->mailboxstore);
-			if (ret != MAPI_E_SUCCESS) {
-				DEBUG(0, ("folder %.16"PRIx64" or %.16"PRIx64" does not exist\n", parent_fid, fid));
-				talloc_free(local_ctx);
-				talloc_free(folder_object);
-				return MAPISTORE_ERR_NOT_FOUND;
-			}
-			if (oc_parent_fid != parent_fid) {
-				DEBUG(0, ("parent folder mismatch: expected %.16"PRIx64" but got %.16"PRIx64"\n", parent_fid, oc_parent_fid));
-				talloc_free(local_ctx);
-				talloc_free(folder_object);
-				return MAPISTORE_ERR_NOT_FOUND;
+			if (!entry || entry->parent_fid != parent_fid) {
+				mailbox_object = emsmdbp_get_mailbox(parent);
+				ret = openchangedb_get_parent_fid(emsmdbp_ctx->oc_ctx, fid, &oc_parent_fid, mailbox_object->object.mailbox->mailboxstore);
+				if (ret != MAPI_E_SUCCESS) {
+					DEBUG(0, ("folder %.16"PRIx64" or %.16"PRIx64" does not exist\n", parent_fid, fid));
+					talloc_free(local_ctx);
+					talloc_free(folder_object);
+					return MAPISTORE_ERR_NOT_FOUND;
+				}
+				if (oc_parent_fid != parent_fid) {
+					DEBUG(0, ("parent folder mismatch: expected %.16"PRIx64" but got %.16"PRIx64"\n", parent_fid, oc_parent_fid));
+					talloc_free(local_ctx);
+					talloc_free(folder_object);
+					return MAPISTORE_ERR_NOT_FOUND;
+				}
+				entry = emsmdbp_folder_cache_add(emsmdbp_ctx->folder_cache, fid, parent_fid);
+				if (retval == MAPISTORE_SUCCESS) {
+					emsmdbp_folder_cache_set_uri(entry, NULL);
+				}
 			}
 			DEBUG(0, ("%s: opening openchangedb folder\n", __FUNCTION__));
 		}
@@ -513,10 +541,17 @@ static char *emsmdbp_compute_parent_uri(TALLOC_CTX *mem_ctx, char *uri)
 
 static int emsmdbp_get_parent_fid(struct emsmdbp_context *emsmdbp_ctx, uint64_t fid, uint64_t *parent_fidp)
 {
-	TALLOC_CTX	*mem_ctx;
-	int		retval = MAPISTORE_SUCCESS;
-	bool		soft_deleted;
-	char		*uri, *parent_uri;
+	TALLOC_CTX				*mem_ctx;
+	int					retval = MAPISTORE_SUCCESS;
+	bool					soft_deleted;
+	char					*uri, *parent_uri;
+	struct emsmdbp_folder_cache_entry	*entry;
+
+	entry = emsmdbp_folder_cache_get(emsmdbp_ctx->folder_cache, fid);
+	if (entry) {
+		*parent_fidp = entry->parent_fid;
+		return MAPISTORE_SUCCESS;
+	}
 
 	mem_ctx = talloc_zero(NULL, void);
 	retval = openchangedb_get_parent_fid(emsmdbp_ctx->oc_ctx, fid, parent_fidp, true);
@@ -542,6 +577,10 @@ static int emsmdbp_get_parent_fid(struct emsmdbp_context *emsmdbp_ctx, uint64_t
 end:
 	talloc_free(mem_ctx);
 
+	if (retval == MAPISTORE_SUCCESS) {
+		emsmdbp_folder_cache_add(emsmdbp_ctx->folder_cache, fid, *parent_fidp);
+	}
+
 	return retval;
 }
 
@@ -560,6 +599,7 @@ _PUBLIC_ enum mapistore_error emsmdbp_object_open_folder_by_fid(TALLOC_CTX *mem_
 	uint64_t		parent_fid;
 	int			retval;
 	struct emsmdbp_object	*parent_object;
+	bool			cached;
 	
 	if ((context_object->type == EMSMDBP_OBJECT_MAILBOX
 	     && fid == context_object->object.mailbox->folderID)
@@ -576,22 +616,33 @@ _PUBLIC_ enum mapistore_error emsmdbp_object_open_folder_by_fid(TALLOC_CTX *mem_
 		}
 	}
 
+	cached = (emsmdbp_folder_cache_get(emsmdbp_ctx->folder_cache, fid) != NULL);
 	retval = emsmdbp_get_parent_fid(emsmdbp_ctx, fid, &parent_fid);
 	if (retval == MAPISTORE_SUCCESS) {
 		if (parent_fid) {
 			retval = emsmdbp_object_open_folder_by_fid(mem_ctx, emsmdbp_ctx, context_object, parent_fid, &parent_object);
-			if (retval != MAPISTORE_SUCCESS) {
-				return retval;
+			if (retval == MAPISTORE_SUCCESS) {
+				retval = emsmdbp_object_open_folder(mem_ctx, emsmdbp_ctx, parent_object, fid, folder_object_p);
 			}
-			return emsmdbp_object_open_folder(mem_ctx, emsmdbp_ctx, parent_object, fid, folder_object_p);
 		}
 		else {
 			*folder_object_p = emsmdbp_object_folder_init(mem_ctx, emsmdbp_ctx, fid, NULL);
 			return MAPISTORE_SUCCESS;
 		}
 	}
+	else {
+		retval = MAPISTORE_ERROR;
+	}
+
+	/* the cached parent may be stale (e.g. a move we were not
+	   notified of): look it up again, once */
+	if (retval != MAPISTORE_SUCCESS && cached) {
+		DEBUG(5, ("[%s:%d]: opening folder 0x%.16"PRIx64" under its cached parent failed, retrying\n", __FUNCTION__, __LINE__, fid));
+		emsmdbp_folder_cache_del(emsmdbp_ctx->folder_cache, fid);
+		return emsmdbp_object_open_folder_by_fid(mem_ctx, emsmdbp_ctx, context_object, fid, folder_object_p);
+	}
 
-	return MAPISTORE_ERROR;
+	return retval;
 }
 
 _PUBLIC_ int emsmdbp_object_stream_commit(struct emsmdbp_object *stream_object)
@@ -1232,6 +1283,7 @@ _PUBLIC_ enum mapistore_error emsmdbp_folder_move_folder(struct emsmdbp_context
 	}
 
 	contextID = emsmdbp_get_contextID(move_folder);
+	emsmdbp_folder_cache_del(emsmdbp_ctx->folder_cache, move_folder->object.folder->folderID);
 	ret = mapistore_folder_move_folder(emsmdbp_ctx->mstore_ctx, contextID, move_folder->backend_object, target_folder->backend_object, mem_ctx, new_name);
 	if (move_folder->object.folder->mapistore_root) {
 		retval = openchangedb_delete_folder(emsmdbp_ctx->oc_ctx, move_folder->object.folder->folderID);
@@ -1308,6 +1360,10 @@ _PUBLIC_ enum mapistore_error emsmdbp_folder_delete(struct emsmdbp_context *emsm
 		}
 	}
 
+	/* a deleted search folder stops searching */
+	emsmdbp_search_del(emsmdbp_ctx, fid);
+	emsmdbp_folder_cache_del(emsmdbp_ctx->folder_cache, fid);
+
 	ret = MAPISTORE_SUCCESS;
 
 end:
@@ -1338,7 +1394,13 @@ _PUBLIC_ struct emsmdbp_object *emsmdbp_folder_open_table(TALLOC_CTX *mem_ctx,
 	if (table_object) {
 		table_object->object.table->handle = handle_id;
 		table_object->object.table->ulType = table_type;
-		if (emsmdbp_is_mapistore(parent_object)) {
+		if (table_type == MAPISTORE_MESSAGE_TABLE && parent_object->type == EMSMDBP_OBJECT_FOLDER
+		    && emsmdbp_search_find(parent_object->emsmdbp_ctx, parent_object->object.folder->folderID)) {
+			/* search folders list the results of their search, not their own messages */
+			table_object->object.table->search = true;
+			emsmdbp_object_search_table_refresh(table_object);
+		}
+		else if (emsmdbp_is_mapistore(parent_object)) {
 			switch (table_type) {
 			case MAPISTORE_MESSAGE_TABLE:
 				mstore_type = MAPISTORE_MESSAGE_TABLE;
@@ -1478,7 +1540,11 @@ _PUBLIC_ int emsmdbp_object_table_get_available_properties(TALLOC_CTX *mem_ctx,
 		return MAPISTORE_ERROR;
 	}
 
-	if (emsmdbp_is_mapistore(table_object)) {
+	if (table_object->object.table->search) {
+		/* rows come from messages of many folders */
+		retval = MAPISTORE_ERR_NOT_FOUND;
+	}
+	else if (emsmdbp_is_mapistore(table_object)) {
 		contextID = emsmdbp_get_contextID(table_object);
 		retval = mapistore_table_get_available_properties(emsmdbp_ctx->mstore_ctx, contextID, table_object->backend_object, mem_ctx, propertiesp);
 	}
@@ -1537,6 +1603,87 @@ _PUBLIC_ int emsmdbp_object_table_get_available_properties(TALLOC_CTX *mem_ctx,
 	return retval;
 }
 
+/**
+   \details Retrieve the properties of a row of a search folder
+   contents table, read from the message of the matching result
+
+   \param mem_ctx pointer to the memory context
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param table_object pointer to the search contents table
+   \param row_id the row to retrieve
+   \param retvalsp pointer on the array of per-property status
+
+   \return the array of property values on success, otherwise NULL
+ */
+static void **emsmdbp_object_search_get_row_props(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, uint32_t row_id, enum MAPISTATUS **retvalsp)
+{
+	struct emsmdbp_object_table	*table;
+	struct emsmdbp_search_folder	*search;
+	struct emsmdbp_search_result	*result;
+	struct emsmdbp_object		*message_object;
+	struct SPropTagArray		properties;
+	void				**data_pointers;
+	enum MAPISTATUS			*retvals;
+	uint64_t			*id;
+	uint32_t			*instance_num;
+	uint32_t			i;
+
+	table = table_object->object.table;
+	search = emsmdbp_search_find(emsmdbp_ctx, table_object->parent_object->object.folder->folderID);
+	if (!search || !search->mailbox) return NULL;
+
+	while (true) {
+		result = emsmdbp_search_get_result(search, row_id);
+		if (!result) return NULL;
+
+		if (emsmdbp_object_message_open(mem_ctx, emsmdbp_ctx, search->mailbox, result->fid, result->mid, false, &message_object, NULL) == MAPISTORE_SUCCESS) {
+			break;
+		}
+
+		/* the deletion was not notified, drop the result: the
+		   next result moves up to this row */
+		DEBUG(5, ("[%s:%d]: message 0x%.16"PRIx64" of the search folder is gone\n", __FUNCTION__, __LINE__, result->mid));
+		emsmdbp_search_del_result(search, result->mid);
+		emsmdbp_object_search_table_refresh(table_object);
+	}
+
+	properties.cValues = table->prop_count;
+	properties.aulPropTag = table->properties;
+	data_pointers = emsmdbp_object_get_properties(mem_ctx, emsmdbp_ctx, message_object, &properties, &retvals);
+	if (!data_pointers) {
+		talloc_free(message_object);
+		return NULL;
+	}
+	talloc_steal(data_pointers, message_object);
+
+	/* identifiers are known without asking the backend */
+	for (i = 0; i < table->prop_count; i++) {
+		switch (table->properties[i]) {
+		case PidTagMid:
+		case PidTagInstID:
+		case PidTagParentFolderId:
+			id = talloc(data_pointers, uint64_t);
+			*id = (table->properties[i] == PidTagParentFolderId) ? result->fid : result->mid;
+			data_pointers[i] = id;
+			retvals[i] = MAPI_E_SUCCESS;
+			break;
+		case PidTagInstanceNum:
+			instance_num = talloc_zero(data_pointers, uint32_t);
+			data_pointers[i] = instance_num;
+			retvals[i] = MAPI_E_SUCCESS;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (retvalsp) {
+		*retvalsp = retvals;
+	}
+
+	return data_pointers;
+}
+
 _PUBLIC_ void **emsmdbp_object_table_get_row_props(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, uint32_t row_id, enum mapistore_query_type query_type, enum MAPISTATUS **retvalsp)
 {
         void				**data_pointers;
@@ -1557,6 +1704,10 @@ _PUBLIC_ void **emsmdbp_object_table_get_row_props(TALLOC_CTX *mem_ctx, struct e
         table = table_object->object.table;
         num_props = table_object->object.table->prop_count;
 
+	if (table->search) {
+		return emsmdbp_object_search_get_row_props(mem_ctx, emsmdbp_ctx, table_object, row_id, retvalsp);
+	}
+
         data_pointers = talloc_array(mem_ctx, void *, num_props);
         memset(data_pointers, 0, sizeof(void *) * num_props);
         retvals = talloc_array(mem_ctx, enum MAPISTATUS, num_props);
@@ -1747,6 +1898,569 @@ _PUBLIC_ void **emsmdbp_object_table_get_row_props(TALLOC_CTX *mem_ctx, struct e
         return data_pointers;
 }
 
+/**
+   \details Record in the folder cache the parent of the folders
+   listed by the rows of a hierarchy table
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param table_object pointer to the hierarchy table object
+   \param rows the rows fetched from the table
+   \param retvals the property retvals of the rows
+   \param count the number of rows
+ */
+static void emsmdbp_object_table_cache_folders(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, void ***rows, enum MAPISTATUS **retvals, uint32_t count)
+{
+	struct emsmdbp_object_table	*table = table_object->object.table;
+	struct emsmdbp_object		*parent = table_object->parent_object;
+	uint64_t			parent_fid;
+	uint32_t			i, fid_column;
+
+	if (!emsmdbp_ctx->folder_cache || table->ulType != MAPISTORE_FOLDER_TABLE || !parent) return;
+
+	switch (parent->type) {
+	case EMSMDBP_OBJECT_MAILBOX:
+		parent_fid = parent->object.mailbox->folderID;
+		break;
+	case EMSMDBP_OBJECT_FOLDER:
+		parent_fid = parent->object.folder->folderID;
+		break;
+	default:
+		return;
+	}
+
+	for (fid_column = 0; fid_column < table->prop_count; fid_column++) {
+		if (table->properties[fid_column] == PR_FID) break;
+	}
+	if (fid_column == table->prop_count) return;
+
+	for (i = 0; i < count; i++) {
+		if (rows[i] && retvals[i] && retvals[i][fid_column] == MAPI_E_SUCCESS && rows[i][fid_column]) {
+			emsmdbp_folder_cache_add(emsmdbp_ctx->folder_cache, *(uint64_t *) rows[i][fid_column], parent_fid);
+		}
+	}
+}
+
+/**
+   \details Retrieve the properties of a range of table rows
+
+   Mapistore tables are fetched with a single backend get_rows call and
+   the data pointers of every row share one allocation. Openchangedb
+   tables are still fetched row by row.
+
+   \param mem_ctx pointer to the memory context
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param table_object pointer to the table object
+   \param row_id the index of the first row to fetch
+   \param count the number of rows to fetch
+   \param query_type the type of query to run
+   \param retvalsp pointer to the per-row property status arrays to
+   return, allocated as a child of the returned array
+
+   \return an array of count data pointers arrays on success, where
+   rows which could not be fetched (e.g. filtered out by a restriction)
+   are NULL, otherwise NULL
+ */
+_PUBLIC_ void ***emsmdbp_object_table_get_rows_props(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, uint32_t row_id, uint32_t count, enum mapistore_query_type query_type, enum MAPISTATUS ***retvalsp)
+{
+	void				***rows;
+	void				**data_pointers;
+	enum MAPISTATUS			**retvals;
+	enum MAPISTATUS			*row_retvals;
+	struct mapistore_property_data	**properties;
+	struct mapistore_property_data	*row;
+	uint32_t			contextID, num_props, i, j;
+
+	if (!count) {
+		return NULL;
+	}
+
+	num_props = table_object->object.table->prop_count;
+
+	rows = talloc_zero_array(mem_ctx, void **, count);
+	if (!rows) {
+		return NULL;
+	}
+	retvals = talloc_zero_array(rows, enum MAPISTATUS *, count);
+	if (!retvals) {
+		talloc_free(rows);
+		return NULL;
+	}
+
+	if (emsmdbp_is_mapistore(table_object) && !table_object->object.table->search) {
+		contextID = emsmdbp_get_contextID(table_object);
+		if (mapistore_table_get_rows(emsmdbp_ctx->mstore_ctx, contextID, table_object->backend_object,
+					     rows, query_type, row_id, count, &properties) != MAPISTORE_SUCCESS) {
+			DEBUG(5, ("%s: unable to fetch rows %d-%d\n", __location__, row_id, row_id + count - 1));
+			talloc_free(rows);
+			return NULL;
+		}
+
+		data_pointers = talloc_zero_array(rows, void *, count * num_props);
+		row_retvals = talloc_zero_array(rows, enum MAPISTATUS, count * num_props);
+		if (!data_pointers || !row_retvals) {
+			talloc_free(rows);
+			return NULL;
+		}
+
+		for (i = 0; i < count; i++) {
+			row = properties[i];
+			if (!row) {
+				DEBUG(5, ("%s: invalid object at row %d (likely due to a restriction)\n", __location__, row_id + i));
+				continue;
+			}
+			rows[i] = data_pointers + i * num_props;
+			retvals[i] = row_retvals + i * num_props;
+			for (j = 0; j < num_props; j++) {
+				rows[i][j] = row[j].data;
+				if (row[j].error) {
+					retvals[i][j] = mapistore_error_to_mapi(row[j].error);
+				}
+				else if (row[j].data == NULL) {
+					retvals[i][j] = MAPI_E_NOT_FOUND;
+				}
+			}
+		}
+	}
+	else {
+		for (i = 0; i < count; i++) {
+			rows[i] = emsmdbp_object_table_get_row_props(rows, emsmdbp_ctx, table_object, row_id + i, query_type, retvals + i);
+		}
+	}
+
+	emsmdbp_object_table_cache_folders(emsmdbp_ctx, table_object, rows, retvals, count);
+
+	if (retvalsp) {
+		*retvalsp = retvals;
+	}
+
+	return rows;
+}
+
+/**
+   \details Check whether a folder is a search folder, as created with
+   a FOLDER_SEARCH folder type
+
+   \param folder_object pointer to the folder object
+
+   \return true if the folder is a search folder, otherwise false
+ */
+_PUBLIC_ bool emsmdbp_object_is_search_folder(struct emsmdbp_object *folder_object)
+{
+	TALLOC_CTX		*local_mem_ctx;
+	struct SPropTagArray	props;
+	enum MAPITAGS		prop_tag = PR_FOLDER_TYPE;
+	void			**data_pointers;
+	enum MAPISTATUS		*retvals = NULL;
+	bool			ret;
+
+	/* Sanity checks */
+	if (!folder_object || folder_object->type != EMSMDBP_OBJECT_FOLDER) return false;
+
+	if (emsmdbp_search_find(folder_object->emsmdbp_ctx, folder_object->object.folder->folderID)) return true;
+
+	local_mem_ctx = talloc_new(NULL);
+	if (!local_mem_ctx) return false;
+
+	props.cValues = 1;
+	props.aulPropTag = &prop_tag;
+	data_pointers = emsmdbp_object_get_properties(local_mem_ctx, folder_object->emsmdbp_ctx, folder_object, &props, &retvals);
+	ret = (data_pointers && retvals[0] == MAPI_E_SUCCESS
+	       && *(uint32_t *) data_pointers[0] == FOLDER_SEARCH);
+	talloc_free(local_mem_ctx);
+
+	return ret;
+}
+
+/**
+   \details Open the search folder state of a folder, creating it
+   when the folder is not a search folder yet
+
+   \param folder_object pointer to the folder object
+
+   \return the search folder on success, otherwise NULL
+ */
+_PUBLIC_ struct emsmdbp_search_folder *emsmdbp_object_search_open(struct emsmdbp_object *folder_object)
+{
+	struct emsmdbp_context		*emsmdbp_ctx;
+	struct emsmdbp_search_folder	*search;
+	struct emsmdbp_object		*mailbox_object;
+	struct emsmdbp_object_mailbox	*mailbox;
+	uint64_t			fid;
+
+	/* Sanity checks */
+	if (!folder_object || folder_object->type != EMSMDBP_OBJECT_FOLDER) return NULL;
+
+	emsmdbp_ctx = folder_object->emsmdbp_ctx;
+	fid = folder_object->object.folder->folderID;
+	search = emsmdbp_search_find(emsmdbp_ctx, fid);
+	if (search) return search;
+
+	mailbox_object = emsmdbp_get_mailbox(folder_object);
+	if (!mailbox_object) return NULL;
+
+	search = emsmdbp_search_add(emsmdbp_ctx, fid);
+	if (!search) return NULL;
+
+	/* the search outlives the handles of the client: it opens the
+	   searched folders from a mailbox object of its own */
+	mailbox = mailbox_object->object.mailbox;
+	search->mailbox = emsmdbp_object_mailbox_init(search, emsmdbp_ctx,
+						      mailbox->owner_EssDN ? mailbox->owner_EssDN : emsmdbp_ctx->szUserDN,
+						      mailbox->mailboxstore);
+	if (!search->mailbox) {
+		emsmdbp_search_del(emsmdbp_ctx, fid);
+		return NULL;
+	}
+
+	return search;
+}
+
+static void emsmdbp_object_search_set_columns(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object,
+					      uint16_t prop_count, enum MAPITAGS *properties)
+{
+	struct emsmdbp_object_table	*table = table_object->object.table;
+
+	table->prop_count = prop_count;
+	table->properties = talloc_memdup(table, properties, prop_count * sizeof (enum MAPITAGS));
+	if (emsmdbp_is_mapistore(table_object)) {
+		mapistore_table_set_columns(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(table_object),
+					    table_object->backend_object, table->prop_count, table->properties);
+	}
+}
+
+/**
+   \details Queue the subfolders of a folder searched recursively
+
+   \return the number of rows read
+ */
+static uint32_t emsmdbp_object_search_add_subfolders(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_search_folder *search,
+						     struct emsmdbp_object *folder_object)
+{
+	struct emsmdbp_object	*table_object;
+	enum MAPITAGS		column = PidTagFolderId;
+	void			***rows;
+	enum MAPISTATUS		**retvals;
+	uint32_t		denominator;
+	uint32_t		row;
+	uint32_t		count;
+	uint32_t		i;
+
+	table_object = emsmdbp_folder_open_table(NULL, folder_object, MAPISTORE_FOLDER_TABLE, 0);
+	if (!table_object) return 0;
+	emsmdbp_object_search_set_columns(emsmdbp_ctx, table_object, 1, &column);
+
+	denominator = table_object->object.table->denominator;
+	for (row = 0; row < denominator; row += count) {
+		count = denominator - row;
+		if (count > EMSMDBP_TABLE_ROWS_BATCH) {
+			count = EMSMDBP_TABLE_ROWS_BATCH;
+		}
+		rows = emsmdbp_object_table_get_rows_props(table_object, emsmdbp_ctx, table_object, row, count, MAPISTORE_PREFILTERED_QUERY, &retvals);
+		if (!rows) break;
+		for (i = 0; i < count; i++) {
+			if (rows[i] && retvals[i][0] == MAPI_E_SUCCESS) {
+				emsmdbp_search_add_folder(search, *(uint64_t *)rows[i][0]);
+			}
+		}
+		talloc_free(rows);
+	}
+	talloc_free(table_object);
+
+	return row;
+}
+
+/**
+   \details Open the contents table of the next folder to populate
+   the search with
+
+   \return true on success, otherwise false
+ */
+static bool emsmdbp_object_search_open_table(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_search_folder *search,
+					     uint64_t fid, uint32_t *countp)
+{
+	TALLOC_CTX		*local_mem_ctx;
+	struct emsmdbp_object	*folder_object;
+	struct SPropTagArray	*columns;
+	enum MAPITAGS		*properties;
+	uint16_t		prop_count;
+
+	local_mem_ctx = talloc_new(NULL);
+	if (emsmdbp_object_open_folder_by_fid(local_mem_ctx, emsmdbp_ctx, search->mailbox, fid, &folder_object) != MAPISTORE_SUCCESS) {
+		DEBUG(5, ("[%s:%d]: unable to open folder 0x%.16"PRIx64" of the search\n", __FUNCTION__, __LINE__, fid));
+		talloc_free(local_mem_ctx);
+		return false;
+	}
+
+	if (search->search_flags & RECURSIVE_SEARCH) {
+		*countp += emsmdbp_object_search_add_subfolders(emsmdbp_ctx, search, folder_object);
+	}
+
+	/* the table keeps a reference on the folder */
+	search->table = emsmdbp_folder_open_table(search, folder_object, MAPISTORE_MESSAGE_TABLE, 0);
+	talloc_free(local_mem_ctx);
+	if (!search->table) return false;
+
+	/* columns of the restriction, then the message identifier */
+	columns = search->restriction->columns;
+	prop_count = columns->cValues + 1;
+	properties = talloc_array(NULL, enum MAPITAGS, prop_count);
+	memcpy(properties, columns->aulPropTag, columns->cValues * sizeof (enum MAPITAGS));
+	properties[columns->cValues] = PidTagMid;
+	emsmdbp_object_search_set_columns(emsmdbp_ctx, search->table, prop_count, properties);
+	talloc_free(properties);
+
+	search->table_fid = fid;
+	search->table_row = 0;
+
+	return true;
+}
+
+/**
+   \details Populate a search folder, reading at most budget rows
+   from the searched folders. Population resumes where the previous
+   call stopped.
+
+   A searched folder whose rows cannot be read stops the population:
+   the search is left incomplete rather than silently truncated.
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param search pointer to the search folder
+   \param budget the maximum number of rows to read
+   \param countp pointer to the number of rows read to return
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_object_search_populate(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_search_folder *search, uint32_t budget, uint32_t *countp)
+{
+	void		***rows;
+	enum MAPISTATUS	**retvals;
+	uint32_t	mid_column;
+	uint32_t	count = 0;
+	uint32_t	batch;
+	uint64_t	fid;
+	uint32_t	i;
+
+	*countp = 0;
+	if (!(search->state & SEARCH_REBUILD) || !search->restriction) return MAPI_E_SUCCESS;
+
+	mid_column = search->restriction->columns->cValues;
+	while (count < budget) {
+		if (!search->table) {
+			if (!emsmdbp_search_next_folder(search, &fid)) {
+				search->state = (search->state & ~SEARCH_REBUILD) | SEARCH_COMPLETE;
+				DEBUG(5, ("[%s:%d]: search folder 0x%.16"PRIx64" populated with %d messages\n",
+					  __FUNCTION__, __LINE__, search->folderID, search->results_count));
+				break;
+			}
+			if (!emsmdbp_object_search_open_table(emsmdbp_ctx, search, fid, &count)) {
+				continue;
+			}
+		}
+
+		batch = search->table->object.table->denominator - search->table_row;
+		if (batch > EMSMDBP_TABLE_ROWS_BATCH) {
+			batch = EMSMDBP_TABLE_ROWS_BATCH;
+		}
+		if (batch > budget - count) {
+			batch = budget - count;
+		}
+
+		if (!batch) {
+			/* end of the folder */
+			talloc_free(search->table);
+			search->table = NULL;
+			continue;
+		}
+
+		rows = emsmdbp_object_table_get_rows_props(NULL, emsmdbp_ctx, search->table, search->table_row, batch, MAPISTORE_PREFILTERED_QUERY, &retvals);
+		if (!rows) {
+			DEBUG(1, ("[%s:%d]: unable to read rows %u to %u of folder 0x%.16"PRIx64", search folder 0x%.16"PRIx64" is incomplete\n",
+				  __FUNCTION__, __LINE__, search->table_row, search->table_row + batch - 1, search->table_fid, search->folderID));
+			talloc_free(search->table);
+			search->table = NULL;
+			search->state &= ~SEARCH_REBUILD;
+			*countp = count;
+			return MAPI_E_CALL_FAILED;
+		}
+
+		for (i = 0; i < batch; i++) {
+			if (!rows[i] || retvals[i][mid_column] != MAPI_E_SUCCESS) continue;
+			if (emsmdbp_restriction_match(search->restriction, rows[i], retvals[i])) {
+				emsmdbp_search_add_result(search, *(uint64_t *)rows[i][mid_column], search->table_fid);
+			}
+		}
+		talloc_free(rows);
+
+		search->table_row += batch;
+		count += batch;
+	}
+
+	*countp = count;
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Populate the search folders of the session, reading at
+   most budget rows overall
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param budget the maximum number of rows to read
+ */
+_PUBLIC_ void emsmdbp_object_search_run(struct emsmdbp_context *emsmdbp_ctx, uint32_t budget)
+{
+	struct emsmdbp_search_folder	*search;
+	uint32_t			count;
+
+	for (search = emsmdbp_ctx->searches; search && budget; search = search->next) {
+		emsmdbp_object_search_populate(emsmdbp_ctx, search, budget, &count);
+		budget = (count < budget) ? budget - count : 0;
+	}
+}
+
+/**
+   \details Evaluate the restriction of a search against a message
+   and update its results
+ */
+static void emsmdbp_object_search_evaluate(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_search_folder *search,
+					   uint64_t fid, uint64_t mid)
+{
+	TALLOC_CTX		*local_mem_ctx;
+	struct emsmdbp_object	*message_object;
+	void			**data_pointers = NULL;
+	enum MAPISTATUS		*retvals = NULL;
+
+	local_mem_ctx = talloc_new(NULL);
+	if (emsmdbp_object_message_open(local_mem_ctx, emsmdbp_ctx, search->mailbox, fid, mid, false, &message_object, NULL) == MAPISTORE_SUCCESS) {
+		data_pointers = emsmdbp_object_get_properties(local_mem_ctx, emsmdbp_ctx, message_object, search->restriction->columns, &retvals);
+	}
+
+	if (data_pointers && emsmdbp_restriction_match(search->restriction, data_pointers, retvals)) {
+		emsmdbp_search_add_result(search, mid, fid);
+	}
+	else {
+		emsmdbp_search_del_result(search, mid);
+	}
+	talloc_free(local_mem_ctx);
+}
+
+/**
+   \details Update the search folders of the session with a mapistore
+   object notification
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param notification pointer to the notification
+ */
+_PUBLIC_ void emsmdbp_object_search_notify(struct emsmdbp_context *emsmdbp_ctx, struct mapistore_notification *notification)
+{
+	struct emsmdbp_search_folder			*search;
+	struct emsmdbp_search_folder			*next;
+	struct mapistore_object_notification_parameters	*parameters;
+
+	if (!emsmdbp_ctx->searches || !notification) return;
+	if (notification->object_type != MAPISTORE_FOLDER && notification->object_type != MAPISTORE_MESSAGE) return;
+
+	parameters = &notification->parameters.object_parameters;
+	for (search = emsmdbp_ctx->searches; search; search = next) {
+		next = search->next;
+
+		if (notification->object_type == MAPISTORE_FOLDER) {
+			switch (notification->event) {
+			case MAPISTORE_OBJECT_CREATED:
+				if ((search->state & SEARCH_RUNNING) && (search->search_flags & RECURSIVE_SEARCH)
+				    && emsmdbp_search_has_folder(search, parameters->folder_id)) {
+					emsmdbp_search_add_folder(search, parameters->object_id);
+					search->state = (search->state & ~SEARCH_COMPLETE) | SEARCH_REBUILD;
+				}
+				break;
+			case MAPISTORE_OBJECT_DELETED:
+				if (parameters->object_id == search->folderID) {
+					emsmdbp_search_del(emsmdbp_ctx, search->folderID);
+					break;
+				}
+				if (search->table && search->table_fid == parameters->object_id) {
+					talloc_free(search->table);
+					search->table = NULL;
+				}
+				emsmdbp_search_del_folder(search, parameters->object_id);
+				break;
+			default:
+				break;
+			}
+			continue;
+		}
+
+		if (!(search->state & SEARCH_RUNNING)) continue;
+
+		switch (notification->event) {
+		case MAPISTORE_OBJECT_DELETED:
+			emsmdbp_search_del_result(search, parameters->object_id);
+			break;
+		case MAPISTORE_OBJECT_MOVED:
+			emsmdbp_search_del_result(search, parameters->old_object_id);
+			if (emsmdbp_search_has_folder(search, parameters->folder_id)) {
+				emsmdbp_object_search_evaluate(emsmdbp_ctx, search, parameters->folder_id, parameters->object_id);
+			}
+			break;
+		default:
+			if (emsmdbp_search_has_folder(search, parameters->folder_id)) {
+				emsmdbp_object_search_evaluate(emsmdbp_ctx, search, parameters->folder_id, parameters->object_id);
+			}
+			break;
+		}
+	}
+}
+
+/**
+   \details Update the search folders after the client saved,
+   deleted, moved or copied a message through its own session
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param event the kind of change made to the message
+   \param folder_id the identifier of the folder holding the message
+   \param message_id the identifier of the message
+   \param old_folder_id the identifier of the source folder of a move or copy
+   \param old_message_id the identifier of the source message of a move or copy
+ */
+_PUBLIC_ void emsmdbp_object_search_message_notify(struct emsmdbp_context *emsmdbp_ctx, enum mapistore_notification_type event,
+						   uint64_t folder_id, uint64_t message_id,
+						   uint64_t old_folder_id, uint64_t old_message_id)
+{
+	struct mapistore_notification	notification;
+
+	if (!emsmdbp_ctx || !emsmdbp_ctx->searches) return;
+
+	memset(&notification, 0, sizeof(struct mapistore_notification));
+	notification.object_type = MAPISTORE_MESSAGE;
+	notification.event = event;
+	notification.parameters.object_parameters.folder_id = folder_id;
+	notification.parameters.object_parameters.object_id = message_id;
+	notification.parameters.object_parameters.old_folder_id = old_folder_id;
+	notification.parameters.object_parameters.old_object_id = old_message_id;
+
+	emsmdbp_object_search_notify(emsmdbp_ctx, &notification);
+}
+
+/**
+   \details Update the row count of a search folder contents table
+
+   \param table_object pointer to the table object
+ */
+_PUBLIC_ void emsmdbp_object_search_table_refresh(struct emsmdbp_object *table_object)
+{
+	struct emsmdbp_object_table	*table;
+	struct emsmdbp_search_folder	*search;
+
+	if (!table_object || table_object->type != EMSMDBP_OBJECT_TABLE) return;
+	table = table_object->object.table;
+	if (!table->search) return;
+
+	search = emsmdbp_search_find(table_object->emsmdbp_ctx, table_object->parent_object->object.folder->folderID);
+	table->denominator = search ? search->results_count : 0;
+	if (table->numerator > table->denominator) {
+		table->numerator = table->denominator;
+	}
+}
+
 _PUBLIC_ void emsmdbp_fill_table_row_blob(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx,
 					  DATA_BLOB *table_row, uint16_t num_props,
 					  enum MAPITAGS *properties,
@@ -2791,32 +3505,213 @@ _PUBLIC_ DATA_BLOB emsmdbp_stream_read_buffer(struct emsmdbp_stream *stream, uin
 	return buffer;
 }
 
-_PUBLIC_ void emsmdbp_stream_write_buffer(TALLOC_CTX *mem_ctx, struct emsmdbp_stream *stream, DATA_BLOB new_buffer)
+/* size above which stream buffers are moved to a temporary file */
+static size_t		emsmdbp_stream_spill_size = EMSMDBP_STREAM_SPILL_SIZE;
+static const char	*emsmdbp_stream_spill_dir = NULL;
+
+struct emsmdbp_stream_spill {
+	int		fd;
+	uint8_t		*map;
+	size_t		size;
+};
+
+static int emsmdbp_stream_spill_destructor(struct emsmdbp_stream_spill *spill)
+{
+	if (spill->map) {
+		munmap(spill->map, spill->size);
+	}
+	if (spill->fd != -1) {
+		close(spill->fd);
+	}
+
+	return 0;
+}
+
+/**
+   \details Set the size above which stream buffers are moved from
+   the heap to a temporary file
+
+   \param size the spill size in bytes, 0 to keep every stream in memory
+   \param dir the directory where temporary files are created, NULL
+   for the default temporary directory
+ */
+_PUBLIC_ void emsmdbp_stream_set_spill(size_t size, const char *dir)
+{
+	emsmdbp_stream_spill_size = size;
+	emsmdbp_stream_spill_dir = dir;
+}
+
+/**
+   \details Map a stream buffer of the given capacity on an unlinked
+   temporary file, so large uploads are paged by the kernel instead of
+   sitting in the server heap.
+
+   \param mem_ctx pointer to the memory context owning the stream data
+   \param stream pointer to the stream
+   \param allocated the new capacity of the buffer
+
+   \return true on success, otherwise false and the stream is left
+   unchanged
+ */
+static bool emsmdbp_stream_spill_grow(TALLOC_CTX *mem_ctx, struct emsmdbp_stream *stream, size_t allocated)
+{
+	struct emsmdbp_stream_spill	*spill;
+	char				*path;
+	uint8_t				*map;
+	int				ret;
+
+	spill = stream->spill;
+	if (!spill) {
+		spill = talloc_zero(mem_ctx, struct emsmdbp_stream_spill);
+		if (!spill) return false;
+		path = talloc_asprintf(spill, "%s/emsmdbp_stream.XXXXXX",
+				       emsmdbp_stream_spill_dir ? emsmdbp_stream_spill_dir : "/tmp");
+		spill->fd = path ? mkstemp(path) : -1;
+		if (spill->fd == -1) {
+			DEBUG(1, ("emsmdbp_stream: unable to create a spill file\n"));
+			talloc_free(spill);
+			return false;
+		}
+		unlink(path);
+		talloc_free(path);
+		talloc_set_destructor(spill, emsmdbp_stream_spill_destructor);
+	}
+
+	/* blocks are reserved up front: a full disk must fail here, not
+	   as SIGBUS when the mapping is written */
+	ret = posix_fallocate(spill->fd, spill->size, allocated - spill->size);
+	if (ret != 0) {
+		DEBUG(1, ("emsmdbp_stream: unable to reserve spill file blocks: %s\n", strerror(ret)));
+		goto fail;
+	}
+	map = mmap(NULL, allocated, PROT_READ | PROT_WRITE, MAP_SHARED, spill->fd, 0);
+	if (map == MAP_FAILED) {
+		goto fail;
+	}
+
+	if (spill->map) {
+		/* the previous mapping shares the same file */
+		munmap(spill->map, spill->size);
+	}
+	else {
+		if (stream->buffer.length) {
+			memcpy(map, stream->buffer.data, stream->buffer.length);
+		}
+		if (stream->allocated) {
+			talloc_free(stream->buffer.data);
+		}
+		stream->spill = spill;
+		DEBUG(5, ("emsmdbp_stream: spilling %zu bytes to a temporary file\n", stream->buffer.length));
+	}
+	spill->map = map;
+	spill->size = allocated;
+	stream->buffer.data = map;
+	stream->allocated = allocated;
+
+	return true;
+
+fail:
+	DEBUG(1, ("emsmdbp_stream: unable to grow the spill file to %zu bytes\n", allocated));
+	if (!stream->spill) {
+		talloc_free(spill);
+	}
+	return false;
+}
+
+/**
+   \details Make sure a stream buffer is owned by the stream and can
+   hold at least size bytes. The capacity grows geometrically so a
+   sequence of writes only copies the data a logarithmic number of
+   times; buffers borrowed from a property value are copied on first
+   write.
+
+   \param mem_ctx pointer to the memory context owning the stream data
+   \param stream pointer to the stream
+   \param size the minimum capacity needed
+
+   \return true on success, otherwise false
+ */
+static bool emsmdbp_stream_reserve(TALLOC_CTX *mem_ctx, struct emsmdbp_stream *stream, size_t size)
+{
+	size_t	allocated;
+	uint8_t	*data;
+
+	if (stream->allocated && size <= stream->allocated) return true;
+
+	allocated = stream->allocated ? stream->allocated : EMSMDBP_STREAM_MIN_ALLOC;
+	while (allocated < size) {
+		allocated *= 2;
+	}
+
+	if (stream->spill || (emsmdbp_stream_spill_size && allocated > emsmdbp_stream_spill_size)) {
+		if (emsmdbp_stream_spill_grow(mem_ctx, stream, allocated)) {
+			return true;
+		}
+		if (stream->spill) return false;
+	}
+
+	if (stream->allocated) {
+		data = talloc_realloc(mem_ctx, stream->buffer.data, uint8_t, allocated);
+		if (!data) return false;
+	}
+	else {
+		data = talloc_array(mem_ctx, uint8_t, allocated);
+		if (!data) return false;
+		if (stream->buffer.length) {
+			memcpy(data, stream->buffer.data, stream->buffer.length);
+		}
+	}
+	stream->buffer.data = data;
+	stream->allocated = allocated;
+
+	return true;
+}
+
+/**
+   \details Write data at the current position of a stream and move
+   the position past it
+
+   \param mem_ctx pointer to the memory context owning the stream data
+   \param stream pointer to the stream
+   \param new_buffer the data to write
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_NOT_ENOUGH_MEMORY
+   and the stream is left unchanged
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_stream_write_buffer(TALLOC_CTX *mem_ctx, struct emsmdbp_stream *stream, DATA_BLOB new_buffer)
 {
 	size_t new_position;
-	uint32_t old_length;
-	uint8_t *old_data;
 
 	new_position = stream->position + new_buffer.length;
-	if (new_position >= stream->buffer.length) {
-		old_length = stream->buffer.length;
+	if (!emsmdbp_stream_reserve(mem_ctx, stream, MAX(new_position, stream->buffer.length))) {
+		DEBUG(0, ("emsmdbp_stream: unable to grow the stream buffer to %zu bytes\n", new_position));
+		return MAPI_E_NOT_ENOUGH_MEMORY;
+	}
+	if (new_position > stream->buffer.length) {
 		stream->buffer.length = new_position;
-		if (stream->buffer.data) {
-			old_data = stream->buffer.data;
-			stream->buffer.data = talloc_realloc(mem_ctx, stream->buffer.data, uint8_t, stream->buffer.length);
-			if (!stream->buffer.data) {
-				DEBUG(5, ("WARNING: [bug] lost buffer pointer (data = NULL)\n"));
-				stream->buffer.data = talloc_array(mem_ctx, uint8_t, stream->buffer.length);
-				memcpy(stream->buffer.data, old_data, old_length);
-			}
-		}
-		else {
-			stream->buffer.data = talloc_array(mem_ctx, uint8_t, stream->buffer.length);
-		}
 	}
 
 	memcpy(stream->buffer.data + stream->position, new_buffer.data, new_buffer.length);
 	stream->position = new_position;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Release the data owned by a stream and reset it to an
+   empty stream
+
+   \param stream pointer to the stream
+ */
+_PUBLIC_ void emsmdbp_stream_release(struct emsmdbp_stream *stream)
+{
+	if (stream->spill) {
+		talloc_free(stream->spill);
+	}
+	else if (stream->allocated) {
+		talloc_free(stream->buffer.data);
+	}
+	memset(stream, 0, sizeof(struct emsmdbp_stream));
 }
 
 _PUBLIC_ struct emsmdbp_stream_data *emsmdbp_object_get_stream_data(struct emsmdbp_object *object, enum MAPITAGS prop_tag)
@@ -2871,18 +3766,14 @@ _PUBLIC_ struct emsmdbp_object *emsmdbp_object_synccontext_init(TALLOC_CTX *mem_
 	(void) talloc_reference(synccontext_object->object.synccontext, parent_object);
         synccontext_object->object.synccontext->state_property = 0;
         synccontext_object->object.synccontext->state_stream.buffer.length = 0;
-        synccontext_object->object.synccontext->state_stream.buffer.data = talloc_zero(synccontext_object->object.synccontext, uint8_t);
+        synccontext_object->object.synccontext->state_stream.buffer.data = NULL;
         synccontext_object->object.synccontext->stream.buffer.length = 0;
         synccontext_object->object.synccontext->stream.buffer.data = NULL;
 
 	synccontext_object->object.synccontext->cnset_seen = talloc_zero(emsmdbp_ctx, struct idset);
 	openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, emsmdbp_ctx->username, NULL, &synccontext_object->object.synccontext->cnset_seen->repl.guid);
-	synccontext_object->object.synccontext->cnset_seen->ranges = talloc_zero(synccontext_object->object.synccontext->cnset_seen, struct globset_range);
-	synccontext_object->object.synccontext->cnset_seen->range_count = 1;
-	synccontext_object->object.synccontext->cnset_seen->ranges->next = NULL;
-	synccontext_object->object.synccontext->cnset_seen->ranges->prev = synccontext_object->object.synccontext->cnset_seen->ranges;
-	synccontext_object->object.synccontext->cnset_seen->ranges->low = 0xffffffffffffffffLL;
-	synccontext_object->object.synccontext->cnset_seen->ranges->high = 0x0;
+	synccontext_object->object.synccontext->cnset_seen->range_count = 0;
+	synccontext_object->object.synccontext->cnset_seen->ranges = NULL;
 
         /* synccontext_object->object.synccontext->property_tags.cValues = 0; */
         /* synccontext_object->object.synccontext->property_tags.aulPropTag = NULL; */
@@ -0,0 +1,635 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_restriction.c
+
+   \brief Compiled restrictions
+
+   A mapi_SRestriction tree is flattened once into an array of nodes
+   in pre-order, where each node records the index of the node
+   following its subtree so AND and OR nodes can skip children. The
+   properties the restriction reads are collected into a column set,
+   and each node refers to its properties by column index: a message
+   is matched against the data pointers returned for these columns,
+   whichever way they were fetched (table row or opened message).
+ */
+
+#include <ctype.h>
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/libmapiserver/libmapiserver.h"
+#include "libmapi/property_tags.h"
+
+#include "dcesrv_exchange_emsmdb.h"
+
+/* deepest restriction tree accepted by the compiler */
+#define	EMSMDBP_RESTRICTION_MAX_DEPTH	64
+
+static uint16_t emsmdbp_restriction_column(struct emsmdbp_restriction *restriction, enum MAPITAGS tag)
+{
+	uint32_t	i;
+
+	for (i = 0; i < restriction->columns->cValues; i++) {
+		if (restriction->columns->aulPropTag[i] == tag) {
+			return i;
+		}
+	}
+
+	SPropTagArray_add(restriction->columns, restriction->columns, tag);
+
+	return restriction->columns->cValues - 1;
+}
+
+/**
+   \details Load the value of a restriction into a compiled value.
+   Strings are copied, lowercased when the comparison ignores case.
+ */
+static void emsmdbp_restriction_load_value(TALLOC_CTX *mem_ctx, struct mapi_SPropValue *prop, bool ignorecase,
+					   struct emsmdbp_restriction_value *value)
+{
+	const char	*str = NULL;
+	char		*lower;
+	size_t		i;
+
+	value->type = EMSMDBP_RESTRICTION_NONE;
+
+	switch (prop->ulPropTag & 0xFFFF) {
+	case PT_I2:
+		value->type = EMSMDBP_RESTRICTION_INTEGER;
+		value->i = (int16_t) prop->value.i;
+		break;
+	case PT_LONG:
+		value->type = EMSMDBP_RESTRICTION_INTEGER;
+		value->i = (int32_t) prop->value.l;
+		break;
+	case PT_I8:
+		value->type = EMSMDBP_RESTRICTION_INTEGER;
+		value->i = (int64_t) prop->value.d;
+		break;
+	case PT_BOOLEAN:
+		value->type = EMSMDBP_RESTRICTION_INTEGER;
+		value->i = prop->value.b ? 1 : 0;
+		break;
+	case PT_SYSTIME:
+		value->type = EMSMDBP_RESTRICTION_INTEGER;
+		value->i = ((int64_t) prop->value.ft.dwHighDateTime << 32) | prop->value.ft.dwLowDateTime;
+		break;
+	case PT_DOUBLE:
+		value->type = EMSMDBP_RESTRICTION_DOUBLE;
+		value->dbl = prop->value.dbl;
+		break;
+	case PT_MV_LONG:
+		if (prop->value.MVl.cValues) {
+			value->type = EMSMDBP_RESTRICTION_INTEGER;
+			value->i = (int32_t) prop->value.MVl.lpl[0];
+		}
+		break;
+	case PT_STRING8:
+		str = prop->value.lpszA;
+		break;
+	case PT_UNICODE:
+		str = prop->value.lpszW;
+		break;
+	case PT_MV_STRING8:
+		if (prop->value.MVszA.cValues) {
+			str = prop->value.MVszA.strings[0].lppszA;
+		}
+		break;
+	case PT_MV_UNICODE:
+		if (prop->value.MVszW.cValues) {
+			str = prop->value.MVszW.strings[0].lppszW;
+		}
+		break;
+	case PT_BINARY:
+	case PT_SVREID:
+		value->type = EMSMDBP_RESTRICTION_BINARY;
+		value->data = talloc_memdup(mem_ctx, prop->value.bin.lpb, prop->value.bin.cb);
+		value->length = prop->value.bin.cb;
+		break;
+	case PT_CLSID:
+		value->type = EMSMDBP_RESTRICTION_BINARY;
+		value->data = talloc_memdup(mem_ctx, &prop->value.lpguid, sizeof (struct GUID));
+		value->length = sizeof (struct GUID);
+		break;
+	default:
+		DEBUG(5, ("[%s:%d]: unsupported restriction value type 0x%.4x\n", __FUNCTION__, __LINE__, prop->ulPropTag & 0xFFFF));
+		break;
+	}
+
+	if (str) {
+		lower = talloc_strdup(mem_ctx, str);
+		if (lower && ignorecase) {
+			for (i = 0; lower[i]; i++) {
+				lower[i] = tolower((unsigned char) lower[i]);
+			}
+		}
+		value->type = EMSMDBP_RESTRICTION_STRING;
+		value->data = (const uint8_t *) lower;
+		value->length = lower ? strlen(lower) : 0;
+	}
+}
+
+static bool emsmdbp_restriction_compile_node(struct emsmdbp_restriction *restriction, struct mapi_SRestriction *res, uint32_t depth)
+{
+	struct emsmdbp_restriction_node	*nodes;
+	struct emsmdbp_restriction_node	*node;
+	struct mapi_SRestriction	*child;
+	uint32_t			idx;
+	uint32_t			i;
+
+	if (depth > EMSMDBP_RESTRICTION_MAX_DEPTH) {
+		DEBUG(5, ("[%s:%d]: restriction is too deep\n", __FUNCTION__, __LINE__));
+		return false;
+	}
+
+	nodes = talloc_realloc(restriction, restriction->nodes, struct emsmdbp_restriction_node, restriction->count + 1);
+	if (!nodes) return false;
+	restriction->nodes = nodes;
+
+	idx = restriction->count++;
+	memset(&nodes[idx], 0, sizeof (struct emsmdbp_restriction_node));
+	nodes[idx].rt = res->rt;
+
+	switch (res->rt) {
+	case RES_AND:
+		nodes[idx].count = res->res.resAnd.cRes;
+		for (i = 0; i < res->res.resAnd.cRes; i++) {
+			child = (struct mapi_SRestriction *) &res->res.resAnd.res[i];
+			if (!emsmdbp_restriction_compile_node(restriction, child, depth + 1)) return false;
+		}
+		break;
+	case RES_OR:
+		nodes[idx].count = res->res.resOr.cRes;
+		for (i = 0; i < res->res.resOr.cRes; i++) {
+			child = (struct mapi_SRestriction *) &res->res.resOr.res[i];
+			if (!emsmdbp_restriction_compile_node(restriction, child, depth + 1)) return false;
+		}
+		break;
+	case RES_NOT:
+		nodes[idx].count = 1;
+		child = (struct mapi_SRestriction *) &res->res.resNot.res;
+		if (!emsmdbp_restriction_compile_node(restriction, child, depth + 1)) return false;
+		break;
+	case RES_CONTENT:
+		node = &restriction->nodes[idx];
+		node->fuzzy = res->res.resContent.fuzzy;
+		node->column = emsmdbp_restriction_column(restriction, res->res.resContent.ulPropTag);
+		emsmdbp_restriction_load_value(restriction, &res->res.resContent.lpProp,
+					       (node->fuzzy & FL_IGNORECASE), &node->value);
+		break;
+	case RES_PROPERTY:
+		node = &restriction->nodes[idx];
+		node->relop = res->res.resProperty.relop;
+		node->column = emsmdbp_restriction_column(restriction, res->res.resProperty.ulPropTag);
+		emsmdbp_restriction_load_value(restriction, &res->res.resProperty.lpProp, false, &node->value);
+		break;
+	case RES_COMPAREPROPS:
+		node = &restriction->nodes[idx];
+		node->relop = res->res.resCompareProps.relop;
+		node->column = emsmdbp_restriction_column(restriction, res->res.resCompareProps.ulPropTag1);
+		node->column2 = emsmdbp_restriction_column(restriction, res->res.resCompareProps.ulPropTag2);
+		break;
+	case RES_BITMASK:
+		node = &restriction->nodes[idx];
+		node->relop = res->res.resBitmask.relMBR;
+		node->mask = res->res.resBitmask.ulMask;
+		node->column = emsmdbp_restriction_column(restriction, res->res.resBitmask.ulPropTag);
+		break;
+	case RES_SIZE:
+		node = &restriction->nodes[idx];
+		node->relop = res->res.resSize.relop;
+		node->mask = res->res.resSize.size;
+		node->column = emsmdbp_restriction_column(restriction, res->res.resSize.ulPropTag);
+		break;
+	case RES_EXIST:
+		node = &restriction->nodes[idx];
+		node->column = emsmdbp_restriction_column(restriction, res->res.resExist.ulPropTag);
+		break;
+	case RES_SUBRESTRICTION:
+		/* recipients and attachments are not available as message columns */
+		DEBUG(5, ("[%s:%d]: subobject restrictions never match\n", __FUNCTION__, __LINE__));
+		break;
+	case RES_COMMENT:
+		if (res->res.resComment.RestrictionPresent && res->res.resComment.Restriction.res) {
+			nodes[idx].count = 1;
+			child = (struct mapi_SRestriction *) res->res.resComment.Restriction.res;
+			if (!emsmdbp_restriction_compile_node(restriction, child, depth + 1)) return false;
+		}
+		break;
+	default:
+		DEBUG(5, ("[%s:%d]: unsupported restriction type 0x%x\n", __FUNCTION__, __LINE__, res->rt));
+		return false;
+	}
+
+	restriction->nodes[idx].next = restriction->count;
+
+	return true;
+}
+
+/**
+   \details Compile a restriction
+
+   \param mem_ctx pointer to the memory context
+   \param res pointer to the restriction to compile
+
+   \return Allocated compiled restriction on success, otherwise NULL
+ */
+_PUBLIC_ struct emsmdbp_restriction *emsmdbp_restriction_compile(TALLOC_CTX *mem_ctx, struct mapi_SRestriction *res)
+{
+	struct emsmdbp_restriction	*restriction;
+
+	/* Sanity checks */
+	if (!res) return NULL;
+
+	restriction = talloc_zero(mem_ctx, struct emsmdbp_restriction);
+	if (!restriction) return NULL;
+
+	restriction->columns = talloc_zero(restriction, struct SPropTagArray);
+	if (!restriction->columns) {
+		talloc_free(restriction);
+		return NULL;
+	}
+	restriction->columns->aulPropTag = talloc_zero(restriction->columns, enum MAPITAGS);
+
+	if (!emsmdbp_restriction_compile_node(restriction, res, 0)) {
+		talloc_free(restriction);
+		return NULL;
+	}
+
+	return restriction;
+}
+
+/**
+   \details Read the value of a single-valued column
+ */
+static bool emsmdbp_restriction_get_value(uint16_t type, const void *data, struct emsmdbp_restriction_value *value)
+{
+	const struct FILETIME	*ft;
+	const struct Binary_r	*bin;
+
+	switch (type) {
+	case PT_I2:
+		value->type = EMSMDBP_RESTRICTION_INTEGER;
+		value->i = *(const int16_t *) data;
+		break;
+	case PT_LONG:
+		value->type = EMSMDBP_RESTRICTION_INTEGER;
+		value->i = *(const int32_t *) data;
+		break;
+	case PT_I8:
+		value->type = EMSMDBP_RESTRICTION_INTEGER;
+		value->i = *(const int64_t *) data;
+		break;
+	case PT_BOOLEAN:
+		value->type = EMSMDBP_RESTRICTION_INTEGER;
+		value->i = *(const uint8_t *) data ? 1 : 0;
+		break;
+	case PT_SYSTIME:
+		ft = (const struct FILETIME *) data;
+		value->type = EMSMDBP_RESTRICTION_INTEGER;
+		value->i = ((int64_t) ft->dwHighDateTime << 32) | ft->dwLowDateTime;
+		break;
+	case PT_DOUBLE:
+		value->type = EMSMDBP_RESTRICTION_DOUBLE;
+		value->dbl = *(const double *) data;
+		break;
+	case PT_STRING8:
+	case PT_UNICODE:
+		value->type = EMSMDBP_RESTRICTION_STRING;
+		value->data = (const uint8_t *) data;
+		value->length = strlen((const char *) data);
+		break;
+	case PT_BINARY:
+	case PT_SVREID:
+		bin = (const struct Binary_r *) data;
+		value->type = EMSMDBP_RESTRICTION_BINARY;
+		value->data = bin->lpb;
+		value->length = bin->cb;
+		break;
+	case PT_CLSID:
+		value->type = EMSMDBP_RESTRICTION_BINARY;
+		value->data = (const uint8_t *) data;
+		value->length = sizeof (struct GUID);
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+static int emsmdbp_restriction_strncmp(const uint8_t *a, const uint8_t *b, size_t length, bool ignorecase)
+{
+	size_t	i;
+	int	ca, cb;
+
+	for (i = 0; i < length; i++) {
+		ca = a[i];
+		cb = b[i];
+		if (ignorecase) {
+			ca = tolower(ca);
+			cb = tolower(cb);
+		}
+		if (ca != cb) {
+			return ca - cb;
+		}
+	}
+
+	return 0;
+}
+
+/**
+   \details Order two values of the same kind
+
+   \return true if the values can be compared, the order being
+   returned in cmp
+ */
+static bool emsmdbp_restriction_order(const struct emsmdbp_restriction_value *a, const struct emsmdbp_restriction_value *b,
+				      bool ignorecase, int *cmp)
+{
+	size_t	length;
+
+	if (a->type == EMSMDBP_RESTRICTION_DOUBLE || b->type == EMSMDBP_RESTRICTION_DOUBLE) {
+		double	da, db;
+
+		if ((a->type != EMSMDBP_RESTRICTION_DOUBLE && a->type != EMSMDBP_RESTRICTION_INTEGER)
+		    || (b->type != EMSMDBP_RESTRICTION_DOUBLE && b->type != EMSMDBP_RESTRICTION_INTEGER)) {
+			return false;
+		}
+		da = (a->type == EMSMDBP_RESTRICTION_DOUBLE) ? a->dbl : (double) a->i;
+		db = (b->type == EMSMDBP_RESTRICTION_DOUBLE) ? b->dbl : (double) b->i;
+		*cmp = (da < db) ? -1 : (da > db);
+		return true;
+	}
+
+	if (a->type != b->type) {
+		return false;
+	}
+
+	switch (a->type) {
+	case EMSMDBP_RESTRICTION_INTEGER:
+		*cmp = (a->i < b->i) ? -1 : (a->i > b->i);
+		return true;
+	case EMSMDBP_RESTRICTION_STRING:
+	case EMSMDBP_RESTRICTION_BINARY:
+		length = (a->length < b->length) ? a->length : b->length;
+		*cmp = emsmdbp_restriction_strncmp(a->data, b->data, length,
+						   ignorecase && a->type == EMSMDBP_RESTRICTION_STRING);
+		if (*cmp == 0) {
+			*cmp = (a->length < b->length) ? -1 : (a->length > b->length);
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool emsmdbp_restriction_relop(uint8_t relop, int cmp)
+{
+	switch (relop) {
+	case RELOP_LT:
+		return cmp < 0;
+	case RELOP_LE:
+		return cmp <= 0;
+	case RELOP_GT:
+		return cmp > 0;
+	case RELOP_GE:
+		return cmp >= 0;
+	case RELOP_EQ:
+		return cmp == 0;
+	case RELOP_NE:
+		return cmp != 0;
+	default:
+		/* RELOP_RE is not supported */
+		return false;
+	}
+}
+
+static bool emsmdbp_restriction_content(struct emsmdbp_restriction_node *node, const struct emsmdbp_restriction_value *value)
+{
+	const struct emsmdbp_restriction_value	*needle = &node->value;
+	bool					ignorecase;
+	size_t					i;
+
+	if (value->type != needle->type
+	    || (value->type != EMSMDBP_RESTRICTION_STRING && value->type != EMSMDBP_RESTRICTION_BINARY)) {
+		return false;
+	}
+
+	/* the needle was lowercased at compile time */
+	ignorecase = (value->type == EMSMDBP_RESTRICTION_STRING) && (node->fuzzy & FL_IGNORECASE);
+
+	switch (node->fuzzy & 0xFFFF) {
+	case FL_SUBSTRING:
+		if (needle->length > value->length) return false;
+		for (i = 0; i + needle->length <= value->length; i++) {
+			if (!emsmdbp_restriction_strncmp(value->data + i, needle->data, needle->length, ignorecase)) {
+				return true;
+			}
+		}
+		return false;
+	case FL_PREFIX:
+		if (needle->length > value->length) return false;
+		return !emsmdbp_restriction_strncmp(value->data, needle->data, needle->length, ignorecase);
+	default:
+		if (needle->length != value->length) return false;
+		return !emsmdbp_restriction_strncmp(value->data, needle->data, needle->length, ignorecase);
+	}
+}
+
+static bool emsmdbp_restriction_property(struct emsmdbp_restriction_node *node, const struct emsmdbp_restriction_value *value)
+{
+	int	cmp;
+
+	/* string properties compare case-insensitively */
+	if (!emsmdbp_restriction_order(value, &node->value, true, &cmp)) {
+		return false;
+	}
+
+	return emsmdbp_restriction_relop(node->relop, cmp);
+}
+
+/**
+   \details Match a value node against a column. A multi-valued
+   column matches when any of its values matches.
+ */
+static bool emsmdbp_restriction_match_values(struct emsmdbp_restriction_node *node, uint32_t tag, const void *data)
+{
+	struct emsmdbp_restriction_value	value;
+	const struct mapi_MV_LONG_STRUCT	*mvl;
+	const struct mapi_SLPSTRArray		*mvsz_a;
+	const struct mapi_SLPSTRArrayW		*mvsz_w;
+	uint32_t				i;
+	bool					match;
+
+	switch (tag & 0xFFFF) {
+	case PT_MV_LONG:
+		mvl = (const struct mapi_MV_LONG_STRUCT *) data;
+		for (i = 0; i < mvl->cValues; i++) {
+			emsmdbp_restriction_get_value(PT_LONG, &mvl->lpl[i], &value);
+			match = (node->rt == RES_CONTENT) ? false : emsmdbp_restriction_property(node, &value);
+			if (match) return true;
+		}
+		return false;
+	case PT_MV_STRING8:
+		mvsz_a = (const struct mapi_SLPSTRArray *) data;
+		for (i = 0; i < mvsz_a->cValues; i++) {
+			if (!mvsz_a->strings[i].lppszA) continue;
+			emsmdbp_restriction_get_value(PT_STRING8, mvsz_a->strings[i].lppszA, &value);
+			match = (node->rt == RES_CONTENT) ? emsmdbp_restriction_content(node, &value) : emsmdbp_restriction_property(node, &value);
+			if (match) return true;
+		}
+		return false;
+	case PT_MV_UNICODE:
+		mvsz_w = (const struct mapi_SLPSTRArrayW *) data;
+		for (i = 0; i < mvsz_w->cValues; i++) {
+			if (!mvsz_w->strings[i].lppszW) continue;
+			emsmdbp_restriction_get_value(PT_UNICODE, mvsz_w->strings[i].lppszW, &value);
+			match = (node->rt == RES_CONTENT) ? emsmdbp_restriction_content(node, &value) : emsmdbp_restriction_property(node, &value);
+			if (match) return true;
+		}
+		return false;
+	default:
+		if (!emsmdbp_restriction_get_value(tag & 0xFFFF, data, &value)) {
+			return false;
+		}
+		return (node->rt == RES_CONTENT) ? emsmdbp_restriction_content(node, &value) : emsmdbp_restriction_property(node, &value);
+	}
+}
+
+static uint32_t emsmdbp_restriction_size(uint32_t tag, const void *data)
+{
+	switch (tag & 0xFFFF) {
+	case PT_I2:
+	case PT_BOOLEAN:
+		return 2;
+	case PT_LONG:
+		return 4;
+	case PT_I8:
+	case PT_SYSTIME:
+	case PT_DOUBLE:
+		return 8;
+	case PT_CLSID:
+		return 16;
+	case PT_STRING8:
+		return strlen((const char *) data) + 1;
+	case PT_UNICODE:
+		/* stored as UTF-8 but sized as UTF-16, exact for ASCII strings */
+		return (strlen((const char *) data) + 1) * 2;
+	case PT_BINARY:
+	case PT_SVREID:
+		return ((const struct Binary_r *) data)->cb;
+	default:
+		return 0;
+	}
+}
+
+static bool emsmdbp_restriction_match_node(struct emsmdbp_restriction *restriction, uint32_t idx,
+					   void **data_pointers, enum MAPISTATUS *retvals)
+{
+	struct emsmdbp_restriction_node		*node = &restriction->nodes[idx];
+	struct emsmdbp_restriction_value	value1;
+	struct emsmdbp_restriction_value	value2;
+	enum MAPITAGS				*tags = restriction->columns->aulPropTag;
+	const void				*data = NULL;
+	uint32_t				child;
+	uint32_t				size;
+	uint32_t				i;
+	int					cmp;
+
+#define	COLUMN_PRESENT(col) (data_pointers[col] && (!retvals || retvals[col] == MAPI_E_SUCCESS))
+
+	switch (node->rt) {
+	case RES_AND:
+		for (i = 0, child = idx + 1; i < node->count; i++, child = restriction->nodes[child].next) {
+			if (!emsmdbp_restriction_match_node(restriction, child, data_pointers, retvals)) return false;
+		}
+		return true;
+	case RES_OR:
+		for (i = 0, child = idx + 1; i < node->count; i++, child = restriction->nodes[child].next) {
+			if (emsmdbp_restriction_match_node(restriction, child, data_pointers, retvals)) return true;
+		}
+		return false;
+	case RES_NOT:
+		return !emsmdbp_restriction_match_node(restriction, idx + 1, data_pointers, retvals);
+	case RES_COMMENT:
+		if (!node->count) return true;
+		return emsmdbp_restriction_match_node(restriction, idx + 1, data_pointers, retvals);
+	case RES_EXIST:
+		return COLUMN_PRESENT(node->column);
+	case RES_SUBRESTRICTION:
+		return false;
+	default:
+		break;
+	}
+
+	/* the remaining restrictions never match a missing property */
+	if (!COLUMN_PRESENT(node->column)) return false;
+	data = data_pointers[node->column];
+
+	switch (node->rt) {
+	case RES_CONTENT:
+	case RES_PROPERTY:
+		return emsmdbp_restriction_match_values(node, tags[node->column], data);
+	case RES_BITMASK:
+		if (!emsmdbp_restriction_get_value(tags[node->column] & 0xFFFF, data, &value1)
+		    || value1.type != EMSMDBP_RESTRICTION_INTEGER) {
+			return false;
+		}
+		return (node->relop == BMR_EQZ) ? !(value1.i & node->mask) : !!(value1.i & node->mask);
+	case RES_SIZE:
+		size = emsmdbp_restriction_size(tags[node->column], data);
+		return emsmdbp_restriction_relop(node->relop, (size < node->mask) ? -1 : (size > node->mask));
+	case RES_COMPAREPROPS:
+		if (!COLUMN_PRESENT(node->column2)) return false;
+		if (!emsmdbp_restriction_get_value(tags[node->column] & 0xFFFF, data, &value1)
+		    || !emsmdbp_restriction_get_value(tags[node->column2] & 0xFFFF, data_pointers[node->column2], &value2)
+		    || !emsmdbp_restriction_order(&value1, &value2, true, &cmp)) {
+			return false;
+		}
+		return emsmdbp_restriction_relop(node->relop, cmp);
+	default:
+		return false;
+	}
+
+#undef	COLUMN_PRESENT
+}
+
+/**
+   \details Match a message against a compiled restriction
+
+   \param restriction pointer to the compiled restriction
+   \param data_pointers the values of the restriction columns
+   \param retvals the status of each column, NULL if all columns were
+   retrieved
+
+   \return true if the message matches, otherwise false
+ */
+_PUBLIC_ bool emsmdbp_restriction_match(struct emsmdbp_restriction *restriction, void **data_pointers, enum MAPISTATUS *retvals)
+{
+	/* Sanity checks */
+	if (!restriction || !restriction->count) return true;
+	if (!data_pointers) return false;
+
+	return emsmdbp_restriction_match_node(restriction, 0, data_pointers, retvals);
+}
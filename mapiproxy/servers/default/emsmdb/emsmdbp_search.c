@@ -0,0 +1,443 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_search.c
+
+   \brief Search folders state
+
+   A search folder is created by the first SetSearchCriteria call on
+   a folder and lives as long as the emsmdbp context. It holds the
+   compiled restriction, the sorted set of searched folders, the
+   folders still to be populated and the matching messages, sorted
+   by message identifier.
+
+   Populating the folder and following mapistore notifications is
+   done by the emsmdbp_object_search_* routines in emsmdbp_object.c,
+   which read messages through the regular folder and table objects.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "libmapi/property_tags.h"
+
+#include "dcesrv_exchange_emsmdb.h"
+
+/**
+   \details Find the search folder of a folder
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param fid the folder identifier
+
+   \return the search folder on success, otherwise NULL
+ */
+_PUBLIC_ struct emsmdbp_search_folder *emsmdbp_search_find(struct emsmdbp_context *emsmdbp_ctx, uint64_t fid)
+{
+	struct emsmdbp_search_folder	*search;
+
+	if (!emsmdbp_ctx) return NULL;
+
+	for (search = emsmdbp_ctx->searches; search; search = search->next) {
+		if (search->folderID == fid) {
+			return search;
+		}
+	}
+
+	return NULL;
+}
+
+static int emsmdbp_search_destructor(struct emsmdbp_search_folder *search)
+{
+	/* the population table refers to objects owned by the search folder */
+	talloc_free(search->table);
+
+	return 0;
+}
+
+/**
+   \details Create the search folder of a folder, without criteria
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param fid the folder identifier
+
+   \return the new search folder on success, otherwise NULL
+ */
+_PUBLIC_ struct emsmdbp_search_folder *emsmdbp_search_add(struct emsmdbp_context *emsmdbp_ctx, uint64_t fid)
+{
+	struct emsmdbp_search_folder	*search;
+
+	if (!emsmdbp_ctx) return NULL;
+
+	search = talloc_zero(emsmdbp_ctx->mem_ctx, struct emsmdbp_search_folder);
+	if (!search) return NULL;
+
+	search->folderID = fid;
+	talloc_set_destructor(search, emsmdbp_search_destructor);
+	DLIST_ADD(emsmdbp_ctx->searches, search);
+
+	return search;
+}
+
+/**
+   \details Drop the search folder of a folder
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param fid the folder identifier
+ */
+_PUBLIC_ void emsmdbp_search_del(struct emsmdbp_context *emsmdbp_ctx, uint64_t fid)
+{
+	struct emsmdbp_search_folder	*search;
+
+	search = emsmdbp_search_find(emsmdbp_ctx, fid);
+	if (!search) return;
+
+	DLIST_REMOVE(emsmdbp_ctx->searches, search);
+	talloc_free(search);
+}
+
+static bool emsmdbp_search_bsearch_fid(uint64_t *fids, uint32_t count, uint64_t fid, uint32_t *idx)
+{
+	uint32_t	low = 0;
+	uint32_t	high = count;
+	uint32_t	mid;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (fids[mid] == fid) {
+			*idx = mid;
+			return true;
+		}
+		if (fids[mid] < fid) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	*idx = low;
+
+	return false;
+}
+
+static bool emsmdbp_search_bsearch_mid(struct emsmdbp_search_result *results, uint32_t count, uint64_t mid, uint32_t *idx)
+{
+	uint32_t	low = 0;
+	uint32_t	high = count;
+	uint32_t	middle;
+
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (results[middle].mid == mid) {
+			*idx = middle;
+			return true;
+		}
+		if (results[middle].mid < mid) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	*idx = low;
+
+	return false;
+}
+
+/**
+   \details Check whether a folder is searched
+
+   \param search pointer to the search folder
+   \param fid the folder identifier
+
+   \return true if the folder is part of the search scope
+ */
+_PUBLIC_ bool emsmdbp_search_has_folder(struct emsmdbp_search_folder *search, uint64_t fid)
+{
+	uint32_t	idx;
+
+	return emsmdbp_search_bsearch_fid(search->folders, search->folders_count, fid, &idx);
+}
+
+/**
+   \details Add a folder to the search scope and queue it for
+   population
+
+   \param search pointer to the search folder
+   \param fid the folder identifier
+
+   \return true if the folder was added, false if it was already
+   searched or on memory error
+ */
+_PUBLIC_ bool emsmdbp_search_add_folder(struct emsmdbp_search_folder *search, uint64_t fid)
+{
+	uint64_t	*folders;
+	uint64_t	*pending;
+	uint32_t	idx;
+
+	if (emsmdbp_search_bsearch_fid(search->folders, search->folders_count, fid, &idx)) {
+		return false;
+	}
+
+	folders = talloc_realloc(search, search->folders, uint64_t, search->folders_count + 1);
+	if (!folders) return false;
+	search->folders = folders;
+
+	pending = talloc_realloc(search, search->pending, uint64_t, search->pending_count + 1);
+	if (!pending) return false;
+	search->pending = pending;
+
+	memmove(folders + idx + 1, folders + idx, (search->folders_count - idx) * sizeof (uint64_t));
+	folders[idx] = fid;
+	search->folders_count++;
+
+	pending[search->pending_count++] = fid;
+
+	return true;
+}
+
+/**
+   \details Remove a deleted folder from the search scope, with the
+   messages it held
+
+   \param search pointer to the search folder
+   \param fid the folder identifier
+ */
+_PUBLIC_ void emsmdbp_search_del_folder(struct emsmdbp_search_folder *search, uint64_t fid)
+{
+	uint32_t	idx;
+	uint32_t	i;
+	uint32_t	count;
+
+	if (!emsmdbp_search_bsearch_fid(search->folders, search->folders_count, fid, &idx)) {
+		return;
+	}
+
+	memmove(search->folders + idx, search->folders + idx + 1, (search->folders_count - idx - 1) * sizeof (uint64_t));
+	search->folders_count--;
+
+	for (i = 0, count = 0; i < search->pending_count; i++) {
+		if (search->pending[i] != fid) {
+			search->pending[count++] = search->pending[i];
+		}
+	}
+	search->pending_count = count;
+
+	for (i = 0, count = 0; i < search->results_count; i++) {
+		if (search->results[i].fid != fid) {
+			search->results[count++] = search->results[i];
+		}
+	}
+	search->results_count = count;
+}
+
+/**
+   \details Take the next folder to populate
+
+   \param search pointer to the search folder
+   \param fidp pointer to the folder identifier to return
+
+   \return true if a folder was returned, false if population is over
+ */
+_PUBLIC_ bool emsmdbp_search_next_folder(struct emsmdbp_search_folder *search, uint64_t *fidp)
+{
+	if (!search->pending_count) {
+		return false;
+	}
+
+	*fidp = search->pending[--search->pending_count];
+
+	return true;
+}
+
+/**
+   \details Add a message to the search results
+
+   \param search pointer to the search folder
+   \param mid the message identifier
+   \param fid the identifier of the folder holding the message
+
+   \return true on success, otherwise false
+ */
+_PUBLIC_ bool emsmdbp_search_add_result(struct emsmdbp_search_folder *search, uint64_t mid, uint64_t fid)
+{
+	struct emsmdbp_search_result	*results;
+	uint32_t			idx;
+	uint32_t			size;
+
+	if (emsmdbp_search_bsearch_mid(search->results, search->results_count, mid, &idx)) {
+		search->results[idx].fid = fid;
+		return true;
+	}
+
+	if (search->results_count == search->results_size) {
+		size = search->results_size ? search->results_size * 2 : 64;
+		results = talloc_realloc(search, search->results, struct emsmdbp_search_result, size);
+		if (!results) return false;
+		search->results = results;
+		search->results_size = size;
+	}
+
+	memmove(search->results + idx + 1, search->results + idx,
+		(search->results_count - idx) * sizeof (struct emsmdbp_search_result));
+	search->results[idx].mid = mid;
+	search->results[idx].fid = fid;
+	search->results_count++;
+
+	return true;
+}
+
+/**
+   \details Remove a message from the search results
+
+   \param search pointer to the search folder
+   \param mid the message identifier
+
+   \return true if the message was part of the results, otherwise false
+ */
+_PUBLIC_ bool emsmdbp_search_del_result(struct emsmdbp_search_folder *search, uint64_t mid)
+{
+	uint32_t	idx;
+
+	if (!emsmdbp_search_bsearch_mid(search->results, search->results_count, mid, &idx)) {
+		return false;
+	}
+
+	memmove(search->results + idx, search->results + idx + 1,
+		(search->results_count - idx - 1) * sizeof (struct emsmdbp_search_result));
+	search->results_count--;
+
+	return true;
+}
+
+/**
+   \details Return a row of the search folder contents table. Rows
+   are returned most recent message first.
+
+   \param search pointer to the search folder
+   \param row_id the row index
+
+   \return the search result on success, otherwise NULL
+ */
+_PUBLIC_ struct emsmdbp_search_result *emsmdbp_search_get_result(struct emsmdbp_search_folder *search, uint32_t row_id)
+{
+	if (row_id >= search->results_count) {
+		return NULL;
+	}
+
+	return &search->results[search->results_count - row_id - 1];
+}
+
+/**
+   \details Restart the search: results are dropped and every folder
+   of the scope is queued for population again
+
+   \param search pointer to the search folder
+ */
+_PUBLIC_ void emsmdbp_search_restart(struct emsmdbp_search_folder *search)
+{
+	uint32_t	i;
+
+	talloc_free(search->table);
+	search->table = NULL;
+
+	search->results_count = 0;
+	search->folders_count = 0;
+	search->pending_count = 0;
+	for (i = 0; i < search->scope_count; i++) {
+		emsmdbp_search_add_folder(search, search->scope[i]);
+	}
+
+	search->state = SEARCH_RUNNING | SEARCH_REBUILD;
+	if (search->search_flags & RECURSIVE_SEARCH) {
+		search->state |= SEARCH_RECURSIVE;
+	}
+}
+
+/**
+   \details Stop the search: results are kept but no longer updated
+
+   \param search pointer to the search folder
+ */
+_PUBLIC_ void emsmdbp_search_stop(struct emsmdbp_search_folder *search)
+{
+	talloc_free(search->table);
+	search->table = NULL;
+
+	search->pending_count = 0;
+	search->state &= ~(SEARCH_RUNNING | SEARCH_REBUILD);
+}
+
+/**
+   \details Set the criteria of a search folder and restart the
+   search, unless it is stopped
+
+   \param search pointer to the search folder
+   \param res pointer to the restriction
+   \param folder_count the number of folders in fids, 0 keeps the
+   current scope
+   \param fids the identifiers of the folders to search
+   \param flags the SetSearchCriteria search flags
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_search_set_criteria(struct emsmdbp_search_folder *search, struct mapi_SRestriction *res,
+						     uint16_t folder_count, uint64_t *fids, uint32_t flags)
+{
+	struct emsmdbp_restriction	*restriction;
+	enum ndr_err_code		ndr_err;
+	DATA_BLOB			criteria;
+	uint64_t			*scope;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!search, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!res, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!folder_count && !search->scope_count, MAPI_E_NOT_INITIALIZED, NULL);
+
+	restriction = emsmdbp_restriction_compile(search, res);
+	OPENCHANGE_RETVAL_IF(!restriction, MAPI_E_TOO_COMPLEX, NULL);
+
+	ndr_err = ndr_push_struct_blob(&criteria, search, res, (ndr_push_flags_fn_t)ndr_push_mapi_SRestriction);
+	OPENCHANGE_RETVAL_IF(!NDR_ERR_CODE_IS_SUCCESS(ndr_err), MAPI_E_INVALID_PARAMETER, restriction);
+
+	if (folder_count) {
+		scope = talloc_memdup(search, fids, folder_count * sizeof (uint64_t));
+		if (!scope) {
+			talloc_free(restriction);
+			talloc_free(criteria.data);
+			return MAPI_E_NOT_ENOUGH_MEMORY;
+		}
+		talloc_free(search->scope);
+		search->scope = scope;
+		search->scope_count = folder_count;
+	}
+
+	talloc_free(search->restriction);
+	search->restriction = restriction;
+	talloc_free(search->criteria.data);
+	search->criteria = criteria;
+	search->search_flags = flags;
+
+	if (flags & STOP_SEARCH) {
+		emsmdbp_search_stop(search);
+	} else {
+		emsmdbp_search_restart(search);
+	}
+
+	return MAPI_E_SUCCESS;
+}
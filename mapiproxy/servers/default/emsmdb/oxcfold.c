@@ -693,6 +693,9 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopDeleteMessages(TALLOC_CTX *mem_ctx,
 			mapi_repl->error_code = MAPI_E_CALL_FAILED;
 			goto delete_message_response;
 		}
+
+		emsmdbp_object_search_message_notify(emsmdbp_ctx, MAPISTORE_OBJECT_DELETED,
+						     parent_object->object.folder->folderID, mid, 0, 0);
 	}
 
 delete_message_response:
@@ -723,6 +726,14 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSetSearchCriteria(TALLOC_CTX *mem_ctx,
 						      struct EcDoRpc_MAPI_REPL *mapi_repl,
 						      uint32_t *handles, uint16_t *size)
 {
+	struct SetSearchCriteria_req	*request;
+	struct mapi_handles		*rec = NULL;
+	void				*private_data;
+	struct emsmdbp_object		*folder_object;
+	struct emsmdbp_search_folder	*search;
+	enum MAPISTATUS			retval;
+	uint32_t			count;
+
 	DEBUG(4, ("exchange_emsmdb: [OXCFOLD] SetSearchCriteria (0x30)\n"));
 
 	/* Sanity checks */
@@ -736,8 +747,53 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSetSearchCriteria(TALLOC_CTX *mem_ctx,
 	mapi_repl->handle_idx = mapi_req->handle_idx;
 	mapi_repl->error_code = MAPI_E_SUCCESS;
 
-	/* TODO: actually implement this */
+	request = &mapi_req->u.mapi_SetSearchCriteria;
+
+	retval = mapi_handles_search(emsmdbp_ctx->handles_ctx, handles[mapi_req->handle_idx], &rec);
+	if (retval) {
+		mapi_repl->error_code = MAPI_E_INVALID_OBJECT;
+		goto end;
+	}
+
+	mapi_handles_get_private_data(rec, &private_data);
+	folder_object = (struct emsmdbp_object *) private_data;
+	if (!folder_object || folder_object->type != EMSMDBP_OBJECT_FOLDER) {
+		mapi_repl->error_code = MAPI_E_NO_SUPPORT;
+		goto end;
+	}
+
+	if (!emsmdbp_object_is_search_folder(folder_object)) {
+		DEBUG(5, ("  folder 0x%.16"PRIx64" is not a search folder\n", folder_object->object.folder->folderID));
+		mapi_repl->error_code = MAPI_E_NO_SUPPORT;
+		goto end;
+	}
+
+	search = emsmdbp_object_search_open(folder_object);
+	if (!search) {
+		mapi_repl->error_code = MAPI_E_NOT_ENOUGH_MEMORY;
+		goto end;
+	}
 
+	retval = emsmdbp_search_set_criteria(search, &request->res, request->FolderIdCount, request->FolderIds, request->SearchFlags);
+	if (retval) {
+		/* a folder never set up for searching is left untouched */
+		if (!search->restriction) {
+			emsmdbp_search_del(emsmdbp_ctx, search->folderID);
+		}
+		mapi_repl->error_code = retval;
+		goto end;
+	}
+
+	/* otherwise the search is populated in slices, after each EcDoRpc call */
+	if (request->SearchFlags & FOREGROUND_SEARCH) {
+		retval = emsmdbp_object_search_populate(emsmdbp_ctx, search, UINT32_MAX, &count);
+		if (retval) {
+			mapi_repl->error_code = retval;
+			goto end;
+		}
+	}
+
+end:
 	*size += libmapiserver_RopSetSearchCriteria_size(mapi_repl);
 
 	return MAPI_E_SUCCESS;
@@ -765,7 +821,14 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopGetSearchCriteria(TALLOC_CTX *mem_ctx,
 						      struct EcDoRpc_MAPI_REPL *mapi_repl,
 						      uint32_t *handles, uint16_t *size)
 {
-	/* struct mapi_SRestriction *res; */
+	struct GetSearchCriteria_req	*request;
+	struct GetSearchCriteria_repl	*response;
+	struct mapi_handles		*rec = NULL;
+	void				*private_data;
+	struct emsmdbp_object		*folder_object;
+	struct emsmdbp_search_folder	*search;
+	enum ndr_err_code		ndr_err;
+	enum MAPISTATUS			retval;
 
 	DEBUG(4, ("exchange_emsmdb: [OXCFOLD] GetSearchCriteria (0x31)\n"));
 
@@ -780,15 +843,52 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopGetSearchCriteria(TALLOC_CTX *mem_ctx,
 	mapi_repl->handle_idx = mapi_req->handle_idx;
 	mapi_repl->error_code = MAPI_E_SUCCESS;
 
-	/* res = NULL; */
-	mapi_repl->u.mapi_GetSearchCriteria.RestrictionDataSize = 0;
-	mapi_repl->u.mapi_GetSearchCriteria.LogonId = mapi_req->logon_id;
-	mapi_repl->u.mapi_GetSearchCriteria.FolderIdCount = 0;
-	mapi_repl->u.mapi_GetSearchCriteria.FolderIds = NULL;
-	mapi_repl->u.mapi_GetSearchCriteria.SearchFlags = 0;
+	request = &mapi_req->u.mapi_GetSearchCriteria;
+	response = &mapi_repl->u.mapi_GetSearchCriteria;
 
-	/* TODO: actually implement this */
+	response->RestrictionDataSize = 0;
+	response->LogonId = mapi_req->logon_id;
+	response->FolderIdCount = 0;
+	response->FolderIds = NULL;
+	response->SearchFlags = 0;
 
+	retval = mapi_handles_search(emsmdbp_ctx->handles_ctx, handles[mapi_req->handle_idx], &rec);
+	if (retval) {
+		mapi_repl->error_code = MAPI_E_INVALID_OBJECT;
+		goto end;
+	}
+
+	mapi_handles_get_private_data(rec, &private_data);
+	folder_object = (struct emsmdbp_object *) private_data;
+	if (!folder_object || folder_object->type != EMSMDBP_OBJECT_FOLDER) {
+		mapi_repl->error_code = MAPI_E_NO_SUPPORT;
+		goto end;
+	}
+
+	/* folders without criteria are reported as an empty search */
+	search = emsmdbp_search_find(emsmdbp_ctx, folder_object->object.folder->folderID);
+	if (!search || !search->restriction) {
+		goto end;
+	}
+
+	if (request->IncludeRestriction) {
+		ndr_err = ndr_pull_struct_blob(&search->criteria, mem_ctx, &response->RestrictionData,
+					       (ndr_pull_flags_fn_t)ndr_pull_mapi_SRestriction);
+		if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+			mapi_repl->error_code = MAPI_E_CALL_FAILED;
+			goto end;
+		}
+		response->RestrictionDataSize = search->criteria.length;
+	}
+
+	if (request->IncludeFolders) {
+		response->FolderIdCount = search->scope_count;
+		response->FolderIds = talloc_memdup(mem_ctx, search->scope, search->scope_count * sizeof (uint64_t));
+	}
+
+	response->SearchFlags = search->state;
+
+end:
 	*size += libmapiserver_RopGetSearchCriteria_size(mapi_repl);
 
 	return MAPI_E_SUCCESS;
@@ -944,6 +1044,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopMoveCopyMessages(TALLOC_CTX *mem_ctx,
 						     uint32_t *handles, uint16_t *size)
 {
 	enum MAPISTATUS		retval;
+	enum mapistore_error	ret;
 	uint32_t		handle;
 	uint32_t                contextID;
 	struct mapi_handles	*rec = NULL;
@@ -1015,7 +1116,16 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopMoveCopyMessages(TALLOC_CTX *mem_ctx,
 		}
 
 		/* We invoke the backend method */
-		mapistore_folder_move_copy_messages(emsmdbp_ctx->mstore_ctx, contextID, destination_object->backend_object, source_object->backend_object, mem_ctx, mapi_req->u.mapi_MoveCopyMessages.count, mapi_req->u.mapi_MoveCopyMessages.message_id, targetMIDs, NULL, mapi_req->u.mapi_MoveCopyMessages.WantCopy);
+		ret = mapistore_folder_move_copy_messages(emsmdbp_ctx->mstore_ctx, contextID, destination_object->backend_object, source_object->backend_object, mem_ctx, mapi_req->u.mapi_MoveCopyMessages.count, mapi_req->u.mapi_MoveCopyMessages.message_id, targetMIDs, NULL, mapi_req->u.mapi_MoveCopyMessages.WantCopy);
+		if (ret == MAPISTORE_SUCCESS
+		    && destination_object->type == EMSMDBP_OBJECT_FOLDER && source_object->type == EMSMDBP_OBJECT_FOLDER) {
+			for (i = 0; i < mapi_req->u.mapi_MoveCopyMessages.count; i++) {
+				emsmdbp_object_search_message_notify(emsmdbp_ctx,
+								     mapi_req->u.mapi_MoveCopyMessages.WantCopy ? MAPISTORE_OBJECT_COPIED : MAPISTORE_OBJECT_MOVED,
+								     destination_object->object.folder->folderID, targetMIDs[i],
+								     source_object->object.folder->folderID, mapi_req->u.mapi_MoveCopyMessages.message_id[i]);
+			}
+		}
 		talloc_free(targetMIDs);
 
 		/* /\* The backend might do this for us. In any case, we try to add it ourselves *\/ */
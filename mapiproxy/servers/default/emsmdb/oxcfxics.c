@@ -32,8 +32,7 @@
 /* a constant time offset by which the first change number ever can be produced by OpenChange */
 #define oc_version_time 0x4dbb2dbe
 
-/* the maximum buffer that will be populated during msg synchronization operations (note: this is a soft limit) */
-static const size_t max_message_sync_size = 262144;
+/* the amount of messages whose bodies are preloaded at once, as the sync cursor walks the mids snapshot */
 static const uint32_t message_preload_interval = 150;
 
 /** notes:
@@ -85,6 +84,10 @@ struct oxcfxics_sync_data {
 	struct oxcfxics_message_sync_data	*message_sync_data;
 };
 
+/* cursor over the mids of a contents synchronization: the mids matching
+   the cn restriction are read once when the synchronization starts, so that
+   the messages rendered by successive chunks are those of the same table
+   snapshot */
 struct oxcfxics_message_sync_data {
 	uint64_t	*mids;
 	uint64_t	count;
@@ -776,20 +779,20 @@ static void oxcfxics_table_set_cn_restriction(struct emsmdbp_context *emsmdbp_ct
 	cn_restriction.res.resProperty.relop = RELOP_GT;
 	cn_restriction.res.resProperty.ulPropTag = PidTagChangeNumber;
 	cn_restriction.res.resProperty.lpProp.ulPropTag = PidTagChangeNumber;
-	cn_restriction.res.resProperty.lpProp.value.d = (cnset_seen->ranges[0].high << 16) | repl_id;
+	cn_restriction.res.resProperty.lpProp.value.d = (exchange_globcnt(local_cnset->ranges[0].high) << 16) | repl_id;
 
 	mapistore_table_set_restrictions(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(table_object), table_object->backend_object, &cn_restriction, &state);
 }
 
-static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object_synccontext *synccontext, const char *owner, struct oxcfxics_sync_data *sync_data, struct emsmdbp_object *folder_object)
+static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object_synccontext *synccontext, const char *owner, struct oxcfxics_sync_data *sync_data, struct emsmdbp_object *folder_object, size_t max_size)
 {
 	TALLOC_CTX			*mem_ctx, *msg_ctx;
 	bool				folder_is_mapistore, end_of_table;
 	struct emsmdbp_object		*table_object, *message_object;
-	uint32_t			i;
+	uint32_t			i, j, batch;
 	static enum MAPITAGS		mid_property = PidTagMid;
-	enum MAPISTATUS			*retvals, *header_retvals;
-	void				**data_pointers, **header_data_pointers;
+	enum MAPISTATUS			*retvals, *header_retvals, **rows_retvals;
+	void				**data_pointers, **header_data_pointers, ***rows;
 	struct FILETIME			*lm_time;
 	NTTIME				nt_time;
 	uint32_t			unix_time, contextID;
@@ -824,7 +827,7 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 		message_sync_data = sync_data->message_sync_data;
 	}
 	else {
-		message_sync_data = talloc_zero(NULL, struct oxcfxics_message_sync_data);
+		message_sync_data = talloc_zero(sync_data, struct oxcfxics_message_sync_data);
 		sync_data->message_sync_data = message_sync_data;
 
 		/* we only push "messageChangeFull" since we don't handle property-based changes */
@@ -850,14 +853,34 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 			DEBUG(5, ("push_messageChange: %d objects in table\n", table_object->object.table->denominator));
 			/* fetch maching mids */
 			message_sync_data->mids = talloc_array(message_sync_data, uint64_t, table_object->object.table->denominator);
-			for (i = 0; i < table_object->object.table->denominator; i++) {
-				data_pointers = emsmdbp_object_table_get_row_props(mem_ctx, emsmdbp_ctx, table_object, i, MAPISTORE_PREFILTERED_QUERY, &retvals);
-				if (data_pointers) {
-					if (retvals[0] == MAPI_E_SUCCESS) {
-						message_sync_data->mids[message_sync_data->max] = *(uint64_t *) data_pointers[0];
+			for (i = 0; i < table_object->object.table->denominator; i += batch) {
+				batch = table_object->object.table->denominator - i;
+				if (batch > EMSMDBP_TABLE_ROWS_BATCH) {
+					batch = EMSMDBP_TABLE_ROWS_BATCH;
+				}
+				rows = emsmdbp_object_table_get_rows_props(NULL, emsmdbp_ctx, table_object, i, batch, MAPISTORE_PREFILTERED_QUERY, &rows_retvals);
+				if (!rows) {
+					/* the cnset covers every message of the table: fall back on reading the rows one by one */
+					DEBUG(5, ("push_messageChange: rows %u to %u could not be fetched at once\n", i, i + batch - 1));
+					for (j = 0; j < batch; j++) {
+						data_pointers = emsmdbp_object_table_get_row_props(mem_ctx, emsmdbp_ctx, table_object, i + j, MAPISTORE_PREFILTERED_QUERY, &retvals);
+						if (data_pointers) {
+							if (retvals[0] == MAPI_E_SUCCESS) {
+								message_sync_data->mids[message_sync_data->max] = *(uint64_t *) data_pointers[0];
+								message_sync_data->max++;
+							}
+							talloc_free(data_pointers);
+						}
+					}
+					continue;
+				}
+				for (j = 0; j < batch; j++) {
+					if (rows[j] && rows_retvals[j][0] == MAPI_E_SUCCESS) {
+						message_sync_data->mids[message_sync_data->max] = *(uint64_t *) rows[j][0];
 						message_sync_data->max++;
 					}
 				}
+				talloc_free(rows);
 			}
 		}
 
@@ -869,10 +892,11 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 		contextID = emsmdbp_get_contextID(folder_object);
 	}
 
-	/* open each message and fetch properties */
-	for (; sync_data->ndr->offset < max_message_sync_size && message_sync_data->count < message_sync_data->max; message_sync_data->count++) {
+	/* open each message and fetch properties, until the requested amount of data is produced */
+	for (; sync_data->ndr->offset < max_size && message_sync_data->count < message_sync_data->max; message_sync_data->count++) {
 		msg_ctx = talloc_zero(NULL, TALLOC_CTX);
 
+		/* the bodies of the next messages are preloaded when the cursor reaches the end of the previous batch */
 		if (folder_is_mapistore && (message_sync_data->count % message_preload_interval) == 0) {
 			preload_mids.lpui8 = message_sync_data->mids + message_sync_data->count;
 			if ((message_sync_data->count + message_preload_interval) < message_sync_data->max) {
@@ -1051,19 +1075,15 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 		talloc_free(msg_ctx);
 	}
 
-	if (sync_data->ndr->offset >= max_message_sync_size) {
-		DEBUG(5, ("reached max sync size: %u >= %zu\n", sync_data->ndr->offset, max_message_sync_size));
-	}
-
 	if (message_sync_data->count < message_sync_data->max) {
 		end_of_table = false;
-		DEBUG(5, ("table status: count: %"PRId64", max: %"PRId64"\n", message_sync_data->count, message_sync_data->max));
+		DEBUG(5, ("table status: count: %"PRId64", max: %"PRId64", buffer: %u >= %zu\n", message_sync_data->count, message_sync_data->max, sync_data->ndr->offset, max_size));
 	}
 	else {
 		/* fetch deleted ids */
 		if (folder_is_mapistore) {
 			if (original_cnset_seen && original_cnset_seen->range_count > 0) {
-				cn = (original_cnset_seen->ranges[0].high << 16) | 0x0001;
+				cn = (exchange_globcnt(original_cnset_seen->ranges[0].high) << 16) | 0x0001;
 			}
 			else {
 				cn = 0;
@@ -1090,7 +1110,13 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 	return end_of_table;
 }
 
-static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_synccontext *synccontext, TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, const char *owner, struct emsmdbp_object *parent_object)
+/**
+   \details Produce the next chunk of a contents synchronization stream. The
+   mids snapshot is walked from where the previous chunk stopped and messages
+   are rendered until the chunk holds at least max_size bytes, the last chunk
+   being the one where the deletions, the state and IncrSyncEnd are appended.
+ */
+static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_synccontext *synccontext, TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, const char *owner, struct emsmdbp_object *parent_object, size_t max_size)
 {
 	struct oxcfxics_sync_data	*sync_data;
 	struct idset			*new_idset, *old_idset;
@@ -1099,7 +1125,7 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 
 	if (synccontext->sync_stage == 0) {
 		/* 1. we setup the mandatory properties indexes */
-		sync_data = talloc_zero(NULL, struct oxcfxics_sync_data);
+		sync_data = talloc_zero(synccontext, struct oxcfxics_sync_data);
 		openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, owner, NULL, &sync_data->replica_guid);
 		SPropTagArray_find(synccontext->properties, PidTagMid, &sync_data->prop_index.eid);
 		SPropTagArray_find(synccontext->properties, PidTagChangeNumber, &sync_data->prop_index.change_number);
@@ -1132,11 +1158,11 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 		/* 2a. we build the message stream (normal messages) */
 		if (synccontext->request.normal) {
 			if (!sync_data->message_sync_data) {
-				sync_data->cnset_seen = RAWIDSET_make(NULL, false, true);
+				sync_data->cnset_seen = RAWIDSET_make(sync_data, false, true);
 				sync_data->table_type = MAPISTORE_MESSAGE_TABLE;
 			}
 
-			if (oxcfxics_push_messageChange(emsmdbp_ctx, synccontext, owner, sync_data, parent_object)) {
+			if (oxcfxics_push_messageChange(emsmdbp_ctx, synccontext, owner, sync_data, parent_object, max_size)) {
 				new_idset = RAWIDSET_convert_to_idset(NULL, sync_data->cnset_seen);
 				old_idset = synccontext->cnset_seen;
 				/* IDSET_dump (synccontext->cnset_seen, "initial cnset_seen"); */
@@ -1157,11 +1183,11 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 		/* 2b. we build the message stream (FAI messages) */
 		if (synccontext->request.fai) {
 			if (!sync_data->message_sync_data) {
-				sync_data->cnset_seen = RAWIDSET_make(NULL, false, true);
+				sync_data->cnset_seen = RAWIDSET_make(sync_data, false, true);
 				sync_data->table_type = MAPISTORE_FAI_TABLE;
 			}
 
-			if (oxcfxics_push_messageChange(emsmdbp_ctx, synccontext, owner, sync_data, parent_object)) {
+			if (oxcfxics_push_messageChange(emsmdbp_ctx, synccontext, owner, sync_data, parent_object, max_size)) {
 				new_idset = RAWIDSET_convert_to_idset(NULL, sync_data->cnset_seen);
 				old_idset = synccontext->cnset_seen_fai;
 				/* IDSET_dump (synccontext->cnset_seen, "initial cnset_seen_fai"); */
@@ -1642,7 +1668,7 @@ static inline void oxcfxics_fill_synccontext_fasttransfer_response(struct FastTr
 			}
 			else if (synccontext->sync_stage == 0) {
 				/* no chunk sent yet, so we create a new one */
-				oxcfxics_fill_synccontext_with_messageChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object);
+				oxcfxics_fill_synccontext_with_messageChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object, request_buffer_size);
 				oxcfxics_check_cutmark_buffer(synccontext->cutmarks, &synccontext->stream.buffer);
 				if (request_buffer_size < synccontext->stream.buffer.length) {
 					buffer_size = oxcfxics_advance_cutmarks(synccontext, request_buffer_size);
@@ -1652,9 +1678,6 @@ static inline void oxcfxics_fill_synccontext_fasttransfer_response(struct FastTr
 					if (synccontext->sync_stage == 4) {
 						end_of_buffer = true;
 					}
-					else {
-						abort();
-					}
 				}
 				response->TransferBuffer = emsmdbp_stream_read_buffer(&synccontext->stream, buffer_size);
 			}
@@ -1662,23 +1685,23 @@ static inline void oxcfxics_fill_synccontext_fasttransfer_response(struct FastTr
 				/* we have reached the end of a middle chunk, we must thus finish it and complete the buffer with the content of the next chunk */
 				old_chunk_size = synccontext->stream.buffer.length - synccontext->stream.position;
 
+				joint_buffer.length = 0;
+				joint_buffer.data = NULL;
 				if (old_chunk_size > 0) {
 					joint_buffer.length = old_chunk_size;
 					joint_buffer.data = talloc_memdup(mem_ctx, synccontext->stream.buffer.data + synccontext->stream.position, joint_buffer.length);
 				}
 
-				oxcfxics_fill_synccontext_with_messageChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object);
+				/* only what is needed to complete the response is produced */
+				new_chunk_size = request_buffer_size - old_chunk_size;
+				oxcfxics_fill_synccontext_with_messageChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object, new_chunk_size);
 				oxcfxics_check_cutmark_buffer(synccontext->cutmarks, &synccontext->stream.buffer);
 
-				new_chunk_size = request_buffer_size - old_chunk_size;
-				if (synccontext->stream.buffer.length < new_chunk_size) {
+				if (synccontext->stream.buffer.length <= new_chunk_size) {
 					new_chunk_size = synccontext->stream.buffer.length;
 					if (synccontext->sync_stage == 4) {
 						end_of_buffer = true;
 					}
-					else {
-						abort();
-					}
 				}
 				else {
 					new_chunk_size = oxcfxics_advance_cutmarks(synccontext, new_chunk_size);
@@ -2540,8 +2563,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncUploadStateStreamBegin(TALLOC_CTX *mem_c
 	}
 
 	synccontext_object->object.synccontext->state_property = property;
-	memset(&synccontext_object->object.synccontext->state_stream, 0, sizeof(struct emsmdbp_stream));
-	synccontext_object->object.synccontext->state_stream.buffer.data = talloc_zero(synccontext_object->object.synccontext, uint8_t);
+	emsmdbp_stream_release(&synccontext_object->object.synccontext->state_stream);
 
 end:
 	*size += libmapiserver_RopSyncUploadStateStreamBegin_size(mapi_repl);
@@ -2613,9 +2635,12 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncUploadStateStreamContinue(TALLOC_CTX *me
 	request = &mapi_req->u.mapi_SyncUploadStateStreamContinue;
 	new_data.length = request->StreamDataSize;
 	new_data.data = request->StreamData;
-	emsmdbp_stream_write_buffer(synccontext_object->object.synccontext,
-				    &synccontext_object->object.synccontext->state_stream,
-				    new_data);
+	retval = emsmdbp_stream_write_buffer(synccontext_object->object.synccontext,
+					     &synccontext_object->object.synccontext->state_stream,
+					     new_data);
+	if (retval) {
+		mapi_repl->error_code = retval;
+	}
 
 end:
 	*size += libmapiserver_RopSyncUploadStateStreamContinue_size(mapi_repl);
@@ -2627,10 +2652,10 @@ static void oxcfxics_check_cnset(struct ldb_context *oc_ctx, struct idset *parse
 {
 	uint64_t next_cn, high_cn;
 
-	if (parsed_idset) {
+	if (parsed_idset && parsed_idset->range_count > 0) {
 		openchangedb_get_next_changeNumber(oc_ctx, &next_cn);
 		next_cn = exchange_globcnt(next_cn >> 16);
-		high_cn = exchange_globcnt(parsed_idset->ranges->high);
+		high_cn = parsed_idset->ranges[parsed_idset->range_count - 1].high;
 		if (high_cn >= next_cn) {
 			DEBUG(0, ("inconsistency: idset range for '%s' is referencing a change number that has not been issued yet: %"PRIx64" >= %"PRIx64" \n", label, high_cn, next_cn));
 			abort();
@@ -2745,11 +2770,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncUploadStateStreamEnd(TALLOC_CTX *mem_ctx
 	}
 
 	/* reset synccontext state */
-	if (synccontext->state_stream.buffer.length > 0) {
-		talloc_free(synccontext->state_stream.buffer.data);
-		synccontext->state_stream.buffer.data = talloc_zero(synccontext, uint8_t);
-		synccontext->state_stream.buffer.length = 0;
-	}
+	emsmdbp_stream_release(&synccontext->state_stream);
 
 	synccontext->state_property = 0;
 
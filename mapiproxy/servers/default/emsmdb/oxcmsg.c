@@ -615,6 +615,9 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSaveChangesMessage(TALLOC_CTX *mem_ctx,
 		break;
 	}
 
+	emsmdbp_object_search_message_notify(emsmdbp_ctx, MAPISTORE_OBJECT_MODIFIED,
+					     object->object.message->folderID, object->object.message->messageID, 0, 0);
+
 	mapi_repl->u.mapi_SaveChangesMessage.handle_idx = mapi_req->u.mapi_SaveChangesMessage.handle_idx;
 	mapi_repl->u.mapi_SaveChangesMessage.MessageId = object->object.message->messageID;
 
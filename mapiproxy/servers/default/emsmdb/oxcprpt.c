@@ -807,7 +807,11 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopWriteStream(TALLOC_CTX *mem_ctx,
 
 	request = &mapi_req->u.mapi_WriteStream;
 	if (request->data.length > 0) {
-                emsmdbp_stream_write_buffer(object->object.stream, &object->object.stream->stream, request->data);
+		retval = emsmdbp_stream_write_buffer(object->object.stream, &object->object.stream->stream, request->data);
+		if (retval) {
+			mapi_repl->error_code = retval;
+			goto end;
+		}
 		mapi_repl->u.mapi_WriteStream.WrittenSize = request->data.length;
 	}
 
@@ -109,7 +109,10 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSetColumns(TALLOC_CTX *mem_ctx,
 			table->prop_count = request.prop_count;
 			table->properties = talloc_memdup(table, request.properties, 
 							  request.prop_count * sizeof (uint32_t));
-                        if (emsmdbp_is_mapistore(object)) {
+                        if (table->search) {
+				/* search folder rows are read from the messages */
+				DEBUG(5, ("[%s] object: Setting Columns on search folder table\n", __FUNCTION__));
+			} else if (emsmdbp_is_mapistore(object)) {
 				DEBUG(5, ("[%s] object: %p, backend_object: %p\n", __FUNCTION__, object, object->backend_object));
 				mapistore_table_set_columns(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(object),
 							    object->backend_object, request.prop_count, request.properties);
@@ -217,7 +220,12 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSortTable(TALLOC_CTX *mem_ctx,
 
 	/* If parent folder has a mapistore context */
 	request = &mapi_req->u.mapi_SortTable;
-	if (emsmdbp_is_mapistore(object)) {
+	if (table->search) {
+		/* search results are only listed newest first */
+		mapi_repl->error_code = MAPI_E_NO_SUPPORT;
+		DEBUG(5, ("  sorting search folder tables is not supported\n"));
+		goto end;
+	} else if (emsmdbp_is_mapistore(object)) {
 		status = TBLSTAT_COMPLETE;
 		retval = mapistore_table_set_sort_order(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(object), object->backend_object, &request->lpSortCriteria, &status);
                 if (retval) {
@@ -314,6 +322,12 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopRestrict(TALLOC_CTX *mem_ctx,
 	table = object->object.table;
 	OPENCHANGE_RETVAL_IF(!table, MAPI_E_INVALID_PARAMETER, NULL);
 
+	if (table->search) {
+		mapi_repl->error_code = MAPI_E_NO_SUPPORT;
+		DEBUG(5, ("  restrictions on search folder tables are not supported\n"));
+		goto end;
+	}
+
 	table->restricted = true;
 	if (table->ulType == MAPISTORE_RULE_TABLE) {
 		DEBUG(5, ("  query on rules table are all faked right now\n"));
@@ -336,8 +350,13 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopRestrict(TALLOC_CTX *mem_ctx,
 
 		/* Parent folder doesn't have any mapistore context associated */
 	} else {
-		DEBUG(0, ("not mapistore Restrict: Not implemented yet\n"));
-		goto end;
+		retval = openchangedb_table_set_restrictions(object->backend_object, &request.restrictions);
+		if (retval) {
+			mapi_repl->error_code = retval;
+			goto end;
+		}
+
+		openchangedb_table_get_row_count(object->backend_object, emsmdbp_ctx->oc_ctx, false, &object->object.table->denominator);
 	}
 
 end:
@@ -372,11 +391,11 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopQueryRows(TALLOC_CTX *mem_ctx,
 	struct QueryRows_repl		*response;
 	enum MAPISTATUS			retval;
 	void				*data;
-	enum MAPISTATUS			*retvals;
-	void				**data_pointers;
-	uint32_t			count, max;
+	enum MAPISTATUS			**retvals;
+	void				***rows;
+	uint32_t			count, max, batch;
 	uint32_t			handle;
-	uint32_t			i = 0;
+	uint32_t			i = 0, j;
 
 	DEBUG(4, ("exchange_emsmdb: [OXCTABL] QueryRows (0x15)\n"));
 
@@ -436,25 +455,35 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopQueryRows(TALLOC_CTX *mem_ctx,
 		abort();
 	}
 
+	emsmdbp_object_search_table_refresh(object);
+
         /* Lookup the properties */
 	max = table->numerator + request->RowCount;
 	if (max > table->denominator) {
 		max = table->denominator;
 	}
-        for (i = table->numerator; i < max; i++) {
-		data_pointers = emsmdbp_object_table_get_row_props(mem_ctx, emsmdbp_ctx, object, i, MAPISTORE_PREFILTERED_QUERY, &retvals);
-		if (data_pointers) {
-			emsmdbp_fill_table_row_blob(mem_ctx, emsmdbp_ctx,
-						    &response->RowData, table->prop_count,
-						    table->properties, data_pointers, retvals);
-			talloc_free(retvals);
-			talloc_free(data_pointers);
-			count++;
+	for (i = table->numerator; i < max;) {
+		batch = max - i;
+		if (batch > EMSMDBP_TABLE_ROWS_BATCH) {
+			batch = EMSMDBP_TABLE_ROWS_BATCH;
 		}
-		else {
+		rows = emsmdbp_object_table_get_rows_props(NULL, emsmdbp_ctx, object, i, batch, MAPISTORE_PREFILTERED_QUERY, &retvals);
+		if (!rows) {
 			count = 0;
 			goto finish;
 		}
+		for (j = 0; j < batch; j++, i++) {
+			if (!rows[j]) {
+				talloc_free(rows);
+				count = 0;
+				goto finish;
+			}
+			emsmdbp_fill_table_row_blob(mem_ctx, emsmdbp_ctx,
+						    &response->RowData, table->prop_count,
+						    table->properties, rows[j], retvals[j]);
+			count++;
+		}
+		talloc_free(rows);
 	}
 
 finish:
@@ -553,6 +582,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopQueryPosition(TALLOC_CTX *mem_ctx,
 	}
 
 	table = object->object.table;
+	emsmdbp_object_search_table_refresh(object);
 
         mapi_repl->u.mapi_QueryPosition.Numerator = table->numerator;
 	mapi_repl->u.mapi_QueryPosition.Denominator = table->denominator;
@@ -634,6 +664,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSeekRow(TALLOC_CTX *mem_ctx,
 	 * entire table, nor do we handle bookmarks */
 
 	table = object->object.table;
+	emsmdbp_object_search_table_refresh(object);
 	if (mapi_req->u.mapi_SeekRow.origin == BOOKMARK_BEGINNING) {
                 next_position = mapi_req->u.mapi_SeekRow.offset;
 	}
@@ -674,6 +705,97 @@ end:
 }
 
 
+/**
+   \details Move the table cursor to the next row matching the live
+   restriction and push its properties into the row blob. Rows are
+   fetched from the backend EMSMDBP_TABLE_ROWS_BATCH at a time.
+
+   \param mem_ctx pointer to the memory context
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param object pointer to the table object
+   \param row pointer to the PropertyRow blob to fill
+
+   \return MAPI_E_SUCCESS if a row was found, MAPI_E_NOT_FOUND if no
+   row matches, otherwise MAPI error. The cursor is left on the first
+   row of a batch the backend failed to return.
+ */
+static enum MAPISTATUS oxctabl_find_row(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx,
+					struct emsmdbp_object *object, DATA_BLOB *row)
+{
+	struct emsmdbp_object_table	*table;
+	enum MAPISTATUS			**retvals;
+	void				***rows;
+	enum MAPISTATUS			retval;
+	uint32_t			property;
+	void				*data;
+	uint32_t			batch, i, j;
+	uint8_t				flagged;
+
+	table = object->object.table;
+
+	while (table->numerator < table->denominator) {
+		batch = table->denominator - table->numerator;
+		if (batch > EMSMDBP_TABLE_ROWS_BATCH) {
+			batch = EMSMDBP_TABLE_ROWS_BATCH;
+		}
+		rows = emsmdbp_object_table_get_rows_props(NULL, emsmdbp_ctx, object, table->numerator, batch, MAPISTORE_LIVEFILTERED_QUERY, &retvals);
+		if (!rows) {
+			/* a matching row may be part of this batch */
+			DEBUG(5, ("  unable to fetch rows %d to %d\n", table->numerator, table->numerator + batch - 1));
+			return MAPI_E_CALL_FAILED;
+		}
+
+		for (j = 0; j < batch && !rows[j]; j++) {
+			table->numerator++;
+		}
+		if (j == batch) {
+			talloc_free(rows);
+			continue;
+		}
+
+		/* Lookup the properties and check if we need to flag the PropertyRow blob */
+		flagged = 0;
+		for (i = 0; i < table->prop_count; i++) {
+			if (retvals[j][i] != MAPI_E_SUCCESS) {
+				flagged = 1;
+			}
+		}
+
+		if (flagged) {
+			libmapiserver_push_property(mem_ctx,
+						    0x0000000b, (const void *)&flagged,
+						    row, 0, 0, 0);
+		}
+		else {
+			libmapiserver_push_property(mem_ctx,
+						    0x00000000, (const void *)&flagged,
+						    row, 0, 1, 0);
+		}
+
+		/* Push the properties */
+		for (i = 0; i < table->prop_count; i++) {
+			property = table->properties[i];
+			retval = retvals[j][i];
+			if (retval == MAPI_E_NOT_FOUND) {
+				property = (property & 0xFFFF0000) + PT_ERROR;
+				data = &retval;
+			}
+			else {
+				data = rows[j][i];
+			}
+
+			libmapiserver_push_property(mem_ctx,
+						    property, data, row,
+						    flagged?PT_ERROR:0, flagged, 0);
+		}
+		talloc_free(rows);
+
+		return MAPI_E_SUCCESS;
+	}
+
+	return MAPI_E_NOT_FOUND;
+}
+
 /**
    \details EcDoRpc FindRow (0x4f) Rop. This operation moves the
    cursor to a row in a table that matches specific search criteria.
@@ -696,18 +818,15 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopFindRow(TALLOC_CTX *mem_ctx,
 	struct mapi_handles		*parent;
 	struct emsmdbp_object		*object;
 	struct emsmdbp_object_table	*table;
+	struct openchangedb_table	*ocdb_table;
+	struct mapi_SRestriction	*saved_res;
 	struct FindRow_req		request;
 	enum MAPISTATUS			retval;
 	void				*data = NULL;
-	enum MAPISTATUS			*retvals;
-	void				**data_pointers;
 	uint32_t			handle;
 	DATA_BLOB			row;
-	uint32_t			property;
-	uint8_t				flagged;
 	uint8_t				status = 0;
-	uint32_t			i;
-	bool				found = false;
+	enum MAPISTATUS			found = MAPI_E_NOT_FOUND;
 
 	DEBUG(4, ("exchange_emsmdb: [OXCTABL] FindRow (0x4f)\n"));
 
@@ -760,6 +879,12 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopFindRow(TALLOC_CTX *mem_ctx,
 		goto end;
 	}
 
+	if (table->search) {
+		mapi_repl->error_code = MAPI_E_NO_SUPPORT;
+		DEBUG(5, ("  FindRow on search folder tables is not supported\n"));
+		goto end;
+	}
+
 	if (mapi_req->u.mapi_FindRow.origin == BOOKMARK_BEGINNING) {
 		table->numerator = 0;
 	}
@@ -777,61 +902,16 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopFindRow(TALLOC_CTX *mem_ctx,
 		/* Then fetch rows */
 		/* Lookup the properties and check if we need to flag the PropertyRow blob */
 
-		while (!found && table->numerator < table->denominator) {
-                        flagged = 0;
-
-			data_pointers = emsmdbp_object_table_get_row_props(NULL, emsmdbp_ctx, object, table->numerator, MAPISTORE_LIVEFILTERED_QUERY, &retvals);
-			if (data_pointers) {
-				found = true;
-				for (i = 0; i < table->prop_count; i++) {
-					if (retvals[i] != MAPI_E_SUCCESS) {
-						flagged = 1;
-					}
-				}
-
-				if (flagged) {
-					libmapiserver_push_property(mem_ctx, 
-								    0x0000000b, (const void *)&flagged,
-								    &row, 0, 0, 0);
-				}
-				else {
-					libmapiserver_push_property(mem_ctx, 
-								    0x00000000, (const void *)&flagged,
-								    &row, 0, 1, 0);
-				}
-                                
-				/* Push the properties */
-				for (i = 0; i < table->prop_count; i++) {
-					property = table->properties[i];
-					retval = retvals[i];
-					if (retval == MAPI_E_NOT_FOUND) {
-						property = (property & 0xFFFF0000) + PT_ERROR;
-						data = &retval;
-					}
-					else {
-						data = data_pointers[i];
-					}
-                                
-					libmapiserver_push_property(mem_ctx,
-								    property, data, &row,
-								    flagged?PT_ERROR:0, flagged, 0);
-				}
-				talloc_free(retvals);
-				talloc_free(data_pointers);
-                        }
-                        else {
-				table->numerator++;
-			}
-		}
+		found = oxctabl_find_row(mem_ctx, emsmdbp_ctx, object, &row);
 
 		retval = mapistore_table_set_restrictions(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(object), object->backend_object, NULL, &status);
 
 		/* Adjust parameters */
-		if (found) {
+		if (found == MAPI_E_SUCCESS) {
 			mapi_repl->u.mapi_FindRow.HasRowData = 1;
 		}
 		else {
-                        mapi_repl->error_code = MAPI_E_NOT_FOUND;
+                        mapi_repl->error_code = found;
 		}
 
 		mapi_repl->u.mapi_FindRow.row.length = row.length;
@@ -841,64 +921,25 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopFindRow(TALLOC_CTX *mem_ctx,
 	case false:
 		memset (&row, 0, sizeof(DATA_BLOB));
 		DEBUG(0, ("FindRow for openchangedb\n"));
+		/* Keep the restriction set by Restrict, if any */
+		ocdb_table = (struct openchangedb_table *) object->backend_object;
+		saved_res = talloc_steal(mem_ctx, ocdb_table->restrictions);
+		ocdb_table->restrictions = NULL;
 		/* Restrict rows to be fetched */
 		retval = openchangedb_table_set_restrictions(object->backend_object, &request.res);
 		/* Then fetch rows */
 		/* Lookup the properties and check if we need to flag the PropertyRow blob */
-		while (!found && table->numerator < table->denominator) {
-                        flagged = 0;
-
-			data_pointers = emsmdbp_object_table_get_row_props(NULL, emsmdbp_ctx, object, table->numerator, MAPISTORE_LIVEFILTERED_QUERY, &retvals);
-			if (data_pointers) {
-				found = true;
-				for (i = 0; i < table->prop_count; i++) {
-					if (retvals[i] != MAPI_E_SUCCESS) {
-						flagged = 1;
-					}
-				}
-
-				if (flagged) {
-					libmapiserver_push_property(mem_ctx, 
-								    0x0000000b, (const void *)&flagged,
-								    &row, 0, 0, 0);
-				}
-				else {
-					libmapiserver_push_property(mem_ctx, 
-								    0x00000000, (const void *)&flagged,
-								    &row, 0, 1, 0);
-				}
-                                
-				/* Push the properties */
-				for (i = 0; i < table->prop_count; i++) {
-					property = table->properties[i];
-					retval = retvals[i];
-					if (retval == MAPI_E_NOT_FOUND) {
-						property = (property & 0xFFFF0000) + PT_ERROR;
-						data = &retval;
-					}
-					else {
-						data = data_pointers[i];
-					}
-                                
-					libmapiserver_push_property(mem_ctx,
-								    property, data, &row,
-								    flagged?PT_ERROR:0, flagged, 0);
-				}
-				talloc_free(retvals);
-				talloc_free(data_pointers);
-                        } else {
-				table->numerator++;
-			}
-		}
-		/* Reset restrictions */
-		openchangedb_table_set_restrictions(object->backend_object, NULL);
+		found = oxctabl_find_row(mem_ctx, emsmdbp_ctx, object, &row);
+		/* Restore restrictions */
+		openchangedb_table_set_restrictions(object->backend_object, saved_res);
+		talloc_free(saved_res);
 
 		/* Adjust parameters */
-		if (found) {
+		if (found == MAPI_E_SUCCESS) {
 			mapi_repl->u.mapi_FindRow.HasRowData = 1;
 		}
 		else {
-                        mapi_repl->error_code = MAPI_E_NOT_FOUND;
+                        mapi_repl->error_code = found;
 		}
 
 		mapi_repl->u.mapi_FindRow.row.length = row.length;
@@ -996,14 +1037,17 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopResetTable(TALLOC_CTX *mem_ctx,
 		}
 
 		/* 1.2. empty restrictions */
-		if (emsmdbp_is_mapistore(object)) {
+		if (table->search) {
+			emsmdbp_object_search_table_refresh(object);
+		} else if (emsmdbp_is_mapistore(object)) {
 			contextID = emsmdbp_get_contextID(object);
 			retval = mapistore_table_set_restrictions(emsmdbp_ctx->mstore_ctx, contextID, object->backend_object, NULL, &status);
 			mapistore_table_get_row_count(emsmdbp_ctx->mstore_ctx, contextID, object->backend_object, MAPISTORE_PREFILTERED_QUERY, &object->object.table->denominator);
 		} else {
-			DEBUG(0, ("  mapistore Restrict: Not implemented yet\n"));
-			goto end;
+			retval = openchangedb_table_set_restrictions(object->backend_object, NULL);
+			openchangedb_table_get_row_count(object->backend_object, emsmdbp_ctx->oc_ctx, false, &object->object.table->denominator);
 		}
+		table->restricted = false;
 
 		/* 3. reset the cursor to the beginning of the table. */
 		table->numerator = 0;
@@ -28,20 +28,12 @@
 #include "mapiproxy/dcesrv_mapiproxy.h"
 #include "dcesrv_exchange_nsp.h"
 
-static struct exchange_nsp_session	*nsp_session = NULL;
+static struct mpm_session_table		*nsp_sessions = NULL;
 static TDB_CONTEXT			*emsabp_tdb_ctx = NULL;
 
 static struct exchange_nsp_session *dcesrv_find_nsp_session(struct GUID *uuid)
 {
-	struct exchange_nsp_session	*session, *found_session = NULL;
-
-	for (session = nsp_session; !found_session && session; session = session->next) {
-		if (GUID_equal(uuid, &session->uuid)) {
-			found_session = session;
-		}
-	}
-
-	return found_session;
+	return (struct exchange_nsp_session *) mpm_session_table_find(nsp_sessions, uuid);
 }
 
 static struct emsabp_context *dcesrv_find_emsabp_context(struct GUID *uuid)
@@ -153,12 +145,12 @@ static void dcesrv_NspiBind(struct dcesrv_call_state *dce_call,
 		DEBUG(0, ("Creating new session\n"));
 
 		/* Step 6. Associate this emsabp context to the session */
-		session = talloc((TALLOC_CTX *)nsp_session, struct exchange_nsp_session);
+		session = talloc(nsp_sessions, struct exchange_nsp_session);
 		if (!session) {
 			DCESRV_NSP_RETURN(r, MAPI_E_NOT_ENOUGH_RESOURCES, emsabp_ctx);
 		}
 
-		session->session = mpm_session_init((TALLOC_CTX *)nsp_session, dce_call);
+		session->session = mpm_session_init((TALLOC_CTX *)session, dce_call);
 		if (!session->session) {
 			DCESRV_NSP_RETURN(r, MAPI_E_NOT_ENOUGH_RESOURCES, emsabp_ctx);
 		}
@@ -168,7 +160,11 @@ static void dcesrv_NspiBind(struct dcesrv_call_state *dce_call,
 		mpm_session_set_private_data(session->session, (void *) emsabp_ctx);
 		mpm_session_set_destructor(session->session, emsabp_destructor);
 
-		DLIST_ADD_END(nsp_session, session, struct exchange_nsp_session *);
+		if (!mpm_session_table_add(nsp_sessions, &session->uuid, session)) {
+			talloc_free(session);
+			DCESRV_NSP_RETURN(r, MAPI_E_NOT_ENOUGH_RESOURCES, emsabp_ctx);
+		}
+		DEBUG(5, ("  %d nsp sessions\n", mpm_session_table_count(nsp_sessions)));
 	}
 
 	DCESRV_NSP_RETURN(r, MAPI_E_SUCCESS, NULL);
@@ -206,7 +202,8 @@ static void dcesrv_NspiUnbind(struct dcesrv_call_state *dce_call,
 		if (session) {
 			ret = mpm_session_release(session->session);
 			if (ret == true) {
-				DLIST_REMOVE(nsp_session, session);
+				mpm_session_table_remove(nsp_sessions, &session->uuid);
+				talloc_free(session);
 				DEBUG(0, ("[%s:%d]: Session found and released\n", 
 					  __FUNCTION__, __LINE__));
 			} else {
@@ -1365,9 +1362,8 @@ static NTSTATUS dcesrv_exchange_nsp_init(struct dcesrv_context *dce_ctx)
 {
 	DEBUG (0, ("dcesrv_exchange_nsp_init\n"));
 	/* Initialize exchange_nsp session */
-	nsp_session = talloc_zero(dce_ctx, struct exchange_nsp_session);
-	if (!nsp_session) return NT_STATUS_NO_MEMORY;
-	nsp_session->session = NULL;
+	nsp_sessions = mpm_session_table_init((TALLOC_CTX *)dce_ctx, 0);
+	if (!nsp_sessions) return NT_STATUS_NO_MEMORY;
 
 	/* Open a read-write pointer on the EMSABP TDB database */
 	emsabp_tdb_ctx = emsabp_tdb_init((TALLOC_CTX *)dce_ctx, dce_ctx->lp_ctx);
@@ -1375,6 +1371,11 @@ static NTSTATUS dcesrv_exchange_nsp_init(struct dcesrv_context *dce_ctx)
 		smb_panic("unable to initialize EMSABP context");
 	}
 
+	/* Load the GAL index once, before connection processes are forked */
+	if (emsabp_gal_preload(dce_ctx->lp_ctx) != MAPI_E_SUCCESS) {
+		DEBUG(0, ("[%s:%d]: Unable to load the GAL index, it is loaded on first use\n", __FUNCTION__, __LINE__));
+	}
+
 	return NT_STATUS_OK;
 }
 
@@ -48,14 +48,64 @@ struct emsabp_context {
 	void			*ldb_ctx;
 	TDB_CONTEXT		*tdb_ctx;
 	TDB_CONTEXT		*ttdb_ctx;
+	struct emsabp_gal	*gal;
 	TALLOC_CTX		*mem_ctx;
 };
 
+/**
+   GAL index attributes
+ */
+enum emsabp_gal_attr {
+	EMSABP_GAL_ATTR_DISPLAYNAME = 0,
+	EMSABP_GAL_ATTR_MAIL,
+	EMSABP_GAL_ATTR_LEGACYEXCHANGEDN,
+	EMSABP_GAL_ATTR_UPN,
+	EMSABP_GAL_ATTR_ACCOUNT,
+	EMSABP_GAL_ATTR_GIVENNAME,
+	EMSABP_GAL_ATTR_SN,
+	EMSABP_GAL_ATTR_NAME,
+	EMSABP_GAL_ATTR_MAX
+};
+
+/**
+   GAL index record: attributes are lower-cased
+ */
+struct emsabp_gal_entry {
+	DATA_BLOB		key;		/* objectGUID, or the DN */
+	char			*dn;
+	char			*values[EMSABP_GAL_ATTR_MAX];
+	char			**proxyAddresses;
+	uint32_t		proxyAddresses_count;
+	bool			removed;
+};
+
+struct emsabp_gal_token {
+	const char		*value;
+	uint32_t		entry;		/* position in entries */
+	bool			exact;
+};
+
+/**
+   GAL index: entries are sorted by display name, records without
+   display name last. tokens are sorted by value for prefix lookups.
+ */
+struct emsabp_gal {
+	struct emsabp_gal_entry	**entries;
+	uint32_t		count;
+	uint32_t		table_count;	/* records with a display name */
+	struct emsabp_gal_entry	**by_key;
+	struct emsabp_gal_token	*tokens;
+	uint32_t		tokens_count;
+	uint32_t		tokens_size;
+	uint64_t		highest_usn;
+	time_t			last_refresh;
+	uint32_t		refresh;
+	bool			loaded;
+};
+
 struct exchange_nsp_session {
 	struct mpm_session		*session;
 	struct GUID			uuid;
-	struct exchange_nsp_session	*prev;
-	struct exchange_nsp_session	*next;
 };
 
 struct emsabp_MId {
@@ -106,6 +156,15 @@ struct EphemeralEntryID {
 #define	EMSABP_TDB_TMP_MID_START	0x5000
 #define	EMSABP_TDB_DATA_REC		"MId_index"
 
+/* reverse MId -> DN records: prefix followed by the little-endian MId */
+#define	EMSABP_TDB_MID_KEY_PREFIX	"@MId:"
+#define	EMSABP_TDB_MID_KEY_LEN		(sizeof (EMSABP_TDB_MID_KEY_PREFIX) - 1 + sizeof (uint32_t))
+#define	EMSABP_TDB_MID_INDEX_REC	"@MId_dn_index"
+#define	EMSABP_TDB_MID_INDEX_VERSION	"1"
+
+/* default number of seconds between two GAL index updates */
+#define	EMSABP_GAL_REFRESH		30
+
 #define DCESRV_NSP_RETURN(r,c,ctx) { r->out.result = c; return; if (ctx) talloc_free(ctx); }
 
 __BEGIN_DECLS
@@ -150,6 +209,13 @@ enum MAPISTATUS		emsabp_tdb_fetch_dn_from_MId(TALLOC_CTX *, TDB_CONTEXT *, uint3
 
 TDB_CONTEXT		*emsabp_tdb_init_tmp(TALLOC_CTX *);
 
+/* definitions from emsabp_gal.c */
+struct emsabp_gal	*emsabp_gal_init(TALLOC_CTX *, uint32_t);
+struct emsabp_gal	*emsabp_gal_get(struct loadparm_context *);
+enum MAPISTATUS		emsabp_gal_preload(struct loadparm_context *);
+enum MAPISTATUS		emsabp_gal_refresh(struct emsabp_gal *, struct ldb_context *, bool);
+enum MAPISTATUS		emsabp_gal_search(TALLOC_CTX *, struct emsabp_gal *, const char *, const char *, const char ***, uint32_t *);
+
 /* definitions from emsabp_property.c */
 const char		*emsabp_property_get_attribute(uint32_t);
 uint32_t		emsabp_property_get_ulPropTag(const char *);
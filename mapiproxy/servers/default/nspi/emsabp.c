@@ -87,6 +87,9 @@ _PUBLIC_ struct emsabp_context *emsabp_init(struct loadparm_context *lp_ctx,
 		smb_panic("unable to create on-memory TDB database");
 	}
 
+	/* Reference the GAL index of the server process */
+	emsabp_ctx->gal = emsabp_gal_get(lp_ctx);
+
 	return emsabp_ctx;
 }
 
@@ -1020,6 +1023,9 @@ _PUBLIC_ enum MAPISTATUS emsabp_get_CreationTemplatesTable(TALLOC_CTX *mem_ctx,
    \param pStat pointer the STAT structure associated to the search
    \param limit the limit number of results the function can return
 
+   Searches on attributes held by the GAL index are served from it,
+   other searches are run against AD.
+
    \note SortTypePhoneticDisplayName sort type is currently not supported.
 
    \return MAPI_E_SUCCESS on success, otherwise MAPI error
@@ -1034,6 +1040,9 @@ _PUBLIC_ enum MAPISTATUS emsabp_search(TALLOC_CTX *mem_ctx, struct emsabp_contex
 	const char * const		recipient_attrs[] = { "*", NULL };
 	int				ret;
 	uint32_t			i;
+	uint32_t			count = 0;
+	TALLOC_CTX			*local_mem_ctx;
+	const char			**dns = NULL;
 	const char			*dn;
 	char				*fmt_str;
 	const char			*fmt_attr;
@@ -1054,7 +1063,7 @@ _PUBLIC_ enum MAPISTATUS emsabp_search(TALLOC_CTX *mem_ctx, struct emsabp_contex
 		return MAPI_E_CALL_FAILED;
 	}
 
-	/* Step 1. Apply restriction and retrieve results from AD */
+	/* Step 1. Retrieve the search value */
 	if (restriction) {
 		/* FIXME: We only support RES_PROPERTY restriction */
 		if ((uint32_t)restriction->rt != RES_PROPERTY) {
@@ -1081,7 +1090,25 @@ _PUBLIC_ enum MAPISTATUS emsabp_search(TALLOC_CTX *mem_ctx, struct emsabp_contex
 		if (attr == NULL) {
 			return MAPI_E_NO_SUPPORT;
 		}
+	} else {
+		fmt_attr = NULL;
+		attr = NULL;
+	}
+
+	local_mem_ctx = talloc_new(NULL);
+	OPENCHANGE_RETVAL_IF(!local_mem_ctx, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+
+	/* Step 2. Serve the search from the GAL index when the attribute is indexed */
+	if (emsabp_ctx->gal && emsabp_gal_refresh(emsabp_ctx->gal, emsabp_ctx->samdb_ctx, false) == MAPI_E_SUCCESS) {
+		retval = emsabp_gal_search(local_mem_ctx, emsabp_ctx->gal, fmt_attr, attr, &dns, &count);
+		if (retval != MAPI_E_NO_SUPPORT) {
+			OPENCHANGE_RETVAL_IF(retval, retval, local_mem_ctx);
+			goto mids;
+		}
+	}
 
+	/* Step 3. Otherwise apply restriction and retrieve results from AD */
+	if (restriction) {
 		/* Special case: anr doesn't return correct result with partial search */
 		if (!strcmp(fmt_attr, "anr")) {
 			fmt_str = talloc_asprintf(mem_ctx, "(&(objectClass=user)(|(%s=%s)(userPrincipalName=%s))(!(objectClass=computer)))", fmt_attr, attr, attr);
@@ -1092,42 +1119,55 @@ _PUBLIC_ enum MAPISTATUS emsabp_search(TALLOC_CTX *mem_ctx, struct emsabp_contex
 		}
 	} else {
 		fmt_str = talloc_strdup(mem_ctx, "(&(objectClass=user)(displayName=*)(!(objectClass=computer)))");
-		attr = NULL;
 	}
 
-	ret = ldb_search(emsabp_ctx->samdb_ctx, emsabp_ctx, &res,
+	ret = ldb_search(emsabp_ctx->samdb_ctx, local_mem_ctx, &res,
 			 ldb_get_default_basedn(emsabp_ctx->samdb_ctx),
 			 LDB_SCOPE_SUBTREE, recipient_attrs, fmt_str, attr);
 	talloc_free(fmt_str);			
 	
 	if (ret != LDB_SUCCESS) {
+		talloc_free(local_mem_ctx);
 		return MAPI_E_NOT_FOUND;
 	}
 	if (res == NULL) {
+		talloc_free(local_mem_ctx);
 		return MAPI_E_INVALID_OBJECT;
 	}
-	if (!res->count) {
+
+	count = res->count;
+	dns = talloc_array(local_mem_ctx, const char *, count);
+	OPENCHANGE_RETVAL_IF(!dns && count, MAPI_E_NOT_ENOUGH_RESOURCES, local_mem_ctx);
+	for (i = 0; i < count; i++) {
+		dns[i] = ldb_msg_find_attr_as_string(res->msgs[i], "distinguishedName", NULL);
+	}
+
+mids:
+	if (!count) {
+		talloc_free(local_mem_ctx);
 		return MAPI_E_NOT_FOUND;
 	}
 
-	if (limit && res->count > limit) {
+	if (limit && count > limit) {
+		talloc_free(local_mem_ctx);
 		return MAPI_E_TABLE_TOO_BIG;
 	}
 
-	MIds->aulPropTag = (uint32_t *) talloc_array(mem_ctx, uint32_t, res->count);
-	MIds->cValues = res->count;
+	MIds->aulPropTag = (uint32_t *) talloc_array(mem_ctx, uint32_t, count);
+	MIds->cValues = count;
 
-	/* Step 2. Create session MId for all fetched records */
-	for (i = 0; i < res->count; i++) {
-		dn = ldb_msg_find_attr_as_string(res->msgs[i], "distinguishedName", NULL);
+	/* Step 4. Create session MId for all fetched records */
+	for (i = 0; i < count; i++) {
+		dn = dns[i];
 		retval = emsabp_tdb_fetch_MId(emsabp_ctx->ttdb_ctx, dn, (uint32_t *)&(MIds->aulPropTag[i]));
 		if (retval) {
 			retval = emsabp_tdb_insert(emsabp_ctx->ttdb_ctx, dn);
-			OPENCHANGE_RETVAL_IF(retval, MAPI_E_CORRUPT_STORE, NULL);
+			OPENCHANGE_RETVAL_IF(retval, MAPI_E_CORRUPT_STORE, local_mem_ctx);
 			retval = emsabp_tdb_fetch_MId(emsabp_ctx->ttdb_ctx, dn, (uint32_t *) &(MIds->aulPropTag[i]));
-			OPENCHANGE_RETVAL_IF(retval, MAPI_E_CORRUPT_STORE, NULL);
+			OPENCHANGE_RETVAL_IF(retval, MAPI_E_CORRUPT_STORE, local_mem_ctx);
 		}
 	}
+	talloc_free(local_mem_ctx);
 
 	return MAPI_E_SUCCESS;
 }
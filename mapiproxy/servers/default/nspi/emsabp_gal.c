@@ -0,0 +1,807 @@
+/*
+   OpenChange Server implementation.
+
+   EMSABP: Address Book Provider implementation
+
+   Copyright (C) OpenChange Project 2013.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   \file emsabp_gal.c
+
+   \brief In-memory index of the Global Address List
+
+   The index holds the searchable attributes of every mail recipient
+   of the directory, ordered the way MS-NSPI sorts the GAL
+   (SortTypeDisplayName), with a sorted token table for ambiguous name
+   resolution. It is loaded from samdb on first use, then kept up to
+   date with the records whose uSNChanged is above the highest USN
+   seen so far. Deleted objects are fetched with the show_deleted
+   control and matched on their objectGUID, since their DN changes.
+
+   The index is process wide: every EMSABP context of the server
+   process shares it. It is loaded when the NSPI server is initialized,
+   before the server forks the processes serving the connections: they
+   inherit the loaded index and only fetch the later changes.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "dcesrv_exchange_nsp.h"
+#include <util/debug.h>
+
+/* single valued attributes kept in the index, see enum emsabp_gal_attr */
+static const char * const emsabp_gal_attrs[EMSABP_GAL_ATTR_MAX] = {
+	"displayName",
+	"mail",
+	"legacyExchangeDN",
+	"userPrincipalName",
+	"sAMAccountName",
+	"givenName",
+	"sn",
+	"name"
+};
+
+static struct emsabp_gal	*emsabp_gal_ctx = NULL;
+
+
+static int emsabp_gal_entry_cmp(const void *a, const void *b)
+{
+	const struct emsabp_gal_entry	*e1 = *(const struct emsabp_gal_entry **)a;
+	const struct emsabp_gal_entry	*e2 = *(const struct emsabp_gal_entry **)b;
+	const char			*s1 = e1->values[EMSABP_GAL_ATTR_DISPLAYNAME];
+	const char			*s2 = e2->values[EMSABP_GAL_ATTR_DISPLAYNAME];
+	int				ret;
+
+	/* records without display name are not part of the GAL table
+	 * and go last */
+	if (s1 && s2) {
+		ret = strcmp(s1, s2);
+		if (ret) return ret;
+	} else if (s1 || s2) {
+		return s1 ? -1 : 1;
+	}
+
+	return strcmp(e1->dn, e2->dn);
+}
+
+static int emsabp_gal_key_cmp(const DATA_BLOB *k1, const DATA_BLOB *k2)
+{
+	if (k1->length != k2->length) {
+		return (k1->length < k2->length) ? -1 : 1;
+	}
+
+	return memcmp(k1->data, k2->data, k1->length);
+}
+
+static int emsabp_gal_entry_key_cmp(const void *a, const void *b)
+{
+	const struct emsabp_gal_entry	*e1 = *(const struct emsabp_gal_entry **)a;
+	const struct emsabp_gal_entry	*e2 = *(const struct emsabp_gal_entry **)b;
+
+	return emsabp_gal_key_cmp(&e1->key, &e2->key);
+}
+
+static int emsabp_gal_token_cmp(const void *a, const void *b)
+{
+	const struct emsabp_gal_token	*t1 = (const struct emsabp_gal_token *)a;
+	const struct emsabp_gal_token	*t2 = (const struct emsabp_gal_token *)b;
+	int				ret;
+
+	ret = strcmp(t1->value, t2->value);
+	if (ret) return ret;
+
+	return (t1->entry < t2->entry) ? -1 : (t1->entry > t2->entry);
+}
+
+static int emsabp_gal_uint32_cmp(const void *a, const void *b)
+{
+	uint32_t	v1 = *(const uint32_t *)a;
+	uint32_t	v2 = *(const uint32_t *)b;
+
+	return (v1 < v2) ? -1 : (v1 > v2);
+}
+
+
+/**
+   \details Create an empty GAL index
+
+   \param mem_ctx pointer to the memory context
+   \param refresh minimum number of seconds between two updates from
+   the directory
+
+   \return Allocated GAL index on success, otherwise NULL
+ */
+_PUBLIC_ struct emsabp_gal *emsabp_gal_init(TALLOC_CTX *mem_ctx, uint32_t refresh)
+{
+	struct emsabp_gal	*gal;
+
+	gal = talloc_zero(mem_ctx, struct emsabp_gal);
+	if (!gal) return NULL;
+
+	gal->refresh = refresh;
+
+	return gal;
+}
+
+
+/**
+   \details Return the GAL index of the server process, creating it on
+   first call.
+
+   The index is disabled with dcerpc_mapiproxy:nspi_gal_cache = false,
+   and dcerpc_mapiproxy:nspi_gal_refresh sets the number of seconds
+   between two updates from the directory.
+
+   \param lp_ctx pointer to the loadparm context
+
+   \return pointer to the GAL index, or NULL if disabled
+ */
+_PUBLIC_ struct emsabp_gal *emsabp_gal_get(struct loadparm_context *lp_ctx)
+{
+	int	refresh;
+
+	if (emsabp_gal_ctx) return emsabp_gal_ctx;
+
+	if (lpcfg_parm_bool(lp_ctx, NULL, "dcerpc_mapiproxy", "nspi_gal_cache", true) == false) {
+		return NULL;
+	}
+
+	refresh = lpcfg_parm_int(lp_ctx, NULL, "dcerpc_mapiproxy", "nspi_gal_refresh", EMSABP_GAL_REFRESH);
+	emsabp_gal_ctx = emsabp_gal_init(NULL, (refresh < 0) ? 0 : refresh);
+
+	return emsabp_gal_ctx;
+}
+
+
+/**
+   \details Load the GAL index of the server process from the directory,
+   so that the processes later forked to serve the connections inherit
+   it instead of each loading their own copy.
+
+   \param lp_ctx pointer to the loadparm context
+
+   \return MAPI_E_SUCCESS on success or if the index is disabled,
+   otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsabp_gal_preload(struct loadparm_context *lp_ctx)
+{
+	enum MAPISTATUS		retval;
+	TALLOC_CTX		*mem_ctx;
+	struct emsabp_gal	*gal;
+	struct tevent_context	*ev;
+	struct ldb_context	*samdb_ctx;
+
+	gal = emsabp_gal_get(lp_ctx);
+	if (!gal) return MAPI_E_SUCCESS;
+
+	mem_ctx = talloc_named(NULL, 0, "emsabp_gal_preload");
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	ev = tevent_context_init(mem_ctx);
+	OPENCHANGE_RETVAL_IF(!ev, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+
+	samdb_ctx = samdb_connect(mem_ctx, ev, lp_ctx, system_session(lp_ctx), 0);
+	if (!samdb_ctx) {
+		DEBUG(0, ("[%s:%d]: Connection to \"sam.ldb\" failed\n", __FUNCTION__, __LINE__));
+		talloc_free(mem_ctx);
+		return MAPI_E_CALL_FAILED;
+	}
+
+	retval = emsabp_gal_refresh(gal, samdb_ctx, true);
+	talloc_free(mem_ctx);
+
+	return retval;
+}
+
+
+/**
+   \details Drop the content of the GAL index, so that the next update
+   loads it again from the directory
+
+   \param gal pointer to the GAL index
+ */
+static void emsabp_gal_reset(struct emsabp_gal *gal)
+{
+	uint32_t	i;
+
+	for (i = 0; i < gal->count; i++) {
+		talloc_free(gal->entries[i]);
+	}
+	talloc_free(gal->entries);
+	talloc_free(gal->by_key);
+	talloc_free(gal->tokens);
+
+	gal->entries = NULL;
+	gal->count = 0;
+	gal->table_count = 0;
+	gal->by_key = NULL;
+	gal->tokens = NULL;
+	gal->tokens_count = 0;
+	gal->tokens_size = 0;
+	gal->highest_usn = 0;
+	gal->loaded = false;
+}
+
+
+/**
+   \details Create an index entry from a directory record
+
+   \param gal pointer to the GAL index
+   \param msg pointer to the LDB message
+
+   \return Allocated entry on success, otherwise NULL
+ */
+static struct emsabp_gal_entry *emsabp_gal_entry_new(struct emsabp_gal *gal, struct ldb_message *msg)
+{
+	struct emsabp_gal_entry		*entry;
+	struct ldb_message_element	*el;
+	const struct ldb_val		*guid;
+	const char			*value;
+	uint32_t			i;
+
+	entry = talloc_zero(gal, struct emsabp_gal_entry);
+	if (!entry) return NULL;
+
+	value = ldb_msg_find_attr_as_string(msg, "distinguishedName", NULL);
+	entry->dn = talloc_strdup(entry, value ? value : ldb_dn_get_linearized(msg->dn));
+	if (!entry->dn) goto error;
+
+	guid = ldb_msg_find_ldb_val(msg, "objectGUID");
+	if (guid && guid->length) {
+		entry->key = data_blob_talloc(entry, guid->data, guid->length);
+	} else {
+		entry->key = data_blob_const(entry->dn, strlen(entry->dn));
+	}
+
+	for (i = 0; i < EMSABP_GAL_ATTR_MAX; i++) {
+		value = ldb_msg_find_attr_as_string(msg, emsabp_gal_attrs[i], NULL);
+		if (value && value[0]) {
+			entry->values[i] = strlower_talloc(entry, value);
+			if (!entry->values[i]) goto error;
+		}
+	}
+
+	el = ldb_msg_find_element(msg, "proxyAddresses");
+	if (el && el->num_values) {
+		entry->proxyAddresses = talloc_array(entry, char *, el->num_values);
+		if (!entry->proxyAddresses) goto error;
+		for (i = 0; i < el->num_values; i++) {
+			value = talloc_strndup(entry, (const char *)el->values[i].data, el->values[i].length);
+			if (!value) goto error;
+			entry->proxyAddresses[entry->proxyAddresses_count] = strlower_talloc(entry, value);
+			if (!entry->proxyAddresses[entry->proxyAddresses_count]) goto error;
+			talloc_free(discard_const_p(char, value));
+			entry->proxyAddresses_count++;
+		}
+	}
+
+	return entry;
+
+error:
+	talloc_free(entry);
+	return NULL;
+}
+
+
+/**
+   \details Add the tokens of an entry to the token table
+
+   \param gal pointer to the GAL index
+   \param index position of the entry in the sorted entries array
+   \param value lower-cased value to add
+   \param exact whether the token only matches on the whole value
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_NOT_ENOUGH_MEMORY
+ */
+static enum MAPISTATUS emsabp_gal_token_add(struct emsabp_gal *gal, uint32_t index,
+					    const char *value, bool exact)
+{
+	struct emsabp_gal_token	*tokens;
+	uint32_t		size;
+
+	if (!value || !value[0]) return MAPI_E_SUCCESS;
+
+	if (gal->tokens_count == gal->tokens_size) {
+		size = gal->tokens_size ? gal->tokens_size * 2 : 1024;
+		tokens = talloc_realloc(gal, gal->tokens, struct emsabp_gal_token, size);
+		OPENCHANGE_RETVAL_IF(!tokens, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		gal->tokens = tokens;
+		gal->tokens_size = size;
+	}
+
+	gal->tokens[gal->tokens_count].value = value;
+	gal->tokens[gal->tokens_count].entry = index;
+	gal->tokens[gal->tokens_count].exact = exact;
+	gal->tokens_count++;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Sort the entries and rebuild the lookup tables once
+   entries were added or removed.
+
+   \param gal pointer to the GAL index
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_NOT_ENOUGH_MEMORY
+ */
+static enum MAPISTATUS emsabp_gal_rebuild(struct emsabp_gal *gal)
+{
+	enum MAPISTATUS		retval;
+	struct emsabp_gal_entry	*entry;
+	const char		*address;
+	uint32_t		i;
+	uint32_t		j;
+	uint32_t		count;
+
+	/* Step 1. Drop removed entries and sort in GAL order */
+	for (i = 0, count = 0; i < gal->count; i++) {
+		if (gal->entries[i]) {
+			gal->entries[count++] = gal->entries[i];
+		}
+	}
+	gal->count = count;
+	qsort(gal->entries, gal->count, sizeof (struct emsabp_gal_entry *), emsabp_gal_entry_cmp);
+
+	for (i = 0, count = 0; i < gal->count; i++) {
+		if (gal->entries[i]->values[EMSABP_GAL_ATTR_DISPLAYNAME]) {
+			count++;
+		}
+	}
+	gal->table_count = count;
+
+	/* Step 2. Objects lookup table */
+	talloc_free(gal->by_key);
+	gal->by_key = talloc_memdup(gal, gal->entries, gal->count * sizeof (struct emsabp_gal_entry *));
+	OPENCHANGE_RETVAL_IF(gal->count && !gal->by_key, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	qsort(gal->by_key, gal->count, sizeof (struct emsabp_gal_entry *), emsabp_gal_entry_key_cmp);
+
+	/* Step 3. Ambiguous name resolution tokens */
+	gal->tokens_count = 0;
+	for (i = 0; i < gal->count; i++) {
+		entry = gal->entries[i];
+		for (j = 0; j < EMSABP_GAL_ATTR_MAX; j++) {
+			retval = emsabp_gal_token_add(gal, i, entry->values[j], (j == EMSABP_GAL_ATTR_UPN));
+			OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+		}
+		for (j = 0; j < entry->proxyAddresses_count; j++) {
+			retval = emsabp_gal_token_add(gal, i, entry->proxyAddresses[j], false);
+			OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+			/* also match on the address without its type */
+			address = strchr(entry->proxyAddresses[j], ':');
+			if (address) {
+				retval = emsabp_gal_token_add(gal, i, address + 1, false);
+				OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+			}
+		}
+	}
+	qsort(gal->tokens, gal->tokens_count, sizeof (struct emsabp_gal_token), emsabp_gal_token_cmp);
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Look up an entry of the index from the objectGUID or DN
+   of a directory record
+
+   \param gal pointer to the GAL index
+   \param count number of entries in the by_key array
+   \param key pointer to the key of the record
+
+   \return position of the entry in the by_key array, or -1
+ */
+static int emsabp_gal_find_key(struct emsabp_gal *gal, uint32_t count, const DATA_BLOB *key)
+{
+	int	low = 0;
+	int	high = (int)count - 1;
+	int	middle;
+	int	ret;
+
+	while (low <= high) {
+		middle = (low + high) / 2;
+		ret = emsabp_gal_key_cmp(&gal->by_key[middle]->key, key);
+		if (!ret) return middle;
+		if (ret < 0) {
+			low = middle + 1;
+		} else {
+			high = middle - 1;
+		}
+	}
+
+	return -1;
+}
+
+
+/**
+   \details Update the GAL index from the directory. The first call
+   loads every mail recipient, later calls only fetch the records
+   changed since the previous update. Nothing is done if the previous
+   update is more recent than the refresh interval, unless force is
+   set. If the update fails half way, the index is dropped and loaded
+   again by the next update.
+
+   \param gal pointer to the GAL index
+   \param ldb_ctx pointer to the directory LDB context
+   \param force whether to ignore the refresh interval
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsabp_gal_refresh(struct emsabp_gal *gal, struct ldb_context *ldb_ctx, bool force)
+{
+	enum MAPISTATUS			retval;
+	TALLOC_CTX			*mem_ctx;
+	struct ldb_request		*req;
+	struct ldb_result		*res;
+	struct ldb_control		**controls;
+	struct emsabp_gal_entry		*entry;
+	struct emsabp_gal_entry		**entries;
+	const char * const		control_strings[] = { "show_deleted:0", NULL };
+	const char * const		recipient_attrs[] = { "displayName", "mail", "legacyExchangeDN", "userPrincipalName",
+							      "sAMAccountName", "givenName", "sn", "name", "proxyAddresses",
+							      "distinguishedName", "objectGUID", "objectClass", "uSNChanged",
+							      "isDeleted", NULL };
+	char				*filter;
+	uint64_t			usn;
+	uint64_t			highest_usn;
+	time_t				now;
+	uint32_t			i;
+	uint32_t			count;
+	int				index;
+	int				ret;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!gal, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!ldb_ctx, MAPI_E_INVALID_PARAMETER, NULL);
+
+	now = time(NULL);
+	if (gal->loaded && !force && (now - gal->last_refresh) < (time_t)gal->refresh) {
+		return MAPI_E_SUCCESS;
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "emsabp_gal_refresh");
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	/* Step 1. Fetch every recipient, or the ones changed since the last update */
+	if (gal->loaded) {
+		filter = talloc_asprintf(mem_ctx, "(&(objectClass=user)(uSNChanged>=%"PRIu64"))", gal->highest_usn + 1);
+		controls = ldb_parse_control_strings(ldb_ctx, mem_ctx, control_strings);
+	} else {
+		filter = talloc_strdup(mem_ctx, "(&(objectClass=user)(!(objectClass=computer)))");
+		controls = NULL;
+	}
+	res = talloc_zero(mem_ctx, struct ldb_result);
+	OPENCHANGE_RETVAL_IF(!filter || !res, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+
+	ret = ldb_build_search_req(&req, ldb_ctx, mem_ctx, ldb_get_default_basedn(ldb_ctx),
+				   LDB_SCOPE_SUBTREE, filter, recipient_attrs, controls,
+				   res, ldb_search_default_callback, NULL);
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_CALL_FAILED, mem_ctx);
+
+	ret = ldb_request(ldb_ctx, req);
+	if (ret == LDB_SUCCESS) {
+		ret = ldb_wait(req->handle, LDB_WAIT_ALL);
+	}
+	if (ret != LDB_SUCCESS) {
+		DEBUG(1, ("[%s:%d]: GAL update failed: %s\n", __FUNCTION__, __LINE__, ldb_errstring(ldb_ctx)));
+		talloc_free(mem_ctx);
+		return MAPI_E_CALL_FAILED;
+	}
+
+	gal->last_refresh = now;
+	if (gal->loaded && !res->count) {
+		talloc_free(mem_ctx);
+		return MAPI_E_SUCCESS;
+	}
+
+	/* Step 2. Replace changed records and drop deleted ones */
+	retval = MAPI_E_NOT_ENOUGH_MEMORY;
+	entries = talloc_realloc(gal, gal->entries, struct emsabp_gal_entry *, gal->count + res->count);
+	if (!entries && (gal->count + res->count)) goto fail;
+	gal->entries = entries;
+
+	highest_usn = gal->highest_usn;
+	count = gal->count;
+	for (i = 0; i < res->count; i++) {
+		usn = ldb_msg_find_attr_as_uint64(res->msgs[i], "uSNChanged", 0);
+		if (usn > highest_usn) {
+			highest_usn = usn;
+		}
+
+		entry = emsabp_gal_entry_new(gal, res->msgs[i]);
+		if (!entry) goto fail;
+
+		if (gal->loaded) {
+			index = emsabp_gal_find_key(gal, count, &entry->key);
+			if (index != -1) {
+				gal->by_key[index]->removed = true;
+			}
+		}
+
+		if (ldb_msg_find_attr_as_bool(res->msgs[i], "isDeleted", false) ||
+		    ldb_msg_check_string_attribute(res->msgs[i], "objectClass", "computer")) {
+			talloc_free(entry);
+			continue;
+		}
+		gal->entries[gal->count++] = entry;
+	}
+
+	for (i = 0; i < gal->count; i++) {
+		if (gal->entries[i]->removed) {
+			talloc_free(gal->entries[i]);
+			gal->entries[i] = NULL;
+		}
+	}
+
+	retval = emsabp_gal_rebuild(gal);
+	if (retval) goto fail;
+
+	talloc_free(mem_ctx);
+
+	DEBUG(5, ("[%s:%d]: GAL %s: %u records, %u tokens, highest USN %"PRIu64"\n", __FUNCTION__, __LINE__,
+		  gal->loaded ? "updated" : "loaded", gal->count, gal->tokens_count, highest_usn));
+
+	gal->highest_usn = highest_usn;
+	gal->loaded = true;
+
+	return MAPI_E_SUCCESS;
+
+fail:
+	DEBUG(1, ("[%s:%d]: GAL update failed, dropping the index\n", __FUNCTION__, __LINE__));
+	emsabp_gal_reset(gal);
+	talloc_free(mem_ctx);
+
+	return retval;
+}
+
+
+/**
+   \details Add an entry to the search results
+
+   \param mem_ctx pointer to the memory context of the results
+   \param hits pointer on the results array
+   \param count pointer on the number of results
+   \param index position of the entry in the sorted entries array
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_NOT_ENOUGH_MEMORY
+ */
+static enum MAPISTATUS emsabp_gal_hit(TALLOC_CTX *mem_ctx, uint32_t **hits, uint32_t *count, uint32_t index)
+{
+	uint32_t	*array;
+
+	/* grow by powers of two, starting at 16 */
+	if (!*count || (*count >= 16 && !(*count & (*count - 1)))) {
+		array = talloc_realloc(mem_ctx, *hits, uint32_t, *count ? *count * 2 : 16);
+		OPENCHANGE_RETVAL_IF(!array, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		*hits = array;
+	}
+	(*hits)[(*count)++] = index;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Return the position of the first token greater or equal
+   to a prefix
+
+   \param gal pointer to the GAL index
+   \param prefix the lower-cased prefix
+
+   \return position in the token table
+ */
+static uint32_t emsabp_gal_lower_bound(struct emsabp_gal *gal, const char *prefix)
+{
+	uint32_t	low = 0;
+	uint32_t	high = gal->tokens_count;
+	uint32_t	middle;
+
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (strcmp(gal->tokens[middle].value, prefix) < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+
+static bool emsabp_gal_prefix(const char *value, const char *prefix, size_t len)
+{
+	return (value && !strncmp(value, prefix, len));
+}
+
+
+/**
+   \details Ambiguous name resolution: match the value as a prefix of
+   any indexed token, the user principal name as a whole, and "first
+   last" or "last first" against given name and surname. A value
+   starting with '=' only matches whole tokens.
+
+   \param mem_ctx pointer to the memory context of the results
+   \param gal pointer to the GAL index
+   \param value the lower-cased value to resolve
+   \param hits pointer on the results array
+   \param count pointer on the number of results
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_NOT_ENOUGH_MEMORY
+ */
+static enum MAPISTATUS emsabp_gal_anr(TALLOC_CTX *mem_ctx, struct emsabp_gal *gal, const char *value,
+				      uint32_t **hits, uint32_t *count)
+{
+	enum MAPISTATUS		retval;
+	struct emsabp_gal_entry	*entry;
+	const char		*first;
+	const char		*last;
+	size_t			len;
+	size_t			first_len;
+	size_t			last_len;
+	uint32_t		i;
+	bool			exact = false;
+
+	if (value[0] == '=') {
+		exact = true;
+		value++;
+	}
+	len = strlen(value);
+	if (!len) return MAPI_E_SUCCESS;
+
+	for (i = emsabp_gal_lower_bound(gal, value); i < gal->tokens_count; i++) {
+		if (strncmp(gal->tokens[i].value, value, len)) break;
+		if ((exact || gal->tokens[i].exact) && gal->tokens[i].value[len]) continue;
+		retval = emsabp_gal_hit(mem_ctx, hits, count, gal->tokens[i].entry);
+		OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+	}
+
+	/* "first last" and "last first" */
+	last = strchr(value, ' ');
+	if (exact || !last) return MAPI_E_SUCCESS;
+
+	first = value;
+	first_len = last - value;
+	while (*last == ' ') last++;
+	last_len = strlen(last);
+	if (!last_len) return MAPI_E_SUCCESS;
+
+	for (i = emsabp_gal_lower_bound(gal, last); i < gal->tokens_count; i++) {
+		if (strncmp(gal->tokens[i].value, last, last_len)) break;
+		entry = gal->entries[gal->tokens[i].entry];
+		if ((entry->values[EMSABP_GAL_ATTR_SN] == gal->tokens[i].value &&
+		     emsabp_gal_prefix(entry->values[EMSABP_GAL_ATTR_GIVENNAME], first, first_len)) ||
+		    (entry->values[EMSABP_GAL_ATTR_GIVENNAME] == gal->tokens[i].value &&
+		     emsabp_gal_prefix(entry->values[EMSABP_GAL_ATTR_SN], first, first_len))) {
+			retval = emsabp_gal_hit(mem_ctx, hits, count, gal->tokens[i].entry);
+			OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+		}
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Search the GAL index. Records are returned in GAL order
+   (SortTypeDisplayName), with the same matching rules as the
+   directory searches emsabp_search runs:
+
+   - no attribute: every record with a display name
+   - anr and legacyExchangeDN: ambiguous name resolution
+   - other indexed attributes: substring match
+
+   \param mem_ctx pointer to the memory context
+   \param gal pointer to the GAL index
+   \param attribute the AD attribute to match, or NULL
+   \param value the value to match
+   \param dns pointer on the array of DN the function returns. DN
+   strings belong to the index and remain valid until the next
+   update.
+   \param count pointer on the number of records found
+
+   \return MAPI_E_SUCCESS on success, MAPI_E_NO_SUPPORT if the
+   attribute is not indexed, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsabp_gal_search(TALLOC_CTX *mem_ctx, struct emsabp_gal *gal,
+					   const char *attribute, const char *value,
+					   const char ***dns, uint32_t *count)
+{
+	enum MAPISTATUS		retval = MAPI_E_SUCCESS;
+	TALLOC_CTX		*local_mem_ctx;
+	struct emsabp_gal_entry	*entry;
+	const char		**results;
+	char			*lvalue = NULL;
+	uint32_t		*hits = NULL;
+	uint32_t		hits_count = 0;
+	uint32_t		i;
+	uint32_t		j;
+	int			attr = -1;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!gal || !gal->loaded, MAPI_E_NO_SUPPORT, NULL);
+	OPENCHANGE_RETVAL_IF(!dns || !count, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(attribute && !value, MAPI_E_INVALID_PARAMETER, NULL);
+
+	if (attribute && strcasecmp(attribute, "anr") && strcasecmp(attribute, "legacyExchangeDN") &&
+	    strcasecmp(attribute, "proxyAddresses")) {
+		for (i = 0; i < EMSABP_GAL_ATTR_MAX; i++) {
+			if (!strcasecmp(attribute, emsabp_gal_attrs[i])) {
+				attr = i;
+				break;
+			}
+		}
+		OPENCHANGE_RETVAL_IF(attr == -1, MAPI_E_NO_SUPPORT, NULL);
+	}
+
+	local_mem_ctx = talloc_named(NULL, 0, "emsabp_gal_search");
+	OPENCHANGE_RETVAL_IF(!local_mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	if (!attribute) {
+		/* the whole GAL table */
+		results = talloc_array(mem_ctx, const char *, gal->table_count);
+		OPENCHANGE_RETVAL_IF(!results && gal->table_count, MAPI_E_NOT_ENOUGH_MEMORY, local_mem_ctx);
+		for (i = 0; i < gal->table_count; i++) {
+			results[i] = gal->entries[i]->dn;
+		}
+		*dns = results;
+		*count = gal->table_count;
+		talloc_free(local_mem_ctx);
+		return MAPI_E_SUCCESS;
+	}
+
+	lvalue = strlower_talloc(local_mem_ctx, value);
+	OPENCHANGE_RETVAL_IF(!lvalue, MAPI_E_NOT_ENOUGH_MEMORY, local_mem_ctx);
+
+	if (!strcasecmp(attribute, "anr") || !strcasecmp(attribute, "legacyExchangeDN")) {
+		retval = emsabp_gal_anr(local_mem_ctx, gal, lvalue, &hits, &hits_count);
+	} else {
+		for (i = 0; i < gal->count && !retval; i++) {
+			entry = gal->entries[i];
+			if (attr != -1) {
+				if (entry->values[attr] && strstr(entry->values[attr], lvalue)) {
+					retval = emsabp_gal_hit(local_mem_ctx, &hits, &hits_count, i);
+				}
+				continue;
+			}
+			for (j = 0; j < entry->proxyAddresses_count; j++) {
+				if (strstr(entry->proxyAddresses[j], lvalue)) {
+					retval = emsabp_gal_hit(local_mem_ctx, &hits, &hits_count, i);
+					break;
+				}
+			}
+		}
+	}
+	OPENCHANGE_RETVAL_IF(retval, retval, local_mem_ctx);
+
+	/* Return unique records in GAL order */
+	if (hits_count) {
+		qsort(hits, hits_count, sizeof (uint32_t), emsabp_gal_uint32_cmp);
+	}
+	results = talloc_array(mem_ctx, const char *, hits_count);
+	OPENCHANGE_RETVAL_IF(!results && hits_count, MAPI_E_NOT_ENOUGH_MEMORY, local_mem_ctx);
+	for (i = 0, j = 0; i < hits_count; i++) {
+		if (i && hits[i] == hits[i - 1]) continue;
+		results[j++] = gal->entries[hits[i]]->dn;
+	}
+
+	*dns = results;
+	*count = j;
+	talloc_free(local_mem_ctx);
+
+	return MAPI_E_SUCCESS;
+}
@@ -30,12 +30,117 @@
 #include <util/debug.h>
 
 /**
-   \details Structure to be used for MId traversal within TDB
+   \details Build the binary key of the MId -> DN record
+
+   \param MId the MId to build the key for
+   \param buf buffer of EMSABP_TDB_MID_KEY_LEN bytes holding the key
+
+   \return the TDB key
+ */
+static TDB_DATA emsabp_tdb_MId_key(uint32_t MId, uint8_t *buf)
+{
+	TDB_DATA	key;
+	size_t		len = sizeof (EMSABP_TDB_MID_KEY_PREFIX) - 1;
+
+	memcpy(buf, EMSABP_TDB_MID_KEY_PREFIX, len);
+	buf[len] = MId & 0xFF;
+	buf[len + 1] = (MId >> 8) & 0xFF;
+	buf[len + 2] = (MId >> 16) & 0xFF;
+	buf[len + 3] = (MId >> 24) & 0xFF;
+
+	key.dptr = buf;
+	key.dsize = EMSABP_TDB_MID_KEY_LEN;
+
+	return key;
+}
+
+
+/**
+   \details Store the MId -> DN record associated to a DN record
+
+   \param tdb_ctx pointer to the EMSABP TDB context
+   \param dn the DN record key
+   \param value the DN record value, the MId in hexadecimal
+
+   \return 0 on success, otherwise -1
  */
-struct traverse_MId {
+static int emsabp_tdb_store_MId_key(TDB_CONTEXT *tdb_ctx, TDB_DATA dn, TDB_DATA value)
+{
+	uint8_t		buf[EMSABP_TDB_MID_KEY_LEN];
+	char		str[16];
 	uint32_t	MId;
-	bool		found;
-};
+
+	if (!value.dsize || value.dsize >= sizeof (str)) return -1;
+	memcpy(str, value.dptr, value.dsize);
+	str[value.dsize] = '\0';
+	MId = strtoul(str, NULL, 16);
+
+	return tdb_store(tdb_ctx, emsabp_tdb_MId_key(MId, buf), dn, TDB_REPLACE);
+}
+
+
+static int emsabp_tdb_traverse_index(TDB_CONTEXT *tdb_ctx,
+				     TDB_DATA key, TDB_DATA dbuf,
+				     void *state)
+{
+	size_t	*count = (size_t *) state;
+
+	/* Skip internal records */
+	if (!key.dsize || key.dptr[0] == '@') return 0;
+	if (key.dsize == strlen(EMSABP_TDB_DATA_REC) &&
+	    !strncmp((const char *)key.dptr, EMSABP_TDB_DATA_REC, key.dsize)) {
+		return 0;
+	}
+
+	if (emsabp_tdb_store_MId_key(tdb_ctx, key, dbuf) == -1) {
+		return -1;
+	}
+	*count += 1;
+
+	return 0;
+}
+
+
+/**
+   \details Build the MId -> DN records of the EMSABP TDB database if
+   they are missing
+
+   Databases created before the reverse records were introduced are
+   indexed once, the version record being stored last.
+
+   \param tdb_ctx pointer to the EMSABP TDB context
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS emsabp_tdb_index_MId(TDB_CONTEXT *tdb_ctx)
+{
+	enum MAPISTATUS	retval;
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	size_t		count = 0;
+	int		ret;
+
+	retval = emsabp_tdb_fetch(tdb_ctx, EMSABP_TDB_MID_INDEX_REC, &dbuf);
+	if (retval == MAPI_E_SUCCESS) {
+		free(dbuf.dptr);
+		return MAPI_E_SUCCESS;
+	}
+
+	ret = tdb_traverse(tdb_ctx, emsabp_tdb_traverse_index, (void *)&count);
+	OPENCHANGE_RETVAL_IF(ret == -1, MAPI_E_CORRUPT_STORE, NULL);
+
+	key.dptr = (unsigned char *) EMSABP_TDB_MID_INDEX_REC;
+	key.dsize = strlen(EMSABP_TDB_MID_INDEX_REC);
+	dbuf.dptr = (unsigned char *) EMSABP_TDB_MID_INDEX_VERSION;
+	dbuf.dsize = strlen(EMSABP_TDB_MID_INDEX_VERSION);
+
+	ret = tdb_store(tdb_ctx, key, dbuf, TDB_REPLACE);
+	OPENCHANGE_RETVAL_IF(ret == -1, MAPI_E_CORRUPT_STORE, NULL);
+
+	DEBUG(3, ("[%s:%d]: %d MId records indexed\n", __FUNCTION__, __LINE__, (int)count));
+
+	return MAPI_E_SUCCESS;
+}
 
 /**
    \details Open EMSABP TDB database
@@ -81,6 +186,15 @@ _PUBLIC_ TDB_CONTEXT *emsabp_tdb_init(TALLOC_CTX *mem_ctx,
 		free (dbuf.dptr);
 	}
 
+	/* Step 2. Ensure MId -> DN records are available */
+	retval = emsabp_tdb_index_MId(tdb_ctx);
+	if (retval != MAPI_E_SUCCESS) {
+		DEBUG(3, ("[%s:%d]: Unable to index MId records: %s\n", __FUNCTION__, __LINE__,
+			  tdb_errorstr(tdb_ctx)));
+		tdb_close(tdb_ctx);
+		return NULL;
+	}
+
 	return tdb_ctx;
 }
 
@@ -118,6 +232,12 @@ _PUBLIC_ TDB_CONTEXT *emsabp_tdb_init_tmp(TALLOC_CTX *mem_ctx)
 		tdb_close(tdb_ctx);
 		return NULL;
 	} 
+
+	/* Step 2. Fresh database: MId -> DN records are maintained on insert */
+	if (emsabp_tdb_index_MId(tdb_ctx) != MAPI_E_SUCCESS) {
+		tdb_close(tdb_ctx);
+		return NULL;
+	}
 	
 	return tdb_ctx;
 }
@@ -222,32 +342,8 @@ _PUBLIC_ enum MAPISTATUS emsabp_tdb_fetch_MId(TDB_CONTEXT *tdb_ctx,
 }
 
 
-static int emsabp_tdb_traverse_MId(TDB_CONTEXT *tdb_ctx, 
-				   TDB_DATA key, TDB_DATA dbuf, 
-				   void *state)
-{
-	TALLOC_CTX		*mem_ctx;
-	uint32_t		value;
-	char			*value_str = NULL;
-	struct traverse_MId	*mid_trav = (struct traverse_MId *) state;
-
-	mem_ctx = talloc_named(NULL, 0, "emsabp_tdb_traverse_MId");
-	value_str = talloc_strndup(mem_ctx, (char *)dbuf.dptr, dbuf.dsize);
-	value = strtol((const char *)value_str, NULL, 16);
-	talloc_free(mem_ctx);
-
-	if (value == mid_trav->MId) {
-		mid_trav->found = true;
-		return 1;
-	}
-
-	return 0;
-}
-
-
 /**
-   \details Traverse the EMSABP TDB database and look for the input
-   MId
+   \details Check whether a MId exists within the EMSABP TDB database
 
    \param tdb_ctx pointer to the EMSABP TDB context
    \param MId MID to lookup
@@ -257,73 +353,46 @@ static int emsabp_tdb_traverse_MId(TDB_CONTEXT *tdb_ctx,
 _PUBLIC_ bool emsabp_tdb_lookup_MId(TDB_CONTEXT *tdb_ctx,
 				    uint32_t MId)
 {
-	int			ret;
-	struct traverse_MId	mid_trav = { MId, false };
+	uint8_t		buf[EMSABP_TDB_MID_KEY_LEN];
 
-	ret = tdb_traverse(tdb_ctx, emsabp_tdb_traverse_MId, (void *)&mid_trav);
+	if (!tdb_ctx) return false;
 
-	return (ret > 0) && mid_trav.found;
-}
-
-
-static int emsabp_tdb_traverse_MId_DN(TDB_CONTEXT *tdb_ctx,
-				      TDB_DATA key, TDB_DATA dbuf,
-				      void *state)
-{
-	char			*MId;
-	uint32_t		value;
-	struct emsabp_MId	*emsabp_MId = (struct emsabp_MId *) state;
-
-	if (key.dptr) {
-		if (!strncmp((const char *)key.dptr, "CN=", 3)) {
-			MId = talloc_strndup(emsabp_MId, (char *)dbuf.dptr, dbuf.dsize);
-			value = strtol((const char *)MId, NULL, 16);
-			talloc_free(MId);
-			if (value == emsabp_MId->MId) {
-				emsabp_MId->dn = talloc_strndup(emsabp_MId, (char *)key.dptr, key.dsize);
-				return 1;
-			}
-		}
-	}
-
-	return 0;
+	return tdb_exists(tdb_ctx, emsabp_tdb_MId_key(MId, buf));
 }
 
 
 /**
-   \details Traverse the EMSABP TDB and fetch the DN associated with
-   the MId
+   \details Fetch the DN associated with the MId
 
    \param mem_ctx pointer to the memory context
    \param tdb_ctx pointer to the EMSABP TDB context
    \param MId MID to search
    \param dn pointer on pointer to the dn to return
 
-   \return MAPI_E_SUCCESS on success, otherwise false
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_NOT_FOUND
  */
 _PUBLIC_ enum MAPISTATUS emsabp_tdb_fetch_dn_from_MId(TALLOC_CTX *mem_ctx,
 						      TDB_CONTEXT *tdb_ctx,
 						      uint32_t MId,
 						      char **dn)
 {
-	int			ret;
-	struct emsabp_MId	*emsabp_MId;
-	
-	emsabp_MId = talloc_zero(mem_ctx, struct emsabp_MId);
-	emsabp_MId->dn = NULL;
-	emsabp_MId->MId = MId;
-	
-	ret = tdb_traverse(tdb_ctx, emsabp_tdb_traverse_MId_DN, (void *)emsabp_MId);
-	if (ret > -1 && emsabp_MId->dn) {
-		*dn = talloc_strdup(mem_ctx, emsabp_MId->dn);
-		talloc_free(emsabp_MId);
-		return MAPI_E_SUCCESS;
-	}
+	uint8_t		buf[EMSABP_TDB_MID_KEY_LEN];
+	TDB_DATA	dbuf;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!dn, MAPI_E_INVALID_PARAMETER, NULL);
 
 	*dn = NULL;
-	talloc_free(emsabp_MId);
 
-	return MAPI_E_NOT_FOUND;
+	dbuf = tdb_fetch(tdb_ctx, emsabp_tdb_MId_key(MId, buf));
+	OPENCHANGE_RETVAL_IF(!dbuf.dptr, MAPI_E_NOT_FOUND, NULL);
+
+	*dn = talloc_strndup(mem_ctx, (char *)dbuf.dptr, dbuf.dsize);
+	free(dbuf.dptr);
+	OPENCHANGE_RETVAL_IF(!*dn, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -377,6 +446,9 @@ _PUBLIC_ enum MAPISTATUS emsabp_tdb_insert(TDB_CONTEXT *tdb_ctx,
 	ret = tdb_store(tdb_ctx, key, dbuf, TDB_INSERT);
 	OPENCHANGE_RETVAL_IF(ret == -1, MAPI_E_CORRUPT_STORE, mem_ctx);
 
+	ret = emsabp_tdb_store_MId_key(tdb_ctx, key, dbuf);
+	OPENCHANGE_RETVAL_IF(ret == -1, MAPI_E_CORRUPT_STORE, mem_ctx);
+
 	/* Step 4. Update Data record */
 	key.dptr = (unsigned char *) EMSABP_TDB_DATA_REC;
 	key.dsize = strlen((const char *)key.dptr);
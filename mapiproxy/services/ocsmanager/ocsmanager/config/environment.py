@@ -1,5 +1,7 @@
 """Pylons environment configuration"""
 import os
+import logging
+import threading
 
 from mako.lookup import TemplateLookup
 from pylons.configuration import PylonsConfig
@@ -17,6 +19,8 @@ from samba import Ldb
 from samba.samdb import SamDB
 from samba.auth import system_session, admin_session
 
+log = logging.getLogger(__name__)
+
 FIRST_ORGANIZATION = "First Organization"
 FIRST_ORGANIZATION_UNIT = "First Administrative Group"
 
@@ -73,6 +77,46 @@ def _load_ocdb():
     return ocdb
 
 
+def _newmail_listener(mgmt, path):
+    """Dispatch the newmail events sent by the delivery agents on
+    the newmail endpoint.
+
+    """
+
+    from ocsmanager.model.NotificationModel import NotificationModel
+
+    notification = NotificationModel()
+    try:
+        mgmt.newmail_listen(path)
+    except OSError as e:
+        log.error("newmail endpoint %s: %s", path, e)
+        return
+
+    while True:
+        try:
+            events = mgmt.newmail_receive()
+        except Exception as e:
+            log.error("newmail endpoint %s: %s", path, e)
+            continue
+        for event in events:
+            (error, msg) = notification.dispatchNewMail(mgmt, event)
+            if error is True:
+                log.debug("newmail for %s in %s: %s", event['username'], event['folder'], msg)
+
+
+def _start_newmail_listener(mgmt, path):
+    """Start the newmail endpoint listener thread.
+
+    """
+
+    thread = threading.Thread(target=_newmail_listener, args=(mgmt, path),
+                              name="newmail")
+    thread.daemon = True
+    thread.start()
+
+    return thread
+
+
 def load_environment(global_conf, app_conf):
     """Configure the Pylons environment via the ``pylons.config``
     object
@@ -120,5 +164,9 @@ def load_environment(global_conf, app_conf):
     config['management'] = mstore.management()
     if config['ocsmanager']['main']['debug'] == "yes":
         config['management'].verbose = True;
+
+    if config['ocsmanager']['main']['newmail_socket']:
+        _start_newmail_listener(config['management'],
+                                config['ocsmanager']['main']['newmail_socket'])
     
     return config
@@ -57,6 +57,7 @@ class OCSConfig(object):
         self.__get_option('main', 'mapistore_root')
         self.__get_option('main', 'mapistore_data')
         self.__get_option('main', 'debug')
+        self.__get_option('main', 'newmail_socket', None, None, '')
         if self.d['main']['debug'] != "yes" and self.d['main']['debug'] != "no":
             log.error("%s: invalid debug value: %s. Must be set to yes or no", self.config, self.d['main']['debug'])
             sys.exit()
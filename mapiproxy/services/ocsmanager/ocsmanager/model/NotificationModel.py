@@ -35,7 +35,7 @@ class NotificationModel:
 
         # messageID parameter
         param = notification.find('messageID')
-        if param is None or param.text is None: retrun (True, 'Invalid/Missing messageID parameter')
+        if param is None or param.text is None: return (True, 'Invalid/Missing messageID parameter')
         params['messageID'] = param.text
 
         # username parameter
@@ -43,36 +43,58 @@ class NotificationModel:
         if param is None or param.text is None: return (True, 'Invalid/Missing username parameter')
         params['vuser'] = param.text
 
+        params['uids'] = [params['messageID']]
+
+        return self.dispatchNewMail(mgmt, params)
+
+    def dispatchNewMail(self, mgmt, params):
+        """Register the messages delivered to a folder and notify the
+        registered users. params holds the backend, the folder, the
+        username (vuser or username) and the list of delivered
+        messages (uids). All the messages are registered, then a
+        single newmail notification per user and folder is sent."""
+
+        if not 'vuser' in params: params['vuser'] = params['username']
+        if mgmt.registered_backend(params['backend']) is False: return (True, 'Specified backend is invalid')
+        uids = [str(uid) for uid in params['uids']]
+        if len(uids) == 0: return (True, 'No message')
+
         # Search for openchange user matching above attributes
         ed = mgmt.existing_users(params['backend'], params['vuser'], params['folder'])
         if ed['count'] == 0: return (True, 'Invalid user')
         print ed
-        count = 0
+        registered = 0
+        messages = {}
         for info in ed['infos']:
-            ret = mgmt.registered_message(params['backend'], info['username'], params['vuser'],
-                                          params['folder'], info['mapistoreURI'], params['messageID'])
-            if ret is True:
-                print 'Message already registered for user %s' % info['username']
-                count = count + 1
-            else:
-                # Register the message in all users indexing databases
-                message = mgmt.register_message(params['backend'], info['username'], 
-                                                info['mapistoreURI'], params['messageID'])
-                if not message: print "Unable to register URI for user %s" % (info['username'])
+            for uid in uids:
+                ret = mgmt.registered_message(params['backend'], info['username'], params['vuser'],
+                                              params['folder'], info['mapistoreURI'], uid)
+                if ret is True:
+                    print 'Message already registered for user %s' % info['username']
+                    registered = registered + 1
                 else:
-                    print "[REGISTERED] user %s: (%s, %s)" % (info['username'], hex(message[0]), message[1])
+                    # Register the message in all users indexing databases
+                    message = mgmt.register_message(params['backend'], info['username'], 
+                                                    info['mapistoreURI'], uid)
+                    if not message: print "Unable to register URI for user %s" % (info['username'])
+                    else:
+                        print "[REGISTERED] user %s: (%s, %s)" % (info['username'], hex(message[0]), message[1])
+                        messages[info['username']] = message
 
         # Case where all users referencing this folder already got notified
-        if count == ed['count']: return (True, 'Message already registered')
+        if registered == ed['count'] * len(uids): return (True, 'Message already registered')
 
         # Only trigger a notification for registered users
-        rd = mgmt.registered_users(params['backend'], param.text)
+        rd = mgmt.registered_users(params['backend'], params['vuser'])
         print rd
         if rd["count"] == 0: return (True, 'User not registered')
         params['usernames'] = rd["usernames"]
 
         # Trigger newmail notification for registered users (rd) who subscribed for newmail Notification
+        # The latest message of the folder stands for the whole batch
         for info in ed['infos']:
+            if not info['username'] in messages: continue
+            message = messages[info['username']]
             for username in params['usernames']:
 #                print 'Searching for fnevNewmail for %s on %s' % (username, info['mapistoreURI'])
 #                ret = mgmt.registered_subscription(username, info['mapistoreURI'], 1, 4)
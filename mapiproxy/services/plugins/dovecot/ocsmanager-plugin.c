@@ -21,12 +21,24 @@
 
 /*
   Step 1. Compile the plugin
-  gcc  -fPIC -shared -DHAVE_CONFIG_H `echo $DOVECOT_CFLAGS $LIBDOVECOT_INCLUDE $LIBDOVECOT_STORAGE_INCLUDE` ocsmanager-plugin.c -L/usr/lib/dovecot/modules/ -l15_notify_plugin -o ocsmanager_plugin.so
+  gcc  -fPIC -shared -DHAVE_CONFIG_H `echo $DOVECOT_CFLAGS $LIBDOVECOT_INCLUDE $LIBDOVECOT_STORAGE_INCLUDE` -I$OPENCHANGE_SRC `pkg-config --cflags --libs libmapistore` ocsmanager-plugin.c -L/usr/lib/dovecot/modules/ -l15_notify_plugin -o ocsmanager_plugin.so
 
   Step 2: Install the plugin
   sudo cp ocsmanager_plugin.so /usr/lib/dovecot/modules/ocsmanager_plugin.so
 
   Step 3: Configure ocsmanager plugin options in dovecot.conf
+  plugin {
+  ocsmanager_backend = SOGo
+  ocsmanager_socket = /var/run/ocsmanager/newmail.sock
+  ocsmanager_newmail_delay = 50
+}
+
+  ocsmanager_socket is the newmail endpoint ocsmanager listens on
+  (newmail_socket in ocsmanager.cfg). Deliveries are coalesced per
+  user and folder and sent as a single datagram ocsmanager_newmail_delay
+  milliseconds after the first one. Without ocsmanager_socket, the
+  plugin falls back to running newmail.py for every message:
+
   plugin {
   ocsmanager_backend = SOGo
   ocsmanager_newmail = /home/openchange/openchange/sogo-good/mapiproxy/services/client/newmail.py
@@ -70,6 +82,12 @@ enum ocsmanager_event {
 
 #define	OCSMANAGER_DEFAULT_EVENTS	(OCSMANAGER_EVENT_SAVE)
 
+/* newmail channel limits: keep a batch well below the datagram size */
+#define	OCSMANAGER_NEWMAIL_DELAY	50
+#define	OCSMANAGER_BATCH_MAX_COMMANDS	32
+#define	OCSMANAGER_BATCH_MAX_UIDS	2048
+#define	OCSMANAGER_SEND_MAX_RETRIES	20
+
 struct ocsmanager_user {
 	union mail_user_module_context	module_ctx;
 	enum ocsmanager_field		fields;
@@ -78,6 +96,19 @@ struct ocsmanager_user {
 	const char			*backend;
 	const char			*bin;
 	const char			*config;
+	const char			*socket;
+	unsigned int			delay;
+};
+
+struct ocsmanager_channel {
+	TALLOC_CTX				*mem_ctx;
+	char					*path;
+	int					fd;
+	unsigned int				delay;
+	struct mapistore_mgmt_command_batch	*batch;
+	uint32_t				uids_count;
+	unsigned int				retries;
+	struct timeout				*to;
 };
 
 struct ocsmanager_message {
@@ -102,6 +133,148 @@ struct ocsmanager_mail_txn_context {
 static MODULE_CONTEXT_DEFINE_INIT(ocsmanager_user_module,
 				  &mail_user_module_register);
 
+static struct ocsmanager_channel ocsmanager_channel = { .fd = -1 };
+
+static void ocsmanager_channel_flush(struct ocsmanager_channel *);
+
+static void ocsmanager_channel_timeout(struct ocsmanager_channel *channel)
+{
+	timeout_remove(&channel->to);
+	ocsmanager_channel_flush(channel);
+}
+
+static void ocsmanager_channel_schedule(struct ocsmanager_channel *channel)
+{
+	if (channel->to || !channel->batch) return;
+
+	/* lda runs without an ioloop: the batch is sent at deinit */
+	if (current_ioloop == NULL) return;
+
+	channel->to = timeout_add(channel->delay, ocsmanager_channel_timeout, channel);
+}
+
+/**
+   \details Send the pending batch on the newmail channel. The
+   connection is opened again once if ocsmanager was restarted. When
+   ocsmanager is busy, the batch is kept and sent again on the next
+   timeout.
+ */
+static void ocsmanager_channel_flush(struct ocsmanager_channel *channel)
+{
+	enum mapistore_error	retval;
+
+	if (!channel->batch || !channel->batch->count) return;
+
+	if (channel->fd == -1) {
+		channel->fd = mapistore_mgmt_newmail_connect(channel->path);
+	}
+
+	/* errno is only meaningful when send was attempted */
+	if (channel->fd == -1) {
+		retval = MAPISTORE_ERR_NOT_INITIALIZED;
+	} else {
+		retval = mapistore_mgmt_newmail_send(channel->fd, channel->batch);
+		if (retval == MAPISTORE_ERR_MSG_SEND && errno != EAGAIN && errno != EMSGSIZE) {
+			close(channel->fd);
+			channel->fd = mapistore_mgmt_newmail_connect(channel->path);
+			if (channel->fd == -1) {
+				retval = MAPISTORE_ERR_NOT_INITIALIZED;
+			} else {
+				retval = mapistore_mgmt_newmail_send(channel->fd, channel->batch);
+			}
+		}
+	}
+
+	if (retval == MAPISTORE_ERR_MSG_SEND && errno == EAGAIN
+	    && channel->retries++ < OCSMANAGER_SEND_MAX_RETRIES) {
+		ocsmanager_channel_schedule(channel);
+		return;
+	}
+
+	if (retval != MAPISTORE_SUCCESS) {
+		i_error("ocsmanager: unable to send %u newmail notifications to %s: %s",
+			channel->uids_count, channel->path, mapistore_errstr(retval));
+	}
+
+	talloc_free(channel->batch);
+	channel->batch = NULL;
+	channel->uids_count = 0;
+	channel->retries = 0;
+}
+
+/**
+   \details Queue a delivered message on the newmail channel. Messages
+   delivered to the same folder of the same user share a single
+   newmail command.
+ */
+static void ocsmanager_channel_add(struct ocsmanager_channel *channel, struct ocsmanager_message *msg)
+{
+	struct mapistore_mgmt_command_batch	*batch;
+	struct mapistore_mgmt_command		*commands;
+	struct mapistore_mgmt_newmail_cmd	*newmail = NULL;
+	struct timeval				tv;
+	uint32_t				*uids;
+	uint32_t				i;
+
+	if (!channel->mem_ctx) {
+		channel->mem_ctx = talloc_named(NULL, 0, "ocsmanager_channel");
+		if (!channel->mem_ctx) goto nomem;
+	}
+
+	if (!channel->batch) {
+		channel->batch = talloc_zero(channel->mem_ctx, struct mapistore_mgmt_command_batch);
+		if (!channel->batch) goto nomem;
+	}
+	batch = channel->batch;
+
+	for (i = 0; i < batch->count; i++) {
+		newmail = &batch->commands[i].command.newmail;
+		if (!strcmp(newmail->username, msg->username) && !strcmp(newmail->folder, msg->destination_folder)
+		    && !strcmp(newmail->backend, msg->backend)) {
+			break;
+		}
+	}
+
+	if (i == batch->count) {
+		gettimeofday(&tv, NULL);
+		/* the batch is left untouched when the array cannot grow */
+		commands = talloc_realloc(batch, batch->commands, struct mapistore_mgmt_command, batch->count + 1);
+		if (!commands) goto nomem;
+		batch->commands = commands;
+		memset(&batch->commands[i], 0, sizeof (struct mapistore_mgmt_command));
+		batch->commands[i].type = MAPISTORE_MGMT_NEWMAIL;
+		newmail = &batch->commands[i].command.newmail;
+		newmail->backend = talloc_strdup(batch->commands, msg->backend);
+		newmail->username = talloc_strdup(batch->commands, msg->username);
+		newmail->folder = talloc_strdup(batch->commands, msg->destination_folder);
+		if (!newmail->backend || !newmail->username || !newmail->folder) {
+			talloc_free(newmail->backend);
+			talloc_free(newmail->username);
+			talloc_free(newmail->folder);
+			goto nomem;
+		}
+		newmail->timestamp = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+		batch->count++;
+	}
+
+	uids = talloc_realloc(batch->commands, newmail->uids, uint32_t, newmail->count + 1);
+	if (!uids) goto nomem;
+	newmail->uids = uids;
+	newmail->uids[newmail->count++] = msg->uid;
+	channel->uids_count++;
+
+	if (batch->count >= OCSMANAGER_BATCH_MAX_COMMANDS || channel->uids_count >= OCSMANAGER_BATCH_MAX_UIDS) {
+		if (channel->to) timeout_remove(&channel->to);
+		ocsmanager_channel_flush(channel);
+	}
+	return;
+
+nomem:
+	i_error("ocsmanager: out of memory, dropping newmail notification for uid %u in %s",
+		msg->uid, msg->destination_folder);
+}
+}
+
 static void ocsmanager_mail_user_created(struct mail_user *user)
 {
 	struct ocsmanager_user	*ocsuser;
@@ -122,9 +295,16 @@ static void ocsmanager_mail_user_created(struct mail_user *user)
 	}
 	ocsuser->backend = str;
 
+	ocsuser->socket = mail_user_plugin_getenv(user, "ocsmanager_socket");
+	if (ocsuser->socket) {
+		str = mail_user_plugin_getenv(user, "ocsmanager_newmail_delay");
+		ocsuser->delay = str ? atoi(str) : OCSMANAGER_NEWMAIL_DELAY;
+		return;
+	}
+
 	str = mail_user_plugin_getenv(user, "ocsmanager_newmail");
 	if (!str) {
-		i_fatal("Missing ocsmanager_newmail parameter in dovecot.conf");
+		i_fatal("Missing ocsmanager_socket or ocsmanager_newmail parameter in dovecot.conf");
 	}
 	ocsuser->bin = str;
 	
@@ -159,6 +339,11 @@ static void ocsmanager_mail_copy(void *txn, struct mail *src, struct mail *dst)
 		msg->bin = p_strdup(ctx->pool, mctx->bin);
 		msg->config = p_strdup(ctx->pool, mctx->config);
 
+		if (mctx->socket && !ocsmanager_channel.path) {
+			ocsmanager_channel.path = i_strdup(mctx->socket);
+			ocsmanager_channel.delay = mctx->delay;
+		}
+
 		/* FIXME: Quick hack of the night */
 		msg->username[0] = toupper(msg->username[0]);
 		for (i = 0; i < strlen(msg->destination_folder); i++) {
@@ -202,6 +387,11 @@ static void ocsmanager_mail_transaction_commit(void *txn,
 			i_debug("# username = %s", msg->username);
 			i_debug("# backend = %s", msg->backend);
 
+			if (!msg->bin) {
+				ocsmanager_channel_add(&ocsmanager_channel, msg);
+				continue;
+			}
+
 			/* FIXME: I'm ashamed but I'm tired */
 			command = p_strdup_printf(ctx->pool, "python %s --config %s --backend %s --user %s --folder %s --msgid %d", msg->bin, msg->config, msg->backend, msg->username, msg->destination_folder, msg->uid);
 			system(command);
@@ -209,6 +399,12 @@ static void ocsmanager_mail_transaction_commit(void *txn,
 	}
 	i_assert(!seq_range_array_iter_nth(&iter, n, &uid));
 
+	if (ocsmanager_channel.delay == 0) {
+		ocsmanager_channel_flush(&ocsmanager_channel);
+	} else {
+		ocsmanager_channel_schedule(&ocsmanager_channel);
+	}
+
 	pool_unref(&ctx->pool);
 }
 
@@ -245,6 +441,15 @@ void ocsmanager_plugin_deinit(void)
 	i_debug("oscmanager_plugin_deinit");
 	mail_storage_hooks_remove(&ocsmanager_mail_storage_hooks);
 	notify_unregister(ocsmanager_ctx);
+
+	if (ocsmanager_channel.to) timeout_remove(&ocsmanager_channel.to);
+	ocsmanager_channel.retries = OCSMANAGER_SEND_MAX_RETRIES;
+	ocsmanager_channel_flush(&ocsmanager_channel);
+	if (ocsmanager_channel.fd != -1) close(ocsmanager_channel.fd);
+	ocsmanager_channel.fd = -1;
+	talloc_free(ocsmanager_channel.mem_ctx);
+	ocsmanager_channel.mem_ctx = NULL;
+	i_free(ocsmanager_channel.path);
 }
 
 const char *ocsmanager_plugin_dependencies[] = { "notify", NULL };
@@ -31,9 +31,17 @@
 #include "mail-storage-private.h"
 #include "mailbox-list-private.h"
 #include "notify-plugin.h"
+#include "ioloop.h"
+
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "mapiproxy/libmapistore/mgmt/mapistore_mgmt.h"
 
 #include <ctype.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <talloc.h>
 
 extern const char *ocsmanager_plugin_dependencies[];
 
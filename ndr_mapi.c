@@ -24,6 +24,7 @@
 #include <ndr.h>
 #include "gen_ndr/ndr_exchange.h"
 #include "gen_ndr/ndr_property.h"
+#include <time.h>
 
 #define MIN(a,b) ((a)<(b)?(a):(b))
 
@@ -207,6 +208,108 @@ _PUBLIC_ enum ndr_err_code ndr_push_lzxpress_compress(struct ndr_push *subndr,
 }
 
 
+/**
+   \details Return the CPU time consumed by the calling thread, in
+   microseconds
+ */
+static uint64_t mapi_compression_cpu_time(void)
+{
+	struct timespec	ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+		return 0;
+	}
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+   \details Push an extended buffer: an RPC_HEADER_EXT header followed
+   by its payload
+
+   When RHEF_Compressed is requested, the payload is LZ77 compressed
+   provided it is at least threshold bytes long, fits in a single
+   extended buffer and actually shrinks. Otherwise it is sent as is
+   and RHEF_Compressed is cleared. A compressed payload is never
+   obfuscated.
+
+   \param ndr pointer to the NDR push context to write to
+   \param data pointer to the uncompressed payload
+   \param size the size of the uncompressed payload
+   \param flags the requested RPC_HEADER_EXT flags
+   \param threshold the minimum payload size worth compressing
+   \param stats pointer to the compression counters to update, including
+   the CPU time spent compressing, can be NULL
+
+   \return NDR_ERR_SUCCESS on success, otherwise NDR error
+ */
+_PUBLIC_ enum ndr_err_code ndr_push_mapi_extended_buffer(struct ndr_push *ndr,
+							 const uint8_t *data,
+							 uint32_t size,
+							 uint16_t flags,
+							 uint32_t threshold,
+							 struct mapi_compression_stats *stats)
+{
+	struct RPC_HEADER_EXT	header;
+	uint8_t			*comp_data = NULL;
+	uint32_t		comp_size;
+	uint32_t		offset;
+	uint64_t		start = 0;
+	ssize_t			ret;
+
+	if ((flags & RHEF_Compressed) && (size < threshold || size > MAPI_EXTENDED_BUFFER_MAX_SIZE)) {
+		flags &= ~RHEF_Compressed;
+	}
+
+	if (flags & RHEF_Compressed) {
+		comp_size = size + (size / 8) + 16;
+		comp_data = talloc_array(ndr, uint8_t, comp_size);
+		NDR_ERR_HAVE_NO_MEMORY(comp_data);
+
+		if (stats) {
+			start = mapi_compression_cpu_time();
+		}
+		ret = lzxpress_compress(data, size, comp_data, comp_size);
+		if (stats) {
+			stats->usec += mapi_compression_cpu_time() - start;
+		}
+		if (ret > 0 && (uint32_t)ret < size) {
+			comp_size = ret;
+			flags &= ~RHEF_XorMagic;
+		} else {
+			talloc_free(comp_data);
+			comp_data = NULL;
+			flags &= ~RHEF_Compressed;
+		}
+	}
+
+	header.Version = 0x0000;
+	header.Flags = flags;
+	header.SizeActual = size;
+	header.Size = comp_data ? comp_size : size;
+
+	NDR_CHECK(ndr_push_RPC_HEADER_EXT(ndr, NDR_SCALARS|NDR_BUFFERS, &header));
+	offset = ndr->offset;
+	NDR_CHECK(ndr_push_bytes(ndr, comp_data ? comp_data : data, header.Size));
+	talloc_free(comp_data);
+
+	/* Obfuscate content if applicable */
+	if (header.Flags & RHEF_XorMagic) {
+		obfuscate_data(ndr->data + offset, header.Size, 0xA5);
+	}
+
+	if (stats) {
+		stats->buffers++;
+		stats->bytes_in += size;
+		stats->bytes_out += header.Size;
+		if (header.Flags & RHEF_Compressed) {
+			stats->compressed_buffers++;
+		}
+	}
+
+	return NDR_ERR_SUCCESS;
+}
+
 _PUBLIC_ enum ndr_err_code ndr_pull_mapi2k7_request(struct ndr_pull *ndr, int ndr_flags, struct mapi2k7_request *r)
 {
 	if (ndr_flags & NDR_SCALARS) {
@@ -247,10 +350,115 @@ _PUBLIC_ enum ndr_err_code ndr_pull_mapi2k7_request(struct ndr_pull *ndr, int nd
 }
 
 
+/**
+   \details Pull a chain of RPC_HEADER_EXT extended buffers
+
+   Each extended buffer holds its own RopSize, ROP replies and handle
+   table. The replies of all buffers are merged into a single
+   mapi_response, using the handle table of the last buffer.
+
+   \param ndr pointer to the NDR pull context, positioned after the
+   header of the first extended buffer
+   \param r pointer to the mapi2k7_response to fill
+
+   \return NDR_ERR_SUCCESS on success, otherwise NDR error
+ */
+static enum ndr_err_code ndr_pull_mapi2k7_response_chain(struct ndr_pull *ndr, struct mapi2k7_response *r)
+{
+	struct RPC_HEADER_EXT	header = r->header;
+	struct ndr_push		*ndr_rops;
+	struct ndr_pull		*_ndr_merged;
+	uint8_t			*data;
+	uint8_t			*payload = NULL;
+	uint32_t		rop_size = 0;
+	ssize_t			ret;
+
+	ndr_rops = ndr_push_init_ctx(ndr);
+	NDR_ERR_HAVE_NO_MEMORY(ndr_rops);
+	ndr_set_flags(&ndr_rops->flags, LIBNDR_FLAG_NOALIGN);
+	NDR_CHECK(ndr_push_uint16(ndr_rops, NDR_SCALARS, 0));
+
+	while (true) {
+		/* Step 1. Retrieve the plain payload of this buffer */
+		data = ndr->data + ndr->offset;
+		NDR_CHECK(ndr_pull_advance(ndr, header.Size));
+
+		talloc_free(payload);
+		payload = talloc_array(ndr_rops, uint8_t, header.SizeActual);
+		NDR_ERR_HAVE_NO_MEMORY(payload);
+		if (header.Flags & RHEF_Compressed) {
+			ret = lzxpress_decompress(data, header.Size, payload, header.SizeActual);
+			if (ret != header.SizeActual) {
+				return ndr_pull_error(ndr, NDR_ERR_COMPRESSION,
+						      "XPRESS lzxpress_decompress() returned %d\n",
+						      (int)ret);
+			}
+		} else {
+			if (header.Size != header.SizeActual) {
+				return ndr_pull_error(ndr, NDR_ERR_BUFSIZE,
+						      "Bad extended buffer size [%u] != [%u]",
+						      header.Size, header.SizeActual);
+			}
+			memcpy(payload, data, header.Size);
+			if (header.Flags & RHEF_XorMagic) {
+				obfuscate_data(payload, header.Size, 0xA5);
+			}
+		}
+
+		/* Step 2. Append its replies */
+		if (header.SizeActual < sizeof (uint16_t)) {
+			return ndr_pull_error(ndr, NDR_ERR_BUFSIZE, "Extended buffer too small");
+		}
+		rop_size = payload[0] | (payload[1] << 8);
+		if (rop_size < sizeof (uint16_t) || rop_size > header.SizeActual) {
+			return ndr_pull_error(ndr, NDR_ERR_BUFSIZE, "Bad RopSize [%u]", rop_size);
+		}
+		NDR_CHECK(ndr_push_bytes(ndr_rops, payload + sizeof (uint16_t), rop_size - sizeof (uint16_t)));
+
+		if ((header.Flags & RHEF_Last) || ndr->offset >= ndr->data_size) {
+			break;
+		}
+		NDR_CHECK(ndr_pull_RPC_HEADER_EXT(ndr, NDR_SCALARS, &header));
+	}
+
+	/* Step 3. Build the merged mapi_response with the handle table
+	 * of the last buffer */
+	if (ndr_rops->offset > 0xFFFF) {
+		return ndr_pull_error(ndr, NDR_ERR_BUFSIZE, "Chained replies exceed [%u] bytes", 0xFFFF);
+	}
+	rop_size = ndr_rops->offset;
+	ndr_rops->offset = 0;
+	NDR_CHECK(ndr_push_uint16(ndr_rops, NDR_SCALARS, rop_size));
+	ndr_rops->offset = rop_size;
+	rop_size = payload[0] | (payload[1] << 8);
+	NDR_CHECK(ndr_push_bytes(ndr_rops, payload + rop_size, header.SizeActual - rop_size));
+
+	if (ndr->flags & LIBNDR_FLAG_REF_ALLOC) {
+		NDR_PULL_ALLOC(ndr, r->mapi_response);
+	}
+
+	_ndr_merged = talloc_zero(ndr_rops, struct ndr_pull);
+	NDR_ERR_HAVE_NO_MEMORY(_ndr_merged);
+	_ndr_merged->flags = ndr->flags;
+	ndr_set_flags(&_ndr_merged->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REMAINING);
+	_ndr_merged->current_mem_ctx = ndr->current_mem_ctx;
+	_ndr_merged->data = talloc_steal(r->mapi_response, ndr_rops->data);
+	_ndr_merged->data_size = ndr_rops->offset;
+	_ndr_merged->offset = 0;
+
+	NDR_CHECK(ndr_pull_mapi_response(_ndr_merged, NDR_SCALARS|NDR_BUFFERS, r->mapi_response));
+	talloc_free(ndr_rops);
+
+	return NDR_ERR_SUCCESS;
+}
+
 _PUBLIC_ enum ndr_err_code ndr_pull_mapi2k7_response(struct ndr_pull *ndr, int ndr_flags, struct mapi2k7_response *r)
 {
 	if (ndr_flags & NDR_SCALARS) {
 		NDR_CHECK(ndr_pull_RPC_HEADER_EXT(ndr, NDR_SCALARS, &r->header));
+		if (!(r->header.Flags & RHEF_Last)) {
+			return ndr_pull_mapi2k7_response_chain(ndr, r);
+		}
 		{
 			uint32_t _flags_save_mapi_response = ndr->flags;
 			ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REMAINING);
@@ -22,11 +22,40 @@
 #include <Python.h>
 #include "pyopenchange/mapistore/pymapistore.h"
 
+#include <unistd.h>
+
+/* Store a new reference in a dict or list and release it: value may be
+   NULL when its creation failed, in which case -1 is returned */
+static int py_MAPIStoreMGMT_dict_set(PyObject *dict, const char *key, PyObject *value)
+{
+	int	ret;
+
+	if (!value) return -1;
+	ret = PyDict_SetItemString(dict, key, value);
+	Py_DECREF(value);
+
+	return ret;
+}
+
+static int py_MAPIStoreMGMT_list_append(PyObject *list, PyObject *value)
+{
+	int	ret;
+
+	if (!value) return -1;
+	ret = PyList_Append(list, value);
+	Py_DECREF(value);
+
+	return ret;
+}
+
 static void py_MAPIStoreMGMT_dealloc(PyObject *_self)
 {
 	PyMAPIStoreMGMTObject *self = (PyMAPIStoreMGMTObject *)_self;
 
 	printf("deallocate MGMT object\n");
+	if (self->newmail_fd != -1) {
+		close(self->newmail_fd);
+	}
 	mapistore_mgmt_release(self->mgmt_ctx);
 
 	Py_XDECREF(self->parent);
@@ -61,27 +90,41 @@ static PyObject *py_MAPIStoreMGMT_registered_users(PyMAPIStoreMGMTObject *self,
 	}
 
 	dict = PyDict_New();
-	PyDict_SetItemString(dict, "backend", PyString_FromString(backend));
-	PyDict_SetItemString(dict, "user", PyString_FromString(vuser));
-	
+	if (!dict) return NULL;
+	if (py_MAPIStoreMGMT_dict_set(dict, "backend", PyString_FromString(backend)) == -1 ||
+	    py_MAPIStoreMGMT_dict_set(dict, "user", PyString_FromString(vuser)) == -1) {
+		Py_DECREF(dict);
+		return NULL;
+	}
+
 	ulist = mapistore_mgmt_registered_users(self->mgmt_ctx, backend, vuser);
 	userlist = PyList_New(0);
+	if (!userlist) goto error;
 
 	if (ulist && ulist->count != 0) {
-		PyDict_SetItem(dict, PyString_FromString("count"), PyLong_FromLong(ulist->count));
+		if (py_MAPIStoreMGMT_dict_set(dict, "count", PyLong_FromLong(ulist->count)) == -1) goto error;
 		for (i = 0; i < ulist->count; i++) {
-			PyList_Append(userlist, PyString_FromString(ulist->user[i]));
+			if (py_MAPIStoreMGMT_list_append(userlist, PyString_FromString(ulist->user[i])) == -1) goto error;
 		}
 	} else {
-		PyDict_SetItem(dict, PyString_FromString("count"), PyLong_FromLong(0));
+		if (py_MAPIStoreMGMT_dict_set(dict, "count", PyLong_FromLong(0)) == -1) goto error;
 	}
-	PyDict_SetItem(dict, PyString_FromString("usernames"), userlist);
+	if (PyDict_SetItemString(dict, "usernames", userlist) == -1) goto error;
+	Py_DECREF(userlist);
 
 	if (ulist) {
 		talloc_free(ulist);
 	}
 
 	return (PyObject *)dict;
+
+error:
+	Py_XDECREF(userlist);
+	Py_DECREF(dict);
+	if (ulist) {
+		talloc_free(ulist);
+	}
+	return NULL;
 }
 
 static PyObject *py_MAPIStoreMGMT_registered_message(PyMAPIStoreMGMTObject *self, PyObject *args)
@@ -120,6 +163,7 @@ static PyObject *py_MAPIStoreMGMT_register_message(PyMAPIStoreMGMTObject *self,
 	}
 
 	retlist = PyList_New(0);
+	if (!retlist) return NULL;
 
 	/* Gets a new message ID */
 	globals = get_PyMAPIStoreGlobals();
@@ -130,9 +174,12 @@ static PyObject *py_MAPIStoreMGMT_register_message(PyMAPIStoreMGMTObject *self,
 	ret = mapistore_mgmt_register_message(self->mgmt_ctx, backend, user, mid, uri, messageID, &registered_uri);
 	if (ret) return (PyObject *)retlist;
 
-	PyList_Append(retlist, PyLong_FromLongLong(mid));
-	PyList_Append(retlist, PyString_FromString(registered_uri));
-	
+	if (py_MAPIStoreMGMT_list_append(retlist, PyLong_FromLongLong(mid)) == -1 ||
+	    py_MAPIStoreMGMT_list_append(retlist, PyString_FromString(registered_uri)) == -1) {
+		Py_DECREF(retlist);
+		retlist = NULL;
+	}
+
 	talloc_free(registered_uri);
 	return (PyObject *) retlist;
 }
@@ -158,31 +205,45 @@ static PyObject *py_MAPIStoreMGMT_existing_users(PyMAPIStoreMGMTObject *self, Py
 	}	
 
 	dict = PyDict_New();
+	if (!dict) return NULL;
 	userlist = PyList_New(0);
-	PyDict_SetItemString(dict, "backend", PyString_FromString(backend));
-	PyDict_SetItemString(dict, "user", PyString_FromString(vuser));
-	PyDict_SetItemString(dict, "count", PyLong_FromLong(0));
-	PyDict_SetItem(dict, PyString_FromString("infos"), userlist);
+	if (!userlist) goto error;
+	if (py_MAPIStoreMGMT_dict_set(dict, "backend", PyString_FromString(backend)) == -1 ||
+	    py_MAPIStoreMGMT_dict_set(dict, "user", PyString_FromString(vuser)) == -1 ||
+	    py_MAPIStoreMGMT_dict_set(dict, "count", PyLong_FromLong(0)) == -1 ||
+	    PyDict_SetItemString(dict, "infos", userlist) == -1) {
+		goto error;
+	}
 
 	ret = mapistore_mgmt_generate_uri(self->mgmt_ctx, backend, vuser, folder, NULL, NULL, &uri);
-	if (ret != MAPISTORE_SUCCESS) return (PyObject *)dict;
+	if (ret != MAPISTORE_SUCCESS) goto end;
 	printf("uri: %s\n", uri);
 
 	globals = get_PyMAPIStoreGlobals();
 	ret = openchangedb_get_users_from_partial_uri(self->mgmt_ctx, globals->ocdb_ctx, uri, 
 						      &count, &MAPIStoreURI, &users);
-	if (ret != MAPISTORE_SUCCESS) return (PyObject *)dict;
+	if (ret != MAPISTORE_SUCCESS) goto end;
 
-	PyDict_SetItemString(dict, "count", PyLong_FromLong(count));
+	if (py_MAPIStoreMGMT_dict_set(dict, "count", PyLong_FromLong(count)) == -1) goto error;
 	for (i = 0; i != count; i++) {
 		item = PyDict_New();
-		PyDict_SetItemString(item, "username", PyString_FromString(users[i]));
-		PyDict_SetItemString(item, "mapistoreURI", PyString_FromString(MAPIStoreURI[i]));
-		PyList_Append(userlist, item);
+		if (!item) goto error;
+		if (py_MAPIStoreMGMT_dict_set(item, "username", PyString_FromString(users[i])) == -1 ||
+		    py_MAPIStoreMGMT_dict_set(item, "mapistoreURI", PyString_FromString(MAPIStoreURI[i])) == -1) {
+			Py_DECREF(item);
+			goto error;
+		}
+		if (py_MAPIStoreMGMT_list_append(userlist, item) == -1) goto error;
 	}
-	PyDict_SetItem(dict, PyString_FromString("infos"), userlist);
 
+end:
+	Py_DECREF(userlist);
 	return (PyObject *)dict;
+
+error:
+	Py_XDECREF(userlist);
+	Py_DECREF(dict);
+	return NULL;
 }
 
 static PyObject *py_MAPIStoreMGMT_registered_subscription(PyMAPIStoreMGMTObject *self, PyObject *args)
@@ -253,6 +314,94 @@ static PyObject *py_MAPIStoreMGMT_send_newmail(PyMAPIStoreMGMTObject *self, PyOb
 	return PyBool_FromLong((ret == MAPISTORE_SUCCESS) ? true : false);
 }
 
+static PyObject *py_MAPIStoreMGMT_newmail_listen(PyMAPIStoreMGMTObject *self, PyObject *args)
+{
+	const char	*path;
+
+	if (!PyArg_ParseTuple(args, "s", &path)) {
+		return NULL;
+	}
+
+	if (self->newmail_fd != -1) {
+		close(self->newmail_fd);
+	}
+
+	self->newmail_fd = mapistore_mgmt_newmail_listen(path);
+	if (self->newmail_fd == -1) {
+		PyErr_SetFromErrnoWithFilename(PyExc_OSError, (char *)path);
+		return NULL;
+	}
+
+	Py_RETURN_NONE;
+}
+
+static PyObject *py_MAPIStoreMGMT_newmail_receive(PyMAPIStoreMGMTObject *self, PyObject *args)
+{
+	TALLOC_CTX				*mem_ctx;
+	PyObject				*list;
+	PyObject				*item;
+	PyObject				*uids;
+	PyObject				*uid;
+	struct mapistore_mgmt_command_batch	*batch = NULL;
+	struct mapistore_mgmt_newmail_cmd	*newmail;
+	enum mapistore_error			retval;
+	uint32_t				i;
+	uint32_t				j;
+
+	if (self->newmail_fd == -1) {
+		PyErr_SetMAPIStoreError(MAPISTORE_ERR_NOT_INITIALIZED);
+		return NULL;
+	}
+
+	mem_ctx = talloc_new(NULL);
+
+	/* ocsmanager runs this from a listener thread */
+	Py_BEGIN_ALLOW_THREADS
+	retval = mapistore_mgmt_newmail_receive(mem_ctx, self->newmail_fd, &batch);
+	Py_END_ALLOW_THREADS
+
+	if (retval != MAPISTORE_SUCCESS) {
+		talloc_free(mem_ctx);
+		PyErr_SetMAPIStoreError(retval);
+		return NULL;
+	}
+
+	list = PyList_New(0);
+	if (!list) goto error;
+	for (i = 0; i < batch->count; i++) {
+		newmail = &batch->commands[i].command.newmail;
+		item = PyDict_New();
+		if (!item) goto error;
+		if (py_MAPIStoreMGMT_list_append(list, item) == -1) goto error;
+		if (py_MAPIStoreMGMT_dict_set(item, "backend", PyString_FromString(newmail->backend)) == -1 ||
+		    py_MAPIStoreMGMT_dict_set(item, "username", PyString_FromString(newmail->username)) == -1 ||
+		    py_MAPIStoreMGMT_dict_set(item, "folder", PyString_FromString(newmail->folder)) == -1 ||
+		    py_MAPIStoreMGMT_dict_set(item, "timestamp", PyLong_FromUnsignedLongLong(newmail->timestamp)) == -1) {
+			goto error;
+		}
+		uids = PyList_New(newmail->count);
+		if (!uids) goto error;
+		for (j = 0; j < newmail->count; j++) {
+			uid = PyLong_FromUnsignedLong(newmail->uids[j]);
+			if (!uid) {
+				Py_DECREF(uids);
+				goto error;
+			}
+			/* steals the reference */
+			PyList_SET_ITEM(uids, j, uid);
+		}
+		if (py_MAPIStoreMGMT_dict_set(item, "uids", uids) == -1) goto error;
+	}
+	talloc_free(mem_ctx);
+
+	return list;
+
+error:
+	Py_XDECREF(list);
+	talloc_free(mem_ctx);
+	return NULL;
+}
+
 static PyObject *obj_get_verbose(PyMAPIStoreMGMTObject *self, void *closure)
 {
 	return PyBool_FromLong(self->mgmt_ctx->verbose);
@@ -274,6 +423,8 @@ static PyMethodDef mapistore_mgmt_methods[] = {
 	{ "registered_subscription", (PyCFunction)py_MAPIStoreMGMT_registered_subscription, METH_VARARGS },
 	{ "existing_users", (PyCFunction)py_MAPIStoreMGMT_existing_users, METH_VARARGS },
 	{ "send_newmail", (PyCFunction)py_MAPIStoreMGMT_send_newmail, METH_VARARGS },
+	{ "newmail_listen", (PyCFunction)py_MAPIStoreMGMT_newmail_listen, METH_VARARGS },
+	{ "newmail_receive", (PyCFunction)py_MAPIStoreMGMT_newmail_receive, METH_NOARGS },
 	{ NULL },
 };
 
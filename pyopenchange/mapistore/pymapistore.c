@@ -234,6 +234,7 @@ static PyObject *py_MAPIStore_new_mgmt(PyMAPIStoreObject *self, PyObject *args)
 		return NULL;
 	}
 	obj->mem_ctx = self->mem_ctx;
+	obj->newmail_fd = -1;
 	obj->parent = self;
 	Py_INCREF(obj->parent);
 
@@ -46,6 +46,7 @@ typedef struct {
 	PyObject_HEAD
 	TALLOC_CTX			*mem_ctx;
 	struct mapistore_mgmt_context	*mgmt_ctx;
+	int				newmail_fd;
 	PyMAPIStoreObject		*parent;
 } PyMAPIStoreMGMTObject;
 
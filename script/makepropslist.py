@@ -2,6 +2,7 @@
 # -*- coding: utf-8 -*-
 
 import argparse
+import re
 import string
 import subprocess
 import sys
@@ -534,6 +535,26 @@ temporary_private_tags_struct = """\t{ openchange_private_ROOT_FOLDER_FID,		PT_I
 	{ openchange_private_PF_LOCAL_OAB,		PT_I8, "openchange_private_PF_LOCAL_OAB" },
 """
 
+# Values of the property tags defined in the private tags blocks above
+def private_tags_values():
+	values = { "PidTagFolderChildCount" : 0x66380003 }
+	for match in re.finditer(r"#define (\w+)\s+PROP_TAG\([^)]*\)\s*/\* (0x[0-9a-fA-F]+) \*/", temporary_private_tags):
+		values[match.group(1)] = int(match.group(2), 16)
+	return values
+
+# Property tags used by the rows of a private tags block
+def private_tags_rows(block):
+	values = private_tags_values()
+	return [(name, values[name]) for name in re.findall(r"\{ (\w+),", block)]
+
+# Write an array of table indexes, sorted by key(index) at generation time
+def write_sorted_index(f, name, indexes, key):
+	f.write("static const uint16_t %s[] = {\n" % name)
+	indexes = sorted(indexes, key=lambda idx: (key(idx), idx))
+	for pos in range(0, len(indexes), 12):
+		f.write("\t" + " ".join(["%4d," % idx for idx in indexes[pos:pos + 12]]) + "\n")
+	f.write("};\n\n")
+
 def make_mapi_properties_file():
 	proplines = []
 	altnamelines = []
@@ -694,42 +715,71 @@ def make_mapi_properties_file():
 			print "Section", entry["OXPROPS_Sect"], "has no data type entry"
 			continue
 		if entry.has_key("PropertyId"):
+			proptag = (entry["PropertyId"] << 16) | int(knowndatatypes[entry["DataTypeName"]], 16)
 			propline = "\t{ "
 			propline += string.ljust(entry["CanonicalName"] + ",", 68)
 			propline += string.ljust(datatypemap[entry["DataTypeName"]] + ",", 14)
 			propline += string.ljust("\"" + entry["CanonicalName"] + "\"" , 68) + "},\n"
-			proplines.append(propline)
+			proplines.append((propline, [(entry["CanonicalName"], proptag)]))
 			propline = "\t{ "
 			propline += string.ljust(entry["CanonicalName"] + "_Error,", 68)
 			propline += string.ljust("PT_ERROR,", 14)
 			propline += string.ljust("\"" + entry["CanonicalName"] + "_Error" + "\"" , 68) + "},\n"
-			proplines.append(propline)
-	proplines.append(extra_private_tags_struct)
+			proplines.append((propline, [(entry["CanonicalName"] + "_Error", (entry["PropertyId"] << 16) | 0x000A)]))
+	proplines.append((extra_private_tags_struct, private_tags_rows(extra_private_tags_struct)))
 	# this is just a temporary hack till we properly support named properties
-	proplines.append(temporary_private_tags_struct)
+	proplines.append((temporary_private_tags_struct, private_tags_rows(temporary_private_tags_struct)))
 	sortedproplines = sorted(proplines)
+	rows = []
 	f.write("static struct mapi_proptags canonical_property_tags[] = {\n")
-	for propline in sortedproplines:
+	for (propline, proprows) in sortedproplines:
 		f.write(propline)
+		rows.extend(proprows)
 	f.write("\t{ 0,                                                                  0,            \"NULL\"                                                              }\n")
-	f.write("};\n")
-	f.write("""
+	f.write("};\n\n")
+
+	# write lookup indexes, sorted by property tag and by name
+	f.write("#define\tCANONICAL_PROPERTY_TAGS_COUNT\t%d\n\n" % len(rows))
+	write_sorted_index(f, "canonical_property_tags_by_tag", range(len(rows)), lambda idx: rows[idx][1])
+	write_sorted_index(f, "canonical_property_tags_by_name", range(len(rows)), lambda idx: rows[idx][0])
+	f.write("""/**
+   \\details Return the position in canonical_property_tags_by_tag of the
+   first entry whose property tag is not lower than proptag
+ */
+static uint32_t canonical_property_tags_lower_bound(uint32_t proptag)
+{
+	uint32_t	low = 0;
+	uint32_t	high = CANONICAL_PROPERTY_TAGS_COUNT;
+	uint32_t	mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (canonical_property_tags[canonical_property_tags_by_tag[mid]].proptag < proptag) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
 _PUBLIC_ const char *get_proptag_name(uint32_t proptag)
 {
-	uint32_t idx;
+	uint32_t pos;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
-		}
+	pos = canonical_property_tags_lower_bound(proptag);
+	if (pos < CANONICAL_PROPERTY_TAGS_COUNT &&
+	    canonical_property_tags[canonical_property_tags_by_tag[pos]].proptag == proptag) {
+		return canonical_property_tags[canonical_property_tags_by_tag[pos]].propname;
 	}
 	if (((proptag & 0xFFFF) == PT_STRING8) ||
 	    ((proptag & 0xFFFF) == PT_MV_STRING8)) {
 		proptag += 1; /* try as _UNICODE variant */
-	}
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
+		pos = canonical_property_tags_lower_bound(proptag);
+		if (pos < CANONICAL_PROPERTY_TAGS_COUNT &&
+		    canonical_property_tags[canonical_property_tags_by_tag[pos]].proptag == proptag) {
+			return canonical_property_tags[canonical_property_tags_by_tag[pos]].propname;
 		}
 	}
 	return NULL;
@@ -737,11 +787,20 @@ _PUBLIC_ const char *get_proptag_name(uint32_t proptag)
 
 _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 {
-	uint32_t idx;
-
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (!strcmp(canonical_property_tags[idx].propname, propname)) { 
-			return canonical_property_tags[idx].proptag;
+	uint32_t	low = 0;
+	uint32_t	high = CANONICAL_PROPERTY_TAGS_COUNT;
+	uint32_t	mid;
+	int		ret;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		ret = strcmp(canonical_property_tags[canonical_property_tags_by_name[mid]].propname, propname);
+		if (!ret) {
+			return canonical_property_tags[canonical_property_tags_by_name[mid]].proptag;
+		} else if (ret < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
 		}
 	}
 
@@ -750,17 +809,25 @@ _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 
 _PUBLIC_ uint16_t get_property_type(uint16_t untypedtag)
 {
+	uint32_t	pos;
 	uint32_t	idx;
+	uint32_t	found = CANONICAL_PROPERTY_TAGS_COUNT;
 	uint16_t	current_type;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if ((canonical_property_tags[idx].proptag >> 16) == untypedtag) {
-			current_type = canonical_property_tags[idx].proptype;
-			if (current_type != PT_ERROR && current_type != PT_STRING8) {
-				return current_type;
-			}
+	/* Entries sharing a property id are contiguous: keep the first
+	 * one in table order, as a linear scan would */
+	for (pos = canonical_property_tags_lower_bound(untypedtag << 16);
+	     pos < CANONICAL_PROPERTY_TAGS_COUNT; pos++) {
+		idx = canonical_property_tags_by_tag[pos];
+		if ((canonical_property_tags[idx].proptag >> 16) != untypedtag) break;
+		current_type = canonical_property_tags[idx].proptype;
+		if (current_type != PT_ERROR && current_type != PT_STRING8 && idx < found) {
+			found = idx;
 		}
 	}
+	if (found < CANONICAL_PROPERTY_TAGS_COUNT) {
+		return canonical_property_tags[found].proptype;
+	}
 
 	DEBUG(5, ("%s: type for property '%x' could not be deduced\\n", __FUNCTION__, untypedtag));
 	return 0;
@@ -1384,7 +1451,39 @@ static struct mapi_nameid_names mapi_nameid_names[] = {
 	f.write("""
 };
 
-#endif /* !MAPI_NAMEID_PRIVATE_H__ */
+""")
+
+	# write lookup indexes over both tables: (proptag, OOM, lid, Name)
+	# for mapi_nameid_tags and (proptag, propname) for mapi_nameid_names
+	tags = []
+	for line in sortednamedprops:
+		if line[5] == "MNID_ID":
+			tags.append((int(line[2], 16) << 16 | int(line[4], 16), line[1], int(line[2], 16), None))
+	mnstring_id = 0xa000
+	for line in sortednamedprops:
+		if line[5] == "MNID_STRING":
+			tags.append(((mnstring_id << 16) | int(line[4], 16), None, 0, line[3]))
+			mnstring_id += 1
+	tags.append((0x8f050003, "RemoteTransferSize", 0x8f05, None))
+	tagvalues = {}
+	for (line, tag) in zip([line for line in sortednamedprops if line[5] == "MNID_ID"] +
+			       [line for line in sortednamedprops if line[5] == "MNID_STRING"], tags):
+		tagvalues[line[0]] = tag[0]
+	names = [(tagvalues[line[0]], line[0]) for line in sortednamedprops]
+
+	f.write("#define\tMAPI_NAMEID_TAGS_COUNT\t%d\n" % len(tags))
+	f.write("#define\tMAPI_NAMEID_NAMES_COUNT\t%d\n\n" % len(names))
+	write_sorted_index(f, "mapi_nameid_tags_by_proptag", range(len(tags)), lambda idx: tags[idx][0])
+	write_sorted_index(f, "mapi_nameid_tags_by_lid", range(len(tags)), lambda idx: tags[idx][2])
+	oom_indexes = [idx for idx in range(len(tags)) if tags[idx][1] is not None]
+	f.write("#define\tMAPI_NAMEID_TAGS_OOM_COUNT\t%d\n\n" % len(oom_indexes))
+	write_sorted_index(f, "mapi_nameid_tags_by_OOM", oom_indexes, lambda idx: tags[idx][1])
+	name_indexes = [idx for idx in range(len(tags)) if tags[idx][3] is not None]
+	f.write("#define\tMAPI_NAMEID_TAGS_NAME_COUNT\t%d\n\n" % len(name_indexes))
+	write_sorted_index(f, "mapi_nameid_tags_by_Name", name_indexes, lambda idx: tags[idx][3])
+	write_sorted_index(f, "mapi_nameid_names_by_proptag", range(len(names)), lambda idx: names[idx][0])
+	write_sorted_index(f, "mapi_nameid_names_by_propname", range(len(names)), lambda idx: names[idx][1])
+	f.write("""#endif /* !MAPI_NAMEID_PRIVATE_H__ */
 """)
 	f.close()
 
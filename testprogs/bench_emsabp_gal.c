@@ -0,0 +1,231 @@
+/*
+   Benchmark the EMSABP GAL index
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+   A temporary LDB database is populated with a GAL sized set of user
+   records. The GAL index is loaded from it, then a fixed number of
+   names are resolved through the index and through the LDB searches
+   emsabp_search used to run for every NspiGetMatches and
+   NspiResolveNames call. A share of the records is finally modified
+   to time an incremental update of the index.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/servers/default/nspi/dcesrv_exchange_nsp.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <ldb_module.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define	BENCH_ENTRIES	50000
+#define	BENCH_LOOKUPS	1000
+#define	BENCH_CHANGES	500
+
+static const char * const bench_given[] = { "John", "Jane", "Alice", "Bob", "Carol", "David", "Erin", "Frank" };
+static const char * const bench_sn[] = { "Smith", "Doe", "Brown", "Johnson", "Lee", "Martin", "Garcia", "Miller" };
+
+static double bench_now(void)
+{
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static int bench_add_user(TALLOC_CTX *mem_ctx, struct ldb_context *ldb_ctx, uint32_t i, uint64_t usn, bool modify)
+{
+	struct ldb_message	*msg;
+	const char		*given = bench_given[i % 8];
+	const char		*sn = bench_sn[(i / 8) % 8];
+	int			ret;
+
+	msg = ldb_msg_new(mem_ctx);
+	msg->dn = ldb_dn_new_fmt(msg, ldb_ctx, "CN=user%u,CN=Users,DC=example,DC=com", i);
+	ldb_msg_add_string(msg, "objectClass", "user");
+	ldb_msg_add_fmt(msg, "distinguishedName", "CN=user%u,CN=Users,DC=example,DC=com", i);
+	ldb_msg_add_fmt(msg, "displayName", "%s %s%s%u", given, sn, modify ? " (renamed) " : " ", i);
+	ldb_msg_add_fmt(msg, "givenName", "%s", given);
+	ldb_msg_add_fmt(msg, "sn", "%s%u", sn, i);
+	ldb_msg_add_fmt(msg, "sAMAccountName", "user%u", i);
+	ldb_msg_add_fmt(msg, "mail", "user%u@example.com", i);
+	ldb_msg_add_fmt(msg, "proxyAddresses", "SMTP:user%u@example.com", i);
+	ldb_msg_add_fmt(msg, "legacyExchangeDN", "/o=First Organization/ou=Exchange Administrative Group/cn=Recipients/cn=user%u", i);
+	ldb_msg_add_fmt(msg, "uSNChanged", "%"PRIu64, usn);
+
+	if (modify) {
+		ret = ldb_delete(ldb_ctx, msg->dn);
+		if (ret == LDB_SUCCESS) {
+			ret = ldb_add(ldb_ctx, msg);
+		}
+	} else {
+		ret = ldb_add(ldb_ctx, msg);
+	}
+	talloc_free(msg);
+
+	return ret;
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX		*mem_ctx;
+	TALLOC_CTX		*tmp_ctx;
+	struct ldb_context	*ldb_ctx;
+	struct ldb_result	*res;
+	struct emsabp_gal	*gal;
+	poptContext		pc;
+	int			opt;
+	int			fd;
+	uint32_t		opt_entries = BENCH_ENTRIES;
+	uint32_t		opt_lookups = BENCH_LOOKUPS;
+	uint32_t		legacy_lookups;
+	uint32_t		i;
+	uint32_t		count;
+	uint32_t		index_found = 0;
+	uint32_t		legacy_found = 0;
+	const char		**dns;
+	const char		*name;
+	const char * const	attrs[] = { "*", NULL };
+	char			path[] = "/tmp/bench_emsabp_gal.XXXXXX";
+	double			start;
+	double			index_time;
+	double			legacy_time;
+
+	enum {OPT_ENTRIES=1000, OPT_LOOKUPS};
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{"entries", 'e', POPT_ARG_INT, NULL, OPT_ENTRIES, "populate the directory with COUNT users", "COUNT"},
+		{"lookups", 'l', POPT_ARG_INT, NULL, OPT_LOOKUPS, "resolve COUNT names", "COUNT"},
+		{ NULL, 0, POPT_ARG_NONE, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_emsabp_gal", argc, argv, long_options, 0);
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_ENTRIES:
+			opt_entries = atoi(poptGetOptArg(pc));
+			break;
+		case OPT_LOOKUPS:
+			opt_lookups = atoi(poptGetOptArg(pc));
+			break;
+		}
+	}
+	poptFreeContext(pc);
+
+	if (!opt_entries) {
+		fprintf(stderr, "at least one entry is required\n");
+		return 1;
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_emsabp_gal");
+
+	fd = mkstemp(path);
+	if (fd == -1) {
+		fprintf(stderr, "unable to create the directory database\n");
+		talloc_free(mem_ctx);
+		return 1;
+	}
+	close(fd);
+	unlink(path);
+
+	ldb_ctx = ldb_init(mem_ctx, NULL);
+	if (!ldb_ctx || ldb_connect(ldb_ctx, path, 0, NULL) != LDB_SUCCESS) {
+		fprintf(stderr, "unable to open the directory database\n");
+		talloc_free(mem_ctx);
+		return 1;
+	}
+	ldb_schema_attribute_add(ldb_ctx, "uSNChanged", 0, LDB_SYNTAX_INTEGER);
+
+	/* Step 1. Populate the directory */
+	start = bench_now();
+	ldb_transaction_start(ldb_ctx);
+	for (i = 0; i < opt_entries; i++) {
+		if (bench_add_user(mem_ctx, ldb_ctx, i, i + 1, false) != LDB_SUCCESS) {
+			fprintf(stderr, "unable to add user%u: %s\n", i, ldb_errstring(ldb_ctx));
+			ldb_transaction_cancel(ldb_ctx);
+			goto end;
+		}
+	}
+	ldb_transaction_commit(ldb_ctx);
+	printf("%u users added in %.3f s\n", opt_entries, bench_now() - start);
+
+	/* Step 2. Load the index */
+	gal = emsabp_gal_init(mem_ctx, 0);
+	start = bench_now();
+	if (emsabp_gal_refresh(gal, ldb_ctx, true) != MAPI_E_SUCCESS) {
+		fprintf(stderr, "unable to load the GAL index\n");
+		goto end;
+	}
+	printf("index loaded in %.3f ms: %u records, %u tokens\n", (bench_now() - start) * 1000.0,
+	       gal->count, gal->tokens_count);
+
+	/* Step 3. Resolve names through the index */
+	start = bench_now();
+	for (i = 0; i < opt_lookups; i++) {
+		tmp_ctx = talloc_new(mem_ctx);
+		name = talloc_asprintf(tmp_ctx, "%s %s%u", bench_given[i % 8], bench_sn[(i / 8) % 8], (i * 7919) % opt_entries);
+		if (emsabp_gal_search(tmp_ctx, gal, "anr", name, &dns, &count) == MAPI_E_SUCCESS) {
+			index_found += count;
+		}
+		talloc_free(tmp_ctx);
+	}
+	index_time = bench_now() - start;
+	printf("index  %7u entries: %u matches for %u names, %10.3f us/resolve\n", opt_entries,
+	       index_found, opt_lookups, index_time * 1000000.0 / opt_lookups);
+
+	/* Step 4. Resolve names with LDB searches, limited to keep the run short */
+	legacy_lookups = opt_lookups < 100 ? opt_lookups : 100;
+	start = bench_now();
+	for (i = 0; i < legacy_lookups; i++) {
+		tmp_ctx = talloc_new(mem_ctx);
+		name = talloc_asprintf(tmp_ctx, "%s %s%u", bench_given[i % 8], bench_sn[(i / 8) % 8], (i * 7919) % opt_entries);
+		if (ldb_search(ldb_ctx, tmp_ctx, &res, NULL, LDB_SCOPE_SUBTREE, attrs,
+			       "(&(objectClass=user)(|(displayName=%s*)(sAMAccountName=%s*)(mail=%s*)(proxyAddresses=%s*))(!(objectClass=computer)))",
+			       name, name, name, name) == LDB_SUCCESS) {
+			legacy_found += res->count;
+		}
+		talloc_free(tmp_ctx);
+	}
+	legacy_time = bench_now() - start;
+	printf("ldb    %7u entries: %u matches for %u names, %10.3f us/resolve\n", opt_entries,
+	       legacy_found, legacy_lookups, legacy_time * 1000000.0 / legacy_lookups);
+
+	/* Step 5. Incremental update */
+	ldb_transaction_start(ldb_ctx);
+	for (i = 0; i < BENCH_CHANGES && i < opt_entries; i++) {
+		bench_add_user(mem_ctx, ldb_ctx, (i * 7919) % opt_entries, opt_entries + i + 1, true);
+	}
+	ldb_transaction_commit(ldb_ctx);
+
+	start = bench_now();
+	emsabp_gal_refresh(gal, ldb_ctx, true);
+	printf("index updated in %.3f ms: %u records changed, highest USN %"PRIu64"\n",
+	       (bench_now() - start) * 1000.0, i, gal->highest_usn);
+
+end:
+	talloc_free(mem_ctx);
+	unlink(path);
+
+	return 0;
+}
@@ -0,0 +1,165 @@
+/*
+   Benchmark the EMSABP TDB MId lookups
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+   Populate an in-memory EMSABP TDB with a GAL sized set of DN
+   records, then resolve a fixed number of MIds to their DN with the
+   MId -> DN records and with the full traverse they replaced.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/servers/default/nspi/dcesrv_exchange_nsp.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <tdb.h>
+#include <sys/time.h>
+
+#define	BENCH_ENTRIES	40000
+#define	BENCH_LOOKUPS	10000
+
+struct legacy_MId {
+	uint32_t	MId;
+	char		*dn;
+};
+
+static double bench_now(void)
+{
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static int legacy_traverse_MId_DN(TDB_CONTEXT *tdb_ctx, TDB_DATA key, TDB_DATA dbuf, void *state)
+{
+	struct legacy_MId	*legacy = (struct legacy_MId *) state;
+	char			*MId;
+	uint32_t		value;
+
+	if (key.dptr && !strncmp((const char *)key.dptr, "CN=", 3)) {
+		MId = talloc_strndup(NULL, (char *)dbuf.dptr, dbuf.dsize);
+		value = strtol((const char *)MId, NULL, 16);
+		talloc_free(MId);
+		if (value == legacy->MId) {
+			legacy->dn = talloc_strndup(NULL, (char *)key.dptr, key.dsize);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX		*mem_ctx;
+	TDB_CONTEXT		*tdb_ctx;
+	poptContext		pc;
+	int			opt;
+	uint32_t		opt_entries = BENCH_ENTRIES;
+	uint32_t		opt_lookups = BENCH_LOOKUPS;
+	uint32_t		legacy_lookups;
+	uint32_t		i;
+	uint32_t		MId;
+	uint32_t		found;
+	char			*dn;
+	struct legacy_MId	legacy;
+	double			start;
+	double			index_time;
+	double			legacy_time;
+
+	enum {OPT_ENTRIES=1000, OPT_LOOKUPS};
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{"entries", 'e', POPT_ARG_INT, NULL, OPT_ENTRIES, "populate the database with COUNT DN records", "COUNT"},
+		{"lookups", 'l', POPT_ARG_INT, NULL, OPT_LOOKUPS, "resolve COUNT MIds", "COUNT"},
+		{ NULL, 0, POPT_ARG_NONE, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_emsabp_tdb", argc, argv, long_options, 0);
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_ENTRIES:
+			opt_entries = atoi(poptGetOptArg(pc));
+			break;
+		case OPT_LOOKUPS:
+			opt_lookups = atoi(poptGetOptArg(pc));
+			break;
+		}
+	}
+	poptFreeContext(pc);
+
+	if (!opt_entries) {
+		fprintf(stderr, "at least one entry is required\n");
+		return 1;
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_emsabp_tdb");
+	tdb_ctx = emsabp_tdb_init_tmp(mem_ctx);
+	if (!tdb_ctx) {
+		fprintf(stderr, "unable to initialize the EMSABP TDB\n");
+		talloc_free(mem_ctx);
+		return 1;
+	}
+
+	for (i = 0; i < opt_entries; i++) {
+		dn = talloc_asprintf(mem_ctx, "CN=user%u,CN=Users,DC=example,DC=com", i);
+		emsabp_tdb_insert(tdb_ctx, dn);
+		talloc_free(dn);
+	}
+
+	/* Step 1. MId -> DN records */
+	start = bench_now();
+	for (i = 0, found = 0; i < opt_lookups; i++) {
+		MId = EMSABP_TDB_TMP_MID_START + 1 + (i * 7919) % opt_entries;
+		if (emsabp_tdb_lookup_MId(tdb_ctx, MId) &&
+		    emsabp_tdb_fetch_dn_from_MId(mem_ctx, tdb_ctx, MId, &dn) == MAPI_E_SUCCESS) {
+			talloc_free(dn);
+			found++;
+		}
+	}
+	index_time = bench_now() - start;
+	printf("index    %7u entries: %u/%u MIds resolved, %10.3f us/lookup\n", opt_entries,
+	       found, opt_lookups, opt_lookups ? index_time * 1000000.0 / opt_lookups : 0.0);
+
+	/* Step 2. Full traverse, limited to keep the run short */
+	legacy_lookups = opt_lookups < 100 ? opt_lookups : 100;
+	start = bench_now();
+	for (i = 0, found = 0; i < legacy_lookups; i++) {
+		legacy.MId = EMSABP_TDB_TMP_MID_START + 1 + (i * 7919) % opt_entries;
+		legacy.dn = NULL;
+		tdb_traverse(tdb_ctx, legacy_traverse_MId_DN, (void *)&legacy);
+		if (legacy.dn) {
+			talloc_free(legacy.dn);
+			found++;
+		}
+	}
+	legacy_time = bench_now() - start;
+	printf("traverse %7u entries: %u/%u MIds resolved, %10.3f us/lookup\n", opt_entries,
+	       found, legacy_lookups, legacy_lookups ? legacy_time * 1000000.0 / legacy_lookups : 0.0);
+
+	tdb_close(tdb_ctx);
+	talloc_free(mem_ctx);
+
+	return 0;
+}
@@ -0,0 +1,365 @@
+/*
+   Benchmark emsmdbp search folders
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+   A synthetic folder of messages (flags, follow up status, subject,
+   delivery time and importance) is searched with the criteria Outlook
+   sets on its default search folders: unread mail, mail flagged for
+   follow up and a subject search restricted to recent mail.
+
+   For each criteria, the restriction is compiled once and the folder
+   populated from its rows. A fixed number of message changes is then
+   applied, either incrementally (the changed message is evaluated
+   and the results updated) or by running the whole search again for
+   each change.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/servers/default/emsmdb/dcesrv_exchange_emsmdb.h"
+#include "libmapi/libmapi.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <sys/time.h>
+
+#define	BENCH_MESSAGES		100000
+#define	BENCH_CHANGES		10000
+#define	BENCH_RESCANS		20
+
+struct bench_message {
+	uint32_t	flags;
+	uint32_t	flag_status;
+	bool		flagged;
+	const char	*subject;
+	struct FILETIME	delivery_time;
+	uint32_t	importance;
+};
+
+static const char *bench_subjects[] = {
+	"Weekly status report",
+	"Re: lunch on friday?",
+	"Build failures on the nightly branch",
+	"FW: Quarterly REPORT draft",
+	"Meeting notes",
+	"Invitation: design review",
+	NULL
+};
+
+static double bench_now(void)
+{
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static void bench_fill_message(struct bench_message *message, uint32_t i)
+{
+	uint64_t	nt_time;
+
+	message->flags = ((i * 7) % 10) < 3 ? 0 : MSGFLAG_READ;
+	message->flagged = (i % 17) == 0;
+	message->flag_status = 2;
+	message->subject = bench_subjects[i % 6];
+	nt_time = 130000000000000000ULL + (uint64_t)i * 600000000ULL;
+	message->delivery_time.dwLowDateTime = nt_time & 0xFFFFFFFF;
+	message->delivery_time.dwHighDateTime = nt_time >> 32;
+	message->importance = (i % 11) ? 1 : 2;
+}
+
+/* what a contents table row holds for the columns of a restriction */
+static void bench_row(struct bench_message *message, struct SPropTagArray *columns, void **data_pointers, enum MAPISTATUS *retvals)
+{
+	uint32_t	i;
+
+	for (i = 0; i < columns->cValues; i++) {
+		retvals[i] = MAPI_E_SUCCESS;
+		switch (columns->aulPropTag[i]) {
+		case PidTagMessageFlags:
+			data_pointers[i] = &message->flags;
+			break;
+		case PidTagFlagStatus:
+			data_pointers[i] = message->flagged ? &message->flag_status : NULL;
+			retvals[i] = message->flagged ? MAPI_E_SUCCESS : MAPI_E_NOT_FOUND;
+			break;
+		case PidTagSubject:
+			data_pointers[i] = (void *) message->subject;
+			break;
+		case PidTagMessageDeliveryTime:
+			data_pointers[i] = &message->delivery_time;
+			break;
+		case PidTagImportance:
+			data_pointers[i] = &message->importance;
+			break;
+		default:
+			data_pointers[i] = NULL;
+			retvals[i] = MAPI_E_NOT_FOUND;
+			break;
+		}
+	}
+}
+
+static struct mapi_SRestriction *bench_unread(TALLOC_CTX *mem_ctx)
+{
+	struct mapi_SRestriction	*res;
+
+	res = talloc_zero(mem_ctx, struct mapi_SRestriction);
+	res->rt = RES_BITMASK;
+	res->res.resBitmask.relMBR = BMR_EQZ;
+	res->res.resBitmask.ulPropTag = PidTagMessageFlags;
+	res->res.resBitmask.ulMask = MSGFLAG_READ;
+
+	return res;
+}
+
+static struct mapi_SRestriction *bench_followup(TALLOC_CTX *mem_ctx)
+{
+	struct mapi_SRestriction	*res;
+
+	res = talloc_zero(mem_ctx, struct mapi_SRestriction);
+	res->rt = RES_AND;
+	res->res.resAnd.cRes = 2;
+	res->res.resAnd.res = talloc_zero_array(res, struct mapi_SRestriction_and, 2);
+	res->res.resAnd.res[0].rt = RES_EXIST;
+	res->res.resAnd.res[0].res.resExist.ulPropTag = PidTagFlagStatus;
+	res->res.resAnd.res[1].rt = RES_PROPERTY;
+	res->res.resAnd.res[1].res.resProperty.relop = RELOP_EQ;
+	res->res.resAnd.res[1].res.resProperty.ulPropTag = PidTagFlagStatus;
+	res->res.resAnd.res[1].res.resProperty.lpProp.ulPropTag = PidTagFlagStatus;
+	res->res.resAnd.res[1].res.resProperty.lpProp.value.l = 2;
+
+	return res;
+}
+
+static struct mapi_SRestriction *bench_subject(TALLOC_CTX *mem_ctx, uint32_t messages)
+{
+	struct mapi_SRestriction	*res;
+	struct mapi_SRestriction_or	*or_res;
+	uint64_t			nt_time;
+
+	res = talloc_zero(mem_ctx, struct mapi_SRestriction);
+	res->rt = RES_AND;
+	res->res.resAnd.cRes = 3;
+	res->res.resAnd.res = talloc_zero_array(res, struct mapi_SRestriction_and, 3);
+
+	res->res.resAnd.res[0].rt = RES_CONTENT;
+	res->res.resAnd.res[0].res.resContent.fuzzy = FL_SUBSTRING | FL_IGNORECASE;
+	res->res.resAnd.res[0].res.resContent.ulPropTag = PidTagSubject;
+	res->res.resAnd.res[0].res.resContent.lpProp.ulPropTag = PidTagSubject;
+	res->res.resAnd.res[0].res.resContent.lpProp.value.lpszW = "report";
+
+	/* the most recent half of the folder */
+	nt_time = 130000000000000000ULL + (uint64_t)(messages / 2) * 600000000ULL;
+	res->res.resAnd.res[1].rt = RES_PROPERTY;
+	res->res.resAnd.res[1].res.resProperty.relop = RELOP_GE;
+	res->res.resAnd.res[1].res.resProperty.ulPropTag = PidTagMessageDeliveryTime;
+	res->res.resAnd.res[1].res.resProperty.lpProp.ulPropTag = PidTagMessageDeliveryTime;
+	res->res.resAnd.res[1].res.resProperty.lpProp.value.ft.dwLowDateTime = nt_time & 0xFFFFFFFF;
+	res->res.resAnd.res[1].res.resProperty.lpProp.value.ft.dwHighDateTime = nt_time >> 32;
+
+	res->res.resAnd.res[2].rt = RES_OR;
+	res->res.resAnd.res[2].res.resOr.cRes = 2;
+	or_res = talloc_zero_array(res, struct mapi_SRestriction_or, 2);
+	res->res.resAnd.res[2].res.resOr.res = or_res;
+	or_res[0].rt = RES_PROPERTY;
+	or_res[0].res.resProperty.relop = RELOP_EQ;
+	or_res[0].res.resProperty.ulPropTag = PidTagImportance;
+	or_res[0].res.resProperty.lpProp.ulPropTag = PidTagImportance;
+	or_res[0].res.resProperty.lpProp.value.l = 2;
+	or_res[1].rt = RES_BITMASK;
+	or_res[1].res.resBitmask.relMBR = BMR_EQZ;
+	or_res[1].res.resBitmask.ulPropTag = PidTagMessageFlags;
+	or_res[1].res.resBitmask.ulMask = MSGFLAG_READ;
+
+	return res;
+}
+
+static void bench_evaluate(struct emsmdbp_search_folder *search, struct bench_message *messages, uint32_t i,
+			   void **data_pointers, enum MAPISTATUS *retvals)
+{
+	bench_row(&messages[i], search->restriction->columns, data_pointers, retvals);
+	if (emsmdbp_restriction_match(search->restriction, data_pointers, retvals)) {
+		emsmdbp_search_add_result(search, i + 1, 1);
+	}
+	else {
+		emsmdbp_search_del_result(search, i + 1);
+	}
+}
+
+static void bench_populate(struct emsmdbp_search_folder *search, struct bench_message *messages, uint32_t count,
+			   void **data_pointers, enum MAPISTATUS *retvals)
+{
+	uint32_t	i;
+
+	search->results_count = 0;
+	for (i = 0; i < count; i++) {
+		bench_row(&messages[i], search->restriction->columns, data_pointers, retvals);
+		if (emsmdbp_restriction_match(search->restriction, data_pointers, retvals)) {
+			emsmdbp_search_add_result(search, i + 1, 1);
+		}
+	}
+}
+
+/* the change made to a message: read, flagged or unflagged */
+static uint32_t bench_change(struct bench_message *messages, uint32_t count, uint32_t c)
+{
+	uint32_t	i;
+
+	i = (c * 7919) % count;
+	switch (c % 3) {
+	case 0:
+		messages[i].flags ^= MSGFLAG_READ;
+		break;
+	case 1:
+		messages[i].flagged = !messages[i].flagged;
+		break;
+	default:
+		messages[i].importance = (messages[i].importance == 2) ? 1 : 2;
+		break;
+	}
+
+	return i;
+}
+
+static bool bench_criteria(TALLOC_CTX *mem_ctx, const char *name, struct mapi_SRestriction *res,
+			   uint32_t count, uint32_t changes, uint32_t rescans)
+{
+	struct emsmdbp_search_folder	*search;
+	struct bench_message		*messages;
+	void				**data_pointers;
+	enum MAPISTATUS			*retvals;
+	uint32_t			*incremental;
+	uint32_t			i;
+	uint32_t			c;
+	double				start;
+	double				populate;
+	double				update;
+	double				rescan;
+	bool				ret = true;
+
+	messages = talloc_array(mem_ctx, struct bench_message, count);
+	for (i = 0; i < count; i++) {
+		bench_fill_message(&messages[i], i);
+	}
+
+	search = talloc_zero(mem_ctx, struct emsmdbp_search_folder);
+	start = bench_now();
+	search->restriction = emsmdbp_restriction_compile(search, res);
+	if (!search->restriction) {
+		printf("%-10s unable to compile the restriction\n", name);
+		return false;
+	}
+	data_pointers = talloc_array(mem_ctx, void *, search->restriction->columns->cValues);
+	retvals = talloc_array(mem_ctx, enum MAPISTATUS, search->restriction->columns->cValues);
+	bench_populate(search, messages, count, data_pointers, retvals);
+	populate = bench_now() - start;
+	printf("%-10s %u of %u messages match, populated in %.3f ms (%.0f rows/s)\n",
+	       name, search->results_count, count, populate * 1000.0, count / populate);
+
+	/* incremental updates */
+	start = bench_now();
+	for (c = 0; c < changes; c++) {
+		i = bench_change(messages, count, c);
+		bench_evaluate(search, messages, i, data_pointers, retvals);
+	}
+	update = bench_now() - start;
+
+	/* check the incremental results against a full search */
+	incremental = talloc_array(mem_ctx, uint32_t, search->results_count);
+	for (i = 0; i < search->results_count; i++) {
+		incremental[i] = search->results[i].mid;
+	}
+	c = search->results_count;
+	bench_populate(search, messages, count, data_pointers, retvals);
+	ret = (c == search->results_count);
+	for (i = 0; ret && i < c; i++) {
+		if (incremental[i] != search->results[i].mid) ret = false;
+	}
+	if (!ret) {
+		printf("%-10s incremental results differ from a full search\n", name);
+	}
+
+	/* full search per change */
+	start = bench_now();
+	for (c = 0; c < rescans; c++) {
+		bench_change(messages, count, changes + c);
+		bench_populate(search, messages, count, data_pointers, retvals);
+	}
+	rescan = bench_now() - start;
+
+	printf("%-10s incremental: %8.3f us per change, rescan: %10.3f us per change\n",
+	       name, update * 1000000.0 / changes, rescan * 1000000.0 / rescans);
+
+	return ret;
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX			*mem_ctx;
+	poptContext			pc;
+	int				opt;
+	uint32_t			opt_messages = BENCH_MESSAGES;
+	uint32_t			opt_changes = BENCH_CHANGES;
+	uint32_t			opt_rescans = BENCH_RESCANS;
+	bool				ret = true;
+
+	enum {OPT_MESSAGES=1000, OPT_CHANGES, OPT_RESCANS};
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{"messages", 'm', POPT_ARG_INT, NULL, OPT_MESSAGES, "number of messages in the searched folder", "COUNT"},
+		{"changes", 'c', POPT_ARG_INT, NULL, OPT_CHANGES, "number of message changes applied incrementally", "COUNT"},
+		{"rescans", 'r', POPT_ARG_INT, NULL, OPT_RESCANS, "number of message changes applied with a full search", "COUNT"},
+		{ NULL, 0, POPT_ARG_NONE, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_emsmdbp_search", argc, argv, long_options, 0);
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_MESSAGES:
+			opt_messages = atoi(poptGetOptArg(pc));
+			break;
+		case OPT_CHANGES:
+			opt_changes = atoi(poptGetOptArg(pc));
+			break;
+		case OPT_RESCANS:
+			opt_rescans = atoi(poptGetOptArg(pc));
+			break;
+		}
+	}
+	poptFreeContext(pc);
+
+	if (!opt_messages || !opt_changes || !opt_rescans) {
+		return 1;
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_emsmdbp_search");
+
+	ret &= bench_criteria(mem_ctx, "unread", bench_unread(mem_ctx), opt_messages, opt_changes, opt_rescans);
+	ret &= bench_criteria(mem_ctx, "followup", bench_followup(mem_ctx), opt_messages, opt_changes, opt_rescans);
+	ret &= bench_criteria(mem_ctx, "subject", bench_subject(mem_ctx, opt_messages), opt_messages, opt_changes, opt_rescans);
+
+	talloc_free(mem_ctx);
+
+	return ret ? 0 : 1;
+}
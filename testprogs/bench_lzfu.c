@@ -0,0 +1,346 @@
+/*
+   Benchmark Compressed RTF (LZFu) compression and decompression
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+   Each file given on the command line is an RTF body. It is compressed
+   with compress_rtf(), with the streaming compressor fed in chunks
+   and with the dictionary scan compress_rtf() used before hash chains,
+   which is reproduced below. All three outputs must be identical.
+   The result is then decompressed with uncompress_rtf() and with the
+   streaming decompressor, and throughput is reported in MB/s.
+ */
+
+#include "libmapi/libmapi.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <sys/time.h>
+
+#define	BENCH_ITERATIONS	10
+#define	BENCH_CHUNK		0x1000
+
+#ifndef MIN
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#endif
+
+#define	LEGACY_DICTLENGTH	0x1000
+#define	LEGACY_INITLENGTH	207
+#define	LEGACY_INITDICT					\
+  "{\\rtf1\\ansi\\mac\\deff0\\deftab720{\\fonttbl;}"	\
+  "{\\f0\\fnil \\froman \\fswiss \\fmodern \\fscript "	\
+  "\\fdecor MS Sans SerifSymbolArialTimes New RomanCourier" \
+  "{\\colortbl\\red0\\green0\\blue0\r\n\\par "		\
+  "\\pard\\plain\\f0\\fs20\\b\\i\\u\\tab\\tx"
+
+static double bench_now(void)
+{
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static size_t legacy_longest_match(const char *rtf, size_t rtf_size, size_t input_idx, uint8_t *dict,
+				   size_t *dict_write_idx, size_t *dict_match_offset)
+{
+	size_t	best_match_length = 0;
+	size_t	dict_iterator;
+	size_t	length;
+
+	for (dict_iterator = 0; dict_iterator < MIN(*dict_write_idx, LEGACY_DICTLENGTH); ++dict_iterator) {
+		length = 0;
+		while ((rtf[input_idx + length] == dict[dict_iterator + length]) &&
+		       ((dict_iterator + length) < ((*dict_write_idx) % LEGACY_DICTLENGTH)) &&
+		       ((input_idx + length) < rtf_size) &&
+		       (length < 17)) {
+			length += 1;
+			if (length > best_match_length) {
+				best_match_length = length;
+				dict[(*dict_write_idx) % LEGACY_DICTLENGTH] = rtf[input_idx + length - 1];
+				*dict_write_idx += 1;
+				*dict_match_offset = dict_iterator;
+			}
+		}
+	}
+
+	return best_match_length;
+}
+
+static size_t legacy_compress(const char *rtf, size_t rtf_size, uint8_t *out)
+{
+	uint8_t		dict[LEGACY_DICTLENGTH];
+	size_t		dict_write_idx = LEGACY_INITLENGTH;
+	size_t		input_idx = 0;
+	size_t		control_byte_idx = 16;
+	size_t		output_idx = 17;
+	uint8_t		control_bit = 0x01;
+	size_t		length;
+	size_t		offset = 0;
+	uint16_t	dict_ref;
+	uint32_t	value;
+
+	memset(dict, 0, sizeof (dict));
+	memcpy(dict, LEGACY_INITDICT, LEGACY_INITLENGTH);
+	out[control_byte_idx] = 0x00;
+
+	while (input_idx < rtf_size) {
+		length = legacy_longest_match(rtf, rtf_size, input_idx, dict, &dict_write_idx, &offset);
+		if (length > 1) {
+			dict_ref = (offset << 4) + (length - 2);
+			input_idx += length;
+			out[control_byte_idx] |= control_bit;
+			out[output_idx++] = (dict_ref & 0xFF00) >> 8;
+			out[output_idx++] = (dict_ref & 0xFF);
+		} else {
+			if (length == 0) {
+				dict[dict_write_idx % LEGACY_DICTLENGTH] = rtf[input_idx];
+				dict_write_idx += 1;
+			}
+			out[output_idx++] = rtf[input_idx++];
+		}
+		if (control_bit == 0x80) {
+			control_bit = 0x01;
+			control_byte_idx = output_idx;
+			out[control_byte_idx] = 0x00;
+			output_idx = control_byte_idx + 1;
+		} else {
+			control_bit = control_bit << 1;
+		}
+	}
+
+	dict_ref = (dict_write_idx % LEGACY_DICTLENGTH) << 4;
+	out[control_byte_idx] |= control_bit;
+	out[output_idx++] = (dict_ref & 0xFF00) >> 8;
+	out[output_idx++] = (dict_ref & 0xFF);
+
+	/* little-endian cbSize, cbRawSize, dwMagic and dwCRC */
+	value = output_idx - 4;
+	out[0] = value & 0xFF; out[1] = (value >> 8) & 0xFF; out[2] = (value >> 16) & 0xFF; out[3] = value >> 24;
+	value = rtf_size;
+	out[4] = value & 0xFF; out[5] = (value >> 8) & 0xFF; out[6] = (value >> 16) & 0xFF; out[7] = value >> 24;
+	out[8] = 0x4c; out[9] = 0x5a; out[10] = 0x46; out[11] = 0x75;
+	value = calculateCRC(out, 16, output_idx - 16);
+	out[12] = value & 0xFF; out[13] = (value >> 8) & 0xFF; out[14] = (value >> 16) & 0xFF; out[15] = value >> 24;
+
+	return output_idx;
+}
+
+static bool bench_stream_compress(TALLOC_CTX *mem_ctx, const char *rtf, size_t rtf_size,
+				  uint8_t *out, size_t *out_size)
+{
+	struct lzfu_stream	*stream;
+	DATA_BLOB		chunk;
+	DATA_BLOB		header;
+	size_t			offset;
+	size_t			length;
+
+	stream = lzfu_compress_init(mem_ctx);
+	if (!stream) return false;
+
+	*out_size = 16;
+	for (offset = 0; offset < rtf_size; offset += length) {
+		length = MIN(rtf_size - offset, BENCH_CHUNK);
+		if (lzfu_compress_update(stream, (const uint8_t *)rtf + offset, length, &chunk)) {
+			talloc_free(stream);
+			return false;
+		}
+		memcpy(out + *out_size, chunk.data, chunk.length);
+		*out_size += chunk.length;
+	}
+	if (lzfu_compress_final(stream, &chunk, &header)) {
+		talloc_free(stream);
+		return false;
+	}
+	memcpy(out + *out_size, chunk.data, chunk.length);
+	*out_size += chunk.length;
+	memcpy(out, header.data, header.length);
+	talloc_free(stream);
+
+	return true;
+}
+
+static bool bench_stream_uncompress(TALLOC_CTX *mem_ctx, uint8_t *data, size_t size, size_t *out_size)
+{
+	struct lzfu_stream	*stream;
+	DATA_BLOB		chunk;
+	size_t			offset;
+	size_t			length;
+
+	stream = lzfu_uncompress_init(mem_ctx);
+	if (!stream) return false;
+
+	*out_size = 0;
+	for (offset = 0; offset < size; offset += length) {
+		length = MIN(size - offset, BENCH_CHUNK);
+		if (lzfu_uncompress_update(stream, data + offset, length, &chunk)) {
+			talloc_free(stream);
+			return false;
+		}
+		*out_size += chunk.length;
+	}
+	if (lzfu_uncompress_final(stream)) {
+		talloc_free(stream);
+		return false;
+	}
+	talloc_free(stream);
+
+	return true;
+}
+
+static double bench_rate(size_t size, double elapsed, uint32_t iterations)
+{
+	return elapsed ? (double)size * iterations / elapsed / (1024.0 * 1024.0) : 0.0;
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX		*mem_ctx;
+	poptContext		pc;
+	int			opt;
+	const char		*filename;
+	char			*rtf;
+	size_t			rtf_size;
+	uint8_t			*compressed;
+	size_t			compressed_size;
+	uint8_t			*legacy;
+	size_t			legacy_size;
+	uint8_t			*streamed;
+	size_t			streamed_size;
+	DATA_BLOB		decompressed;
+	size_t			decompressed_size;
+	uint32_t		opt_iterations = BENCH_ITERATIONS;
+	bool			opt_legacy = true;
+	uint32_t		i;
+	double			start;
+	double			times[5];
+	int			errors = 0;
+
+	enum {OPT_ITERATIONS=1000, OPT_NO_LEGACY};
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{"iterations", 'i', POPT_ARG_INT, NULL, OPT_ITERATIONS, "process each file COUNT times", "COUNT"},
+		{"no-legacy", 0, POPT_ARG_NONE, NULL, OPT_NO_LEGACY, "do not time the former dictionary scan", NULL},
+		{ NULL, 0, POPT_ARG_NONE, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_lzfu", argc, argv, long_options, 0);
+	poptSetOtherOptionHelp(pc, "rtf_file...");
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_ITERATIONS:
+			opt_iterations = atoi(poptGetOptArg(pc));
+			break;
+		case OPT_NO_LEGACY:
+			opt_legacy = false;
+			break;
+		}
+	}
+
+	if (!poptPeekArg(pc) || !opt_iterations) {
+		poptPrintUsage(pc, stderr, 0);
+		poptFreeContext(pc);
+		return 1;
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_lzfu");
+
+	printf("%-32s %8s %8s %10s %10s %10s %10s %10s\n", "file", "bytes", "lzfu",
+	       "comp MB/s", "strm MB/s", "scan MB/s", "unc MB/s", "strm MB/s");
+	while ((filename = poptGetArg(pc)) != NULL) {
+		rtf = file_load(filename, &rtf_size, 0, mem_ctx);
+		if (!rtf) {
+			fprintf(stderr, "unable to load %s\n", filename);
+			continue;
+		}
+
+		/* a reference or a literal costs at most 9/8 of the input */
+		legacy = talloc_array(mem_ctx, uint8_t, rtf_size + rtf_size / 8 + 32);
+		streamed = talloc_array(mem_ctx, uint8_t, rtf_size + rtf_size / 8 + 32);
+		memset(times, 0, sizeof (times));
+
+		start = bench_now();
+		for (i = 0; i < opt_iterations; i++) {
+			compress_rtf(mem_ctx, rtf, rtf_size, &compressed, &compressed_size);
+			if (i + 1 < opt_iterations) talloc_free(compressed);
+		}
+		times[0] = bench_now() - start;
+
+		start = bench_now();
+		for (i = 0; i < opt_iterations; i++) {
+			bench_stream_compress(mem_ctx, rtf, rtf_size, streamed, &streamed_size);
+		}
+		times[1] = bench_now() - start;
+
+		if (opt_legacy) {
+			start = bench_now();
+			for (i = 0; i < opt_iterations; i++) {
+				legacy_size = legacy_compress(rtf, rtf_size, legacy);
+			}
+			times[2] = bench_now() - start;
+			if (legacy_size != compressed_size || memcmp(legacy, compressed, compressed_size)) {
+				printf("%s: compress_rtf output differs from the dictionary scan\n", filename);
+				errors++;
+			}
+		}
+		if (streamed_size != compressed_size || memcmp(streamed, compressed, compressed_size)) {
+			printf("%s: streaming output differs from compress_rtf\n", filename);
+			errors++;
+		}
+
+		start = bench_now();
+		for (i = 0; i < opt_iterations; i++) {
+			uncompress_rtf(mem_ctx, compressed, compressed_size, &decompressed);
+			if (i + 1 < opt_iterations) talloc_free(decompressed.data);
+		}
+		times[3] = bench_now() - start;
+		if (decompressed.length != rtf_size + 1 || memcmp(decompressed.data, rtf, rtf_size)) {
+			printf("%s: uncompress_rtf does not round-trip\n", filename);
+			errors++;
+		}
+
+		start = bench_now();
+		for (i = 0; i < opt_iterations; i++) {
+			if (!bench_stream_uncompress(mem_ctx, compressed, compressed_size, &decompressed_size)) break;
+		}
+		times[4] = bench_now() - start;
+		if (i < opt_iterations || decompressed_size != rtf_size) {
+			printf("%s: streaming decompression does not round-trip\n", filename);
+			errors++;
+		}
+
+		printf("%-32s %8zu %8zu %10.2f %10.2f %10.2f %10.2f %10.2f\n", filename, rtf_size, compressed_size,
+		       bench_rate(rtf_size, times[0], opt_iterations), bench_rate(rtf_size, times[1], opt_iterations),
+		       bench_rate(rtf_size, times[2], opt_iterations), bench_rate(rtf_size, times[3], opt_iterations),
+		       bench_rate(rtf_size, times[4], opt_iterations));
+
+		talloc_free(decompressed.data);
+		talloc_free(compressed);
+		talloc_free(streamed);
+		talloc_free(legacy);
+		talloc_free(rtf);
+	}
+	poptFreeContext(pc);
+	talloc_free(mem_ctx);
+
+	return errors ? 1 : 0;
+}
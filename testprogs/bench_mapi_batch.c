@@ -0,0 +1,323 @@
+/*
+   Benchmark batched MAPI operations
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+   List the Inbox (OpenFolder, GetContentsTable, SetColumns,
+   QueryRows) then read the subject of each listed message (OpenMessage,
+   GetProps, Release), once with the synchronous calls and once with a
+   mapi_batch and deferred releases. The number of EcDoRpc round-trips
+   and the elapsed time of each run are reported.
+ */
+
+#include "libmapi/libmapi.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <sys/time.h>
+
+#define	DEFAULT_PROFDB		"%s/.openchange/profiles.ldb"
+#define	BENCH_MESSAGES		50
+
+struct bench_result {
+	uint64_t	transactions;
+	double		elapsed;
+	uint32_t	messages;
+};
+
+static double bench_now(void)
+{
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static enum MAPISTATUS bench_sequential(TALLOC_CTX *mem_ctx, struct mapi_session *session,
+					mapi_object_t *obj_store, mapi_id_t fid, uint16_t count,
+					struct bench_result *result)
+{
+	enum MAPISTATUS		retval;
+	mapi_object_t		obj_folder;
+	mapi_object_t		obj_table;
+	mapi_object_t		obj_message;
+	struct SPropTagArray	*columns;
+	struct SPropTagArray	*props;
+	struct SPropValue	*lpProps;
+	struct SRowSet		rowSet;
+	const uint64_t		*mid;
+	uint32_t		RowCount;
+	uint32_t		PropCount;
+	uint32_t		i;
+
+	columns = set_SPropTagArray(mem_ctx, 0x2, PR_FID, PR_MID);
+	props = set_SPropTagArray(mem_ctx, 0x1, PR_SUBJECT_UNICODE);
+
+	mapi_object_init(&obj_folder);
+	mapi_object_init(&obj_table);
+
+	result->transactions = emsmdb_get_info(session)->transactions;
+	result->elapsed = bench_now();
+
+	retval = OpenFolder(obj_store, fid, &obj_folder);
+	if (retval) goto end;
+	retval = GetContentsTable(&obj_folder, &obj_table, 0, &RowCount);
+	if (retval) goto end;
+	retval = SetColumns(&obj_table, columns);
+	if (retval) goto end;
+	retval = QueryRows(&obj_table, count, TBL_ADVANCE, &rowSet);
+	if (retval) goto end;
+
+	for (i = 0; i < rowSet.cRows; i++) {
+		mid = (const uint64_t *) find_SPropValue_data(&rowSet.aRow[i], PR_MID);
+		if (!mid) continue;
+
+		mapi_object_init(&obj_message);
+		retval = OpenMessage(obj_store, fid, *mid, &obj_message, 0);
+		if (retval == MAPI_E_SUCCESS) {
+			if (GetProps(&obj_message, MAPI_UNICODE | MAPI_PROPS_SKIP_NAMEDID_CHECK,
+				     props, &lpProps, &PropCount) == MAPI_E_SUCCESS) {
+				MAPIFreeBuffer(lpProps);
+				result->messages++;
+			}
+		}
+		mapi_object_release(&obj_message);
+	}
+	retval = MAPI_E_SUCCESS;
+
+end:
+	mapi_object_release(&obj_table);
+	mapi_object_release(&obj_folder);
+
+	result->elapsed = bench_now() - result->elapsed;
+	result->transactions = emsmdb_get_info(session)->transactions - result->transactions;
+
+	return retval;
+}
+
+static enum MAPISTATUS bench_batched(TALLOC_CTX *mem_ctx, struct mapi_session *session,
+				     mapi_object_t *obj_store, mapi_id_t fid, uint16_t count,
+				     struct bench_result *result)
+{
+	enum MAPISTATUS			retval;
+	struct mapi_batch		*batch;
+	struct mapi_batch_future	rows;
+	struct mapi_batch_future	*futures;
+	mapi_object_t			obj_folder;
+	mapi_object_t			obj_table;
+	mapi_object_t			*obj_messages;
+	struct SPropTagArray		*columns;
+	struct SPropTagArray		*props;
+	const uint64_t			*mid;
+	uint32_t			i;
+
+	columns = set_SPropTagArray(mem_ctx, 0x2, PR_FID, PR_MID);
+	props = set_SPropTagArray(mem_ctx, 0x1, PR_SUBJECT_UNICODE);
+
+	retval = mapi_batch_init(session, mem_ctx, &batch);
+	if (retval) return retval;
+
+	mapi_object_init(&obj_folder);
+	mapi_object_init(&obj_table);
+	emsmdb_set_deferred_release(session, true);
+
+	result->transactions = emsmdb_get_info(session)->transactions;
+	result->elapsed = bench_now();
+
+	mapi_batch_OpenFolder(batch, obj_store, fid, &obj_folder, NULL);
+	mapi_batch_GetContentsTable(batch, &obj_folder, &obj_table, 0, NULL);
+	mapi_batch_SetColumns(batch, &obj_table, columns, NULL);
+	mapi_batch_QueryRows(batch, &obj_table, count, TBL_ADVANCE, &rows);
+	retval = mapi_batch_execute(batch);
+	if (retval) goto end;
+	retval = rows.retval;
+	if (retval) goto end;
+
+	obj_messages = talloc_array(mem_ctx, mapi_object_t, rows.rowSet.cRows);
+	futures = talloc_zero_array(mem_ctx, struct mapi_batch_future, rows.rowSet.cRows);
+	for (i = 0; i < rows.rowSet.cRows; i++) {
+		mapi_object_init(&obj_messages[i]);
+		mid = (const uint64_t *) find_SPropValue_data(&rows.rowSet.aRow[i], PR_MID);
+		if (!mid) continue;
+
+		mapi_batch_OpenMessage(batch, obj_store, fid, *mid, &obj_messages[i], 0, NULL);
+		mapi_batch_GetProps(batch, &obj_messages[i], MAPI_UNICODE, props, &futures[i]);
+	}
+	retval = mapi_batch_execute(batch);
+
+	for (i = 0; i < rows.rowSet.cRows; i++) {
+		if (futures[i].done && futures[i].retval == MAPI_E_SUCCESS) {
+			MAPIFreeBuffer(futures[i].lpProps);
+			result->messages++;
+		}
+		mapi_object_release(&obj_messages[i]);
+	}
+
+end:
+	mapi_object_release(&obj_table);
+	mapi_object_release(&obj_folder);
+	FlushReleases(session);
+
+	result->elapsed = bench_now() - result->elapsed;
+	result->transactions = emsmdb_get_info(session)->transactions - result->transactions;
+
+	emsmdb_set_deferred_release(session, false);
+	talloc_free(batch);
+
+	return retval;
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX		*mem_ctx;
+	enum MAPISTATUS		retval;
+	struct mapi_session	*session = NULL;
+	struct mapi_context	*mapi_ctx;
+	mapi_object_t		obj_store;
+	mapi_id_t		fid;
+	poptContext		pc;
+	int			opt;
+	const char		*opt_profdb = NULL;
+	char			*opt_profname = NULL;
+	const char		*opt_password = NULL;
+	const char		*opt_debug = NULL;
+	uint32_t		opt_messages = BENCH_MESSAGES;
+	struct bench_result	sequential, batched;
+	int			exit_code = 0;
+
+	enum {OPT_PROFILE_DB=1000, OPT_PROFILE, OPT_PASSWORD, OPT_DEBUG, OPT_MESSAGES};
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{"database", 'f', POPT_ARG_STRING, NULL, OPT_PROFILE_DB, "set the profile database path", "PATH"},
+		{"profile", 'p', POPT_ARG_STRING, NULL, OPT_PROFILE, "set the profile name", "PROFILE"},
+		{"password", 'P', POPT_ARG_STRING, NULL, OPT_PASSWORD, "set the profile password", "PASSWORD"},
+		{"debuglevel", 'd', POPT_ARG_STRING, NULL, OPT_DEBUG, "set the debug level", "LEVEL"},
+		{"messages", 'n', POPT_ARG_INT, NULL, OPT_MESSAGES, "read at most COUNT Inbox messages", "COUNT"},
+		{ NULL, 0, POPT_ARG_NONE, NULL, 0, NULL, NULL }
+	};
+
+	mem_ctx = talloc_named(NULL, 0, "bench_mapi_batch");
+
+	pc = poptGetContext("bench_mapi_batch", argc, argv, long_options, 0);
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_PROFILE_DB:
+			opt_profdb = poptGetOptArg(pc);
+			break;
+		case OPT_PROFILE:
+			opt_profname = talloc_strdup(mem_ctx, (char *)poptGetOptArg(pc));
+			break;
+		case OPT_PASSWORD:
+			opt_password = poptGetOptArg(pc);
+			break;
+		case OPT_DEBUG:
+			opt_debug = poptGetOptArg(pc);
+			break;
+		case OPT_MESSAGES:
+			opt_messages = atoi(poptGetOptArg(pc));
+			break;
+		}
+	}
+
+	if (!opt_profdb) {
+		opt_profdb = talloc_asprintf(mem_ctx, DEFAULT_PROFDB, getenv("HOME"));
+	}
+	if (opt_messages > 0xffff) {
+		opt_messages = 0xffff;
+	}
+
+	retval = MAPIInitialize(&mapi_ctx, opt_profdb);
+	if (retval != MAPI_E_SUCCESS) {
+		mapi_errstr("MAPIInitialize", retval);
+		exit (1);
+	}
+
+	if (opt_debug) {
+		SetMAPIDebugLevel(mapi_ctx, atoi(opt_debug));
+	}
+
+	/* if no profile is supplied use the default one */
+	if (!opt_profname) {
+		retval = GetDefaultProfile(mapi_ctx, &opt_profname);
+		if (retval != MAPI_E_SUCCESS) {
+			printf("No profile specified and no default profile found\n");
+			exit_code = 1;
+			goto cleanup;
+		}
+	}
+
+	retval = MapiLogonEx(mapi_ctx, &session, opt_profname, opt_password);
+	talloc_free(opt_profname);
+	if (retval != MAPI_E_SUCCESS) {
+		mapi_errstr("MapiLogonEx", retval);
+		exit_code = 1;
+		goto cleanup;
+	}
+
+	/* Open the default message store */
+	mapi_object_init(&obj_store);
+	retval = OpenMsgStore(session, &obj_store);
+	if (retval != MAPI_E_SUCCESS) {
+		mapi_errstr("OpenMsgStore", retval);
+		exit_code = 1;
+		goto cleanup;
+	}
+
+	retval = GetDefaultFolder(&obj_store, &fid, olFolderInbox);
+	if (retval != MAPI_E_SUCCESS) {
+		mapi_errstr("GetDefaultFolder", retval);
+		exit_code = 1;
+		goto cleanup;
+	}
+
+	memset(&sequential, 0, sizeof (sequential));
+	memset(&batched, 0, sizeof (batched));
+
+	retval = bench_sequential(mem_ctx, session, &obj_store, fid, opt_messages, &sequential);
+	if (retval != MAPI_E_SUCCESS) {
+		mapi_errstr("sequential", retval);
+		exit_code = 1;
+		goto cleanup;
+	}
+
+	retval = bench_batched(mem_ctx, session, &obj_store, fid, opt_messages, &batched);
+	if (retval != MAPI_E_SUCCESS) {
+		mapi_errstr("batched", retval);
+		exit_code = 1;
+		goto cleanup;
+	}
+
+	printf("%-12s %10s %14s %12s\n", "mode", "messages", "round-trips", "ms");
+	printf("%-12s %10u %14"PRIu64" %12.3f\n", "sequential", sequential.messages,
+	       sequential.transactions, sequential.elapsed * 1000.0);
+	printf("%-12s %10u %14"PRIu64" %12.3f\n", "batched", batched.messages,
+	       batched.transactions, batched.elapsed * 1000.0);
+
+	mapi_object_release(&obj_store);
+
+cleanup:
+	poptFreeContext(pc);
+	MAPIUninitialize(mapi_ctx);
+	talloc_free(mem_ctx);
+
+	return exit_code;
+}
@@ -0,0 +1,150 @@
+/*
+   Benchmark RPC_HEADER_EXT response compression
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+   Each file given on the command line is a captured mapi_response
+   blob, as pushed by EcDoRpcExt2 before it is wrapped into an
+   RPC_HEADER_EXT extended buffer. Every blob is pushed through
+   ndr_push_mapi_extended_buffer() with and without RHEF_Compressed,
+   and the CPU time spent is reported against the bytes saved.
+ */
+
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+#include "gen_ndr/ndr_exchange.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <sys/time.h>
+
+#define	BENCH_ITERATIONS	100
+
+static double bench_now(void)
+{
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static double bench_push(const uint8_t *data, uint32_t size, uint16_t flags, uint32_t threshold,
+			 uint32_t iterations, struct mapi_compression_stats *stats)
+{
+	struct ndr_push	*ndr;
+	uint32_t	i;
+	double		start;
+
+	start = bench_now();
+	for (i = 0; i < iterations; i++) {
+		ndr = ndr_push_init_ctx(NULL);
+		ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
+		ndr_push_mapi_extended_buffer(ndr, data, size, flags, threshold, (i == 0) ? stats : NULL);
+		talloc_free(ndr);
+	}
+
+	return (bench_now() - start) / iterations;
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX			*mem_ctx;
+	poptContext			pc;
+	int				opt;
+	const char			*filename;
+	uint8_t				*data;
+	size_t				size;
+	uint32_t			opt_threshold = 0;
+	uint32_t			opt_iterations = BENCH_ITERATIONS;
+	double				plain_time, comp_time;
+	double				total_plain = 0, total_comp = 0;
+	struct mapi_compression_stats	plain_stats, comp_stats, stats;
+
+	enum {OPT_THRESHOLD=1000, OPT_ITERATIONS};
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{"threshold", 't', POPT_ARG_INT, NULL, OPT_THRESHOLD, "do not compress responses smaller than SIZE bytes", "SIZE"},
+		{"iterations", 'i', POPT_ARG_INT, NULL, OPT_ITERATIONS, "push each response COUNT times", "COUNT"},
+		{ NULL, 0, POPT_ARG_NONE, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_mapi_compression", argc, argv, long_options, 0);
+	poptSetOtherOptionHelp(pc, "mapi_response_file...");
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_THRESHOLD:
+			opt_threshold = atoi(poptGetOptArg(pc));
+			break;
+		case OPT_ITERATIONS:
+			opt_iterations = atoi(poptGetOptArg(pc));
+			break;
+		}
+	}
+
+	if (!poptPeekArg(pc) || !opt_iterations) {
+		poptPrintUsage(pc, stderr, 0);
+		poptFreeContext(pc);
+		return 1;
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_mapi_compression");
+	memset(&plain_stats, 0, sizeof (plain_stats));
+	memset(&comp_stats, 0, sizeof (comp_stats));
+
+	printf("%-32s %8s %8s %7s %12s %12s\n", "response", "bytes", "sent", "ratio", "plain us", "lz77 us");
+	while ((filename = poptGetArg(pc)) != NULL) {
+		data = (uint8_t *) file_load(filename, &size, 0, mem_ctx);
+		if (!data) {
+			fprintf(stderr, "unable to load %s\n", filename);
+			continue;
+		}
+
+		memset(&stats, 0, sizeof (stats));
+		plain_time = bench_push(data, size, RHEF_Last|RHEF_XorMagic, opt_threshold, opt_iterations, &plain_stats);
+		comp_time = bench_push(data, size, RHEF_Last|RHEF_Compressed, opt_threshold, opt_iterations, &stats);
+		total_plain += plain_time;
+		total_comp += comp_time;
+
+		printf("%-32s %8"PRIu64" %8"PRIu64" %6.2fx %12.3f %12.3f\n", filename,
+		       stats.bytes_in, stats.bytes_out, (double)stats.bytes_in / (stats.bytes_out ? stats.bytes_out : 1),
+		       plain_time * 1000000.0, comp_time * 1000000.0);
+
+		comp_stats.buffers += stats.buffers;
+		comp_stats.compressed_buffers += stats.compressed_buffers;
+		comp_stats.bytes_in += stats.bytes_in;
+		comp_stats.bytes_out += stats.bytes_out;
+		talloc_free(data);
+	}
+	poptFreeContext(pc);
+
+	printf("\n%"PRIu64"/%"PRIu64" responses compressed, %"PRIu64" -> %"PRIu64" bytes (%"PRIu64" saved)\n",
+	       comp_stats.compressed_buffers, comp_stats.buffers, comp_stats.bytes_in, comp_stats.bytes_out,
+	       comp_stats.bytes_in - comp_stats.bytes_out);
+	printf("extra CPU for compression: %.3f us total, %.3f ns per saved byte\n",
+	       (total_comp - total_plain) * 1000000.0,
+	       (comp_stats.bytes_in > comp_stats.bytes_out) ?
+	       (total_comp - total_plain) * 1000000000.0 / (comp_stats.bytes_in - comp_stats.bytes_out) : 0.0);
+
+	talloc_free(mem_ctx);
+
+	return 0;
+}
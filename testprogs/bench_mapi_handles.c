@@ -0,0 +1,256 @@
+/*
+   Benchmark the MAPI handles allocator
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+   Compare the slab based mapi_handles_* implementation against the
+   TDB layout it replaced. Both stores are populated with the same
+   number of live handles, then a fixed number of search and
+   add/delete cycles are timed against each.
+
+   The TDB path below reproduces the previous algorithm: one
+   "0x%x" -> "0x%x" record per handle, a full traverse to find a
+   "null" record on add and a full traverse to find children on
+   delete.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "libmapi/libmapi.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <tdb.h>
+#include <sys/time.h>
+
+#define	BENCH_OPS	1000
+
+struct legacy_handles {
+	TDB_CONTEXT	*tdb_ctx;
+	uint32_t	last_handle;
+};
+
+struct legacy_state {
+	struct legacy_handles	*ctx;
+	const char		*match;
+	uint32_t		handle;
+};
+
+static double bench_now(void)
+{
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static int legacy_store(struct legacy_handles *ctx, uint32_t handle, const char *value, int flag)
+{
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	char		keystr[16];
+
+	snprintf(keystr, sizeof (keystr), "0x%x", handle);
+	key.dptr = (unsigned char *)keystr;
+	key.dsize = strlen(keystr);
+	dbuf.dptr = (unsigned char *)value;
+	dbuf.dsize = strlen(value);
+
+	return tdb_store(ctx->tdb_ctx, key, dbuf, flag);
+}
+
+static int legacy_traverse_match(TDB_CONTEXT *tdb_ctx, TDB_DATA key, TDB_DATA dbuf, void *private_data)
+{
+	struct legacy_state	*state = (struct legacy_state *)private_data;
+	char			keystr[16];
+
+	if (dbuf.dsize == strlen(state->match) && !strncmp((const char *)dbuf.dptr, state->match, dbuf.dsize)) {
+		snprintf(keystr, sizeof (keystr), "%.*s", (int)key.dsize, (const char *)key.dptr);
+		state->handle = strtol(keystr, NULL, 16);
+		return 1;
+	}
+
+	return 0;
+}
+
+static uint32_t legacy_add(struct legacy_handles *ctx, uint32_t container_handle)
+{
+	struct legacy_state	state;
+	char			value[16];
+
+	snprintf(value, sizeof (value), "0x%x", container_handle);
+
+	state.ctx = ctx;
+	state.match = MAPI_HANDLES_NULL;
+	state.handle = 0;
+	tdb_traverse(ctx->tdb_ctx, legacy_traverse_match, &state);
+	if (state.handle) {
+		legacy_store(ctx, state.handle, value, TDB_MODIFY);
+		return state.handle;
+	}
+
+	legacy_store(ctx, ctx->last_handle, value, TDB_INSERT);
+	return ctx->last_handle++;
+}
+
+static bool legacy_search(struct legacy_handles *ctx, uint32_t handle)
+{
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	char		keystr[16];
+	bool		found;
+
+	snprintf(keystr, sizeof (keystr), "0x%x", handle);
+	key.dptr = (unsigned char *)keystr;
+	key.dsize = strlen(keystr);
+
+	dbuf = tdb_fetch(ctx->tdb_ctx, key);
+	found = (dbuf.dptr && strncmp((const char *)dbuf.dptr, MAPI_HANDLES_NULL, dbuf.dsize));
+	free(dbuf.dptr);
+
+	return found;
+}
+
+static void legacy_delete(struct legacy_handles *ctx, uint32_t handle)
+{
+	struct legacy_state	state;
+	char			value[16];
+
+	legacy_store(ctx, handle, MAPI_HANDLES_NULL, TDB_MODIFY);
+
+	snprintf(value, sizeof (value), "0x%x", handle);
+	state.ctx = ctx;
+	state.match = value;
+	state.handle = 0;
+	tdb_traverse(ctx->tdb_ctx, legacy_traverse_match, &state);
+}
+
+static void bench_legacy(uint32_t count)
+{
+	struct legacy_handles	ctx;
+	uint32_t		i;
+	uint32_t		handle;
+	double			start;
+	double			search_time;
+	double			cycle_time;
+
+	ctx.tdb_ctx = tdb_open(NULL, 0, TDB_INTERNAL, O_RDWR|O_CREAT, 0600);
+	ctx.last_handle = 1;
+
+	/* Populate directly: going through legacy_add would be quadratic */
+	for (i = 0; i < count; i++) {
+		legacy_store(&ctx, ctx.last_handle++, MAPI_HANDLES_ROOT, TDB_INSERT);
+	}
+
+	start = bench_now();
+	for (i = 0; i < BENCH_OPS; i++) {
+		legacy_search(&ctx, 1 + (i * 7919) % count);
+	}
+	search_time = bench_now() - start;
+
+	start = bench_now();
+	for (i = 0; i < BENCH_OPS; i++) {
+		handle = legacy_add(&ctx, 1 + i % count);
+		legacy_delete(&ctx, handle);
+	}
+	cycle_time = bench_now() - start;
+
+	printf("tdb  %7u live: search %10.3f us/op, add+delete %10.3f us/op\n", count,
+	       search_time * 1000000.0 / BENCH_OPS, cycle_time * 1000000.0 / BENCH_OPS);
+
+	tdb_close(ctx.tdb_ctx);
+}
+
+static void bench_slab(uint32_t count)
+{
+	TALLOC_CTX			*mem_ctx;
+	struct mapi_handles_context	*handles_ctx;
+	struct mapi_handles		*rec;
+	uint32_t			i;
+	double				start;
+	double				search_time;
+	double				cycle_time;
+
+	mem_ctx = talloc_named(NULL, 0, "bench_slab");
+	handles_ctx = mapi_handles_init(mem_ctx);
+
+	for (i = 0; i < count; i++) {
+		mapi_handles_add(handles_ctx, 0, &rec);
+	}
+
+	start = bench_now();
+	for (i = 0; i < BENCH_OPS; i++) {
+		mapi_handles_search(handles_ctx, 1 + (i * 7919) % count, &rec);
+	}
+	search_time = bench_now() - start;
+
+	start = bench_now();
+	for (i = 0; i < BENCH_OPS; i++) {
+		mapi_handles_add(handles_ctx, 1 + i % count, &rec);
+		mapi_handles_delete(handles_ctx, rec->handle);
+	}
+	cycle_time = bench_now() - start;
+
+	printf("slab %7u live: search %10.3f us/op, add+delete %10.3f us/op\n", count,
+	       search_time * 1000000.0 / BENCH_OPS, cycle_time * 1000000.0 / BENCH_OPS);
+
+	talloc_free(mem_ctx);
+}
+
+int main(int argc, const char *argv[])
+{
+	poptContext		pc;
+	int			opt;
+	uint32_t		opt_count = 0;
+	uint32_t		counts[] = { 10000, 100000 };
+	uint32_t		i;
+
+	enum {OPT_COUNT=1000};
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{"count", 'c', POPT_ARG_INT, NULL, OPT_COUNT, "only benchmark COUNT live handles", "COUNT"},
+		{ NULL, 0, POPT_ARG_NONE, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_mapi_handles", argc, argv, long_options, 0);
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_COUNT:
+			opt_count = atoi(poptGetOptArg(pc));
+			break;
+		}
+	}
+	poptFreeContext(pc);
+
+	if (opt_count) {
+		bench_slab(opt_count);
+		bench_legacy(opt_count);
+		return 0;
+	}
+
+	for (i = 0; i < sizeof (counts) / sizeof (counts[0]); i++) {
+		bench_slab(counts[i]);
+		bench_legacy(counts[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,265 @@
+/*
+   Benchmark mapistore notification matching
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+   A mapistore context is populated with a mix of table, folder,
+   message and whole store subscriptions, the way Outlook sessions
+   register them. A fixed number of newmail bursts (message created and
+   folder modified notifications) and table notifications are then
+   matched through the subscription index, and through a scan of the
+   whole subscription list, which is what mapistore used to do.
+ */
+
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "libmapi/libmapi.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <dlinklist.h>
+#include <sys/time.h>
+
+#define	BENCH_SUBSCRIPTIONS	10000
+#define	BENCH_NOTIFICATIONS	100000
+#define	BENCH_FOLDERS		500
+
+static double bench_now(void)
+{
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static bool legacy_matches(struct mapistore_notification *notification, struct mapistore_subscription *subscription)
+{
+	struct mapistore_object_notification_parameters	*n_object_parameters;
+	struct mapistore_object_subscription_parameters	*s_object_parameters;
+
+	if (notification->object_type == MAPISTORE_TABLE) {
+		return ((subscription->notification_types & fnevTableModified)
+			&& subscription->handle == notification->parameters.table_parameters.handle
+			&& subscription->parameters.table_parameters.table_type == notification->parameters.table_parameters.table_type
+			&& subscription->parameters.table_parameters.folder_id == notification->parameters.table_parameters.folder_id);
+	}
+
+	if (!(((subscription->notification_types & fnevObjectCreated) && notification->event == MAPISTORE_OBJECT_CREATED)
+	      || ((subscription->notification_types & fnevObjectModified) && notification->event == MAPISTORE_OBJECT_MODIFIED))) {
+		return false;
+	}
+
+	n_object_parameters = &notification->parameters.object_parameters;
+	s_object_parameters = &subscription->parameters.object_parameters;
+	if (s_object_parameters->whole_store) return true;
+	if (notification->object_type == MAPISTORE_FOLDER) {
+		return n_object_parameters->object_id == s_object_parameters->folder_id;
+	}
+
+	return (n_object_parameters->folder_id == s_object_parameters->folder_id
+		&& (s_object_parameters->object_id == 0 || n_object_parameters->object_id == s_object_parameters->object_id));
+}
+
+static uint32_t legacy_find(TALLOC_CTX *mem_ctx, struct mapistore_context *mstore_ctx,
+			    struct mapistore_notification *notification)
+{
+	struct mapistore_subscription_list	*matching = NULL;
+	struct mapistore_subscription_list	*el;
+	struct mapistore_subscription_list	*new_element;
+	uint32_t				count = 0;
+
+	for (el = mstore_ctx->subscriptions; el; el = el->next) {
+		if (legacy_matches(notification, el->subscription)) {
+			new_element = talloc_memdup(mem_ctx, el, sizeof(struct mapistore_subscription_list));
+			DLIST_ADD_END(matching, new_element, struct mapistore_subscription_list *);
+			count++;
+		}
+	}
+
+	return count;
+}
+
+static uint32_t indexed_find(struct mapistore_context *mstore_ctx, struct mapistore_notification *notification)
+{
+	struct mapistore_subscription_list	*matching;
+	struct mapistore_subscription_list	*el;
+	uint32_t				count = 0;
+
+	matching = mapistore_find_matching_subscriptions(mstore_ctx, notification);
+	while ((el = matching)) {
+		DLIST_REMOVE(matching, el);
+		talloc_free(el);
+		count++;
+	}
+
+	return count;
+}
+
+static void bench_subscribe(struct mapistore_context *mstore_ctx, uint32_t count)
+{
+	struct mapistore_subscription_list		*subscription_list;
+	struct mapistore_table_subscription_parameters	table_parameters;
+	struct mapistore_object_subscription_parameters	object_parameters;
+	uint32_t					i;
+
+	for (i = 0; i < count; i++) {
+		subscription_list = talloc_zero(mstore_ctx, struct mapistore_subscription_list);
+		DLIST_ADD(mstore_ctx->subscriptions, subscription_list);
+
+		switch (i % 4) {
+		case 0:
+		case 1:
+			/* contents and hierarchy tables */
+			table_parameters.table_type = (i % 4) ? MAPISTORE_MESSAGE_TABLE : MAPISTORE_FOLDER_TABLE;
+			table_parameters.folder_id = (i * 7919) % BENCH_FOLDERS;
+			subscription_list->subscription = mapistore_new_subscription(subscription_list, mstore_ctx, "bench", i,
+										     fnevTableModified, &table_parameters);
+			break;
+		case 2:
+			/* folder subscriptions, one whole store per session */
+			object_parameters.whole_store = ((i % 400) == 2);
+			object_parameters.folder_id = (i * 7919) % BENCH_FOLDERS;
+			object_parameters.object_id = 0;
+			subscription_list->subscription = mapistore_new_subscription(subscription_list, mstore_ctx, "bench", i,
+										     fnevNewMail|fnevObjectCreated|fnevObjectModified|fnevObjectDeleted,
+										     &object_parameters);
+			break;
+		default:
+			/* opened messages */
+			object_parameters.whole_store = false;
+			object_parameters.folder_id = (i * 7919) % BENCH_FOLDERS;
+			object_parameters.object_id = i;
+			subscription_list->subscription = mapistore_new_subscription(subscription_list, mstore_ctx, "bench", i,
+										     fnevObjectModified|fnevObjectDeleted,
+										     &object_parameters);
+			break;
+		}
+	}
+}
+
+static void bench_notification(struct mapistore_notification *notification, uint32_t i, uint32_t subscriptions)
+{
+	memset(notification, 0, sizeof(struct mapistore_notification));
+
+	switch (i % 3) {
+	case 0:
+		notification->object_type = MAPISTORE_MESSAGE;
+		notification->event = MAPISTORE_OBJECT_CREATED;
+		notification->parameters.object_parameters.folder_id = (i * 31) % BENCH_FOLDERS;
+		notification->parameters.object_parameters.object_id = subscriptions + i;
+		break;
+	case 1:
+		notification->object_type = MAPISTORE_FOLDER;
+		notification->event = MAPISTORE_OBJECT_MODIFIED;
+		notification->parameters.object_parameters.object_id = (i * 31) % BENCH_FOLDERS;
+		break;
+	default:
+		notification->object_type = MAPISTORE_TABLE;
+		notification->event = MAPISTORE_OBJECT_CREATED;
+		notification->parameters.table_parameters.handle = (i * 4) % subscriptions;
+		notification->parameters.table_parameters.table_type = MAPISTORE_FOLDER_TABLE;
+		notification->parameters.table_parameters.folder_id = (((i * 4) % subscriptions) * 7919) % BENCH_FOLDERS;
+		break;
+	}
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX			*mem_ctx;
+	TALLOC_CTX			*tmp_ctx;
+	struct mapistore_context	*mstore_ctx;
+	struct mapistore_notification	notification;
+	poptContext			pc;
+	int				opt;
+	uint32_t			opt_subscriptions = BENCH_SUBSCRIPTIONS;
+	uint32_t			opt_notifications = BENCH_NOTIFICATIONS;
+	uint32_t			i;
+	uint32_t			indexed_matches = 0;
+	uint32_t			legacy_matches_count = 0;
+	double				start;
+	double				indexed;
+	double				legacy;
+
+	enum {OPT_SUBSCRIPTIONS=1000, OPT_NOTIFICATIONS};
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{"subscriptions", 's', POPT_ARG_INT, NULL, OPT_SUBSCRIPTIONS, "number of subscriptions", "COUNT"},
+		{"notifications", 'n', POPT_ARG_INT, NULL, OPT_NOTIFICATIONS, "number of notifications to match", "COUNT"},
+		{ NULL, 0, POPT_ARG_NONE, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_mapistore_notification", argc, argv, long_options, 0);
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_SUBSCRIPTIONS:
+			opt_subscriptions = atoi(poptGetOptArg(pc));
+			break;
+		case OPT_NOTIFICATIONS:
+			opt_notifications = atoi(poptGetOptArg(pc));
+			break;
+		}
+	}
+	poptFreeContext(pc);
+
+	if (!opt_subscriptions || !opt_notifications) {
+		return 1;
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_mapistore_notification");
+	mstore_ctx = talloc_zero(mem_ctx, struct mapistore_context);
+
+	start = bench_now();
+	bench_subscribe(mstore_ctx, opt_subscriptions);
+	printf("%u subscriptions registered in %.3f ms\n", opt_subscriptions, (bench_now() - start) * 1000.0);
+
+	start = bench_now();
+	for (i = 0; i < opt_notifications; i++) {
+		bench_notification(&notification, i, opt_subscriptions);
+		indexed_matches += indexed_find(mstore_ctx, &notification);
+	}
+	indexed = bench_now() - start;
+
+	tmp_ctx = talloc_new(mem_ctx);
+	start = bench_now();
+	for (i = 0; i < opt_notifications; i++) {
+		bench_notification(&notification, i, opt_subscriptions);
+		legacy_matches_count += legacy_find(tmp_ctx, mstore_ctx, &notification);
+		if ((i % 1000) == 999) {
+			talloc_free(tmp_ctx);
+			tmp_ctx = talloc_new(mem_ctx);
+		}
+	}
+	legacy = bench_now() - start;
+	talloc_free(tmp_ctx);
+
+	printf("indexed: %8.3f us per notification, %8.0f notifications/s\n",
+	       indexed * 1000000.0 / opt_notifications, opt_notifications / indexed);
+	printf("scan:    %8.3f us per notification, %8.0f notifications/s\n",
+	       legacy * 1000000.0 / opt_notifications, opt_notifications / legacy);
+	if (indexed_matches != legacy_matches_count) {
+		printf("indexed lookups returned %u matches, scan returned %u\n", indexed_matches, legacy_matches_count);
+	}
+
+	talloc_free(mem_ctx);
+
+	return (indexed_matches == legacy_matches_count) ? 0 : 1;
+}
@@ -0,0 +1,440 @@
+/*
+   Load generator for the ocsmanager newmail channel
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+   Deliveries are simulated at a fixed rate for a set of users and
+   sent on the newmail endpoint the way the dovecot ocsmanager plugin
+   does: coalesced per user and sent after a short delay. The newmail
+   queue of every user is opened the way the server does, and the
+   latency of a delivery is the time until a newmail notification
+   covering it is read from the user queue.
+
+   By default a child process stands for ocsmanager: it receives the
+   batches and sends one notification per command on the user queue.
+   With --external, the endpoint of a running ocsmanager is used
+   instead and the users must be registered there.
+ */
+
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "mapiproxy/libmapistore/mgmt/mapistore_mgmt.h"
+#include "mapiproxy/libmapistore/mgmt/gen_ndr/ndr_mapistore_mgmt.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#define	BENCH_USERS		100
+#define	BENCH_RATE		500
+#define	BENCH_MESSAGES		5000
+#define	BENCH_DELAY		50
+#define	BENCH_MAX_COMMANDS	32
+#define	BENCH_MAX_UIDS		2048
+#define	BENCH_DRAIN_TIMEOUT	5.0
+#define	BENCH_MSGSIZE		1024
+
+struct bench_user {
+	char		*name;
+	mqd_t		mqfd;
+	uint32_t	*uids;
+	uint32_t	count;
+	uint32_t	notified;
+};
+
+struct bench_ctx {
+	struct bench_user			*users;
+	uint32_t				users_count;
+	double					*delivered;
+	double					*latencies;
+	uint32_t				latencies_count;
+	uint32_t				notifications;
+	int					fd;
+	const char				*path;
+	unsigned int				delay;
+	struct mapistore_mgmt_command_batch	*batch;
+	uint32_t				batch_uids;
+	double					batch_deadline;
+	uint32_t				datagrams;
+	uint32_t				send_errors;
+};
+
+static double bench_now(void)
+{
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static int bench_cmp_double(const void *a, const void *b)
+{
+	const double	*da = (const double *)a;
+	const double	*db = (const double *)b;
+
+	return (*da > *db) - (*da < *db);
+}
+
+/**
+   Stand for ocsmanager: every newmail command is turned into a
+   notification on the user queue, as send_newmail does
+ */
+static void bench_receiver(const char *path, int ready)
+{
+	TALLOC_CTX				*mem_ctx;
+	struct mapistore_mgmt_command_batch	*batch;
+	struct mapistore_mgmt_newmail_cmd	*newmail;
+	struct mapistore_mgmt_command		cmd;
+	DATA_BLOB				data;
+	char					*queue;
+	mqd_t					mqfd;
+	int					fd;
+	uint32_t				i;
+
+	fd = mapistore_mgmt_newmail_listen(path);
+	if (write(ready, &fd, sizeof (fd)) != sizeof (fd) || fd == -1) {
+		_exit(1);
+	}
+	close(ready);
+
+	while (1) {
+		mem_ctx = talloc_new(NULL);
+		if (mapistore_mgmt_newmail_receive(mem_ctx, fd, &batch) != MAPISTORE_SUCCESS) {
+			talloc_free(mem_ctx);
+			continue;
+		}
+
+		for (i = 0; i < batch->count; i++) {
+			newmail = &batch->commands[i].command.newmail;
+			if (!newmail->count) continue;
+
+			memset(&cmd, 0, sizeof (struct mapistore_mgmt_command));
+			cmd.type = MAPISTORE_MGMT_NOTIF;
+			cmd.command.notification.status = MAPISTORE_MGMT_SEND;
+			cmd.command.notification.NotificationFlags = 0x2;
+			cmd.command.notification.MessageID = newmail->uids[newmail->count - 1];
+			cmd.command.notification.MAPIStoreURI = newmail->folder;
+			if (ndr_push_struct_blob(&data, mem_ctx, &cmd, (ndr_push_flags_fn_t)ndr_push_mapistore_mgmt_command)
+			    != NDR_ERR_SUCCESS) {
+				continue;
+			}
+
+			queue = talloc_asprintf(mem_ctx, "/%s#newmail", newmail->username);
+			mqfd = mq_open(queue, O_WRONLY|O_NONBLOCK);
+			if (mqfd == -1) continue;
+			mq_send(mqfd, (const char *)data.data, data.length, 0);
+			mq_close(mqfd);
+		}
+		talloc_free(mem_ctx);
+	}
+}
+
+static void bench_flush(struct bench_ctx *ctx)
+{
+	if (!ctx->batch) return;
+
+	if (mapistore_mgmt_newmail_send(ctx->fd, ctx->batch) == MAPISTORE_SUCCESS) {
+		ctx->datagrams++;
+	} else if (errno == EAGAIN) {
+		/* endpoint busy: keep the batch for the next round */
+		ctx->batch_deadline = bench_now() + 0.001;
+		return;
+	} else {
+		ctx->send_errors++;
+	}
+
+	talloc_free(ctx->batch);
+	ctx->batch = NULL;
+	ctx->batch_uids = 0;
+}
+
+/**
+   Coalesce a delivery with the pending ones of the same user, as the
+   dovecot plugin does
+ */
+static void bench_deliver(struct bench_ctx *ctx, uint32_t user, uint32_t uid)
+{
+	struct mapistore_mgmt_command_batch	*batch;
+	struct mapistore_mgmt_newmail_cmd	*newmail = NULL;
+	uint32_t				i;
+
+	if (!ctx->batch) {
+		ctx->batch = talloc_zero(ctx->users, struct mapistore_mgmt_command_batch);
+		ctx->batch_deadline = bench_now() + ctx->delay / 1000.0;
+	}
+	batch = ctx->batch;
+
+	for (i = 0; i < batch->count; i++) {
+		newmail = &batch->commands[i].command.newmail;
+		if (!strcmp(newmail->username, ctx->users[user].name)) break;
+	}
+
+	if (i == batch->count) {
+		batch->commands = talloc_realloc(batch, batch->commands, struct mapistore_mgmt_command, batch->count + 1);
+		memset(&batch->commands[i], 0, sizeof (struct mapistore_mgmt_command));
+		batch->commands[i].type = MAPISTORE_MGMT_NEWMAIL;
+		newmail = &batch->commands[i].command.newmail;
+		newmail->backend = "bench";
+		newmail->username = ctx->users[user].name;
+		newmail->folder = "inbox";
+		newmail->timestamp = (uint64_t)(bench_now() * 1000000.0);
+		batch->count++;
+	}
+
+	newmail->uids = talloc_realloc(batch->commands, newmail->uids, uint32_t, newmail->count + 1);
+	newmail->uids[newmail->count++] = uid;
+	ctx->batch_uids++;
+
+	if (!ctx->delay || batch->count >= BENCH_MAX_COMMANDS || ctx->batch_uids >= BENCH_MAX_UIDS) {
+		bench_flush(ctx);
+	}
+}
+
+/**
+   Read the pending notifications of every user queue and record the
+   latency of the deliveries they cover
+ */
+static void bench_drain(struct bench_ctx *ctx)
+{
+	TALLOC_CTX			*mem_ctx;
+	struct bench_user		*user;
+	struct mapistore_mgmt_command	cmd;
+	DATA_BLOB			data;
+	char				buf[BENCH_MSGSIZE];
+	ssize_t				len;
+	double				now;
+	uint32_t			i;
+
+	mem_ctx = talloc_new(NULL);
+	for (i = 0; i < ctx->users_count; i++) {
+		user = &ctx->users[i];
+		while ((len = mq_receive(user->mqfd, buf, sizeof (buf), NULL)) > 0) {
+			now = bench_now();
+			data.data = (uint8_t *)buf;
+			data.length = len;
+			if (ndr_pull_struct_blob(&data, mem_ctx, &cmd, (ndr_pull_flags_fn_t)ndr_pull_mapistore_mgmt_command)
+			    != NDR_ERR_SUCCESS || cmd.type != MAPISTORE_MGMT_NOTIF) {
+				continue;
+			}
+			ctx->notifications++;
+			while (user->notified < user->count
+			       && user->uids[user->notified] <= cmd.command.notification.MessageID) {
+				ctx->latencies[ctx->latencies_count++] = now - ctx->delivered[user->uids[user->notified]];
+				user->notified++;
+			}
+		}
+	}
+	talloc_free(mem_ctx);
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX		*mem_ctx;
+	struct bench_ctx	ctx;
+	struct mq_attr		attr;
+	poptContext		pc;
+	int			opt;
+	int			ready[2];
+	int			fd;
+	pid_t			pid = -1;
+	uint32_t		opt_users = BENCH_USERS;
+	uint32_t		opt_rate = BENCH_RATE;
+	uint32_t		opt_messages = BENCH_MESSAGES;
+	const char		*opt_socket = NULL;
+	bool			opt_external = false;
+	char			*queue;
+	uint32_t		i;
+	uint32_t		user;
+	double			start;
+	double			target;
+	double			elapsed;
+	int			ret = 0;
+
+	enum {OPT_USERS=1000, OPT_RATE, OPT_MESSAGES, OPT_DELAY, OPT_SOCKET, OPT_EXTERNAL};
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{"users", 'u', POPT_ARG_INT, NULL, OPT_USERS, "deliver to COUNT users", "COUNT"},
+		{"rate", 'r', POPT_ARG_INT, NULL, OPT_RATE, "deliveries per second", "RATE"},
+		{"messages", 'm', POPT_ARG_INT, NULL, OPT_MESSAGES, "number of deliveries", "COUNT"},
+		{"delay", 'd', POPT_ARG_INT, NULL, OPT_DELAY, "coalescing delay in milliseconds (0 sends every delivery)", "MSECS"},
+		{"socket", 's', POPT_ARG_STRING, NULL, OPT_SOCKET, "newmail endpoint", "PATH"},
+		{"external", 'e', POPT_ARG_NONE, NULL, OPT_EXTERNAL, "use the endpoint of a running ocsmanager", NULL},
+		{ NULL, 0, POPT_ARG_NONE, NULL, 0, NULL, NULL }
+	};
+
+	memset(&ctx, 0, sizeof (struct bench_ctx));
+	ctx.delay = BENCH_DELAY;
+
+	pc = poptGetContext("bench_ocsmanager_newmail", argc, argv, long_options, 0);
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_USERS:
+			opt_users = atoi(poptGetOptArg(pc));
+			break;
+		case OPT_RATE:
+			opt_rate = atoi(poptGetOptArg(pc));
+			break;
+		case OPT_MESSAGES:
+			opt_messages = atoi(poptGetOptArg(pc));
+			break;
+		case OPT_DELAY:
+			ctx.delay = atoi(poptGetOptArg(pc));
+			break;
+		case OPT_SOCKET:
+			opt_socket = poptGetOptArg(pc);
+			break;
+		case OPT_EXTERNAL:
+			opt_external = true;
+			break;
+		}
+	}
+	poptFreeContext(pc);
+
+	if (!opt_users || !opt_rate || !opt_messages) {
+		fprintf(stderr, "users, rate and messages must not be null\n");
+		return 1;
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_ocsmanager_newmail");
+	if (!opt_socket) {
+		opt_socket = opt_external ? MAPISTORE_MGMT_NEWMAIL_SOCKET :
+			talloc_asprintf(mem_ctx, "/tmp/bench_ocsmanager_newmail.%d", getpid());
+	}
+	ctx.path = opt_socket;
+
+	/* Step 1. Open the user newmail queues the way the server does */
+	memset(&attr, 0, sizeof (struct mq_attr));
+	attr.mq_maxmsg = 10;
+	attr.mq_msgsize = BENCH_MSGSIZE;
+
+	ctx.users = talloc_zero_array(mem_ctx, struct bench_user, opt_users);
+	ctx.users_count = opt_users;
+	for (i = 0; i < opt_users; i++) {
+		ctx.users[i].name = talloc_asprintf(ctx.users, "benchuser%u", i);
+		queue = talloc_asprintf(mem_ctx, "/%s#newmail", ctx.users[i].name);
+		ctx.users[i].mqfd = mq_open(queue, O_RDONLY|O_NONBLOCK|O_CREAT, 0600, &attr);
+		if (ctx.users[i].mqfd == -1) {
+			perror("mq_open");
+			ctx.users_count = i;
+			ret = 1;
+			goto end;
+		}
+	}
+	ctx.delivered = talloc_array(mem_ctx, double, opt_messages);
+	ctx.latencies = talloc_array(mem_ctx, double, opt_messages);
+
+	/* Step 2. Start the receiver */
+	if (!opt_external) {
+		if (pipe(ready) == -1) {
+			perror("pipe");
+			ret = 1;
+			goto end;
+		}
+		pid = fork();
+		if (pid == 0) {
+			close(ready[0]);
+			bench_receiver(ctx.path, ready[1]);
+			_exit(0);
+		}
+		close(ready[1]);
+		if (read(ready[0], &fd, sizeof (fd)) != sizeof (fd) || fd == -1) {
+			fprintf(stderr, "unable to listen on %s\n", ctx.path);
+			close(ready[0]);
+			ret = 1;
+			goto end;
+		}
+		close(ready[0]);
+	}
+
+	ctx.fd = mapistore_mgmt_newmail_connect(ctx.path);
+	if (ctx.fd == -1) {
+		fprintf(stderr, "unable to connect to %s: %s\n", ctx.path, strerror(errno));
+		ret = 1;
+		goto end;
+	}
+
+	/* Step 3. Deliver at the requested rate */
+	start = bench_now();
+	for (i = 0; i < opt_messages; i++) {
+		target = start + (double)i / opt_rate;
+		while (bench_now() < target) {
+			bench_drain(&ctx);
+			if (ctx.batch && bench_now() >= ctx.batch_deadline) {
+				bench_flush(&ctx);
+			}
+			usleep(100);
+		}
+
+		user = (i * 7919) % opt_users;
+		ctx.delivered[i] = bench_now();
+		ctx.users[user].uids = talloc_realloc(ctx.users, ctx.users[user].uids, uint32_t, ctx.users[user].count + 1);
+		ctx.users[user].uids[ctx.users[user].count++] = i;
+		bench_deliver(&ctx, user, i);
+	}
+	elapsed = bench_now() - start;
+
+	/* Step 4. Wait for the last notifications */
+	target = bench_now() + BENCH_DRAIN_TIMEOUT;
+	while (ctx.latencies_count < opt_messages && bench_now() < target) {
+		if (ctx.batch && bench_now() >= ctx.batch_deadline) {
+			bench_flush(&ctx);
+		}
+		bench_drain(&ctx);
+		usleep(100);
+	}
+
+	printf("%u deliveries to %u users in %.3f s (%.0f/s), delay %u ms\n", opt_messages, opt_users,
+	       elapsed, opt_messages / elapsed, ctx.delay);
+	printf("%u datagrams sent, %u send errors, %u notifications received\n",
+	       ctx.datagrams, ctx.send_errors, ctx.notifications);
+	if (ctx.latencies_count) {
+		qsort(ctx.latencies, ctx.latencies_count, sizeof (double), bench_cmp_double);
+		printf("latency (ms): p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+		       ctx.latencies[ctx.latencies_count / 2] * 1000.0,
+		       ctx.latencies[ctx.latencies_count * 9 / 10] * 1000.0,
+		       ctx.latencies[ctx.latencies_count * 99 / 100] * 1000.0,
+		       ctx.latencies[ctx.latencies_count - 1] * 1000.0);
+	}
+	if (ctx.latencies_count != opt_messages) {
+		printf("%u deliveries were never notified\n", opt_messages - ctx.latencies_count);
+		ret = 1;
+	}
+
+end:
+	if (pid > 0) {
+		kill(pid, SIGTERM);
+		waitpid(pid, NULL, 0);
+		unlink(ctx.path);
+	}
+	for (i = 0; ctx.users && i < ctx.users_count; i++) {
+		mq_close(ctx.users[i].mqfd);
+		queue = talloc_asprintf(mem_ctx, "/%s#newmail", ctx.users[i].name);
+		mq_unlink(queue);
+	}
+	talloc_free(mem_ctx);
+
+	return ret;
+}
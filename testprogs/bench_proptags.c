@@ -0,0 +1,240 @@
+/*
+   Benchmark property tag and named property metadata lookups
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2013
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+   The canonical and named property tables are enumerated through
+   the public API, for every property id and every property type, into
+   a flat array. A fixed number of tag->name, name->tag and id->type
+   lookups are then timed against the libmapi indexed lookups and
+   against a linear scan of the flat array, which is what libmapi used
+   to do.
+ */
+
+#include "libmapi/libmapi.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <sys/time.h>
+
+#define	BENCH_LOOKUPS	100000
+
+struct legacy_proptag {
+	uint32_t	proptag;
+	const char	*propname;
+};
+
+static const uint16_t bench_types[] = {
+	PT_I2, PT_LONG, PT_R4, PT_DOUBLE, PT_CURRENCY, PT_APPTIME, PT_ERROR,
+	PT_BOOLEAN, PT_OBJECT, PT_I8, PT_STRING8, PT_UNICODE, PT_SYSTIME,
+	PT_CLSID, PT_SVREID, PT_SRESTRICT, PT_ACTIONS, PT_BINARY,
+	PT_MV_I2, PT_MV_LONG, PT_MV_R4, PT_MV_DOUBLE, PT_MV_CURRENCY,
+	PT_MV_APPTIME, PT_MV_I8, PT_MV_STRING8, PT_MV_UNICODE, PT_MV_SYSTIME,
+	PT_MV_CLSID, PT_MV_BINARY
+};
+
+static double bench_now(void)
+{
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static struct legacy_proptag *bench_enumerate(TALLOC_CTX *mem_ctx, const char *(*get_name)(uint32_t),
+					      uint32_t *count)
+{
+	struct legacy_proptag	*table = NULL;
+	const char		*propname;
+	uint32_t		proptag;
+	uint32_t		id;
+	uint32_t		i;
+
+	*count = 0;
+	for (id = 0; id < 0x10000; id++) {
+		for (i = 0; i < ARRAY_SIZE(bench_types); i++) {
+			proptag = (id << 16) | bench_types[i];
+			propname = get_name(proptag);
+			/* skip the _UNICODE fallback of STRING8 lookups */
+			if (!propname || get_name(proptag + 1) == propname) continue;
+
+			table = talloc_realloc(mem_ctx, table, struct legacy_proptag, *count + 1);
+			table[*count].proptag = proptag;
+			table[*count].propname = propname;
+			*count += 1;
+		}
+	}
+
+	return table;
+}
+
+static const char *legacy_get_name(struct legacy_proptag *table, uint32_t count, uint32_t proptag)
+{
+	uint32_t	i;
+
+	for (i = 0; i < count; i++) {
+		if (table[i].proptag == proptag) {
+			return table[i].propname;
+		}
+	}
+
+	return NULL;
+}
+
+static uint32_t legacy_get_value(struct legacy_proptag *table, uint32_t count, const char *propname)
+{
+	uint32_t	i;
+
+	for (i = 0; i < count; i++) {
+		if (!strcmp(table[i].propname, propname)) {
+			return table[i].proptag;
+		}
+	}
+
+	return 0;
+}
+
+static uint16_t legacy_get_type(struct legacy_proptag *table, uint32_t count, uint16_t untypedtag)
+{
+	uint32_t	i;
+	uint16_t	current_type;
+
+	for (i = 0; i < count; i++) {
+		if ((table[i].proptag >> 16) == untypedtag) {
+			current_type = table[i].proptag & 0xFFFF;
+			if (current_type != PT_ERROR && current_type != PT_STRING8) {
+				return current_type;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void bench_table(const char *label, struct legacy_proptag *table, uint32_t count, uint32_t lookups,
+			const char *(*get_name)(uint32_t), uint32_t (*get_value)(const char *),
+			uint16_t (*get_type)(uint16_t))
+{
+	struct legacy_proptag	*entry;
+	uint32_t		i;
+	uint32_t		errors = 0;
+	double			start;
+	double			indexed[3];
+	double			legacy[3];
+
+	if (!count) return;
+
+	start = bench_now();
+	for (i = 0; i < lookups; i++) {
+		entry = &table[(i * 7919) % count];
+		if (get_name(entry->proptag) != entry->propname) errors++;
+	}
+	indexed[0] = bench_now() - start;
+
+	start = bench_now();
+	for (i = 0; i < lookups; i++) {
+		entry = &table[(i * 7919) % count];
+		legacy_get_name(table, count, entry->proptag);
+	}
+	legacy[0] = bench_now() - start;
+
+	start = bench_now();
+	for (i = 0; i < lookups; i++) {
+		entry = &table[(i * 7919) % count];
+		if (!get_value(entry->propname)) errors++;
+	}
+	indexed[1] = bench_now() - start;
+
+	start = bench_now();
+	for (i = 0; i < lookups; i++) {
+		entry = &table[(i * 7919) % count];
+		legacy_get_value(table, count, entry->propname);
+	}
+	legacy[1] = bench_now() - start;
+
+	start = bench_now();
+	for (i = 0; i < lookups; i++) {
+		entry = &table[(i * 7919) % count];
+		get_type(entry->proptag >> 16);
+	}
+	indexed[2] = bench_now() - start;
+
+	start = bench_now();
+	for (i = 0; i < lookups; i++) {
+		entry = &table[(i * 7919) % count];
+		legacy_get_type(table, count, entry->proptag >> 16);
+	}
+	legacy[2] = bench_now() - start;
+
+	printf("%-9s %5u tags  tag->name %8.3f / %8.3f us  name->tag %8.3f / %8.3f us  type %8.3f / %8.3f us\n",
+	       label, count,
+	       indexed[0] * 1000000.0 / lookups, legacy[0] * 1000000.0 / lookups,
+	       indexed[1] * 1000000.0 / lookups, legacy[1] * 1000000.0 / lookups,
+	       indexed[2] * 1000000.0 / lookups, legacy[2] * 1000000.0 / lookups);
+	if (errors) {
+		printf("%-9s %u lookups returned an unexpected result\n", label, errors);
+	}
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX		*mem_ctx;
+	poptContext		pc;
+	int			opt;
+	uint32_t		opt_lookups = BENCH_LOOKUPS;
+	struct legacy_proptag	*table;
+	uint32_t		count;
+
+	enum {OPT_LOOKUPS=1000};
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{"lookups", 'l', POPT_ARG_INT, NULL, OPT_LOOKUPS, "number of lookups to time", "COUNT"},
+		{ NULL, 0, POPT_ARG_NONE, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_proptags", argc, argv, long_options, 0);
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_LOOKUPS:
+			opt_lookups = atoi(poptGetOptArg(pc));
+			break;
+		}
+	}
+	poptFreeContext(pc);
+
+	if (!opt_lookups) {
+		return 1;
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_proptags");
+
+	printf("timings are indexed / linear scan, per lookup\n");
+	table = bench_enumerate(mem_ctx, get_proptag_name, &count);
+	bench_table("canonical", table, count, opt_lookups, get_proptag_name, get_proptag_value, get_property_type);
+
+	table = bench_enumerate(mem_ctx, get_namedid_name, &count);
+	bench_table("named", table, count, opt_lookups, get_namedid_name, get_namedid_value, get_namedid_type);
+
+	talloc_free(mem_ctx);
+
+	return 0;
+}
@@ -97,6 +97,7 @@ _PUBLIC_ uint32_t module_oxcfold_init(struct mapitest *mt)
 	mapitest_suite_add_test(suite, "GET-CONTENTS-TABLE", "Retrieve the contents table", mapitest_oxcfold_GetContentsTable);
 	mapitest_suite_add_test(suite, "SET-SEARCHCRITERIA", "Set a search criteria on a container", mapitest_oxcfold_SetSearchCriteria);
 	mapitest_suite_add_test(suite, "GET-SEARCHCRITERIA", "Retrieve a search criteria associated to a container", mapitest_oxcfold_GetSearchCriteria);
+	mapitest_suite_add_test(suite, "SEARCH-UPDATE", "Check a saved message appears in a search folder", mapitest_oxcfold_SearchFolderUpdate);
 	mapitest_suite_add_test(suite, "MOVECOPY-MESSAGES", "Move or copy messages from a source to destination folder", mapitest_oxcfold_MoveCopyMessages);
 	mapitest_suite_add_test(suite, "MOVEFOLDER", "Move folder from source to destination", mapitest_oxcfold_MoveFolder);
 	mapitest_suite_add_test(suite, "COPYFOLDER", "Copy folder from source to destination", mapitest_oxcfold_CopyFolder);
@@ -381,10 +382,15 @@ _PUBLIC_ uint32_t module_noserver_init(struct mapitest *mt)
 	mapitest_suite_add_test(suite, "LZFU-DECOMPRESS", "Test Compressed RTF decompression operations", mapitest_noserver_lzfu);
 	mapitest_suite_add_test(suite, "LZFU-COMPRESS", "Test Compressed RTF compression operations", mapitest_noserver_rtfcp);
 	mapitest_suite_add_test(suite, "LZFU-COMPRESS-LARGE", "Test RTF (de)compression operations on larger file", mapitest_noserver_rtfcp_large);
+	mapitest_suite_add_test(suite, "LZFU-STREAM", "Test streaming RTF (de)compression operations", mapitest_noserver_rtfcp_stream);
+	mapitest_suite_add_test(suite, "LZFU-CRC", "Test Compressed RTF CRC and dictionary references", mapitest_noserver_rtfcp_crc);
+	mapitest_suite_add_test(suite, "FXPARSER", "Test FastTransfer stream parsing", mapitest_noserver_fxparser);
+	mapitest_suite_add_test(suite, "IDSET", "Test IDSET serialization and set operations", mapitest_noserver_idset);
 	mapitest_suite_add_test(suite, "SROWSET", "Test SRowSet parsing", mapitest_noserver_srowset);
 	mapitest_suite_add_test(suite, "GETSETPROPS", "Test Property handling", mapitest_noserver_properties);
 	mapitest_suite_add_test(suite, "MAPIPROPS", "Test MAPI Property handling", mapitest_noserver_mapi_properties);
 	mapitest_suite_add_test(suite, "PROPTAGVALUE", "Test MAPI PropTag value handling", mapitest_noserver_proptagvalue);
+	mapitest_suite_add_test(suite, "EXT2-REQUEST", "Test compressed EcDoRpcExt2 request round-trip", mapitest_noserver_ext2_request);
 
 	mapitest_suite_register(mt, suite);
 
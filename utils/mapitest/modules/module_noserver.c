@@ -21,6 +21,8 @@
 
 #include "utils/mapitest/mapitest.h"
 #include "utils/mapitest/proto.h"
+#include "gen_ndr/ndr_exchange.h"
+#include "libmapi/libmapi_private.h"
 
 /**
    \file module_noserver.c
@@ -265,6 +267,218 @@ _PUBLIC_ bool mapitest_noserver_rtfcp_large(struct mapitest *mt)
 	return true;
 }
 
+/**
+     \details Test the streaming Compressed RTF compression and
+     decompression routines
+
+   This function:
+   -# Loads the large test file
+   -# Compresses it in small chunks and checks the result matches compress_rtf
+   -# Decompresses it in small chunks and checks the result matches the test file
+
+   \param mt pointer to the top-level mapitest structure
+
+   \return true on success, otherwise false
+*/ 
+_PUBLIC_ bool mapitest_noserver_rtfcp_stream(struct mapitest *mt)
+{
+	enum MAPISTATUS		retval;
+	char			*filename = NULL;
+	char			*original_data;
+	size_t			original_length;
+	uint8_t			*compressed;
+	size_t			compressed_length;
+	struct lzfu_stream	*stream;
+	DATA_BLOB		out;
+	DATA_BLOB		header;
+	DATA_BLOB		streamed;
+	size_t			offset;
+	size_t			chunk;
+
+	/* load the test file */
+	filename = talloc_asprintf(mt->mem_ctx, "%s/testcase.rtf", LZFU_DATADIR);
+	original_data = file_load(filename, &original_length, 0, mt->mem_ctx);
+	if (!original_data) {
+		perror(filename);
+		mapitest_print(mt, "%s: Error while loading %s\n", __FUNCTION__, filename);
+		talloc_free(filename);
+		return false;
+	}
+	talloc_free(filename);
+
+	retval = compress_rtf(mt->mem_ctx, original_data, original_length, &compressed, &compressed_length);
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval_clean(mt, "mapitest_noserver_rtfcp_stream - step 1 (bad retval)", retval);
+		return false;
+	}
+
+	/* compress it 7 bytes at a time */
+	stream = lzfu_compress_init(mt->mem_ctx);
+	streamed = data_blob_talloc(mt->mem_ctx, NULL, 16); /* room for the LZFu header */
+	for (offset = 0; offset < original_length; offset += chunk) {
+		chunk = (original_length - offset > 7) ? 7 : original_length - offset;
+		retval = lzfu_compress_update(stream, (const uint8_t *)original_data + offset, chunk, &out);
+		if (retval != MAPI_E_SUCCESS) {
+			mapitest_print_retval_clean(mt, "mapitest_noserver_rtfcp_stream - step 2 (bad retval)", retval);
+			return false;
+		}
+		data_blob_append(mt->mem_ctx, &streamed, out.data, out.length);
+	}
+	retval = lzfu_compress_final(stream, &out, &header);
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval_clean(mt, "mapitest_noserver_rtfcp_stream - step 3 (bad retval)", retval);
+		return false;
+	}
+	data_blob_append(mt->mem_ctx, &streamed, out.data, out.length);
+	memcpy(streamed.data, header.data, header.length);
+	talloc_free(stream);
+
+	if (streamed.length != compressed_length || memcmp(streamed.data, compressed, compressed_length)) {
+		mapitest_print(mt, "* %-40s: compare compressed results - mismatch\n", "RTFCP_STREAM");
+		return false;
+	}
+	mapitest_print(mt, "* %-40s: compare compressed results - match\n", "RTFCP_STREAM");
+	data_blob_free(&streamed);
+
+	/* decompress it 7 bytes at a time */
+	stream = lzfu_uncompress_init(mt->mem_ctx);
+	streamed = data_blob_talloc(mt->mem_ctx, NULL, 0);
+	for (offset = 0; offset < compressed_length; offset += chunk) {
+		chunk = (compressed_length - offset > 7) ? 7 : compressed_length - offset;
+		retval = lzfu_uncompress_update(stream, compressed + offset, chunk, &out);
+		if (retval != MAPI_E_SUCCESS) {
+			mapitest_print_retval_clean(mt, "mapitest_noserver_rtfcp_stream - step 4 (bad retval)", retval);
+			return false;
+		}
+		data_blob_append(mt->mem_ctx, &streamed, out.data, out.length);
+	}
+	retval = lzfu_uncompress_final(stream);
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval_clean(mt, "mapitest_noserver_rtfcp_stream - step 5 (bad retval)", retval);
+		return false;
+	}
+	talloc_free(stream);
+
+	if (streamed.length != original_length || memcmp(streamed.data, original_data, original_length)) {
+		mapitest_print(mt, "* %-40s: compare decompressed results - mismatch\n", "RTFCP_STREAM");
+		return false;
+	}
+	mapitest_print(mt, "* %-40s: compare decompressed results - match\n", "RTFCP_STREAM");
+
+	/* clean up */
+	data_blob_free(&streamed);
+	talloc_free(compressed);
+	talloc_free(original_data);
+
+	return true;
+}
+
+/* Bit by bit CRC, as specified by MS-OXRTFCP: no table, no pre or post conditioning */
+static uint32_t mapitest_noserver_crc_bitwise(const uint8_t *data, size_t length)
+{
+	uint32_t	crc = 0;
+	size_t		i;
+	int		bit;
+
+	for (i = 0; i < length; i++) {
+		crc ^= data[i];
+		for (bit = 0; bit < 8; bit++) {
+			crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : (crc >> 1);
+		}
+	}
+
+	return crc;
+}
+
+/**
+     \details Test the Compressed RTF CRC and the decompression of
+     dictionary references
+
+   This function:
+   -# Checks calculateCRC() against a bit by bit CRC, for all offsets
+      and lengths covering both the byte-wise and the slice-by-8 kernels
+   -# Compresses a periodic RTF whose references overlap the bytes being
+      written and wrap around the dictionary
+   -# Checks that uncompress_rtf and the streaming decompressor return it
+
+   \param mt pointer to the top-level mapitest structure
+
+   \return true on success, otherwise false
+*/ 
+_PUBLIC_ bool mapitest_noserver_rtfcp_crc(struct mapitest *mt)
+{
+	enum MAPISTATUS		retval;
+	uint8_t			*data;
+	size_t			data_length = 0x3000;
+	uint32_t		offset;
+	uint32_t		length;
+	uint8_t			*compressed;
+	size_t			compressed_length;
+	DATA_BLOB		decompressed;
+	struct lzfu_stream	*stream;
+	DATA_BLOB		out;
+	size_t			i;
+
+	data = talloc_array(mt->mem_ctx, uint8_t, data_length);
+	for (i = 0; i < data_length; i++) {
+		data[i] = (i * 7919 + (i >> 5)) & 0xFF;
+	}
+
+	for (offset = 0; offset < 8; offset++) {
+		for (length = 0; length + offset <= data_length; length += (length < 256) ? 1 : 997) {
+			if (calculateCRC(data, offset, length) != mapitest_noserver_crc_bitwise(data + offset, length)) {
+				mapitest_print(mt, "* %-40s: CRC mismatch at offset %u, length %u\n", "RTFCP_CRC", offset, length);
+				return false;
+			}
+		}
+	}
+	mapitest_print(mt, "* %-40s: compare CRC results - match\n", "RTFCP_CRC");
+
+	/* a short period makes references overlap the dictionary write position */
+	for (i = 0; i < data_length; i++) {
+		data[i] = "{\\rtf1 abc}"[i % 11];
+	}
+
+	retval = compress_rtf(mt->mem_ctx, (const char *)data, data_length, &compressed, &compressed_length);
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval_clean(mt, "mapitest_noserver_rtfcp_crc - step 1 (bad retval)", retval);
+		return false;
+	}
+
+	retval = uncompress_rtf(mt->mem_ctx, compressed, compressed_length, &decompressed);
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval_clean(mt, "mapitest_noserver_rtfcp_crc - step 2 (bad retval)", retval);
+		return false;
+	}
+	if (decompressed.length != data_length + 1 || memcmp(decompressed.data, data, data_length)) {
+		mapitest_print(mt, "* %-40s: compare decompressed results - mismatch\n", "RTFCP_CRC");
+		return false;
+	}
+	talloc_free(decompressed.data);
+
+	stream = lzfu_uncompress_init(mt->mem_ctx);
+	retval = lzfu_uncompress_update(stream, compressed, compressed_length, &out);
+	if (retval == MAPI_E_SUCCESS) {
+		retval = lzfu_uncompress_final(stream);
+	}
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval_clean(mt, "mapitest_noserver_rtfcp_crc - step 3 (bad retval)", retval);
+		return false;
+	}
+	if (out.length != data_length || memcmp(out.data, data, data_length)) {
+		mapitest_print(mt, "* %-40s: compare streamed results - mismatch\n", "RTFCP_CRC");
+		return false;
+	}
+	mapitest_print(mt, "* %-40s: compare decompressed results - match\n", "RTFCP_CRC");
+
+	/* clean up */
+	talloc_free(stream);
+	talloc_free(compressed);
+	talloc_free(data);
+
+	return true;
+}
+
 #define SROWSET_UNTAGGED "004d542044756d6d792046726f6d00426f6479206f66206d657373616765203800004d542044756d6d792046726f6d00426f6479206f66206d657373616765203900004d542044756d6d792046726f6d00426f6479206f66206d657373616765203700004d542044756d6d792046726f6d00426f6479206f66206d657373616765203600004d542044756d6d793400426f6479206f66206d657373616765203400004d542044756d6d792046726f6d00426f6479206f66206d657373616765203500004d542044756d6d793300426f6479206f66206d657373616765203300004d542044756d6d793100426f6479206f66206d657373616765203100004d542044756d6d793200426f6479206f66206d657373616765203200004d542044756d6d793000426f6479206f66206d657373616765203000"
 #define SROWSET_UNTAGGED_LEN 310
 
@@ -1213,6 +1427,378 @@ _PUBLIC_ bool mapitest_noserver_mapi_properties(struct mapitest *mt)
 	return true;
 }
 
+struct mt_fxparser_events {
+	TALLOC_CTX	*mem_ctx;
+	uint32_t	markers;
+	uint32_t	flags;
+	char		*subject;
+	DATA_BLOB	rtf;
+	uint32_t	chunks;
+	bool		error;
+};
+
+static enum MAPISTATUS mt_fxparser_marker(uint32_t marker, void *priv)
+{
+	struct mt_fxparser_events	*events = (struct mt_fxparser_events *) priv;
+
+	events->markers++;
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS mt_fxparser_property(struct SPropValue prop, void *priv)
+{
+	struct mt_fxparser_events	*events = (struct mt_fxparser_events *) priv;
+
+	switch (prop.ulPropTag) {
+	case PidTagMessageFlags:
+		events->flags = prop.value.l;
+		break;
+	case PidTagSubject:
+		events->subject = talloc_strdup(events->mem_ctx, prop.value.lpszW);
+		break;
+	case PidTagRtfCompressed:
+		events->rtf = data_blob_talloc(events->mem_ctx, prop.value.bin.lpb, prop.value.bin.cb);
+		break;
+	default:
+		events->error = true;
+	}
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS mt_fxparser_chunk(uint32_t proptag, DATA_BLOB chunk, uint32_t offset, uint32_t length, void *priv)
+{
+	struct mt_fxparser_events	*events = (struct mt_fxparser_events *) priv;
+
+	if (proptag != PidTagRtfCompressed || offset != events->rtf.length || offset + chunk.length > length) {
+		events->error = true;
+		return MAPI_E_SUCCESS;
+	}
+	data_blob_append(events->mem_ctx, &events->rtf, chunk.data, chunk.length);
+	events->chunks++;
+	return MAPI_E_SUCCESS;
+}
+
+static void mt_fxparser_push_uint32(TALLOC_CTX *mem_ctx, DATA_BLOB *blob, uint32_t value)
+{
+	uint8_t	data[4];
+
+	data[0] = value & 0xFF;
+	data[1] = (value >> 8) & 0xFF;
+	data[2] = (value >> 16) & 0xFF;
+	data[3] = (value >> 24) & 0xFF;
+	data_blob_append(mem_ctx, blob, data, 4);
+}
+
+static bool mt_fxparser_check(struct mapitest *mt, const char *label, struct mt_fxparser_events *events, DATA_BLOB *rtf)
+{
+	if (events->error || events->markers != 2 || events->flags != 0x1
+	    || !events->subject || strcmp(events->subject, "fxparser")
+	    || events->rtf.length != rtf->length || memcmp(events->rtf.data, rtf->data, rtf->length)) {
+		mapitest_print(mt, "* %-40s: compare %s results - mismatch\n", "FXPARSER", label);
+		return false;
+	}
+	mapitest_print(mt, "* %-40s: compare %s results - match\n", "FXPARSER", label);
+	return true;
+}
+
+/**
+     \details Test the FastTransfer stream parser
+
+   This function:
+   -# Builds a FastTransfer stream holding a message with a large binary property
+   -# Parses the stream in a single buffer
+   -# Parses the stream split in buffers of varying sizes
+   -# Parses the stream in streaming mode and checks the large
+      property was handed over in chunks, without being buffered
+
+   \param mt pointer on the top-level mapitest structure
+
+   \return true on success, otherwise false
+*/
+_PUBLIC_ bool mapitest_noserver_fxparser(struct mapitest *mt)
+{
+	TALLOC_CTX			*mem_ctx;
+	struct fx_parser_context	*parser;
+	struct mt_fxparser_events	events;
+	DATA_BLOB			stream;
+	DATA_BLOB			rtf;
+	DATA_BLOB			buf;
+	const char			*subject = "fxparser";
+	uint32_t			offset;
+	uint32_t			i;
+	size_t				max_size;
+	bool				ret = false;
+
+	mem_ctx = talloc_named(NULL, 0, "mapitest_noserver_fxparser");
+
+	rtf = data_blob_talloc(mem_ctx, NULL, 256 * 1024);
+	for (i = 0; i < rtf.length; i++) {
+		rtf.data[i] = (i * 7919 + (i >> 9)) & 0xFF;
+	}
+
+	stream = data_blob_talloc(mem_ctx, NULL, 0);
+	mt_fxparser_push_uint32(mem_ctx, &stream, PidTagStartMessage);
+	mt_fxparser_push_uint32(mem_ctx, &stream, PidTagMessageFlags);
+	mt_fxparser_push_uint32(mem_ctx, &stream, 0x1); /* MSGFLAG_READ */
+	mt_fxparser_push_uint32(mem_ctx, &stream, PidTagSubject);
+	mt_fxparser_push_uint32(mem_ctx, &stream, (strlen(subject) + 1) * 2);
+	for (i = 0; i <= strlen(subject); i++) {
+		uint8_t	ucs2[2] = { subject[i], 0 };
+		data_blob_append(mem_ctx, &stream, ucs2, 2);
+	}
+	mt_fxparser_push_uint32(mem_ctx, &stream, PidTagRtfCompressed);
+	mt_fxparser_push_uint32(mem_ctx, &stream, rtf.length);
+	data_blob_append(mem_ctx, &stream, rtf.data, rtf.length);
+	mt_fxparser_push_uint32(mem_ctx, &stream, PidTagEndMessage);
+
+	/* Step 1. Parse the stream at once */
+	memset(&events, 0, sizeof (events));
+	events.mem_ctx = mem_ctx;
+	parser = fxparser_init(mem_ctx, &events);
+	fxparser_set_marker_callback(parser, mt_fxparser_marker);
+	fxparser_set_property_callback(parser, mt_fxparser_property);
+	fxparser_parse(parser, &stream);
+	talloc_free(parser);
+	if (!mt_fxparser_check(mt, "single buffer", &events, &rtf)) goto end;
+
+	/* Step 2. Parse the stream in buffers of varying sizes */
+	memset(&events, 0, sizeof (events));
+	events.mem_ctx = mem_ctx;
+	parser = fxparser_init(mem_ctx, &events);
+	fxparser_set_marker_callback(parser, mt_fxparser_marker);
+	fxparser_set_property_callback(parser, mt_fxparser_property);
+	for (offset = 0, i = 1; offset < stream.length; offset += buf.length, i = (i * 3) % 5003) {
+		buf.data = stream.data + offset;
+		buf.length = (stream.length - offset < i) ? stream.length - offset : i;
+		fxparser_parse(parser, &buf);
+	}
+	talloc_free(parser);
+	if (!mt_fxparser_check(mt, "split buffers", &events, &rtf)) goto end;
+
+	/* Step 3. Stream the large property */
+	memset(&events, 0, sizeof (events));
+	events.mem_ctx = mem_ctx;
+	max_size = 0;
+	parser = fxparser_init(mem_ctx, &events);
+	fxparser_set_marker_callback(parser, mt_fxparser_marker);
+	fxparser_set_property_callback(parser, mt_fxparser_property);
+	fxparser_set_chunk_callback(parser, mt_fxparser_chunk, 1024);
+	for (offset = 0; offset < stream.length; offset += buf.length) {
+		buf.data = stream.data + offset;
+		buf.length = (stream.length - offset < 4000) ? stream.length - offset : 4000;
+		fxparser_parse(parser, &buf);
+		if (talloc_total_size(parser) > max_size) {
+			max_size = talloc_total_size(parser);
+		}
+	}
+	talloc_free(parser);
+	if (!mt_fxparser_check(mt, "streamed", &events, &rtf)) goto end;
+	if (events.chunks < rtf.length / 4000 || max_size > 16384) {
+		mapitest_print(mt, "* %-40s: %u chunks, %zu bytes kept by the parser\n", "FXPARSER", events.chunks, max_size);
+		goto end;
+	}
+
+	ret = true;
+end:
+	talloc_free(mem_ctx);
+	return ret;
+}
+
+/**
+     \details Test the IDSET conversion, serialization and set operations
+
+   This function:
+   -# Builds an IDSET from unordered ids and checks its serialized GLOBSET
+   -# Parses the serialized IDSET back and checks the membership of ids
+   -# Merges another IDSET and checks its ranges were coalesced
+   -# Removes ids from the middle of a range
+
+   \param mt pointer on the top-level mapitest structure
+
+   \return true on success, otherwise false
+*/
+_PUBLIC_ bool mapitest_noserver_idset(struct mapitest *mt)
+{
+	const uint64_t		globcnts[] = { 0x102, 0x200, 0x100, 0x101, 0x100 };
+	const uint64_t		merged_globcnts[] = { 0x1ff, 0x103 };
+	/* replid 1, push 5 + range [0x100:0x102] + pop, push 6 0x200, end */
+	const uint8_t		expected[] = { 0x01, 0x00,
+					       0x05, 0x00, 0x00, 0x00, 0x00, 0x01,
+					       0x52, 0x00, 0x02, 0x50,
+					       0x06, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00,
+					       0x00 };
+	struct rawidset		*rawidset;
+	struct idset		*idset;
+	struct idset		*parsed;
+	struct idset		*merged;
+	struct Binary_r		*bin;
+	DATA_BLOB		blob;
+	uint32_t		i;
+
+#define	IDSET_EID(globcnt)	((exchange_globcnt(globcnt) << 16) | 0x0001)
+
+	rawidset = RAWIDSET_make(mt->mem_ctx, true, false);
+	for (i = 0; i < sizeof(globcnts) / sizeof(globcnts[0]); i++) {
+		RAWIDSET_push_eid(rawidset, IDSET_EID(globcnts[i]));
+	}
+	idset = RAWIDSET_convert_to_idset(mt->mem_ctx, rawidset);
+	if (!idset || idset->range_count != 2) {
+		mapitest_print(mt, "* %-40s: unexpected range count\n", "IDSET");
+		return false;
+	}
+
+	bin = IDSET_serialize(mt->mem_ctx, idset);
+	if (bin->cb != sizeof(expected) || memcmp(bin->lpb, expected, sizeof(expected))) {
+		mapitest_print(mt, "* %-40s: compare serialized results - mismatch\n", "IDSET");
+		return false;
+	}
+	mapitest_print(mt, "* %-40s: compare serialized results - match\n", "IDSET");
+
+	blob.data = bin->lpb;
+	blob.length = bin->cb;
+	parsed = IDSET_parse(mt->mem_ctx, blob, true);
+	if (!parsed || parsed->range_count != 2 || parsed->next
+	    || !IDSET_includes_eid(parsed, IDSET_EID(0x101)) || !IDSET_includes_eid(parsed, IDSET_EID(0x200))
+	    || IDSET_includes_eid(parsed, IDSET_EID(0x103)) || IDSET_includes_eid(parsed, IDSET_EID(0x0ff))
+	    || IDSET_includes_eid(parsed, IDSET_EID(0x101) | 0x2)) {
+		mapitest_print(mt, "* %-40s: compare parsed results - mismatch\n", "IDSET");
+		return false;
+	}
+	mapitest_print(mt, "* %-40s: compare parsed results - match\n", "IDSET");
+
+	rawidset = RAWIDSET_make(mt->mem_ctx, true, false);
+	for (i = 0; i < sizeof(merged_globcnts) / sizeof(merged_globcnts[0]); i++) {
+		RAWIDSET_push_eid(rawidset, IDSET_EID(merged_globcnts[i]));
+	}
+	merged = IDSET_merge_idsets(mt->mem_ctx, parsed, RAWIDSET_convert_to_idset(mt->mem_ctx, rawidset));
+	if (!merged || merged->range_count != 2
+	    || merged->ranges[0].low != 0x100 || merged->ranges[0].high != 0x103
+	    || merged->ranges[1].low != 0x1ff || merged->ranges[1].high != 0x200) {
+		mapitest_print(mt, "* %-40s: compare merged results - mismatch\n", "IDSET");
+		return false;
+	}
+	mapitest_print(mt, "* %-40s: compare merged results - match\n", "IDSET");
+
+	rawidset = RAWIDSET_make(mt->mem_ctx, true, false);
+	RAWIDSET_push_eid(rawidset, IDSET_EID(0x101));
+	RAWIDSET_push_eid(rawidset, IDSET_EID(0x200));
+	IDSET_remove_rawidset(merged, rawidset);
+	if (merged->range_count != 3
+	    || !IDSET_includes_eid(merged, IDSET_EID(0x100)) || IDSET_includes_eid(merged, IDSET_EID(0x101))
+	    || !IDSET_includes_eid(merged, IDSET_EID(0x102)) || !IDSET_includes_eid(merged, IDSET_EID(0x1ff))
+	    || IDSET_includes_eid(merged, IDSET_EID(0x200))) {
+		mapitest_print(mt, "* %-40s: compare removal results - mismatch\n", "IDSET");
+		return false;
+	}
+	mapitest_print(mt, "* %-40s: compare removal results - match\n", "IDSET");
+
+#undef	IDSET_EID
+
+	return true;
+}
+
+/**
+     \details Test the compressed EcDoRpcExt2 request round-trip
+
+   This function:
+   -# Builds a request of Release ROPs and pushes it the way
+      emsmdb_transaction_ext2() does, with RHEF_Compressed
+   -# Checks the extended buffer header was compressed and not obfuscated
+   -# Pulls the buffer back with ndr_pull_mapi2k7_request() and checks
+      the ROPs and the handle table match the original request
+
+   \param mt pointer on the top-level mapitest structure
+
+   \return true on success, otherwise false
+*/
+_PUBLIC_ bool mapitest_noserver_ext2_request(struct mapitest *mt)
+{
+	const uint32_t		handles[] = { 0x00000001, 0x00000002, 0x00000003, 0x00000004 };
+	const uint32_t		rop_count = 256;
+	struct mapi_request	req;
+	struct mapi2k7_request	pulled;
+	struct ndr_push		*ndr_uncomp;
+	struct ndr_push		*ndr_push;
+	struct ndr_pull		*ndr_pull;
+	DATA_BLOB		blob;
+	enum ndr_err_code	ndr_err;
+	uint32_t		i;
+
+	/* Step 1. Build and push the request */
+	req.mapi_req = talloc_zero_array(mt->mem_ctx, struct EcDoRpc_MAPI_REQ, rop_count + 1);
+	for (i = 0; i < rop_count; i++) {
+		req.mapi_req[i].opnum = op_MAPI_Release;
+		req.mapi_req[i].logon_id = 0;
+		req.mapi_req[i].handle_idx = i % (sizeof(handles) / sizeof(handles[0]));
+	}
+	req.length = sizeof (uint16_t) + rop_count * 3;
+	req.mapi_len = req.length + sizeof (handles);
+	req.handles = discard_const_p(uint32_t, handles);
+
+	ndr_uncomp = ndr_push_init_ctx(mt->mem_ctx);
+	ndr_set_flags(&ndr_uncomp->flags, LIBNDR_FLAG_NOALIGN);
+	ndr_err = ndr_push_mapi_request(ndr_uncomp, NDR_SCALARS|NDR_BUFFERS, &req);
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+		mapitest_print(mt, "* %-40s: [FAILURE]\n", "push mapi_request");
+		return false;
+	}
+
+	ndr_push = ndr_push_init_ctx(mt->mem_ctx);
+	ndr_set_flags(&ndr_push->flags, LIBNDR_FLAG_NOALIGN);
+	ndr_err = ndr_push_mapi_extended_buffer(ndr_push, ndr_uncomp->data, ndr_uncomp->offset,
+						RHEF_Compressed|RHEF_XorMagic|RHEF_Last, 0, NULL);
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+		mapitest_print(mt, "* %-40s: [FAILURE]\n", "push extended buffer");
+		return false;
+	}
+
+	/* Step 2. Pull the request back */
+	blob.data = ndr_push->data;
+	blob.length = ndr_push->offset;
+	ndr_pull = ndr_pull_init_blob(&blob, mt->mem_ctx);
+	ndr_set_flags(&ndr_pull->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REF_ALLOC);
+	ndr_err = ndr_pull_mapi2k7_request(ndr_pull, NDR_SCALARS|NDR_BUFFERS, &pulled);
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+		mapitest_print(mt, "* %-40s: [FAILURE]\n", "pull mapi2k7_request");
+		return false;
+	}
+
+	if (!(pulled.header.Flags & RHEF_Compressed) || (pulled.header.Flags & RHEF_XorMagic)
+	    || pulled.header.SizeActual != ndr_uncomp->offset || pulled.header.Size >= pulled.header.SizeActual) {
+		mapitest_print(mt, "* %-40s: unexpected header flags or sizes\n", "EXT2-REQUEST");
+		return false;
+	}
+	mapitest_print(mt, "* %-40s: compressed %u bytes to %u\n", "EXT2-REQUEST",
+		       pulled.header.SizeActual, pulled.header.Size);
+
+	/* Step 3. Compare the ROPs and the handle table */
+	if (pulled.mapi_request->length != req.length || pulled.mapi_request->mapi_len != req.mapi_len) {
+		mapitest_print(mt, "* %-40s: compare request lengths - mismatch\n", "EXT2-REQUEST");
+		return false;
+	}
+	for (i = 0; i < rop_count; i++) {
+		if (pulled.mapi_request->mapi_req[i].opnum != req.mapi_req[i].opnum
+		    || pulled.mapi_request->mapi_req[i].logon_id != req.mapi_req[i].logon_id
+		    || pulled.mapi_request->mapi_req[i].handle_idx != req.mapi_req[i].handle_idx) {
+			mapitest_print(mt, "* %-40s: compare ROP %u - mismatch\n", "EXT2-REQUEST", i);
+			return false;
+		}
+	}
+	if (pulled.mapi_request->mapi_req[rop_count].opnum != 0) {
+		mapitest_print(mt, "* %-40s: compare ROP count - mismatch\n", "EXT2-REQUEST");
+		return false;
+	}
+	for (i = 0; i < sizeof(handles) / sizeof(handles[0]); i++) {
+		if (pulled.mapi_request->handles[i] != handles[i]) {
+			mapitest_print(mt, "* %-40s: compare handle %u - mismatch\n", "EXT2-REQUEST", i);
+			return false;
+		}
+	}
+	mapitest_print(mt, "* %-40s: compare request - match\n", "EXT2-REQUEST");
+
+	return true;
+}
+
 /**
      \details Test the get_proptag_value() function
 
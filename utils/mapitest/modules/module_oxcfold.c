@@ -905,6 +905,172 @@ error:
 }
 
 
+/**
+   \details Test that a search folder picks up a message saved after
+   its search criteria were set
+
+   This function:
+	-# Log on the user private mailbox
+	-# Open the Inbox folder
+	-# Open the default search folder
+	-# Create a search folder within this folder
+	-# Set a foreground search criteria on the Inbox
+	-# Retrieve the number of messages in the search folder
+	-# Create and save a message matching the criteria in the Inbox
+	-# Check the message now appears in the search folder
+	-# Delete the message and the test search folder
+
+   \param mt pointer on the top-level mapitest structure
+
+   \return true on success, otherwise false
+ */
+_PUBLIC_ bool mapitest_oxcfold_SearchFolderUpdate(struct mapitest *mt)
+{
+	enum MAPISTATUS			retval;
+	bool				ret = true;
+	mapi_object_t			obj_store;
+	mapi_object_t			obj_inbox;
+	mapi_object_t			obj_search;
+	mapi_object_t			obj_searchdir;
+	mapi_object_t			obj_ctable;
+	mapi_object_t			obj_message;
+	mapi_id_t			id_inbox;
+	mapi_id_t			id_search;
+	mapi_id_t			id_msg = 0;
+	mapi_id_array_t			id;
+	struct mapi_SRestriction	res;
+	uint32_t			count;
+	uint32_t			new_count;
+
+	/* Step 1. Logon */
+	mapi_object_init(&obj_store);
+	mapi_object_init(&obj_inbox);
+	mapi_object_init(&obj_search);
+	mapi_object_init(&obj_searchdir);
+	mapi_object_init(&obj_ctable);
+	mapi_object_init(&obj_message);
+	retval = OpenMsgStore(mt->session, &obj_store);
+	mapitest_print_retval(mt, "OpenMsgStore");
+	if (retval != MAPI_E_SUCCESS) {
+		return false;
+	}
+
+	/* Step 2. Open Inbox folder */
+	retval = GetDefaultFolder(&obj_store, &id_inbox, olFolderInbox);
+	mapitest_print_retval(mt, "GetDefaultFolder");
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto release;
+	}
+
+	retval = OpenFolder(&obj_store, id_inbox, &obj_inbox);
+	mapitest_print_retval(mt, "OpenFolder");
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto release;
+	}
+
+	/* Step 3. Open Search folder */
+	retval = GetDefaultFolder(&obj_store, &id_search, olFolderFinder);
+	mapitest_print_retval(mt, "GetDefaultFolder");
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto release;
+	}
+
+	retval = OpenFolder(&obj_store, id_search, &obj_search);
+	mapitest_print_retval(mt, "OpenFolder");
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto release;
+	}
+
+	/* Step 4. Create a search folder */
+	retval = CreateFolder(&obj_search, FOLDER_SEARCH, "mapitest",
+			      "mapitest search folder", OPEN_IF_EXISTS,
+			      &obj_searchdir);
+	mapitest_print_retval(mt, "CreateFolder");
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto release;
+	}
+
+	/* Step 5. Search criteria on this folder */
+	mapi_id_array_init(mt->mapi_ctx->mem_ctx, &id);
+	mapi_id_array_add_id(&id, id_inbox);
+
+	res.rt = RES_CONTENT;
+	res.res.resContent.fuzzy = FL_SUBSTRING;
+	res.res.resContent.ulPropTag = PR_SUBJECT;
+	res.res.resContent.lpProp.ulPropTag = PR_SUBJECT;
+	res.res.resContent.lpProp.value.lpszA = MT_MAIL_SUBJECT;
+
+	retval = SetSearchCriteria(&obj_searchdir, &res,
+				   FOREGROUND_SEARCH|RECURSIVE_SEARCH, &id);
+	mapitest_print_retval(mt, "SetSearchCriteria");
+	mapi_id_array_release(&id);
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto error;
+	}
+
+	/* Step 6. Retrieve the number of messages found so far */
+	retval = GetContentsTable(&obj_searchdir, &obj_ctable, 0, &count);
+	mapitest_print_retval(mt, "GetContentsTable");
+	mapi_object_release(&obj_ctable);
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto error;
+	}
+
+	/* Step 7. Create and save a matching message */
+	if (!mapitest_common_message_create(mt, &obj_inbox, &obj_message, MT_MAIL_SUBJECT)) {
+		mapitest_print(mt, "* mapitest_common_message_create() failed\n");
+		ret = false;
+		goto error;
+	}
+
+	retval = SaveChangesMessage(&obj_inbox, &obj_message, KeepOpenReadOnly);
+	mapitest_print_retval(mt, "SaveChangesMessage");
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto error;
+	}
+	id_msg = mapi_object_get_id(&obj_message);
+
+	/* Step 8. Check the message appears in the search folder */
+	mapi_object_init(&obj_ctable);
+	retval = GetContentsTable(&obj_searchdir, &obj_ctable, 0, &new_count);
+	mapitest_print_retval(mt, "GetContentsTable");
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto error;
+	}
+	if (new_count != count + 1) {
+		mapitest_print(mt, "* %-35s: %d messages found, expected %d\n", "SearchFolderUpdate", new_count, count + 1);
+		ret = false;
+	}
+
+error:
+	if (id_msg) {
+		DeleteMessage(&obj_inbox, &id_msg, 1);
+		mapitest_print_retval(mt, "DeleteMessage");
+	}
+	DeleteFolder(&obj_search, mapi_object_get_id(&obj_searchdir),
+		     DEL_MESSAGES|DEL_FOLDERS|DELETE_HARD_DELETE, NULL);
+	mapitest_print_retval(mt, "DeleteFolder");
+
+release:
+	mapi_object_release(&obj_ctable);
+	mapi_object_release(&obj_message);
+	mapi_object_release(&obj_searchdir);
+	mapi_object_release(&obj_search);
+	mapi_object_release(&obj_inbox);
+	mapi_object_release(&obj_store);
+	return ret;
+}
+
+
 /**
    \details Test the MoveCopyMessages (0x33) operation.
 